@@ -0,0 +1,29 @@
+/*
+  File backed flash device for the wsf_flash record store.
+
+  Behaves as NOR flash: programming can only clear bits, erasing a block sets it to 0xFF.
+  The contents are kept in a file, so a store can be mounted again as after a reset.
+
+  paulvha / October 2026
+*/
+
+#ifndef _FILE_FLASH_H_
+#define _FILE_FLASH_H_
+
+#include <stdint.h>
+#include "wsf_flash.h"
+
+// open (and create if needed) a file backed flash, blank when erase is true
+const wsfFlashDev_t* fileFlashOpen(const char* path, uint32_t blockSize, uint16_t numBlocks, bool erase);
+void fileFlashClose();
+
+// erase count per block, kept by the device itself
+uint32_t fileFlashEraseCount(uint16_t block);
+
+// fail program calls after count more calls (-1 = never), to emulate a reset during a write
+void fileFlashFailAfter(int count);
+
+// fail read calls after count more calls (-1 = never), to emulate a read error of the device
+void fileFlashFailReadAfter(int count);
+
+#endif // _FILE_FLASH_H_
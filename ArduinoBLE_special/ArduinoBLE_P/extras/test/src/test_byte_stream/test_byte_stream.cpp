@@ -0,0 +1,258 @@
+/*
+  Tests for ByteStream.h and the PDU decoders in BLEPdu.h
+
+  The fuzz tests feed random PDU's of every length in an exact size heap buffer to the decoders:
+  they must never read outside the buffer (run with -fsanitize=address to catch that) and the
+  returned value must stay within the PDU. The benchmark compares the cursor with the packed
+  struct casts it replaced.
+
+  paulvha / October 2026
+*/
+
+#include <catch.hpp>
+
+#include <chrono>
+#include <stdio.h>
+#include <vector>
+
+#include "utility/ByteStream.h"
+#include "utility/BLEPdu.h"
+
+// small fixed seed generator, so a failure can be repeated
+static uint32_t fuzzRandom()
+{
+  static uint32_t state = 0x2545F491;
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+static constexpr uint8_t goldenLe[] = { 0x34, 0x12 };
+static_assert(leRead16(goldenLe) == 0x1234, "leRead16 must be usable in a constant expression");
+
+static bool inside(const uint8_t* p, uint8_t len, const uint8_t* data, uint8_t dlen)
+{
+  return len == 0 || (p != NULL && p >= data && p + len <= data + dlen);
+}
+
+TEST_CASE("Little endian helpers", "[ArduinoBLE::ByteStream]")
+{
+  WHEN("Read and write values on unaligned addresses")
+  {
+    uint8_t buf[16];
+
+    for (int offset = 0; offset < 4; offset++) {
+      uint8_t* p = &buf[offset];
+
+      p = leWrite16(p, 0xA1B2);
+      p = leWrite24(p, 0xC3D4E5);
+      p = leWrite32(p, 0xF6071829);
+      REQUIRE(p == &buf[offset + 9]);
+
+      REQUIRE(buf[offset] == 0xB2);
+      REQUIRE(leRead16(&buf[offset]) == 0xA1B2);
+      REQUIRE(leRead24(&buf[offset + 2]) == 0xC3D4E5);
+      REQUIRE(leRead32(&buf[offset + 5]) == 0xF6071829);
+    }
+  }
+
+  WHEN("The reader stops at the end")
+  {
+    const uint8_t data[] = { 0x01, 0x02, 0x03, 0x04, 0x05 };
+    ByteReader r(data, sizeof(data));
+
+    REQUIRE(r.u8() == 0x01);
+    REQUIRE(r.u16() == 0x0302);
+    REQUIRE(r.remaining() == 2);
+    REQUIRE(r.u24() == 0);
+    REQUIRE(!r.ok());
+    REQUIRE(r.remaining() == 0);
+    REQUIRE(r.u8() == 0);            // stays in error
+    REQUIRE(r.bytes(0) == NULL);
+  }
+
+  WHEN("The writer stops at the end")
+  {
+    uint8_t buf[5];
+    ByteWriter w(buf, sizeof(buf));
+
+    w.u8(0x01).u16(0x0302);
+    REQUIRE(w.ok());
+    w.u24(0x060504);
+    REQUIRE(!w.ok());
+    REQUIRE(w.length() == 3);
+  }
+}
+
+TEST_CASE("PDU decoders", "[ArduinoBLE::BLEPdu]")
+{
+  WHEN("Decode valid PDU's")
+  {
+    const uint8_t acl[] = { 0x40, 0x20, 0x07, 0x00, 0x03, 0x00, 0x04, 0x00, 0x0A, 0x10, 0x00 };
+    HCIAclHdr aclHdr;
+    L2CAPHdr l2capHdr;
+
+    REQUIRE(hciDecodeAclHdr(acl, sizeof(acl), aclHdr));
+    REQUIRE(aclHdr.handle == 0x040);
+    REQUIRE(aclHdr.flags == 0x02);
+    REQUIRE(aclHdr.dlen == 7);
+    REQUIRE(l2capDecodeHdr(&acl[HCI_ACL_HDR_SIZE], aclHdr.dlen, l2capHdr));
+    REQUIRE(l2capHdr.len == 3);
+    REQUIRE(l2capHdr.cid == 0x0004);
+
+    const uint8_t findByType[] = { 0x01, 0x00, 0xFF, 0xFF, 0x00, 0x28, 0x0F, 0x18 };
+    ATTRangeReq range;
+
+    REQUIRE(attDecodeFindByTypeReq(findByType, sizeof(findByType), range));
+    REQUIRE(range.startHandle == 0x0001);
+    REQUIRE(range.endHandle == 0xFFFF);
+    REQUIRE(range.type == 0x2800);
+    REQUIRE(range.valueLength == 2);
+    REQUIRE(leRead16(range.value) == 0x180F);
+
+    const uint8_t prepWrite[] = { 0x12, 0x00, 0x05, 0x00, 0xAA, 0xBB };
+    ATTHandleReq req;
+
+    REQUIRE(attDecodePrepWriteReq(prepWrite, sizeof(prepWrite), req));
+    REQUIRE(req.handle == 0x0012);
+    REQUIRE(req.offset == 5);
+    REQUIRE(req.valueLength == 2);
+    REQUIRE(req.value == &prepWrite[4]);
+  }
+
+  WHEN("Reject short and long PDU's")
+  {
+    const uint8_t data[8] = { 0x05, 0x00, 0x06, 0x00, 0x00, 0x28, 0x00, 0x00 };
+    uint16_t mtu;
+    ATTRangeReq range;
+    ATTHandleReq req;
+    ATTErrorRsp error;
+
+    REQUIRE(!attDecodeMtu(data, 1, mtu));
+    REQUIRE(!attDecodeMtu(data, 3, mtu));
+    REQUIRE(!attDecodeFindInfoReq(data, 3, range));
+    REQUIRE(!attDecodeReadByReq(data, 7, range));
+    REQUIRE(!attDecodeReadReq(true, data, 2, req));
+    REQUIRE(!attDecodeHandleValue(data, 1, req));
+    REQUIRE(!attDecodeError(data, 3, error));
+
+    // the start handle is still there for the error response
+    REQUIRE(!attDecodeReadByReq(data, 4, range));
+    REQUIRE(range.startHandle == 0x0005);
+  }
+
+  WHEN("Fuzz the decoders")
+  {
+    long accepted = 0;
+
+    for (int loop = 0; loop < 20000; loop++) {
+      uint8_t dlen = fuzzRandom() % 64;
+
+      // exact size, so reading past the end is caught by the address sanitizer
+      std::vector<uint8_t> pdu(dlen);
+      for (uint8_t i = 0; i < dlen; i++) pdu[i] = (uint8_t)fuzzRandom();
+      const uint8_t* data = pdu.data();
+
+      HCIAclHdr aclHdr;
+      if (hciDecodeAclHdr(data, dlen, aclHdr)) {
+        REQUIRE(HCI_ACL_HDR_SIZE + aclHdr.dlen <= dlen);
+        REQUIRE(aclHdr.handle <= 0x0fff);
+        accepted++;
+      }
+
+      L2CAPHdr l2capHdr;
+      if (l2capDecodeHdr(data, dlen, l2capHdr)) {
+        REQUIRE(dlen >= L2CAP_HDR_SIZE);
+        accepted++;
+      }
+
+      uint16_t mtu;
+      if (attDecodeMtu(data, dlen, mtu)) {
+        REQUIRE(dlen == 2);
+        accepted++;
+      }
+
+      ATTRangeReq range;
+      if (attDecodeFindInfoReq(data, dlen, range)) {
+        REQUIRE(dlen == 4);
+        accepted++;
+      }
+      if (attDecodeReadByReq(data, dlen, range)) {
+        REQUIRE(dlen == 6);
+        accepted++;
+      }
+      if (attDecodeFindByTypeReq(data, dlen, range)) {
+        REQUIRE(range.valueLength == dlen - 6);
+        REQUIRE(inside(range.value, range.valueLength, data, dlen));
+        accepted++;
+      }
+
+      ATTHandleReq req;
+      if (attDecodeReadReq(fuzzRandom() & 1, data, dlen, req)) {
+        REQUIRE((dlen == 2 || dlen == 4));
+        accepted++;
+      }
+      if (attDecodeHandleValue(data, dlen, req)) {
+        REQUIRE(req.valueLength == dlen - 2);
+        REQUIRE(inside(req.value, req.valueLength, data, dlen));
+        accepted++;
+      }
+      if (attDecodePrepWriteReq(data, dlen, req)) {
+        REQUIRE(req.valueLength == dlen - 4);
+        REQUIRE(inside(req.value, req.valueLength, data, dlen));
+        accepted++;
+      }
+
+      ATTErrorRsp error;
+      if (attDecodeError(data, dlen, error)) {
+        REQUIRE(dlen == 4);
+        accepted++;
+      }
+    }
+
+    REQUIRE(accepted > 0);
+  }
+}
+
+TEST_CASE("Decoder benchmark", "[ArduinoBLE::BLEPdu]")
+{
+  WHEN("Decode prepare write requests")
+  {
+    const int loops = 2000000;
+    uint8_t buf[8 + 1] = { 0 };
+    uint8_t* pdu = &buf[1];     // odd address, as in the receive buffer
+    uint32_t sum = 0;
+
+    struct __attribute__ ((packed)) PrepWriteReq {
+      uint16_t handle;
+      uint16_t offset;
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < loops; i++) {
+      leWrite16(pdu, (uint16_t)i);
+      PrepWriteReq* req = (PrepWriteReq*)pdu;
+      sum += req->handle + req->offset + (sizeof(buf) - 1 - sizeof(PrepWriteReq));
+    }
+    auto castTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+    uint32_t check = sum;
+    sum = 0;
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < loops; i++) {
+      leWrite16(pdu, (uint16_t)i);
+      ATTHandleReq req;
+      if (attDecodePrepWriteReq(pdu, sizeof(buf) - 1, req)) {
+        sum += req.handle + req.offset + req.valueLength;
+      }
+    }
+    auto readerTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+    printf("decoder benchmark : %d PDU's, packed struct %lld us, ByteReader %lld us\n",
+           loops, (long long)castTime, (long long)readerTime);
+
+    REQUIRE(sum == check);
+  }
+}
@@ -0,0 +1,110 @@
+/*
+  File backed flash device for the wsf_flash record store.
+
+  paulvha / October 2026
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "FileFlash.h"
+
+static FILE* _file = NULL;
+static uint32_t _blockSize;
+static std::vector<uint32_t> _eraseCount;
+static int _failAfter = -1;
+static int _failReadAfter = -1;
+
+static uint8_t fileFlashRead(uint32_t address, uint8_t* pBuf, uint32_t len)
+{
+  if (_failReadAfter == 0) return WSF_FLASH_FAILURE;
+  if (_failReadAfter > 0) _failReadAfter--;
+
+  if (fseek(_file, address, SEEK_SET) != 0) return WSF_FLASH_FAILURE;
+  return fread(pBuf, 1, len, _file) == len ? WSF_FLASH_SUCCESS : WSF_FLASH_FAILURE;
+}
+
+static uint8_t fileFlashProgram(uint32_t address, const uint8_t* pBuf, uint32_t len)
+{
+  std::vector<uint8_t> cur(len);
+
+  if (_failAfter == 0) return WSF_FLASH_FAILURE;
+  if (_failAfter > 0) _failAfter--;
+
+  if ((address | len) & 3) return WSF_FLASH_FAILURE;
+  if (fileFlashRead(address, cur.data(), len) != WSF_FLASH_SUCCESS) return WSF_FLASH_FAILURE;
+
+  // NOR : a bit can only go from 1 to 0
+  for (uint32_t i = 0; i < len; i++) cur[i] &= pBuf[i];
+
+  if (fseek(_file, address, SEEK_SET) != 0) return WSF_FLASH_FAILURE;
+  if (fwrite(cur.data(), 1, len, _file) != len) return WSF_FLASH_FAILURE;
+  fflush(_file);
+  return WSF_FLASH_SUCCESS;
+}
+
+static uint8_t fileFlashErase(uint16_t block)
+{
+  std::vector<uint8_t> blank(_blockSize, 0xFF);
+
+  if (block >= _eraseCount.size()) return WSF_FLASH_FAILURE;
+  if (fseek(_file, (long) block * _blockSize, SEEK_SET) != 0) return WSF_FLASH_FAILURE;
+  if (fwrite(blank.data(), 1, _blockSize, _file) != _blockSize) return WSF_FLASH_FAILURE;
+  fflush(_file);
+
+  _eraseCount[block]++;
+  return WSF_FLASH_SUCCESS;
+}
+
+static wsfFlashDev_t _dev;
+
+const wsfFlashDev_t* fileFlashOpen(const char* path, uint32_t blockSize, uint16_t numBlocks, bool erase)
+{
+  fileFlashClose();
+
+  _file = erase ? NULL : fopen(path, "r+b");
+
+  if (_file == NULL) {
+    _file = fopen(path, "w+b");
+    if (_file == NULL) return NULL;
+
+    std::vector<uint8_t> blank(blockSize, 0xFF);
+    for (uint16_t b = 0; b < numBlocks; b++) fwrite(blank.data(), 1, blockSize, _file);
+    fflush(_file);
+    _eraseCount.assign(numBlocks, 0);
+  }
+
+  _blockSize = blockSize;
+  if (_eraseCount.size() != numBlocks) _eraseCount.assign(numBlocks, 0);
+  _failAfter = -1;
+  _failReadAfter = -1;
+
+  _dev.blockSize = blockSize;
+  _dev.numBlocks = numBlocks;
+  _dev.read = fileFlashRead;
+  _dev.program = fileFlashProgram;
+  _dev.erase = fileFlashErase;
+  return &_dev;
+}
+
+void fileFlashClose()
+{
+  if (_file != NULL) fclose(_file);
+  _file = NULL;
+}
+
+uint32_t fileFlashEraseCount(uint16_t block)
+{
+  return block < _eraseCount.size() ? _eraseCount[block] : 0;
+}
+
+void fileFlashFailAfter(int count)
+{
+  _failAfter = count;
+}
+
+void fileFlashFailReadAfter(int count)
+{
+  _failReadAfter = count;
+}
@@ -0,0 +1,318 @@
+/*
+  Tests for the wsf_flash record store (ExactleP) and the flash key store of ArduinoBLE_P,
+  running on a file backed flash device.
+
+  paulvha / October 2026
+*/
+
+#include <catch.hpp>
+
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+#include "FileFlash.h"
+#include "FlashKeyStore.h"
+
+#define FLASH_FILE        "test_flash_store.bin"
+#define FLASH_BLOCK_SIZE  4096
+#define FLASH_BLOCKS      8
+
+static void makeBond(int n, uint8_t* address, uint8_t* key, uint8_t seed)
+{
+  for (int i = 0; i < 6; i++)  address[i] = (uint8_t) (0xC0 + i * 7 + n * 13 + (n >> 4));
+  address[5] = (uint8_t) n;
+  for (int i = 0; i < 16; i++) key[i] = (uint8_t) (seed + n + i * 3);
+}
+
+TEST_CASE("wsf_flash records", "[ExactleP::wsf_flash]")
+{
+  const wsfFlashDev_t* dev = fileFlashOpen(FLASH_FILE, FLASH_BLOCK_SIZE, FLASH_BLOCKS, true);
+  REQUIRE(dev != NULL);
+  REQUIRE(WsfFlashInit(dev) == WSF_FLASH_SUCCESS);
+
+  WHEN("Write, replace and delete a record")
+  {
+    uint8_t buf[32];
+    const uint8_t first[] = "first value";
+    const uint8_t second[] = "second, longer value";
+
+    REQUIRE(WsfFlashRead(WSF_FLASH_ID_USER_BASE, buf, sizeof(buf)) == 0);
+
+    REQUIRE(WsfFlashWrite(WSF_FLASH_ID_USER_BASE, first, sizeof(first)) == WSF_FLASH_SUCCESS);
+    REQUIRE(WsfFlashRead(WSF_FLASH_ID_USER_BASE, buf, sizeof(buf)) == sizeof(first));
+    REQUIRE(memcmp(buf, first, sizeof(first)) == 0);
+
+    REQUIRE(WsfFlashWrite(WSF_FLASH_ID_USER_BASE, second, sizeof(second)) == WSF_FLASH_SUCCESS);
+    REQUIRE(WsfFlashRead(WSF_FLASH_ID_USER_BASE, buf, sizeof(buf)) == sizeof(second));
+    REQUIRE(memcmp(buf, second, sizeof(second)) == 0);
+
+    REQUIRE(WsfFlashDelete(WSF_FLASH_ID_USER_BASE) == WSF_FLASH_SUCCESS);
+    REQUIRE(WsfFlashRead(WSF_FLASH_ID_USER_BASE, buf, sizeof(buf)) == 0);
+    REQUIRE(WsfFlashNextId(WSF_FLASH_ID_USER_BASE, 0xFFFE) == WSF_FLASH_ID_INVALID);
+  }
+
+  WHEN("Records survive a remount, deleted records stay deleted")
+  {
+    uint8_t buf[8];
+    uint8_t value[8];
+
+    for (uint16_t id = 0; id < 40; id++) {
+      memset(value, id, sizeof(value));
+      REQUIRE(WsfFlashWrite(WSF_FLASH_ID_USER_BASE + id, value, sizeof(value)) == WSF_FLASH_SUCCESS);
+    }
+    for (uint16_t id = 0; id < 40; id += 2) {
+      REQUIRE(WsfFlashDelete(WSF_FLASH_ID_USER_BASE + id) == WSF_FLASH_SUCCESS);
+    }
+
+    // force compaction several times, the tombstones must keep the old copies hidden
+    for (int loop = 0; loop < 2000; loop++) {
+      memset(value, loop, sizeof(value));
+      REQUIRE(WsfFlashWrite(WSF_FLASH_ID_USER_BASE + 100, value, sizeof(value)) == WSF_FLASH_SUCCESS);
+    }
+    REQUIRE(WsfFlashSync() == WSF_FLASH_SUCCESS);
+
+    dev = fileFlashOpen(FLASH_FILE, FLASH_BLOCK_SIZE, FLASH_BLOCKS, false);
+    REQUIRE(WsfFlashInit(dev) == WSF_FLASH_SUCCESS);
+
+    for (uint16_t id = 0; id < 40; id++) {
+      uint16_t len = WsfFlashRead(WSF_FLASH_ID_USER_BASE + id, buf, sizeof(buf));
+      if (id & 1) {
+        REQUIRE(len == sizeof(buf));
+        REQUIRE(buf[0] == id);
+      }
+      else {
+        REQUIRE(len == 0);
+      }
+    }
+
+    REQUIRE(WsfFlashRead(WSF_FLASH_ID_USER_BASE + 100, buf, sizeof(buf)) == sizeof(buf));
+    REQUIRE(buf[0] == (uint8_t) 1999);
+  }
+
+  WHEN("A write is interrupted by a reset")
+  {
+    uint8_t buf[16];
+    uint8_t value[16];
+
+    memset(value, 0x11, sizeof(value));
+    REQUIRE(WsfFlashWrite(WSF_FLASH_ID_USER_BASE, value, sizeof(value)) == WSF_FLASH_SUCCESS);
+    REQUIRE(WsfFlashSync() == WSF_FLASH_SUCCESS);
+
+    fileFlashFailAfter(0);
+    memset(value, 0x22, sizeof(value));
+    WsfFlashWrite(WSF_FLASH_ID_USER_BASE, value, sizeof(value));
+    REQUIRE(WsfFlashSync() == WSF_FLASH_FAILURE);
+
+    // reset : the old value is still there and the store is usable
+    dev = fileFlashOpen(FLASH_FILE, FLASH_BLOCK_SIZE, FLASH_BLOCKS, false);
+    REQUIRE(WsfFlashInit(dev) == WSF_FLASH_SUCCESS);
+    REQUIRE(WsfFlashRead(WSF_FLASH_ID_USER_BASE, buf, sizeof(buf)) == sizeof(buf));
+    REQUIRE(buf[0] == 0x11);
+
+    REQUIRE(WsfFlashWrite(WSF_FLASH_ID_USER_BASE, value, sizeof(value)) == WSF_FLASH_SUCCESS);
+    REQUIRE(WsfFlashRead(WSF_FLASH_ID_USER_BASE, buf, sizeof(buf)) == sizeof(buf));
+    REQUIRE(buf[0] == 0x22);
+  }
+
+  WHEN("A reset right after a compaction")
+  {
+    uint8_t buf[8];
+    uint8_t value[8];
+    wsfFlashStats_t stats;
+    uint32_t erases = 0;
+
+    for (uint16_t id = 0; id < 20; id++) {
+      memset(value, id, sizeof(value));
+      REQUIRE(WsfFlashWrite(WSF_FLASH_ID_USER_BASE + id, value, sizeof(value)) == WSF_FLASH_SUCCESS);
+    }
+    REQUIRE(WsfFlashSync() == WSF_FLASH_SUCCESS);
+
+    // reset without a sync after each erase, until the wear levelling has moved the block
+    // with these records as well
+    for (int loop = 0; erases < 20 * FLASH_BLOCKS; loop++) {
+      memset(value, loop, sizeof(value));
+      REQUIRE(WsfFlashWrite(WSF_FLASH_ID_USER_BASE + 100, value, sizeof(value)) == WSF_FLASH_SUCCESS);
+
+      WsfFlashGetStats(&stats);
+      if (stats.erases == 0) continue;
+
+      erases += stats.erases;
+      dev = fileFlashOpen(FLASH_FILE, FLASH_BLOCK_SIZE, FLASH_BLOCKS, false);
+      REQUIRE(WsfFlashInit(dev) == WSF_FLASH_SUCCESS);
+
+      for (uint16_t id = 0; id < 20; id++) {
+        REQUIRE(WsfFlashRead(WSF_FLASH_ID_USER_BASE + id, buf, sizeof(buf)) == sizeof(buf));
+        REQUIRE(buf[0] == id);
+      }
+    }
+  }
+
+  WHEN("The device fails a read while mounting")
+  {
+    uint8_t value[16];
+
+    memset(value, 0x33, sizeof(value));
+    REQUIRE(WsfFlashWrite(WSF_FLASH_ID_USER_BASE, value, sizeof(value)) == WSF_FLASH_SUCCESS);
+    REQUIRE(WsfFlashSync() == WSF_FLASH_SUCCESS);
+
+    // after the block headers, the record scan does not take a failed read as data
+    dev = fileFlashOpen(FLASH_FILE, FLASH_BLOCK_SIZE, FLASH_BLOCKS, false);
+    fileFlashFailReadAfter(FLASH_BLOCKS + 1);
+    REQUIRE(WsfFlashInit(dev) == WSF_FLASH_FAILURE);
+    REQUIRE(WsfFlashWrite(WSF_FLASH_ID_USER_BASE, value, sizeof(value)) == WSF_FLASH_FAILURE);
+
+    fileFlashFailReadAfter(-1);
+    REQUIRE(WsfFlashInit(dev) == WSF_FLASH_SUCCESS);
+    REQUIRE(WsfFlashRead(WSF_FLASH_ID_USER_BASE, value, sizeof(value)) == sizeof(value));
+  }
+
+  WHEN("Used as media for the WSF embedded file system")
+  {
+    uint8_t data[200];
+    uint8_t buf[200];
+
+    for (unsigned i = 0; i < sizeof(data); i++) data[i] = (uint8_t) (i * 7);
+
+    REQUIRE(WsfFlashEfsMedia.init() == WSF_EFS_SUCCESS);
+    REQUIRE(WsfFlashEfsMedia.write(data, 100, sizeof(data)) == WSF_EFS_SUCCESS);
+
+    REQUIRE(WsfFlashEfsMedia.read(buf, 100, sizeof(buf)) == WSF_EFS_SUCCESS);
+    REQUIRE(memcmp(buf, data, sizeof(data)) == 0);
+
+    // not written is erased flash
+    REQUIRE(WsfFlashEfsMedia.read(buf, 1000, 4) == WSF_EFS_SUCCESS);
+    REQUIRE(buf[0] == 0xFF);
+
+    REQUIRE(WsfFlashEfsMedia.erase(0, WSF_FLASH_EFS_PAGE_SIZE * 8) == WSF_EFS_SUCCESS);
+    REQUIRE(WsfFlashEfsMedia.read(buf, 100, sizeof(buf)) == WSF_EFS_SUCCESS);
+    REQUIRE(buf[0] == 0xFF);
+    REQUIRE(buf[sizeof(buf) - 1] == 0xFF);
+  }
+
+  fileFlashClose();
+  remove(FLASH_FILE);
+}
+
+TEST_CASE("Flash key store", "[ArduinoBLE::FlashKeyStore]")
+{
+  const wsfFlashDev_t* dev = fileFlashOpen(FLASH_FILE, FLASH_BLOCK_SIZE, FLASH_BLOCKS, true);
+  REQUIRE(flashKeyStoreBegin(dev));
+
+  WHEN("Store and retrieve many bonds")
+  {
+    const int bonds = FLASH_KEY_STORE_MAX_BONDS;
+    uint8_t address[6];
+    uint8_t key[16];
+    uint8_t out[16];
+
+    for (int n = 0; n < bonds; n++) {
+      makeBond(n, address, key, 0x10);
+      REQUIRE(flashKeyStoreStoreLTK(address, key) == 1);
+      makeBond(n, address, key, 0x80);
+      REQUIRE(flashKeyStoreStoreIdentity(address, n & 1, key) == 1);
+    }
+    REQUIRE(flashKeyStoreCount() == bonds);
+
+    // full : a new peer is refused, the index has room left for other records
+    makeBond(bonds, address, key, 0x10);
+    REQUIRE(flashKeyStoreStoreLTK(address, key) == 0);
+    REQUIRE(WsfFlashWrite(WSF_FLASH_ID_USER_BASE, key, sizeof(key)) == WSF_FLASH_SUCCESS);
+
+    // re-pairing : new keys for the same peers, enough to compact every block several times
+    const int loops = 100;
+    for (int loop = 0; loop < loops; loop++) {
+      for (int n = 0; n < bonds; n++) {
+        makeBond(n, address, key, (uint8_t) (0x20 + loop));
+        REQUIRE(flashKeyStoreStoreLTK(address, key) == 1);
+      }
+    }
+
+    wsfFlashStats_t stats;
+    WsfFlashGetStats(&stats);
+
+    double amplification = (double) stats.programBytes / stats.userBytes;
+    printf("flash key store : %d bonds, user %u bytes, programmed %u bytes, amplification %.2f\n",
+           bonds, stats.userBytes, stats.programBytes, amplification);
+    const int updates = 2 * bonds + loops * bonds;
+    printf("flash key store : %d bond updates, %.1f bytes programmed per update\n",
+           updates, (double) stats.programBytes / updates);
+    printf("flash key store : %u erases, erase count %u - %u\n",
+           stats.erases, stats.minEraseCount, stats.maxEraseCount);
+
+    // record header and padding, plus moving live data during compaction
+    REQUIRE(amplification < 4.0);
+    REQUIRE(stats.maxEraseCount - stats.minEraseCount <= WSF_FLASH_WEAR_DELTA + 1);
+
+    // lookups are done on the RAM index
+    auto start = std::chrono::steady_clock::now();
+    for (int n = 0; n < bonds; n++) {
+      makeBond(n, address, key, (uint8_t) (0x20 + loops - 1));
+      REQUIRE(flashKeyStoreGetLTK(address, out) == 1);
+      REQUIRE(memcmp(out, key, 16) == 0);
+    }
+    auto usec = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    printf("flash key store : %d lookups in %lld us, %.2f us per lookup\n", bonds, (long long) usec,
+           (double) usec / bonds);
+
+    // and all is back after a reset
+    dev = fileFlashOpen(FLASH_FILE, FLASH_BLOCK_SIZE, FLASH_BLOCKS, false);
+    REQUIRE(flashKeyStoreBegin(dev));
+    REQUIRE(flashKeyStoreCount() == bonds);
+
+    uint8_t nIRKs = 0;
+    uint8_t* BDAddrType = 0;
+    uint8_t** BDAddrs = 0;
+    uint8_t** IRKs = 0;
+
+    REQUIRE(flashKeyStoreGetIRKs(&nIRKs, &BDAddrType, &BDAddrs, &IRKs) == 1);
+    REQUIRE(nIRKs == bonds);
+
+    for (int i = 0; i < nIRKs; i++) {
+      makeBond(BDAddrs[i][5], address, key, 0x80);
+      REQUIRE(memcmp(BDAddrs[i], address, 6) == 0);
+      REQUIRE(BDAddrType[i] == (BDAddrs[i][5] & 1));
+      REQUIRE(memcmp(IRKs[i], key, 16) == 0);
+      delete[] BDAddrs[i];
+      delete[] IRKs[i];
+    }
+    delete[] BDAddrType;
+    delete[] BDAddrs;
+    delete[] IRKs;
+  }
+
+  WHEN("Remove bonds")
+  {
+    uint8_t address[6];
+    uint8_t key[16];
+    uint8_t out[16];
+
+    for (int n = 0; n < 5; n++) {
+      makeBond(n, address, key, 0x10);
+      REQUIRE(flashKeyStoreStoreLTK(address, key) == 1);
+    }
+
+    makeBond(2, address, key, 0x10);
+    REQUIRE(flashKeyStoreRemove(address) == 1);
+    REQUIRE(flashKeyStoreGetLTK(address, out) == 0);
+    REQUIRE(flashKeyStoreCount() == 4);
+
+    // the id of a removed bond is used again, its tombstone takes no extra index entry
+    for (int loop = 0; loop < 3 * FLASH_KEY_STORE_MAX_BONDS; loop++) {
+      makeBond(100 + loop, address, key, 0x10);
+      REQUIRE(flashKeyStoreStoreLTK(address, key) == 1);
+      REQUIRE(flashKeyStoreRemove(address) == 1);
+    }
+    REQUIRE(flashKeyStoreCount() == 4);
+
+    REQUIRE(flashKeyStoreRemoveAll() == 1);
+    REQUIRE(flashKeyStoreCount() == 0);
+
+    dev = fileFlashOpen(FLASH_FILE, FLASH_BLOCK_SIZE, FLASH_BLOCKS, false);
+    REQUIRE(flashKeyStoreBegin(dev));
+    REQUIRE(flashKeyStoreCount() == 0);
+  }
+
+  fileFlashClose();
+  remove(FLASH_FILE);
+}
@@ -0,0 +1,255 @@
+/*
+  Tests for the HCI write queue of the exactleP Apollo3 driver
+  (exactleP/sw/hci/ambiq/hci_drv_write_queue.c).
+
+  MockBus plays the controller side of hci_drv_apollo3: after wake it takes a transfer from the
+  queue (status interrupt), the transfer takes time on the bus and completes (write callback).
+  The controller splits the received bytes on the HCI headers and checks that every packet
+  arrives once, in order and unchanged. The tests report transfers per packet for a burst of
+  ATT notifications, without and with coalescing.
+
+  paulvha / October 2026
+*/
+
+#include <catch.hpp>
+
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <vector>
+
+#include "hci_drv_write_queue.h"
+
+#define HCI_CMD_TYPE    0x01
+#define HCI_ACL_TYPE    0x02
+
+struct MockBus {
+  hci_drv_wq_t queue;
+
+  // bus timing in ticks of 1 us : wake / status handshake and clock per byte (8 MHz SPI)
+  uint32_t handshake = 40;
+  double perByte = 1.0;
+
+  uint64_t now = 0;
+  uint64_t busyUntil = 0;
+  bool busy = false;
+
+  uint32_t transfers = 0;
+  uint32_t maxTransfer = 0;
+  std::vector<std::vector<uint8_t>> received;
+  bool streamError = false;
+
+  // the controller is ready and takes the next transfer
+  void start()
+  {
+    uint32_t* data;
+    uint32_t len = HciDrvWqStart(&queue, &data);
+
+    if (len == 0) return;
+
+    parse((const uint8_t*)data, len);
+    transfers++;
+    if (len > maxTransfer) maxTransfer = len;
+    busy = true;
+    busyUntil = now + handshake + (uint64_t)(len * perByte);
+  }
+
+  // split the HCI stream on the packet headers
+  void parse(const uint8_t* p, uint32_t len)
+  {
+    while (len > 0) {
+      uint32_t pktLen;
+
+      if (p[0] == HCI_CMD_TYPE && len >= 4) pktLen = 4 + p[3];
+      else if (p[0] == HCI_ACL_TYPE && len >= 5) pktLen = 5 + (p[3] | (p[4] << 8));
+      else pktLen = len + 1;
+
+      if (pktLen > len) {
+        streamError = true;
+        return;
+      }
+
+      received.push_back(std::vector<uint8_t>(p, p + pktLen));
+      p += pktLen;
+      len -= pktLen;
+    }
+  }
+
+  // advance the time, complete and start transfers
+  void run(uint64_t until)
+  {
+    while (now < until) {
+      if (busy && now >= busyUntil) {
+        HciDrvWqDone(&queue);
+        busy = false;
+      }
+      if (!busy && !HciDrvWqEmpty(&queue)) start();
+      now++;
+    }
+  }
+
+  void flush()
+  {
+    while (busy || !HciDrvWqEmpty(&queue)) run(now + 1);
+  }
+};
+
+// ACL packet with an ATT notification, as hciDrvWrite gets it (without the type byte)
+static std::vector<uint8_t> notification(uint16_t seq, uint8_t valueLen)
+{
+  std::vector<uint8_t> pkt;
+  uint16_t l2capLen = 3 + valueLen;
+
+  pkt.push_back(0x40); pkt.push_back(0x00);                              // handle
+  pkt.push_back((uint8_t)(l2capLen + 4)); pkt.push_back(0x00);           // ACL length
+  pkt.push_back((uint8_t)l2capLen); pkt.push_back(0x00);                 // L2CAP length
+  pkt.push_back(0x04); pkt.push_back(0x00);                              // ATT channel
+  pkt.push_back(0x1B); pkt.push_back(0x12); pkt.push_back(0x00);         // notify, handle
+  for (uint8_t i = 0; i < valueLen; i++) pkt.push_back((uint8_t)(seq + i));
+  return pkt;
+}
+
+// send a burst of notifications as a sketch does in a loop : the stack queues a packet
+// every gap us, and waits for a slot when the queue is full
+static double runBurst(MockBus& bus, uint32_t maxBatch, uint32_t count, uint32_t gap,
+                       std::vector<std::vector<uint8_t>>& sent)
+{
+  HciDrvWqInit(&bus.queue, maxBatch);
+
+  for (uint32_t i = 0; i < count; i++) {
+    std::vector<uint8_t> pkt = notification((uint16_t)i, 20);
+
+    while (HciDrvWqPut(&bus.queue, HCI_ACL_TYPE, (uint16_t)pkt.size(), pkt.data()) == HCI_DRV_WQ_FULL) {
+      bus.run(bus.now + 1);
+    }
+
+    pkt.insert(pkt.begin(), HCI_ACL_TYPE);
+    sent.push_back(pkt);
+    bus.run(bus.now + gap);
+  }
+
+  bus.flush();
+  return (double)bus.transfers / count;
+}
+
+TEST_CASE("HCI write queue", "[exactleP::hci_drv_write_queue]")
+{
+  MockBus bus;
+  HciDrvWqInit(&bus.queue, 0);
+
+  WHEN("Packets are sent one per transfer")
+  {
+    const uint8_t reset[] = { 0x03, 0x0C, 0x00 };
+    const uint8_t le[] = { 0x01, 0x20, 0x08, 1, 2, 3, 4, 5, 6, 7, 8 };
+
+    REQUIRE(HciDrvWqEmpty(&bus.queue));
+    REQUIRE(HciDrvWqPut(&bus.queue, HCI_CMD_TYPE, sizeof(reset), reset) == HCI_DRV_WQ_SUCCESS);
+    REQUIRE(HciDrvWqPut(&bus.queue, HCI_CMD_TYPE, sizeof(le), le) == HCI_DRV_WQ_SUCCESS);
+    REQUIRE(!HciDrvWqEmpty(&bus.queue));
+
+    uint32_t* data;
+    REQUIRE(HciDrvWqStart(&bus.queue, &data) == sizeof(reset) + 1);
+    REQUIRE(((uint8_t*)data)[0] == HCI_CMD_TYPE);
+    REQUIRE(memcmp((uint8_t*)data + 1, reset, sizeof(reset)) == 0);
+
+    // not done yet : the same transfer again
+    REQUIRE(HciDrvWqStart(&bus.queue, &data) == sizeof(reset) + 1);
+    HciDrvWqDone(&bus.queue);
+
+    REQUIRE(HciDrvWqStart(&bus.queue, &data) == sizeof(le) + 1);
+    HciDrvWqDone(&bus.queue);
+    REQUIRE(HciDrvWqEmpty(&bus.queue));
+    REQUIRE(HciDrvWqStart(&bus.queue, &data) == 0);
+    REQUIRE(bus.queue.sStats.ui32Transfers == 2);
+  }
+
+  WHEN("The queue is full or the packet too large")
+  {
+    uint8_t big[HCI_DRV_WQ_MAX_PACKET] = { 0 };
+
+    REQUIRE(HciDrvWqPut(&bus.queue, HCI_ACL_TYPE, HCI_DRV_WQ_MAX_PACKET, big) == HCI_DRV_WQ_TOO_LARGE);
+    REQUIRE(HciDrvWqPut(&bus.queue, HCI_ACL_TYPE, HCI_DRV_WQ_MAX_PACKET - 1, big) == HCI_DRV_WQ_SUCCESS);
+
+    for (int i = 1; i < HCI_DRV_WQ_NUM_PACKETS; i++) {
+      REQUIRE(HciDrvWqPut(&bus.queue, HCI_ACL_TYPE, 10, big) == HCI_DRV_WQ_SUCCESS);
+    }
+    REQUIRE(HciDrvWqPut(&bus.queue, HCI_ACL_TYPE, 10, big) == HCI_DRV_WQ_FULL);
+    REQUIRE(bus.queue.sStats.ui32Full == 1);
+    REQUIRE(bus.queue.sStats.ui32Packets == HCI_DRV_WQ_NUM_PACKETS);
+  }
+
+  WHEN("Waiting packets are coalesced up to the limit")
+  {
+    const uint8_t value[40] = { 0 };
+    HciDrvWqSetBatch(&bus.queue, 100);
+
+    for (int i = 0; i < 5; i++) {
+      REQUIRE(HciDrvWqPut(&bus.queue, HCI_ACL_TYPE, sizeof(value), value) == HCI_DRV_WQ_SUCCESS);
+    }
+
+    uint32_t* data;
+    REQUIRE(HciDrvWqStart(&bus.queue, &data) == 2 * (sizeof(value) + 1));
+    HciDrvWqDone(&bus.queue);
+    REQUIRE(HciDrvWqStart(&bus.queue, &data) == 2 * (sizeof(value) + 1));
+    HciDrvWqDone(&bus.queue);
+
+    // the last one is sent from its slot
+    REQUIRE(HciDrvWqStart(&bus.queue, &data) == sizeof(value) + 1);
+    REQUIRE(data == bus.queue.psPackets[4].pui32Data);
+    HciDrvWqDone(&bus.queue);
+
+    REQUIRE(HciDrvWqEmpty(&bus.queue));
+    REQUIRE(bus.queue.sStats.ui32MaxPerTransfer == 2);
+  }
+
+  WHEN("The queue is emptied the statistics stay")
+  {
+    const uint8_t value[10] = { 0 };
+    uint32_t* data;
+
+    REQUIRE(HciDrvWqPut(&bus.queue, HCI_ACL_TYPE, sizeof(value), value) == HCI_DRV_WQ_SUCCESS);
+    REQUIRE(HciDrvWqStart(&bus.queue, &data) == sizeof(value) + 1);
+    HciDrvWqDone(&bus.queue);
+    REQUIRE(HciDrvWqPut(&bus.queue, HCI_ACL_TYPE, sizeof(value), value) == HCI_DRV_WQ_SUCCESS);
+    REQUIRE(HciDrvWqStart(&bus.queue, &data) == sizeof(value) + 1);
+
+    HciDrvWqReset(&bus.queue);
+
+    REQUIRE(HciDrvWqEmpty(&bus.queue));
+    REQUIRE(HciDrvWqStart(&bus.queue, &data) == 0);
+    REQUIRE(bus.queue.sStats.ui32Packets == 2);
+    REQUIRE(bus.queue.sStats.ui32Transfers == 1);
+  }
+}
+
+TEST_CASE("HCI write queue on a mock bus", "[exactleP::hci_drv_write_queue]")
+{
+  const uint32_t count = 2000;
+
+  for (uint32_t gap : { 5u, 20u, 200u }) {
+    MockBus single, batched;
+    std::vector<std::vector<uint8_t>> sentSingle, sentBatched;
+
+    double perPacketSingle = runBurst(single, 0, count, gap, sentSingle);
+    double perPacketBatched = runBurst(batched, 512, count, gap, sentBatched);
+
+    printf("hci write queue : notification every %3u us, transfers per packet %.2f single, "
+           "%.2f coalesced (max %u bytes), %.1f / %.1f ms\n",
+           (unsigned)gap, perPacketSingle, perPacketBatched, (unsigned)batched.maxTransfer,
+           single.now / 1000.0, batched.now / 1000.0);
+
+    REQUIRE(!single.streamError);
+    REQUIRE(!batched.streamError);
+    REQUIRE(single.received == sentSingle);
+    REQUIRE(batched.received == sentBatched);
+    REQUIRE(perPacketSingle == 1.0);
+    REQUIRE(perPacketBatched <= perPacketSingle);
+    REQUIRE(batched.maxTransfer <= 512);
+    REQUIRE(batched.now <= single.now);
+
+    // when the stack is faster than the bus, packets pile up and get coalesced
+    if (gap < single.handshake) {
+      REQUIRE(perPacketBatched < 0.5);
+    }
+  }
+}
@@ -0,0 +1,194 @@
+/*
+  Tests for the lock free packet ring (exactleP/ws-core/sw/util/pkt_ring.c) between the HCI
+  driver read interrupt and the host.
+
+  The stress test runs the producer and the consumer in their own thread, as the interrupt and
+  the dispatcher on the Apollo3. Every packet carries a sequence number and a checksum, the
+  consumer checks that no packet is changed or out of order and that every packet that was
+  not dropped arrives. Run with -fsanitize=thread to check the memory ordering.
+
+  paulvha / October 2026
+*/
+
+#include <catch.hpp>
+
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <atomic>
+#include <thread>
+
+#include "pkt_ring.h"
+
+// small fixed seed generator, so a failure can be repeated
+static uint32_t ringRandom(uint32_t& state)
+{
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+// packet : sequence number (4 bytes), data, checksum (1 byte)
+static uint16_t makePacket(uint8_t* buf, uint32_t seq, uint16_t len)
+{
+  uint8_t sum = 0;
+
+  memcpy(buf, &seq, 4);
+  for (uint16_t i = 4; i < len - 1; i++) buf[i] = (uint8_t)(seq * 7 + i);
+  for (uint16_t i = 0; i < len - 1; i++) sum += buf[i];
+  buf[len - 1] = (uint8_t)~sum;
+  return len;
+}
+
+static bool checkPacket(const uint8_t* buf, uint16_t len, uint32_t& seq)
+{
+  uint8_t sum = 0;
+
+  for (uint16_t i = 0; i < len; i++) sum += buf[i];
+  memcpy(&seq, buf, 4);
+  return sum == 0xFF;
+}
+
+TEST_CASE("Packet ring", "[exactleP::pkt_ring]")
+{
+  uint8_t storage[64];
+  uint8_t buf[64];
+  pktRing_t ring;
+
+  PktRingInit(&ring, storage, sizeof(storage));
+
+  WHEN("Store and remove packets")
+  {
+    const uint8_t a[] = { 0x04, 0x0E, 0x01 };
+    const uint8_t b[] = { 0x02, 0x40, 0x00, 0x05 };
+
+    REQUIRE(PktRingPeekLen(&ring) == 0);
+    REQUIRE(PktRingGet(&ring, buf, sizeof(buf)) == 0);
+    REQUIRE(PktRingSpace(&ring) == sizeof(storage));
+
+    REQUIRE(PktRingPut(&ring, a, sizeof(a)) == sizeof(a));
+    REQUIRE(PktRingPut(&ring, b, sizeof(b)) == sizeof(b));
+    REQUIRE(PktRingSpace(&ring) == sizeof(storage) - sizeof(a) - sizeof(b) - 2 * PKT_RING_HDR_LEN);
+
+    REQUIRE(PktRingPeekLen(&ring) == sizeof(a));
+    REQUIRE(PktRingGet(&ring, buf, sizeof(buf)) == sizeof(a));
+    REQUIRE(memcmp(buf, a, sizeof(a)) == 0);
+    REQUIRE(PktRingGet(&ring, buf, sizeof(buf)) == sizeof(b));
+    REQUIRE(memcmp(buf, b, sizeof(b)) == 0);
+    REQUIRE(PktRingPeekLen(&ring) == 0);
+    REQUIRE(ring.packets == 2);
+  }
+
+  WHEN("Packets wrap around the end of the buffer")
+  {
+    uint8_t pkt[23];
+    uint32_t seq;
+
+    for (uint32_t i = 0; i < 100; i++) {
+      makePacket(pkt, i, sizeof(pkt));
+      REQUIRE(PktRingPut(&ring, pkt, sizeof(pkt)) == sizeof(pkt));
+      REQUIRE(PktRingGet(&ring, buf, sizeof(buf)) == sizeof(pkt));
+      REQUIRE(checkPacket(buf, sizeof(pkt), seq));
+      REQUIRE(seq == i);
+    }
+  }
+
+  WHEN("The ring is full")
+  {
+    uint8_t pkt[30] = { 0 };
+
+    REQUIRE(PktRingPut(&ring, pkt, sizeof(pkt)) == sizeof(pkt));
+    REQUIRE(PktRingPut(&ring, pkt, sizeof(pkt)) == sizeof(pkt));
+    REQUIRE(PktRingSpace(&ring) == 0);
+    REQUIRE(PktRingPut(&ring, pkt, 1) == 0);
+    REQUIRE(PktRingPut(&ring, pkt, 0) == 0);
+    REQUIRE(ring.dropped == 1);
+    REQUIRE(ring.droppedBytes == 1);
+    REQUIRE(ring.highWater == sizeof(storage));
+  }
+
+  WHEN("The consumer buffer is too small")
+  {
+    uint8_t pkt[20] = { 0 };
+
+    pkt[0] = 0x55;
+    REQUIRE(PktRingPut(&ring, pkt, sizeof(pkt)) == sizeof(pkt));
+    REQUIRE(PktRingPut(&ring, pkt, 2) == 2);
+    REQUIRE(PktRingGet(&ring, buf, 8) == 8);
+    REQUIRE(buf[0] == 0x55);
+    REQUIRE(ring.truncated == 1);
+
+    // the rest of the truncated packet is skipped
+    REQUIRE(PktRingGet(&ring, buf, 8) == 2);
+    REQUIRE(PktRingPeekLen(&ring) == 0);
+  }
+}
+
+TEST_CASE("Packet ring between two threads", "[exactleP::pkt_ring]")
+{
+  WHEN("A producer and a consumer run at the same time")
+  {
+    const uint32_t count = 1000000;
+    static uint8_t storage[2048];
+    pktRing_t ring;
+    std::atomic<bool> done(false);
+    uint32_t sent = 0;
+
+    PktRingInit(&ring, storage, sizeof(storage));
+
+    std::thread producer([&]() {
+      uint32_t state = 0x2545F491;
+      uint8_t pkt[256];
+
+      for (sent = 0; sent < count; sent++) {
+        uint16_t len = 6 + ringRandom(state) % (sizeof(pkt) - 6);
+
+        // as the driver : wait for room before starting a read (backpressure), but
+        // every 8th packet is stored at once and dropped when the ring is full
+        if (sent % 8 != 0) {
+          while (PktRingSpace(&ring) < (uint32_t)len + PKT_RING_HDR_LEN) std::this_thread::yield();
+        }
+        PktRingPut(&ring, pkt, makePacket(pkt, sent, len));
+      }
+      done = true;
+    });
+
+    uint8_t buf[256];
+    uint32_t received = 0;
+    uint32_t bad = 0;
+    uint32_t outOfOrder = 0;
+    int64_t last = -1;
+
+    for (;;) {
+      bool finished = done;
+      uint16_t len = PktRingGet(&ring, buf, sizeof(buf));
+
+      if (len == 0) {
+        if (finished) break;
+        std::this_thread::yield();
+        continue;
+      }
+
+      uint32_t seq;
+      if (!checkPacket(buf, len, seq)) bad++;
+      else if ((int64_t)seq <= last) outOfOrder++;
+      else last = seq;
+      received++;
+    }
+
+    producer.join();
+
+    printf("packet ring : %u packets, %u received, %u dropped, high water %u of %u bytes\n",
+           (unsigned)sent, (unsigned)received, (unsigned)ring.dropped,
+           (unsigned)ring.highWater, (unsigned)sizeof(storage));
+
+    REQUIRE(bad == 0);
+    REQUIRE(outOfOrder == 0);
+    REQUIRE(ring.truncated == 0);
+    REQUIRE(received == ring.packets);
+    REQUIRE(received + ring.dropped == count);
+    REQUIRE(ring.dropped <= count / 8);
+    REQUIRE(ring.highWater <= sizeof(storage));
+  }
+}
@@ -276,6 +276,41 @@ uint16_t BLEDevice::readMTU()
   return(ATT.mtu(handle)-3);
 }
 
+// special paulvha : a central updates the connection itself, a peripheral asks the central
+bool BLEDevice::updateConnection(uint16_t minInterval, uint16_t maxInterval, uint16_t latency, uint16_t supervisionTimeout)
+{
+  uint16_t handle = ATT.connectionHandle(_addressType, _address);
+
+  if (handle == 0xffff) return false;
+
+  if (ATT.role(handle) == 0x00) {
+    return HCI.leConnUpdate(handle, minInterval, maxInterval, latency, supervisionTimeout) == 0;
+  }
+
+  return L2CAPSignaling.connectionParameterRequest(handle, minInterval, maxInterval, latency, supervisionTimeout) == 0;
+}
+
+// special paulvha
+bool BLEDevice::setPhy(uint8_t phy)
+{
+  uint16_t handle = ATT.connectionHandle(_addressType, _address);
+  uint8_t phys = phy == 2 ? 0x02 : 0x01;
+
+  if (handle == 0xffff) return false;
+
+  return HCI.leSetPhy(handle, phys, phys) == 0;
+}
+
+// special paulvha
+bool BLEDevice::setDataLength(uint16_t octets)
+{
+  uint16_t handle = ATT.connectionHandle(_addressType, _address);
+
+  if (handle == 0xffff) return false;
+
+  return HCI.leSetDataLength(handle, octets) == 0;
+}
+
 bool BLEDevice::connect()
 {
   return ATT.connect(_addressType, _address);
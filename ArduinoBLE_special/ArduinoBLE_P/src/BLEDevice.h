@@ -70,6 +70,12 @@ public:
   virtual int rssi();
   uint16_t readMTU(); // paulvha
 
+  // special paulvha : change the connection while connected, October 2026.
+  // interval in 1.25 ms units, timeout in 10 ms units, phy 1 (1M) or 2 (2M), octets 27 - 251
+  bool updateConnection(uint16_t minInterval, uint16_t maxInterval, uint16_t latency, uint16_t supervisionTimeout);
+  bool setPhy(uint8_t phy);
+  bool setDataLength(uint16_t octets);
+
   bool connect();
   bool discoverAttributes();
   bool discoverService(const char* serviceUuid);
@@ -22,6 +22,7 @@
 #include "utility/GAP.h"
 #include "utility/GATT.h"
 #include "utility/L2CAPSignaling.h"
+#include "utility/FlashKeyStore.h"
 
 #include "BLELocalDevice.h"
 
@@ -465,6 +466,27 @@ void BLELocalDevice::setStoreLTK(int (*storeLTK)(uint8_t*, uint8_t*)){
 void BLELocalDevice::setStoreIRK(int (*storeIRK)(uint8_t*, uint8_t*)){
   HCI._storeIRK = storeIRK;
 }
+// special paulvha : bonds in flash with the wsf_flash store of ExactleP, October 2026
+bool BLELocalDevice::setFlashKeyStore(bool enable)
+{
+#ifdef BLE_FLASH_KEY_STORE
+  if (enable) {
+    HCI._storeIRK = flashKeyStoreStoreIRK;
+    HCI._getIRKs  = flashKeyStoreGetIRKs;
+    HCI._storeLTK = flashKeyStoreStoreLTK;
+    HCI._getLTK   = flashKeyStoreGetLTK;
+  }
+  else if (HCI._storeIRK == flashKeyStoreStoreIRK) {
+    HCI._storeIRK = 0;
+    HCI._getIRKs  = 0;
+    HCI._storeLTK = 0;
+    HCI._getLTK   = 0;
+  }
+  return true;
+#else
+  return false;
+#endif
+}
 void BLELocalDevice::setDisplayCode(void (*displayCode)(uint32_t confirmationCode)){
   HCI._displayCode = displayCode;
 }
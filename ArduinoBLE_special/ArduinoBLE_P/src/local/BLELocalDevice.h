@@ -117,6 +117,9 @@ public:
   // address - The mac address needing its LTK
   // LTK - 16 octet LTK for the mac address
   virtual void setGetLTK(int (*getLTK)(uint8_t* address, uint8_t* LTK));
+  // keep bonds in flash (Apollo3 V1 only, 0xF4000 - 0xFBFFF is erased on first use), call before
+  // begin(). Sets or clears the 4 callbacks above. Returns false if not available. paulvha October 2026
+  virtual bool setFlashKeyStore(bool enable);
 
   virtual void setDisplayCode(void (*displayCode)(uint32_t confirmationCode));
   virtual void setBinaryConfirmPairing(bool (*binaryConfirmPairing)());
@@ -33,6 +33,7 @@
 #include "BLEProperty.h"
 
 #include "ATT.h"
+#include "BLEPdu.h"
 
 #define ATT_OP_ERROR              0x01
 #define ATT_OP_MTU_REQ            0x02
@@ -300,6 +301,10 @@ void ATTClass::addConnection(uint16_t handle, uint8_t role, uint8_t peerBdaddrTy
 
 void ATTClass::handleData(uint16_t connectionHandle, uint8_t dlen, uint8_t data[])
 {
+  if (dlen == 0) {
+    return; // no opcode, drop
+  }
+
   uint8_t opcode = data[0];
 
   dlen--;
@@ -563,6 +568,18 @@ uint16_t ATTClass::mtu(uint16_t handle) const
   return 23;
 }
 
+// special paulvha : 0x00 we are central, 0x01 we are peripheral, 0xff not connected
+uint8_t ATTClass::role(uint16_t handle) const
+{
+  for (int i = 0; i < ATT_MAX_PEERS; i++) {
+    if (_peers[i].connectionHandle == handle) {
+      return _peers[i].role;
+    }
+  }
+
+  return 0xff;
+}
+
 bool ATTClass::disconnect()
 {
   int numDisconnects = 0;
@@ -680,18 +697,14 @@ bool ATTClass::handleInd(uint16_t handle, const uint8_t* value, int length)
 
 void ATTClass::error(uint16_t connectionHandle, uint8_t dlen, uint8_t data[])
 {
-  if (dlen != 4) {
+  ATTErrorRsp attError;
+
+  if (!attDecodeError(data, dlen, attError)) {
     // drop
     return;
   }
 
-  struct __attribute__ ((packed)) AttError {
-    uint8_t opcode;
-    uint16_t handle;
-    uint8_t code;
-  } *attError = (AttError*)data;
-
-  if (_pendingResp.connectionHandle == connectionHandle && (_pendingResp.op - 1) == attError->opcode) {
+  if (_pendingResp.connectionHandle == connectionHandle && (_pendingResp.op - 1) == attError.opcode) {
     _pendingResp.buffer[0] = ATT_OP_ERROR;
     memcpy(&_pendingResp.buffer[1], data, dlen);
     _pendingResp.length = dlen + 1;
@@ -702,9 +715,9 @@ void ATTClass::error(uint16_t connectionHandle, uint8_t dlen, uint8_t data[])
 // remote is Client / Central, we are peripheral / server
 void ATTClass::mtuReq(uint16_t connectionHandle, uint8_t dlen, uint8_t data[])
 {
-  uint16_t mtu = *(uint16_t*)data;
+  uint16_t mtu;
 
-  if (dlen != 2 ) {
+  if (!attDecodeMtu(data, dlen, mtu)) {
     sendError(connectionHandle, ATT_OP_MTU_REQ, 0x0000, ATT_ECODE_INVALID_PDU);
     return;
   }
@@ -744,9 +757,9 @@ int ATTClass::mtuReq(uint16_t connectionHandle, uint16_t mtu, uint8_t responseBu
 // we are Client / Central. peripheral / server should NOT expect this.
 void ATTClass::mtuResp(uint16_t connectionHandle, uint8_t dlen, uint8_t data[])
 {
-  uint16_t mtu = *(uint16_t*)data;
+  uint16_t mtu;
 
-  if (dlen != 2) {
+  if (!attDecodeMtu(data, dlen, mtu)) {
     return;
   }
 
@@ -766,13 +779,10 @@ void ATTClass::mtuResp(uint16_t connectionHandle, uint8_t dlen, uint8_t data[])
 
 void ATTClass::findInfoReq(uint16_t connectionHandle, uint16_t mtu, uint8_t dlen, uint8_t data[])
 {
-  struct __attribute__ ((packed)) FindInfoReq {
-    uint16_t startHandle;
-    uint16_t endHandle;
-  } *findInfoReq = (FindInfoReq*)data;
+  ATTRangeReq findInfoReq;
 
-  if (dlen != sizeof(FindInfoReq)) {
-    sendError(connectionHandle, ATT_OP_FIND_INFO_REQ, findInfoReq->startHandle, ATT_ECODE_INVALID_PDU);
+  if (!attDecodeFindInfoReq(data, dlen, findInfoReq)) {
+    sendError(connectionHandle, ATT_OP_FIND_INFO_REQ, findInfoReq.startHandle, ATT_ECODE_INVALID_PDU);
     return;
   }
 
@@ -783,7 +793,7 @@ void ATTClass::findInfoReq(uint16_t connectionHandle, uint16_t mtu, uint8_t dlen
   response[1] = 0x00;
   responseLength = 2;
 
-  for (uint16_t i = (findInfoReq->startHandle - 1); i < GATT.attributeCount() && i <= (findInfoReq->endHandle - 1); i++) {
+  for (uint16_t i = (findInfoReq.startHandle - 1); i < GATT.attributeCount() && i <= (findInfoReq.endHandle - 1); i++) {
     BLELocalAttribute* attribute = GATT.attribute(i);
     uint16_t handle = (i + 1);
     bool isValueHandle = (attribute->type() == BLETypeCharacteristic) && (((BLELocalCharacteristic*)attribute)->valueHandle() == handle);
@@ -822,7 +832,7 @@ void ATTClass::findInfoReq(uint16_t connectionHandle, uint16_t mtu, uint8_t dlen
   }
 
   if (responseLength == 2) {
-    sendError(connectionHandle, ATT_OP_FIND_INFO_REQ, findInfoReq->startHandle, ATT_ECODE_ATTR_NOT_FOUND);
+    sendError(connectionHandle, ATT_OP_FIND_INFO_REQ, findInfoReq.startHandle, ATT_ECODE_ATTR_NOT_FOUND);
   } else {
     HCI.sendAclPkt(connectionHandle, ATT_CID, responseLength, response);
   }
@@ -854,19 +864,15 @@ void ATTClass::findInfoResp(uint16_t connectionHandle, uint8_t dlen, uint8_t dat
 
 void ATTClass::findByTypeReq(uint16_t connectionHandle, uint16_t mtu, uint8_t dlen, uint8_t data[])
 {
-  struct __attribute__ ((packed)) FindByTypeReq {
-    uint16_t startHandle;
-    uint16_t endHandle;
-    uint16_t type;
-  } *findByTypeReq = (FindByTypeReq*)data;
+  ATTRangeReq findByTypeReq;
 
-  if (dlen < sizeof(FindByTypeReq)) {
-    sendError(connectionHandle, ATT_OP_FIND_BY_TYPE_REQ, findByTypeReq->startHandle, ATT_ECODE_INVALID_PDU);
+  if (!attDecodeFindByTypeReq(data, dlen, findByTypeReq)) {
+    sendError(connectionHandle, ATT_OP_FIND_BY_TYPE_REQ, findByTypeReq.startHandle, ATT_ECODE_INVALID_PDU);
     return;
   }
 
-  uint16_t valueLength = dlen - sizeof(*findByTypeReq);
-  uint8_t* value = &data[sizeof(*findByTypeReq)];
+  uint16_t valueLength = findByTypeReq.valueLength;
+  const uint8_t* value = findByTypeReq.value;
 
   uint8_t response[mtu];
   uint16_t responseLength;
@@ -874,11 +880,11 @@ void ATTClass::findByTypeReq(uint16_t connectionHandle, uint16_t mtu, uint8_t dl
   response[0] = ATT_OP_FIND_BY_TYPE_RESP;
   responseLength = 1;
 
-  if (findByTypeReq->type == BLETypeService) {
-    for (uint16_t i = (findByTypeReq->startHandle - 1); i < GATT.attributeCount() && i <= (findByTypeReq->endHandle - 1); i++) {
+  if (findByTypeReq.type == BLETypeService) {
+    for (uint16_t i = (findByTypeReq.startHandle - 1); i < GATT.attributeCount() && i <= (findByTypeReq.endHandle - 1); i++) {
       BLELocalAttribute* attribute = GATT.attribute(i);
 
-      if ((attribute->type() == findByTypeReq->type) && (attribute->uuidLength() == valueLength) && memcmp(attribute->uuidData(), value, valueLength) == 0) {
+      if ((attribute->type() == findByTypeReq.type) && (attribute->uuidLength() == valueLength) && memcmp(attribute->uuidData(), value, valueLength) == 0) {
         BLELocalService* service = (BLELocalService*)attribute;
 
         // add the start handle
@@ -899,7 +905,7 @@ void ATTClass::findByTypeReq(uint16_t connectionHandle, uint16_t mtu, uint8_t dl
   }
 
   if (responseLength == 1) {
-    sendError(connectionHandle, ATT_OP_FIND_BY_TYPE_REQ, findByTypeReq->startHandle, ATT_ECODE_ATTR_NOT_FOUND);
+    sendError(connectionHandle, ATT_OP_FIND_BY_TYPE_REQ, findByTypeReq.startHandle, ATT_ECODE_ATTR_NOT_FOUND);
   } else {
     HCI.sendAclPkt(connectionHandle, ATT_CID, responseLength, response);
   }
@@ -907,22 +913,19 @@ void ATTClass::findByTypeReq(uint16_t connectionHandle, uint16_t mtu, uint8_t dl
 
 void ATTClass::readByGroupReq(uint16_t connectionHandle, uint16_t mtu, uint8_t dlen, uint8_t data[])
 {
-  struct __attribute__ ((packed)) ReadByGroupReq {
-    uint16_t startHandle;
-    uint16_t endHandle;
-    uint16_t uuid;
-  } *readByGroupReq = (ReadByGroupReq*)data;
+  ATTRangeReq readByGroupReq;
+  bool valid = attDecodeReadByReq(data, dlen, readByGroupReq);
 #ifdef _BLE_TRACE_
   Serial.print("readByGroupReq: start: 0x");
-  Serial.println(readByGroupReq->startHandle,HEX);
+  Serial.println(readByGroupReq.startHandle,HEX);
   Serial.print("readByGroupReq: end: 0x");
-  Serial.println(readByGroupReq->endHandle,HEX);
+  Serial.println(readByGroupReq.endHandle,HEX);
   Serial.print("readByGroupReq: UUID: 0x");
-  Serial.println(readByGroupReq->uuid,HEX);
+  Serial.println(readByGroupReq.type,HEX);
 #endif
 
-  if (dlen != sizeof(ReadByGroupReq) || (readByGroupReq->uuid != BLETypeService && readByGroupReq->uuid != 0x2801)) {
-    sendError(connectionHandle, ATT_OP_READ_BY_GROUP_REQ, readByGroupReq->startHandle, ATT_ECODE_UNSUPP_GRP_TYPE);
+  if (!valid || (readByGroupReq.type != BLETypeService && readByGroupReq.type != 0x2801)) {
+    sendError(connectionHandle, ATT_OP_READ_BY_GROUP_REQ, readByGroupReq.startHandle, ATT_ECODE_UNSUPP_GRP_TYPE);
     return;
   }
 
@@ -936,10 +939,10 @@ void ATTClass::readByGroupReq(uint16_t connectionHandle, uint16_t mtu, uint8_t d
   Serial.print("readByGroupReq: attrcount: ");
   Serial.println(GATT.attributeCount());
 #endif
-  for (uint16_t i = (readByGroupReq->startHandle - 1); i < GATT.attributeCount() && i <= (readByGroupReq->endHandle - 1); i++) {
+  for (uint16_t i = (readByGroupReq.startHandle - 1); i < GATT.attributeCount() && i <= (readByGroupReq.endHandle - 1); i++) {
     BLELocalAttribute* attribute = GATT.attribute(i);
 
-    if (readByGroupReq->uuid != attribute->type()) {
+    if (readByGroupReq.type != attribute->type()) {
       // not the type
       continue;
     }
@@ -978,7 +981,7 @@ void ATTClass::readByGroupReq(uint16_t connectionHandle, uint16_t mtu, uint8_t d
   }
 
   if (responseLength == 2) {
-    sendError(connectionHandle, ATT_OP_READ_BY_GROUP_REQ, readByGroupReq->startHandle, ATT_ECODE_ATTR_NOT_FOUND);
+    sendError(connectionHandle, ATT_OP_READ_BY_GROUP_REQ, readByGroupReq.startHandle, ATT_ECODE_ATTR_NOT_FOUND);
   } else {
     HCI.sendAclPkt(connectionHandle, ATT_CID, responseLength, response);
   }
@@ -1011,31 +1014,23 @@ void ATTClass::readByGroupResp(uint16_t connectionHandle, uint8_t dlen, uint8_t
 
 void ATTClass::readOrReadBlobReq(uint16_t connectionHandle, uint16_t mtu, uint8_t opcode, uint8_t dlen, uint8_t data[])
 {
-  // this is requesting a first read (if any more)
-  if (opcode == ATT_OP_READ_REQ) {
-    if (dlen != sizeof(uint16_t)) {
-      sendError(connectionHandle, ATT_OP_READ_REQ, 0x0000, ATT_ECODE_INVALID_PDU);
-      return;
-    }
-  } else {
-    // This expect to read the next data portion that would fit in the MTU AFTER a first read
-    if (dlen != (sizeof(uint16_t) + sizeof(uint16_t))) {
-      sendError(connectionHandle, ATT_OP_READ_BLOB_REQ, 0x0000, ATT_ECODE_INVALID_PDU);
-      return;
-    }
+  ATTHandleReq readReq;
+
+  // a read request has the handle, a read blob request (to read the next data portion that
+  // would fit in the MTU AFTER a first read) also the offset to read the local value from
+  if (!attDecodeReadReq(opcode != ATT_OP_READ_REQ, data, dlen, readReq)) {
+    sendError(connectionHandle, opcode, 0x0000, ATT_ECODE_INVALID_PDU);
+    return;
   }
 
   /// if auth error, hold the response in a buffer.
   bool holdResponse = false;
 
   // obtain the characteristic handle to read from
-  uint16_t handle = *(uint16_t*)data;
-
-  // if the opcode is to do a read request WITHOUT a starting offset
-  // offset is zero, else the offset to read the local data characteristic value with the offset that is provided AFTER the handle.
-  uint16_t offset = (opcode == ATT_OP_READ_REQ) ? 0 : *(uint16_t*)&data[sizeof(handle)];
+  uint16_t handle = readReq.handle;
+  uint16_t offset = readReq.offset;
 
-  if ((uint16_t)(handle - 1) > GATT.attributeCount()) {
+  if ((uint16_t)(handle - 1) >= GATT.attributeCount()) {
     sendError(connectionHandle, opcode, handle, ATT_ECODE_ATTR_NOT_FOUND);
     return;
   }
@@ -1151,14 +1146,10 @@ void ATTClass::readResp(uint16_t connectionHandle, uint8_t dlen, uint8_t data[])
 
 void ATTClass::readByTypeReq(uint16_t connectionHandle, uint16_t mtu, uint8_t dlen, uint8_t data[])
 {
-  struct __attribute__ ((packed)) ReadByTypeReq {
-    uint16_t startHandle;
-    uint16_t endHandle;
-    uint16_t uuid;
-  } *readByTypeReq = (ReadByTypeReq*)data;
+  ATTRangeReq readByTypeReq;
 
-  if (dlen != sizeof(ReadByTypeReq)) {
-    sendError(connectionHandle, ATT_OP_READ_BY_TYPE_REQ, readByTypeReq->startHandle, ATT_ECODE_INVALID_PDU);
+  if (!attDecodeReadByReq(data, dlen, readByTypeReq)) {
+    sendError(connectionHandle, ATT_OP_READ_BY_TYPE_REQ, readByTypeReq.startHandle, ATT_ECODE_INVALID_PDU);
     return;
   }
 
@@ -1169,11 +1160,11 @@ void ATTClass::readByTypeReq(uint16_t connectionHandle, uint16_t mtu, uint8_t dl
   response[1] = 0x00;
   responseLength = 2;
 
-  for (uint16_t i = (readByTypeReq->startHandle - 1); i < GATT.attributeCount() && i <= (readByTypeReq->endHandle - 1); i++) {
+  for (uint16_t i = (readByTypeReq.startHandle - 1); i < GATT.attributeCount() && i <= (readByTypeReq.endHandle - 1); i++) {
     BLELocalAttribute* attribute = GATT.attribute(i);
     uint16_t handle = (i + 1);
 
-    if (attribute->type() == readByTypeReq->uuid) {
+    if (attribute->type() == readByTypeReq.type) {
       if (attribute->type() == BLETypeCharacteristic) {
         BLELocalCharacteristic* characteristic = (BLELocalCharacteristic*)attribute;
 
@@ -1232,7 +1223,7 @@ void ATTClass::readByTypeReq(uint16_t connectionHandle, uint16_t mtu, uint8_t dl
 
         break; // all done
       }
-    } else if (attribute->type() == BLETypeCharacteristic && attribute->uuidLength() == 2 && memcmp(&readByTypeReq->uuid, attribute->uuidData(), 2) == 0) {
+    } else if (attribute->type() == BLETypeCharacteristic && attribute->uuidLength() == 2 && leRead16(attribute->uuidData()) == readByTypeReq.type) {
       BLELocalCharacteristic* characteristic = (BLELocalCharacteristic*)attribute;
 
       // add the handle
@@ -1251,7 +1242,7 @@ void ATTClass::readByTypeReq(uint16_t connectionHandle, uint16_t mtu, uint8_t dl
   }
 
   if (responseLength == 2) {
-    sendError(connectionHandle, ATT_OP_READ_BY_TYPE_REQ, readByTypeReq->startHandle, ATT_ECODE_ATTR_NOT_FOUND);
+    sendError(connectionHandle, ATT_OP_READ_BY_TYPE_REQ, readByTypeReq.startHandle, ATT_ECODE_ATTR_NOT_FOUND);
   } else {
     HCI.sendAclPkt(connectionHandle, ATT_CID, responseLength, response);
   }
@@ -1285,25 +1276,26 @@ void ATTClass::readByTypeResp(uint16_t connectionHandle, uint8_t dlen, uint8_t d
 void ATTClass::writeReqOrCmd(uint16_t connectionHandle, uint16_t mtu, uint8_t op, uint8_t dlen, uint8_t data[])
 {
   bool withResponse = (op == ATT_OP_WRITE_REQ);
+  ATTHandleReq writeReq;
 
-  if (dlen < sizeof(uint16_t)) {
+  if (!attDecodeHandleValue(data, dlen, writeReq)) {
     if (withResponse) {
       sendError(connectionHandle, ATT_OP_WRITE_REQ, 0x0000, ATT_ECODE_INVALID_PDU);
     }
     return;
   }
 
-  uint16_t handle = *(uint16_t*)data;
+  uint16_t handle = writeReq.handle;
 
-  if ((uint16_t)(handle - 1) > GATT.attributeCount()) {
+  if ((uint16_t)(handle - 1) >= GATT.attributeCount()) {
     if (withResponse) {
       sendError(connectionHandle, ATT_OP_WRITE_REQ, handle, ATT_ECODE_ATTR_NOT_FOUND);
     }
     return;
   }
 
-  uint8_t valueLength = dlen - sizeof(handle);
-  uint8_t* value = &data[sizeof(handle)];
+  uint8_t valueLength = writeReq.valueLength;
+  const uint8_t* value = writeReq.value;
 
   BLELocalAttribute* attribute = GATT.attribute(handle - 1);
   bool holdResponse = false;
@@ -1354,13 +1346,21 @@ void ATTClass::writeReqOrCmd(uint16_t connectionHandle, uint16_t mtu, uint8_t op
     BLELocalDescriptor* descriptor = (BLELocalDescriptor*)attribute;
 
     // only CCCD's are writable
-    if (descriptor->uuidLength() != 2 || *((uint16_t*)(descriptor->uuidData())) != 0x2902) {
+    if (descriptor->uuidLength() != 2 || leRead16(descriptor->uuidData()) != 0x2902) {
       if (withResponse) {
         sendError(connectionHandle, ATT_OP_WRITE_REQ, handle, ATT_ECODE_WRITE_NOT_PERM);
       }
       return;
     }
 
+    // added paulvha : a CCCD value is 2 bytes
+    if (valueLength != 2) {
+      if (withResponse) {
+        sendError(connectionHandle, ATT_OP_WRITE_REQ, handle, ATT_ECODE_INVAL_ATTR_VALUE_LEN);
+      }
+      return;
+    }
+
     // get the previous handle, should be the characteristic for the CCCD
     attribute = GATT.attribute(handle - 2);
 
@@ -1375,7 +1375,7 @@ void ATTClass::writeReqOrCmd(uint16_t connectionHandle, uint16_t mtu, uint8_t op
 
     for (int i = 0; i < ATT_MAX_PEERS; i++) {
       if (_peers[i].connectionHandle == connectionHandle) {
-        characteristic->writeCccdValue(BLEDevice(_peers[i].addressType, _peers[i].address), *((uint16_t*)value));
+        characteristic->writeCccdValue(BLEDevice(_peers[i].addressType, _peers[i].address), leRead16(value));
         break;
       }
     }
@@ -1440,20 +1440,17 @@ void ATTClass::writeResp(uint16_t connectionHandle, uint8_t dlen, uint8_t data[]
 
 void ATTClass::prepWriteReq(uint16_t connectionHandle, uint16_t mtu, uint8_t dlen, uint8_t data[])
 {
-  struct __attribute__ ((packed)) PrepWriteReq {
-    uint16_t handle;
-    uint16_t offset;
-  } *prepWriteReq = (PrepWriteReq*)data;
+  ATTHandleReq prepWriteReq;
 
-  if (dlen < sizeof(PrepWriteReq)) {
+  if (!attDecodePrepWriteReq(data, dlen, prepWriteReq)) {
     sendError(connectionHandle, ATT_OP_PREP_WRITE_REQ, 0x0000, ATT_ECODE_INVALID_PDU);
     return;
   }
 
-  uint16_t handle = prepWriteReq->handle;
-  uint16_t offset = prepWriteReq->offset;
+  uint16_t handle = prepWriteReq.handle;
+  uint16_t offset = prepWriteReq.offset;
 
-  if ((uint16_t)(handle - 1) > GATT.attributeCount()) {
+  if ((uint16_t)(handle - 1) >= GATT.attributeCount()) {
     sendError(connectionHandle, ATT_OP_PREP_WRITE_REQ, handle, ATT_ECODE_ATTR_NOT_FOUND);
     return;
   }
@@ -1490,8 +1487,8 @@ void ATTClass::prepWriteReq(uint16_t connectionHandle, uint16_t mtu, uint8_t dle
     return;
   }
 
-  uint8_t valueLength = dlen - sizeof(PrepWriteReq);
-  uint8_t* value = &data[sizeof(PrepWriteReq)];
+  uint8_t valueLength = prepWriteReq.valueLength;
+  const uint8_t* value = prepWriteReq.value;
 
   if ((offset != _longWriteValueLength) || ((offset + valueLength) > (uint16_t)characteristic->valueSize())) {
     sendError(connectionHandle, ATT_OP_PREP_WRITE_REQ, handle, ATT_ECODE_INVALID_OFFSET);
@@ -1545,15 +1542,13 @@ void ATTClass::execWriteReq(uint16_t connectionHandle, uint16_t mtu, uint8_t dle
 
 void ATTClass::handleNotifyOrInd(uint16_t connectionHandle, uint8_t opcode, uint8_t dlen, uint8_t data[])
 {
-  if (dlen < 2) {
+  ATTHandleReq notifyOrInd;
+
+  if (!attDecodeHandleValue(data, dlen, notifyOrInd)) {
     return; // drop
   }
 
-  struct __attribute__ ((packed)) HandleNotifyOrInd {
-    uint16_t handle;
-  } *handleNotifyOrInd = (HandleNotifyOrInd*)data;
-
-  uint16_t handle = handleNotifyOrInd->handle;
+  uint16_t handle = notifyOrInd.handle;
 
   for (int peer = 0; peer < ATT_MAX_PEERS; peer++) {
     if (_peers[peer].connectionHandle != connectionHandle) {
@@ -1578,7 +1573,7 @@ void ATTClass::handleNotifyOrInd(uint16_t connectionHandle, uint8_t opcode, uint
           BLERemoteCharacteristic* c = s->characteristic(j);
 
           if (c->valueHandle() == handle) {
-            c->writeValue(BLEDevice(_peers[peer].addressType, _peers[peer].address), &data[2], dlen - 2);
+            c->writeValue(BLEDevice(_peers[peer].addressType, _peers[peer].address), notifyOrInd.value, notifyOrInd.valueLength);
           }
         }
 
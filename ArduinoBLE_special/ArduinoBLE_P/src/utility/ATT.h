@@ -78,6 +78,7 @@ public:
   virtual bool paired() const;
   virtual bool paired(uint16_t handle) const;
   virtual uint16_t mtu(uint16_t handle) const;
+  virtual uint8_t role(uint16_t handle) const;     // special paulvha
 
   virtual bool disconnect();
 
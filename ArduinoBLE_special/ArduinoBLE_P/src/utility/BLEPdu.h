@@ -0,0 +1,176 @@
+/*
+  Decoders for the received HCI ACL, L2CAP and ATT request PDU's, built on ByteReader.
+
+  Each decoder fills in what it can read (missing fields are 0) and returns false if the PDU
+  has the wrong length, so the caller can still use e.g. the start handle in an error response.
+  Pointers in the result point into the received data and are only valid as long as that is.
+
+  paulvha / October 2026
+*/
+
+#ifndef _BLE_PDU_H_
+#define _BLE_PDU_H_
+
+#include "ByteStream.h"
+
+// HCI ACL data header : handle (12 bits) + packet boundary / broadcast flags, data length
+struct HCIAclHdr {
+  uint16_t handle;
+  uint8_t flags;
+  uint16_t dlen;
+};
+
+#define HCI_ACL_HDR_SIZE   4
+#define HCI_ACL_CONT       0x01       // continuing fragment of a higher layer message
+
+// basic L2CAP header, at the start of the first fragment
+struct L2CAPHdr {
+  uint16_t len;
+  uint16_t cid;
+};
+
+#define L2CAP_HDR_SIZE     4
+
+// ATT request with a handle range (find info, find by type, read by type / group)
+struct ATTRangeReq {
+  uint16_t startHandle;
+  uint16_t endHandle;
+  uint16_t type;
+  const uint8_t* value;     // find by type value
+  uint8_t valueLength;
+};
+
+// ATT request on one handle (read, write, prepare write, notify / indicate)
+struct ATTHandleReq {
+  uint16_t handle;
+  uint16_t offset;
+  const uint8_t* value;
+  uint8_t valueLength;
+};
+
+// ATT error response
+struct ATTErrorRsp {
+  uint8_t opcode;
+  uint16_t handle;
+  uint8_t code;
+};
+
+// the ACL data must be complete : dlen bytes after the header
+inline bool hciDecodeAclHdr(const uint8_t pdata[], uint16_t plen, HCIAclHdr& hdr)
+{
+  ByteReader r(pdata, plen);
+  uint16_t handle = r.u16();
+
+  hdr.handle = handle & 0x0fff;
+  hdr.flags = (handle & 0xf000) >> 12;
+  hdr.dlen = r.u16();
+
+  return r.skip(hdr.dlen);
+}
+
+// only the header is checked, len can be more than what has been received (fragmented)
+inline bool l2capDecodeHdr(const uint8_t data[], uint16_t dlen, L2CAPHdr& hdr)
+{
+  ByteReader r(data, dlen);
+
+  hdr.len = r.u16();
+  hdr.cid = r.u16();
+  return r.ok();
+}
+
+// exchange MTU request / response
+inline bool attDecodeMtu(const uint8_t data[], uint8_t dlen, uint16_t& mtu)
+{
+  ByteReader r(data, dlen);
+
+  mtu = r.u16();
+  return r.atEnd();
+}
+
+// find information request
+inline bool attDecodeFindInfoReq(const uint8_t data[], uint8_t dlen, ATTRangeReq& req)
+{
+  ByteReader r(data, dlen);
+
+  req.startHandle = r.u16();
+  req.endHandle = r.u16();
+  req.type = 0;
+  req.value = NULL;
+  req.valueLength = 0;
+  return r.atEnd();
+}
+
+// find by type value request : range, 16 bit type and the value
+inline bool attDecodeFindByTypeReq(const uint8_t data[], uint8_t dlen, ATTRangeReq& req)
+{
+  ByteReader r(data, dlen);
+
+  req.startHandle = r.u16();
+  req.endHandle = r.u16();
+  req.type = r.u16();
+  req.valueLength = r.remaining();
+  req.value = r.ok() ? r.rest() : NULL;
+  return r.ok();
+}
+
+// read by type / read by group type request with a 16 bit UUID
+inline bool attDecodeReadByReq(const uint8_t data[], uint8_t dlen, ATTRangeReq& req)
+{
+  ByteReader r(data, dlen);
+
+  req.startHandle = r.u16();
+  req.endHandle = r.u16();
+  req.type = r.u16();
+  req.value = NULL;
+  req.valueLength = 0;
+  return r.atEnd();
+}
+
+// read request (handle) or read blob request (handle + offset)
+inline bool attDecodeReadReq(bool blob, const uint8_t data[], uint8_t dlen, ATTHandleReq& req)
+{
+  ByteReader r(data, dlen);
+
+  req.handle = r.u16();
+  req.offset = blob ? r.u16() : 0;
+  req.value = NULL;
+  req.valueLength = 0;
+  return r.atEnd();
+}
+
+// write request / command, handle value notification / indication : handle + value
+inline bool attDecodeHandleValue(const uint8_t data[], uint8_t dlen, ATTHandleReq& req)
+{
+  ByteReader r(data, dlen);
+
+  req.handle = r.u16();
+  req.offset = 0;
+  req.valueLength = r.remaining();
+  req.value = r.ok() ? r.rest() : NULL;
+  return r.ok();
+}
+
+// prepare write request : handle, offset and part of the value
+inline bool attDecodePrepWriteReq(const uint8_t data[], uint8_t dlen, ATTHandleReq& req)
+{
+  ByteReader r(data, dlen);
+
+  req.handle = r.u16();
+  req.offset = r.u16();
+  req.valueLength = r.remaining();
+  req.value = r.ok() ? r.rest() : NULL;
+  return r.ok();
+}
+
+// error response
+inline bool attDecodeError(const uint8_t data[], uint8_t dlen, ATTErrorRsp& rsp)
+{
+  ByteReader r(data, dlen);
+
+  rsp.opcode = r.u8();
+  rsp.handle = r.u16();
+  rsp.code = r.u8();
+  return r.atEnd();
+}
+
+#endif // _BLE_PDU_H_
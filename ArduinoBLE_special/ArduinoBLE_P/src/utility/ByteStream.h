@@ -0,0 +1,210 @@
+/*
+  Little endian readers / writers and a bounds checked cursor for parsing HCI, L2CAP and ATT PDU's.
+
+  The PDU's are byte streams that can start on any address. Casting them to (uint16_t*) is an
+  unaligned access (and undefined behavior), next to that it is easy to read past the received
+  length. These helpers assemble the values from single bytes, which the compiler turns into
+  a single load where the processor allows it.
+
+  ByteReader remembers a read past the end: the read returns 0 and ok() becomes false.
+  Check ok() (or atEnd() for an exact length) once after reading all fields.
+
+  Header only, no dependencies.  paulvha / October 2026
+*/
+
+#ifndef _BYTE_STREAM_H_
+#define _BYTE_STREAM_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// read little endian values from any address
+constexpr uint16_t leRead16(const uint8_t* p)
+{
+  return (uint16_t)(p[0] | ((uint16_t)p[1] << 8));
+}
+
+constexpr uint32_t leRead24(const uint8_t* p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16);
+}
+
+constexpr uint32_t leRead32(const uint8_t* p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// write little endian values to any address, return the address after the value
+inline uint8_t* leWrite16(uint8_t* p, uint16_t v)
+{
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  return p + 2;
+}
+
+inline uint8_t* leWrite24(uint8_t* p, uint32_t v)
+{
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  return p + 3;
+}
+
+inline uint8_t* leWrite32(uint8_t* p, uint32_t v)
+{
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+  return p + 4;
+}
+
+class ByteReader {
+public:
+  constexpr ByteReader(const uint8_t* data, size_t length) :
+    _data(data), _length(length), _offset(0), _error(false) {}
+
+  uint8_t u8()
+  {
+    return need(1) ? _data[_offset++] : 0;
+  }
+
+  uint16_t u16()
+  {
+    if (!need(2)) return 0;
+    uint16_t v = leRead16(&_data[_offset]);
+    _offset += 2;
+    return v;
+  }
+
+  uint32_t u24()
+  {
+    if (!need(3)) return 0;
+    uint32_t v = leRead24(&_data[_offset]);
+    _offset += 3;
+    return v;
+  }
+
+  uint32_t u32()
+  {
+    if (!need(4)) return 0;
+    uint32_t v = leRead32(&_data[_offset]);
+    _offset += 4;
+    return v;
+  }
+
+  // pointer to the next n bytes in the stream, NULL if there are not that many
+  const uint8_t* bytes(size_t n)
+  {
+    if (!need(n)) return NULL;
+    const uint8_t* p = &_data[_offset];
+    _offset += n;
+    return p;
+  }
+
+  // copy n bytes, the destination is zeroed if there are not that many
+  bool copy(uint8_t* dest, size_t n)
+  {
+    const uint8_t* p = bytes(n);
+    if (p == NULL) {
+      memset(dest, 0, n);
+      return false;
+    }
+    memcpy(dest, p, n);
+    return true;
+  }
+
+  bool skip(size_t n)
+  {
+    return bytes(n) != NULL;
+  }
+
+  // whatever is left (can be 0 bytes)
+  const uint8_t* rest()
+  {
+    const uint8_t* p = &_data[_offset];
+    _offset = _length;
+    return p;
+  }
+
+  size_t remaining() const { return _error ? 0 : _length - _offset; }
+  size_t offset() const { return _offset; }
+  bool ok() const { return !_error; }
+  bool atEnd() const { return !_error && _offset == _length; }
+
+private:
+  bool need(size_t n)
+  {
+    if (_error || n > _length - _offset) {
+      _error = true;
+      return false;
+    }
+    return true;
+  }
+
+  const uint8_t* _data;
+  size_t _length;
+  size_t _offset;
+  bool _error;
+};
+
+class ByteWriter {
+public:
+  constexpr ByteWriter(uint8_t* data, size_t size) :
+    _data(data), _size(size), _length(0), _error(false) {}
+
+  ByteWriter& u8(uint8_t v)
+  {
+    if (need(1)) _data[_length++] = v;
+    return *this;
+  }
+
+  ByteWriter& u16(uint16_t v)
+  {
+    if (need(2)) _length = leWrite16(&_data[_length], v) - _data;
+    return *this;
+  }
+
+  ByteWriter& u24(uint32_t v)
+  {
+    if (need(3)) _length = leWrite24(&_data[_length], v) - _data;
+    return *this;
+  }
+
+  ByteWriter& u32(uint32_t v)
+  {
+    if (need(4)) _length = leWrite32(&_data[_length], v) - _data;
+    return *this;
+  }
+
+  ByteWriter& bytes(const uint8_t* p, size_t n)
+  {
+    if (need(n)) {
+      memcpy(&_data[_length], p, n);
+      _length += n;
+    }
+    return *this;
+  }
+
+  size_t length() const { return _length; }
+  size_t remaining() const { return _size - _length; }
+  bool ok() const { return !_error; }
+
+private:
+  bool need(size_t n)
+  {
+    if (_error || n > _size - _length) {
+      _error = true;
+      return false;
+    }
+    return true;
+  }
+
+  uint8_t* _data;
+  size_t _size;
+  size_t _length;
+  bool _error;
+};
+
+#endif // _BYTE_STREAM_H_
@@ -0,0 +1,188 @@
+/*
+  Default store for bonding keys in flash, using the wsf_flash record store of ExactleP.
+
+  paulvha / October 2026
+*/
+
+#include <string.h>
+#include "FlashKeyStore.h"
+
+#ifdef BLE_FLASH_KEY_STORE
+
+// a bond as stored in flash, the address is first as that is what is searched on
+struct __attribute__ ((packed)) FlashBond {
+  uint8_t address[6];
+  uint8_t flags;
+  uint8_t addressType;
+  uint8_t LTK[16];
+  uint8_t IRK[16];
+};
+
+#define FLASH_BOND_LTK 0x01
+#define FLASH_BOND_IRK 0x02
+#define FLASH_BOND_TYPE 0x04    // addressType is set
+
+static bool _mounted = false;
+
+bool flashKeyStoreBegin(const wsfFlashDev_t* dev)
+{
+  _mounted = (WsfFlashInit(dev) == WSF_FLASH_SUCCESS);
+  return _mounted;
+}
+
+// mount on first use
+static bool flashKeyStoreReady()
+{
+#if defined (ARDUINO_ARCH_APOLLO3)
+  if (!_mounted) flashKeyStoreBegin(&WsfFlashApollo3Dev);
+#endif
+  return _mounted;
+}
+
+// return the record id of the bond of address, or of a free slot if not found
+static uint16_t flashKeyStoreLookup(uint8_t* address, bool* found)
+{
+  uint16_t id = WsfFlashFind(WSF_FLASH_ID_BOND_BASE, FLASH_KEY_STORE_LAST_ID, address);
+
+  *found = (id != WSF_FLASH_ID_INVALID);
+  if (*found) return id;
+
+  for (id = WSF_FLASH_ID_BOND_BASE; id <= FLASH_KEY_STORE_LAST_ID; id++) {
+    if (WsfFlashNextId(id, id) == WSF_FLASH_ID_INVALID) return id;
+  }
+
+  return WSF_FLASH_ID_INVALID;
+}
+
+// add or update one key of a bond, addressType is only set with FLASH_BOND_TYPE in flag
+static int flashKeyStoreKey(uint8_t* address, uint8_t* key, uint8_t flag, uint8_t addressType = 0)
+{
+  FlashBond bond;
+  bool found;
+
+  if (!flashKeyStoreReady()) return 0;
+
+  uint16_t id = flashKeyStoreLookup(address, &found);
+  if (id == WSF_FLASH_ID_INVALID) return 0;
+
+  if (found) {
+    WsfFlashRead(id, (uint8_t*) &bond, sizeof(bond));
+  }
+  else {
+    memset(&bond, 0, sizeof(bond));
+    memcpy(bond.address, address, 6);
+  }
+
+  memcpy((flag & FLASH_BOND_LTK) ? bond.LTK : bond.IRK, key, 16);
+  if (flag & FLASH_BOND_TYPE) bond.addressType = addressType;
+  bond.flags |= flag;
+
+  if (WsfFlashWrite(id, (uint8_t*) &bond, sizeof(bond)) != WSF_FLASH_SUCCESS) return 0;
+
+  // keys must survive a reset right after pairing
+  return WsfFlashSync() == WSF_FLASH_SUCCESS;
+}
+
+int flashKeyStoreStoreIRK(uint8_t* address, uint8_t* IRK)
+{
+  return flashKeyStoreKey(address, IRK, FLASH_BOND_IRK);
+}
+
+int flashKeyStoreStoreIdentity(uint8_t* address, uint8_t addressType, uint8_t* IRK)
+{
+  return flashKeyStoreKey(address, IRK, FLASH_BOND_IRK | FLASH_BOND_TYPE, addressType);
+}
+
+int flashKeyStoreStoreLTK(uint8_t* address, uint8_t* LTK)
+{
+  return flashKeyStoreKey(address, LTK, FLASH_BOND_LTK);
+}
+
+int flashKeyStoreGetLTK(uint8_t* address, uint8_t* LTK)
+{
+  FlashBond bond;
+  bool found;
+
+  if (!flashKeyStoreReady()) return 0;
+
+  uint16_t id = flashKeyStoreLookup(address, &found);
+  if (!found || WsfFlashRead(id, (uint8_t*) &bond, sizeof(bond)) != sizeof(bond)) return 0;
+  if (!(bond.flags & FLASH_BOND_LTK)) return 0;
+
+  memcpy(LTK, bond.LTK, 16);
+  return 1;
+}
+
+// the arrays are allocated as HCIClass::tryResolveAddress() expects and deletes them
+int flashKeyStoreGetIRKs(uint8_t* nIRKs, uint8_t** BDAddrType, uint8_t*** BDAddrs, uint8_t*** IRKs)
+{
+  FlashBond bond;
+  uint8_t n = 0;
+  int count = flashKeyStoreCount();
+
+  if (count > 255) count = 255;
+
+  *BDAddrType = new uint8_t[count];
+  *BDAddrs    = new uint8_t*[count];
+  *IRKs       = new uint8_t*[count];
+
+  for (uint16_t id = WsfFlashNextId(WSF_FLASH_ID_BOND_BASE, FLASH_KEY_STORE_LAST_ID);
+       id != WSF_FLASH_ID_INVALID && n < count;
+       id = (id == FLASH_KEY_STORE_LAST_ID) ? WSF_FLASH_ID_INVALID : WsfFlashNextId(id + 1, FLASH_KEY_STORE_LAST_ID)) {
+
+    if (WsfFlashRead(id, (uint8_t*) &bond, sizeof(bond)) != sizeof(bond)) continue;
+    if (!(bond.flags & FLASH_BOND_IRK)) continue;
+
+    (*BDAddrType)[n] = bond.addressType;
+    (*BDAddrs)[n] = new uint8_t[6];
+    (*IRKs)[n]    = new uint8_t[16];
+    memcpy((*BDAddrs)[n], bond.address, 6);
+    memcpy((*IRKs)[n], bond.IRK, 16);
+    n++;
+  }
+
+  *nIRKs = n;
+  return 1;
+}
+
+int flashKeyStoreRemove(uint8_t* address)
+{
+  bool found;
+
+  if (!flashKeyStoreReady()) return 0;
+
+  uint16_t id = flashKeyStoreLookup(address, &found);
+  if (!found || WsfFlashDelete(id) != WSF_FLASH_SUCCESS) return 0;
+
+  return WsfFlashSync() == WSF_FLASH_SUCCESS;
+}
+
+int flashKeyStoreRemoveAll()
+{
+  if (!flashKeyStoreReady()) return 0;
+
+  for (uint16_t id = WsfFlashNextId(WSF_FLASH_ID_BOND_BASE, FLASH_KEY_STORE_LAST_ID);
+       id != WSF_FLASH_ID_INVALID;
+       id = WsfFlashNextId(WSF_FLASH_ID_BOND_BASE, FLASH_KEY_STORE_LAST_ID)) {
+    if (WsfFlashDelete(id) != WSF_FLASH_SUCCESS) return 0;
+  }
+
+  return WsfFlashSync() == WSF_FLASH_SUCCESS;
+}
+
+int flashKeyStoreCount()
+{
+  int count = 0;
+
+  if (!flashKeyStoreReady()) return 0;
+
+  for (uint16_t id = WsfFlashNextId(WSF_FLASH_ID_BOND_BASE, FLASH_KEY_STORE_LAST_ID);
+       id != WSF_FLASH_ID_INVALID;
+       id = (id == FLASH_KEY_STORE_LAST_ID) ? WSF_FLASH_ID_INVALID : WsfFlashNextId(id + 1, FLASH_KEY_STORE_LAST_ID)) {
+    count++;
+  }
+
+  return count;
+}
+
+#endif // BLE_FLASH_KEY_STORE
@@ -0,0 +1,67 @@
+/*
+  Default store for bonding keys in flash, using the wsf_flash record store of ExactleP.
+
+  Not used unless the sketch asks for it with BLE.setFlashKeyStore(true) before BLE.begin().
+  It sets the setStoreIRK / setGetIRKs / setStoreLTK / setGetLTK callbacks to these functions,
+  so bonds survive a reset.
+
+  The store uses WsfFlashApollo3Dev : 4 pages of 8K from 0xF4000 - 0xFBFFF (see
+  wsf_flash_apollo3.c). On first use these pages are ERASED when they do not hold a store yet,
+  a sketch larger than 976K or other data in that range is overwritten.
+
+  Each bond is one record with the peer address, its type, LTK and IRK. Lookup on address is
+  done with the RAM index of the store (hash of the address), without scanning flash.
+  Link keys (HCIClass::writeLK()) are BR/EDR keys kept by the controller and not stored here,
+  the Apollo3 is LE only.
+
+  paulvha / October 2026
+*/
+
+#ifndef _FLASH_KEY_STORE_H_
+#define _FLASH_KEY_STORE_H_
+
+// available for Apollo3 1.2.3 (ExactleP), used after BLE.setFlashKeyStore(true).
+// The host tests define BLE_FLASH_KEY_STORE themselves
+#if defined (ARDUINO_ARCH_APOLLO3) && ! defined (ARDUINO_ARCH_MBED)
+#define BLE_FLASH_KEY_STORE
+#endif
+
+#ifdef BLE_FLASH_KEY_STORE
+
+#include <stdint.h>
+#include "wsf_flash.h"
+
+// max number of bonds, record ids WSF_FLASH_ID_BOND_BASE... A deleted bond keeps its index entry
+// (tombstone) until its id is used again, so the bonds never take more than this many entries
+// of the RAM index. Half of the index is left for other records.
+#ifndef FLASH_KEY_STORE_MAX_BONDS
+#define FLASH_KEY_STORE_MAX_BONDS (WSF_FLASH_MAX_RECORDS / 2)
+#endif
+
+#if FLASH_KEY_STORE_MAX_BONDS > WSF_FLASH_MAX_RECORDS || FLASH_KEY_STORE_MAX_BONDS > WSF_FLASH_ID_BOND_LAST - WSF_FLASH_ID_BOND_BASE + 1
+#error "FLASH_KEY_STORE_MAX_BONDS does not fit WSF_FLASH_MAX_RECORDS or the bond record ids"
+#endif
+
+#define FLASH_KEY_STORE_LAST_ID   (WSF_FLASH_ID_BOND_BASE + FLASH_KEY_STORE_MAX_BONDS - 1)
+
+// mount the store. Called on first use with the Apollo3 flash if not done before
+bool flashKeyStoreBegin(const wsfFlashDev_t* dev);
+
+// same prototypes as the HCI callbacks. return 1 on success, 0 on failure / not found
+int flashKeyStoreStoreIRK(uint8_t* address, uint8_t* IRK);
+// as flashKeyStoreStoreIRK, with the address type (0 public, 1 static random) that
+// flashKeyStoreGetIRKs() returns. flashKeyStoreStoreIRK() keeps the type or uses 0 for a new bond
+int flashKeyStoreStoreIdentity(uint8_t* address, uint8_t addressType, uint8_t* IRK);
+int flashKeyStoreGetIRKs(uint8_t* nIRKs, uint8_t** BDAddrType, uint8_t*** BDAddrs, uint8_t*** IRKs);
+int flashKeyStoreStoreLTK(uint8_t* address, uint8_t* LTK);
+int flashKeyStoreGetLTK(uint8_t* address, uint8_t* LTK);
+
+// remove one bond or all bonds
+int flashKeyStoreRemove(uint8_t* address);
+int flashKeyStoreRemoveAll();
+
+// number of bonds stored
+int flashKeyStoreCount();
+
+#endif // BLE_FLASH_KEY_STORE
+#endif // _FLASH_KEY_STORE_H_
@@ -26,6 +26,7 @@
 #include "BLEProperty.h"
 
 #include "GATT.h"
+#include "ByteStream.h"
 
 GATTClass::GATTClass() :
   _genericAccessService(NULL),
@@ -136,9 +137,9 @@ uint16_t GATTClass::serviceUuidForCharacteristic(BLELocalCharacteristic* charact
 
   if (lastService) {
     if (lastService->uuidLength() == 2) {
-      serviceUuid = *(uint16_t*)(lastService->uuidData());
+      serviceUuid = leRead16(lastService->uuidData());
     } else {
-      serviceUuid = *(uint16_t*)(lastService->uuidData() + 10);
+      serviceUuid = leRead16(lastService->uuidData() + 10);
     }
   }
 
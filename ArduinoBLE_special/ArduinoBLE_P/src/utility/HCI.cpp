@@ -24,6 +24,8 @@
 #include "btct.h"
 #include "HCI.h"
 #include "bitDescriptions.h"
+#include "FlashKeyStore.h"
+#include "BLEPdu.h"
 // #define _BLE_TRACE_
 
 
@@ -71,6 +73,8 @@
 #define OCF_LE_CREATE_CONN                0x000d
 #define OCF_LE_CANCEL_CONN                0x000e
 #define OCF_LE_CONN_UPDATE                0x0013
+#define OCF_LE_SET_DATA_LENGTH            0x0022    // special paulvha
+#define OCF_LE_SET_PHY                    0x0032    // special paulvha
 
 #define HCI_OE_USER_ENDED_CONNECTION 0x13
 bool ScanResponseDataSet = false;       // paulvha
@@ -102,7 +106,8 @@ String commandToString(LE_COMMAND command){
 HCIClass::HCIClass() :
   _debug(NULL),
   _recvIndex(0),
-  _pendingPkt(0)
+  _pendingPkt(0),
+  _aclPktLength(0)
 {
 }
 
@@ -484,6 +489,13 @@ int HCIClass::leConnUpdate(uint16_t handle, uint16_t minInterval, uint16_t maxIn
   return sendCommand(OGF_LE_CTL << 10 | OCF_LE_CONN_UPDATE, sizeof(leConnUpdateData), &leConnUpdateData);
 }
 void HCIClass::saveNewAddress(uint8_t addressType, uint8_t* address, uint8_t* peerIrk, uint8_t* localIrk){
+#ifdef BLE_FLASH_KEY_STORE
+  // added paulvha : the flash key store keeps the address type with the IRK
+  if(_storeIRK == flashKeyStoreStoreIRK){
+    flashKeyStoreStoreIdentity(address, addressType, peerIrk);
+    return;
+  }
+#endif
   if(_storeIRK!=0){
     _storeIRK(address, peerIrk);
   }
@@ -681,6 +693,45 @@ int HCIClass::sendAclPkt(uint16_t handle, uint8_t cid, uint8_t plen, void* data)
   return 0;
 }
 
+// special paulvha : free ACL buffers, a sendAclPkt() now does not wait. October 2026
+uint8_t HCIClass::availablePackets()
+{
+  return _pendingPkt < _maxPkt ? _maxPkt - _pendingPkt : 0;
+}
+
+// special paulvha : LE Set PHY, the result comes later in an LE PHY Update Complete event. October 2026
+int HCIClass::leSetPhy(uint16_t handle, uint8_t txPhys, uint8_t rxPhys)
+{
+  struct __attribute__ ((packed)) HCILeSetPhyData {
+    uint16_t handle;
+    uint8_t allPhys;
+    uint8_t txPhys;
+    uint8_t rxPhys;
+    uint16_t phyOptions;
+  } leSetPhyData = { handle, 0x00, txPhys, rxPhys, 0x0000 };
+
+  return sendCommand(OGF_LE_CTL << 10 | OCF_LE_SET_PHY, sizeof(leSetPhyData), &leSetPhyData);
+}
+
+// special paulvha : LE Set Data Length, link layer packets of txOctets (27 - 251). October 2026
+int HCIClass::leSetDataLength(uint16_t handle, uint16_t txOctets)
+{
+  struct __attribute__ ((packed)) HCILeSetDataLengthData {
+    uint16_t handle;
+    uint16_t txOctets;
+    uint16_t txTime;
+  } leSetDataLengthData;
+
+  if (txOctets < 27) txOctets = 27;
+  if (txOctets > 251) txOctets = 251;
+
+  leSetDataLengthData.handle = handle;
+  leSetDataLengthData.txOctets = txOctets;
+  leSetDataLengthData.txTime = (txOctets + 14) * 8;     // us at 1M, the longest
+
+  return sendCommand(OGF_LE_CTL << 10 | OCF_LE_SET_DATA_LENGTH, sizeof(leSetDataLengthData), &leSetDataLengthData);
+}
+
 int HCIClass::disconnect(uint16_t handle)
 {
     struct __attribute__ ((packed)) HCIDisconnectData {
@@ -741,76 +792,79 @@ int HCIClass::sendCommand(uint16_t opcode, uint8_t plen, void* parameters)
   return _cmdCompleteStatus;
 }
 
-void HCIClass::handleAclDataPkt(uint8_t /*plen*/, uint8_t pdata[])
+void HCIClass::handleAclDataPkt(uint8_t plen, uint8_t pdata[])
 {
-  struct __attribute__ ((packed)) HCIACLHdr {
-    uint16_t handle;
-    uint16_t dlen;
-    uint16_t len;
-    uint16_t cid;
-  } *aclHdr = (HCIACLHdr*)pdata;
+  HCIAclHdr aclHdr;
+  L2CAPHdr l2capHdr;
 
   KeepAlive = millis();     // paulvha
 
-  uint16_t aclFlags = (aclHdr->handle & 0xf000) >> 12;
-
-  if ((aclHdr->dlen - 4) != aclHdr->len) {
-    // packet is fragmented
-    if (aclFlags != 0x01) {
-      // copy into ACL buffer
-      memcpy(_aclPktBuffer, &_recvBuffer[1], sizeof(HCIACLHdr) + aclHdr->dlen - 4);
-    } else {
-      // copy next chunk into the buffer
-      HCIACLHdr* aclBufferHeader = (HCIACLHdr*)_aclPktBuffer;
+  // changed paulvha : decode with bounds checks instead of casting the receive buffer
+  if (!hciDecodeAclHdr(pdata, plen, aclHdr)) {
+    return; // truncated, drop
+  }
 
-      memcpy(&_aclPktBuffer[sizeof(HCIACLHdr) + aclBufferHeader->dlen - 4], &_recvBuffer[1 + sizeof(aclHdr->handle) + sizeof(aclHdr->dlen)], aclHdr->dlen);
+  uint8_t* l2cap = &pdata[HCI_ACL_HDR_SIZE];
+  uint16_t l2capLen = aclHdr.dlen;
 
-      aclBufferHeader->dlen += aclHdr->dlen;
-      aclHdr = aclBufferHeader;
+  if (aclHdr.flags == HCI_ACL_CONT) {
+    // copy next chunk into the buffer
+    if (_aclPktLength == 0 || _aclPktLength + aclHdr.dlen > sizeof(_aclPktBuffer)) {
+      _aclPktLength = 0;
+      return; // no start or too long, drop
     }
+
+    memcpy(&_aclPktBuffer[_aclPktLength], l2cap, aclHdr.dlen);
+    _aclPktLength += aclHdr.dlen;
+
+    l2cap = _aclPktBuffer;
+    l2capLen = _aclPktLength;
+  }
+  else {
+    // a new start drops an incomplete packet
+    _aclPktLength = 0;
   }
 
-  if ((aclHdr->dlen - 4) != aclHdr->len) {
+  if (!l2capDecodeHdr(l2cap, l2capLen, l2capHdr) || l2capHdr.len > l2capLen - L2CAP_HDR_SIZE) {
 #ifdef _BLE_TRACE_
     Serial.println("Don't have full packet yet");
-    Serial.print("Handle: ");
-    btct.printBytes((uint8_t*)&aclHdr->handle,2);
+    Serial.print("Handle: 0x");
+    Serial.println(aclHdr.handle, HEX);
     Serial.print("dlen: ");
-    btct.printBytes((uint8_t*)&aclHdr->dlen,2);
+    Serial.println(l2capLen);
     Serial.print("len: ");
-    btct.printBytes((uint8_t*)&aclHdr->len,2);
-    Serial.print("cid: ");
-    btct.printBytes((uint8_t*)&aclHdr->cid,2);
+    Serial.println(l2capHdr.len);
 #endif
+    // packet is fragmented, keep the first part
+    if (aclHdr.flags != HCI_ACL_CONT && l2capLen <= sizeof(_aclPktBuffer)) {
+      memcpy(_aclPktBuffer, l2cap, l2capLen);
+      _aclPktLength = l2capLen;
+    }
+
     // don't have the full packet yet
     return;
   }
 
-  if (aclHdr->cid == ATT_CID) { //0x0004
-    if (aclFlags == 0x01) {
-      // use buffered packet
-      ATT.handleData(aclHdr->handle & 0x0fff, aclHdr->len, &_aclPktBuffer[sizeof(HCIACLHdr)]);
-    } else {
-      // use the recv buffer
-      ATT.handleData(aclHdr->handle & 0x0fff, aclHdr->len, &_recvBuffer[1 + sizeof(HCIACLHdr)]);
-    }
-  } else if (aclHdr->cid == SIGNALING_CID) {
+  _aclPktLength = 0;
+
+  uint16_t handle = aclHdr.handle;
+  uint8_t* data = &l2cap[L2CAP_HDR_SIZE];
+
+  if (l2capHdr.cid == ATT_CID) { //0x0004
+    ATT.handleData(handle, l2capHdr.len, data);
+  } else if (l2capHdr.cid == SIGNALING_CID) {
 #ifdef _BLE_TRACE_
     Serial.println("Signalling");
 #endif
 
-    L2CAPSignaling.handleData(aclHdr->handle & 0x0fff, aclHdr->len, &_recvBuffer[1 + sizeof(HCIACLHdr)]);
-  } else if (aclHdr->cid == SECURITY_CID){
+    L2CAPSignaling.handleData(handle, l2capHdr.len, data);
+  } else if (l2capHdr.cid == SECURITY_CID){
     // Security manager
 
 #ifdef _BLE_TRACE_
     Serial.println("Security data");
 #endif
-    if (aclFlags == 0x1){
-      L2CAPSignaling.handleSecurityData(aclHdr->handle & 0x0fff, aclHdr->len, &_aclPktBuffer[sizeof(HCIACLHdr)]);
-    }else{
-      L2CAPSignaling.handleSecurityData(aclHdr->handle & 0x0fff, aclHdr->len, &_recvBuffer[1 + sizeof(HCIACLHdr)]);
-    }
+    L2CAPSignaling.handleSecurityData(handle, l2capHdr.len, data);
 
   }else {
     struct __attribute__ ((packed)) {
@@ -820,13 +874,13 @@ void HCIClass::handleAclDataPkt(uint8_t /*plen*/, uint8_t pdata[])
       uint16_t reason;
       uint16_t localCid;
       uint16_t remoteCid;
-    } l2capRejectCid= { 0x01, 0x00, 0x006, 0x0002, aclHdr->cid, 0x0000 };
+    } l2capRejectCid= { 0x01, 0x00, 0x006, 0x0002, l2capHdr.cid, 0x0000 };
 #ifdef _BLE_TRACE_
     Serial.print("rejecting packet cid: 0x");
-    Serial.println(aclHdr->cid,HEX);
+    Serial.println(l2capHdr.cid,HEX);
 #endif
 
-    sendAclPkt(aclHdr->handle & 0x0fff, 0x0005, sizeof(l2capRejectCid), &l2capRejectCid);
+    sendAclPkt(handle, 0x0005, sizeof(l2capRejectCid), &l2capRejectCid);
   }
 }
 
@@ -998,20 +1052,26 @@ void HCIClass::handleEventPkt(uint8_t /*plen*/, uint8_t pdata[])
   else if (eventHdr->evt == EVT_NUM_COMP_PKTS)
   {
 
-    uint8_t numHandles = pdata[sizeof(HCIEventHdr)];
-    uint16_t* data = (uint16_t*)&pdata[sizeof(HCIEventHdr) + sizeof(numHandles)];
+    ByteReader r(&pdata[sizeof(HCIEventHdr)], eventHdr->plen);
+    uint8_t numHandles = r.u8();
 
     for (uint8_t i = 0; i < numHandles; i++) {
-      handleNumCompPkts(data[0], data[1]);
+      uint16_t handle = r.u16();
+      uint16_t numPkts = r.u16();
+
+      if (!r.ok()) {
+        break;  // truncated event
+      }
+
+      handleNumCompPkts(handle, numPkts);
 #ifdef _BLE_TRACE_
       Serial.print("Outstanding packets: ");
       Serial.println(_pendingPkt);
       Serial.print("Data[0]: 0x");
-      Serial.println(data[0]);
+      Serial.println(handle);
       Serial.print("Data[1]: 0x");
-      Serial.println(data[1]);
+      Serial.println(numPkts);
 #endif
-      data += 2;
     }
   }
   else if(eventHdr->evt == EVT_RETURN_LINK_KEYS)
@@ -20,6 +20,9 @@
 #ifndef _HCI_H_
 #define _HCI_H_
 
+#define HCI_AVAILABLE_PACKETS     // HCI.availablePackets() exists, special paulvha
+#define HCI_LINK_UPDATE           // HCI.leSetPhy(), leSetDataLength() and BLEDevice.updateConnection() exist, special paulvha
+
 #include <Arduino.h>
 #include "bitDescriptions.h"
 
@@ -120,6 +123,16 @@ public:
   // special paulvha : set TX power Feb 2025
   virtual bool setTXPower(uint8_t TXpower);
 
+  // special paulvha : free ACL buffers of the controller (LE Read Buffer Size minus the
+  // packets not yet in Number Of Completed Packets), for flow control. October 2026
+  virtual uint8_t availablePackets();
+
+  // special paulvha : change a connection while connected, e.g. for a bulk transfer. October 2026
+  // phys is a bit per PHY (0x01 1M, 0x02 2M), the controller picks one. A controller without it
+  // answers with an error, the connection stays as it is.
+  virtual int leSetPhy(uint16_t handle, uint8_t txPhys, uint8_t rxPhys);
+  virtual int leSetDataLength(uint16_t handle, uint16_t txOctets);
+
   // TODO: Send command be private again & use ATT implementation of send command within ATT.
   virtual int sendCommand(uint16_t opcode, uint8_t plen = 0, void* parameters = NULL);
   uint8_t remotePublicKeyBuffer[64];
@@ -162,6 +175,7 @@ private:
   uint8_t _pendingPkt;
 
   uint8_t _aclPktBuffer[255];
+  uint16_t _aclPktLength;     // bytes of a fragmented L2CAP packet in _aclPktBuffer
 };
 
 extern HCIClass& HCI;
@@ -38,9 +38,6 @@
 
 #include <Arduino.h>
 #include "HCIExactleTransport.h"
-#include "RingBuffer.h"
-
-RingBufferN<256> _rxBuf;
 
 #ifdef __cplusplus
 extern "C"
@@ -70,8 +67,13 @@ ERROR: EXACTLE IMPLEMENTATION ONLY WORKS WITH ZERO COPY
 /* avoid many small allocs (and WSF doesn't have smaller buffers) */
 #define MIN_WSF_ALLOC (16)
 
+/* binary tracing : WsfTokenService() calls per poll(), a record takes 2 (added paulvha) */
+#define TRACE_SERVICE_PER_POLL (8)
+
 HCIExactleTransportClass::HCIExactleTransportClass() :
-  _begun(false) // not begun yet
+  _begun(false), // not begun yet
+  _rxLen(0),
+  _rxPos(0)
 {
 }
 
@@ -81,7 +83,8 @@ HCIExactleTransportClass::~HCIExactleTransportClass()
 
 int HCIExactleTransportClass::begin()
 {
-  _rxBuf.clear();
+  _rxLen = 0;
+  _rxPos = 0;
 
 #if PRINT_DEBUG_TRACE
   WsfTraceRegisterHandler(traceCback);    // will set in wsf_trace.c generic
@@ -99,9 +102,10 @@ int HCIExactleTransportClass::begin()
   exactle_init();
 
   //
-  // set on data received is called
+  // received packets are taken from the driver ring in nextPacket()
+  // changed paulvha / October 2026
   //
-  HciDrvset_data_received_handler(HCIExactleTransportClass::onDataReceived);
+  HciDrvset_data_received_handler(NULL);
 
   _begun = true;                    // all is ready to go
 
@@ -140,28 +144,46 @@ void HCIExactleTransportClass::wait(unsigned long timeout)
   }
 }
 
-// check for data in the RXbuffer
+// take the next packet from the driver ring if the current one has been read
+// return true if there is data to read
+bool HCIExactleTransportClass::nextPacket()
+{
+  if (_rxPos < _rxLen) return true;
+
+  _rxLen = HciDrvReadPacket(_rxPkt, sizeof(_rxPkt));
+  _rxPos = 0;
+
+  return _rxLen > 0;
+}
+
+// check for data in the current packet or the driver ring
 // if nothing trigger the timers and driver
 int HCIExactleTransportClass::available()
 {
-  if (_rxBuf.available())  return _rxBuf.available();
+  if (nextPacket())  return _rxLen - _rxPos;
 
   // trigger BLE driver
   poll();
 
-  return _rxBuf.available();
+  nextPacket();
+
+  return _rxLen - _rxPos;
 }
 
-// peek for first data in RXbuffer
+// peek for first data
 int HCIExactleTransportClass::peek()
 {
-  return _rxBuf.peek();
+  if (!nextPacket()) return -1;
+
+  return _rxPkt[_rxPos];
 }
 
-// read from RXbuffer data
+// read data
 int HCIExactleTransportClass::read()
 {
-  return _rxBuf.read_char();
+  if (!nextPacket()) return -1;
+
+  return _rxPkt[_rxPos++];
 }
 
 // write data to BLE
@@ -199,30 +221,9 @@ size_t HCIExactleTransportClass::write(const uint8_t* data, size_t length)
   return retLen;
 }
 
-// store received data in the _rxBuf, taken from HCICordioTransport.cpp
-// _rxbuf is a ring buffer 256
-void HCIExactleTransportClass::handleRxData(uint8_t* data, uint8_t len)
-{
-  // patch #96 not loosing data
-  while (_rxBuf.availableForStore() < len) {
-    // Wait for free space on RingBuffer
-    yield();
-  }
-
-  for (int i = 0; i < len; i++) {
-    _rxBuf.store_char(data[i]);
-  }
-}
-
 HCIExactleTransportClass HCIExactleTransport;
 HCITransportInterface& HCITransport = HCIExactleTransport;
 
-// call back from lower stacklevel calls function above
-void HCIExactleTransportClass::onDataReceived(uint8_t* data, uint8_t len)
-{
-  HCIExactleTransport.handleRxData(data, len);
-}
-
 //*****************************************************************************
 //
 // This routine will trigger WSF event handler
@@ -233,9 +234,32 @@ bool
 HCIExactleTransportClass::poll()
 {
     wsfOsDispatcher();
+
+#if WSF_TOKEN_ENABLED == TRUE
+    // send pending binary trace records, a few per call to not hold up the sketch
+    for (int i = 0; i < TRACE_SERVICE_PER_POLL; i++) {
+        if (! WsfTokenService()) break;
+    }
+#endif
+
     return(true);
 }
 
+#if WSF_TOKEN_ENABLED == TRUE
+/***********************************************************************************************
+ *!
+ * Output for binary trace records (compile with -DWSF_TOKEN_ENABLED=TRUE and -DHCI_TRACE_ENABLED
+ * for HCI packets). The records are written to Serial as frames with a sync byte, length and
+ * checksum, so they can be mixed with prints of the sketch. Capture them on a Linux box and
+ * decode with exactleP/extras/wsf-trace-decoder.py
+ *
+ ***********************************************************************************************/
+extern "C" uint8_t WsfTokenIOWrite(uint8_t *pBuf, uint8_t len)
+{
+    return (uint8_t) Serial.write(pBuf, len);
+}
+#endif // WSF_TOKEN_ENABLED
+
 //*****************************************************************************
 //
 // WSF buffer pools.
@@ -48,12 +48,17 @@ public:
   virtual bool setTXPower(uint8_t TXpower);
 
 private:
-  static void onDataReceived(uint8_t* data, uint8_t len);
-  void handleRxData(uint8_t* data, uint8_t len);
+  bool nextPacket();
 
 private:
   bool _begun;
 
+  // packet taken from the receive ring of the driver (HCI packet type first)
+  // size is HCI_DRV_MAX_RX_PACKET of exactleP hci_drv_apollo.h
+  uint8_t _rxPkt[256];
+  uint16_t _rxLen;
+  uint16_t _rxPos;
+
 };
 
 // ExactLE specific calls
@@ -32,7 +32,8 @@ L2CAPSignalingClass::L2CAPSignalingClass() :
   _minInterval(0),
   _maxInterval(0),
   _supervisionTimeout(0),
-  _pairing_enabled(1)
+  _pairing_enabled(1),
+  _identifier(1)
 {
 }
 
@@ -84,6 +85,28 @@ void L2CAPSignalingClass::addConnection(uint16_t handle, uint8_t role, uint8_t /
   }
 }
 
+// special paulvha : the central answers with CONNECTION_PARAMETER_UPDATE_RESPONSE, then the link
+// layer uses the new parameters some connection events later. October 2026
+int L2CAPSignalingClass::connectionParameterRequest(uint16_t handle, uint16_t minInterval, uint16_t maxInterval,
+                                                    uint16_t latency, uint16_t supervisionTimeout)
+{
+  // 0 is not a valid identifier
+  if (++_identifier == 0) _identifier = 1;
+
+  struct __attribute__ ((packed)) L2CAPConnectionParameterUpdateRequest {
+    uint8_t code;
+    uint8_t identifier;
+    uint16_t length;
+    uint16_t minInterval;
+    uint16_t maxInterval;
+    uint16_t latency;
+    uint16_t supervisionTimeout;
+  } request = { CONNECTION_PARAMETER_UPDATE_REQUEST, _identifier, 8,
+                minInterval, maxInterval, latency, supervisionTimeout };
+
+  return HCI.sendAclPkt(handle, SIGNALING_CID, sizeof(request), &request);
+}
+
 void L2CAPSignalingClass::handleData(uint16_t connectionHandle, uint8_t dlen, uint8_t data[])
 {
   struct __attribute__ ((packed)) L2CAPSignalingHdr {
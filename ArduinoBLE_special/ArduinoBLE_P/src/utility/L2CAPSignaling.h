@@ -70,6 +70,10 @@ public:
   virtual void setConnectionInterval(uint16_t minInterval, uint16_t maxInterval);
 
   virtual void setSupervisionTimeout(uint16_t supervisionTimeout);
+
+  // special paulvha : as peripheral, ask the central for other parameters while connected. October 2026
+  virtual int connectionParameterRequest(uint16_t handle, uint16_t minInterval, uint16_t maxInterval,
+                                         uint16_t latency, uint16_t supervisionTimeout);
   
   virtual void setPairingEnabled(uint8_t enabled);
   virtual bool isPairingEnabled();
@@ -89,6 +93,7 @@ private:
   uint16_t _maxInterval;
   uint16_t _supervisionTimeout;
   uint8_t _pairing_enabled;
+  uint8_t _identifier;                  // special paulvha
 };
 
 extern L2CAPSignalingClass& L2CAPSignaling;
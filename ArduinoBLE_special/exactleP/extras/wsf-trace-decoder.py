@@ -0,0 +1,234 @@
+'''
+Decode a binary WSF trace dump (WSF_TOKEN_ENABLED) into text, Btsnoop and/or pcap files.
+
+The dump is the byte stream written by WsfTokenIOWrite() (e.g. captured from the serial port
+with : cat /dev/ttyUSB0 > trace.bin). Each record is a frame :
+
+  0xA5, length of the record (2 bytes little endian), the record, checksum (inverted sum of the
+  record bytes)
+
+Bytes between the frames (prints of the sketch) are skipped, a frame with a wrong checksum or
+length as well. A record is one or more slots of 8 bytes : uint32 token, uint32 param (little
+endian).
+
+  token with bit 31 set : HCI packet header. bits 16-23 type (bit 7 = received), bits 0-15 length
+                          param is the timestamp, followed by (length + 7) / 8 slots of packet data
+  token with bit 30 set : timestamp in param, the next slot holds token and param of a trace
+  bit 28                : one or more records were lost before this record (ring buffer full)
+  other                 : token ((line << 16) | module id) and param of a WSF_TRACE message
+
+The messages of the tokens come from a map made with wsf-trace-tokens.py (-m). The param holds
+WSF_TRACE1 : var1, WSF_TRACE2 : var1 (16 bits) and var2 << 16, WSF_TRACE3 : 3 x 8 bits.
+
+Btsnoop file format reference
+ https://www.fte.com/WebHelpII/Sodera/Content/Technical_Information/BT_Snoop_File_Format.htm
+pcap is written with linktype 201 (LINKTYPE_BLUETOOTH_HCI_H4_WITH_PHDR)
+
+paulvha / version 1.1 October 2026 : frames, map from wsf-trace-tokens.py
+'''
+
+import argparse
+import re
+import struct
+import sys
+
+FLAG_PACKET    = 1 << 31
+FLAG_TIME      = 1 << 30
+FLAG_FLOW_CTRL = 1 << 28
+PKT_RX         = 0x80
+
+SLOT_SIZE      = 8
+
+FRAME_SYNC     = 0xa5
+FRAME_HDR      = 3
+MAX_RECORD     = 0x1000     # larger than any ring buffer, a longer length is not a frame
+
+# Btsnoop timestamps are microseconds since 0 AD, this is 1-1-1970
+BTSNOOP_EPOCH  = 0x00dcddb30f2f8000
+
+HCI_TYPES = {1: "COMMAND", 2: "ACL", 3: "SCO", 4: "EVENT"}
+
+parser = argparse.ArgumentParser()
+parser.add_argument('-i', dest='inputPath', type=str, required=True, help='input file containing binary trace dump')
+parser.add_argument('-t', dest='textPath', type=str, help='result file for human readable text (default stdout)')
+parser.add_argument('-b', dest='btsnoopPath', type=str, help='result file that will contain the btsnoop encoded packets')
+parser.add_argument('-p', dest='pcapPath', type=str, help='result file that will contain the pcap encoded packets')
+parser.add_argument('-m', dest='mapPath', type=str, help='token map file from wsf-trace-tokens.py. Each line: module-id line message')
+parser.add_argument('-r', dest='tickRate', type=int, default=3000000, help='timestamp ticks per second (default 3000000)')
+args = parser.parse_args()
+
+# read token map : "module line message" => message is used as format with the param
+# "# module id file" gives the source file of a module
+def readTokenMap(mapPath):
+  tokenMap = {}
+  modules = {}
+  if mapPath is None:
+    return tokenMap, modules
+  with open(mapPath, 'r') as mapFile:
+    for mapLine in mapFile:
+      items = mapLine.strip().split(None, 2)
+      if len(items) == 3 and items[0] == '#' and items[1] == 'module':
+        module = items[2].split(None, 1)
+        if len(module) == 2:
+          modules[int(module[0], 0)] = module[1]
+        continue
+      if len(items) < 3 or items[0].startswith('#'):
+        continue
+      tokenMap[(int(items[0], 0), int(items[1], 0))] = items[2]
+  return tokenMap, modules
+
+# make a 32 bit wrapping timestamp monotonic
+class Clock:
+  def __init__(self, tickRate):
+    self.tickRate = tickRate
+    self.last = None
+    self.wraps = 0
+
+  def toMicros(self, ticks):
+    if self.last is not None and ticks < self.last:
+      self.wraps += 1
+    self.last = ticks
+    return ((self.wraps << 32) + ticks) * 1000000 // self.tickRate
+
+# take the records out of the frames, skipping other bytes
+def readFrames(stream):
+  frames = []
+  skipped = 0
+  i = 0
+  while i + FRAME_HDR < len(stream):
+    if stream[i] != FRAME_SYNC:
+      i += 1
+      skipped += 1
+      continue
+    length = stream[i + 1] | (stream[i + 2] << 8)
+    end = i + FRAME_HDR + length
+    if length == 0 or length % SLOT_SIZE or length > MAX_RECORD or end >= len(stream) or \
+       stream[end] != (~sum(stream[i + FRAME_HDR : end])) & 0xff:
+      i += 1
+      skipped += 1
+      continue
+    frames.append(stream[i + FRAME_HDR : end])
+    i = end + 1
+  if skipped:
+    sys.stderr.write("%d bytes outside trace frames skipped\n" % skipped)
+  return frames
+
+# split the dump in records : ('packet', micros, type, data, lost) or ('token', micros, module, line, param, lost)
+def decodeRecords(frames, clock):
+  records = []
+  for frame in frames:
+    records.extend(decodeRecord(frame, clock))
+  return records
+
+def decodeRecord(dump, clock):
+  records = []
+  slots = len(dump) // SLOT_SIZE
+  i = 0
+  while i < slots:
+    token, param = struct.unpack_from('<II', dump, i * SLOT_SIZE)
+    lost = (token & FLAG_FLOW_CTRL) != 0
+    i += 1
+
+    if token & FLAG_PACKET:
+      length = token & 0xffff
+      dataSlots = (length + SLOT_SIZE - 1) // SLOT_SIZE
+      if i + dataSlots > slots:
+        break
+      data = dump[i * SLOT_SIZE : i * SLOT_SIZE + length]
+      i += dataSlots
+      records.append(('packet', clock.toMicros(param), (token >> 16) & 0xff, data, lost))
+
+    elif token & FLAG_TIME:
+      if i >= slots:
+        break
+      micros = clock.toMicros(param)
+      token, param = struct.unpack_from('<II', dump, i * SLOT_SIZE)
+      i += 1
+      records.append(('token', micros, token & 0xffff, (token >> 16) & 0xfff, param, lost))
+
+    else:
+      # token without timestamp (older firmware)
+      records.append(('token', None, token & 0xffff, (token >> 16) & 0xfff, param, lost))
+
+  return records
+
+# the values of a WSF_TRACE1/2/3 from the param, the number of conversions in msg tells which
+def unpackParam(msg, param):
+  count = len(re.findall(r'%[-+ #0]*\d*(?:\.\d+)?[hlL]*[diouxXcs]', msg))
+  if count == 2:
+    return (param & 0xffff, param >> 16)
+  if count == 3:
+    return (param & 0xff, (param >> 8) & 0xff, (param >> 16) & 0xff)
+  return (param,) if count == 1 else ()
+
+def formatToken(tokenMap, modules, module, line, param):
+  msg = tokenMap.get((module, line))
+  if msg is None:
+    if module in modules:
+      return "TOKEN %s:%d param 0x%08x" % (modules[module], line, param)
+    return "TOKEN module %d line %d param 0x%08x" % (module, line, param)
+  try:
+    return msg % unpackParam(msg, param)
+  except (TypeError, ValueError):
+    return "%s 0x%08x" % (msg, param)
+
+def writeText(records, tokenMap, modules, textFile):
+  for record in records:
+    if record[0] == 'packet':
+      kind, micros, hciType, data, lost = record
+      direction = "RX" if hciType & PKT_RX else "TX"
+      name = HCI_TYPES.get(hciType & ~PKT_RX, "TYPE%02X" % (hciType & ~PKT_RX))
+      line = "%12.6f HCI %s %s %d %s" % (micros / 1e6, name, direction, len(data), data.hex())
+    else:
+      kind, micros, module, srcLine, param, lost = record
+      stamp = "%12.6f" % (micros / 1e6) if micros is not None else " " * 12
+      line = "%s %s" % (stamp, formatToken(tokenMap, modules, module, srcLine, param))
+    if lost:
+      textFile.write("             ** trace records lost **\n")
+    textFile.write(line + "\n")
+
+def buildBinaryHeader():
+  return b'btsnoop\0' + struct.pack('>II', 1, 1002)
+
+def writeBtsnoop(records, outputPath):
+  with open(outputPath, 'wb') as outputFile:
+    outputFile.write(buildBinaryHeader())
+    for record in records:
+      if record[0] != 'packet':
+        continue
+      kind, micros, hciType, data, lost = record
+      h4 = bytes([hciType & ~PKT_RX]) + data
+      commandFlag = 1 if (hciType & ~PKT_RX) in (1, 4) else 0
+      directionFlag = 1 if hciType & PKT_RX else 0
+      outputFile.write(struct.pack('>IIIIq', len(h4), len(h4), (commandFlag * 2) + directionFlag,
+                                   1 if lost else 0, BTSNOOP_EPOCH + micros))
+      outputFile.write(h4)
+
+def writePcap(records, outputPath):
+  with open(outputPath, 'wb') as outputFile:
+    outputFile.write(struct.pack('<IHHiIII', 0xa1b2c3d4, 2, 4, 0, 0, 65535, 201))
+    for record in records:
+      if record[0] != 'packet':
+        continue
+      kind, micros, hciType, data, lost = record
+      frame = struct.pack('>I', 1 if hciType & PKT_RX else 0) + bytes([hciType & ~PKT_RX]) + data
+      outputFile.write(struct.pack('<IIII', micros // 1000000, micros % 1000000, len(frame), len(frame)))
+      outputFile.write(frame)
+
+# Run
+with open(args.inputPath, 'rb') as inputFile:
+  traceRecords = decodeRecords(readFrames(inputFile.read()), Clock(args.tickRate))
+
+traceMap, traceModules = readTokenMap(args.mapPath)
+
+if args.textPath:
+  with open(args.textPath, 'w') as textOut:
+    writeText(traceRecords, traceMap, traceModules, textOut)
+elif not args.btsnoopPath and not args.pcapPath:
+  writeText(traceRecords, traceMap, traceModules, sys.stdout)
+
+if args.btsnoopPath:
+  writeBtsnoop(traceRecords, args.btsnoopPath)
+
+if args.pcapPath:
+  writePcap(traceRecords, args.pcapPath)
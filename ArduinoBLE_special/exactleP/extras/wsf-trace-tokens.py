@@ -0,0 +1,143 @@
+'''
+Make the token map for wsf-trace-decoder.py (-m) from the sources.
+
+With WSF_TOKEN_ENABLED a trace call only stores a token : (line << 16) | MODULE_ID, and its
+parameters. This script finds the trace calls (WSF_TRACE0..3 and the <SUBSYS>_TRACE_<STAT>0..3
+macros) in the .c and .cpp files and writes one line per call :
+
+  module line subsys stat message
+
+and a line "# module <id> <file>" per source file. Each source file with trace calls needs its
+own MODULE_ID, defined before the includes :
+
+  #define MODULE_ID   5
+
+A file without one uses 0 (warning), two files with the same id is an error.
+
+  python3 wsf-trace-tokens.py -o tokens.map          (scans exactleP, the parent of extras)
+  python3 wsf-trace-tokens.py -o tokens.map ../sw ../../ArduinoBLE_P/src
+  python3 wsf-trace-decoder.py -i trace.bin -m tokens.map
+
+The line is the line of the macro name (as __LINE__ in the token), only 12 bits are kept.
+
+paulvha / October 2026 / version 1.0
+'''
+
+import argparse
+import os
+import re
+import sys
+
+SOURCE_EXT = ('.c', '.cpp')
+
+MODULE_RE = re.compile(r'^\s*#\s*define\s+MODULE_ID\s+(\w+)', re.M)
+WSF_RE    = re.compile(r'\bWSF_TRACE([0-3])\s*\(\s*"([^"]*)"\s*,\s*"([^"]*)"\s*,\s*"((?:[^"\\]|\\.)*)"')
+SUBSYS_RE = re.compile(r'\b([A-Z0-9]+)_TRACE_([A-Z]+)([0-3])\s*\(\s*"((?:[^"\\]|\\.)*)"')
+
+parser = argparse.ArgumentParser()
+parser.add_argument('paths', nargs='*', help='directories or files to scan (default exactleP)')
+parser.add_argument('-o', dest='outputPath', type=str, help='token map file (default stdout)')
+args = parser.parse_args()
+
+# blank out comments, keep strings and the line numbers
+def stripComments(text):
+  out = []
+  i = 0
+  n = len(text)
+  while i < n:
+    c = text[i]
+    if c == '"' or c == "'":
+      j = i + 1
+      while j < n and text[j] != c and text[j] != '\n':
+        j += 2 if text[j] == '\\' else 1
+      out.append(text[i:j + 1])
+      i = j + 1
+    elif text.startswith('//', i):
+      j = text.find('\n', i)
+      i = n if j < 0 else j
+    elif text.startswith('/*', i):
+      j = text.find('*/', i + 2)
+      j = n if j < 0 else j + 2
+      out.append('\n' * text.count('\n', i, j))
+      i = j
+    else:
+      out.append(c)
+      i += 1
+  return ''.join(out)
+
+def lineOf(text, pos):
+  return text.count('\n', 0, pos) + 1
+
+def sourceFiles(paths):
+  for path in paths:
+    if os.path.isfile(path):
+      yield path
+      continue
+    for root, dirs, files in os.walk(path):
+      dirs.sort()
+      for name in sorted(files):
+        if name.endswith(SOURCE_EXT):
+          yield os.path.join(root, name)
+
+# returns (module id or None, [(line, subsys, stat, message)])
+def scanFile(path):
+  with open(path, 'r', errors='replace') as sourceFile:
+    text = stripComments(sourceFile.read())
+
+  module = MODULE_RE.search(text)
+  calls = []
+
+  for m in WSF_RE.finditer(text):
+    calls.append((lineOf(text, m.start()), m.group(2), m.group(3), m.group(4)))
+
+  for m in SUBSYS_RE.finditer(text):
+    calls.append((lineOf(text, m.start()), m.group(1), m.group(2), m.group(4)))
+
+  return (int(module.group(1), 0) if module else None), sorted(calls)
+
+def main():
+  base = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..')
+  paths = args.paths if args.paths else [base]
+  owners = {}
+  lines = []
+  errors = 0
+
+  for path in sourceFiles(paths):
+    module, calls = scanFile(path)
+    if not calls:
+      continue
+
+    name = os.path.relpath(path, base)
+
+    if module is None:
+      sys.stderr.write("warning: %s has trace calls but no MODULE_ID, using 0\n" % name)
+      module = 0
+
+    if module in owners:
+      sys.stderr.write("error: MODULE_ID %d in %s and %s\n" % (module, owners[module], name))
+      errors += 1
+      continue
+
+    owners[module] = name
+    lines.append("# module %d %s" % (module, name))
+
+    seen = {}
+    for line, subsys, stat, message in calls:
+      token = line & 0xfff
+      if token in seen and seen[token] != line:
+        sys.stderr.write("warning: %s lines %d and %d give the same token\n" % (name, seen[token], line))
+      seen[token] = line
+      lines.append("%d %d %s %s %s" % (module, token, subsys, stat, message))
+
+  if errors:
+    return 1
+
+  if args.outputPath:
+    with open(args.outputPath, 'w') as mapFile:
+      mapFile.write('\n'.join(lines) + '\n')
+  else:
+    sys.stdout.write('\n'.join(lines) + '\n')
+
+  return 0
+
+sys.exit(main())
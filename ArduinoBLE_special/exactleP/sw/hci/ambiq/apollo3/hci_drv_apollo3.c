@@ -47,20 +47,26 @@
 //  Stripped out much of the unnecessary stuff / February  2023 /paulvha
 //*****************************************************************************
 
+/* module id in binary trace tokens, unique per file (extras/wsf-trace-tokens.py), added paulvha */
+#define MODULE_ID   5
+
 #include <stdint.h>
 #include <stdbool.h>
 
 #include "wsf_types.h"
 #include "wsf_timer.h"
 #include "bstream.h"
+#include "pkt_ring.h"
 #include "wsf_msg.h"
 #include "wsf_trace.h"
 #include "wsf_cs.h"
+#include "hci_defs.h"
 #include "hci_drv.h"
 #include "hci_drv_apollo.h"
 #include "am_mcu_apollo.h"
 #include "am_util.h"
 #include "hci_drv_apollo3.h"
+#include "hci_drv_write_queue.h"
 
 #include <string.h>
 
@@ -69,28 +75,36 @@
 // Configurable buffer sizes.
 //
 //*****************************************************************************
-#define NUM_HCI_WRITE_BUFFERS           8
-#define HCI_DRV_MAX_TX_PACKET           256
-#define HCI_DRV_MAX_RX_PACKET           256
+#define NUM_HCI_WRITE_BUFFERS           HCI_DRV_WQ_NUM_PACKETS
+#define HCI_DRV_MAX_TX_PACKET           HCI_DRV_WQ_MAX_PACKET
 
-//*****************************************************************************
-//
-// Configurable error-detection thresholds.
+// byte limit to coalesce queued packets in one write, 0 is one packet per
+// write. Can be changed with HciDrvSetWriteCoalesce() (added paulvha / October 2026)
 //
-//*****************************************************************************
-#define HCI_DRV_MAX_XTAL_RETRIES         10
+// EXPERIMENTAL, off by default : it is not verified on hardware that the
+// Apollo3 BLE controller accepts more than one HCI packet, or more than 256
+// bytes, in one SPI write. Only tested on the mock bus of the host tests.
+// Check the controller keeps responding before using it.
+#ifndef HCI_DRV_TX_COALESCE
+#define HCI_DRV_TX_COALESCE             0
+#endif
+
+// received packets wait here for the host (added paulvha / October 2026)
+#ifndef HCI_DRV_RX_RING_SIZE
+#define HCI_DRV_RX_RING_SIZE            2048
+#endif
+
+#if (HCI_DRV_RX_RING_SIZE & (HCI_DRV_RX_RING_SIZE - 1)) != 0 || \
+    HCI_DRV_RX_RING_SIZE < (HCI_DRV_MAX_RX_PACKET + PKT_RING_HDR_LEN)
+#error "HCI_DRV_RX_RING_SIZE must be a power of two and hold a packet of HCI_DRV_MAX_RX_PACKET"
+#endif
 
 //*****************************************************************************
 //
-// Structure for holding outgoing HCI packets.
+// Configurable error-detection thresholds.
 //
 //*****************************************************************************
-typedef struct
-{
-    uint32_t ui32Length;
-    uint32_t pui32Data[HCI_DRV_MAX_TX_PACKET / 4];
-}
-hci_drv_write_t;
+#define HCI_DRV_MAX_XTAL_RETRIES         10
 
 //*****************************************************************************
 //
@@ -110,14 +124,22 @@ wsfHandlerId_t g_HciDrvHandleID = 0;
 // store call back to ArduinoBLE
 data_received_handler_t data_received_handler;
 
-// Buffers for HCI write data.
-hci_drv_write_t g_psWriteBuffers[NUM_HCI_WRITE_BUFFERS];
-am_hal_queue_t g_sWriteQueue;
+// Buffers for HCI write data, changed paulvha / October 2026
+hci_drv_wq_t g_sWriteQueue;
+static uint32_t g_ui32WriteCoalesce = HCI_DRV_TX_COALESCE;
 
 // Buffers for HCI read data.
 uint32_t g_pui32ReadBuffer[HCI_DRV_MAX_RX_PACKET / 4];
 uint8_t *g_pui8ReadBuffer = (uint8_t *) g_pui32ReadBuffer;
-uint32_t g_ui32NumBytes   = 0;
+
+// Ring between the read callback (interrupt) and the host, changed paulvha / October 2026
+// A read is only started when the ring can hold the largest packet, so the read callback
+// never has to wait. When it can not, the read is deferred until the host takes a packet.
+static uint8_t g_pui8RxRing[HCI_DRV_RX_RING_SIZE];
+static pktRing_t g_sRxRing;
+static volatile bool g_bReadBusy     = false;
+static volatile bool g_bReadDeferred = false;
+static uint32_t g_ui32ReadDeferred   = 0;
 
 void HciDrvEmptyWriteQueue(void);
 
@@ -245,7 +267,10 @@ void
 HciDrvRadioBoot(bool bColdBoot)
 {
     uint32_t ui32NumXtalRetries = 0;
-    g_ui32NumBytes     = 0;
+
+    PktRingInit(&g_sRxRing, g_pui8RxRing, sizeof(g_pui8RxRing));
+    g_bReadBusy     = false;
+    g_bReadDeferred = false;
 
 #ifdef AM_DEBUG_BLE_TIMING    // ATP pins
     am_hal_gpio_pinconfig(28, g_AM_HAL_GPIO_OUTPUT);    // interrupt from HCI layer
@@ -389,7 +414,7 @@ HciDrvRadioBoot(bool bColdBoot)
     //
     // Initialize a queue to help us keep track of HCI write buffers.
     //
-    am_hal_queue_from_array(&g_sWriteQueue, g_psWriteBuffers);
+    HciDrvWqInit(&g_sWriteQueue, g_ui32WriteCoalesce);
 
     return;
 }
@@ -423,6 +448,62 @@ HciDrvset_data_received_handler(data_received_handler_t handler)
     data_received_handler = handler;
 }
 
+//*****************************************************************************
+//
+// Take the oldest received packet (including the HCI packet type) from the
+// ring. Called by the host when no data_received_handler is set.
+// added paulvha / October 2026
+//
+//*****************************************************************************
+uint16_t
+HciDrvReadPacket(uint8_t *pui8Buf, uint16_t ui16Size)
+{
+    uint16_t ui16Len = PktRingGet(&g_sRxRing, pui8Buf, ui16Size);
+
+    if (ui16Len == 0)
+    {
+        return 0;
+    }
+
+    //
+    // Trace the packet, the first byte is the HCI packet type
+    //
+    if (pui8Buf[0] == HCI_EVT_TYPE)
+    {
+        HCI_PDUMP_EVT(ui16Len - 1, pui8Buf + 1);
+    }
+    else
+    {
+        HCI_PDUMP_RX_ACL(ui16Len - 1, pui8Buf + 1);
+    }
+
+    //
+    // There is space again, restart reading from the controller
+    //
+    if (g_bReadDeferred)
+    {
+        WsfSetEvent(g_HciDrvHandleID, BLE_TRANSFER_NEEDED_EVENT);
+    }
+
+    return ui16Len;
+}
+
+//*****************************************************************************
+//
+// Statistics of the receive ring
+//
+//*****************************************************************************
+void
+HciDrvGetRxStats(hci_drv_rx_stats_t *psStats)
+{
+    psStats->ui32Packets      = g_sRxRing.packets;
+    psStats->ui32Dropped      = g_sRxRing.dropped;
+    psStats->ui32Truncated    = g_sRxRing.truncated;
+    psStats->ui32Deferred     = g_ui32ReadDeferred;
+    psStats->ui32HighWater    = g_sRxRing.highWater;
+    psStats->ui32RingSize     = HCI_DRV_RX_RING_SIZE;
+}
+
 //*****************************************************************************
 //
 // update BLE core to start sending data
@@ -437,7 +518,7 @@ update_wake(void)
     // We want to set WAKE if there's something in the write queue, but not if
     // SPISTATUS or IRQ is high.
     //
-    if ( !am_hal_queue_empty(&g_sWriteQueue) &&
+    if ( !HciDrvWqEmpty(&g_sWriteQueue) &&
          (BLEIFn(0)->BSTATUS_b.SPISTATUS == 0) &&
          (BLE_IRQ_CHECK() == false))
     {
@@ -466,17 +547,7 @@ update_wake(void)
 uint16_t
 hciDrvWrite(uint8_t type, uint16_t len, uint8_t *pData)
 {
-    uint8_t *pui8Wptr;
-    hci_drv_write_t *psWriteBuffer;
-
-    //
-    // Check to see if we still have buffer space.
-    //
-    if (am_hal_queue_full(&g_sWriteQueue))
-    {
-        CRITICAL_PRINT("ERROR: Ran out of HCI transmit queue slots.\n");
-        ERROR_RETURN(HCI_DRV_TRANSMIT_QUEUE_FULL, len);
-    }
+    uint32_t ui32Status;
 
     if (len > (HCI_DRV_MAX_TX_PACKET-1))  // comparison compensates for the type byte at index 0.
     {
@@ -487,25 +558,27 @@ hciDrvWrite(uint8_t type, uint16_t len, uint8_t *pData)
     }
 
     //
-    // Get a pointer to the next item in the queue.
+    // Add to the queue, with the type byte at index 0.
     //
-    psWriteBuffer = am_hal_queue_next_slot(&g_sWriteQueue);
+    ui32Status = HciDrvWqPut(&g_sWriteQueue, type, len, pData);
+
+    if (ui32Status == HCI_DRV_WQ_FULL)
+    {
+        CRITICAL_PRINT("ERROR: Ran out of HCI transmit queue slots.\n");
+        ERROR_RETURN(HCI_DRV_TRANSMIT_QUEUE_FULL, len);
+    }
 
     //
-    // Set all of the fields in the hci write structure.
+    // Trace the packet once it is queued (only with HCI_TRACE_ENABLED, binary with WSF_TOKEN_ENABLED)
     //
-    psWriteBuffer->ui32Length = len + 1;
-
-    pui8Wptr = (uint8_t *) psWriteBuffer->pui32Data;
-
-    *pui8Wptr++ = type;
-
-    for (uint32_t i = 0; i < len; i++)
+    if (type == HCI_CMD_TYPE)
     {
-        pui8Wptr[i] = pData[i];
+        HCI_PDUMP_CMD(len, pData);
+    }
+    else
+    {
+        HCI_PDUMP_TX_ACL(len, pData);
     }
-
-    am_hal_queue_item_add(&g_sWriteQueue, 0, 1);
 
     //
     // Wake up the BLE controller.
@@ -606,19 +679,21 @@ HciDrvIntService(void)
         //CRITICAL_PRINT("INFO: STATUS INTERRUPT\n");
 
         //
-        // Check the queue and send the first message we have.
+        // Check the queue and send the first message we have, or all that are
+        // waiting when coalescing (changed paulvha / October 2026)
         //
-        if ( !am_hal_queue_empty(&g_sWriteQueue) )
+        uint32_t *pui32WriteData;
+        uint32_t ui32WriteLength = HciDrvWqStart(&g_sWriteQueue, &pui32WriteData);
+
+        if ( ui32WriteLength > 0 )
         {
             uint32_t ui32WriteStatus = 0;
 
-            hci_drv_write_t *psWriteBuffer = am_hal_queue_peek(&g_sWriteQueue);
-
             ui32WriteStatus =
                 am_hal_ble_nonblocking_hci_write(BLE_P,
                                                  AM_HAL_BLE_RAW,
-                                                 psWriteBuffer->pui32Data,
-                                                 psWriteBuffer->ui32Length,
+                                                 pui32WriteData,
+                                                 ui32WriteLength,
                                                  hciDrvWriteCallback,
                                                  0);
 
@@ -652,9 +727,9 @@ hciDrvWriteCallback(uint8_t *pui8Data, uint32_t ui32Length, void *pvContext)
     //CRITICAL_PRINT("INFO: HCI physical write complete.\n");
 
     //
-    // Advance the queue.
+    // Advance the queue past all packets of the transfer.
     //
-    am_hal_queue_item_get(&g_sWriteQueue, 0, 1);
+    HciDrvWqDone(&g_sWriteQueue);
 
     while ( BLEIFn(0)->BSTATUS_b.SPISTATUS )
     {
@@ -664,7 +739,7 @@ hciDrvWriteCallback(uint8_t *pui8Data, uint32_t ui32Length, void *pvContext)
     //
     // Check the write queue, and possibly set wake again.
     //
-    if ( !am_hal_queue_empty(&g_sWriteQueue) )
+    if ( !HciDrvWqEmpty(&g_sWriteQueue) )
     {
         //
         // In this case, we need to delay before setting wake. Instead of
@@ -685,11 +760,24 @@ hciDrvReadCallback(uint8_t *pui8Data, uint32_t ui32Length, void *pvContext)
 #if AM_DEBUG_BLE_TIMING
     am_hal_gpio_state_write(23, AM_HAL_GPIO_OUTPUT_SET);
 #endif
+    // CRITICAL_PRINT("INFO: HCI physical read complete.\n");
+    //
+    // Store the packet, there is always space as that was checked before
+    // the read was started. If not, it is counted as dropped in the ring.
+    //
+    if (ui32Length > HCI_DRV_MAX_RX_PACKET)
+    {
+        g_sRxRing.dropped++;
+    }
+    else if (ui32Length > 0)
+    {
+        PktRingPut(&g_sRxRing, g_pui8ReadBuffer, (uint16_t) ui32Length);
+    }
+
     //
     // Set a "transfer needed" event.
     //
-    // CRITICAL_PRINT("INFO: HCI physical read complete.\n");
-    g_ui32NumBytes = ui32Length;
+    g_bReadBusy = false;
     WsfSetEvent(g_HciDrvHandleID, BLE_TRANSFER_NEEDED_EVENT);
 
     //
@@ -703,7 +791,7 @@ hciDrvReadCallback(uint8_t *pui8Data, uint32_t ui32Length, void *pvContext)
     //
     // Check the write queue, and possibly set wake.
     //
-    if ( !am_hal_queue_empty(&g_sWriteQueue) )
+    if ( !HciDrvWqEmpty(&g_sWriteQueue) )
     {
         am_hal_ble_wakeup_set(BLE_P, 1);
     }
@@ -728,53 +816,63 @@ HciDrvHandler(wsfEventMask_t event, wsfMsgHdr_t *pMsg)
     am_hal_gpio_state_write(22, AM_HAL_GPIO_OUTPUT_SET);
 #endif
   //
-  // Check to see if we read any bytes over the HCI interface that we haven't
-  // already sent to the BLE stack.
+  // Pass received packets to the stack if it registered a handler, else the
+  // host takes them with HciDrvReadPacket()
   //
-  if (g_ui32NumBytes > 0)
+  if (data_received_handler)
   {
-      CRITICAL_PRINT("INFO: HCI data transferred to stack.\n");
+      static uint8_t pui8Packet[HCI_DRV_MAX_RX_PACKET];
+      uint16_t ui16Len;
 
-      //
-      // Pass the data along to the stack. The stack should be able
-      // to read as much data as we send it.  If it can't, we need to
-      // know that.
-      // assume all bytes can be send
-      data_received_handler(g_pui8ReadBuffer, g_ui32NumBytes);
-
-      CRITICAL_PRINT("INFO: HCI RX packet complete.\n");
-      g_ui32NumBytes   = 0;
+      while ((ui16Len = HciDrvReadPacket(pui8Packet, sizeof(pui8Packet))) > 0)
+      {
+          CRITICAL_PRINT("INFO: HCI data transferred to stack.\n");
+          data_received_handler(pui8Packet, ui16Len);
+      }
   }
 
-  if ( BLE_IRQ_CHECK() )
+  //
+  // Set wake for packets left in the write queue, the write callback posts
+  // the event for this. (added paulvha / October 2026)
+  //
+  update_wake();
+
+  if ( BLE_IRQ_CHECK() && !g_bReadBusy )
   {
       //
-      // If the stack has used up all of the saved data we've accumulated so
-      // far, we should check to see if we need to read any *new* data.
+      // Only start a read if the ring can hold the largest packet. Else wait
+      // for the host to take packets, HciDrvReadPacket() will call us again.
+      //
+      if (PktRingSpace(&g_sRxRing) < HCI_DRV_MAX_RX_PACKET + PKT_RING_HDR_LEN)
+      {
+          if (!g_bReadDeferred)
+          {
+              g_ui32ReadDeferred++;
+              g_bReadDeferred = true;
+          }
+#if AM_DEBUG_BLE_TIMING
+    am_hal_gpio_state_write(22, AM_HAL_GPIO_OUTPUT_CLEAR);
+#endif
+          return;
+      }
+
+      g_bReadDeferred = false;
+
+      //
       // once all the data has been read it will call hciDrvReadCallback(), this will
-      // set the correct g_ui32NumBytes and call this handler again. Once called
-      // the read data is passed to the upper layer
+      // store the packet in the ring and call this handler again.
       //
       CRITICAL_PRINT("INFO: HCI Read started.\n");
+      g_bReadBusy = true;
       ui32ErrorStatus = am_hal_ble_nonblocking_hci_read(BLE_P,
                                                         g_pui32ReadBuffer,
                                                         hciDrvReadCallback,
                                                         0);
 
-      if (g_ui32NumBytes > HCI_DRV_MAX_RX_PACKET)
-      {
-          CRITICAL_PRINT("ERROR: Trying to receive an HCI packet "
-                         "larger than the hci driver buffer size "
-                         "(needs %d bytes of space).\n",
-                         g_ui32NumBytes);
-#if AM_DEBUG_BLE_TIMING
-    am_hal_gpio_state_write(22, AM_HAL_GPIO_OUTPUT_CLEAR);
-#endif
-          ERROR_CHECK_VOID(HCI_DRV_RX_PACKET_TOO_LARGE);
-      }
-
       if (ui32ErrorStatus != AM_HAL_STATUS_SUCCESS)
       {
+          g_bReadBusy = false;
+
           //
           // If the read didn't succeed for some physical reason, we need
           // to know. We shouldn't get failures here. We checked the IRQ
@@ -903,5 +1001,30 @@ HciDrvBleSleepSet(bool enable)
 void
 HciDrvEmptyWriteQueue(void)
 {
-    am_hal_queue_from_array(&g_sWriteQueue, g_psWriteBuffers);
+    // the statistics of HciDrvGetTxStats() stay
+    HciDrvWqReset(&g_sWriteQueue);
+}
+
+//*****************************************************************************
+//
+// Set the byte limit to coalesce queued packets in one write, 0 to write
+// each packet on its own. (added paulvha / October 2026)
+//
+//*****************************************************************************
+void
+HciDrvSetWriteCoalesce(uint32_t ui32MaxBytes)
+{
+    g_ui32WriteCoalesce = ui32MaxBytes;
+    HciDrvWqSetBatch(&g_sWriteQueue, ui32MaxBytes);
+}
+
+//*****************************************************************************
+//
+// Get the write statistics. Transfers / packets shows the gain of coalescing.
+//
+//*****************************************************************************
+void
+HciDrvGetTxStats(hci_drv_wq_stats_t *psStats)
+{
+    *psStats = g_sWriteQueue.sStats;
 }
@@ -9,6 +9,8 @@
 #ifndef HCI_DRV_APOLLO_H
 #define HCI_DRV_APOLLO_H
 
+#include "hci_drv_write_queue.h"
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -34,6 +36,34 @@ hci_drv_error_t;
 
 typedef void (*hci_drv_error_handler_t)(uint32_t ui32Error);
 
+//*****************************************************************************
+//
+// Receive ring (added paulvha / October 2026)
+//
+//*****************************************************************************
+#ifndef HCI_DRV_MAX_RX_PACKET
+#define HCI_DRV_MAX_RX_PACKET           256
+#endif
+
+typedef struct
+{
+    uint32_t ui32Packets;       // packets received from the controller
+    uint32_t ui32Dropped;       // packets lost, ring full or too large
+    uint32_t ui32Truncated;     // packets cut to the host buffer
+    uint32_t ui32Deferred;      // times reading waited for the host to make space
+    uint32_t ui32HighWater;     // most bytes used in the ring
+    uint32_t ui32RingSize;
+}
+hci_drv_rx_stats_t;
+
+//*****************************************************************************
+//
+// Write queue (added paulvha / October 2026)
+//
+//*****************************************************************************
+extern void HciDrvSetWriteCoalesce(uint32_t ui32MaxBytes);
+extern void HciDrvGetTxStats(hci_drv_wq_stats_t *psStats);
+
 //*****************************************************************************
 //
 // Function prototypes.
@@ -67,6 +97,10 @@ extern void HciDrvErrorHandlerSet(hci_drv_error_handler_t pfnErrorHandler);
 typedef void (*data_received_handler_t)(uint8_t* data, uint8_t len);
 extern void HciDrvset_data_received_handler(data_received_handler_t handler);
 
+// without a data_received_handler the host takes the packets (HCI packet type first)
+extern uint16_t HciDrvReadPacket(uint8_t *pui8Buf, uint16_t ui16Size);
+extern void HciDrvGetRxStats(hci_drv_rx_stats_t *psStats);
+
 #ifdef __cplusplus
 };
 #endif
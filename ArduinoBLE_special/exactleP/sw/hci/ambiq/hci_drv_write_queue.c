@@ -0,0 +1,203 @@
+//*****************************************************************************
+//
+//! @file hci_drv_write_queue.c
+//!
+//! @brief Queue of outgoing HCI packets with optional coalescing.
+//!
+//! added paulvha / October 2026
+//
+//*****************************************************************************
+
+#include <string.h>
+#include "hci_drv_write_queue.h"
+
+#if (HCI_DRV_WQ_NUM_PACKETS & (HCI_DRV_WQ_NUM_PACKETS - 1)) != 0
+#error "HCI_DRV_WQ_NUM_PACKETS must be a power of two"
+#endif
+
+#if (HCI_DRV_WQ_MAX_PACKET % 4) != 0 || HCI_DRV_WQ_MAX_BATCH < HCI_DRV_WQ_MAX_PACKET
+#error "HCI_DRV_WQ_MAX_PACKET must be a multiple of 4 and fit in HCI_DRV_WQ_MAX_BATCH"
+#endif
+
+//*****************************************************************************
+//
+// The slot data must be written before the interrupt sees the new tail, and
+// the interrupt must be done with a slot before the dispatcher sees the new
+// head. GCC turns these into the barriers needed on a Cortex-M.
+//
+//*****************************************************************************
+#define WQ_LOAD(x)          __atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+#define WQ_STORE(x, v)      __atomic_store_n(&(x), (v), __ATOMIC_RELEASE)
+
+#define WQ_SLOT(q, n)       (&(q)->psPackets[(n) & (HCI_DRV_WQ_NUM_PACKETS - 1)])
+
+//*****************************************************************************
+//
+// Empty the queue.
+//
+//*****************************************************************************
+void
+HciDrvWqInit(hci_drv_wq_t *psQueue, uint32_t ui32MaxBatch)
+{
+    HciDrvWqReset(psQueue);
+    memset(&psQueue->sStats, 0, sizeof(psQueue->sStats));
+
+    HciDrvWqSetBatch(psQueue, ui32MaxBatch);
+}
+
+//*****************************************************************************
+//
+// Drop the packets, keep the limit and the statistics.
+//
+//*****************************************************************************
+void
+HciDrvWqReset(hci_drv_wq_t *psQueue)
+{
+    psQueue->ui32Head = 0;
+    psQueue->ui32Tail = 0;
+    psQueue->ui32InFlight = 0;
+}
+
+//*****************************************************************************
+//
+// Change the coalescing limit.
+//
+//*****************************************************************************
+void
+HciDrvWqSetBatch(hci_drv_wq_t *psQueue, uint32_t ui32MaxBatch)
+{
+    if (ui32MaxBatch > HCI_DRV_WQ_MAX_BATCH)
+    {
+        ui32MaxBatch = HCI_DRV_WQ_MAX_BATCH;
+    }
+
+    psQueue->ui32MaxBatch = ui32MaxBatch;
+}
+
+//*****************************************************************************
+//
+// Add a packet.
+//
+//*****************************************************************************
+uint32_t
+HciDrvWqPut(hci_drv_wq_t *psQueue, uint8_t ui8Type, uint16_t ui16Len,
+            const uint8_t *pui8Data)
+{
+    uint32_t ui32Tail = psQueue->ui32Tail;
+    hci_drv_wq_packet_t *psPacket;
+    uint8_t *pui8Wptr;
+
+    // compensate for the type byte
+    if (ui16Len > HCI_DRV_WQ_MAX_PACKET - 1)
+    {
+        return HCI_DRV_WQ_TOO_LARGE;
+    }
+
+    if (ui32Tail - WQ_LOAD(psQueue->ui32Head) >= HCI_DRV_WQ_NUM_PACKETS)
+    {
+        psQueue->sStats.ui32Full++;
+        return HCI_DRV_WQ_FULL;
+    }
+
+    psPacket = WQ_SLOT(psQueue, ui32Tail);
+    psPacket->ui32Length = ui16Len + 1;
+
+    pui8Wptr = (uint8_t *) psPacket->pui32Data;
+    *pui8Wptr++ = ui8Type;
+    memcpy(pui8Wptr, pui8Data, ui16Len);
+
+    psQueue->sStats.ui32Packets++;
+    WQ_STORE(psQueue->ui32Tail, ui32Tail + 1);
+
+    return HCI_DRV_WQ_SUCCESS;
+}
+
+//*****************************************************************************
+//
+// True if nothing is waiting or in a transfer.
+//
+//*****************************************************************************
+bool
+HciDrvWqEmpty(hci_drv_wq_t *psQueue)
+{
+    return WQ_LOAD(psQueue->ui32Tail) == WQ_LOAD(psQueue->ui32Head);
+}
+
+//*****************************************************************************
+//
+// Prepare the next transfer.
+//
+// A single packet (or no coalescing) is sent from its slot. Otherwise the
+// waiting packets are copied behind each other in the batch buffer, as long
+// as they fit in the limit. The controller parses the HCI stream, the type
+// byte and length of each packet tell where the next one starts.
+//
+//*****************************************************************************
+uint32_t
+HciDrvWqStart(hci_drv_wq_t *psQueue, uint32_t **ppui32Data)
+{
+    uint32_t ui32Head = psQueue->ui32Head;
+    uint32_t ui32Waiting = WQ_LOAD(psQueue->ui32Tail) - ui32Head;
+    hci_drv_wq_packet_t *psPacket = WQ_SLOT(psQueue, ui32Head);
+    uint8_t *pui8Batch = (uint8_t *) psQueue->pui32Batch;
+    uint32_t ui32Length = 0;
+    uint32_t ui32Count = 0;
+
+    if (ui32Waiting == 0)
+    {
+        psQueue->ui32InFlight = 0;
+        return 0;
+    }
+
+    if (ui32Waiting == 1 || psQueue->ui32MaxBatch == 0 ||
+        psPacket->ui32Length + WQ_SLOT(psQueue, ui32Head + 1)->ui32Length > psQueue->ui32MaxBatch)
+    {
+        psQueue->ui32InFlight = 1;
+        *ppui32Data = psPacket->pui32Data;
+        return psPacket->ui32Length;
+    }
+
+    while (ui32Count < ui32Waiting)
+    {
+        psPacket = WQ_SLOT(psQueue, ui32Head + ui32Count);
+
+        if (ui32Length + psPacket->ui32Length > psQueue->ui32MaxBatch)
+        {
+            break;
+        }
+
+        memcpy(&pui8Batch[ui32Length], psPacket->pui32Data, psPacket->ui32Length);
+        ui32Length += psPacket->ui32Length;
+        ui32Count++;
+    }
+
+    psQueue->ui32InFlight = ui32Count;
+    *ppui32Data = psQueue->pui32Batch;
+    return ui32Length;
+}
+
+//*****************************************************************************
+//
+// Remove the packets of the transfer.
+//
+//*****************************************************************************
+void
+HciDrvWqDone(hci_drv_wq_t *psQueue)
+{
+    uint32_t ui32Count = psQueue->ui32InFlight;
+
+    if (ui32Count == 0)
+    {
+        return;
+    }
+
+    psQueue->ui32InFlight = 0;
+    psQueue->sStats.ui32Transfers++;
+
+    if (ui32Count > psQueue->sStats.ui32MaxPerTransfer)
+    {
+        psQueue->sStats.ui32MaxPerTransfer = ui32Count;
+    }
+
+    WQ_STORE(psQueue->ui32Head, psQueue->ui32Head + ui32Count);
+}
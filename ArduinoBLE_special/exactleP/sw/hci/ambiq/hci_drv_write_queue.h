@@ -0,0 +1,169 @@
+//*****************************************************************************
+//
+//! @file hci_drv_write_queue.h
+//!
+//! @brief Queue of outgoing HCI packets with optional coalescing.
+//!
+//! The stack adds packets from the dispatcher (HciDrvWqPut), the BLE interrupt
+//! takes a transfer when the controller is ready (HciDrvWqStart) and removes
+//! it once written (HciDrvWqDone). Each transfer costs a wake / status
+//! handshake with the controller. With coalescing, all packets waiting at
+//! that moment are copied behind each other in one transfer, up to a byte
+//! limit. Nothing is held back to wait for more packets, the added latency of
+//! a packet is at most the time to clock out the limit.
+//!
+//! There are no hardware dependencies, so the queue can be tested on a host.
+//!
+//! added paulvha / October 2026
+//
+//*****************************************************************************
+
+#ifndef HCI_DRV_WRITE_QUEUE_H
+#define HCI_DRV_WRITE_QUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+//*****************************************************************************
+//
+// Configurable sizes.
+//
+//*****************************************************************************
+#ifndef HCI_DRV_WQ_NUM_PACKETS
+#define HCI_DRV_WQ_NUM_PACKETS          8       // must be a power of two
+#endif
+
+#ifndef HCI_DRV_WQ_MAX_PACKET
+#define HCI_DRV_WQ_MAX_PACKET           256     // including the HCI type byte
+#endif
+
+#ifndef HCI_DRV_WQ_MAX_BATCH
+#define HCI_DRV_WQ_MAX_BATCH            512     // largest coalesced transfer
+#endif
+
+//*****************************************************************************
+//
+// Return codes of HciDrvWqPut().
+//
+//*****************************************************************************
+#define HCI_DRV_WQ_SUCCESS              0
+#define HCI_DRV_WQ_FULL                 1
+#define HCI_DRV_WQ_TOO_LARGE            2
+
+//*****************************************************************************
+//
+// Queue.
+//
+//*****************************************************************************
+typedef struct
+{
+    uint32_t ui32Length;
+    uint32_t pui32Data[HCI_DRV_WQ_MAX_PACKET / 4];
+}
+hci_drv_wq_packet_t;
+
+typedef struct
+{
+    uint32_t ui32Packets;           // packets added
+    uint32_t ui32Transfers;         // transfers written to the controller
+    uint32_t ui32MaxPerTransfer;    // most packets in one transfer
+    uint32_t ui32Full;              // packets refused, queue full
+}
+hci_drv_wq_stats_t;
+
+typedef struct
+{
+    hci_drv_wq_packet_t psPackets[HCI_DRV_WQ_NUM_PACKETS];
+    volatile uint32_t ui32Head;     // free running, next packet to send (interrupt)
+    volatile uint32_t ui32Tail;     // free running, next free slot (dispatcher)
+    uint32_t ui32InFlight;          // packets in the current transfer
+    uint32_t ui32MaxBatch;          // byte limit of a transfer, 0 is no coalescing
+    uint32_t pui32Batch[HCI_DRV_WQ_MAX_BATCH / 4];
+    hci_drv_wq_stats_t sStats;
+}
+hci_drv_wq_t;
+
+//*****************************************************************************
+//
+// Function prototypes.
+//
+//*****************************************************************************
+
+//*****************************************************************************
+//
+//! @brief Empty the queue.
+//!
+//! @param psQueue      - the queue.
+//! @param ui32MaxBatch - byte limit of a coalesced transfer, 0 sends each
+//!                       packet on its own. Clipped to HCI_DRV_WQ_MAX_BATCH.
+//
+//*****************************************************************************
+extern void HciDrvWqInit(hci_drv_wq_t *psQueue, uint32_t ui32MaxBatch);
+
+//*****************************************************************************
+//
+//! @brief Drop the waiting packets and the transfer in progress. The limit
+//! and the statistics stay.
+//
+//*****************************************************************************
+extern void HciDrvWqReset(hci_drv_wq_t *psQueue);
+
+//*****************************************************************************
+//
+//! @brief Change the coalescing limit, takes effect with the next transfer.
+//
+//*****************************************************************************
+extern void HciDrvWqSetBatch(hci_drv_wq_t *psQueue, uint32_t ui32MaxBatch);
+
+//*****************************************************************************
+//
+//! @brief Add a packet (dispatcher).
+//!
+//! @param ui8Type  - HCI packet type, sent before the data.
+//! @param ui16Len  - length of the data.
+//! @param pui8Data - the data.
+//!
+//! @return HCI_DRV_WQ_SUCCESS, HCI_DRV_WQ_FULL or HCI_DRV_WQ_TOO_LARGE.
+//
+//*****************************************************************************
+extern uint32_t HciDrvWqPut(hci_drv_wq_t *psQueue, uint8_t ui8Type,
+                            uint16_t ui16Len, const uint8_t *pui8Data);
+
+//*****************************************************************************
+//
+//! @brief True if there are no packets waiting or in a transfer.
+//
+//*****************************************************************************
+extern bool HciDrvWqEmpty(hci_drv_wq_t *psQueue);
+
+//*****************************************************************************
+//
+//! @brief Prepare the next transfer (interrupt, controller ready).
+//!
+//! @param ppui32Data - set to the data of the transfer.
+//!
+//! @return length of the transfer, 0 if the queue is empty.
+//!
+//! The transfer stays at the front of the queue until HciDrvWqDone(). Calling
+//! this again before that prepares the same packets, plus any added since.
+//
+//*****************************************************************************
+extern uint32_t HciDrvWqStart(hci_drv_wq_t *psQueue, uint32_t **ppui32Data);
+
+//*****************************************************************************
+//
+//! @brief Remove the packets of the transfer (interrupt, write complete).
+//
+//*****************************************************************************
+extern void HciDrvWqDone(hci_drv_wq_t *psQueue);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HCI_DRV_WRITE_QUEUE_H
@@ -0,0 +1,190 @@
+/*************************************************************************************************/
+/*!
+ *  \file   pkt_ring.c
+ *
+ *  \brief  Lock free single producer / single consumer packet ring.
+ *
+ *          added paulvha / October 2026
+ */
+/*************************************************************************************************/
+
+#include <string.h>
+#include "wsf_types.h"
+#include "pkt_ring.h"
+
+/**************************************************************************************************
+  Macros
+**************************************************************************************************/
+
+/* The data must be in the buffer before the other side sees the new index, and the other side
+ * must have finished with the data before its index is read as moved. On a single core
+ * Cortex-M this is a compiler barrier plus DMB, GCC generates that for these builtins. */
+#define PKT_RING_LOAD(x)          __atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+#define PKT_RING_STORE(x, v)      __atomic_store_n(&(x), (v), __ATOMIC_RELEASE)
+
+/*************************************************************************************************/
+/*!
+ *  \fn     pktRingCopyIn
+ *
+ *  \brief  Copy into the ring at a free running position, wrapping at the end of the buffer.
+ */
+/*************************************************************************************************/
+static void pktRingCopyIn(pktRing_t *pRing, uint32_t pos, const uint8_t *pData, uint32_t len)
+{
+  uint32_t offset = pos & pRing->mask;
+  uint32_t first = pRing->mask + 1 - offset;
+
+  if (first > len)
+  {
+    first = len;
+  }
+
+  memcpy(&pRing->pBuf[offset], pData, first);
+  memcpy(pRing->pBuf, pData + first, len - first);
+}
+
+/*************************************************************************************************/
+/*!
+ *  \fn     pktRingCopyOut
+ *
+ *  \brief  Copy out of the ring at a free running position, wrapping at the end of the buffer.
+ */
+/*************************************************************************************************/
+static void pktRingCopyOut(pktRing_t *pRing, uint32_t pos, uint8_t *pBuf, uint32_t len)
+{
+  uint32_t offset = pos & pRing->mask;
+  uint32_t first = pRing->mask + 1 - offset;
+
+  if (first > len)
+  {
+    first = len;
+  }
+
+  memcpy(pBuf, &pRing->pBuf[offset], first);
+  memcpy(pBuf + first, pRing->pBuf, len - first);
+}
+
+/*************************************************************************************************/
+/*!
+ *  \fn     PktRingInit
+ *
+ *  \brief  Initialize an empty ring.
+ */
+/*************************************************************************************************/
+void PktRingInit(pktRing_t *pRing, uint8_t *pBuf, uint32_t size)
+{
+  memset(pRing, 0, sizeof(pktRing_t));
+
+  pRing->pBuf = pBuf;
+  pRing->mask = size - 1;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \fn     PktRingSpace
+ *
+ *  \brief  Free space (producer).
+ */
+/*************************************************************************************************/
+uint32_t PktRingSpace(pktRing_t *pRing)
+{
+  return pRing->mask + 1 - (pRing->head - PKT_RING_LOAD(pRing->tail));
+}
+
+/*************************************************************************************************/
+/*!
+ *  \fn     PktRingPut
+ *
+ *  \brief  Store a packet (producer).
+ */
+/*************************************************************************************************/
+uint16_t PktRingPut(pktRing_t *pRing, const uint8_t *pData, uint16_t len)
+{
+  uint32_t head = pRing->head;
+  uint32_t used = head - PKT_RING_LOAD(pRing->tail);
+  uint8_t  hdr[PKT_RING_HDR_LEN];
+
+  if (len == 0)
+  {
+    return 0;
+  }
+
+  if ((uint32_t) len + PKT_RING_HDR_LEN > pRing->mask + 1 - used)
+  {
+    pRing->dropped++;
+    pRing->droppedBytes += len;
+    return 0;
+  }
+
+  hdr[0] = (uint8_t) len;
+  hdr[1] = (uint8_t) (len >> 8);
+
+  pktRingCopyIn(pRing, head, hdr, PKT_RING_HDR_LEN);
+  pktRingCopyIn(pRing, head + PKT_RING_HDR_LEN, pData, len);
+
+  /* publish the record */
+  PKT_RING_STORE(pRing->head, head + PKT_RING_HDR_LEN + len);
+
+  used += PKT_RING_HDR_LEN + len;
+  if (used > pRing->highWater)
+  {
+    pRing->highWater = used;
+  }
+  pRing->packets++;
+
+  return len;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \fn     PktRingPeekLen
+ *
+ *  \brief  Length of the oldest packet (consumer).
+ */
+/*************************************************************************************************/
+uint16_t PktRingPeekLen(pktRing_t *pRing)
+{
+  uint32_t tail = pRing->tail;
+  uint8_t  hdr[PKT_RING_HDR_LEN];
+
+  if (PKT_RING_LOAD(pRing->head) == tail)
+  {
+    return 0;
+  }
+
+  pktRingCopyOut(pRing, tail, hdr, PKT_RING_HDR_LEN);
+
+  return (uint16_t) (hdr[0] | (hdr[1] << 8));
+}
+
+/*************************************************************************************************/
+/*!
+ *  \fn     PktRingGet
+ *
+ *  \brief  Remove the oldest packet (consumer).
+ */
+/*************************************************************************************************/
+uint16_t PktRingGet(pktRing_t *pRing, uint8_t *pBuf, uint16_t size)
+{
+  uint32_t tail = pRing->tail;
+  uint16_t len = PktRingPeekLen(pRing);
+  uint16_t copy = len;
+
+  if (len == 0)
+  {
+    return 0;
+  }
+
+  if (copy > size)
+  {
+    copy = size;
+    pRing->truncated++;
+  }
+
+  pktRingCopyOut(pRing, tail + PKT_RING_HDR_LEN, pBuf, copy);
+
+  /* release the space to the producer */
+  PKT_RING_STORE(pRing->tail, tail + PKT_RING_HDR_LEN + len);
+
+  return copy;
+}
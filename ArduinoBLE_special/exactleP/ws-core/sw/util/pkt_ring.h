@@ -0,0 +1,133 @@
+/*************************************************************************************************/
+/*!
+ *  \file   pkt_ring.h
+ *
+ *  \brief  Lock free single producer / single consumer packet ring.
+ *
+ *          Packets are stored as records of a 2 byte length followed by the data, in a buffer
+ *          with a power of two size. The producer only writes head, the consumer only writes
+ *          tail, so one side can run in an interrupt without disabling interrupts. A packet
+ *          that does not fit is dropped and counted, the producer never waits.
+ *
+ *          added paulvha / October 2026
+ */
+/*************************************************************************************************/
+
+#ifndef PKT_RING_H
+#define PKT_RING_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**************************************************************************************************
+  Macros
+**************************************************************************************************/
+
+/*! Bytes used by the record header */
+#define PKT_RING_HDR_LEN          2
+
+/**************************************************************************************************
+  Data Types
+**************************************************************************************************/
+
+/*! Ring control block. head and tail are free running byte counters. */
+typedef struct
+{
+  uint8_t           *pBuf;            /*! Storage, size is a power of two */
+  uint32_t          mask;             /*! Size - 1 */
+  volatile uint32_t head;             /*! Written by the producer */
+  volatile uint32_t tail;             /*! Written by the consumer */
+
+  /* producer statistics */
+  uint32_t          packets;          /*! Packets stored */
+  uint32_t          dropped;          /*! Packets dropped, ring full */
+  uint32_t          droppedBytes;     /*! Bytes of the dropped packets */
+  uint32_t          highWater;        /*! Most bytes in use */
+
+  /* consumer statistics */
+  uint32_t          truncated;        /*! Packets cut to the size of the consumer buffer */
+} pktRing_t;
+
+/**************************************************************************************************
+  Function Declarations
+**************************************************************************************************/
+
+/*************************************************************************************************/
+/*!
+ *  \fn     PktRingInit
+ *
+ *  \brief  Initialize an empty ring. Neither side may use the ring during this call.
+ *
+ *  \param  pRing   Ring control block.
+ *  \param  pBuf    Storage.
+ *  \param  size    Size of pBuf, must be a power of two.
+ *
+ *  \return None.
+ */
+/*************************************************************************************************/
+void PktRingInit(pktRing_t *pRing, uint8_t *pBuf, uint32_t size);
+
+/*************************************************************************************************/
+/*!
+ *  \fn     PktRingPut
+ *
+ *  \brief  Store a packet (producer).
+ *
+ *  \param  pRing   Ring control block.
+ *  \param  pData   Packet data.
+ *  \param  len     Packet length, 1 - 65535.
+ *
+ *  \return len when stored, 0 when the packet was dropped.
+ */
+/*************************************************************************************************/
+uint16_t PktRingPut(pktRing_t *pRing, const uint8_t *pData, uint16_t len);
+
+/*************************************************************************************************/
+/*!
+ *  \fn     PktRingSpace
+ *
+ *  \brief  Free space (producer). A packet of len bytes fits if len + PKT_RING_HDR_LEN <= space.
+ *
+ *  \param  pRing   Ring control block.
+ *
+ *  \return Free bytes.
+ */
+/*************************************************************************************************/
+uint32_t PktRingSpace(pktRing_t *pRing);
+
+/*************************************************************************************************/
+/*!
+ *  \fn     PktRingPeekLen
+ *
+ *  \brief  Length of the oldest packet (consumer).
+ *
+ *  \param  pRing   Ring control block.
+ *
+ *  \return Packet length, 0 if the ring is empty.
+ */
+/*************************************************************************************************/
+uint16_t PktRingPeekLen(pktRing_t *pRing);
+
+/*************************************************************************************************/
+/*!
+ *  \fn     PktRingGet
+ *
+ *  \brief  Remove the oldest packet (consumer).
+ *
+ *  \param  pRing   Ring control block.
+ *  \param  pBuf    Buffer for the packet.
+ *  \param  size    Size of pBuf. A longer packet is truncated and counted.
+ *
+ *  \return Bytes copied to pBuf, 0 if the ring is empty.
+ */
+/*************************************************************************************************/
+uint16_t PktRingGet(pktRing_t *pRing, uint8_t *pBuf, uint16_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PKT_RING_H */
@@ -0,0 +1,106 @@
+/*************************************************************************************************/
+/*!
+ *  \file   wsf_flash_apollo3.c
+ *
+ *  \brief  Apollo3 internal flash device for the wsf_flash record store.
+ *
+ *          By default 4 pages of 8K are used from 0xF4000 to 0xFC000. The last page (0xFE000)
+ *          is left free as the EEPROM emulation of the Apollo3 library is using it.
+ *          Make sure the sketch does not grow into this area (max ~ 976K).
+ *
+ *          added paulvha / October 2026
+ */
+/*************************************************************************************************/
+
+#include <string.h>
+#include "wsf_types.h"
+#include "wsf_flash.h"
+#include "am_mcu_apollo.h"
+
+/**************************************************************************************************
+  Macros
+**************************************************************************************************/
+
+/* Start address of the store in flash, must be on a page boundary */
+#ifndef WSF_FLASH_APOLLO3_START
+#define WSF_FLASH_APOLLO3_START       0x000F4000
+#endif
+
+/* Number of flash pages used */
+#ifndef WSF_FLASH_APOLLO3_PAGES
+#define WSF_FLASH_APOLLO3_PAGES       4
+#endif
+
+/*************************************************************************************************/
+/*!
+ *  \fn     wsfFlashApollo3Read
+ *
+ *  \brief  Flash is memory mapped, a read is a copy.
+ */
+/*************************************************************************************************/
+static uint8_t wsfFlashApollo3Read(uint32_t address, uint8_t *pBuf, uint32_t len)
+{
+  memcpy(pBuf, (const uint8_t *) (WSF_FLASH_APOLLO3_START + address), len);
+
+  return WSF_FLASH_SUCCESS;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \fn     wsfFlashApollo3Program
+ *
+ *  \brief  Program words. The source is copied to be word aligned for the HAL.
+ */
+/*************************************************************************************************/
+static uint8_t wsfFlashApollo3Program(uint32_t address, const uint8_t *pBuf, uint32_t len)
+{
+  uint32_t words[16];
+  uint32_t n;
+
+  while (len)
+  {
+    n = (len > sizeof(words)) ? sizeof(words) : len;
+    memcpy(words, pBuf, n);
+
+    if (am_hal_flash_program_main(AM_HAL_FLASH_PROGRAM_KEY, words,
+                                  (uint32_t *) (WSF_FLASH_APOLLO3_START + address), n / 4) != 0)
+    {
+      return WSF_FLASH_FAILURE;
+    }
+
+    address += n;
+    pBuf    += n;
+    len     -= n;
+  }
+
+  return WSF_FLASH_SUCCESS;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \fn     wsfFlashApollo3Erase
+ *
+ *  \brief  Erase a page.
+ */
+/*************************************************************************************************/
+static uint8_t wsfFlashApollo3Erase(uint16_t block)
+{
+  uint32_t addr = WSF_FLASH_APOLLO3_START + (uint32_t) block * AM_HAL_FLASH_PAGE_SIZE;
+
+  if (am_hal_flash_page_erase(AM_HAL_FLASH_PROGRAM_KEY, AM_HAL_FLASH_ADDR2INST(addr),
+                              AM_HAL_FLASH_ADDR2PAGE(addr)) != 0)
+  {
+    return WSF_FLASH_FAILURE;
+  }
+
+  return WSF_FLASH_SUCCESS;
+}
+
+const wsfFlashDev_t WsfFlashApollo3Dev =
+{
+  AM_HAL_FLASH_PAGE_SIZE,
+  WSF_FLASH_APOLLO3_PAGES,
+  wsfFlashApollo3Read,
+  wsfFlashApollo3Program,
+  wsfFlashApollo3Erase
+};
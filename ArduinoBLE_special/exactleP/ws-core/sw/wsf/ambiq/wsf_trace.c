@@ -33,23 +33,33 @@
 #include "am_util_debug.h"
 #include "am_util_stdio.h"
 
+#if WSF_TOKEN_ENABLED == TRUE
+#include "am_mcu_apollo.h"
+#endif
+
 /**************************************************************************************************
   Macros
 **************************************************************************************************/
 
 #ifndef WSF_RING_BUF_SIZE
-/*! \brief      Size of token ring buffer (multiple of 2^N). */
-#define WSF_RING_BUF_SIZE               32
+/*! \brief      Size of token ring buffer (multiple of 2^N).
+ *              changed paulvha : must hold a complete HCI packet record (8 + 256 bytes) */
+#define WSF_RING_BUF_SIZE               64
+#endif
+
+#ifndef WSF_TOKEN_TIMESTAMP
+/*! \brief      Timestamp of a binary trace record, added paulvha (STIMER, default 3MHz ticks) */
+#define WSF_TOKEN_TIMESTAMP()           am_hal_stimer_counter_get()
 #endif
 
-/*! \brief      Ring buffer flow control condition detected. */
-#define WSF_TOKEN_FLAG_FLOW_CTRL        (1 << 28)
+/*! \brief      Number of ring buffer slots needed for a packet of len bytes including header. */
+#define WSF_TOKEN_PKT_SLOTS(len)        (1 + (((len) + 7) >> 3))
 
 /**************************************************************************************************
   Data types
 **************************************************************************************************/
 
-#if WSF_TOKEN_ENABLED
+#if WSF_TOKEN_ENABLED == TRUE
 
 /*! \brief      Trace control block. */
 struct
@@ -90,7 +100,6 @@ WsfTraceHandler_t sendMsgCback;
 bool_t enable_trace = FALSE;
 /* Use heap memory to ease stack utilization. */
 static char buf_back[200];
-static char buf_tmp[10];
 
 void WsfTraceRegisterHandler(WsfTraceHandler_t traceCback)
 {
@@ -158,64 +167,102 @@ void WsfTraceEnable(bool_t enable)
  *  \param  pui8Buf      Pointer to the buffer of HCI data
  *
  *  \return None.
+ *
+ *  changed paulvha : the dump is sent in parts that fit buf_back, so packets of any length
+ *  can be traced. Like WsfTrace() it must be enabled with WsfTraceEnable().
  */
 /*************************************************************************************************/
 void WsfPacketTrace(uint8_t ui8Type, uint32_t ui32Len, uint8_t *pui8Buf)
 {
-  uint32_t i, j;
-  uint8_t lt, lb;
+  uint32_t i, lb;
+
+  // must be enabled with WsfTraceEnable()
+  if (! enable_trace || sendMsgCback == NULL) return;
 
-  lb = sprintf(buf_back,"%02X ", ui8Type);          //am_util_debug_printf("%02X ", ui8Type);
+  // strip direction flag (added paulvha for binary tracing)
+  lb = snprintf(buf_back, sizeof(buf_back), "%02X ", ui8Type & ~WSF_TRACE_PKT_RX);
 
   for(i = 0; i < ui32Len; i++)
   {
-    if ((i % 8) == 0)
+    // room for a new line, "XX " and the closing "\n\n" : else send what we have
+    if (lb + 6 >= sizeof(buf_back))
     {
-
-      buf_back[lb++] = '\n';                        //am_util_debug_printf("\n");
+      sendMsgCback((uint8_t *)buf_back, lb);
+      lb = 0;
     }
 
-    lt = sprintf(buf_tmp,"%02X ", *pui8Buf++);      //am_util_debug_printf("%02X ", *pui8Buf++);
-    for (j = 0; j < lt ; j++) buf_back[lb++] = buf_tmp[j];
+    if ((i % 8) == 0)
+    {
+      buf_back[lb++] = '\n';
+    }
 
+    lb += snprintf(buf_back + lb, sizeof(buf_back) - lb, "%02X ", *pui8Buf++);
   }
 
-  //am_util_debug_printf("\n\n");
   buf_back[lb++] = '\n';
   buf_back[lb++] = '\n';
   buf_back[lb] = 0x0;
 
-  sendMsgCback((uint8_t *)buf_back, strlen(buf_back));
+  sendMsgCback((uint8_t *)buf_back, lb);
 }
 
-#elif WSF_TOKEN_ENABLED == TRUE
+#endif // WSF_TRACE_ENABLED
+
+#if WSF_TOKEN_ENABLED == TRUE
 
 /*************************************************************************************************/
 /*!
- *  \fn     WsfToken
+ *  \fn     wsfTokenPut
  *
- *  \brief  Output tokenized message.
+ *  \brief  Store a record of one or more slots in the ring buffer.
  *
- *  \param  tok       Token
- *  \param  var       Variable
+ *  \param  tok       Token of the first slot
+ *  \param  var       Parameter of the first slot
+ *  \param  pData     Raw data to store in the next slots (may be NULL)
+ *  \param  len       Length of pData
  *
  *  \return None.
+ *
+ *  A record is either stored completely or not at all. When a record is dropped the next record
+ *  that fits is flagged with WSF_TOKEN_FLAG_FLOW_CTRL so a decoder can tell data was lost.
+ *
+ *  added paulvha for binary tracing
  */
 /*************************************************************************************************/
-void WsfToken(uint32_t tok, uint32_t var)
+static void wsfTokenPut(uint32_t tok, uint32_t var, const uint8_t *pData, uint32_t len)
 {
   static uint32_t flags = 0;
+  uint32_t slots = (pData == NULL) ? 1 : WSF_TOKEN_PKT_SLOTS(len);
+  uint32_t idx, used, i;
 
   WSF_CS_INIT(cs);
   WSF_CS_ENTER(cs);
 
-  uint32_t prodIdx = (wsfTraceCb.prodIdx + 1) & (WSF_RING_BUF_SIZE - 1);
+  used = (wsfTraceCb.prodIdx - wsfTraceCb.consIdx) & (WSF_RING_BUF_SIZE - 1);
 
-  if (prodIdx != wsfTraceCb.consIdx)
+  /* one slot is always kept free to tell a full from an empty ring */
+  if (used + slots < WSF_RING_BUF_SIZE)
   {
-    wsfTraceCb.ringBuf[wsfTraceCb.prodIdx].token = tok | flags;
-    wsfTraceCb.ringBuf[wsfTraceCb.prodIdx].param = var;
-    wsfTraceCb.prodIdx = prodIdx;
+    idx = wsfTraceCb.prodIdx;
+    wsfTraceCb.ringBuf[idx].token = tok | flags;
+    wsfTraceCb.ringBuf[idx].param = var;
+
+    for (i = 0; i < len; i += sizeof(wsfTraceCb.ringBuf[0]))
+    {
+      idx = (idx + 1) & (WSF_RING_BUF_SIZE - 1);
+
+      if (len - i >= sizeof(wsfTraceCb.ringBuf[0]))
+      {
+        memcpy(&wsfTraceCb.ringBuf[idx], pData + i, sizeof(wsfTraceCb.ringBuf[0]));
+      }
+      else
+      {
+        memset(&wsfTraceCb.ringBuf[idx], 0, sizeof(wsfTraceCb.ringBuf[0]));
+        memcpy(&wsfTraceCb.ringBuf[idx], pData + i, len - i);
+      }
+    }
+
+    wsfTraceCb.prodIdx = (idx + 1) & (WSF_RING_BUF_SIZE - 1);
     flags = 0;
   }
   else
@@ -232,6 +279,95 @@ void WsfToken(uint32_t tok, uint32_t var)
   }
 }
 
+/*************************************************************************************************/
+/*!
+ *  \fn     WsfTokenRegisterHandler
+ *
+ *  \brief  Register handler called when the ring buffer gets data while it was empty.
+ *
+ *  \param  pendCback     Token event handler.
+ *
+ *  \return None.
+ *
+ *  added paulvha
+ */
+/*************************************************************************************************/
+void WsfTokenRegisterHandler(WsfTokenHandler_t pendCback)
+{
+  wsfTraceCb.pendCback = pendCback;
+  wsfTraceCb.ringBufEmpty = TRUE;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \fn     WsfToken
+ *
+ *  \brief  Output tokenized message.
+ *
+ *  \param  tok       Token
+ *  \param  var       Variable
+ *
+ *  \return None.
+ */
+/*************************************************************************************************/
+void WsfToken(uint32_t tok, uint32_t var)
+{
+  uint32_t rec[2];
+
+  /* changed paulvha : the token is stored behind a timestamp slot, as one record */
+  rec[0] = tok;
+  rec[1] = var;
+
+  wsfTokenPut(WSF_TOKEN_FLAG_TIME, WSF_TOKEN_TIMESTAMP(), (uint8_t *) rec, sizeof(rec));
+}
+
+/*************************************************************************************************/
+/*!
+ *  \fn     WsfPacketToken
+ *
+ *  \brief  Store raw HCI data as a binary record in the ring buffer.
+ *
+ *  \param  ui8Type      HCI packet type byte (WSF_TRACE_PKT_RX set for received packets)
+ *  \param  ui32Len      Length of the HCI packet
+ *  \param  pui8Buf      Pointer to the buffer of HCI data
+ *
+ *  \return None.
+ *
+ *  This replaces the text formatting of WsfPacketTrace() with a copy of the packet. The header
+ *  token holds WSF_TOKEN_FLAG_PACKET, the type in bits 16-23 and the length in bits 0-15. A packet
+ *  larger than the ring buffer can hold is truncated to fit.
+ *
+ *  added paulvha
+ */
+/*************************************************************************************************/
+void WsfPacketToken(uint8_t ui8Type, uint32_t ui32Len, uint8_t *pui8Buf)
+{
+  const uint32_t maxLen = (WSF_RING_BUF_SIZE - 2) * sizeof(wsfTraceCb.ringBuf[0]);
+
+  if (ui32Len > maxLen) ui32Len = maxLen;
+
+  wsfTokenPut(WSF_TOKEN_FLAG_PACKET | ((uint32_t) ui8Type << 16) | ui32Len,
+              WSF_TOKEN_TIMESTAMP(), pui8Buf, ui32Len);
+}
+
+/*************************************************************************************************/
+/*!
+ *  \fn     wsfTokenRecordSlots
+ *
+ *  \brief  Number of ring buffer slots of the record that starts at idx.
+ *
+ *  added paulvha for binary tracing
+ */
+/*************************************************************************************************/
+static uint32_t wsfTokenRecordSlots(uint32_t idx)
+{
+  uint32_t tok = wsfTraceCb.ringBuf[idx].token;
+
+  if (tok & WSF_TOKEN_FLAG_PACKET) return WSF_TOKEN_PKT_SLOTS(tok & 0xFFFF);
+  if (tok & WSF_TOKEN_FLAG_TIME) return 2;
+  return 1;
+}
+
 /*************************************************************************************************/
 /*!
  *  \fn     wsfTokenService
@@ -241,35 +377,60 @@ void WsfToken(uint32_t tok, uint32_t var)
  *  \return TRUE if trace messages pending, FALSE otherwise.
  *
  *  This routine is called in the main loop for a "push" type trace systems.
+ *
+ *  changed paulvha : each record is sent as a frame : WSF_TOKEN_SYNC, the length of the record
+ *  (2 bytes, little endian), the record and a checksum (the sum of the record bytes, inverted).
+ *  The trace can share the output with other prints, a decoder finds the frames back.
  */
 /*************************************************************************************************/
 bool_t WsfTokenService(void)
 {
-  static uint8_t outBuf[sizeof(wsfTraceCb.ringBuf[0])];
-  static uint8_t outBufIdx = sizeof(wsfTraceCb.ringBuf[0]);
+  static uint8_t outBuf[WSF_TOKEN_FRAME_HDR + WSF_RING_BUF_SIZE * sizeof(wsfTraceCb.ringBuf[0]) + 1];
+  static uint32_t outBufLen = 0;
+  static uint32_t outBufIdx = 0;
+  uint32_t slots, len, i;
+  uint8_t sum = 0;
 
-  if (outBufIdx < sizeof(wsfTraceCb.ringBuf[0]))
+  if (outBufIdx < outBufLen)
   {
-    outBufIdx += WsfTokenIOWrite(outBuf + outBufIdx, sizeof(wsfTraceCb.ringBuf[0]) - outBufIdx);
+    len = outBufLen - outBufIdx;
+    if (len > 255) len = 255;
 
-    if (outBufIdx < sizeof(wsfTraceCb.ringBuf[0]))
-    {
-      /* I/O device is flow controlled. */
-      return TRUE;
-    }
+    outBufIdx += WsfTokenIOWrite(outBuf + outBufIdx, (uint8_t) len);
+
+    /* I/O device is flow controlled or the frame is not done yet. */
+    return TRUE;
   }
 
   if (wsfTraceCb.consIdx != wsfTraceCb.prodIdx)
   {
-    memcpy(&outBuf, &wsfTraceCb.ringBuf[wsfTraceCb.consIdx], sizeof(wsfTraceCb.ringBuf[0]));
-    outBufIdx = 0;
+    slots = wsfTokenRecordSlots(wsfTraceCb.consIdx);
+    len = slots * sizeof(wsfTraceCb.ringBuf[0]);
+
+    outBuf[0] = WSF_TOKEN_SYNC;
+    outBuf[1] = (uint8_t) len;
+    outBuf[2] = (uint8_t) (len >> 8);
+
+    for (i = 0; i < slots; i++)
+    {
+      memcpy(outBuf + WSF_TOKEN_FRAME_HDR + i * sizeof(wsfTraceCb.ringBuf[0]),
+             &wsfTraceCb.ringBuf[wsfTraceCb.consIdx], sizeof(wsfTraceCb.ringBuf[0]));
 
-    wsfTraceCb.consIdx = (wsfTraceCb.consIdx + 1) & (WSF_RING_BUF_SIZE - 1);
+      wsfTraceCb.consIdx = (wsfTraceCb.consIdx + 1) & (WSF_RING_BUF_SIZE - 1);
+    }
+
+    for (i = 0; i < len; i++) sum += outBuf[WSF_TOKEN_FRAME_HDR + i];
+    outBuf[WSF_TOKEN_FRAME_HDR + len] = (uint8_t) ~sum;
+
+    outBufLen = WSF_TOKEN_FRAME_HDR + len + 1;
+    outBufIdx = 0;
 
     return TRUE;
   }
 
+  wsfTraceCb.ringBufEmpty = TRUE;
+
   return FALSE;
 }
 
-#endif
+#endif // WSF_TOKEN_ENABLED
@@ -34,6 +34,20 @@ typedef void (*WsfTraceHandler_t)(const uint8_t *pBuf, uint32_t len);
 void WsfTraceRegisterHandler(WsfTraceHandler_t traceCback);
 void WsfTraceEnable(bool_t enable);
 
+/*! \brief      added paulvha for binary tracing. Flags in the token word of a ring buffer record.
+ *              A decoder for dumps of the ring buffer is in extras/wsf-trace-decoder.py */
+#define WSF_TOKEN_FLAG_PACKET           (1UL << 31)   /*!< HCI packet header, param is timestamp */
+#define WSF_TOKEN_FLAG_TIME             (1UL << 30)   /*!< Timestamp of the next token, param is timestamp */
+#define WSF_TOKEN_FLAG_FLOW_CTRL        (1UL << 28)   /*!< Records were lost before this one */
+
+/*! \brief      Each record is sent by WsfTokenService() as a frame : sync byte, length of the record
+ *              (2 bytes little endian), the record, checksum (inverted sum of the record bytes). */
+#define WSF_TOKEN_SYNC                  0xA5
+#define WSF_TOKEN_FRAME_HDR             3
+
+/*! \brief      Set in the HCI packet type of a binary packet record when received from the controller. */
+#define WSF_TRACE_PKT_RX                0x80
+
 /**************************************************************************************************
   Function Prototypes
 **************************************************************************************************/
@@ -41,8 +55,10 @@ void WsfTraceEnable(bool_t enable);
 void WsfTrace(const char *pStr, ...);
 void WsfToken(uint32_t tok, uint32_t var);
 void WsfPacketTrace(uint8_t ui8Type, uint32_t ui32Len, uint8_t *pui8Buf);
+void WsfPacketToken(uint8_t ui8Type, uint32_t ui32Len, uint8_t *pui8Buf);
 
 /* Token management. */
+void WsfTokenRegisterHandler(WsfTokenHandler_t pendCback);
 bool_t WsfTokenService(void);
 uint8_t WsfTokenIOWrite(uint8_t *pBuf, uint8_t len);
 
@@ -63,6 +79,17 @@ uint8_t WsfTokenIOWrite(uint8_t *pBuf, uint8_t len);
 #define WSF_TRACE_ENABLED   TRUE
 #endif
 
+//added paulvha : binary tracing in the ring buffer (override with -DWSF_TOKEN_ENABLED=TRUE)
+#ifndef WSF_TOKEN_ENABLED
+#define WSF_TOKEN_ENABLED   FALSE
+#endif
+
+#ifndef MODULE_ID
+/*! \brief      Module identifier in a token. Each file with trace calls defines its own before the
+ *              includes, extras/wsf-trace-tokens.py checks they are unique and makes the token map. */
+#define MODULE_ID           0
+#endif
+
 #ifdef TOKEN_GENERATION
 
 #define WSF_TOKEN(subsys, stat, msg)                    \
@@ -78,15 +105,6 @@ uint8_t WsfTokenIOWrite(uint8_t *pBuf, uint8_t len);
 
 #define PACKET_TRACE(type, len, buf)
 
-#elif WSF_TRACE_ENABLED == TRUE
-
-#define WSF_TRACE0(subsys, stat, msg)                   WsfTrace(msg)
-#define WSF_TRACE1(subsys, stat, msg, var1)             WsfTrace(msg, var1)
-#define WSF_TRACE2(subsys, stat, msg, var1, var2)       WsfTrace(msg, var1, var2)
-#define WSF_TRACE3(subsys, stat, msg, var1, var2, var3) WsfTrace(msg, var1, var2, var3)
-
-#define PACKET_TRACE(type, len, buf)                    WsfPacketTrace(type, len, buf)
-
 #elif WSF_TOKEN_ENABLED == TRUE
 
 #define WSF_TRACE0(subsys, stat, msg)                   \
@@ -98,7 +116,16 @@ uint8_t WsfTokenIOWrite(uint8_t *pBuf, uint8_t len);
 #define WSF_TRACE3(subsys, stat, msg, var1, var2, var3) \
   WsfToken(((__LINE__ & 0xFFF) << 16) | MODULE_ID, (uint32_t)((((var3) & 0xFF) << 16) | (((var2) & 0xFF) << 8) | ((var1) & 0xFF)))
 
-#define PACKET_TRACE(type, len, buf)
+#define PACKET_TRACE(type, len, buf)                    WsfPacketToken(type, len, buf)
+
+#elif WSF_TRACE_ENABLED == TRUE
+
+#define WSF_TRACE0(subsys, stat, msg)                   WsfTrace(msg)
+#define WSF_TRACE1(subsys, stat, msg, var1)             WsfTrace(msg, var1)
+#define WSF_TRACE2(subsys, stat, msg, var1, var2)       WsfTrace(msg, var1, var2)
+#define WSF_TRACE3(subsys, stat, msg, var1, var2, var3) WsfTrace(msg, var1, var2, var3)
+
+#define PACKET_TRACE(type, len, buf)                    WsfPacketTrace(type, len, buf)
 
 #else
 
@@ -150,9 +177,9 @@ uint8_t WsfTokenIOWrite(uint8_t *pBuf, uint8_t len);
 #define HCI_TRACE_ERR3(msg, var1, var2, var3)       WSF_TRACE3("HCI", "ERR",  msg, var1, var2, var3)
 
 #define HCI_PDUMP_CMD(len, pBuf)                    PACKET_TRACE(0x1, len, pBuf)
-#define HCI_PDUMP_EVT(len, pBuf)                    PACKET_TRACE(0x4, len, pBuf)
+#define HCI_PDUMP_EVT(len, pBuf)                    PACKET_TRACE(0x4 | WSF_TRACE_PKT_RX, len, pBuf)
 #define HCI_PDUMP_TX_ACL(len, pBuf)                 PACKET_TRACE(0x2, len, pBuf)
-#define HCI_PDUMP_RX_ACL(len, pBuf)                 PACKET_TRACE(0x2, len, pBuf)
+#define HCI_PDUMP_RX_ACL(len, pBuf)                 PACKET_TRACE(0x2 | WSF_TRACE_PKT_RX, len, pBuf)
 #else
 #define HCI_TRACE_INFO0(msg)                        WSF_TRACE0("HCI", "INFO", msg)
 #define HCI_TRACE_INFO1(msg, var1)
@@ -0,0 +1,1219 @@
+/*************************************************************************************************/
+/*!
+ *  \file   wsf_flash.c
+ *
+ *  \brief  Log structured, wear leveled record store on flash.
+ *
+ *          Layout of an erase block:
+ *
+ *            block header (16 bytes) : magic, erase count, sequence number, reserved
+ *            record header (8 bytes) : id, length, flags, crc16
+ *            record data             : padded with 0xFF to a multiple of 4 bytes
+ *            record header ...
+ *            0xFF                    : not yet written
+ *
+ *          A block with sequence number 0xFFFFFFFF is free (erased). Used blocks are replayed in
+ *          sequence order during WsfFlashInit(), so the last copy of a record wins. A delete is
+ *          written as a record with the deleted flag (tombstone).
+ *
+ *          added paulvha / October 2026
+ */
+/*************************************************************************************************/
+
+#include <stddef.h>
+#include <string.h>
+#include "wsf_types.h"
+#include "wsf_flash.h"
+
+/**************************************************************************************************
+  Macros
+**************************************************************************************************/
+
+/* Block header */
+#define WSF_FLASH_MAGIC               0x474C4657    /* "WFLG" */
+#define WSF_FLASH_BLOCK_HDR_LEN       16
+#define WSF_FLASH_SEQ_FREE            0xFFFFFFFF
+
+/* Record header */
+#define WSF_FLASH_REC_HDR_LEN         8
+#define WSF_FLASH_FLAG_DATA           0xFFFF
+#define WSF_FLASH_FLAG_DELETED        0x0000
+
+/* Number of free blocks kept for compaction */
+#define WSF_FLASH_RESERVE_BLOCKS      1
+
+/* Block states */
+#define WSF_FLASH_BLOCK_FREE          0
+#define WSF_FLASH_BLOCK_USED          1
+
+/* No active block */
+#define WSF_FLASH_NO_BLOCK            0xFFFF
+
+/* Round up to a multiple of 4 (flash is programmed in words) */
+#define WSF_FLASH_ALIGN(len)          (((len) + 3) & ~3UL)
+
+/* Size of a record on flash */
+#define WSF_FLASH_REC_SIZE(len)       (WSF_FLASH_REC_HDR_LEN + WSF_FLASH_ALIGN(len))
+
+/**************************************************************************************************
+  Data Types
+**************************************************************************************************/
+
+/* Block header on flash */
+typedef struct
+{
+  uint32_t magic;
+  uint32_t eraseCount;
+  uint32_t seq;
+  uint32_t reserved;
+} wsfFlashBlockHdr_t;
+
+/* Record header on flash */
+typedef struct
+{
+  uint16_t id;
+  uint16_t len;
+  uint16_t flags;
+  uint16_t crc;
+} wsfFlashRecHdr_t;
+
+/* RAM index entry, sorted on id */
+typedef struct
+{
+  uint16_t id;
+  uint16_t len;
+  uint32_t addr;                /* address of the record header */
+  uint32_t tag;                 /* hash of the first WSF_FLASH_TAG_LEN bytes, 0 for a tombstone */
+} wsfFlashIdx_t;
+
+/* Control block */
+static struct
+{
+  const wsfFlashDev_t *pDev;
+
+  wsfFlashIdx_t idx[WSF_FLASH_MAX_RECORDS];
+  uint16_t      numIdx;
+
+  uint32_t      eraseCount[WSF_FLASH_MAX_BLOCKS];
+  uint32_t      blockSeq[WSF_FLASH_MAX_BLOCKS];
+  uint32_t      liveBytes[WSF_FLASH_MAX_BLOCKS];
+  uint8_t       state[WSF_FLASH_MAX_BLOCKS];
+  uint16_t      freeBlocks;
+
+  uint32_t      seq;            /* highest block sequence number in use */
+  uint16_t      active;         /* block records are appended to */
+  uint32_t      writeAddr;      /* next address to write */
+
+  uint8_t       page[WSF_FLASH_PAGE_SIZE];
+  uint32_t      pageAddr;       /* flash address of page[0] */
+  uint16_t      pageLen;        /* bytes in page, not yet programmed */
+
+  wsfFlashStats_t stats;
+} wsfFlashCb;
+
+/*************************************************************************************************/
+/*!
+ *  \fn     wsfFlashCrc
+ *
+ *  \brief  Update a CRC-16/CCITT.
+ */
+/*************************************************************************************************/
+static uint16_t wsfFlashCrc(uint16_t crc, const uint8_t *pBuf, uint32_t len)
+{
+  uint8_t i;
+
+  while (len--)
+  {
+    crc ^= (uint16_t) *pBuf++ << 8;
+
+    for (i = 0; i < 8; i++)
+    {
+      crc = (crc & 0x8000) ? (uint16_t) ((crc << 1) ^ 0x1021) : (uint16_t) (crc << 1);
+    }
+  }
+
+  return crc;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \fn     wsfFlashTag
+ *
+ *  \brief  FNV-1a hash of the first WSF_FLASH_TAG_LEN bytes of record data.
+ */
+/*************************************************************************************************/
+static uint32_t wsfFlashTag(const uint8_t *pData, uint16_t len)
+{
+  uint32_t hash = 2166136261UL;
+  uint16_t i;
+
+  if (len > WSF_FLASH_TAG_LEN) len = WSF_FLASH_TAG_LEN;
+
+  for (i = 0; i < len; i++)
+  {
+    hash = (hash ^ pData[i]) * 16777619UL;
+  }
+
+  /* 0 is used for tombstones */
+  return hash ? hash : 1;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \fn     wsfFlashBlockEnd
+ *
+ *  \brief  Address after the last byte of a block.
+ */
+/*************************************************************************************************/
+static uint32_t wsfFlashBlockEnd(uint16_t block)
+{
+  return (uint32_t) (block + 1) * wsfFlashCb.pDev->blockSize;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \fn     wsfFlashReadRaw
+ *
+ *  \brief  Read from flash, including data still in the page buffer.
+ */
+/*************************************************************************************************/
+static uint8_t wsfFlashReadRaw(uint32_t addr, uint8_t *pBuf, uint32_t len)
+{
+  uint32_t pageEnd = wsfFlashCb.pageAddr + wsfFlashCb.pageLen;
+  uint32_t n;
+
+  while (len)
+  {
+    if (wsfFlashCb.pageLen && addr >= wsfFlashCb.pageAddr && addr < pageEnd)
+    {
+      /* still in the page buffer */
+      n = pageEnd - addr;
+      if (n > len) n = len;
+
+      memcpy(pBuf, &wsfFlashCb.page[addr - wsfFlashCb.pageAddr], n);
+    }
+    else
+    {
+      n = len;
+
+      if (wsfFlashCb.pageLen && addr < wsfFlashCb.pageAddr && addr + len > wsfFlashCb.pageAddr)
+      {
+        n = wsfFlashCb.pageAddr - addr;
+      }
+
+      if (wsfFlashCb.pDev->read(addr, pBuf, n) != WSF_FLASH_SUCCESS)
+      {
+        return WSF_FLASH_FAILURE;
+      }
+    }
+
+    addr += n;
+    pBuf += n;
+    len  -= n;
+  }
+
+  return WSF_FLASH_SUCCESS;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \fn     wsfFlashProgram
+ *
+ *  \brief  Program to the device and keep statistics.
+ */
+/*************************************************************************************************/
+static uint8_t wsfFlashProgram(uint32_t addr, const uint8_t *pBuf, uint32_t len)
+{
+  wsfFlashCb.stats.programBytes += len;
+  wsfFlashCb.stats.programCalls++;
+
+  return wsfFlashCb.pDev->program(addr, pBuf, len);
+}
+
+/*************************************************************************************************/
+/*!
+ *  \fn     WsfFlashSync
+ *
+ *  \brief  Program the RAM page buffer to flash.
+ */
+/*************************************************************************************************/
+uint8_t WsfFlashSync(void)
+{
+  uint8_t status = WSF_FLASH_SUCCESS;
+
+  if (wsfFlashCb.pDev == NULL)
+  {
+    return WSF_FLASH_FAILURE;
+  }
+
+  if (wsfFlashCb.pageLen)
+  {
+    status = wsfFlashProgram(wsfFlashCb.pageAddr, wsfFlashCb.page, WSF_FLASH_ALIGN(wsfFlashCb.pageLen));
+    wsfFlashCb.pageLen = 0;
+  }
+
+  return status;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \fn     wsfFlashAppend
+ *
+ *  \brief  Append bytes at the write address through the page buffer. The caller has checked
+ *          the bytes fit in the active block.
+ */
+/*************************************************************************************************/
+static uint8_t wsfFlashAppend(const uint8_t *pData, uint32_t len)
+{
+  uint32_t n;
+
+  while (len)
+  {
+    if (wsfFlashCb.pageLen == 0)
+    {
+      wsfFlashCb.pageAddr = wsfFlashCb.writeAddr;
+    }
+
+    n = WSF_FLASH_PAGE_SIZE - wsfFlashCb.pageLen;
+    if (n > len) n = len;
+
+    if (pData)
+    {
+      memcpy(&wsfFlashCb.page[wsfFlashCb.pageLen], pData, n);
+      pData += n;
+    }
+    else
+    {
+      /* padding */
+      memset(&wsfFlashCb.page[wsfFlashCb.pageLen], 0xFF, n);
+    }
+
+    wsfFlashCb.pageLen   += n;
+    wsfFlashCb.writeAddr += n;
+    len -= n;
+
+    if (wsfFlashCb.pageLen == WSF_FLASH_PAGE_SIZE)
+    {
+      if (WsfFlashSync() != WSF_FLASH_SUCCESS)
+      {
+        return WSF_FLASH_FAILURE;
+      }
+    }
+  }
+
+  return WSF_FLASH_SUCCESS;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \fn     wsfFlashIdxSearch
+ *
+ *  \brief  Binary search of the index.
+ *
+ *  \param  id      Record id.
+ *  \param  pPos    Position of the entry, or where it should be inserted.
+ *
+ *  \return TRUE if found.
+ */
+/*************************************************************************************************/
+static bool_t wsfFlashIdxSearch(uint16_t id, uint16_t *pPos)
+{
+  uint16_t lo = 0, hi = wsfFlashCb.numIdx, mid;
+
+  while (lo < hi)
+  {
+    mid = (lo + hi) / 2;
+
+    if (wsfFlashCb.idx[mid].id < id)
+    {
+      lo = mid + 1;
+    }
+    else
+    {
+      hi = mid;
+    }
+  }
+
+  *pPos = lo;
+
+  return (lo < wsfFlashCb.numIdx && wsfFlashCb.idx[lo].id == id);
+}
+
+/*************************************************************************************************/
+/*!
+ *  \fn     wsfFlashIdxUpdate
+ *
+ *  \brief  Point the index to a new copy of a record and update the live bytes per block.
+ *
+ *  \return FALSE if the index is full.
+ */
+/*************************************************************************************************/
+static bool_t wsfFlashIdxUpdate(uint16_t id, uint16_t len, uint32_t addr, uint32_t tag)
+{
+  uint16_t pos;
+  wsfFlashIdx_t *pIdx;
+
+  if (wsfFlashIdxSearch(id, &pos))
+  {
+    pIdx = &wsfFlashCb.idx[pos];
+    wsfFlashCb.liveBytes[pIdx->addr / wsfFlashCb.pDev->blockSize] -=
+      WSF_FLASH_REC_SIZE(pIdx->len);
+  }
+  else
+  {
+    if (wsfFlashCb.numIdx == WSF_FLASH_MAX_RECORDS)
+    {
+      return FALSE;
+    }
+
+    memmove(&wsfFlashCb.idx[pos + 1], &wsfFlashCb.idx[pos],
+            (wsfFlashCb.numIdx - pos) * sizeof(wsfFlashIdx_t));
+    wsfFlashCb.numIdx++;
+
+    pIdx = &wsfFlashCb.idx[pos];
+    pIdx->id = id;
+  }
+
+  pIdx->len  = len;
+  pIdx->addr = addr;
+  pIdx->tag  = tag;
+
+  wsfFlashCb.liveBytes[addr / wsfFlashCb.pDev->blockSize] += WSF_FLASH_REC_SIZE(len);
+
+  return TRUE;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \fn     wsfFlashIdxRemove
+ *
+ *  \brief  Remove an entry from the index.
+ */
+/*************************************************************************************************/
+static void wsfFlashIdxRemove(uint16_t pos)
+{
+  wsfFlashIdx_t *pIdx = &wsfFlashCb.idx[pos];
+
+  wsfFlashCb.liveBytes[pIdx->addr / wsfFlashCb.pDev->blockSize] -=
+    WSF_FLASH_REC_SIZE(pIdx->len);
+
+  wsfFlashCb.numIdx--;
+  memmove(pIdx, pIdx + 1, (wsfFlashCb.numIdx - pos) * sizeof(wsfFlashIdx_t));
+}
+
+/*************************************************************************************************/
+/*!
+ *  \fn     wsfFlashFormat
+ *
+ *  \brief  Erase a block and write a free block header.
+ */
+/*************************************************************************************************/
+static uint8_t wsfFlashFormat(uint16_t block)
+{
+  wsfFlashBlockHdr_t hdr;
+
+  if (wsfFlashCb.pDev->erase(block) != WSF_FLASH_SUCCESS)
+  {
+    return WSF_FLASH_FAILURE;
+  }
+
+  wsfFlashCb.stats.erases++;
+  wsfFlashCb.eraseCount[block]++;
+  wsfFlashCb.blockSeq[block]  = WSF_FLASH_SEQ_FREE;
+  wsfFlashCb.liveBytes[block] = 0;
+  wsfFlashCb.state[block]     = WSF_FLASH_BLOCK_FREE;
+  wsfFlashCb.freeBlocks++;
+
+  hdr.magic      = WSF_FLASH_MAGIC;
+  hdr.eraseCount = wsfFlashCb.eraseCount[block];
+  hdr.seq        = WSF_FLASH_SEQ_FREE;
+  hdr.reserved   = 0xFFFFFFFF;
+
+  return wsfFlashProgram((uint32_t) block * wsfFlashCb.pDev->blockSize, (uint8_t *) &hdr, sizeof(hdr));
+}
+
+/*************************************************************************************************/
+/*!
+ *  \fn     wsfFlashOpenBlock
+ *
+ *  \brief  Make the free block with the lowest erase count the active block.
+ */
+/*************************************************************************************************/
+static uint8_t wsfFlashOpenBlock(void)
+{
+  uint16_t b, best = WSF_FLASH_NO_BLOCK;
+  uint32_t seq;
+
+  for (b = 0; b < wsfFlashCb.pDev->numBlocks; b++)
+  {
+    if (wsfFlashCb.state[b] == WSF_FLASH_BLOCK_FREE &&
+        (best == WSF_FLASH_NO_BLOCK || wsfFlashCb.eraseCount[b] < wsfFlashCb.eraseCount[best]))
+    {
+      best = b;
+    }
+  }
+
+  if (best == WSF_FLASH_NO_BLOCK || WsfFlashSync() != WSF_FLASH_SUCCESS)
+  {
+    return WSF_FLASH_FAILURE;
+  }
+
+  /* the sequence number is still erased in the header and can be programmed */
+  seq = ++wsfFlashCb.seq;
+
+  if (wsfFlashProgram((uint32_t) best * wsfFlashCb.pDev->blockSize + offsetof(wsfFlashBlockHdr_t, seq),
+                      (uint8_t *) &seq, sizeof(seq)) != WSF_FLASH_SUCCESS)
+  {
+    return WSF_FLASH_FAILURE;
+  }
+
+  wsfFlashCb.state[best]    = WSF_FLASH_BLOCK_USED;
+  wsfFlashCb.blockSeq[best] = seq;
+  wsfFlashCb.freeBlocks--;
+  wsfFlashCb.active    = best;
+  wsfFlashCb.writeAddr = (uint32_t) best * wsfFlashCb.pDev->blockSize + WSF_FLASH_BLOCK_HDR_LEN;
+
+  return WSF_FLASH_SUCCESS;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \fn     wsfFlashAppendRecord
+ *
+ *  \brief  Append a record to the active block. The caller has checked it fits.
+ */
+/*************************************************************************************************/
+static uint8_t wsfFlashAppendRecord(const wsfFlashRecHdr_t *pHdr, const uint8_t *pData)
+{
+  if (wsfFlashAppend((const uint8_t *) pHdr, sizeof(*pHdr)) != WSF_FLASH_SUCCESS ||
+      wsfFlashAppend(pData, pHdr->len) != WSF_FLASH_SUCCESS ||
+      wsfFlashAppend(NULL, WSF_FLASH_ALIGN(pHdr->len) - pHdr->len) != WSF_FLASH_SUCCESS)
+  {
+    return WSF_FLASH_FAILURE;
+  }
+
+  return WSF_FLASH_SUCCESS;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \fn     wsfFlashCompact
+ *
+ *  \brief  Copy the live records of a block to the active block and erase it.
+ *
+ *          The victim is the used block with the least live data, unless a block holding cold
+ *          data has fallen WSF_FLASH_WEAR_DELTA erases behind, which is then moved so its block
+ *          takes part in the wear again.
+ */
+/*************************************************************************************************/
+static uint8_t wsfFlashCompact(void)
+{
+  uint16_t b, victim = WSF_FLASH_NO_BLOCK, coldest = WSF_FLASH_NO_BLOCK, oldest = WSF_FLASH_NO_BLOCK;
+  uint32_t maxErase = 0, start, end;
+  uint16_t i;
+
+  for (b = 0; b < wsfFlashCb.pDev->numBlocks; b++)
+  {
+    if (wsfFlashCb.eraseCount[b] > maxErase) maxErase = wsfFlashCb.eraseCount[b];
+
+    if (wsfFlashCb.state[b] != WSF_FLASH_BLOCK_USED || b == wsfFlashCb.active)
+    {
+      continue;
+    }
+
+    if (victim == WSF_FLASH_NO_BLOCK || wsfFlashCb.liveBytes[b] < wsfFlashCb.liveBytes[victim])
+    {
+      victim = b;
+    }
+
+    if (coldest == WSF_FLASH_NO_BLOCK || wsfFlashCb.eraseCount[b] < wsfFlashCb.eraseCount[coldest])
+    {
+      coldest = b;
+    }
+  }
+
+  for (b = 0; b < wsfFlashCb.pDev->numBlocks; b++)
+  {
+    if (wsfFlashCb.state[b] == WSF_FLASH_BLOCK_USED &&
+        (oldest == WSF_FLASH_NO_BLOCK || wsfFlashCb.blockSeq[b] < wsfFlashCb.blockSeq[oldest]))
+    {
+      oldest = b;
+    }
+  }
+
+  if (victim == WSF_FLASH_NO_BLOCK)
+  {
+    return WSF_FLASH_FAILURE;
+  }
+
+  if (maxErase - wsfFlashCb.eraseCount[coldest] > WSF_FLASH_WEAR_DELTA)
+  {
+    victim = coldest;
+  }
+
+  start = (uint32_t) victim * wsfFlashCb.pDev->blockSize;
+  end   = start + wsfFlashCb.pDev->blockSize;
+
+  if (wsfFlashCb.writeAddr + wsfFlashCb.liveBytes[victim] > wsfFlashBlockEnd(wsfFlashCb.active))
+  {
+    return WSF_FLASH_FAILURE;
+  }
+
+  for (i = 0; i < wsfFlashCb.numIdx; i++)
+  {
+    wsfFlashIdx_t *pIdx = &wsfFlashCb.idx[i];
+    wsfFlashRecHdr_t hdr;
+    uint8_t buf[32];
+    uint32_t addr, done, n;
+
+    if (pIdx->addr < start || pIdx->addr >= end)
+    {
+      continue;
+    }
+
+    /* a tombstone in the oldest block has no older copy left to hide */
+    if (pIdx->tag == 0 && victim == oldest)
+    {
+      wsfFlashCb.stats.liveBytes -= WSF_FLASH_REC_SIZE(0);
+      wsfFlashIdxRemove(i--);
+      continue;
+    }
+
+    addr = wsfFlashCb.writeAddr;
+
+    if (wsfFlashCb.pDev->read(pIdx->addr, (uint8_t *) &hdr, sizeof(hdr)) != WSF_FLASH_SUCCESS ||
+        wsfFlashAppend((uint8_t *) &hdr, sizeof(hdr)) != WSF_FLASH_SUCCESS)
+    {
+      return WSF_FLASH_FAILURE;
+    }
+
+    for (done = 0; done < WSF_FLASH_ALIGN(hdr.len); done += n)
+    {
+      n = WSF_FLASH_ALIGN(hdr.len) - done;
+      if (n > sizeof(buf)) n = sizeof(buf);
+
+      if (wsfFlashCb.pDev->read(pIdx->addr + sizeof(hdr) + done, buf, n) != WSF_FLASH_SUCCESS ||
+          wsfFlashAppend(buf, n) != WSF_FLASH_SUCCESS)
+      {
+        return WSF_FLASH_FAILURE;
+      }
+    }
+
+    wsfFlashIdxUpdate(pIdx->id, pIdx->len, addr, pIdx->tag);
+  }
+
+  /* the victim holds the only copy in flash until the moved records are programmed */
+  if (WsfFlashSync() != WSF_FLASH_SUCCESS)
+  {
+    return WSF_FLASH_FAILURE;
+  }
+
+  return wsfFlashFormat(victim);
+}
+
+/*************************************************************************************************/
+/*!
+ *  \fn     wsfFlashReserve
+ *
+ *  \brief  Make sure a record of size bytes fits in the active block.
+ */
+/*************************************************************************************************/
+static uint8_t wsfFlashReserve(uint32_t size)
+{
+  uint16_t tries;
+
+  if (size > wsfFlashCb.pDev->blockSize - WSF_FLASH_BLOCK_HDR_LEN)
+  {
+    return WSF_FLASH_FAILURE;
+  }
+
+  for (tries = 0; tries <= wsfFlashCb.pDev->numBlocks; tries++)
+  {
+    if (wsfFlashCb.active != WSF_FLASH_NO_BLOCK &&
+        wsfFlashCb.writeAddr + size <= wsfFlashBlockEnd(wsfFlashCb.active))
+    {
+      return WSF_FLASH_SUCCESS;
+    }
+
+    if (wsfFlashOpenBlock() != WSF_FLASH_SUCCESS)
+    {
+      return WSF_FLASH_FAILURE;
+    }
+
+    if (wsfFlashCb.freeBlocks < WSF_FLASH_RESERVE_BLOCKS && wsfFlashCompact() != WSF_FLASH_SUCCESS)
+    {
+      return WSF_FLASH_FAILURE;
+    }
+  }
+
+  return WSF_FLASH_FAILURE;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \fn     wsfFlashWriteRecord
+ *
+ *  \brief  Write a record or tombstone and update the index.
+ */
+/*************************************************************************************************/
+static uint8_t wsfFlashWriteRecord(uint16_t id, const uint8_t *pData, uint16_t len, uint16_t flags)
+{
+  wsfFlashRecHdr_t hdr;
+  uint32_t addr, used = 0, capacity;
+  uint16_t pos;
+
+  if (wsfFlashCb.pDev == NULL || id == WSF_FLASH_ID_INVALID)
+  {
+    return WSF_FLASH_FAILURE;
+  }
+
+  if (wsfFlashIdxSearch(id, &pos))
+  {
+    used = WSF_FLASH_REC_SIZE(wsfFlashCb.idx[pos].len);
+  }
+  else if (wsfFlashCb.numIdx == WSF_FLASH_MAX_RECORDS)
+  {
+    return WSF_FLASH_FAILURE;
+  }
+
+  /* all live data must fit in the blocks outside the reserve, with room for a record per block */
+  capacity = (wsfFlashCb.pDev->numBlocks - WSF_FLASH_RESERVE_BLOCKS) *
+             (wsfFlashCb.pDev->blockSize - WSF_FLASH_BLOCK_HDR_LEN - WSF_FLASH_REC_SIZE(len));
+
+  if (wsfFlashCb.stats.liveBytes - used + WSF_FLASH_REC_SIZE(len) > capacity)
+  {
+    return WSF_FLASH_FAILURE;
+  }
+
+  if (wsfFlashReserve(WSF_FLASH_REC_SIZE(len)) != WSF_FLASH_SUCCESS)
+  {
+    return WSF_FLASH_FAILURE;
+  }
+
+  hdr.id    = id;
+  hdr.len   = len;
+  hdr.flags = flags;
+  hdr.crc   = wsfFlashCrc(wsfFlashCrc(0xFFFF, (uint8_t *) &hdr, offsetof(wsfFlashRecHdr_t, crc)), pData, len);
+
+  addr = wsfFlashCb.writeAddr;
+
+  if (wsfFlashAppendRecord(&hdr, pData) != WSF_FLASH_SUCCESS)
+  {
+    return WSF_FLASH_FAILURE;
+  }
+
+  wsfFlashIdxUpdate(id, len, addr, flags == WSF_FLASH_FLAG_DATA ? wsfFlashTag(pData, len) : 0);
+
+  wsfFlashCb.stats.liveBytes = wsfFlashCb.stats.liveBytes - used + WSF_FLASH_REC_SIZE(len);
+  wsfFlashCb.stats.userBytes += len;
+
+  return WSF_FLASH_SUCCESS;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \fn     wsfFlashScanBlock
+ *
+ *  \brief  Replay the records of a used block into the index.
+ *
+ *  \param  block   Block to scan.
+ *  \param  pEnd    Returns the address after the last valid record.
+ *
+ *  \return WSF_FLASH_FAILURE if the device could not be read.
+ */
+/*************************************************************************************************/
+static uint8_t wsfFlashScanBlock(uint16_t block, uint32_t *pEnd)
+{
+  uint32_t addr = (uint32_t) block * wsfFlashCb.pDev->blockSize + WSF_FLASH_BLOCK_HDR_LEN;
+  uint32_t end  = wsfFlashBlockEnd(block);
+  wsfFlashRecHdr_t hdr;
+  uint8_t buf[32];
+  uint16_t crc, n, done;
+  uint32_t tag;
+
+  while (addr + WSF_FLASH_REC_HDR_LEN <= end)
+  {
+    if (wsfFlashCb.pDev->read(addr, (uint8_t *) &hdr, sizeof(hdr)) != WSF_FLASH_SUCCESS)
+    {
+      return WSF_FLASH_FAILURE;
+    }
+
+    /* end of written area */
+    if (hdr.id == WSF_FLASH_ID_INVALID && hdr.len == 0xFFFF)
+    {
+      *pEnd = addr;
+      return WSF_FLASH_SUCCESS;
+    }
+
+    if (addr + WSF_FLASH_REC_SIZE(hdr.len) > end)
+    {
+      break;
+    }
+
+    /* check the data and take the tag of the first bytes */
+    crc = wsfFlashCrc(0xFFFF, (uint8_t *) &hdr, offsetof(wsfFlashRecHdr_t, crc));
+    tag = 0;
+
+    for (done = 0; done < hdr.len; done += n)
+    {
+      n = hdr.len - done;
+      if (n > sizeof(buf)) n = sizeof(buf);
+
+      if (wsfFlashCb.pDev->read(addr + sizeof(hdr) + done, buf, n) != WSF_FLASH_SUCCESS)
+      {
+        return WSF_FLASH_FAILURE;
+      }
+
+      crc = wsfFlashCrc(crc, buf, n);
+
+      if (done == 0 && hdr.flags == WSF_FLASH_FLAG_DATA)
+      {
+        tag = wsfFlashTag(buf, n);
+      }
+    }
+
+    /* an interrupted write : nothing after it can be trusted, treat the block as full */
+    if (crc != hdr.crc)
+    {
+      break;
+    }
+
+    if (hdr.flags == WSF_FLASH_FLAG_DATA && hdr.len == 0)
+    {
+      tag = wsfFlashTag(buf, 0);
+    }
+
+    wsfFlashIdxUpdate(hdr.id, hdr.len, addr, tag);
+
+    addr += WSF_FLASH_REC_SIZE(hdr.len);
+  }
+
+  *pEnd = end;
+  return WSF_FLASH_SUCCESS;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \fn     WsfFlashInit
+ *
+ *  \brief  Mount the store on a flash device and build the RAM index.
+ */
+/*************************************************************************************************/
+uint8_t WsfFlashInit(const wsfFlashDev_t *pDev)
+{
+  wsfFlashBlockHdr_t hdr;
+  uint16_t b, next, last = WSF_FLASH_NO_BLOCK;
+  uint32_t end = 0, seq;
+
+  memset(&wsfFlashCb, 0, sizeof(wsfFlashCb));
+  wsfFlashCb.active = WSF_FLASH_NO_BLOCK;
+
+  if (pDev == NULL || pDev->numBlocks < WSF_FLASH_RESERVE_BLOCKS + 1 ||
+      pDev->numBlocks > WSF_FLASH_MAX_BLOCKS)
+  {
+    return WSF_FLASH_FAILURE;
+  }
+
+  wsfFlashCb.pDev = pDev;
+
+  /* read the block headers, format what is not ours */
+  for (b = 0; b < pDev->numBlocks; b++)
+  {
+    if (pDev->read((uint32_t) b * pDev->blockSize, (uint8_t *) &hdr, sizeof(hdr)) != WSF_FLASH_SUCCESS)
+    {
+      wsfFlashCb.pDev = NULL;
+      return WSF_FLASH_FAILURE;
+    }
+
+    if (hdr.magic != WSF_FLASH_MAGIC)
+    {
+      if (wsfFlashFormat(b) != WSF_FLASH_SUCCESS)
+      {
+        wsfFlashCb.pDev = NULL;
+        return WSF_FLASH_FAILURE;
+      }
+      continue;
+    }
+
+    wsfFlashCb.eraseCount[b] = hdr.eraseCount;
+    wsfFlashCb.blockSeq[b]   = hdr.seq;
+
+    if (hdr.seq == WSF_FLASH_SEQ_FREE)
+    {
+      wsfFlashCb.state[b] = WSF_FLASH_BLOCK_FREE;
+      wsfFlashCb.freeBlocks++;
+    }
+    else
+    {
+      wsfFlashCb.state[b] = WSF_FLASH_BLOCK_USED;
+      if (hdr.seq > wsfFlashCb.seq) wsfFlashCb.seq = hdr.seq;
+    }
+  }
+
+  /* replay the used blocks from old to new */
+  for (seq = 0; ; seq = wsfFlashCb.blockSeq[next] + 1)
+  {
+    next = WSF_FLASH_NO_BLOCK;
+
+    for (b = 0; b < pDev->numBlocks; b++)
+    {
+      if (wsfFlashCb.state[b] == WSF_FLASH_BLOCK_USED && wsfFlashCb.blockSeq[b] >= seq &&
+          (next == WSF_FLASH_NO_BLOCK || wsfFlashCb.blockSeq[b] < wsfFlashCb.blockSeq[next]))
+      {
+        next = b;
+      }
+    }
+
+    if (next == WSF_FLASH_NO_BLOCK)
+    {
+      break;
+    }
+
+    if (wsfFlashScanBlock(next, &end) != WSF_FLASH_SUCCESS)
+    {
+      wsfFlashCb.pDev = NULL;
+      return WSF_FLASH_FAILURE;
+    }
+
+    last = next;
+  }
+
+  /* continue writing in the newest block */
+  if (last != WSF_FLASH_NO_BLOCK)
+  {
+    wsfFlashCb.active    = last;
+    wsfFlashCb.writeAddr = end;
+  }
+
+  /* live data counted from the index */
+  wsfFlashCb.stats.liveBytes = 0;
+  for (b = 0; b < wsfFlashCb.numIdx; b++)
+  {
+    wsfFlashIdx_t *pIdx = &wsfFlashCb.idx[b];
+    wsfFlashCb.stats.liveBytes += WSF_FLASH_REC_SIZE(pIdx->len);
+  }
+
+  /* statistics are about this session */
+  wsfFlashCb.stats.erases       = 0;
+  wsfFlashCb.stats.programBytes = 0;
+  wsfFlashCb.stats.programCalls = 0;
+
+  return WSF_FLASH_SUCCESS;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \fn     WsfFlashWrite
+ *
+ *  \brief  Write a record, replacing an earlier record with the same id.
+ */
+/*************************************************************************************************/
+uint8_t WsfFlashWrite(uint16_t id, const uint8_t *pData, uint16_t len)
+{
+  return wsfFlashWriteRecord(id, pData, len, WSF_FLASH_FLAG_DATA);
+}
+
+/*************************************************************************************************/
+/*!
+ *  \fn     WsfFlashDelete
+ *
+ *  \brief  Delete a record.
+ */
+/*************************************************************************************************/
+uint8_t WsfFlashDelete(uint16_t id)
+{
+  uint16_t pos;
+
+  if (wsfFlashCb.pDev == NULL || !wsfFlashIdxSearch(id, &pos))
+  {
+    return WSF_FLASH_FAILURE;
+  }
+
+  /* already deleted */
+  if (wsfFlashCb.idx[pos].tag == 0)
+  {
+    return WSF_FLASH_SUCCESS;
+  }
+
+  return wsfFlashWriteRecord(id, NULL, 0, WSF_FLASH_FLAG_DELETED);
+}
+
+/*************************************************************************************************/
+/*!
+ *  \fn     WsfFlashRead
+ *
+ *  \brief  Read a record.
+ */
+/*************************************************************************************************/
+uint16_t WsfFlashRead(uint16_t id, uint8_t *pBuf, uint16_t len)
+{
+  uint16_t pos;
+  wsfFlashIdx_t *pIdx;
+
+  if (wsfFlashCb.pDev == NULL || !wsfFlashIdxSearch(id, &pos) || wsfFlashCb.idx[pos].tag == 0)
+  {
+    return 0;
+  }
+
+  pIdx = &wsfFlashCb.idx[pos];
+
+  if (len > pIdx->len) len = pIdx->len;
+
+  if (wsfFlashReadRaw(pIdx->addr + WSF_FLASH_REC_HDR_LEN, pBuf, len) != WSF_FLASH_SUCCESS)
+  {
+    return 0;
+  }
+
+  return pIdx->len;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \fn     WsfFlashFind
+ *
+ *  \brief  Find a record in an id range by the first WSF_FLASH_TAG_LEN bytes of its data.
+ */
+/*************************************************************************************************/
+uint16_t WsfFlashFind(uint16_t idFirst, uint16_t idLast, const uint8_t *pTag)
+{
+  uint32_t tag = wsfFlashTag(pTag, WSF_FLASH_TAG_LEN);
+  uint8_t buf[WSF_FLASH_TAG_LEN];
+  uint16_t pos;
+
+  if (wsfFlashCb.pDev == NULL)
+  {
+    return WSF_FLASH_ID_INVALID;
+  }
+
+  wsfFlashIdxSearch(idFirst, &pos);
+
+  for (; pos < wsfFlashCb.numIdx && wsfFlashCb.idx[pos].id <= idLast; pos++)
+  {
+    wsfFlashIdx_t *pIdx = &wsfFlashCb.idx[pos];
+
+    /* the hash rules out nearly all records without reading flash */
+    if (pIdx->tag != tag || pIdx->len < WSF_FLASH_TAG_LEN)
+    {
+      continue;
+    }
+
+    if (wsfFlashReadRaw(pIdx->addr + WSF_FLASH_REC_HDR_LEN, buf, WSF_FLASH_TAG_LEN) == WSF_FLASH_SUCCESS &&
+        memcmp(buf, pTag, WSF_FLASH_TAG_LEN) == 0)
+    {
+      return pIdx->id;
+    }
+  }
+
+  return WSF_FLASH_ID_INVALID;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \fn     WsfFlashNextId
+ *
+ *  \brief  Iterate over the records in an id range.
+ */
+/*************************************************************************************************/
+uint16_t WsfFlashNextId(uint16_t id, uint16_t idLast)
+{
+  uint16_t pos;
+
+  if (wsfFlashCb.pDev == NULL)
+  {
+    return WSF_FLASH_ID_INVALID;
+  }
+
+  wsfFlashIdxSearch(id, &pos);
+
+  for (; pos < wsfFlashCb.numIdx && wsfFlashCb.idx[pos].id <= idLast; pos++)
+  {
+    if (wsfFlashCb.idx[pos].tag)
+    {
+      return wsfFlashCb.idx[pos].id;
+    }
+  }
+
+  return WSF_FLASH_ID_INVALID;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \fn     WsfFlashGetStats
+ *
+ *  \brief  Get the statistics of the store.
+ */
+/*************************************************************************************************/
+void WsfFlashGetStats(wsfFlashStats_t *pStats)
+{
+  uint16_t b, i;
+
+  *pStats = wsfFlashCb.stats;
+  pStats->records = 0;
+  pStats->minEraseCount = 0xFFFFFFFF;
+  pStats->maxEraseCount = 0;
+
+  for (i = 0; i < wsfFlashCb.numIdx; i++)
+  {
+    if (wsfFlashCb.idx[i].tag) pStats->records++;
+  }
+
+  if (wsfFlashCb.pDev == NULL)
+  {
+    pStats->minEraseCount = 0;
+    return;
+  }
+
+  for (b = 0; b < wsfFlashCb.pDev->numBlocks; b++)
+  {
+    if (wsfFlashCb.eraseCount[b] < pStats->minEraseCount) pStats->minEraseCount = wsfFlashCb.eraseCount[b];
+    if (wsfFlashCb.eraseCount[b] > pStats->maxEraseCount) pStats->maxEraseCount = wsfFlashCb.eraseCount[b];
+  }
+}
+
+/**************************************************************************************************
+  WSF EFS media : the address space is split in logical pages, each page is a record.
+  Pages that were never written or erased read as 0xFF.
+**************************************************************************************************/
+
+/*************************************************************************************************/
+/*!
+ *  \fn     wsfFlashEfsReadPage
+ *
+ *  \brief  Read a complete logical page.
+ */
+/*************************************************************************************************/
+static void wsfFlashEfsReadPage(uint16_t id, uint8_t *pPage)
+{
+  uint16_t len = WsfFlashRead(id, pPage, WSF_FLASH_EFS_PAGE_SIZE);
+
+  if (len < WSF_FLASH_EFS_PAGE_SIZE)
+  {
+    memset(pPage + len, 0xFF, WSF_FLASH_EFS_PAGE_SIZE - len);
+  }
+}
+
+/*************************************************************************************************/
+/*!
+ *  \fn     wsfFlashEfsUpdate
+ *
+ *  \brief  Write or erase (pBuf NULL) a part of the address space, page by page.
+ */
+/*************************************************************************************************/
+static uint8_t wsfFlashEfsUpdate(const uint8_t *pBuf, uint32_t address, uint32_t size)
+{
+  uint8_t page[WSF_FLASH_EFS_PAGE_SIZE];
+  uint32_t offset, n, i;
+  uint16_t id;
+
+  if (address + size > WSF_FLASH_EFS_SIZE)
+  {
+    return WSF_EFS_FAILURE;
+  }
+
+  while (size)
+  {
+    id     = (uint16_t) (WSF_FLASH_ID_EFS_BASE + address / WSF_FLASH_EFS_PAGE_SIZE);
+    offset = address % WSF_FLASH_EFS_PAGE_SIZE;
+    n      = WSF_FLASH_EFS_PAGE_SIZE - offset;
+    if (n > size) n = size;
+
+    if (n < WSF_FLASH_EFS_PAGE_SIZE)
+    {
+      wsfFlashEfsReadPage(id, page);
+    }
+
+    if (pBuf)
+    {
+      memcpy(page + offset, pBuf, n);
+      pBuf += n;
+    }
+    else
+    {
+      memset(page + offset, 0xFF, n);
+    }
+
+    /* an erased page does not need a record */
+    for (i = 0; i < WSF_FLASH_EFS_PAGE_SIZE && page[i] == 0xFF; i++);
+
+    if (i == WSF_FLASH_EFS_PAGE_SIZE)
+    {
+      WsfFlashDelete(id);
+    }
+    else if (WsfFlashWrite(id, page, WSF_FLASH_EFS_PAGE_SIZE) != WSF_FLASH_SUCCESS)
+    {
+      return WSF_EFS_FAILURE;
+    }
+
+    address += n;
+    size    -= n;
+  }
+
+  return WSF_EFS_SUCCESS;
+}
+
+static uint8_t wsfFlashEfsInit(void)
+{
+  return (wsfFlashCb.pDev != NULL) ? WSF_EFS_SUCCESS : WSF_EFS_FAILURE;
+}
+
+static uint8_t wsfFlashEfsErase(uint32_t address, uint32_t size)
+{
+  return wsfFlashEfsUpdate(NULL, address, size);
+}
+
+static uint8_t wsfFlashEfsWrite(const uint8_t *pBuf, uint32_t address, uint32_t size)
+{
+  return wsfFlashEfsUpdate(pBuf, address, size);
+}
+
+static uint8_t wsfFlashEfsRead(uint8_t *pBuf, uint32_t address, uint32_t size)
+{
+  uint8_t page[WSF_FLASH_EFS_PAGE_SIZE];
+  uint32_t offset, n;
+
+  if (address + size > WSF_FLASH_EFS_SIZE)
+  {
+    return WSF_EFS_FAILURE;
+  }
+
+  while (size)
+  {
+    offset = address % WSF_FLASH_EFS_PAGE_SIZE;
+    n      = WSF_FLASH_EFS_PAGE_SIZE - offset;
+    if (n > size) n = size;
+
+    wsfFlashEfsReadPage((uint16_t) (WSF_FLASH_ID_EFS_BASE + address / WSF_FLASH_EFS_PAGE_SIZE), page);
+    memcpy(pBuf, page + offset, n);
+
+    pBuf    += n;
+    address += n;
+    size    -= n;
+  }
+
+  return WSF_EFS_SUCCESS;
+}
+
+static uint8_t wsfFlashEfsHandleCmd(uint8_t cmd, uint32_t param)
+{
+  (void) param;
+
+  /* a file transfer is complete : make sure it is on flash */
+  if (cmd == WSF_EFS_WDXS_PUT_COMPLETE_CMD || cmd == WSF_EFS_VALIDATE_CMD)
+  {
+    return WsfFlashSync();
+  }
+
+  return WSF_EFS_FAILURE;
+}
+
+const wsfEfsMedia_t WsfFlashEfsMedia =
+{
+  0,
+  WSF_FLASH_EFS_SIZE,
+  WSF_FLASH_EFS_PAGE_SIZE,
+  wsfFlashEfsInit,
+  wsfFlashEfsErase,
+  wsfFlashEfsRead,
+  wsfFlashEfsWrite,
+  wsfFlashEfsHandleCmd
+};
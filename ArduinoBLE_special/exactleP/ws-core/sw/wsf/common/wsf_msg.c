@@ -20,6 +20,9 @@
  */
 /*************************************************************************************************/
 
+/* module id in binary trace tokens, unique per file (extras/wsf-trace-tokens.py), added paulvha */
+#define MODULE_ID   4
+
 #include "wsf_types.h"
 #include "wsf_msg.h"
 #include "wsf_assert.h"
@@ -20,6 +20,9 @@
  */
 /*************************************************************************************************/
 
+/* module id in binary trace tokens, unique per file (extras/wsf-trace-tokens.py), added paulvha */
+#define MODULE_ID   7
+
 #include "wsf_types.h"
 #include "wsf_assert.h"
 #include "wsf_trace.h"
@@ -20,6 +20,9 @@
  */
 /*************************************************************************************************/
 
+/* module id in binary trace tokens, unique per file (extras/wsf-trace-tokens.py), added paulvha */
+#define MODULE_ID   6
+
 #ifdef __IAR_SYSTEMS_ICC__
 #include <intrinsics.h>
 #endif
@@ -0,0 +1,231 @@
+/*************************************************************************************************/
+/*!
+ *  \file   wsf_flash.h
+ *
+ *  \brief  Log structured, wear leveled record store on flash.
+ *
+ *          Records (id + data) are appended to erase blocks through a RAM page buffer. A RAM
+ *          index holds the location of the newest copy of each record. When the flash is full
+ *          the block with the least live data is compacted and erased, and cold blocks are
+ *          moved once their erase count falls behind, to spread the wear over all blocks.
+ *
+ *          The store is used as media for the WSF embedded file system (WsfFlashEfsMedia) and
+ *          by ArduinoBLE_P as the default store for bonding keys.
+ *
+ *          added paulvha / October 2026
+ */
+/*************************************************************************************************/
+
+#ifndef WSF_FLASH_H
+#define WSF_FLASH_H
+
+#include "wsf_efs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**************************************************************************************************
+  Macros
+**************************************************************************************************/
+
+/* Max number of records in the RAM index (each entry is 12 bytes) */
+#ifndef WSF_FLASH_MAX_RECORDS
+#define WSF_FLASH_MAX_RECORDS               64
+#endif
+
+/* Max number of erase blocks */
+#ifndef WSF_FLASH_MAX_BLOCKS
+#define WSF_FLASH_MAX_BLOCKS                16
+#endif
+
+/* Size of the RAM page buffer, writes are collected before programming the flash */
+#ifndef WSF_FLASH_PAGE_SIZE
+#define WSF_FLASH_PAGE_SIZE                 256
+#endif
+
+/* Erase count difference between blocks that triggers moving cold data */
+#ifndef WSF_FLASH_WEAR_DELTA
+#define WSF_FLASH_WEAR_DELTA                8
+#endif
+
+/* Number of leading data bytes of a record that can be searched with WsfFlashFind() */
+#define WSF_FLASH_TAG_LEN                   6
+
+/* Record identifiers. 0xFFFF is reserved (erased flash) */
+#define WSF_FLASH_ID_INVALID                0xFFFF
+#define WSF_FLASH_ID_EFS_BASE               0x0000        /*! EFS media pages */
+#define WSF_FLASH_ID_EFS_LAST               0x7FFF
+#define WSF_FLASH_ID_BOND_BASE              0x8000        /*! Bonding keys (ArduinoBLE_P) */
+#define WSF_FLASH_ID_BOND_LAST              0x80FF
+#define WSF_FLASH_ID_USER_BASE              0x9000        /*! Free for applications */
+
+/* Status codes, same values as WSF EFS */
+#define WSF_FLASH_SUCCESS                   WSF_EFS_SUCCESS
+#define WSF_FLASH_FAILURE                   WSF_EFS_FAILURE
+
+/* EFS media : size of a logical page and of the address space */
+#ifndef WSF_FLASH_EFS_PAGE_SIZE
+#define WSF_FLASH_EFS_PAGE_SIZE             64
+#endif
+
+#ifndef WSF_FLASH_EFS_SIZE
+#define WSF_FLASH_EFS_SIZE                  (16 * 1024)
+#endif
+
+/**************************************************************************************************
+  Data Types
+**************************************************************************************************/
+
+/* Flash device. Programming can only clear bits, erasing a block sets all bytes to 0xFF.
+ * Addresses are relative to the start of the store. All callbacks return WSF_FLASH_SUCCESS or
+ * WSF_FLASH_FAILURE. */
+typedef struct
+{
+  uint32_t  blockSize;                                                  /*! Erase block size */
+  uint16_t  numBlocks;                                                  /*! Number of blocks */
+  uint8_t   (*read)(uint32_t address, uint8_t *pBuf, uint32_t len);
+  uint8_t   (*program)(uint32_t address, const uint8_t *pBuf, uint32_t len);  /*! len multiple of 4 */
+  uint8_t   (*erase)(uint16_t block);
+} wsfFlashDev_t;
+
+/* Statistics, to measure write amplification and wear */
+typedef struct
+{
+  uint32_t  userBytes;          /*! Bytes of record data written by the user */
+  uint32_t  programBytes;       /*! Bytes programmed to flash (headers, padding and compaction) */
+  uint32_t  programCalls;       /*! Number of program calls to the device */
+  uint32_t  erases;             /*! Number of block erases */
+  uint32_t  minEraseCount;      /*! Lowest erase count of a block */
+  uint32_t  maxEraseCount;      /*! Highest erase count of a block */
+  uint16_t  records;            /*! Live records */
+  uint32_t  liveBytes;          /*! Bytes used by live records */
+} wsfFlashStats_t;
+
+/**************************************************************************************************
+  Function Declarations
+**************************************************************************************************/
+
+/*************************************************************************************************/
+/*!
+ *  \fn     WsfFlashInit
+ *
+ *  \brief  Mount the store on a flash device and build the RAM index. Blocks without a valid
+ *          header are erased and formatted.
+ *
+ *  \param  pDev      Flash device, must stay valid while the store is used.
+ *
+ *  \return WSF_FLASH_SUCCESS or WSF_FLASH_FAILURE.
+ */
+/*************************************************************************************************/
+uint8_t WsfFlashInit(const wsfFlashDev_t *pDev);
+
+/*************************************************************************************************/
+/*!
+ *  \fn     WsfFlashWrite
+ *
+ *  \brief  Write a record, replacing an earlier record with the same id.
+ *
+ *  \param  id        Record identifier.
+ *  \param  pData     Record data.
+ *  \param  len       Length of the data.
+ *
+ *  \return WSF_FLASH_SUCCESS or WSF_FLASH_FAILURE (store full or not initialized).
+ *
+ *  The record can stay in the RAM page buffer until WsfFlashSync() is called.
+ */
+/*************************************************************************************************/
+uint8_t WsfFlashWrite(uint16_t id, const uint8_t *pData, uint16_t len);
+
+/*************************************************************************************************/
+/*!
+ *  \fn     WsfFlashRead
+ *
+ *  \brief  Read a record.
+ *
+ *  \param  id        Record identifier.
+ *  \param  pBuf      Buffer for the data.
+ *  \param  len       Size of pBuf.
+ *
+ *  \return Length of the record (can be more than len), or 0 if not found.
+ */
+/*************************************************************************************************/
+uint16_t WsfFlashRead(uint16_t id, uint8_t *pBuf, uint16_t len);
+
+/*************************************************************************************************/
+/*!
+ *  \fn     WsfFlashDelete
+ *
+ *  \brief  Delete a record.
+ *
+ *  \param  id        Record identifier.
+ *
+ *  \return WSF_FLASH_SUCCESS or WSF_FLASH_FAILURE.
+ */
+/*************************************************************************************************/
+uint8_t WsfFlashDelete(uint16_t id);
+
+/*************************************************************************************************/
+/*!
+ *  \fn     WsfFlashFind
+ *
+ *  \brief  Find a record in an id range by the first WSF_FLASH_TAG_LEN bytes of its data.
+ *
+ *  \param  idFirst   First id of the range.
+ *  \param  idLast    Last id of the range.
+ *  \param  pTag      WSF_FLASH_TAG_LEN bytes to match.
+ *
+ *  \return Record id, or WSF_FLASH_ID_INVALID.
+ */
+/*************************************************************************************************/
+uint16_t WsfFlashFind(uint16_t idFirst, uint16_t idLast, const uint8_t *pTag);
+
+/*************************************************************************************************/
+/*!
+ *  \fn     WsfFlashNextId
+ *
+ *  \brief  Iterate over the records in an id range.
+ *
+ *  \param  id        Start id (inclusive).
+ *  \param  idLast    Last id of the range.
+ *
+ *  \return First existing record id >= id, or WSF_FLASH_ID_INVALID.
+ */
+/*************************************************************************************************/
+uint16_t WsfFlashNextId(uint16_t id, uint16_t idLast);
+
+/*************************************************************************************************/
+/*!
+ *  \fn     WsfFlashSync
+ *
+ *  \brief  Program the RAM page buffer to flash.
+ *
+ *  \return WSF_FLASH_SUCCESS or WSF_FLASH_FAILURE.
+ */
+/*************************************************************************************************/
+uint8_t WsfFlashSync(void);
+
+/*************************************************************************************************/
+/*!
+ *  \fn     WsfFlashGetStats
+ *
+ *  \brief  Get the statistics of the store.
+ *
+ *  \param  pStats    Statistics.
+ *
+ *  \return None.
+ */
+/*************************************************************************************************/
+void WsfFlashGetStats(wsfFlashStats_t *pStats);
+
+/*! Media for the WSF embedded file system, register with WsfEfsRegisterMedia() after WsfFlashInit() */
+extern const wsfEfsMedia_t WsfFlashEfsMedia;
+
+/*! Apollo3 flash device (wsf_flash_apollo3.c) */
+extern const wsfFlashDev_t WsfFlashApollo3Dev;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WSF_FLASH_H */
@@ -1,5 +1,12 @@
 # Created by Huseyin Meric Yigit
 # part taken from https://github.com/hmyit/crc32-python/blob/master/crc32.py
+#
+# paulvha / October 2026
+# crc32() now uses zlib.crc32 (in C, same CRC-32), which is many times faster
+# than the table loop in Python. The table version is kept as crc32_table().
+# python3 crc.py compares both from 20 bytes to 64 Kbyte.
+import zlib
+
 class crc():
 
     def __init__(self):
@@ -14,7 +21,14 @@ class crc():
                 byte >>= 1
             self.table.append(crc)
 
-    def crc32(self, data, len):
+    def crc32(self, data, len, value = 0):
+        """
+            CRC32 of the first len bytes of data (list, bytes or bytearray)
+            value : the result of a previous call, to continue over the next part
+        """
+        return zlib.crc32(bytes(data[:len]), value)
+
+    def crc32_table(self, data, len):
         value = 0xffffffff
         i = 0
         while i < len:
@@ -23,3 +37,23 @@ class crc():
             i += 1
 
         return (0xffffffff - value)
+
+if __name__ == "__main__":
+    import os
+    import timeit
+
+    cc = crc()
+    print("CRC-32 (MB/s)   table     zlib")
+
+    for size in (20, 64, 128, 244, 512, 1024, 4096, 16384, 65536):
+        data = list(os.urandom(size))
+
+        if cc.crc32(data, size) != cc.crc32_table(data, size):
+            print("different CRC on {0} bytes".format(size))
+            break
+
+        loops = max(1, 200000 // size)
+        table = timeit.timeit(lambda: cc.crc32_table(data, size), number = loops)
+        fast = timeit.timeit(lambda: cc.crc32(data, size), number = loops * 20)
+        print("{0:6d} bytes {1:8.2f} {2:8.1f}".format(size, size * loops / table / 1e6,
+              size * loops * 20 / fast / 1e6))
@@ -31,7 +31,11 @@ import logging
 import asyncio
 import struct                       # data parsing
 from bleak import BleakClient
-from amdtpc import AmdtpClient
+# the AMDTP core of the Artemis (needs libamdtp.so, see amdtpcore.py), else pure Python
+try:
+    from amdtpcore import AmdtpCoreClient as AmdtpClient
+except (ImportError, OSError):
+    from amdtpc import AmdtpClient
 from bleak import _logger as logger
 from bleak.uuids import uuid16_dict
 import os                           # for keyboard read
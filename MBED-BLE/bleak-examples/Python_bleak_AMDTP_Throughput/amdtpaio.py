@@ -0,0 +1,405 @@
+#!/usr/bin/python3
+# -*- coding: UTF-8 -*-
+import asyncio
+import struct
+import zlib
+
+"""
+Paul van Haastrecht - October 2026 / version 1.0
+
+AMDTP for asyncio : the same protocol as amdtpc.py (stop-and-wait, as the Artemis server
+without AmdtpNegotiate()), but as a class that can be used in any bleak program :
+
+    async with AmdtpClient(write) as amdtp:
+        await client.start_notify(ATT_UUID_AMDTP_TX, amdtp.notify)
+        await client.start_notify(ATT_UUID_AMDTP_ACK, amdtp.notify)
+
+        await amdtp.send(b"\x07")           # returns when the server has acknowledged it
+        data = await amdtp.recv()           # the next data packet of the server (bytes)
+
+write is a coroutine function that writes a frame (bytearray or memoryview) to the server,
+with bleak :
+
+    async def write(frame):
+        await client.write_gatt_char(ATT_UUID_AMDTP_RX, frame)
+
+Compared to amdtpc.py :
+    * no globals and no polling loop : packets are sent by one sender task, the ACK and
+      CONTROL frames go through a queue to one writer task
+    * a frame is added to a bytearray as it arrives, the frames to send are memoryview
+      slices of the packet, the CRC is zlib.crc32 over a memoryview (no lists)
+    * backpressure : send() waits while tx_queue packets are waiting. When recv() is not
+      called and rx_queue packets are waiting, the ACK of the next packet is held until
+      there is room, so the server stops sending
+    * a packet that is not acknowledged in time raises AmdtpError (amdtpc.py waits forever)
+
+python3 bench_aio.py compares the time per message with amdtpc.py and amdtpcore.py against
+a mock server in the same process.
+
+Keyword Args:
+    mtu = 23        ATT MTU, a frame is at most mtu - 3 bytes (update_mtu() to change it)
+    tx_queue = 4    packets send() can queue before it waits
+    rx_queue = 16   packets received before the ACK is held
+    timeout = 5.0   seconds for SEND_READY or the ACK of the server
+    retries = 3     the server reported a CRC error : send the packet again
+    debug = False   print the frames
+"""
+
+#********************************************************************
+# as in amdtp_common.h
+ATT_DEFAULT_MTU   = 23
+ATT_MAX_MTU       = 200                     # Maximum value of ATT_MTU
+
+# eAmdtpStatus
+AMDTP_STATUS_SUCCESS =               0x00
+AMDTP_STATUS_CRC_ERROR =             0x01
+AMDTP_STATUS_INVALID_METADATA_INFO = 0x02
+AMDTP_STATUS_INVALID_PKT_LENGTH =    0x03
+AMDTP_STATUS_INSUFFICIENT_BUFFER =   0x04
+AMDTP_STATUS_UNKNOWN_ERROR =         0x05
+AMDTP_STATUS_BUSY =                  0x06
+AMDTP_STATUS_TX_NOT_READY =          0x07
+AMDTP_STATUS_RESEND_REPLY =          0x08
+
+# eAmdtpPktType
+AMDTP_PKT_TYPE_DATA =        0x01
+AMDTP_PKT_TYPE_ACK =         0x02
+AMDTP_PKT_TYPE_CONTROL =     0x03
+
+AMDTP_CONTROL_RESEND_REQ =   0x00
+AMDTP_CONTROL_SEND_READY =   0x01
+
+AMDTP_MAX_PAYLOAD_SIZE    =  512
+AMDTP_PREFIX_SIZE_IN_PKT  =  4              # length (2) and header (2)
+AMDTP_CRC_SIZE_IN_PKT     =  4
+AMDTP_ACK_SIZE            =  20             # longest ACK or CONTROL packet taken between data frames
+
+HEADER_ACK_BIT            =  0x40           # first header byte : confirm each frame (SEND_READY)
+
+def build_packet(ptype, sn, data, confirm = False):
+    """
+        length, header, data and CRC of a packet in a bytearray
+    """
+    n = len(data)
+    pkt = bytearray(n + AMDTP_PREFIX_SIZE_IN_PKT + AMDTP_CRC_SIZE_IN_PKT)
+    struct.pack_into("<HBB", pkt, 0, n + AMDTP_CRC_SIZE_IN_PKT, HEADER_ACK_BIT if confirm else 0,
+                     ptype << 4 | sn)
+    pkt[AMDTP_PREFIX_SIZE_IN_PKT:AMDTP_PREFIX_SIZE_IN_PKT + n] = data
+    struct.pack_into("<I", pkt, AMDTP_PREFIX_SIZE_IN_PKT + n, zlib.crc32(data))
+    return pkt
+
+def is_ack_frame(frame):
+    """
+        a frame that is a complete ACK or CONTROL packet with a correct CRC
+        (isAckFrame() in amdtp_core.c)
+    """
+    n = len(frame)
+    if n < AMDTP_PREFIX_SIZE_IN_PKT + AMDTP_CRC_SIZE_IN_PKT + 1 or n > AMDTP_ACK_SIZE:
+        return False
+
+    length, _, header = struct.unpack_from("<HBB", frame)
+    if length + AMDTP_PREFIX_SIZE_IN_PKT != n or header >> 4 not in (AMDTP_PKT_TYPE_ACK, AMDTP_PKT_TYPE_CONTROL):
+        return False
+
+    body = memoryview(frame)[AMDTP_PREFIX_SIZE_IN_PKT:n - AMDTP_CRC_SIZE_IN_PKT]
+    return zlib.crc32(body) == struct.unpack_from("<I", frame, n - AMDTP_CRC_SIZE_IN_PKT)[0]
+
+class AmdtpError(Exception):
+    """ a packet was not delivered, status is the eAmdtpStatus of the server (or TX_NOT_READY) """
+
+    def __init__(self, status, text):
+        super().__init__("{0} (status {1})".format(text, status))
+        self.status = status
+
+class AmdtpClient():
+
+    def __init__(self, write, mtu = ATT_DEFAULT_MTU, tx_queue = 4, rx_queue = 16, timeout = 5.0,
+                 retries = 3, debug = False):
+        self._write = write
+        self.mtu = min(mtu, ATT_MAX_MTU)
+        self.timeout = timeout
+        self.retries = retries
+        self.debug = debug
+        self._tx_queue = tx_queue
+        self._rx_queue = rx_queue
+
+        self._txq = None                    # (data, future) for the sender task
+        self._rxq = None                    # data packets for recv()
+        self._wq = None                     # frames for the writer task
+        self._tasks = []
+        self._error = None                  # the write failed, the client is closed
+
+        self._tx_sn = 0
+        self._peer = None                   # future for SEND_READY or the ACK
+
+        self._rx = bytearray()              # packet being received
+        self._rx_len = 0                    # length field of the packet, data plus CRC
+        self._rx_header = None              # (type, sn, confirm), None between packets
+        self._rx_count = 0                  # frames confirmed with SEND_READY
+        self._last_rx_sn = 0
+        self._held = None                   # data packet waiting for room in rx_queue
+
+        self.stats = dict.fromkeys(("packets_sent", "packets_received", "frames_sent", "frames_received",
+                                    "packets_resent", "crc_errors", "acks_held", "timeouts"), 0)
+
+    #
+    # start / stop
+    #
+    async def start(self):
+        """ start the writer and sender tasks, async with does this """
+        loop = asyncio.get_running_loop()
+        self._txq = asyncio.Queue(self._tx_queue)
+        self._rxq = asyncio.Queue(self._rx_queue)
+        self._wq = asyncio.Queue()
+        self._tasks = [loop.create_task(self._writer()), loop.create_task(self._sender())]
+
+    async def close(self):
+        for task in self._tasks:
+            task.cancel()
+        await asyncio.gather(*self._tasks, return_exceptions = True)
+        self._tasks = []
+
+    async def __aenter__(self):
+        await self.start()
+        return self
+
+    async def __aexit__(self, *exc):
+        await self.close()
+
+    def update_mtu(self, mtu):
+        """ new MTU agreed, used from the next packet """
+        self.mtu = min(mtu, ATT_MAX_MTU)
+
+    #
+    # user interface
+    #
+    async def send(self, data):
+        """
+            send a data packet (bytes, bytearray or memoryview, at most 512 bytes). Waits while
+            tx_queue packets are waiting, returns when the server has acknowledged it.
+            Raises AmdtpError when the server refuses it or does not answer in time
+        """
+        if len(data) > AMDTP_MAX_PAYLOAD_SIZE:
+            raise AmdtpError(AMDTP_STATUS_INVALID_PKT_LENGTH, "more than {0} bytes".format(AMDTP_MAX_PAYLOAD_SIZE))
+
+        self._check()
+        done = asyncio.get_running_loop().create_future()
+        await self._txq.put((bytes(data), done))
+        return await done
+
+    async def recv(self):
+        """ the next data packet of the server (bytes) """
+        self._check()
+        data = await self._rxq.get()
+
+        # room again : take the held packet and acknowledge it
+        if self._held is not None:
+            self._rxq.put_nowait(self._held)
+            self._held = None
+            self._reply(AMDTP_STATUS_SUCCESS)
+
+        return data
+
+    def notify(self, sender, data):
+        """
+            the bleak notification handler, for the TX (data) and the ACK characteristic
+        """
+        self.stats["frames_received"] += 1
+
+        if self.debug:
+            print("received : {0}".format(bytes(data).hex(" ")))
+
+        # an ACK or CONTROL can come in between the frames of a data packet
+        if self._rx_header is not None and is_ack_frame(data):
+            self._packet(data[3] >> 4, memoryview(data)[AMDTP_PREFIX_SIZE_IN_PKT:len(data) - AMDTP_CRC_SIZE_IN_PKT])
+            return
+
+        mv = memoryview(data)
+
+        if self._rx_header is None:
+            if len(data) < AMDTP_PREFIX_SIZE_IN_PKT:
+                self._reply(AMDTP_STATUS_INVALID_PKT_LENGTH)
+                return
+
+            self._rx_len, h1, h2 = struct.unpack_from("<HBB", data)
+            self._rx_header = (h2 >> 4, h2 & 0x0f, h1 & HEADER_ACK_BIT)
+            self._rx_count = 0
+            del self._rx[:]
+            mv = mv[AMDTP_PREFIX_SIZE_IN_PKT:]
+
+        self._rx += mv
+        ptype, sn, confirm = self._rx_header
+
+        if len(self._rx) < self._rx_len:
+            if len(self._rx) > AMDTP_MAX_PAYLOAD_SIZE + AMDTP_CRC_SIZE_IN_PKT:
+                self._rx_header = None
+                self._reply(AMDTP_STATUS_INSUFFICIENT_BUFFER)
+            elif ptype == AMDTP_PKT_TYPE_DATA and confirm:
+                self._rx_count = (self._rx_count + 1) & 0xff     # the count starts with 1
+                self._control(AMDTP_CONTROL_SEND_READY, self._rx_count)
+            return
+
+        # complete
+        self._rx_header = None
+        n = self._rx_len
+
+        if n < AMDTP_CRC_SIZE_IN_PKT + (ptype != AMDTP_PKT_TYPE_DATA):
+            self._reply(AMDTP_STATUS_INVALID_PKT_LENGTH)
+            return
+
+        body = memoryview(self._rx)[:n - AMDTP_CRC_SIZE_IN_PKT]
+        if zlib.crc32(body) != struct.unpack_from("<I", self._rx, n - AMDTP_CRC_SIZE_IN_PKT)[0]:
+            body.release()
+            self.stats["crc_errors"] += 1
+            self._reply(AMDTP_STATUS_CRC_ERROR)
+            return
+
+        if ptype == AMDTP_PKT_TYPE_DATA:
+            self._last_rx_sn = sn
+            self._data(bytes(body))
+        else:
+            self._packet(ptype, body)
+        body.release()
+
+    #
+    # receive
+    #
+    def _data(self, data):
+        self.stats["packets_received"] += 1
+
+        if self._rxq.full():
+            self.stats["acks_held"] += 1
+            self._held = data
+            return
+
+        self._rxq.put_nowait(data)
+        self._reply(AMDTP_STATUS_SUCCESS)
+
+    def _packet(self, ptype, body):
+        """ a complete ACK or CONTROL packet (without CRC) """
+        if ptype == AMDTP_PKT_TYPE_ACK:
+            self._answer(AMDTP_PKT_TYPE_ACK, body[0])
+
+        elif body[0] == AMDTP_CONTROL_SEND_READY:
+            self._answer(AMDTP_CONTROL_SEND_READY, body[1] if len(body) > 1 else 0)
+
+        elif body[0] == AMDTP_CONTROL_RESEND_REQ and len(body) > 1:
+            # as amdtpc.py
+            if body[1] > self._last_rx_sn:
+                self._reply(AMDTP_STATUS_RESEND_REPLY)
+            elif body[1] == self._last_rx_sn:
+                self._reply(AMDTP_STATUS_SUCCESS)
+
+        # WINDOW_REQ etc. are not known : the server stays stop-and-wait
+
+    def _answer(self, what, value):
+        if self._peer is not None and not self._peer.done():
+            self._peer.set_result((what, value))
+        elif self.debug:
+            print("Warning : unexpected {0}".format("ACK" if what == AMDTP_PKT_TYPE_ACK else "SEND_READY"))
+
+    #
+    # send
+    #
+    def _frame(self, frame):
+        self._wq.put_nowait(frame)
+
+    def _reply(self, status):
+        self._frame(build_packet(AMDTP_PKT_TYPE_ACK, 0, bytes((status,))))
+
+    def _control(self, code, value):
+        self._frame(build_packet(AMDTP_PKT_TYPE_CONTROL, 0, bytes((code, value))))
+
+    async def _write_frame(self, frame):
+        if self.debug:
+            print("send     : {0}".format(bytes(frame).hex(" ")))
+
+        try:
+            await self._write(frame)
+        except asyncio.CancelledError:
+            raise
+        except Exception as e:
+            self._error = e
+            raise AmdtpError(AMDTP_STATUS_TX_NOT_READY, "write failed : {0}".format(e))
+
+        self.stats["frames_sent"] += 1
+
+    async def _writer(self):
+        """ the ACK and CONTROL frames, the sender task writes the data frames itself """
+        while True:
+            frame = await self._wq.get()
+            try:
+                await self._write_frame(frame)
+            except AmdtpError as e:
+                if self._peer is not None and not self._peer.done():
+                    self._peer.set_exception(e)
+                return
+
+    async def _sender(self):
+        while True:
+            data, done = await self._txq.get()
+            if done.cancelled():
+                continue
+
+            try:
+                done.set_result(await self._send_packet(data))
+            except asyncio.CancelledError:
+                done.cancel()
+                raise
+            except Exception as e:
+                done.set_exception(e)
+
+    def _no_answer(self, peer):
+        if not peer.done():
+            self.stats["timeouts"] += 1
+            peer.set_exception(AmdtpError(AMDTP_STATUS_TX_NOT_READY, "no answer of the server"))
+
+    async def _wait_peer(self, loop):
+        # call_later() instead of asyncio.wait_for(), that is a task per frame
+        timer = loop.call_later(self.timeout, self._no_answer, self._peer)
+        try:
+            return await self._peer
+        finally:
+            timer.cancel()
+
+    async def _send_packet(self, data):
+        loop = asyncio.get_running_loop()
+        size = self.mtu - 3
+        pkt = build_packet(AMDTP_PKT_TYPE_DATA, self._tx_sn, data,
+                           len(data) + AMDTP_PREFIX_SIZE_IN_PKT + AMDTP_CRC_SIZE_IN_PKT > size)
+        mv = memoryview(pkt)
+
+        for attempt in range(self.retries + 1):
+            if attempt:
+                self.stats["packets_resent"] += 1
+
+            for offset in range(0, len(pkt), size):
+                # the answer can come before this task runs again
+                self._peer = loop.create_future()
+                await self._write_frame(mv[offset:offset + size])
+                what, status = await self._wait_peer(loop)
+
+                # an ACK before the last frame : the server gave up on the packet
+                if what == AMDTP_PKT_TYPE_ACK:
+                    break
+
+            self._peer = None
+
+            if what != AMDTP_PKT_TYPE_ACK:
+                raise AmdtpError(AMDTP_STATUS_UNKNOWN_ERROR, "SEND_READY after the last frame")
+
+            if status not in (AMDTP_STATUS_CRC_ERROR, AMDTP_STATUS_RESEND_REPLY):
+                break
+
+        if status != AMDTP_STATUS_SUCCESS:
+            raise AmdtpError(status, "packet refused by the server")
+
+        self._tx_sn = (self._tx_sn + 1) & 0x0f
+        self.stats["packets_sent"] += 1
+        return status
+
+    def _check(self):
+        if self._error is not None:
+            raise AmdtpError(AMDTP_STATUS_TX_NOT_READY, "write failed : {0}".format(self._error))
+        if not self._tasks:
+            raise AmdtpError(AMDTP_STATUS_TX_NOT_READY, "not started, use async with or start()")
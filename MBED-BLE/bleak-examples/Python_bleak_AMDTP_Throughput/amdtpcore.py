@@ -0,0 +1,327 @@
+#!/usr/bin/python3
+# -*- coding: UTF-8 -*-
+import ctypes
+import os
+
+"""
+Paul van Haastrecht - October 2026 / version 1.0
+
+The AMDTP core (MBED-BLE/src/amdtp/amdtp_core.c) for Python, the same protocol code as
+used on the Artemis / Apollo3 and by amdtc on a Raspberry Pi.
+
+AmdtpCoreClient has the same interface as AmdtpClient in amdtpc.py, so main.py can use
+either. It needs libamdtp.so, created with ./make_amdtp_sim in MBED-BLE/extras/amdtp_sim.
+The library is searched :
+    * the library keyword argument
+    * the environment variable AMDTP_LIB
+    * this directory
+    * ../../extras/amdtp_sim (as in the MBED-BLE library folder)
+
+If it is not found, OSError is raised and main.py falls back to amdtpc.py.
+
+Compared to amdtpc.py, the core also :
+    * offers the sliding window mode (needs timer_callback) and streams to the server
+    * handles a lost frame or ACK (in window mode)
+    * counts what happens (Stats())
+    * can compress the packets it sends (compress = True)
+    * can encrypt the data packets with AES-CCM (key = 16 bytes, the same on the server)
+
+Keyword Args (on top of amdtpc.py):
+    timer_callback:           call Timeout() after ms, 0 cancels. Without it only stop-and-wait
+    window = 0                window to offer with Negotiate(), needs timer_callback
+    compress = False          compress packets sent, when the server supports it (learned with Negotiate())
+    key = None                16 bytes : only send and accept encrypted data packets, the session key
+                              is agreed with Negotiate(). Until then AmdtpSendData() fails
+    Received_stream_callback: part of a stream received (data, len, offset)
+    Stream_done_callback:     a received stream was closed (status, len)
+    Received_part_callback:   cut-through, part of a data packet as it arrives (data, len, offset).
+                              Received_data_callback is then not called
+    Part_done_callback:       cut-through, result of the data packet (status, len)
+    library                   path to libamdtp.so
+"""
+
+#********************************************************************
+# as in amdtp_common.h (NOT the same numbers as amdtpc.py)
+ATT_DEFAULT_MTU   = 23
+ATT_MAX_MTU       = 200                     # Maximum value of ATT_MTU
+
+# eAmdtpStatus
+AMDTP_STATUS_SUCCESS =               0x00
+AMDTP_STATUS_CRC_ERROR =             0x01
+AMDTP_STATUS_INVALID_METADATA_INFO = 0x02
+AMDTP_STATUS_INVALID_PKT_LENGTH =    0x03
+AMDTP_STATUS_INSUFFICIENT_BUFFER =   0x04
+AMDTP_STATUS_UNKNOWN_ERROR =         0x05
+AMDTP_STATUS_BUSY =                  0x06
+AMDTP_STATUS_TX_NOT_READY =          0x07
+AMDTP_STATUS_RESEND_REPLY =          0x08
+AMDTP_STATUS_RECEIVE_CONTINUE =      0x09
+AMDTP_STATUS_RECEIVE_DONE =          0x0a
+
+# eAmdtpPktType
+AMDTP_PKT_TYPE_DATA =        0x01
+AMDTP_PKT_TYPE_ACK =         0x02
+AMDTP_PKT_TYPE_CONTROL =     0x03
+
+AMDTP_MAX_PAYLOAD_SIZE    =  512
+AMDTP_STREAM_LEN_UNKNOWN  =  0xFFFFFFFF
+
+class AmdtpCoreStats(ctypes.Structure):
+    """ amdtpCoreStats_t in amdtp_core.h """
+    _fields_ = [(name, ctypes.c_uint32) for name in (
+        "packetsSent", "packetsReceived", "framesSent", "framesResent",
+        "framesReceived", "framesDuplicate", "controlSent", "sendBusy",
+        "timeouts", "crcErrors", "streamsSent", "streamsReceived",
+        "packetsCompressed", "bytesSaved", "authErrors", "framesReordered",
+        "framesStale")]
+
+# callbacks, see amdtpCoreCallbacks_t
+_SEND = ctypes.CFUNCTYPE(ctypes.c_bool, ctypes.c_void_p, ctypes.c_int, ctypes.POINTER(ctypes.c_uint8), ctypes.c_uint16)
+_RECEIVED = ctypes.CFUNCTYPE(None, ctypes.c_void_p, ctypes.POINTER(ctypes.c_uint8), ctypes.c_uint16)
+_SENT = ctypes.CFUNCTYPE(None, ctypes.c_void_p, ctypes.c_int)
+_TIMER = ctypes.CFUNCTYPE(None, ctypes.c_void_p, ctypes.c_uint32)
+_STREAM_RECEIVED = ctypes.CFUNCTYPE(None, ctypes.c_void_p, ctypes.POINTER(ctypes.c_uint8), ctypes.c_uint16, ctypes.c_uint32)
+_STREAM_DONE = ctypes.CFUNCTYPE(None, ctypes.c_void_p, ctypes.c_int, ctypes.c_uint32)
+_WRITABLE = ctypes.CFUNCTYPE(None, ctypes.c_void_p)
+_PART_RECEIVED = ctypes.CFUNCTYPE(None, ctypes.c_void_p, ctypes.POINTER(ctypes.c_uint8), ctypes.c_uint16, ctypes.c_uint16)
+_PART_DONE = ctypes.CFUNCTYPE(None, ctypes.c_void_p, ctypes.c_int, ctypes.c_uint16)
+
+_lib = None
+
+def LoadLibrary(path = None):
+    """
+        load libamdtp.so (once), raises OSError if not found
+    """
+    global _lib
+
+    if _lib is not None:
+        return _lib
+
+    here = os.path.dirname(os.path.abspath(__file__))
+    tries = [path, os.environ.get("AMDTP_LIB"),
+             os.path.join(here, "libamdtp.so"),
+             os.path.join(here, "..", "..", "extras", "amdtp_sim", "libamdtp.so")]
+
+    for name in tries:
+        if name and os.path.isfile(name):
+            lib = ctypes.CDLL(name)
+            break
+    else:
+        raise OSError("libamdtp.so not found, run make_amdtp_sim in MBED-BLE/extras/amdtp_sim")
+
+    p = ctypes.c_void_p
+    lib.AmdtpLibSize.restype = ctypes.c_uint32
+    lib.AmdtpLibSetCallbacks.argtypes = [p, _SEND, _RECEIVED, _SENT, _TIMER, _STREAM_RECEIVED, _STREAM_DONE, _WRITABLE, p]
+    lib.AmdtpLibSetCutThrough.argtypes = [p, _PART_RECEIVED, _PART_DONE]
+    lib.AmdtpLibStats.argtypes = [p]
+    lib.AmdtpLibStats.restype = ctypes.POINTER(AmdtpCoreStats)
+    lib.AmdtpLibWindow.argtypes = [p]
+    lib.AmdtpLibWindow.restype = ctypes.c_uint8
+    lib.AmdtpLibPeerVersion.argtypes = [p]
+    lib.AmdtpLibPeerVersion.restype = ctypes.c_uint8
+    lib.AmdtpLibSecure.argtypes = [p]
+    lib.AmdtpLibSecure.restype = ctypes.c_bool
+
+    for name in ("AmdtpCoreInit", "AmdtpCoreResetTransfer", "AmdtpCoreNegotiate", "AmdtpCorePump", "AmdtpCoreTimeout"):
+        getattr(lib, name).argtypes = [p]
+        getattr(lib, name).restype = None
+
+    lib.AmdtpCoreSetMtu.argtypes = [p, ctypes.c_uint16]
+    lib.AmdtpCoreSetMtu.restype = None
+    lib.AmdtpCoreSetWindow.argtypes = [p, ctypes.c_uint8]
+    lib.AmdtpCoreSetWindow.restype = None
+    lib.AmdtpCoreSetCompress.argtypes = [p, ctypes.c_bool]
+    lib.AmdtpCoreSetCompress.restype = None
+    lib.AmdtpCoreSetKey.argtypes = [p, ctypes.c_char_p]
+    lib.AmdtpCoreSetKey.restype = None
+    lib.AmdtpCoreReceive.argtypes = [p, ctypes.POINTER(ctypes.c_uint8), ctypes.c_uint16]
+    lib.AmdtpCoreReceive.restype = ctypes.c_int
+    lib.AmdtpCoreSend.argtypes = [p, ctypes.POINTER(ctypes.c_uint8), ctypes.c_uint16]
+    lib.AmdtpCoreSend.restype = ctypes.c_int
+    lib.AmdtpCoreSendComplete.argtypes = [p]
+    lib.AmdtpCoreSendComplete.restype = ctypes.c_bool
+    lib.AmdtpCoreStreamOpen.argtypes = [p, ctypes.c_uint32]
+    lib.AmdtpCoreStreamOpen.restype = ctypes.c_int
+    lib.AmdtpCoreStreamWrite.argtypes = [p, ctypes.POINTER(ctypes.c_uint8), ctypes.c_uint16]
+    lib.AmdtpCoreStreamWrite.restype = ctypes.c_uint16
+    lib.AmdtpCoreStreamClose.argtypes = [p]
+    lib.AmdtpCoreStreamClose.restype = ctypes.c_int
+
+    _lib = lib
+    return lib
+
+def _buffer(data, len):
+    """ copy (part of) a list, bytes or bytearray to a C buffer """
+    return (ctypes.c_uint8 * len).from_buffer_copy(bytes(data[:len]))
+
+class AmdtpCoreClient():
+    """
+    Same interface as AmdtpClient in amdtpc.py
+
+    Keyword Args:
+        Received_data_callback:  Call back for final data packet received.
+        send_central_callback:   Call back for data to send to peripheral
+        debug = True         :   will enable debug messages from library
+    """
+
+    def __init__(self, **kwargs):
+        self._data_callback     =   kwargs.get("Received_data_callback")
+        self._central_callback  =   kwargs.get("send_central_callback")
+        self._timer_callback    =   kwargs.get("timer_callback")
+        self._stream_callback   =   kwargs.get("Received_stream_callback")
+        self._stream_done       =   kwargs.get("Stream_done_callback")
+        self._part_callback     =   kwargs.get("Received_part_callback")
+        self._part_done         =   kwargs.get("Part_done_callback")
+        self.AMD_debug          =   kwargs.get("debug", False)
+        self.lastSent           =   None    # status of the last packet sent
+
+        self.lib = LoadLibrary(kwargs.get("library"))
+        self.core = ctypes.create_string_buffer(self.lib.AmdtpLibSize())
+
+        # keep a reference, else they are garbage collected
+        self._cb = [_SEND(self._send), _RECEIVED(self._received), _SENT(self._sent),
+                    _TIMER(self._timer) if self._timer_callback else _TIMER(),
+                    _STREAM_RECEIVED(self._stream_received), _STREAM_DONE(self._stream_done_cb),
+                    _WRITABLE()]
+
+        self.lib.AmdtpLibSetCallbacks(self.core, *self._cb, None)
+
+        if self._part_callback:
+            self._cb += [_PART_RECEIVED(self._part_received), _PART_DONE(self._part_done_cb)]
+            self.lib.AmdtpLibSetCutThrough(self.core, *self._cb[-2:])
+
+        self.lib.AmdtpCoreSetWindow(self.core, kwargs.get("window", 0))
+        self.lib.AmdtpCoreSetCompress(self.core, kwargs.get("compress", False))
+
+        key = kwargs.get("key")
+        if key is not None and len(key) != 16:
+            raise ValueError("key must be 16 bytes")
+        self.lib.AmdtpCoreSetKey(self.core, bytes(key) if key is not None else None)
+        self.lib.AmdtpCoreInit(self.core)
+
+    #
+    # callbacks from the core
+    #
+    def _send(self, user, ptype, buf, len):
+        data = list(buf[:len])
+
+        if self.AMD_debug:
+            print("send type {0} : {1}".format(ptype, " ".join("0x{:02X}".format(b) for b in data)))
+
+        # send_central_callback can return False if it can not take the frame now
+        return self._central_callback(data, len) is not False
+
+    def _received(self, user, buf, len):
+        self._data_callback(list(buf[:len]), len)
+
+    def _sent(self, user, status):
+        self.lastSent = status
+
+        if self.AMD_debug and status != AMDTP_STATUS_SUCCESS:
+            print("Warning : packet refused by peer, status {0}".format(status))
+
+    def _timer(self, user, ms):
+        self._timer_callback(ms)
+
+    def _stream_received(self, user, buf, len, offset):
+        if self._stream_callback:
+            self._stream_callback(list(buf[:len]), len, offset)
+
+    def _stream_done_cb(self, user, status, len):
+        if self._stream_done:
+            self._stream_done(status, len)
+
+    def _part_received(self, user, buf, len, offset):
+        self._part_callback(list(buf[:len]), len, offset)
+
+    def _part_done_cb(self, user, status, len):
+        if self._part_done:
+            self._part_done(status, len)
+
+    #
+    # as amdtpc.py
+    #
+    def UpdateMTU(self, value):
+        """
+            set new MTU size, if new has been agreed
+        """
+        self.lib.AmdtpCoreSetMtu(self.core, min(value, ATT_MAX_MTU))
+
+    def AmdtpReceivePkt(self, data, len):
+        """
+            handle a received frame (data, ACK or control)
+        """
+        return self.lib.AmdtpCoreReceive(self.core, _buffer(data, len), len)
+
+    def AmdtpSendData(self, buf, len):
+        """
+            called from user program level with data to be send
+            returns :
+            -1 if eror
+            0 if sucessfull
+            1 if sending in chunks of data
+        """
+        st = self.lib.AmdtpCoreSend(self.core, _buffer(buf, len), len)
+
+        if st != AMDTP_STATUS_SUCCESS:
+            if self.AMD_debug:
+                print("Data sending failed, status = {0}".format(st))
+            return -1
+
+        if not self.AmdtpSendComplete():
+            return 1
+
+        return 0
+
+    def AmdtpSendComplete(self):
+        """
+            Check that sending (in chunks) has been completed
+        """
+        return self.lib.AmdtpCoreSendComplete(self.core)
+
+    #
+    # only in the core
+    #
+    def Negotiate(self):
+        """ offer the window mode and learn the version of the server """
+        self.lib.AmdtpCoreNegotiate(self.core)
+
+    def Timeout(self):
+        """ the time given to timer_callback has passed """
+        self.lib.AmdtpCoreTimeout(self.core)
+
+    def Pump(self):
+        """ send_central_callback can take frames again """
+        self.lib.AmdtpCorePump(self.core)
+
+    def Reset(self):
+        """ after a (dis)connect """
+        self.lib.AmdtpCoreInit(self.core)
+
+    def ResetTransfer(self):
+        """ after a send timeout : stop the packet in progress, keep the window and session key """
+        self.lib.AmdtpCoreResetTransfer(self.core)
+
+    def StreamOpen(self, len = AMDTP_STREAM_LEN_UNKNOWN):
+        return self.lib.AmdtpCoreStreamOpen(self.core, len)
+
+    def StreamWrite(self, buf, len):
+        """ returns the number of bytes taken """
+        return self.lib.AmdtpCoreStreamWrite(self.core, _buffer(buf, len), len)
+
+    def StreamClose(self):
+        return self.lib.AmdtpCoreStreamClose(self.core)
+
+    def Window(self):
+        return self.lib.AmdtpLibWindow(self.core)
+
+    def PeerVersion(self):
+        return self.lib.AmdtpLibPeerVersion(self.core)
+
+    def Secure(self):
+        """ True when the session key is agreed """
+        return self.lib.AmdtpLibSecure(self.core)
+
+    def Stats(self):
+        s = self.lib.AmdtpLibStats(self.core).contents
+        return {name: getattr(s, name) for name, _ in AmdtpCoreStats._fields_}
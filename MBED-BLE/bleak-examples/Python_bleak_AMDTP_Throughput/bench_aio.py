@@ -0,0 +1,186 @@
+#!/usr/bin/python3
+# -*- coding: UTF-8 -*-
+
+"""
+Paul van Haastrecht - October 2026 / version 1.0
+
+The time per message of amdtpaio.py against amdtpc.py and amdtpcore.py (if libamdtp.so is found),
+without BLE. Each client sends a packet to a mock server in the same process, the server echoes it
+and the client receives it : one message is two packets, two ACKs and the frames of both.
+
+The mock server is an amdtpaio.AmdtpClient with a task that echoes. A frame from one side is given
+to the other with loop.call_soon(), as bleak calls a notification handler, so the result is the
+time of the Python code (the mock server counted in, it is the same for all clients).
+
+"main.py loop" is amdtpc.py as main.py uses it : the frames to send are kept in a global and
+written by the main loop, that sleeps 50ms. Each frame then waits for the loop.
+
+    python3 bench_aio.py                    sizes 20 128 512, 2000 messages, MTU 23
+    python3 bench_aio.py -s "512" -n 500 -m 200 -p 0
+
+Exit 1 if an echo differs.
+"""
+
+import argparse
+import asyncio
+import os
+import sys
+import time
+
+import amdtpaio
+import amdtpc
+
+try:
+    import amdtpcore
+except ImportError:
+    amdtpcore = None
+
+class MockServer():
+    """ echoes each data packet, frames to the client go to deliver(frame) """
+
+    def __init__(self, deliver, mtu):
+        loop = asyncio.get_running_loop()
+
+        async def write(frame):
+            loop.call_soon(deliver, bytes(frame))
+
+        self.amdtp = amdtpaio.AmdtpClient(write, mtu = mtu)
+
+    async def __aenter__(self):
+        await self.amdtp.start()
+        self.task = asyncio.get_running_loop().create_task(self.echo())
+        return self
+
+    async def __aexit__(self, *exc):
+        self.task.cancel()
+        await asyncio.gather(self.task, return_exceptions = True)
+        await self.amdtp.close()
+
+    async def echo(self):
+        while True:
+            await self.amdtp.send(await self.amdtp.recv())
+
+    def notify(self, frame):
+        self.amdtp.notify(None, frame)
+
+async def bench_aio(data, count, mtu):
+    loop = asyncio.get_running_loop()
+    client = None
+
+    async with MockServer(lambda frame: client.notify(None, frame), mtu) as server:
+        async def write(frame):
+            loop.call_soon(server.notify, bytes(frame))
+
+        async with amdtpaio.AmdtpClient(write, mtu = mtu) as client:
+            start = time.perf_counter()
+            for _ in range(count):
+                await client.send(data)
+                if await client.recv() != data:
+                    return None
+            return time.perf_counter() - start
+
+async def bench_callback(cls, data, count, mtu):
+    """ amdtpc.AmdtpClient or amdtpcore.AmdtpCoreClient, they have the same interface """
+    loop = asyncio.get_running_loop()
+    got = None
+
+    def on_data(buf, len):
+        got.set_result(bytes(buf[:len]))
+
+    def on_send(buf, len):
+        loop.call_soon(server.notify, bytes(buf[:len]))
+
+    client = cls(Received_data_callback = on_data, send_central_callback = on_send)
+    client.UpdateMTU(mtu)
+
+    async with MockServer(lambda frame: client.AmdtpReceivePkt(frame, len(frame)), mtu) as server:
+        start = time.perf_counter()
+        for _ in range(count):
+            got = loop.create_future()
+            if client.AmdtpSendData(data, len(data)) < 0:
+                return None
+            if await got != data:
+                return None
+        return time.perf_counter() - start
+
+async def bench_polled(data, count, mtu, poll):
+    """
+        as main.py : send_central() keeps the frames in a global and the main loop writes
+        them every poll seconds (main.py keeps only the last frame, here all are kept)
+    """
+    loop = asyncio.get_running_loop()
+    pending = []
+    got = None
+
+    def on_data(buf, len):
+        got.set_result(bytes(buf[:len]))
+
+    def on_send(buf, len):
+        pending.append(bytes(buf[:len]))
+
+    client = amdtpc.AmdtpClient(Received_data_callback = on_data, send_central_callback = on_send)
+    client.UpdateMTU(mtu)
+
+    async with MockServer(lambda frame: client.AmdtpReceivePkt(frame, len(frame)), mtu) as server:
+        start = time.perf_counter()
+        for _ in range(count):
+            got = loop.create_future()
+            if client.AmdtpSendData(data, len(data)) < 0:
+                return None
+
+            while not got.done():
+                await asyncio.sleep(poll)
+                while pending:
+                    server.notify(pending.pop(0))
+
+            if got.result() != data:
+                return None
+        return time.perf_counter() - start
+
+def main():
+    parser = argparse.ArgumentParser(description = "time per message of the AMDTP clients")
+    parser.add_argument("-s", "--sizes", default = "20 128 512", help = "packet sizes (20 128 512)")
+    parser.add_argument("-n", "--count", type = int, default = 2000, help = "messages per size (2000)")
+    parser.add_argument("-m", "--mtu", type = int, default = amdtpaio.ATT_DEFAULT_MTU, help = "ATT MTU (23)")
+    parser.add_argument("-p", "--poll", type = float, default = 0.05,
+                        help = "main.py loop : seconds between the writes (0.05), 0 to skip")
+    parser.add_argument("-P", "--poll-count", type = int, default = 5, help = "main.py loop : messages per size (5)")
+    args = parser.parse_args()
+
+    clients = []
+    if args.poll > 0:
+        clients.append(("main.py loop", lambda d: bench_polled(d, args.poll_count, args.mtu, args.poll), args.poll_count))
+
+    clients += [("amdtpc.py", lambda d: bench_callback(amdtpc.AmdtpClient, d, args.count, args.mtu), args.count)]
+
+    if amdtpcore is not None:
+        try:
+            amdtpcore.LoadLibrary()
+            clients.append(("amdtpcore.py", lambda d: bench_callback(amdtpcore.AmdtpCoreClient, d, args.count, args.mtu),
+                            args.count))
+        except OSError:
+            print("libamdtp.so not found, amdtpcore.py is skipped")
+
+    clients.append(("amdtpaio.py", lambda d: bench_aio(d, args.count, args.mtu), args.count))
+
+    print("client          size  frames  us/message  messages/s")
+    failed = False
+
+    for size in (int(s) for s in args.sizes.split()):
+        data = os.urandom(size)
+        frames = -(-(size + amdtpaio.AMDTP_PREFIX_SIZE_IN_PKT + amdtpaio.AMDTP_CRC_SIZE_IN_PKT) // (args.mtu - 3))
+
+        for name, run, count in clients:
+            t = asyncio.run(run(data))
+            if t is None:
+                print("{0:14s} {1:5d}  echo differs".format(name, size))
+                failed = True
+                continue
+
+            print("{0:14s} {1:5d}  {2:6d}  {3:10.1f}  {4:10.1f}".format(name, size, frames,
+                  t / count * 1e6, count / t))
+
+    return 1 if failed else 0
+
+if __name__ == "__main__":
+    sys.exit(main())
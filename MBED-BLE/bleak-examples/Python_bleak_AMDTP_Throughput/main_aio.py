@@ -0,0 +1,65 @@
+#!/usr/bin/python3
+# -*- coding: UTF-8 -*-
+
+"""
+Paul van Haastrecht - October 2026 / version 1.0
+
+main.py with amdtpaio.py : echoes each data packet of the peripheral / server, without the
+global buffers and the polling main loop. Ctrl-C to disconnect.
+
+To be used with peripheral / server : MBED-BLE_example17_gattserv_AMDTP_troughput
+
+    python3 main_aio.py C0:07:5E:90:E0:08
+"""
+
+__author__  = "Paul van Haastrecht"
+__email__   = "paulvha@hotmail.com"
+__version__ = "October 2026"
+
+import asyncio
+import sys
+import time
+
+from bleak import BleakClient
+from amdtpaio import AmdtpClient, AmdtpError
+
+# AMDTP service, see main.py
+ATT_UUID_AMDTP_RX = "00002760-08C2-11E1-9073-0E8AC72E0011"
+ATT_UUID_AMDTP_TX = "00002760-08C2-11E1-9073-0E8AC72E0012"
+ATT_UUID_AMDTP_ACK = "00002760-08C2-11E1-9073-0E8AC72E0013"
+
+async def run(address):
+    async with BleakClient(address) as client:
+
+        async def write(frame):
+            await client.write_gatt_char(ATT_UUID_AMDTP_RX, frame)
+
+        async with AmdtpClient(write) as amdtp:
+            await client.start_notify(ATT_UUID_AMDTP_TX, amdtp.notify)
+            await client.start_notify(ATT_UUID_AMDTP_ACK, amdtp.notify)
+
+            print("Waiting for receiving data or Ctrl-C to disconnect")
+
+            while True:
+                data = await amdtp.recv()
+                print("Test Data has been received ({0} bytes), echo".format(len(data)))
+
+                start = time.monotonic()
+                try:
+                    await amdtp.send(data)
+                    print("sending has been completed in {0:.0f}ms".format((time.monotonic() - start) * 1000))
+                except AmdtpError as e:
+                    print("Error during sending : {0}".format(e))
+
+if __name__ == "__main__":
+
+    # if provided take MAC address from command line
+    address = sys.argv[1] if len(sys.argv) == 2 else "C0:07:5E:90:E0:08"
+
+    print("AMDTP - throughput client asyncio (version {})".format(__version__))
+    print("Looking for peripheral/server with address {}".format(address))
+
+    try:
+        asyncio.run(run(address))
+    except KeyboardInterrupt:
+        pass
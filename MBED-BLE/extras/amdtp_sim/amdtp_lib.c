@@ -0,0 +1,95 @@
+/*
+ * amdtp_lib.c : the AMDTP core (src/amdtp/amdtp_core.c) as a shared library
+ * for Python (ctypes), see amdtpcore.py and amdtp_test.py
+ *
+ * amdtpCore_t and amdtpCoreCallbacks_t are C structures with function
+ * pointers. Instead of rebuilding them in ctypes, Python asks for the size,
+ * allocates the memory and passes the callbacks as arguments.
+ *
+ * compile with ./make_amdtp_sim, which creates libamdtp.so
+ *
+ * paulvha / October 2026
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "amdtp_core.h"
+
+// random bytes for the session key
+static void libRandom(void *user, uint8_t *buf, uint16_t len)
+{
+    FILE *fp = fopen("/dev/urandom", "rb");
+
+    if (fp == NULL || fread(buf, 1, len, fp) != len)
+    {
+        memset(buf, 0, len);        // no /dev/urandom : the session key is then predictable
+    }
+
+    if (fp) fclose(fp);
+}
+
+// size of amdtpCore_t to allocate
+uint32_t AmdtpLibSize(void)
+{
+    return sizeof(amdtpCore_t);
+}
+
+// set the callbacks, a NULL pointer leaves that callback out
+void AmdtpLibSetCallbacks(amdtpCore_t *core,
+        bool (*send)(void *, eAmdtpPktType_t, uint8_t *, uint16_t),
+        void (*received)(void *, uint8_t *, uint16_t),
+        void (*sent)(void *, eAmdtpStatus_t),
+        void (*timer)(void *, uint32_t),
+        void (*streamReceived)(void *, uint8_t *, uint16_t, uint32_t),
+        void (*streamDone)(void *, eAmdtpStatus_t, uint32_t),
+        void (*writable)(void *),
+        void *user)
+{
+    amdtpCoreCallbacks_t cb;
+
+    memset(&cb, 0, sizeof(cb));
+    cb.send = send;
+    cb.received = received;
+    cb.sent = sent;
+    cb.timer = timer;
+    cb.streamReceived = streamReceived;
+    cb.streamDone = streamDone;
+    cb.writable = writable;
+    cb.random = libRandom;
+    cb.user = user;
+
+    AmdtpCoreSetCallbacks(core, &cb);
+}
+
+// cut-through delivery of data packets, NULL turns it off
+void AmdtpLibSetCutThrough(amdtpCore_t *core,
+        void (*partReceived)(void *, uint8_t *, uint16_t, uint16_t),
+        void (*partDone)(void *, eAmdtpStatus_t, uint16_t))
+{
+    core->cb.partReceived = partReceived;
+    core->cb.partDone = partDone;
+}
+
+// the counters, 17 x uint32_t as amdtpCoreStats_t
+amdtpCoreStats_t *AmdtpLibStats(amdtpCore_t *core)
+{
+    return &core->stats;
+}
+
+// agreed window, 0 is stop-and-wait
+uint8_t AmdtpLibWindow(amdtpCore_t *core)
+{
+    return core->window;
+}
+
+// version of the peer, 0 if it did not answer the negotiation
+uint8_t AmdtpLibPeerVersion(amdtpCore_t *core)
+{
+    return core->peerVersion;
+}
+
+// true when the session key is agreed
+bool AmdtpLibSecure(amdtpCore_t *core)
+{
+    return core->secure;
+}
@@ -0,0 +1,491 @@
+/*
+ * amdtp_multi.c : one AMDTP server (src/amdtp/amdtp_conn.c, as AMDTPS) with
+ * several clients at the same time over simulated BLE links, to measure the
+ * total goodput and how fair the transmit turns share it.
+ *
+ * The link model, as amdtp_sim.c, per connection:
+ *
+ * - each connection has its own connection event every interval, spread
+ *   over the interval. In an event a number of frames move in each direction.
+ * - the server stack buffers the frames to send for all connections together
+ *   (-t frames). When it is full the send callback returns false, after an
+ *   event has made room AmdtpConnPump() runs, as onDataSent() in AMDTPS.
+ * - a client has a small receive buffer that the application empties at a
+ *   fixed rate per frame, a frame that arrives with a full buffer is dropped.
+ * - on top, a frame can be dropped at random, once the negotiation is done
+ *   (the WINDOW_REQ of a client is a write with response).
+ *
+ * The server sends packets of 512 bytes to every client and every client to
+ * the server at the same time, every delivered packet is compared with what
+ * was sent. This is repeated for the quota values of the transmit turns,
+ * 0 is first come first served as with a single connection.
+ *
+ * compile with ./make_amdtp_sim, run ./amdtp_multi (-h for options)
+ *
+ * paulvha / October 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include "amdtp_conn.h"
+
+#define TICK_US         100         // simulation step
+#define QUEUE_SIZE      64          // max frames in a queue
+#define START_US        500000      // negotiation is done before the sketch sends
+#define HANDLE_BASE     0x40        // connection handle of client 0
+
+typedef struct
+{
+    uint16_t    len;
+    uint8_t     data[ATT_MAX_MTU];
+}
+frame_t;
+
+typedef struct
+{
+    frame_t     frames[QUEUE_SIZE];
+    int         head, count, size;
+}
+queue_t;
+
+typedef struct
+{
+    int         clients;
+    uint32_t    intervalUs;         // connection interval
+    int         framesPerEvent;     // frames per direction per connection event
+    int         txQueue;            // frames the server stack can buffer, all connections
+    int         rxQueue;            // frames a client can buffer
+    uint32_t    processUs;          // client time per frame
+    double      loss;               // random drop
+    uint16_t    mtu;
+    int         packets;            // packets to send per direction per client
+    bool        verbose;
+}
+config_t;
+
+// one client and the server side of its connection
+typedef struct
+{
+    int         nr;
+    amdtpCore_t core;               // the client
+    amdtpConn_t *conn;              // the server
+    queue_t     down, up, rx;       // server stack, client stack, client buffer
+    uint64_t    timerAt;            // client timer, 0 is not running
+    uint64_t    serverTimerAt;
+    uint64_t    nextProcess;
+
+    int         sent, received;     // by the client
+    int         serverSent, serverReceived;
+    int         bad;
+    uint64_t    doneAt;             // server : all packets to this client acknowledged
+    uint32_t    dropped;
+    uint8_t     payload[AMDTP_MAX_PAYLOAD_SIZE];
+    uint8_t     serverPayload[AMDTP_MAX_PAYLOAD_SIZE];
+}
+client_t;
+
+static config_t cfg = { 4, 30000, 4, 8, 4, 2000, 0.01, ATT_DEFAULT_MTU, 40, false };
+static client_t clients[AMDTP_MAX_CONNECTIONS];
+static amdtpConnPool_t pool;
+static int stackFrames;             // frames in all down queues
+static uint64_t now;
+static uint32_t lossSeed;
+
+static uint32_t simRandom(uint32_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static bool queuePut(queue_t *q, uint8_t *buf, uint16_t len)
+{
+    frame_t *f;
+
+    if (q->count >= q->size) return false;
+
+    f = &q->frames[(q->head + q->count) % QUEUE_SIZE];
+    memcpy(f->data, buf, len);
+    f->len = len;
+    q->count++;
+    return true;
+}
+
+static frame_t *queueGet(queue_t *q)
+{
+    frame_t *f;
+
+    if (q->count == 0) return NULL;
+
+    f = &q->frames[q->head];
+    q->head = (q->head + 1) % QUEUE_SIZE;
+    q->count--;
+    return f;
+}
+
+// packet n from the server (0) or a client (1 + nr), the receiver recreates it
+static void makePayload(uint8_t *buf, int from, int n)
+{
+    uint32_t state = 0x1234 + from * 0x10001 + n * 7919;
+
+    for (int i = 0; i < AMDTP_MAX_PAYLOAD_SIZE; i++) buf[i] = (uint8_t) simRandom(&state);
+}
+
+static client_t *clientOf(amdtpConn_t *c)
+{
+    return &clients[c->handle - HANDLE_BASE];
+}
+
+/*
+ * server callbacks, user is the amdtpConn_t
+ */
+static bool srvSend(void *user, eAmdtpPktType_t type, uint8_t *buf, uint16_t len)
+{
+    client_t *cl = clientOf((amdtpConn_t *) user);
+    (void) type;
+
+    // the stack buffers are shared by the connections
+    if (stackFrames >= cfg.txQueue || ! queuePut(&cl->down, buf, len)) return false;
+
+    stackFrames++;
+    return true;
+}
+
+static void srvReceived(void *user, uint8_t *buf, uint16_t len)
+{
+    client_t *cl = clientOf((amdtpConn_t *) user);
+    uint8_t expect[AMDTP_MAX_PAYLOAD_SIZE];
+
+    makePayload(expect, 1 + cl->nr, cl->serverReceived++);
+
+    if (len != AMDTP_MAX_PAYLOAD_SIZE || memcmp(buf, expect, len) != 0) cl->bad++;
+}
+
+static void srvSent(void *user, eAmdtpStatus_t status)
+{
+    client_t *cl = clientOf((amdtpConn_t *) user);
+
+    if (status != AMDTP_STATUS_SUCCESS)
+    {
+        printf("server : packet %d to client %d failed, status %d\n", cl->serverSent, cl->nr, status);
+        cl->bad++;
+    }
+
+    if (++cl->serverSent == cfg.packets) cl->doneAt = now;
+}
+
+static void srvTimer(void *user, uint32_t ms)
+{
+    amdtpConn_t *c = (amdtpConn_t *) user;
+    client_t *cl;
+
+    // the pool also stops the timer of a free entry
+    if (c->handle == AMDTP_CONN_NONE) return;
+
+    cl = clientOf(c);
+    cl->serverTimerAt = ms ? now + (uint64_t) ms * 1000 : 0;
+}
+
+/*
+ * client callbacks, user is the client_t
+ */
+static bool cliSend(void *user, eAmdtpPktType_t type, uint8_t *buf, uint16_t len)
+{
+    (void) type;
+    return queuePut(&((client_t *) user)->up, buf, len);
+}
+
+static void cliReceived(void *user, uint8_t *buf, uint16_t len)
+{
+    client_t *cl = (client_t *) user;
+    uint8_t expect[AMDTP_MAX_PAYLOAD_SIZE];
+
+    makePayload(expect, 0, cl->received++);
+
+    if (len != AMDTP_MAX_PAYLOAD_SIZE || memcmp(buf, expect, len) != 0) cl->bad++;
+}
+
+static void cliSent(void *user, eAmdtpStatus_t status)
+{
+    client_t *cl = (client_t *) user;
+
+    if (status != AMDTP_STATUS_SUCCESS)
+    {
+        printf("client %d : packet %d failed, status %d\n", cl->nr, cl->sent, status);
+        cl->bad++;
+    }
+
+    cl->sent++;
+}
+
+static void cliTimer(void *user, uint32_t ms)
+{
+    client_t *cl = (client_t *) user;
+
+    cl->timerAt = ms ? now + (uint64_t) ms * 1000 : 0;
+}
+
+static void setup(uint8_t quota)
+{
+    amdtpCoreCallbacks_t cb;
+
+    now = 0;
+    stackFrames = 0;
+    lossSeed = 0x2545F491;
+
+    memset(&cb, 0, sizeof(cb));
+    cb.send = srvSend;
+    cb.received = srvReceived;
+    cb.sent = srvSent;
+    cb.timer = srvTimer;
+    AmdtpConnPoolInit(&pool, &cb, NULL);
+    AmdtpConnSetQuota(&pool, quota);
+
+    memset(&cb, 0, sizeof(cb));
+    cb.send = cliSend;
+    cb.received = cliReceived;
+    cb.sent = cliSent;
+    cb.timer = cliTimer;
+
+    for (int i = 0; i < cfg.clients; i++)
+    {
+        client_t *cl = &clients[i];
+
+        memset(cl, 0, sizeof(client_t));
+        cl->nr = i;
+        cl->down.size = QUEUE_SIZE;
+        cl->up.size = cfg.txQueue;
+        cl->rx.size = cfg.rxQueue;
+
+        // as onConnectionComplete() and onAttMtuChange()
+        cl->conn = AmdtpConnOpen(&pool, HANDLE_BASE + i);
+        AmdtpCoreSetMtu(&cl->conn->core, cfg.mtu);
+
+        cb.user = cl;
+        AmdtpCoreSetCallbacks(&cl->core, &cb);
+        AmdtpCoreInit(&cl->core);
+        AmdtpCoreSetMtu(&cl->core, cfg.mtu);
+
+        // the client offers the window after subscribing
+        AmdtpCoreNegotiate(&cl->core);
+    }
+}
+
+static bool lost(void)
+{
+    return now >= START_US && simRandom(&lossSeed) < cfg.loss * 4294967295.0;
+}
+
+// connection event of one client
+static void event(client_t *cl)
+{
+    frame_t *f;
+    int i;
+
+    for (i = 0; i < cfg.framesPerEvent && (f = queueGet(&cl->down)) != NULL; i++)
+    {
+        stackFrames--;
+
+        if (lost() || ! queuePut(&cl->rx, f->data, f->len))
+        {
+            cl->dropped++;
+        }
+    }
+
+    // the server handles a frame right away
+    for (i = 0; i < cfg.framesPerEvent && (f = queueGet(&cl->up)) != NULL; i++)
+    {
+        if (lost()) continue;
+
+        AmdtpCoreReceive(&cl->conn->core, f->data, f->len);
+    }
+
+    // room in the stack again : onDataSent()
+    AmdtpConnPump(&pool);
+    AmdtpCorePump(&cl->core);
+}
+
+static void run(client_t *cl)
+{
+    frame_t *f;
+
+    if (cl->serverTimerAt && now >= cl->serverTimerAt)
+    {
+        cl->serverTimerAt = 0;
+        AmdtpCoreTimeout(&cl->conn->core);
+    }
+
+    if (cl->timerAt && now >= cl->timerAt)
+    {
+        cl->timerAt = 0;
+        AmdtpCoreTimeout(&cl->core);
+    }
+
+    if (now >= cl->nextProcess && (f = queueGet(&cl->rx)) != NULL)
+    {
+        AmdtpCoreReceive(&cl->core, f->data, f->len);
+        cl->nextProcess = now + cfg.processUs;
+    }
+
+    if (now < START_US) return;
+
+    // the server side, as SendToCentral() per client
+    if (cl->serverSent < cfg.packets && cl->conn->core.txState == AMDTP_STATE_TX_IDLE)
+    {
+        makePayload(cl->serverPayload, 0, cl->serverSent);
+        AmdtpCoreSend(&cl->conn->core, cl->serverPayload, AMDTP_MAX_PAYLOAD_SIZE);
+    }
+
+    if (cl->sent < cfg.packets && cl->core.txState == AMDTP_STATE_TX_IDLE)
+    {
+        makePayload(cl->payload, 1 + cl->nr, cl->sent);
+        AmdtpCoreSend(&cl->core, cl->payload, AMDTP_MAX_PAYLOAD_SIZE);
+    }
+}
+
+static bool finished(void)
+{
+    for (int i = 0; i < cfg.clients; i++)
+    {
+        client_t *cl = &clients[i];
+
+        if (! cl->doneAt || cl->sent < cfg.packets || cl->received < cfg.packets ||
+            cl->serverReceived < cfg.packets)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void simulate(uint8_t quota)
+{
+    uint64_t limit = 600ULL * 1000000;     // 10 minutes simulated
+    uint32_t spacing = cfg.intervalUs / cfg.clients;
+
+    spacing -= spacing % TICK_US;
+    setup(quota);
+
+    while (now < limit && ! finished())
+    {
+        for (int i = 0; i < cfg.clients; i++)
+        {
+            if ((now + cfg.intervalUs - i * spacing) % cfg.intervalUs == 0) event(&clients[i]);
+        }
+
+        for (int i = 0; i < cfg.clients; i++) run(&clients[i]);
+
+        now += TICK_US;
+    }
+}
+
+static void usage(const char *name)
+{
+    printf("%s [options]\n"
+           "  -c n     clients (4, max %d)\n"
+           "  -i us    connection interval (30000)\n"
+           "  -f n     frames per connection event per direction (4)\n"
+           "  -t n     server transmit buffer in frames, all connections (8)\n"
+           "  -r n     client receive buffer in frames (4)\n"
+           "  -p us    client time per frame (2000)\n"
+           "  -l pct   random frame loss in %% (1)\n"
+           "  -m mtu   ATT MTU (23)\n"
+           "  -n n     packets of 512 bytes per client per direction (40)\n"
+           "  -v       show the statistics per client\n", name, AMDTP_MAX_CONNECTIONS);
+}
+
+int main(int argc, char *argv[])
+{
+    static const uint8_t quotas[] = { 0, 1, 2, 4 };
+    int opt, failed = 0;
+
+    while ((opt = getopt(argc, argv, "c:i:f:t:r:p:l:m:n:vh")) != -1)
+    {
+        switch (opt)
+        {
+            case 'c': cfg.clients = atoi(optarg); break;
+            case 'i': cfg.intervalUs = atoi(optarg); break;
+            case 'f': cfg.framesPerEvent = atoi(optarg); break;
+            case 't': cfg.txQueue = atoi(optarg); break;
+            case 'r': cfg.rxQueue = atoi(optarg); break;
+            case 'p': cfg.processUs = atoi(optarg); break;
+            case 'l': cfg.loss = atof(optarg) / 100; break;
+            case 'm': cfg.mtu = atoi(optarg); break;
+            case 'n': cfg.packets = atoi(optarg); break;
+            case 'v': cfg.verbose = true; break;
+            default : usage(argv[0]); return 0;
+        }
+    }
+
+    cfg.intervalUs -= cfg.intervalUs % TICK_US;
+    if (cfg.clients < 1 || cfg.clients > AMDTP_MAX_CONNECTIONS || cfg.intervalUs < TICK_US * cfg.clients ||
+        cfg.txQueue < 1 || cfg.txQueue > QUEUE_SIZE || cfg.rxQueue < 1 || cfg.rxQueue > QUEUE_SIZE ||
+        cfg.mtu < ATT_DEFAULT_MTU || cfg.mtu > ATT_MAX_MTU || cfg.packets < 1)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    printf("%d clients, interval %u ms, %d frames / event, server tx buffer %d, rx buffer %d, "
+           "%u us / frame, loss %.1f %%, MTU %u, %d x %d bytes each way per client\n\n",
+           cfg.clients, cfg.intervalUs / 1000, cfg.framesPerEvent, cfg.txQueue, cfg.rxQueue,
+           cfg.processUs, cfg.loss * 100, cfg.mtu, cfg.packets, AMDTP_MAX_PAYLOAD_SIZE);
+
+    printf("quota  turns         total bytes/s  client min - max bytes/s  first - last done s  held\n");
+
+    for (size_t q = 0; q < sizeof(quotas); q++)
+    {
+        uint64_t first = 0, last = 0;
+        uint32_t held = 0;
+        double total, min = 0, max = 0;
+        bool ok;
+
+        simulate(quotas[q]);
+        ok = finished();
+
+        for (int i = 0; i < cfg.clients; i++)
+        {
+            client_t *cl = &clients[i];
+            double rate = cl->doneAt ? (double) cfg.packets * AMDTP_MAX_PAYLOAD_SIZE * 1000000 /
+                                       (cl->doneAt - START_US) : 0;
+
+            if (i == 0 || rate < min) min = rate;
+            if (i == 0 || rate > max) max = rate;
+            if (i == 0 || cl->doneAt < first) first = cl->doneAt;
+            if (i == 0 || cl->doneAt > last) last = cl->doneAt;
+
+            held += cl->conn->txHeld;
+            if (cl->bad) ok = false;
+        }
+
+        total = last > START_US ? (double) cfg.clients * cfg.packets * AMDTP_MAX_PAYLOAD_SIZE * 1000000 /
+                                  (last - START_US) : 0;
+
+        printf("%5u  %-12s  %13.0f  %10.0f - %-10.0f  %9.1f - %-8.1f  %5u%s\n",
+               quotas[q], quotas[q] ? "round robin" : "first come", total, min, max,
+               first > START_US ? (first - START_US) / 1e6 : 0, last > START_US ? (last - START_US) / 1e6 : 0,
+               held, ok ? "" : "  FAILED");
+
+        if (cfg.verbose)
+        {
+            for (int i = 0; i < cfg.clients; i++)
+            {
+                client_t *cl = &clients[i];
+                amdtpCoreStats_t *st = &cl->conn->core.stats;
+
+                printf("       client %d : window %u, done %.1f s, frames %u, resent %u, timeouts %u, "
+                       "busy %u, dropped %u\n",
+                       i, cl->conn->core.window, cl->doneAt ? (cl->doneAt - START_US) / 1e6 : 0,
+                       st->framesSent, st->framesResent, st->timeouts, st->sendBusy, cl->dropped);
+            }
+        }
+
+        if (! ok) failed++;
+    }
+
+    return failed ? 1 : 0;
+}
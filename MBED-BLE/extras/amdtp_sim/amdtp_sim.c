@@ -0,0 +1,579 @@
+/*
+ * amdtp_sim.c : run the AMDTP core (src/amdtp/amdtp_core.c) on a host over a
+ * simulated BLE link and measure the goodput per window size.
+ *
+ * The link model:
+ *
+ * - every connection interval, each side can move a number of frames from
+ *   its transmit queue to the other side (the BLE stack buffers). When the
+ *   transmit queue is full, the send callback returns false.
+ * - the receiving side has a small buffer that the application empties at
+ *   a fixed rate per frame. A frame that arrives with a full buffer is
+ *   dropped, as happens with notifications on a slow central.
+ * - on top, a frame can be dropped at random.
+ *
+ * Both sides send packets of 512 bytes to each other at the same time, as in
+ * example17. Every delivered packet is compared with what was sent.
+ *
+ * Stop-and-wait has no way to recover a lost frame (the sketch times out
+ * after 15 seconds), with random loss it stalls on the first one.
+ *
+ * With -s each side sends one stream of that many bytes instead, written in
+ * parts of 100 bytes as a sensor log would, and the receiver checks every
+ * byte on its offset and the result of the close.
+ *
+ * The latency of a packet is from AmdtpCoreSend() on the server until the
+ * client delivers it, the percentiles are over all packets of a run.
+ *
+ * With -C each run is one line of CSV (with a header line, -H leaves it out)
+ * to collect a sweep over the link settings in one file, see bench_amdtp.
+ *
+ * compile with ./make_amdtp_sim, run ./amdtp_sim (-h for options)
+ *
+ * paulvha / October 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include "amdtp_core.h"
+
+#define TICK_US         100         // simulation step
+#define QUEUE_SIZE      64          // max frames in a queue
+#define START_US        500000      // negotiation is done before the sketch sends
+#define MAX_PACKETS     4096        // packets per direction with latency
+
+typedef struct
+{
+    uint16_t    len;
+    uint8_t     data[ATT_MAX_MTU];
+}
+frame_t;
+
+typedef struct
+{
+    frame_t     frames[QUEUE_SIZE];
+    int         head, count, size;
+}
+queue_t;
+
+struct side;
+
+typedef struct
+{
+    uint32_t    intervalUs;         // connection interval
+    int         framesPerEvent;     // frames per direction per connection event
+    int         txQueue;            // frames the stack can buffer to send
+    int         rxQueue;            // frames the receiver can buffer
+    uint32_t    processUs;          // receiver time per frame
+    double      loss;               // random drop
+    uint16_t    mtu;
+    int         packets;            // packets to send per direction
+    uint32_t    streamBytes;        // stream length per direction, 0 is packets
+    bool        oldPeer;            // the server ignores WINDOW_REQ
+    bool        verbose;
+    int         window;             // -1 is all windows
+    bool        csv;
+    bool        csvHeader;
+}
+config_t;
+
+typedef struct side
+{
+    const char  *name;
+    amdtpCore_t core;
+    queue_t     tx, rx;
+    struct side *peer;
+    config_t    *cfg;
+
+    uint64_t    timerAt;            // 0 is not running
+    uint64_t    nextProcess;
+
+    int         sent, received, bad;
+    bool        streamOpen, streamDone;
+    uint32_t    streamPos;          // bytes written into the stream
+    uint32_t    streamRx;           // bytes received in order
+    uint64_t    doneAt;             // all packets acknowledged
+    uint32_t    dropped;
+    uint8_t     payload[AMDTP_MAX_PAYLOAD_SIZE];
+    uint32_t    seed;
+    uint64_t    sendAt[MAX_PACKETS];    // packet n was given to the core
+    uint32_t    latency[MAX_PACKETS];   // us, of the packets received from the peer
+    int         latencies;
+}
+side_t;
+
+static uint64_t now;
+static FILE *report;                // failures, stderr with CSV
+static uint32_t lossSeed = 0x2545F491;
+
+static uint32_t simRandom(uint32_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static bool queuePut(queue_t *q, uint8_t *buf, uint16_t len)
+{
+    frame_t *f;
+
+    if (q->count >= q->size) return false;
+
+    f = &q->frames[(q->head + q->count) % QUEUE_SIZE];
+    memcpy(f->data, buf, len);
+    f->len = len;
+    q->count++;
+    return true;
+}
+
+static frame_t *queueGet(queue_t *q)
+{
+    frame_t *f;
+
+    if (q->count == 0) return NULL;
+
+    f = &q->frames[q->head];
+    q->head = (q->head + 1) % QUEUE_SIZE;
+    q->count--;
+    return f;
+}
+
+// byte n of the stream of a side
+static uint8_t streamByte(uint32_t seed, uint32_t n)
+{
+    uint32_t x = seed ^ (n * 2654435761U);
+
+    x ^= x >> 15;
+    x *= 0x2C1B3C6DU;
+    x ^= x >> 12;
+    return (uint8_t) x;
+}
+
+// packet n of a side, the receiver can recreate it to compare
+static void makePayload(uint8_t *buf, uint32_t seed, int n)
+{
+    uint32_t state = seed + n * 7919;
+
+    for (int i = 0; i < AMDTP_MAX_PAYLOAD_SIZE; i++) buf[i] = (uint8_t) simRandom(&state);
+}
+
+/*
+ * callbacks from the core
+ */
+static bool cbSend(void *user, eAmdtpPktType_t type, uint8_t *buf, uint16_t len)
+{
+    side_t *s = (side_t *) user;
+    (void) type;
+
+    // an old peer does not know WINDOW_REQ, as if it never got it
+    if (s->cfg->oldPeer && strcmp(s->peer->name, "server") == 0 && type == AMDTP_PKT_TYPE_CONTROL &&
+        buf[AMDTP_PREFIX_SIZE_IN_PKT] == AMDTP_CONTROL_WINDOW_REQ)
+    {
+        return true;
+    }
+
+    return queuePut(&s->tx, buf, len);
+}
+
+static void cbReceived(void *user, uint8_t *buf, uint16_t len)
+{
+    side_t *s = (side_t *) user;
+    uint8_t expect[AMDTP_MAX_PAYLOAD_SIZE];
+
+    makePayload(expect, s->peer->seed, s->received);
+
+    if (len != AMDTP_MAX_PAYLOAD_SIZE || memcmp(buf, expect, len) != 0) s->bad++;
+
+    if (s->received < MAX_PACKETS)
+    {
+        s->latency[s->latencies++] = (uint32_t) (now - s->peer->sendAt[s->received]);
+    }
+
+    s->received++;
+}
+
+static void cbSent(void *user, eAmdtpStatus_t status)
+{
+    side_t *s = (side_t *) user;
+
+    if (status != AMDTP_STATUS_SUCCESS)
+    {
+        fprintf(report, "%s : %s %d failed, status %d\n", s->name, s->cfg->streamBytes ? "stream" : "packet",
+                s->sent, status);
+        s->bad++;
+    }
+
+    if (s->cfg->streamBytes)
+    {
+        s->doneAt = now;
+        return;
+    }
+
+    if (++s->sent == s->cfg->packets) s->doneAt = now;
+}
+
+static void cbStreamReceived(void *user, uint8_t *buf, uint16_t len, uint32_t offset)
+{
+    side_t *s = (side_t *) user;
+
+    if (offset != s->streamRx) s->bad++;
+
+    for (uint16_t i = 0; i < len; i++)
+    {
+        if (buf[i] != streamByte(s->peer->seed, offset + i)) s->bad++;
+    }
+
+    s->streamRx = offset + len;
+}
+
+static void cbStreamDone(void *user, eAmdtpStatus_t status, uint32_t len)
+{
+    side_t *s = (side_t *) user;
+
+    if (status != AMDTP_STATUS_SUCCESS || len != s->cfg->streamBytes)
+    {
+        fprintf(report, "%s : stream received with status %d, %u bytes\n", s->name, status, len);
+        s->bad++;
+    }
+
+    s->streamDone = true;
+}
+
+static void cbTimer(void *user, uint32_t ms)
+{
+    side_t *s = (side_t *) user;
+
+    s->timerAt = ms ? now + (uint64_t) ms * 1000 : 0;
+}
+
+static void sideInit(side_t *s, const char *name, side_t *peer, config_t *cfg, uint32_t seed)
+{
+    amdtpCoreCallbacks_t cb;
+
+    memset(&cb, 0, sizeof(cb));
+    cb.send = cbSend;
+    cb.received = cbReceived;
+    cb.sent = cbSent;
+    cb.timer = cbTimer;
+    cb.streamReceived = cbStreamReceived;
+    cb.streamDone = cbStreamDone;
+    cb.user = s;
+
+    memset(s, 0, sizeof(side_t));
+    s->name = name;
+    s->peer = peer;
+    s->cfg = cfg;
+    s->seed = seed;
+    s->tx.size = cfg->txQueue;
+    s->rx.size = cfg->rxQueue;
+
+    AmdtpCoreSetCallbacks(&s->core, &cb);
+    AmdtpCoreInit(&s->core);
+    AmdtpCoreSetMtu(&s->core, cfg->mtu);
+}
+
+// write the stream in parts, as long as it is accepted
+static void sideStream(side_t *s)
+{
+    uint8_t part[100];
+    uint16_t len;
+
+    if (! s->streamOpen)
+    {
+        if (AmdtpCoreStreamOpen(&s->core, s->cfg->streamBytes) != AMDTP_STATUS_SUCCESS)
+        {
+            return;
+        }
+        s->streamOpen = true;
+    }
+
+    while (s->streamPos < s->cfg->streamBytes)
+    {
+        len = sizeof(part);
+        if (len > s->cfg->streamBytes - s->streamPos) len = s->cfg->streamBytes - s->streamPos;
+
+        for (uint16_t i = 0; i < len; i++) part[i] = streamByte(s->seed, s->streamPos + i);
+
+        len = AmdtpCoreStreamWrite(&s->core, part, len);
+        if (len == 0) return;           // staging buffer full
+
+        s->streamPos += len;
+    }
+
+    if (s->sent == 0)
+    {
+        AmdtpCoreStreamClose(&s->core);
+        s->sent = 1;
+    }
+}
+
+// start the next packet when the previous one is done
+static void sideSend(side_t *s)
+{
+    int n = s->sent;
+
+    if (now >= START_US && s->cfg->streamBytes)
+    {
+        sideStream(s);
+        return;
+    }
+
+    if (now < START_US || n >= s->cfg->packets || s->core.txState != AMDTP_STATE_TX_IDLE) return;
+
+    makePayload(s->payload, s->seed, n);
+
+    if (AmdtpCoreSend(&s->core, s->payload, AMDTP_MAX_PAYLOAD_SIZE) == AMDTP_STATUS_SUCCESS && n < MAX_PACKETS)
+    {
+        s->sendAt[n] = now;
+    }
+}
+
+// connection event : frames from one side to the other
+static void transfer(side_t *from, side_t *to)
+{
+    for (int i = 0; i < from->cfg->framesPerEvent; i++)
+    {
+        frame_t *f = queueGet(&from->tx);
+
+        if (f == NULL) break;
+
+        if (simRandom(&lossSeed) < from->cfg->loss * 4294967295.0 ||
+            ! queuePut(&to->rx, f->data, f->len))
+        {
+            to->dropped++;
+        }
+    }
+
+    // room in the stack again
+    AmdtpCorePump(&from->core);
+}
+
+static void sideRun(side_t *s)
+{
+    if (s->timerAt && now >= s->timerAt)
+    {
+        s->timerAt = 0;
+        AmdtpCoreTimeout(&s->core);
+    }
+
+    if (now >= s->nextProcess)
+    {
+        frame_t *f = queueGet(&s->rx);
+
+        if (f)
+        {
+            AmdtpCoreReceive(&s->core, f->data, f->len);
+            s->nextProcess = now + s->cfg->processUs;
+        }
+    }
+
+    sideSend(s);
+}
+
+static uint32_t totalBytes(config_t *cfg)
+{
+    return cfg->streamBytes ? cfg->streamBytes : (uint32_t) cfg->packets * AMDTP_MAX_PAYLOAD_SIZE;
+}
+
+/*
+ * run one transfer, return the goodput in bytes per second (server to client)
+ */
+static double simulate(config_t *cfg, uint8_t window, side_t *server, side_t *client)
+{
+    uint64_t limit = 600ULL * 1000000;     // 10 minutes simulated
+
+    now = 0;
+    lossSeed = 0x2545F491;
+
+    sideInit(server, "server", client, cfg, 0x1234);
+    sideInit(client, "client", server, cfg, 0x5678);
+    AmdtpCoreSetWindow(&server->core, window);
+    AmdtpCoreSetWindow(&client->core, window);
+
+    // the client offers the window after subscribing
+    AmdtpCoreNegotiate(&client->core);
+
+    while (now < limit)
+    {
+        if (now % cfg->intervalUs == 0)
+        {
+            transfer(server, client);
+            transfer(client, server);
+        }
+
+        sideRun(server);
+        sideRun(client);
+
+        if (server->doneAt && client->doneAt &&
+            (cfg->streamBytes ? client->streamDone && server->streamDone :
+             client->received == cfg->packets && server->received == cfg->packets))
+        {
+            break;
+        }
+
+        now += TICK_US;
+    }
+
+    if (! server->doneAt) return 0;
+
+    return (double) totalBytes(cfg) * 1000000 / (server->doneAt - START_US);
+}
+
+static int compareU32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+
+    return x < y ? -1 : x > y;
+}
+
+// nearest rank percentile of the latencies in ms, sorts them
+static double percentile(side_t *s, int pct)
+{
+    int rank;
+
+    if (s->latencies == 0) return 0;
+
+    qsort(s->latency, s->latencies, sizeof(uint32_t), compareU32);
+    rank = (s->latencies * pct + 99) / 100;
+    if (rank < 1) rank = 1;
+
+    return s->latency[rank - 1] / 1000.0;
+}
+
+static void usage(const char *name)
+{
+    printf("%s [options]\n"
+           "  -i us    connection interval (30000)\n"
+           "  -f n     frames per connection event per direction (4)\n"
+           "  -t n     transmit queue in frames (8)\n"
+           "  -r n     receive buffer in frames (4)\n"
+           "  -p us    receiver time per frame (2000)\n"
+           "  -l pct   random frame loss in %% (1)\n"
+           "  -m mtu   ATT MTU (23)\n"
+           "  -n n     packets of 512 bytes per direction (20)\n"
+           "  -s n     send a stream of n bytes per direction instead of packets\n"
+           "  -o       server is an old stop-and-wait peer\n"
+           "  -w n     only window n (0 - 32), else 0, 1, 2, 4, 8, 16 and 32\n"
+           "  -C       one line of CSV per window\n"
+           "  -H       no CSV header line\n"
+           "  -v       show the statistics\n", name);
+}
+
+int main(int argc, char *argv[])
+{
+    config_t cfg = { 30000, 4, 8, 4, 2000, 0.01, ATT_DEFAULT_MTU, 20, 0, false, false, -1, false, true };
+    static const uint8_t windows[] = { 0, 1, 2, 4, 8, 16, 32 };
+    static side_t server, client;
+    int opt, failed = 0;
+
+    while ((opt = getopt(argc, argv, "i:f:t:r:p:l:m:n:s:ow:CHvh")) != -1)
+    {
+        switch (opt)
+        {
+            case 'i': cfg.intervalUs = atoi(optarg); break;
+            case 'f': cfg.framesPerEvent = atoi(optarg); break;
+            case 't': cfg.txQueue = atoi(optarg); break;
+            case 'r': cfg.rxQueue = atoi(optarg); break;
+            case 'p': cfg.processUs = atoi(optarg); break;
+            case 'l': cfg.loss = atof(optarg) / 100; break;
+            case 'm': cfg.mtu = atoi(optarg); break;
+            case 'n': cfg.packets = atoi(optarg); break;
+            case 's': cfg.streamBytes = strtoul(optarg, NULL, 0); break;
+            case 'o': cfg.oldPeer = true; break;
+            case 'w': cfg.window = atoi(optarg); break;
+            case 'C': cfg.csv = true; break;
+            case 'H': cfg.csvHeader = false; break;
+            case 'v': cfg.verbose = true; break;
+            default : usage(argv[0]); return 0;
+        }
+    }
+
+    cfg.intervalUs -= cfg.intervalUs % TICK_US;
+    if (cfg.intervalUs == 0 || cfg.txQueue < 1 || cfg.txQueue > QUEUE_SIZE ||
+        cfg.rxQueue < 1 || cfg.rxQueue > QUEUE_SIZE || cfg.mtu < ATT_DEFAULT_MTU || cfg.mtu > ATT_MAX_MTU ||
+        cfg.packets < 1 || cfg.packets > MAX_PACKETS || cfg.window > AMDTP_WINDOW_MAX)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    report = cfg.csv ? stderr : stdout;
+
+    if (cfg.csv)
+    {
+        if (cfg.csvHeader)
+        {
+            printf("interval_us,frames_per_event,tx_queue,rx_buffer,process_us,loss_pct,mtu,"
+                   "packets,stream_bytes,old_peer,window,mode,goodput_Bps,latency_p50_ms,"
+                   "latency_p90_ms,latency_p99_ms,latency_max_ms,frames,resent,timeouts,"
+                   "dropped,result\n");
+        }
+    }
+    else
+    {
+        printf("interval %u ms, %d frames / event, tx queue %d, rx buffer %d, %u us / frame, "
+               "loss %.1f %%, MTU %u, ",
+               cfg.intervalUs / 1000, cfg.framesPerEvent, cfg.txQueue, cfg.rxQueue, cfg.processUs,
+               cfg.loss * 100, cfg.mtu);
+
+        if (cfg.streamBytes)
+            printf("stream of %u bytes each way", cfg.streamBytes);
+        else
+            printf("%d x %d bytes each way", cfg.packets, AMDTP_MAX_PAYLOAD_SIZE);
+
+        printf("%s\n\n", cfg.oldPeer ? ", old server" : "");
+
+        printf("window  mode            bytes/s  ms/packet  p50 ms  p99 ms  frames  resent  timeouts  dropped\n");
+    }
+
+    for (size_t i = 0; i < sizeof(windows); i++)
+    {
+        uint8_t window = cfg.window >= 0 ? (uint8_t) cfg.window : windows[i];
+        double goodput = simulate(&cfg, window, &server, &client);
+        amdtpCoreStats_t *st = &server.core.stats;
+        bool ok = server.bad == 0 && client.bad == 0 &&
+                  (cfg.streamBytes ? server.streamDone && client.streamDone :
+                   server.received == cfg.packets && client.received == cfg.packets);
+        bool stall = ! ok && server.core.window == 0 && cfg.loss > 0;
+        bool noStream = ! ok && cfg.streamBytes && ! server.streamOpen;
+        const char *result = ok ? "ok" : noStream ? "no streams" : stall ? "stalled" : "FAILED";
+        double p50 = percentile(&client, 50), p90 = percentile(&client, 90);
+        double p99 = percentile(&client, 99), pmax = percentile(&client, 100);
+
+        if (cfg.csv)
+        {
+            printf("%u,%d,%d,%d,%u,%.2f,%u,%d,%u,%d,%u,%s,%.0f,%.1f,%.1f,%.1f,%.1f,%u,%u,%u,%u,%s\n",
+                   cfg.intervalUs, cfg.framesPerEvent, cfg.txQueue, cfg.rxQueue, cfg.processUs,
+                   cfg.loss * 100, cfg.mtu, cfg.streamBytes ? 0 : cfg.packets, cfg.streamBytes,
+                   cfg.oldPeer, window, server.core.window ? "window" : "stop-and-wait", goodput,
+                   p50, p90, p99, pmax, st->framesSent, st->framesResent, st->timeouts,
+                   client.dropped, result);
+        }
+        else
+        {
+            printf("%6u  %-14s %8.0f  %9.1f  %6.0f  %6.0f  %6u  %6u  %8u  %7u%s%s\n",
+                   window, server.core.window ? "sliding window" : "stop-and-wait", goodput,
+                   goodput > 0 ? AMDTP_MAX_PAYLOAD_SIZE * 1000 / goodput : 0, p50, p99,
+                   st->framesSent, st->framesResent, st->timeouts, client.dropped,
+                   ok ? "" : "  ", ok ? "" : result);
+        }
+
+        if (cfg.verbose && ! cfg.csv)
+        {
+            printf("        server sent %u received %u, client sent %u received %u, "
+                   "busy %u, duplicates %u, control %u\n",
+                   st->packetsSent, st->packetsReceived, client.core.stats.packetsSent,
+                   client.core.stats.packetsReceived, st->sendBusy,
+                   client.core.stats.framesDuplicate, client.core.stats.controlSent);
+        }
+
+        if (! ok && ! stall && ! (noStream && cfg.oldPeer)) failed++;
+
+        if (cfg.window >= 0) break;
+    }
+
+    return failed ? 1 : 0;
+}
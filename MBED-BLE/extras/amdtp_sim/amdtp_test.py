@@ -0,0 +1,1583 @@
+#!/usr/bin/python3
+# -*- coding: UTF-8 -*-
+"""
+amdtp_test.py : conformance tests for the AMDTP core (src/amdtp/amdtp_core.c)
+
+    * the frames on the wire, as documented in amdtpc.py
+    * the core against amdtpc.py (the pure Python AMDTP of the bleak examples),
+      every payload size in both directions
+    * core against core : sliding window with lost frames, streams
+    * extended serial numbers : repeated, reordered and late frames, old peers
+    * raw frames : zeros and 0x7E 0x20 in the data, the full MTU (no escape)
+    * AmdtpCrc32 (slicing-by-8) against zlib.crc32, in one call and in parts
+    * CRC per frame and cut-through delivery, random frame boundaries and MTU
+    * packet compression (amdtp_lz.c) and its negotiation
+    * AES-CCM (amdtp_ccm.c) : test vectors, session key, refused packets
+    * the copies of the core in the other folders are the same
+    * amdtp_sim (throughput over the simulated link), its CSV and bench_amdtp
+    * bulk_sim (amdtp_link.c : bulk mode against fixed connection parameters)
+    * amdtp_multi (several clients on one server : total and fair share)
+    * bridge_sim (the ACK queue of the Arduino client against its delay(700))
+    * gateway_sim against fake_periph (the gateway mode of amdtc, its sinks, telemetry)
+    * the telemetry batches (amdtp_tlm.c) against a Python coder of the format, round trips
+    * amdtpaio.py (asyncio client of the bleak examples) against the core and amdtpc.py,
+      its backpressure and timeout, and bench_aio.py
+
+Linux, python3. First run ./make_amdtp_sim, then
+
+    python3 amdtp_test.py       (or -v to see each test)
+
+paulvha / October 2026
+"""
+
+import asyncio
+import csv
+import ctypes
+import os
+import json
+import random
+import shutil
+import socket
+import subprocess
+import sys
+import tempfile
+import time
+import unittest
+import zlib
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+AMDTP_CONN_TX_QUOTA = 1     # amdtp_conn.h
+MBED = os.path.join(HERE, "..", "..")
+BLEAK = os.path.join(MBED, "bleak-examples", "Python_bleak_AMDTP_Throughput")
+
+sys.path.insert(0, BLEAK)
+
+import amdtpcore
+from amdtpcore import AmdtpCoreClient
+import amdtpc
+import amdtpaio
+
+# frames from the documentation in amdtpc.py
+DATA_07 = [0x05, 0x00, 0x00, 0x10, 0x07, 0x2E, 0x7A, 0x66, 0x4C]
+ACK_SUCCESS = [0x05, 0x00, 0x00, 0x20, 0x00, 0x8D, 0xEF, 0x02, 0xD2]
+
+def payload(n, seed = 0):
+    rnd = random.Random(n * 7919 + seed)
+    return [rnd.randrange(256) for _ in range(n)]
+
+# the 0x7E 0x20 escape that ble_amdtp_arduino and amdtc used before 4.1 (String characteristics)
+def escape(frame):
+    out = []
+    for b in frame:
+        out += [0x7E, 0x20] if b == 0 else [b]
+    return out
+
+def unescape(frame):
+    out, save = [], 0
+    for c in frame:
+        if c == 0x7E and save == 0:
+            save = 0x7E
+            continue
+        if save == 0x7E:
+            if c == 0x20:
+                c = 0
+            else:
+                out.append(save)
+            save = 0
+        out.append(c)
+    if save:
+        out.append(save)                # a 0x7E as last byte
+    return out
+
+class Side():
+    """ one end of a link : an AMDTP implementation with a queue of frames to the other end """
+
+    def __init__(self, name):
+        self.name = name
+        self.out = []                       # frames to the peer
+        self.received = []                  # packets delivered
+        self.amdtp = None
+
+    def on_data(self, data, len):
+        self.received.append(list(data[:len]))
+
+    def on_send(self, data, len):
+        self.out.append(list(data[:len]))
+
+    def receive(self, frame):
+        self.amdtp.AmdtpReceivePkt(frame, len(frame))
+
+class Link():
+    """
+        moves frames from one side to the other, one at a time as BLE would.
+        drop(frame) can lose a frame, clock and timers are virtual
+    """
+
+    def __init__(self):
+        self.now = 0
+        self.timers = {}
+        self.drop = None
+        self.frames = 0
+        self.longest = 0                    # longest frame on the link
+
+    def timer(self, side):
+        def set_timer(ms):
+            if ms:
+                self.timers[side] = self.now + ms
+            else:
+                self.timers.pop(side, None)
+        return set_timer
+
+    def run(self, a, b, max_steps = 200000):
+        for _ in range(max_steps):
+            moved = False
+
+            for src, dst in ((a, b), (b, a)):
+                if src.out:
+                    frame = src.out.pop(0)
+                    self.frames += 1
+                    self.longest = max(self.longest, len(frame))
+                    moved = True
+
+                    if self.drop is None or not self.drop(frame):
+                        dst.receive(frame)
+
+            if moved:
+                continue
+
+            # idle : let the first timer expire
+            if not self.timers:
+                return
+
+            side = min(self.timers, key = self.timers.get)
+            self.now = self.timers.pop(side)
+            side.amdtp.Timeout()
+
+        raise AssertionError("link did not become idle")
+
+def core_side(name, link, window = 0, mtu = amdtpcore.ATT_DEFAULT_MTU, **kwargs):
+    side = Side(name)
+
+    # without a timer the core stays stop-and-wait
+    if window:
+        kwargs["timer_callback"] = link.timer(side)
+
+    side.amdtp = AmdtpCoreClient(Received_data_callback = side.on_data,
+                                 send_central_callback = side.on_send, window = window, **kwargs)
+    side.amdtp.UpdateMTU(mtu)
+    return side
+
+def legacy_side(name):
+    side = Side(name)
+    side.amdtp = amdtpc.AmdtpClient(Received_data_callback = side.on_data,
+                                    send_central_callback = side.on_send)
+    return side
+
+class WireFormat(unittest.TestCase):
+
+    def test_data_frame(self):
+        link = Link()
+        a = core_side("a", link)
+        self.assertEqual(a.amdtp.AmdtpSendData([0x07], 1), 0)
+        self.assertEqual(a.out, [DATA_07])
+
+    def test_ack_frame(self):
+        link = Link()
+        a = core_side("a", link)
+        st = a.amdtp.AmdtpReceivePkt(DATA_07, len(DATA_07))
+        self.assertEqual(st, amdtpcore.AMDTP_STATUS_RECEIVE_DONE)
+        self.assertEqual(a.received, [[0x07]])
+        self.assertEqual(a.out, [ACK_SUCCESS])
+
+    def test_crc_error(self):
+        link = Link()
+        a = core_side("a", link)
+        bad = DATA_07[:]
+        bad[4] ^= 0x01
+        st = a.amdtp.AmdtpReceivePkt(bad, len(bad))
+        self.assertEqual(st, amdtpcore.AMDTP_STATUS_CRC_ERROR)
+        self.assertEqual(a.received, [])
+        self.assertEqual(a.out[0][4], amdtpcore.AMDTP_STATUS_CRC_ERROR)
+
+    def test_too_long(self):
+        link = Link()
+        a = core_side("a", link)
+        n = amdtpcore.AMDTP_MAX_PAYLOAD_SIZE + 1
+        self.assertEqual(a.amdtp.AmdtpSendData(payload(n), n), -1)
+
+class Legacy(unittest.TestCase):
+    """ the core against amdtpc.py, stop-and-wait at the default MTU """
+
+    def exchange(self, sender, receiver, link):
+        for n in range(1, amdtpcore.AMDTP_MAX_PAYLOAD_SIZE + 1):
+            data = payload(n)
+            self.assertGreaterEqual(sender.amdtp.AmdtpSendData(data, n), 0, "size {0}".format(n))
+            link.run(sender, receiver)
+            self.assertTrue(sender.amdtp.AmdtpSendComplete())
+            self.assertEqual(receiver.received, [data], "size {0}".format(n))
+            receiver.received.clear()
+
+    def test_core_to_legacy(self):
+        link = Link()
+        core, old = core_side("core", link), legacy_side("amdtpc")
+        self.exchange(core, old, link)
+        self.assertEqual(core.amdtp.Stats()["packetsSent"], amdtpcore.AMDTP_MAX_PAYLOAD_SIZE)
+
+    def test_legacy_to_core(self):
+        link = Link()
+        core, old = core_side("core", link), legacy_side("amdtpc")
+        self.exchange(old, core, link)
+        self.assertEqual(core.amdtp.Stats()["packetsReceived"], amdtpcore.AMDTP_MAX_PAYLOAD_SIZE)
+
+    def test_negotiate_with_legacy(self):
+        # amdtpc.py does not know WINDOW_REQ : stay stop-and-wait
+        link = Link()
+        core = core_side("core", link, window = 8)
+        old = legacy_side("amdtpc")
+        core.amdtp.Negotiate()
+        link.run(core, old)
+        self.assertEqual(core.amdtp.Window(), 0)
+        self.assertEqual(core.amdtp.PeerVersion(), 0)
+        self.exchange(core, old, link)
+
+class Window(unittest.TestCase):
+    """ core against core in window mode """
+
+    def pair(self, window = 8, mtu = 100):
+        link = Link()
+        a = core_side("a", link, window = window, mtu = mtu)
+        b = core_side("b", link, window = window, mtu = mtu)
+        a.amdtp.Negotiate()
+        link.run(a, b)
+        return link, a, b
+
+    def test_negotiate(self):
+        link, a, b = self.pair()
+        self.assertEqual(a.amdtp.Window(), 8)
+        self.assertEqual(b.amdtp.Window(), 8)
+        self.assertGreaterEqual(a.amdtp.PeerVersion(), 2)
+
+    def test_both_ways(self):
+        link, a, b = self.pair()
+        for n in (1, 20, 97, 200, 511, 512):
+            da, db = payload(n, 1), payload(n, 2)
+            self.assertGreaterEqual(a.amdtp.AmdtpSendData(da, n), 0)
+            self.assertGreaterEqual(b.amdtp.AmdtpSendData(db, n), 0)
+            link.run(a, b)
+            self.assertEqual(b.received, [da])
+            self.assertEqual(a.received, [db])
+            a.received.clear()
+            b.received.clear()
+
+    def test_lost_frames(self):
+        link, a, b = self.pair(mtu = amdtpcore.ATT_DEFAULT_MTU)
+        rnd = random.Random(5)
+        link.drop = lambda frame: rnd.random() < 0.05
+
+        for i in range(20):
+            data = payload(512, i)
+            self.assertGreaterEqual(a.amdtp.AmdtpSendData(data, 512), 0)
+            link.run(a, b)
+            self.assertEqual(b.received, [data])
+            b.received.clear()
+
+        st = a.amdtp.Stats()
+        self.assertEqual(st["packetsSent"], 20)
+        self.assertGreater(st["framesResent"], 0)
+
+class FuzzLink(Link):
+    """
+        a link that loses, repeats and reorders frames, and now and then
+        delivers a copy of a frame of an earlier packet
+    """
+
+    def __init__(self, seed, lose = 0.03, repeat = 0.05, late = 0.03, spread = 4):
+        super().__init__()
+        self.rnd = random.Random(seed)
+        self.lose, self.repeat, self.late, self.spread = lose, repeat, late, spread
+        self.old = []                       # (side, frame) copies for later
+
+    def run(self, a, b, max_steps = 200000):
+        flight = {a: [], b: []}             # frames on the way to a side
+        rnd = self.rnd
+
+        for _ in range(max_steps):
+            moved = False
+
+            for src, dst in ((a, b), (b, a)):
+                while src.out:
+                    flight[dst].append(src.out.pop(0))
+                    self.frames += 1
+
+                if not flight[dst]:
+                    continue
+
+                # any of the first "spread" frames can go first
+                frame = flight[dst].pop(rnd.randrange(min(len(flight[dst]), self.spread)))
+                moved = True
+
+                r = rnd.random()
+                if r < self.lose:
+                    continue
+                if r < self.lose + self.repeat:
+                    flight[dst].append(list(frame))
+                elif r < self.lose + self.repeat + self.late:
+                    self.old.append((dst, list(frame)))
+                dst.receive(frame)
+
+                # a frame of long ago
+                if self.old and rnd.random() < self.late:
+                    side, frame = self.old.pop(rnd.randrange(len(self.old)))
+                    side.receive(frame)
+
+            if moved:
+                continue
+
+            if not self.timers:
+                return
+
+            side = min(self.timers, key = self.timers.get)
+            self.now = self.timers.pop(side)
+            side.amdtp.Timeout()
+
+        raise AssertionError("link did not become idle")
+
+class Sequence(unittest.TestCase):
+    """ extended serial numbers : duplicates, reordering, late frames, old peers """
+
+    # amdtp_core.h / amdtp_common.h
+    EXTSN_VERSION = 5
+    WINDOW_REQ, WINDOW_RSP = 2, 3
+
+    def pair(self, link, old_version = None):
+        a = core_side("a", link, window = 8, mtu = 60)
+        b = core_side("b", link, window = 8, mtu = 60)
+
+        if old_version is not None:
+            link.drop = lambda frame: self.old_version(frame, old_version)
+
+        a.amdtp.Negotiate()
+        Link.run(link, a, b)                # negotiate on a clean link
+        link.drop = None
+        return a, b
+
+    def old_version(self, frame, version):
+        """ WINDOW_REQ / WINDOW_RSP of a peer before version 5 """
+        if frame[3] >> 4 == amdtpcore.AMDTP_PKT_TYPE_CONTROL and frame[4] in (self.WINDOW_REQ, self.WINDOW_RSP):
+            frame[5] = version
+            crc = zlib.crc32(bytes(frame[4:-4]))
+            frame[-4:] = list(crc.to_bytes(4, "little"))
+        return False
+
+    def send_all(self, link, a, b, count):
+        sent = []
+        for i in range(count):
+            n = 1 + (i * 37) % 300
+            data = payload(n, i)
+            self.assertGreaterEqual(a.amdtp.AmdtpSendData(data, n), 0)
+            link.run(a, b)
+            sent.append(data)
+        return sent
+
+    def test_fuzz(self):
+        # 60 packets : the 4 bit serial number wraps several times
+        for seed in range(4):
+            link = FuzzLink(seed)
+            a, b = self.pair(link)
+            self.assertGreaterEqual(a.amdtp.PeerVersion(), self.EXTSN_VERSION)
+
+            sent = self.send_all(link, a, b, 60)
+            self.assertEqual(b.received, sent, "seed %d" % seed)
+
+            st = b.amdtp.Stats()
+            self.assertEqual(st["packetsReceived"], 60)
+            self.assertGreater(st["framesReordered"], 0)
+            self.assertGreater(st["framesStale"] + st["framesDuplicate"], 0)
+
+    def test_fuzz_old_peer(self):
+        # 4 bit serial numbers : a late frame can cost a packet, but every
+        # send must end (send_all checks the core is idle again)
+        link = FuzzLink(0)
+        a, b = self.pair(link, 4)
+        self.assertEqual(a.amdtp.PeerVersion(), 4)
+        self.send_all(link, a, b, 60)
+        self.assertTrue(link.frames)
+
+    def test_late_copies(self):
+        # every data frame comes again after the next packets
+        link = Link()
+        a, b = self.pair(link)
+        frames = []
+        link.drop = lambda frame: frames.append(list(frame)) and False
+
+        sent = self.send_all(link, a, b, 40)
+        link.drop = None
+
+        for frame in frames:
+            if frame[1] & 0xf0 == 0xE0:
+                b.receive(frame)
+        link.run(a, b)
+
+        self.assertEqual(b.received, sent)
+        self.assertGreater(b.amdtp.Stats()["framesStale"], 0)
+
+    def test_frame_format(self):
+        for version, mark, hdr in ((None, 0xE0, 5), (4, 0xF0, 3)):
+            link = Link()
+            a, b = self.pair(link, version)
+            frames = []
+            link.drop = lambda frame: frames.append(list(frame)) and False
+
+            data = payload(300, 1)
+            a.amdtp.AmdtpSendData(data, 300)
+            link.run(a, b)
+            self.assertEqual(b.received, [data])
+
+            win = [f for f in frames if f[1] >= 0xE0]
+            self.assertTrue(win)
+            self.assertTrue(all(f[1] & 0xf0 == mark for f in win))
+            self.assertEqual(max(len(f) for f in win), 60 - 3)
+            self.assertEqual(win[0][2], 60 - 3 - hdr)
+
+class Streams(unittest.TestCase):
+
+    def run_stream(self, window, total, known = True):
+        link = Link()
+        got = bytearray()
+        done = []
+
+        def on_stream(data, n, offset):
+            self.assertEqual(offset, len(got))
+            got.extend(data[:n])
+
+        kw = dict(Received_stream_callback = on_stream,
+                  Stream_done_callback = lambda status, n: done.append((status, n)))
+        a = core_side("a", link, window = window, mtu = 100)
+        b = core_side("b", link, window = window, mtu = 100, **kw)
+        a.amdtp.Negotiate()
+        link.run(a, b)
+
+        data = bytes(payload(total))
+        self.assertEqual(a.amdtp.StreamOpen(total if known else amdtpcore.AMDTP_STREAM_LEN_UNKNOWN),
+                         amdtpcore.AMDTP_STATUS_SUCCESS)
+        pos = 0
+        while pos < total:
+            n = a.amdtp.StreamWrite(data[pos:pos + 100], min(100, total - pos))
+            pos += n
+            link.run(a, b)
+        a.amdtp.StreamClose()
+        link.run(a, b)
+
+        self.assertEqual(bytes(got), data)
+        self.assertEqual(done, [(amdtpcore.AMDTP_STATUS_SUCCESS, total)])
+        self.assertEqual(a.amdtp.lastSent, amdtpcore.AMDTP_STATUS_SUCCESS)
+
+    def test_stop_and_wait(self):
+        self.run_stream(0, 3000)
+
+    def test_window(self):
+        self.run_stream(8, 20000)
+
+    def test_unknown_length(self):
+        self.run_stream(8, 1234, known = False)
+
+class RawFrames(unittest.TestCase):
+    """ raw byte characteristics : the frames of the core go on the wire as they are """
+
+    @staticmethod
+    def awkward(n, seed = 0):
+        """ zeros, 0x7E 0x20 and 0x7E at the end : what the escape got wrong or had to double """
+        rnd = random.Random(seed)
+        return [rnd.choice((0x00, 0x7E, 0x20, 0x7E, rnd.randrange(256))) for _ in range(n)]
+
+    def round_trip(self, window, mtu, sizes, seed = 0):
+        link = Link()
+        a = core_side("a", link, window = window, mtu = mtu)
+        b = core_side("b", link, window = window, mtu = mtu)
+
+        if window:
+            a.amdtp.Negotiate()
+            link.run(a, b)
+
+        for i, n in enumerate(sizes):
+            for data in ([0] * n, [0x7E, 0x20] * (n // 2) + [0x7E] * (n % 2), self.awkward(n, seed + i)):
+                self.assertGreaterEqual(a.amdtp.AmdtpSendData(data, n), 0)
+                link.run(a, b)
+                self.assertEqual(b.received, [data])
+                b.received.clear()
+
+                # and back
+                self.assertGreaterEqual(b.amdtp.AmdtpSendData(data, n), 0)
+                link.run(a, b)
+                self.assertEqual(a.received, [data])
+                a.received.clear()
+
+        return link
+
+    def test_stop_and_wait(self):
+        mtu = amdtpcore.ATT_DEFAULT_MTU
+        link = self.round_trip(0, mtu, (1, 2, 7, 100, 512))
+
+        # a frame fills the MTU, the escape allowed only (mtu - 3) / 2
+        self.assertEqual(link.longest, mtu - 3)
+
+    def test_window(self):
+        for mtu in (amdtpcore.ATT_DEFAULT_MTU, 64, 185):
+            with self.subTest(mtu = mtu):
+                link = self.round_trip(8, mtu, (1, 19, 20, 21, 300, 512), seed = mtu)
+                self.assertEqual(link.longest, mtu - 3)
+
+    def test_all_byte_values(self):
+        link = Link()
+        a = core_side("a", link, window = 8)
+        b = core_side("b", link, window = 8)
+        a.amdtp.Negotiate()
+        link.run(a, b)
+
+        data = list(range(256)) * 2
+        self.assertGreaterEqual(a.amdtp.AmdtpSendData(data, len(data)), 0)
+        link.run(a, b)
+        self.assertEqual(b.received, [data])
+
+    def test_escape_was_not_transparent(self):
+        # why it went : 0x7E 0x20 in the data came out as a zero and a 0x7E
+        # before a zero took the escape of that zero as data
+        self.assertEqual(unescape(escape([0, 5, 0])), [0, 5, 0])
+        self.assertNotEqual(unescape(escape([5, 0x7E, 0x20])), [5, 0x7E, 0x20])
+        self.assertNotEqual(unescape(escape([5, 0x7E, 0])), [5, 0x7E, 0])
+
+class CutThrough(unittest.TestCase):
+    """ the CRC is calculated per frame, cut-through gives the frames as they arrive """
+
+    def receiver(self, link, cut, **kwargs):
+        side = core_side("rx", link, **kwargs)
+        if cut:
+            side.parts, side.done = [], []
+
+            def on_part(data, n, offset):
+                self.assertEqual(offset, sum(len(d) for d in side.parts))
+                side.parts.append(data[:n])
+
+            side.amdtp = AmdtpCoreClient(Received_data_callback = side.on_data,
+                                         send_central_callback = side.on_send,
+                                         Received_part_callback = on_part,
+                                         Part_done_callback = lambda st, n: side.done.append((st, n)),
+                                         **({"window": kwargs["window"], "timer_callback": link.timer(side)}
+                                            if kwargs.get("window") else {}))
+            side.amdtp.UpdateMTU(kwargs.get("mtu", amdtpcore.ATT_DEFAULT_MTU))
+        return side
+
+    @staticmethod
+    def packet(data):
+        """ stop-and-wait data packet, no ACK per frame """
+        crc = zlib.crc32(bytes(data))
+        n = len(data) + 4
+        return [n & 0xff, n >> 8, 0x00, 0x10] + data + [(crc >> s) & 0xff for s in (0, 8, 16, 24)]
+
+    @staticmethod
+    def split(pkt, rnd):
+        """ frames as sent with a random MTU, with random frame lengths """
+        mtu = rnd.randrange(11, amdtpcore.ATT_MAX_MTU + 1)
+        frames, pos = [], 0
+        while pos < len(pkt):
+            n = rnd.randrange(5 if pos == 0 else 1, mtu - 2)   # header and data in the first
+            frames.append(pkt[pos:pos + n])
+            pos += n
+        return frames
+
+    def test_random_frames(self):
+        rnd = random.Random(35)
+        link = Link()
+        full, cut = self.receiver(link, False), self.receiver(link, True)
+
+        for i in range(300):
+            data = payload(rnd.randrange(0, amdtpcore.AMDTP_MAX_PAYLOAD_SIZE + 1), i)
+            pkt = self.packet(data)
+            bad = i % 3 == 0 and len(data) > 0
+            if bad:
+                pkt[rnd.randrange(4, len(pkt))] ^= 1 << rnd.randrange(8)
+
+            for side in (full, cut):
+                for frame in self.split(pkt, rnd):
+                    side.receive(frame)
+
+            ok = amdtpcore.AMDTP_STATUS_CRC_ERROR if bad else amdtpcore.AMDTP_STATUS_SUCCESS
+            self.assertEqual(full.received, [] if bad else [data], i)
+            self.assertEqual(cut.received, [])
+            self.assertEqual(cut.done, [(ok, len(data))], i)
+            if not bad:
+                self.assertEqual(sum(cut.parts, []), data)
+
+            full.received.clear()
+            cut.parts.clear()
+            cut.done.clear()
+
+    def test_window(self):
+        rnd = random.Random(350)
+
+        for i in range(20):
+            link = Link()
+            mtu = rnd.randrange(amdtpcore.ATT_DEFAULT_MTU, amdtpcore.ATT_MAX_MTU + 1)
+            a = core_side("a", link, window = 8, mtu = mtu)
+            b = self.receiver(link, True, window = 8, mtu = mtu)
+            a.amdtp.Negotiate()
+            link.run(a, b)
+            link.drop = lambda frame: rnd.random() < 0.05
+
+            data = payload(rnd.randrange(1, amdtpcore.AMDTP_MAX_PAYLOAD_SIZE + 1), i)
+            self.assertGreaterEqual(a.amdtp.AmdtpSendData(data, len(data)), 0)
+            link.run(a, b)
+            self.assertEqual(sum(b.parts, []), data, "mtu {0}".format(mtu))
+            self.assertEqual(b.done, [(amdtpcore.AMDTP_STATUS_SUCCESS, len(data))])
+            self.assertEqual(b.received, [])
+
+class Compression(unittest.TestCase):
+
+    @staticmethod
+    def records(n):
+        """ text records as a sensor sketch sends them """
+        text = "".join("T:{0:.2f} H:{1:.1f} P:1013.2\n".format(21 + (i % 9) * 0.05, 45 + i % 4) for i in range(60))
+        return list(text.encode()[:n])
+
+    def lz(self):
+        lib = amdtpcore.LoadLibrary()
+        for name in ("AmdtpLzCompress", "AmdtpLzDecompress"):
+            getattr(lib, name).argtypes = [ctypes.c_char_p, ctypes.c_uint16, ctypes.c_char_p, ctypes.c_uint16]
+            getattr(lib, name).restype = ctypes.c_uint16
+        return lib
+
+    def test_round_trip(self):
+        lib = self.lz()
+        rnd = random.Random(36)
+        out, back = ctypes.create_string_buffer(1024), ctypes.create_string_buffer(1024)
+
+        for i in range(300):
+            n = rnd.randrange(1, amdtpcore.AMDTP_MAX_PAYLOAD_SIZE + 1)
+            kind = i % 3
+            data = bytes(self.records(n) if kind == 0 else payload(n, i) if kind == 1 else
+                         [rnd.choice(b"ab") for _ in range(n)])
+            c = lib.AmdtpLzCompress(data, n, out, 1024)
+            self.assertGreater(c, 0)
+            self.assertEqual(lib.AmdtpLzDecompress(out.raw[:c], c, back, 1024), n)
+            self.assertEqual(back.raw[:n], data)
+
+            # too small an output is refused, not overwritten
+            self.assertEqual(lib.AmdtpLzDecompress(out.raw[:c], c, back, n - 1), 0)
+
+        # a match before the start of the output is refused
+        self.assertEqual(lib.AmdtpLzDecompress(bytes([0x01, 0x05, 0x00]), 3, back, 1024), 0)
+
+    def pair(self, compress_a = True, compress_b = True, window = 8):
+        link = Link()
+        a = core_side("a", link, window = window, mtu = 100, compress = compress_a)
+        b = core_side("b", link, window = window, mtu = 100, compress = compress_b)
+        a.amdtp.Negotiate()
+        link.run(a, b)
+        return link, a, b
+
+    def test_both_ways(self):
+        for window in (0, 8):
+            link, a, b = self.pair(window = window)
+            for n in (1, 100, 200, 512):
+                da, db = self.records(n), payload(n, 3)
+                self.assertGreaterEqual(a.amdtp.AmdtpSendData(da, n), 0)
+                link.run(a, b)
+                self.assertGreaterEqual(b.amdtp.AmdtpSendData(db, n), 0)
+                link.run(a, b)
+                self.assertEqual(b.received, [da])
+                self.assertEqual(a.received, [db])
+                a.received.clear()
+                b.received.clear()
+
+            # text compresses, random data is sent as is
+            self.assertEqual(a.amdtp.Stats()["packetsCompressed"], 3)
+            self.assertGreater(a.amdtp.Stats()["bytesSaved"], 250)
+            self.assertEqual(b.amdtp.Stats()["packetsCompressed"], 0)
+
+    def test_fewer_frames(self):
+        frames = []
+        for compress in (False, True):
+            link, a, b = self.pair(compress, compress)
+            start = link.frames
+            data = self.records(512)
+            a.amdtp.AmdtpSendData(data, 512)
+            link.run(a, b)
+            self.assertEqual(b.received, [data])
+            frames.append(link.frames - start)
+        self.assertLess(frames[1], frames[0])
+
+    def test_one_direction(self):
+        link, a, b = self.pair(True, False)
+        data = self.records(300)
+        b.amdtp.AmdtpSendData(data, 300)
+        link.run(a, b)
+        a.amdtp.AmdtpSendData(data, 300)
+        link.run(a, b)
+        self.assertEqual(a.received, [data])
+        self.assertEqual(b.received, [data])
+        self.assertEqual(a.amdtp.Stats()["packetsCompressed"], 1)
+        self.assertEqual(b.amdtp.Stats()["packetsCompressed"], 0)
+
+    def test_legacy_peer(self):
+        # amdtpc.py does not answer the negotiation : never compress
+        link = Link()
+        core = core_side("core", link, compress = True)
+        old = legacy_side("amdtpc")
+        core.amdtp.Negotiate()
+        link.run(core, old)
+        data = self.records(400)
+        self.assertGreaterEqual(core.amdtp.AmdtpSendData(data, 400), 0)
+        link.run(core, old)
+        self.assertEqual(old.received, [data])
+        self.assertEqual(core.amdtp.Stats()["packetsCompressed"], 0)
+
+    def test_stream(self):
+        link, a, b = self.pair()
+        got = bytearray()
+        b.amdtp._stream_callback = lambda data, n, offset: got.extend(data[:n])
+        data = bytes(self.records(1800) * 3)
+        a.amdtp.StreamOpen(len(data))
+        pos = 0
+        while pos < len(data):
+            pos += a.amdtp.StreamWrite(data[pos:pos + 100], min(100, len(data) - pos))
+            link.run(a, b)
+        a.amdtp.StreamClose()
+        link.run(a, b)
+        self.assertEqual(bytes(got), data)
+        self.assertEqual(b.amdtp.Stats()["streamsReceived"], 1)
+        self.assertGreater(a.amdtp.Stats()["packetsCompressed"], 0)
+
+class Encryption(unittest.TestCase):
+
+    KEY = bytes(range(0x40, 0x50))
+
+    def pair(self, key_a = KEY, key_b = KEY, window = 8, **kwargs):
+        link = Link()
+        a = core_side("a", link, window = window, mtu = 100, key = key_a, **kwargs)
+        b = core_side("b", link, window = window, mtu = 100, key = key_b, **kwargs)
+        a.amdtp.Negotiate()
+        link.run(a, b)
+        return link, a, b
+
+    def test_vectors(self):
+        lib = amdtpcore.LoadLibrary()
+        ctx = ctypes.create_string_buffer(44 * 4)
+
+        # FIPS-197 appendix C.1
+        block = ctypes.create_string_buffer(bytes(i * 0x11 for i in range(16)), 16)
+        lib.AmdtpCcmSetKey(ctx, bytes(range(16)))
+        lib.AmdtpCcmBlock(ctx, block, block)
+        self.assertEqual(block.raw.hex(), "69c4e0d86a7b0430d8cdb78070b4c55a")
+
+        # RFC 3610 packet vector #1
+        lib.AmdtpCcmSetKey(ctx, bytes(range(0xC0, 0xD0)))
+        data = ctypes.create_string_buffer(bytes(range(8, 31)), 31)
+        nonce = bytes([0, 0, 0, 3, 2, 1, 0, 0xA0, 0xA1, 0xA2, 0xA3, 0xA4, 0xA5])
+        lib.AmdtpCcmEncrypt(ctx, nonce, bytes(range(8)), ctypes.c_uint16(8), data, ctypes.c_uint16(23),
+                            ctypes.byref(data, 23), ctypes.c_uint8(8))
+        self.assertEqual(data.raw.hex().upper(),
+                         "588C979A61C663D2F066D0C2C0F989806D5F6B61DAC38417E8D12CFDF926E0")
+
+    def test_both_ways(self):
+        for window in (0, 8):
+            link, a, b = self.pair(window = window)
+            self.assertTrue(a.amdtp.Secure())
+            self.assertTrue(b.amdtp.Secure())
+
+            for n in (1, 20, 200, 504, 512):
+                da, db = payload(n, 1), payload(n, 2)
+                self.assertGreaterEqual(a.amdtp.AmdtpSendData(da, n), 0)
+                link.run(a, b)
+                self.assertGreaterEqual(b.amdtp.AmdtpSendData(db, n), 0)
+                link.run(a, b)
+                self.assertEqual(b.received, [da])
+                self.assertEqual(a.received, [db])
+                a.received.clear()
+                b.received.clear()
+
+            self.assertEqual(a.amdtp.Stats()["authErrors"], 0)
+            self.assertEqual(b.amdtp.Stats()["authErrors"], 0)
+
+    def test_not_plain(self):
+        link, a, b = self.pair()
+        frames = []
+        link.drop = lambda frame: frames.append(bytes(frame)) and False
+        data = list(b"the same secret text, the same secret text")
+        for _ in range(2):
+            a.amdtp.AmdtpSendData(data, len(data))
+            link.run(a, b)
+        self.assertEqual(b.received, [data, data])
+
+        # the data is not on the wire, and a new counter gives other bytes
+        wire = [f for f in frames if len(f) > 40]
+        self.assertEqual(len(wire), 2)
+        self.assertNotIn(b"secret", b"".join(wire))
+        self.assertNotEqual(wire[0][8:], wire[1][8:])
+
+    def test_with_compression(self):
+        link, a, b = self.pair(compress = True)
+        data = Compression.records(400)
+        a.amdtp.AmdtpSendData(data, 400)
+        link.run(a, b)
+        self.assertEqual(b.received, [data])
+        self.assertEqual(a.amdtp.Stats()["packetsCompressed"], 1)
+
+    def test_stream(self):
+        link, a, b = self.pair()
+        got = bytearray()
+        b.amdtp._stream_callback = lambda data, n, offset: got.extend(data[:n])
+        data = bytes(payload(3000, 5))
+        a.amdtp.StreamOpen(len(data))
+        pos = 0
+        while pos < len(data):
+            pos += a.amdtp.StreamWrite(data[pos:pos + 300], min(300, len(data) - pos))
+            link.run(a, b)
+        a.amdtp.StreamClose()
+        link.run(a, b)
+        self.assertEqual(bytes(got), data)
+        self.assertEqual(b.amdtp.Stats()["streamsReceived"], 1)
+
+    def test_wrong_key(self):
+        link, a, b = self.pair(key_b = bytes(16))
+        a.amdtp.AmdtpSendData([1, 2, 3], 3)
+        link.run(a, b)
+        self.assertEqual(b.received, [])
+        self.assertEqual(b.amdtp.Stats()["authErrors"], 1)
+
+    def test_peer_without_key(self):
+        link, a, b = self.pair(key_b = None)
+        self.assertFalse(a.amdtp.Secure())
+        self.assertEqual(a.amdtp.AmdtpSendData([1, 2, 3], 3), -1)
+
+        # the peer sends plain data, that is refused
+        b.amdtp.AmdtpSendData([1, 2, 3], 3)
+        link.run(a, b)
+        self.assertEqual(a.received, [])
+        self.assertEqual(a.amdtp.Stats()["authErrors"], 1)
+
+    def test_legacy_peer(self):
+        link = Link()
+        core = core_side("core", link, key = self.KEY)
+        old = legacy_side("amdtpc")
+        core.amdtp.Negotiate()
+        link.run(core, old)
+        self.assertFalse(core.amdtp.Secure())
+        self.assertEqual(core.amdtp.AmdtpSendData([1], 1), -1)
+
+    def resend(self, change):
+        """ send one packet in one frame, give the receiver a (changed) copy again """
+        link, a, b = self.pair(window = 0)
+        frames = []
+        link.drop = lambda frame: frames.append(list(frame)) and False
+        a.amdtp.AmdtpSendData([7] * 30, 30)
+        link.run(a, b)
+        self.assertEqual(len(b.received), 1)
+
+        frame = change(frames[0])
+        crc = zlib.crc32(bytes(frame[4:-4]))
+        frame[-4:] = list(crc.to_bytes(4, "little"))
+        b.receive(frame)
+        link.run(a, b)
+        return b
+
+    def test_replay(self):
+        b = self.resend(lambda frame: frame)
+        self.assertEqual(len(b.received), 1)
+        self.assertEqual(b.amdtp.Stats()["authErrors"], 1)
+
+    def test_changed(self):
+        def change(frame):
+            frame[4] += 1                   # a new counter
+            frame[12] ^= 0x55               # and changed data
+            return frame
+
+        b = self.resend(change)
+        self.assertEqual(len(b.received), 1)
+        self.assertEqual(b.amdtp.Stats()["authErrors"], 1)
+
+    def test_reset_transfer(self):
+        """ a send timeout in the middle of a packet : the session key stays, no new negotiation """
+        for window in (0, 8):
+            link, a, b = self.pair(window = window)
+            data = payload(504, 3)
+
+            # two frames of the packet get through, then the sender gives up
+            self.assertEqual(a.amdtp.AmdtpSendData(data, len(data)), 1)
+            for frame in a.out[:2]:
+                b.receive(frame)
+            a.out.clear()
+            a.amdtp.ResetTransfer()
+            self.assertNotIn(a, link.timers)
+
+            # the next packet follows at once, before the answer to a RESEND_REQ
+            self.assertTrue(a.amdtp.Secure())
+            self.assertTrue(a.amdtp.AmdtpSendComplete())
+
+            for n in (20, 504):
+                da, db = payload(n, 4), payload(n, 5)
+                self.assertGreaterEqual(a.amdtp.AmdtpSendData(da, n), 0)
+                link.run(a, b)
+                self.assertGreaterEqual(b.amdtp.AmdtpSendData(db, n), 0)
+                link.run(a, b)
+                self.assertEqual(b.received, [da])
+                self.assertEqual(a.received, [db])
+                a.received.clear()
+                b.received.clear()
+
+            self.assertEqual(a.amdtp.Stats()["authErrors"], 0)
+            self.assertEqual(b.amdtp.Stats()["authErrors"], 0)
+
+        # the receiving side resets : the sender repeats the packet, it arrives once
+        link, a, b = self.pair(window = 8)
+        data = payload(504, 6)
+        a.amdtp.AmdtpSendData(data, len(data))
+        for frame in a.out[:2]:
+            b.receive(frame)
+        del a.out[:2]
+        b.amdtp.ResetTransfer()
+        link.run(a, b)
+        self.assertEqual(b.received, [data])
+        self.assertEqual(b.amdtp.Stats()["authErrors"], 0)
+
+    def test_ccm_bench(self):
+        bench = os.path.join(HERE, "ccm_bench")
+        if not os.path.isfile(bench):
+            self.skipTest("ccm_bench not build")
+
+        r = subprocess.run([bench], stdout = subprocess.PIPE, universal_newlines = True)
+        if "-v" in sys.argv:
+            print("\n" + r.stdout)
+        self.assertEqual(r.returncode, 0, r.stdout)
+
+class Crc(unittest.TestCase):
+    """ AmdtpCrc32 in crc32.c is the same as zlib.crc32 """
+
+    def setUp(self):
+        self.crc = amdtpcore.LoadLibrary().AmdtpCrc32
+        self.crc.argtypes = [ctypes.c_uint32, ctypes.POINTER(ctypes.c_uint8), ctypes.c_uint32]
+        self.crc.restype = ctypes.c_uint32
+
+    def calc(self, crc, data):
+        return self.crc(crc, (ctypes.c_uint8 * len(data)).from_buffer_copy(bytes(data)), len(data))
+
+    def test_check_value(self):
+        self.assertEqual(self.calc(0, b"123456789"), 0xCBF43926)
+
+    def test_sizes(self):
+        for n in list(range(0, 70)) + [244, 512, 4096, 65536]:
+            data = payload(n, n)
+            self.assertEqual(self.calc(0, data), zlib.crc32(bytes(data)), n)
+
+    def test_parts(self):
+        rnd = random.Random(34)
+        for i in range(200):
+            data = payload(rnd.randrange(1, 3000), i)
+            crc, pos = 0, 0
+            while pos < len(data):
+                n = rnd.randrange(1, 100)
+                crc = self.calc(crc, data[pos:pos + n])
+                pos += n
+            self.assertEqual(crc, zlib.crc32(bytes(data)))
+
+TLM_FIELDS = 6                  # amdtp_tlm.h
+TLM_MAX_SIZE = 253
+
+class TlmSample(ctypes.Structure):
+    _fields_ = [("time", ctypes.c_uint32), ("value", ctypes.c_int32 * TLM_FIELDS)]
+
+class TlmEnc(ctypes.Structure):
+    _fields_ = [("buf", ctypes.c_void_p), ("size", ctypes.c_uint16), ("len", ctypes.c_uint16),
+                ("last", TlmSample)]
+
+class TlmDec(ctypes.Structure):
+    _fields_ = [("buf", ctypes.c_void_p), ("len", ctypes.c_uint16), ("pos", ctypes.c_uint16),
+                ("fields", ctypes.c_uint8), ("count", ctypes.c_uint8), ("index", ctypes.c_uint8),
+                ("last", TlmSample)]
+
+def varint(v):
+    out = []
+    while True:
+        out.append(v & 0x7f | (0x80 if v > 0x7f else 0))
+        v >>= 7
+        if v == 0:
+            return out
+
+def zigzag(v):
+    return ((v << 1) ^ (-1 if v < 0 else 0)) & 0xffffffff
+
+def int32(v):
+    v &= 0xffffffff
+    return v - (1 << 32) if v & 0x80000000 else v
+
+def tlm_encode(fields, samples):
+    """ the batch as documented in amdtp_tlm.h, samples as (time, [6 values]) """
+    out = [1, fields, len(samples)]
+    last = None
+    for t, values in samples:
+        out += varint(t if last is None else (t - last[0]) & 0xffffffff)
+        for f in range(TLM_FIELDS):
+            if fields & (1 << f):
+                out += varint(zigzag(values[f] if last is None else int32(values[f] - last[1][f])))
+        last = (t, values)
+    return out
+
+class Telemetry(unittest.TestCase):
+    """ amdtp_tlm.c : the batch format, round trips and limits """
+
+    def setUp(self):
+        self.lib = lib = amdtpcore.LoadLibrary()
+        p = ctypes.c_void_p
+        lib.AmdtpTlmEncInit.argtypes = [ctypes.POINTER(TlmEnc), p, ctypes.c_uint16, ctypes.c_uint8]
+        lib.AmdtpTlmEncAdd.argtypes = [ctypes.POINTER(TlmEnc), ctypes.POINTER(TlmSample)]
+        lib.AmdtpTlmEncAdd.restype = ctypes.c_bool
+        lib.AmdtpTlmEncLen.argtypes = [ctypes.POINTER(TlmEnc)]
+        lib.AmdtpTlmEncLen.restype = ctypes.c_uint16
+        lib.AmdtpTlmDecInit.argtypes = [ctypes.POINTER(TlmDec), p, ctypes.c_uint16]
+        lib.AmdtpTlmDecInit.restype = ctypes.c_bool
+        lib.AmdtpTlmDecNext.argtypes = [ctypes.POINTER(TlmDec), ctypes.POINTER(TlmSample)]
+        lib.AmdtpTlmDecNext.restype = ctypes.c_bool
+        lib.AmdtpTlmToInt.argtypes = [ctypes.c_float]
+        lib.AmdtpTlmToInt.restype = ctypes.c_int32
+        lib.AmdtpTlmPutSubscribe.argtypes = [p, ctypes.c_uint8, ctypes.c_uint16, ctypes.c_uint8]
+        lib.AmdtpTlmPutSubscribe.restype = ctypes.c_uint16
+        lib.AmdtpTlmGetSubscribe.argtypes = [p, ctypes.c_uint16, p, p, p]
+        lib.AmdtpTlmGetSubscribe.restype = ctypes.c_bool
+
+    def encode(self, fields, samples, size = TLM_MAX_SIZE):
+        """ the samples that fit and the batch """
+        buf = (ctypes.c_uint8 * size)()
+        enc = TlmEnc()
+        self.lib.AmdtpTlmEncInit(ctypes.byref(enc), ctypes.cast(buf, ctypes.c_void_p), size, fields)
+
+        added = 0
+        for t, values in samples:
+            before = bytes(buf[:enc.len])
+            s = TlmSample(t, (ctypes.c_int32 * TLM_FIELDS)(*values))
+            if not self.lib.AmdtpTlmEncAdd(ctypes.byref(enc), ctypes.byref(s)):
+                self.assertEqual(bytes(buf[:enc.len]), before)      # the batch as before
+                break
+            added += 1
+
+        return added, list(buf[:self.lib.AmdtpTlmEncLen(ctypes.byref(enc))])
+
+    def decode(self, batch):
+        """ fields and the samples, None if not a batch """
+        buf = (ctypes.c_uint8 * max(len(batch), 1)).from_buffer_copy(bytes(batch) or b"\0")
+        dec = TlmDec()
+        if not self.lib.AmdtpTlmDecInit(ctypes.byref(dec), ctypes.cast(buf, ctypes.c_void_p), len(batch)):
+            return None
+
+        out, s = [], TlmSample()
+        while self.lib.AmdtpTlmDecNext(ctypes.byref(dec), ctypes.byref(s)):
+            out.append((s.time, [s.value[f] if dec.fields & (1 << f) else 0 for f in range(TLM_FIELDS)]))
+        return dec.fields, out
+
+    def walk(self, rnd, n, fields, step = 100):
+        """ samples as a sensor : small changes, the clock may wrap """
+        t = rnd.randrange(1 << 32)
+        values = [rnd.randrange(-100000, 200000) for _ in range(TLM_FIELDS)]
+        out = []
+        for _ in range(n):
+            out.append((t, [v if fields & (1 << f) else 0 for f, v in enumerate(values)]))
+            t = (t + rnd.randrange(step)) & 0xffffffff
+            values = [v + rnd.randrange(-step, step) for v in values]
+        return out
+
+    def test_format(self):
+        rnd = random.Random(45)
+        for i in range(300):
+            fields = rnd.randrange(64)
+            samples = self.walk(rnd, rnd.randrange(1, 30), fields, rnd.choice([2, 100, 100000]))
+            added, batch = self.encode(fields, samples, 4000)
+            self.assertEqual(added, len(samples))
+            self.assertEqual(batch, tlm_encode(fields, samples))
+
+    def test_round_trip(self):
+        rnd = random.Random(46)
+        for i in range(300):
+            fields = rnd.randrange(64)
+            samples = self.walk(rnd, rnd.randrange(1, 100), fields, rnd.choice([2, 100, 100000]))
+            added, batch = self.encode(fields, samples)
+            self.assertGreater(added, 0)
+            self.assertLessEqual(len(batch), TLM_MAX_SIZE)
+            self.assertEqual(self.decode(batch), (fields, samples[:added]))
+
+    def test_extremes(self):
+        lo, hi = -(1 << 31), (1 << 31) - 1
+        samples = [(0xffffffff, [hi, lo, 0, -1, 1, hi]), (5, [lo, hi, -1, 0, hi, lo]),
+                   (5, [hi, lo, hi, lo, 0, 0]), (0, [0] * TLM_FIELDS)]
+        added, batch = self.encode(63, samples)
+        self.assertEqual(added, len(samples))
+        self.assertEqual(batch, tlm_encode(63, samples))
+        self.assertEqual(self.decode(batch), (63, samples))
+
+    def test_size(self):
+        # a BME280 sample each second, 0.01 steps : the first 14 bytes, then 6 - 7
+        rnd = random.Random(47)
+        fields = 0x3c
+        t, values = 1234567, [0, 0, 2134, 4512, 101325, 1050, 0]
+        samples = []
+        for i in range(20):
+            samples.append((t, values[:TLM_FIELDS]))
+            t += 1000 + rnd.randrange(-3, 4)
+            values = [v + rnd.randrange(-20, 21) for v in values]
+        added, batch = self.encode(fields, samples)
+        first = len(self.encode(fields, samples[:1])[1]) - 3
+        self.assertEqual(added, 20)
+        self.assertLessEqual(first, 14)
+        self.assertLessEqual((len(batch) - 3 - first) / 19, 7)
+
+    def test_full(self):
+        rnd = random.Random(48)
+        samples = self.walk(rnd, 400, 63, 100000)
+        for size in (3, 4, 20, 100, TLM_MAX_SIZE):
+            added, batch = self.encode(63, samples, size)
+            self.assertLess(added, len(samples))
+            self.assertLessEqual(len(batch), size)
+            self.assertEqual(self.decode(batch), (63, samples[:added]))
+
+        # at most 255 samples, the count is 1 byte
+        added, batch = self.encode(0, [(i, [0] * TLM_FIELDS) for i in range(300)], 1000)
+        self.assertEqual(added, 255)
+
+    def test_cut_short(self):
+        samples = self.walk(random.Random(49), 10, 63)
+        added, batch = self.encode(63, samples)
+        for n in range(len(batch)):
+            r = self.decode(batch[:n])
+            if n < 3:
+                self.assertIsNone(r)
+            else:
+                self.assertLess(len(r[1]), 10)
+                self.assertEqual(r[1], samples[:len(r[1])])
+
+        self.assertIsNone(self.decode([2] + batch[1:]))                 # other version
+
+    def test_to_int(self):
+        for f, i in ((21.345, 2135), (-0.004, 0), (-0.006, -1), (1013.25, 101325), (99.994, 9999), (1e12, (1 << 31) - 1)):
+            self.assertEqual(self.lib.AmdtpTlmToInt(f), i, f)
+
+    def test_subscribe(self):
+        buf = (ctypes.c_uint8 * 4)()
+        self.assertEqual(self.lib.AmdtpTlmPutSubscribe(buf, 0x3d, 1500, 12), 4)
+        self.assertEqual(list(buf), [0x3d, 0x05, 0xdc, 12])
+
+        fields, ms, n = ctypes.c_uint8(), ctypes.c_uint16(), ctypes.c_uint8()
+        args = [ctypes.byref(fields), ctypes.byref(ms), ctypes.byref(n)]
+        self.assertTrue(self.lib.AmdtpTlmGetSubscribe(buf, 4, *args))
+        self.assertEqual((fields.value, ms.value, n.value), (0x3d, 1500, 12))
+        self.assertFalse(self.lib.AmdtpTlmGetSubscribe(buf, 3, *args))
+
+class Copies(unittest.TestCase):
+    """ the other implementations carry a copy of the core """
+
+    def test_same_core(self):
+        src = os.path.join(MBED, "src", "amdtp")
+        repo = os.path.join(MBED, "..")
+        copies = [os.path.join(repo, "ble_amdtp_arduino", "amdtp_server"),
+                  os.path.join(repo, "ble_amdtp_arduino", "amdtp_client"),
+                  os.path.join(repo, "ble_amdtp_raspPi", "amdtc", "amdtpcommon")]
+        found = [d for d in copies if os.path.isdir(d)]
+
+        if not found:
+            self.skipTest("only MBED-BLE is installed")
+
+        for d in found:
+            for name in ("amdtp_core.c", "amdtp_core.h", "amdtp_lz.c", "amdtp_lz.h", "amdtp_ccm.c", "amdtp_ccm.h",
+                         "amdtp_tlm.c", "amdtp_tlm.h"):
+                with open(os.path.join(src, name), "rb") as f1, open(os.path.join(d, name), "rb") as f2:
+                    self.assertEqual(f1.read(), f2.read(), "{0} differs, run sync_amdtp_core".format(os.path.join(d, name)))
+
+            # the bulk mode is for the Arduino server only
+            if d.endswith("amdtp_server"):
+                for name in ("amdtp_link.c", "amdtp_link.h"):
+                    with open(os.path.join(src, name), "rb") as f1, open(os.path.join(d, name), "rb") as f2:
+                        self.assertEqual(f1.read(), f2.read(), "{0} differs, run sync_amdtp_core".format(os.path.join(d, name)))
+
+            # crc32.c differs per folder (CalcCrc32 or CalcCrc32_org), AmdtpCrc32 not
+            with open(os.path.join(src, "crc32.c")) as f1, open(os.path.join(d, "crc32.c")) as f2:
+                mark = "Incremental CRC-32 with slicing-by-8"
+                self.assertEqual(f1.read().split(mark)[1], f2.read().split(mark)[1], os.path.join(d, "crc32.c"))
+
+class Throughput(unittest.TestCase):
+
+    def test_amdtp_sim(self):
+        sim = os.path.join(HERE, "amdtp_sim")
+        if not os.path.isfile(sim):
+            self.skipTest("amdtp_sim not build")
+
+        for args in ([], ["-s", "20000"], ["-o", "-l", "0"]):
+            r = subprocess.run([sim] + args, stdout = subprocess.PIPE, universal_newlines = True)
+            if "-v" in sys.argv:
+                print("\n" + r.stdout)
+            self.assertEqual(r.returncode, 0, r.stdout)
+
+    def test_amdtp_sim_csv(self):
+        sim = os.path.join(HERE, "amdtp_sim")
+        if not os.path.isfile(sim):
+            self.skipTest("amdtp_sim not build")
+
+        for args in (["-l", "0"], ["-m", "100", "-l", "2"], ["-i", "50000", "-f", "1", "-l", "5"]):
+            r = subprocess.run([sim, "-C"] + args, stdout = subprocess.PIPE, universal_newlines = True)
+            self.assertEqual(r.returncode, 0, r.stdout)
+
+            rows = list(csv.DictReader(r.stdout.splitlines()))
+            self.assertEqual(len(rows), 7, r.stdout)
+
+            goodput = {}
+            for row in rows:
+                if row["mode"] == "stop-and-wait":
+                    continue
+                self.assertEqual(row["result"], "ok", row)
+                lat = [float(row["latency_" + p + "_ms"]) for p in ("p50", "p90", "p99", "max")]
+                self.assertEqual(lat, sorted(lat), row)
+                self.assertGreater(lat[0], 0, row)
+                goodput[int(row["window"])] = float(row["goodput_Bps"])
+
+            self.assertGreater(goodput[8], goodput[1], r.stdout)
+
+    def test_bench_amdtp(self):
+        bench = os.path.join(HERE, "bench_amdtp")
+        if not os.path.isfile(os.path.join(HERE, "amdtp_sim")):
+            self.skipTest("amdtp_sim not build")
+
+        r = subprocess.run([bench, "-m", "23 100", "-i", "30000", "-f", "4", "-l", "0 1", "--", "-w", "8"],
+                           stdout = subprocess.PIPE, universal_newlines = True)
+        self.assertEqual(r.returncode, 0, r.stdout)
+
+        rows = list(csv.DictReader(r.stdout.splitlines()))
+        self.assertEqual([(row["mtu"], row["loss_pct"], row["window"]) for row in rows],
+                         [("23", "0.00", "8"), ("23", "1.00", "8"), ("100", "0.00", "8"), ("100", "1.00", "8")])
+
+    def test_bulk_sim(self):
+        sim = os.path.join(HERE, "bulk_sim")
+        if not os.path.isfile(sim):
+            self.skipTest("bulk_sim not build")
+
+        # mode : bytes/s, burst ms (p50), radio ms/s, requests
+        def run(args):
+            r = subprocess.run([sim, "-d", "30"] + args, stdout = subprocess.PIPE, universal_newlines = True)
+            if "-v" in sys.argv:
+                print("\n" + r.stdout)
+            self.assertEqual(r.returncode, 0, r.stdout)
+            self.assertNotIn("FAILED", r.stdout)
+
+            rows = {}
+            for line in r.stdout.splitlines():
+                f = line.split()
+                if f and f[0] in ("idle", "bulk", "auto") and len(f) == 7:
+                    rows[f[0]] = (float(f[1]), float(f[2]), float(f[5]), int(f[6]))
+            self.assertEqual(len(rows), 3, r.stdout)
+            return rows
+
+        # a long burst : much faster than idle, less radio time than bulk all the time,
+        # a bulk and an idle request per burst (every 5 s)
+        rows = run(["-n", "32"])
+        self.assertGreater(rows["auto"][0], 5 * rows["idle"][0], rows)
+        self.assertLess(rows["auto"][1], rows["idle"][1] / 5, rows)
+        self.assertLess(rows["auto"][2], rows["bulk"][2], rows)
+        self.assertEqual(rows["auto"][3], 12, rows)
+
+        # a single packet does not switch, only the idle request after the connection
+        rows = run(["-n", "1"])
+        self.assertEqual(rows["auto"], rows["idle"][:3] + (1,), rows)
+
+        # unless asked from the first packet
+        rows = run(["-n", "1", "-p", "1"])
+        self.assertEqual(rows["auto"][3], 12, rows)
+
+    def test_bridge_sim(self):
+        sim = os.path.join(HERE, "bridge_sim")
+        if not os.path.isfile(sim):
+            self.skipTest("bridge_sim not build")
+
+        for args in ([], ["-e", "10"], ["-k", "1", "-f", "1"]):
+            r = subprocess.run([sim] + args, stdout = subprocess.PIPE, universal_newlines = True)
+            if "-v" in sys.argv:
+                print("\n" + r.stdout)
+            self.assertEqual(r.returncode, 0, r.stdout)
+
+            # mode : chunks/s, result
+            rows = {}
+            for line in r.stdout.splitlines():
+                f = line.split()
+                if f and f[0] == "delay":
+                    rows["delay"] = (float(f[3]), f[-1])
+                elif f and f[0] == "queue":
+                    rows["queue"] = (float(f[1]), f[-1])
+
+            self.assertEqual(rows["queue"][1], "ok", r.stdout)
+
+            # a failed write stalls the delay, the queue tries again
+            if "-e" in args:
+                self.assertEqual(rows["delay"][1], "stalled", r.stdout)
+            else:
+                self.assertEqual(rows["delay"][1], "ok", r.stdout)
+                self.assertGreater(rows["queue"][0], 5 * rows["delay"][0], r.stdout)
+
+    def test_amdtp_multi(self):
+        sim = os.path.join(HERE, "amdtp_multi")
+        if not os.path.isfile(sim):
+            self.skipTest("amdtp_multi not build")
+
+        for args in (["-n", "40"], ["-n", "40", "-l", "0"], ["-c", "8", "-t", "16", "-n", "20"]):
+            r = subprocess.run([sim] + args, stdout = subprocess.PIPE, universal_newlines = True)
+            if "-v" in sys.argv:
+                print("\n" + r.stdout)
+            self.assertEqual(r.returncode, 0, r.stdout)
+
+            # quota : total, client min, client max
+            rows = {}
+            for line in r.stdout.splitlines():
+                f = line.split()
+                if len(f) > 6 and f[1] in ("first", "round"):
+                    rows[int(f[0])] = (float(f[3]), float(f[4]), float(f[6]))
+
+            first, turns = rows[0], rows[AMDTP_CONN_TX_QUOTA]
+            self.assertGreaterEqual(turns[0], first[0], r.stdout)
+            self.assertLess(turns[2] - turns[1], first[2] - first[1], r.stdout)
+
+    def test_lz_bench(self):
+        bench = os.path.join(HERE, "lz_bench")
+        if not os.path.isfile(bench):
+            self.skipTest("lz_bench not build")
+
+        r = subprocess.run([bench], stdout = subprocess.PIPE, universal_newlines = True)
+        if "-v" in sys.argv:
+            print("\n" + r.stdout)
+        self.assertEqual(r.returncode, 0, r.stdout)
+
+class Asyncio(unittest.TestCase):
+    """ amdtpaio.AmdtpClient, frames given to the other side with call_soon() as bleak would """
+
+    def run_with(self, peer_cls, test, **kwargs):
+        async def main():
+            loop = asyncio.get_running_loop()
+            received = []
+            aio = None
+
+            def on_send(data, len):
+                loop.call_soon(aio.notify, None, bytes(data[:len]))
+
+            peer = peer_cls(Received_data_callback = lambda data, len: received.append(bytes(data[:len])),
+                            send_central_callback = on_send)
+
+            async def write(frame):
+                frame = bytes(frame)
+                loop.call_soon(peer.AmdtpReceivePkt, frame, len(frame))
+
+            async with amdtpaio.AmdtpClient(write, **kwargs) as aio:
+                await test(aio, peer, received)
+
+        asyncio.run(main())
+
+    async def peer_send(self, peer, data):
+        # stop-and-wait : the peer takes the next packet after the ACK
+        while peer.AmdtpSendData(data, len(data)) < 0:
+            await asyncio.sleep(0)
+
+    def exchange(self, peer_cls, sizes, mtu = amdtpaio.ATT_DEFAULT_MTU):
+        async def test(aio, peer, received):
+            peer.UpdateMTU(mtu)
+            for n in sizes:
+                data = bytes(payload(n))
+                await aio.send(data)
+                self.assertEqual(received, [data], "size {0}".format(n))
+                received.clear()
+
+                await self.peer_send(peer, data)
+                self.assertEqual(await aio.recv(), data, "size {0}".format(n))
+
+            self.assertEqual(aio.stats["packets_sent"], len(sizes))
+
+        self.run_with(peer_cls, test, mtu = mtu)
+
+    def test_core(self):
+        self.exchange(AmdtpCoreClient, range(1, amdtpaio.AMDTP_MAX_PAYLOAD_SIZE + 1))
+
+    def test_core_mtu(self):
+        self.exchange(AmdtpCoreClient, (1, 100, 197, 512), mtu = 200)
+
+    def test_amdtpc(self):
+        self.exchange(amdtpc.AmdtpClient, (1, 15, 16, 17, 100, 511, 512))
+
+    def test_backpressure(self):
+        async def test(aio, peer, received):
+            packets = [bytes(payload(40, i)) for i in range(5)]
+
+            for data in packets[:3]:
+                await self.peer_send(peer, data)
+
+            # rx_queue full : the ACK of the third is held and the peer can not send
+            for _ in range(50):
+                await asyncio.sleep(0)
+            self.assertEqual(aio.stats["acks_held"], 1)
+            self.assertFalse(peer.AmdtpSendComplete() and peer.AmdtpSendData(packets[3], 40) == 0)
+
+            got = [await aio.recv() for _ in range(3)]
+            for data in packets[3:]:
+                await self.peer_send(peer, data)
+            got += [await aio.recv() for _ in range(2)]
+            self.assertEqual(got, packets)
+
+        self.run_with(AmdtpCoreClient, test, rx_queue = 2)
+
+    def test_timeout(self):
+        async def main():
+            async def lost(frame):
+                pass
+
+            async with amdtpaio.AmdtpClient(lost, timeout = 0.05) as aio:
+                with self.assertRaises(amdtpaio.AmdtpError) as e:
+                    await aio.send(b"\x07")
+                self.assertEqual(e.exception.status, amdtpaio.AMDTP_STATUS_TX_NOT_READY)
+                self.assertEqual(aio.stats["timeouts"], 1)
+
+        asyncio.run(main())
+
+    def test_bench_aio(self):
+        r = subprocess.run([sys.executable, os.path.join(BLEAK, "bench_aio.py"), "-n", "50", "-p", "0"],
+                           stdout = subprocess.PIPE, universal_newlines = True, cwd = BLEAK)
+        if "-v" in sys.argv:
+            print("\n" + r.stdout)
+        self.assertEqual(r.returncode, 0, r.stdout)
+        self.assertIn("amdtpaio.py", r.stdout)
+
+class Gateway(unittest.TestCase):
+
+    KEY = "00112233445566778899aabbccddeeff"
+
+    def setUp(self):
+        self.periph = os.path.join(HERE, "fake_periph")
+        self.gateway = os.path.join(HERE, "gateway_sim")
+        if not os.path.isfile(self.periph) or not os.path.isfile(self.gateway):
+            self.skipTest("fake_periph or gateway_sim not build")
+
+        self.dir = tempfile.mkdtemp()
+        self.sock = os.path.join(self.dir, "periph.sock")
+        self.procs = []
+
+    def tearDown(self):
+        for p in self.procs:
+            p.terminate()
+            p.wait()
+        shutil.rmtree(self.dir)
+
+    def start_periph(self, *args):
+        p = subprocess.Popen([self.periph, "-s", self.sock] + list(args),
+                             stdout = subprocess.DEVNULL)
+        self.procs.append(p)
+
+        for _ in range(100):
+            if os.path.exists(self.sock):
+                return
+            time.sleep(0.02)
+        self.fail("fake_periph did not start")
+
+    def run_gateway(self, *args):
+        r = subprocess.run([self.gateway, "-s", self.sock] + list(args), stdout = subprocess.PIPE,
+                           stderr = subprocess.PIPE, universal_newlines = True, timeout = 60)
+        if "-v" in sys.argv:
+            print("\n" + r.stderr + r.stdout)
+        self.assertEqual(r.returncode, 0, r.stderr + r.stdout)
+
+        # connections records records/s reply-avg max timeouts errors reconnects
+        return [float(x) for x in r.stdout.splitlines()[1].split()]
+
+    def test_json(self):
+        out = os.path.join(self.dir, "records.json")
+        self.start_periph()
+        totals = self.run_gateway("-c", "40", "-t", "3", "-I", "200", "-o", "json:" + out)
+        self.assertEqual(totals[0], 40)
+        self.assertEqual(totals[5:7], [0, 0])
+
+        with open(out) as f:
+            records = [json.loads(line) for line in f]
+
+        self.assertEqual(len(records), totals[1])
+        self.assertEqual(len({r["device"] for r in records}), 40)
+        self.assertEqual({r["type"] for r in records}, {"battery", "tempC", "bme280"})
+
+        for r in records:
+            if r["type"] == "bme280":
+                self.assertEqual(set(r["units"]), {"temperature", "humidity", "pressure", "altitude"}, r)
+
+    def test_csv_loss_key(self):
+        out = os.path.join(self.dir, "records.csv")
+        self.start_periph("-l", "2", "-k", self.KEY)
+        totals = self.run_gateway("-c", "20", "-t", "4", "-I", "100", "-k", self.KEY,
+                                  "-p", "version,adc:3,pin:5,tempF", "-o", "csv:" + out)
+
+        with open(out) as f:
+            rows = list(csv.DictReader(f))
+
+        self.assertEqual(len({r["device"] for r in rows}), 20)
+        self.assertEqual({r["type"] for r in rows}, {"version", "adc", "pin", "tempF"})
+        self.assertGreater(totals[1], 0)
+
+    def test_unix_sink(self):
+        path = os.path.join(self.dir, "sink.sock")
+        listener = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        listener.bind(path)
+        listener.listen(1)
+        listener.settimeout(10)
+
+        self.start_periph()
+        p = subprocess.Popen([self.gateway, "-s", self.sock, "-c", "4", "-t", "2", "-I", "200",
+                              "-o", "unix:" + path], stdout = subprocess.PIPE, universal_newlines = True)
+        conn, _ = listener.accept()
+        data = b""
+        while True:
+            b = conn.recv(65536)
+            if not b:
+                break
+            data += b
+        out = p.communicate()[0]
+        conn.close()
+        listener.close()
+        self.assertEqual(p.returncode, 0, out)
+
+        records = [json.loads(line) for line in data.decode().splitlines()]
+        self.assertEqual(len(records), int(out.splitlines()[1].split()[1]))
+        self.assertEqual(len({r["device"] for r in records}), 4)
+
+    def test_subscribe(self):
+        out = os.path.join(self.dir, "records.json")
+        self.start_periph("-l", "1")
+        totals = self.run_gateway("-c", "20", "-t", "4", "-S", "bme280,battery:50:10", "-o", "json:" + out)
+        polled = self.run_gateway("-c", "20", "-t", "2", "-I", "50", "-p", "bme280,battery")
+
+        with open(out) as f:
+            records = [json.loads(line) for line in f]
+
+        self.assertEqual(len(records), totals[1])
+        self.assertEqual({r["type"] for r in records}, {"telemetry"})
+        self.assertEqual(set(records[0]["units"]), {"battery", "temperature", "humidity", "pressure", "altitude"})
+
+        # 10 samples per packet : far fewer frames per value than a command per value
+        self.assertLess(totals[8] * 3, polled[8])
+
+        # the time of a sample is the arrival of its packet minus its age : 50ms apart on average
+        for device in {r["device"] for r in records}:
+            times = [r["time"] for r in records if r["device"] == device]
+            self.assertGreater(len(times), 20, device)
+            self.assertAlmostEqual((times[-1] - times[0]) / (len(times) - 1), 0.05, delta = 0.01, msg = device)
+
+    def test_subscribe_fields(self):
+        # no BME280 on the server : only the battery, or polled when nothing is left
+        out = os.path.join(self.dir, "records.json")
+        self.start_periph("-B")
+        self.run_gateway("-c", "4", "-t", "2", "-S", "bme280,battery:100:5", "-o", "json:" + out)
+        self.run_gateway("-c", "4", "-t", "2", "-S", "bme280", "-I", "200", "-p", "tempC", "-o", "json:" + out)
+
+        with open(out) as f:
+            records = [json.loads(line) for line in f]
+
+        self.assertEqual({r["type"] for r in records}, {"telemetry", "tempC"})
+        for r in records:
+            if r["type"] == "telemetry":
+                self.assertEqual(set(r["units"]), {"battery"})
+
+if __name__ == "__main__":
+    unittest.main()
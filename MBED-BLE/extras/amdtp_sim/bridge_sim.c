@@ -0,0 +1,400 @@
+/*
+ * bridge_sim.c : the ACK path of the ble_amdtp_arduino client on a host, to
+ * compare the delay(700) before each ACK (version 4.1) with the ACK queue of
+ * amdtp_ackq.c (version 4.2).
+ *
+ * The server sends packets of 512 bytes, stop-and-wait without a timer as
+ * amdtp_server does : each frame (chunk) waits for SEND_READY of the client.
+ * The model of the client :
+ *
+ * - the loop takes one received frame per pass (BLE.poll()) and gives it to
+ *   the core, which asks for the ACK or SEND_READY from within that call.
+ * - a write (TxChar.writeValue()) needs a free ACL buffer of the controller
+ *   (-k) and returns after the ATT write response, the connection event
+ *   after the one that sent the frame. The client does nothing else
+ *   meanwhile. With -e a write fails (the frame is lost).
+ * - delay : AckChar_Write() waits -d ms and then writes, the result of the
+ *   write is not looked at (as 4.1).
+ * - queue : AckChar_Write() puts the frame in amdtp_ackq.c, the loop writes
+ *   it when there is a free buffer and tries again after a failed write.
+ *
+ * Every received packet is compared with what was sent. The server has no
+ * timer, so a lost SEND_READY stops the transfer : "stalled".
+ *
+ * compile with ./make_amdtp_sim, run ./bridge_sim (-h for options)
+ *
+ * paulvha / October 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include "amdtp_core.h"
+#include "amdtp_ackq.h"
+
+#define TICK_US         100         // simulation step
+#define QUEUE_SIZE      64          // max frames in a queue
+#define LIMIT_US        (600ULL * 1000000)  // 10 minutes simulated
+
+typedef struct
+{
+    uint16_t    len;
+    bool        lost;               // a failed write
+    uint8_t     data[ATT_MAX_MTU];
+}
+frame_t;
+
+typedef struct
+{
+    frame_t     frames[QUEUE_SIZE];
+    int         head, count, size;
+}
+queue_t;
+
+typedef struct
+{
+    uint32_t    intervalUs;         // connection interval
+    int         framesPerEvent;     // frames per direction per connection event
+    int         hciBuffers;         // ACL buffers of the client controller
+    uint32_t    delayMs;            // delay before an ACK, 4.1
+    double      writeFail;          // a write of the client fails
+    uint16_t    mtu;
+    int         packets;            // packets of 512 bytes, server to client
+    bool        verbose;
+}
+config_t;
+
+typedef struct
+{
+    amdtpCore_t core;
+    queue_t     tx, rx;
+    int         sent, received, bad;
+    uint64_t    doneAt;             // last packet received by the client
+    uint32_t    chunks;             // data frames received
+}
+side_t;
+
+static config_t cfg = { 30000, 4, 4, 700, 0, ATT_DEFAULT_MTU, 4, false };
+static side_t server, client;
+static amdtpAckq_t ackq;
+static bool useQueue;
+static uint64_t now;
+static uint32_t failSeed;
+static uint32_t writes, writesFailed;
+static uint64_t respondAt;          // the pending write has its response
+static int inFlight;                // frames of the client not sent by the controller
+
+static uint32_t simRandom(uint32_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static bool queuePut(queue_t *q, uint8_t *buf, uint16_t len, bool lost)
+{
+    frame_t *f;
+
+    if (q->count >= q->size) return false;
+
+    f = &q->frames[(q->head + q->count) % QUEUE_SIZE];
+    memcpy(f->data, buf, len);
+    f->len = len;
+    f->lost = lost;
+    q->count++;
+    return true;
+}
+
+static frame_t *queueGet(queue_t *q)
+{
+    frame_t *f;
+
+    if (q->count == 0) return NULL;
+
+    f = &q->frames[q->head];
+    q->head = (q->head + 1) % QUEUE_SIZE;
+    q->count--;
+    return f;
+}
+
+// packet n of the server, the client recreates it to compare
+static void makePayload(uint8_t *buf, int n)
+{
+    uint32_t state = 0x1234 + n * 7919;
+
+    for (int i = 0; i < AMDTP_MAX_PAYLOAD_SIZE; i++) buf[i] = (uint8_t) simRandom(&state);
+}
+
+/*
+ * the world without the client loop : connection events and the server
+ */
+static void tick(void)
+{
+    frame_t *f;
+
+    if (now % cfg.intervalUs == 0)
+    {
+        for (int i = 0; i < cfg.framesPerEvent; i++)
+        {
+            f = queueGet(&server.tx);
+            if (f == NULL) break;
+            if (! queuePut(&client.rx, f->data, f->len, false)) client.bad++;
+        }
+
+        AmdtpCorePump(&server.core);
+
+        // the controller of the client sends, the buffers come back
+        // (Number Of Completed Packets) and the response of the write
+        // arrives on the next event
+        for (int i = 0; i < cfg.framesPerEvent; i++)
+        {
+            f = queueGet(&client.tx);
+            if (f == NULL) break;
+            inFlight--;
+            respondAt = now + cfg.intervalUs;
+            if (! f->lost) AmdtpCoreReceive(&server.core, f->data, f->len);
+        }
+    }
+
+    now += TICK_US;
+}
+
+// TxChar.writeValue() of the client : waits for a buffer and the response
+static bool clientWrite(const uint8_t *buf, uint16_t len)
+{
+    bool lost = simRandom(&failSeed) < cfg.writeFail * 4294967295.0;
+
+    while (inFlight >= cfg.hciBuffers && now < LIMIT_US) tick();
+
+    writes++;
+    if (lost) writesFailed++;
+
+    queuePut(&client.tx, (uint8_t *) buf, len, lost);
+    inFlight++;
+    respondAt = 0;
+
+    while ((respondAt == 0 || now < respondAt) && now < LIMIT_US) tick();
+
+    return ! lost;
+}
+
+/*
+ * callbacks
+ */
+static bool serverSend(void *user, eAmdtpPktType_t type, uint8_t *buf, uint16_t len)
+{
+    (void) user;
+    (void) type;
+
+    return queuePut(&server.tx, buf, len, false);
+}
+
+static void serverSent(void *user, eAmdtpStatus_t status)
+{
+    (void) user;
+
+    if (status != AMDTP_STATUS_SUCCESS) server.bad++;
+    server.sent++;
+}
+
+static void serverReceived(void *user, uint8_t *buf, uint16_t len)
+{
+    (void) user;
+    (void) buf;
+    (void) len;
+}
+
+// AckChar_Write() of the bridge, data frames are not sent by the client here
+static bool clientSend(void *user, eAmdtpPktType_t type, uint8_t *buf, uint16_t len)
+{
+    (void) user;
+    (void) type;
+
+    if (useQueue)
+    {
+        return AmdtpAckqPut(&ackq, buf, len);
+    }
+
+    // version 4.1
+    uint64_t until = now + (uint64_t) cfg.delayMs * 1000;
+
+    while (now < until) tick();
+
+    clientWrite(buf, len);
+    return true;
+}
+
+static void clientReceived(void *user, uint8_t *buf, uint16_t len)
+{
+    uint8_t expect[AMDTP_MAX_PAYLOAD_SIZE];
+    (void) user;
+
+    makePayload(expect, client.received);
+
+    if (len != AMDTP_MAX_PAYLOAD_SIZE || memcmp(buf, expect, len) != 0) client.bad++;
+
+    if (++client.received == cfg.packets) client.doneAt = now;
+}
+
+static uint8_t ackCredits(void *user)
+{
+    (void) user;
+
+    return inFlight < cfg.hciBuffers ? cfg.hciBuffers - inFlight : 0;
+}
+
+static bool ackWrite(void *user, const uint8_t *buf, uint8_t len)
+{
+    (void) user;
+
+    return clientWrite(buf, len);
+}
+
+static void sideInit(side_t *s, amdtpCoreCallbacks_t *cb)
+{
+    memset(s, 0, sizeof(side_t));
+    s->tx.size = QUEUE_SIZE;
+    s->rx.size = QUEUE_SIZE;
+
+    AmdtpCoreSetCallbacks(&s->core, cb);
+    AmdtpCoreInit(&s->core);
+    AmdtpCoreSetMtu(&s->core, cfg.mtu);
+}
+
+// one transfer, the goodput in bytes per second
+static double simulate(bool queue)
+{
+    amdtpCoreCallbacks_t cb;
+    uint8_t payload[AMDTP_MAX_PAYLOAD_SIZE];
+    frame_t *f;
+
+    now = 0;
+    useQueue = queue;
+    failSeed = 0x2545F491;
+    writes = writesFailed = 0;
+    inFlight = 0;
+
+    // no timer : stop-and-wait, as the Arduino server and client
+    memset(&cb, 0, sizeof(cb));
+    cb.send = serverSend;
+    cb.sent = serverSent;
+    cb.received = serverReceived;
+    sideInit(&server, &cb);
+
+    memset(&cb, 0, sizeof(cb));
+    cb.send = clientSend;
+    cb.received = clientReceived;
+    sideInit(&client, &cb);
+
+    AmdtpAckqInit(&ackq, ackCredits, ackWrite, NULL);
+
+    while (now < LIMIT_US && client.received < cfg.packets)
+    {
+        if (server.core.txState == AMDTP_STATE_TX_IDLE && server.sent < cfg.packets)
+        {
+            makePayload(payload, server.sent);
+            AmdtpCoreSend(&server.core, payload, AMDTP_MAX_PAYLOAD_SIZE);
+        }
+
+        // loop() of the client : BLE.poll() handles one frame
+        f = queueGet(&client.rx);
+
+        if (f)
+        {
+            client.chunks++;
+            AmdtpCoreReceive(&client.core, f->data, f->len);
+        }
+
+        if (useQueue && AmdtpAckqPump(&ackq, (uint32_t) (now / 1000)))
+        {
+            AmdtpCorePump(&client.core);
+        }
+
+        tick();
+    }
+
+    if (! client.doneAt) return 0;
+
+    return (double) cfg.packets * AMDTP_MAX_PAYLOAD_SIZE * 1000000 / client.doneAt;
+}
+
+static void usage(const char *name)
+{
+    printf("%s [options]\n"
+           "  -i us    connection interval (30000)\n"
+           "  -f n     frames per connection event per direction (4)\n"
+           "  -k n     ACL buffers of the client controller (4)\n"
+           "  -d ms    delay before each ACK of version 4.1 (700)\n"
+           "  -e pct   writes of the client that fail in %% (0)\n"
+           "  -m mtu   ATT MTU (23)\n"
+           "  -n n     packets of 512 bytes, server to client (4)\n"
+           "  -v       show the ACK queue statistics\n", name);
+}
+
+int main(int argc, char *argv[])
+{
+    int opt, failed = 0;
+
+    while ((opt = getopt(argc, argv, "i:f:k:d:e:m:n:vh")) != -1)
+    {
+        switch (opt)
+        {
+            case 'i': cfg.intervalUs = atoi(optarg); break;
+            case 'f': cfg.framesPerEvent = atoi(optarg); break;
+            case 'k': cfg.hciBuffers = atoi(optarg); break;
+            case 'd': cfg.delayMs = atoi(optarg); break;
+            case 'e': cfg.writeFail = atof(optarg) / 100; break;
+            case 'm': cfg.mtu = atoi(optarg); break;
+            case 'n': cfg.packets = atoi(optarg); break;
+            case 'v': cfg.verbose = true; break;
+            default : usage(argv[0]); return 0;
+        }
+    }
+
+    cfg.intervalUs -= cfg.intervalUs % TICK_US;
+    if (cfg.intervalUs == 0 || cfg.framesPerEvent < 1 || cfg.hciBuffers < 1 || cfg.hciBuffers > QUEUE_SIZE ||
+        cfg.mtu < AMDTP_MIN_MTU || cfg.mtu > ATT_MAX_MTU || cfg.packets < 1)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    printf("interval %u ms, %d frames / event, %d ACL buffers, write fails %.1f %%, MTU %u, "
+           "%d x %d bytes server to client\n\n",
+           cfg.intervalUs / 1000, cfg.framesPerEvent, cfg.hciBuffers, cfg.writeFail * 100, cfg.mtu,
+           cfg.packets, AMDTP_MAX_PAYLOAD_SIZE);
+
+    printf("ACK            chunks/s  bytes/s  ms/packet  writes  failed  result\n");
+
+    for (int queue = 0; queue < 2; queue++)
+    {
+        double goodput = simulate(queue);
+        double secs = (client.doneAt ? client.doneAt : now) / 1000000.0;
+        bool ok = client.received == cfg.packets && client.bad == 0 && server.bad == 0;
+        bool stall = ! ok && client.bad == 0 && server.bad == 0;
+        char mode[20];
+
+        if (queue)
+            snprintf(mode, sizeof(mode), "queue");
+        else
+            snprintf(mode, sizeof(mode), "delay %u ms", cfg.delayMs);
+
+        printf("%-14s %8.1f  %7.0f  %9.0f  %6u  %6u  %s\n", mode, client.chunks / secs, goodput,
+               goodput > 0 ? AMDTP_MAX_PAYLOAD_SIZE * 1000 / goodput : 0, writes, writesFailed,
+               ok ? "ok" : stall ? "stalled" : "FAILED");
+
+        if (queue && cfg.verbose)
+        {
+            printf("               sent %u, no credit %u, retries %u, dropped %u, queue full %u\n",
+                   ackq.stats.sent, ackq.stats.noCredit, ackq.stats.retries, ackq.stats.dropped,
+                   ackq.stats.full);
+        }
+
+        // 4.1 can not recover a failed write
+        if (! ok && ! (stall && ! queue)) failed++;
+    }
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,502 @@
+/*
+ * bulk_sim.c : the AMDTP bulk mode (src/amdtp/amdtp_link.c) over a simulated
+ * BLE link whose connection parameters change, to show what it gains in
+ * transfer time and what it costs in radio time against fixed parameters.
+ *
+ * The server (peripheral) sends a burst of packets of 512 bytes every period,
+ * the client (central) only acknowledges. Three runs :
+ *
+ *   idle  the idle parameters all the time (100ms, latency 4, 1M, 27 bytes)
+ *   bulk  the bulk parameters all the time (7.5ms, 2M, 251 bytes)
+ *   auto  amdtp_link.c on the server : bulk from the second packet of a
+ *         burst (-p), idle 2 seconds after it
+ *
+ * The link model, per connection event :
+ *
+ * - central and peripheral take turns to send a link layer packet (an empty
+ *   one when they have nothing), 150us apart, until neither has data, the
+ *   event is used up (the interval minus 1.25ms) or each sent -f packets.
+ * - an AMDTP frame is an ATT notification : 3 bytes ATT and 4 bytes L2CAP
+ *   header in front, cut in link layer packets of the data length. The air
+ *   time of a packet is (10 + payload) bytes at 1M, (11 + payload) at 2M.
+ * - with latency the peripheral skips events while it has nothing to send
+ *   (then the frames of the central wait as well).
+ * - a parameter request is used -u connection events later (the L2CAP
+ *   request, the answer of the central and the instant of the link layer
+ *   procedure), a new request replaces one that is waiting.
+ *
+ * The radio time is that of the peripheral : per event it listens, 300us to
+ * wake up and the exchanges. It is a rough guide for the power, the bytes/s
+ * and the latency of a burst (first packet given to the core until the client
+ * has the last one) are from the simulation.
+ *
+ * compile with ./make_amdtp_sim, run ./bulk_sim (-h for options)
+ *
+ * paulvha / October 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include "amdtp_core.h"
+#include "amdtp_link.h"
+
+#define TICK_US         100         // simulation step
+#define QUEUE_SIZE      64          // max frames in a queue
+#define START_US        500000      // negotiation is done before the sketch sends
+#define MAX_BURSTS      1024
+#define WAKE_US         300         // peripheral : wake up and listen per event
+#define IFS_US          150         // between two link layer packets
+#define GUARD_US        1250        // end of the event before the next one
+#define ATT_L2CAP_HDR   7           // notification : ATT 3 + L2CAP 4
+
+typedef struct
+{
+    uint16_t    len;
+    uint16_t    sent;               // bytes (with ATT_L2CAP_HDR) in link layer packets so far
+    uint8_t     data[ATT_MAX_MTU];
+}
+frame_t;
+
+typedef struct
+{
+    frame_t     frames[QUEUE_SIZE];
+    int         head, count, size;
+}
+queue_t;
+
+typedef struct
+{
+    int         packets;            // per burst
+    uint32_t    periodMs;           // between the bursts
+    uint32_t    durationMs;
+    uint16_t    mtu;
+    int         txQueue;
+    int         perEvent;           // link layer packets per direction per event
+    int         updateEvents;       // a request is used this many events later
+    int         bulkPackets;        // amdtp_link.c : packets in a row before bulk
+    amdtpLinkParams_t bulk, idle;
+    bool        verbose;
+}
+config_t;
+
+struct side;
+
+typedef struct side
+{
+    const char  *name;
+    amdtpCore_t core;
+    queue_t     tx;
+    struct side *peer;
+    uint64_t    timerAt;
+
+    int         sent, received, bad;
+    uint8_t     payload[AMDTP_MAX_PAYLOAD_SIZE];
+}
+side_t;
+
+typedef struct
+{
+    const char  *name;
+    amdtpLinkParams_t now;          // in use
+    amdtpLinkParams_t next;         // requested
+    uint64_t    nextAt;             // 0 : none waiting
+    int         skipped;            // events skipped by the peripheral
+
+    uint32_t    events, listened;
+    uint64_t    radioUs;
+    uint32_t    requests;
+
+    int         bursts;
+    uint64_t    burstAt[MAX_BURSTS];
+    uint32_t    latencyUs[MAX_BURSTS];
+    uint64_t    burstUs;            // sum of the latencies
+    int         done;
+}
+link_t;
+
+static uint64_t now;
+static config_t cfg;
+static side_t server, client;
+static link_t link;
+static amdtpLink_t policy;
+
+static bool queuePut(queue_t *q, uint8_t *buf, uint16_t len)
+{
+    frame_t *f;
+
+    if (q->count >= q->size) return false;
+
+    f = &q->frames[(q->head + q->count) % QUEUE_SIZE];
+    memcpy(f->data, buf, len);
+    f->len = len;
+    f->sent = 0;
+    q->count++;
+    return true;
+}
+
+static frame_t *queuePeek(queue_t *q)
+{
+    return q->count ? &q->frames[q->head] : NULL;
+}
+
+static void queueDrop(queue_t *q)
+{
+    q->head = (q->head + 1) % QUEUE_SIZE;
+    q->count--;
+}
+
+// packet n of the server, the client compares
+static void makePayload(uint8_t *buf, int n)
+{
+    uint32_t state = 0x1234 + n * 7919;
+
+    for (int i = 0; i < AMDTP_MAX_PAYLOAD_SIZE; i++)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        buf[i] = (uint8_t) state;
+    }
+}
+
+/*
+ * callbacks from the core
+ */
+static bool cbSend(void *user, eAmdtpPktType_t type, uint8_t *buf, uint16_t len)
+{
+    (void) type;
+    return queuePut(&((side_t *) user)->tx, buf, len);
+}
+
+static void cbReceived(void *user, uint8_t *buf, uint16_t len)
+{
+    side_t *s = (side_t *) user;
+    uint8_t expect[AMDTP_MAX_PAYLOAD_SIZE];
+    int burst = s->received / cfg.packets;
+
+    makePayload(expect, s->received);
+    if (len != AMDTP_MAX_PAYLOAD_SIZE || memcmp(buf, expect, len) != 0) s->bad++;
+
+    // last packet of a burst
+    if (++s->received % cfg.packets == 0 && burst < MAX_BURSTS)
+    {
+        link.latencyUs[burst] = (uint32_t) (now - link.burstAt[burst]);
+        link.burstUs += link.latencyUs[burst];
+        link.done++;
+    }
+}
+
+static void cbSent(void *user, eAmdtpStatus_t status)
+{
+    side_t *s = (side_t *) user;
+
+    if (status != AMDTP_STATUS_SUCCESS) s->bad++;
+    s->sent++;
+}
+
+static void cbTimer(void *user, uint32_t ms)
+{
+    side_t *s = (side_t *) user;
+
+    s->timerAt = ms ? now + (uint64_t) ms * 1000 : 0;
+}
+
+// amdtp_link.c on the server : the central takes the shortest interval asked
+static void cbRequest(void *user, const amdtpLinkParams_t *params, bool bulk)
+{
+    link_t *l = (link_t *) user;
+
+    l->next = *params;
+    l->nextAt = now + (uint64_t) cfg.updateEvents * l->now.intervalMin * 1250;
+    l->requests++;
+
+    if (cfg.verbose)
+    {
+        printf("  %8.3f s  ask %s : %.2f ms, latency %u, %uM, %u bytes\n", now / 1e6, bulk ? "bulk" : "idle",
+               params->intervalMin * 1.25, params->latency, params->phy, params->dataLength);
+    }
+}
+
+static void sideInit(side_t *s, const char *name, side_t *peer)
+{
+    amdtpCoreCallbacks_t cb;
+
+    memset(&cb, 0, sizeof(cb));
+    cb.send = cbSend;
+    cb.received = cbReceived;
+    cb.sent = cbSent;
+    cb.timer = cbTimer;
+    cb.user = s;
+
+    memset(s, 0, sizeof(side_t));
+    s->name = name;
+    s->peer = peer;
+    s->tx.size = cfg.txQueue;
+
+    AmdtpCoreSetCallbacks(&s->core, &cb);
+    AmdtpCoreInit(&s->core);
+    AmdtpCoreSetMtu(&s->core, cfg.mtu);
+    AmdtpCoreSetWindow(&s->core, AMDTP_WINDOW_DEFAULT);
+}
+
+static uint32_t airUs(uint16_t payload)
+{
+    return link.now.phy == AMDTP_LINK_PHY_2M ? (11 + payload) * 4 : (10 + payload) * 8;
+}
+
+// the next link layer packet of a side, 0 bytes is an empty packet
+static uint16_t llPacket(side_t *from, side_t *to)
+{
+    frame_t *f = queuePeek(&from->tx);
+    uint16_t n;
+
+    if (f == NULL) return 0;
+
+    n = f->len + ATT_L2CAP_HDR - f->sent;
+    if (n > link.now.dataLength) n = link.now.dataLength;
+    f->sent += n;
+
+    // the last part : the frame is complete at the receiver
+    if (f->sent == f->len + ATT_L2CAP_HDR)
+    {
+        AmdtpCoreReceive(&to->core, f->data, f->len);
+        queueDrop(&from->tx);
+    }
+
+    return n;
+}
+
+static void connectionEvent(void)
+{
+    uint64_t budget = (uint64_t) link.now.intervalMin * 1250 - GUARD_US;
+    uint64_t used = 0;
+    int n = 0;
+
+    link.events++;
+
+    // the peripheral sleeps through the event when it has nothing to say
+    if (server.tx.count == 0 && link.skipped < link.now.latency)
+    {
+        link.skipped++;
+        return;
+    }
+
+    link.skipped = 0;
+    link.listened++;
+
+    do
+    {
+        bool more = client.tx.count || server.tx.count;
+        uint16_t c = llPacket(&client, &server);
+        uint16_t p = llPacket(&server, &client);
+
+        used += airUs(c) + airUs(p) + 2 * IFS_US;
+        n++;
+
+        if (! more) break;
+    }
+    while (used + airUs(link.now.dataLength) * 2 + 2 * IFS_US <= budget && n < cfg.perEvent);
+
+    link.radioUs += WAKE_US + used;
+
+    // room in the stacks again
+    AmdtpCorePump(&server.core);
+    AmdtpCorePump(&client.core);
+}
+
+static void sideRun(side_t *s)
+{
+    if (s->timerAt && now >= s->timerAt)
+    {
+        s->timerAt = 0;
+        AmdtpCoreTimeout(&s->core);
+    }
+}
+
+// the sketch : a burst every period, the next packet when the core is free
+static void serverSend(void)
+{
+    int burst;
+
+    // after the window negotiation, that waits for the peripheral to listen
+    if (now < START_US || server.core.window == 0 || server.core.txState != AMDTP_STATE_TX_IDLE) return;
+
+    burst = server.sent / cfg.packets;
+    if (burst >= MAX_BURSTS || now < START_US + (uint64_t) burst * cfg.periodMs * 1000) return;
+
+    // the next burst starts when its time comes, not when the previous one ended
+    if (server.sent % cfg.packets == 0)
+    {
+        if (server.sent != client.received) return;     // previous burst not delivered yet
+        link.burstAt[burst] = now;
+        link.bursts = burst + 1;
+    }
+
+    makePayload(server.payload, server.sent);
+    AmdtpCoreSend(&server.core, server.payload, AMDTP_MAX_PAYLOAD_SIZE);
+}
+
+static void simulate(const char *name, const amdtpLinkParams_t *start, bool bulkMode)
+{
+    uint64_t limit = START_US + (uint64_t) cfg.durationMs * 1000;
+    uint64_t nextEvent = 0;
+
+    memset(&link, 0, sizeof(link));
+    link.name = name;
+    link.now = *start;
+    now = 0;
+
+    sideInit(&server, "server", &client);
+    sideInit(&client, "client", &server);
+    AmdtpCoreNegotiate(&client.core);
+
+    AmdtpLinkInit(&policy, cbRequest, &link);
+    AmdtpLinkSetParams(&policy, &cfg.bulk, &cfg.idle, AMDTP_LINK_IDLE_MS, cfg.bulkPackets);
+    AmdtpLinkReset(&policy, 0);
+
+    if (cfg.verbose) printf("%s\n", name);
+
+    while (now < limit)
+    {
+        if (link.nextAt && now >= link.nextAt)
+        {
+            link.now = link.next;
+            link.nextAt = 0;
+        }
+
+        if (now >= nextEvent)
+        {
+            connectionEvent();
+            nextEvent = now + (uint64_t) link.now.intervalMin * 1250;
+        }
+
+        sideRun(&server);
+        sideRun(&client);
+        serverSend();
+
+        if (bulkMode && now % 1000 == 0) AmdtpLinkUpdate(&policy, &server.core, (uint32_t) (now / 1000));
+
+        now += TICK_US;
+    }
+}
+
+static int compareU32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+
+    return x < y ? -1 : x > y;
+}
+
+// nearest rank percentile of the burst latencies in ms, sorts them
+static double percentile(int pct)
+{
+    int rank;
+
+    if (link.done == 0) return 0;
+
+    qsort(link.latencyUs, link.done, sizeof(uint32_t), compareU32);
+    rank = (link.done * pct + 99) / 100;
+    if (rank < 1) rank = 1;
+
+    return link.latencyUs[rank - 1] / 1000.0;
+}
+
+static bool report(void)
+{
+    double seconds = cfg.durationMs / 1000.0;
+    double bytes = (double) link.done * cfg.packets * AMDTP_MAX_PAYLOAD_SIZE;
+    bool ok = server.bad == 0 && client.bad == 0 && link.done > 0 && link.done >= link.bursts - 1;   // the last can run
+
+    printf("%-5s  %8.0f  %8.0f  %8.0f  %8.1f  %10.1f  %8u%s\n", link.name,
+           link.burstUs ? bytes * 1e6 / link.burstUs : 0, percentile(50), percentile(100),
+           link.listened / seconds, link.radioUs / 1000.0 / seconds, link.requests, ok ? "" : "  FAILED");
+
+    return ok;
+}
+
+static void usage(const char *name)
+{
+    printf("%s [options]\n"
+           "  -n n     packets of 512 bytes per burst (8)\n"
+           "  -e ms    time between the bursts (5000)\n"
+           "  -d s     seconds to run (60)\n"
+           "  -m mtu   ATT MTU (200)\n"
+           "  -t n     transmit queue in frames (8)\n"
+           "  -f n     link layer packets per direction per event (8)\n"
+           "  -u n     connection events before a request is used (6)\n"
+           "  -p n     auto : packets in a row before bulk is asked (2)\n"
+           "  -b ms    bulk connection interval (7.5)\n"
+           "  -i ms    idle connection interval (100)\n"
+           "  -L n     idle latency (4)\n"
+           "  -1       bulk stays at the 1M PHY\n"
+           "  -v       show the requests\n", name);
+}
+
+int main(int argc, char *argv[])
+{
+    static const amdtpLinkParams_t bulk = AMDTP_LINK_BULK_DEFAULT, idle = AMDTP_LINK_IDLE_DEFAULT;
+    int opt, failed = 0;
+
+    cfg.packets = 8;
+    cfg.periodMs = 5000;
+    cfg.durationMs = 60000;
+    cfg.mtu = ATT_MAX_MTU;
+    cfg.txQueue = 8;
+    cfg.perEvent = 8;
+    cfg.updateEvents = 6;
+    cfg.bulkPackets = AMDTP_LINK_BULK_PACKETS;
+    cfg.bulk = bulk;
+    cfg.idle = idle;
+
+    while ((opt = getopt(argc, argv, "n:e:d:m:t:f:u:p:b:i:L:1vh")) != -1)
+    {
+        switch (opt)
+        {
+            case 'n': cfg.packets = atoi(optarg); break;
+            case 'e': cfg.periodMs = atoi(optarg); break;
+            case 'd': cfg.durationMs = atoi(optarg) * 1000; break;
+            case 'm': cfg.mtu = atoi(optarg); break;
+            case 't': cfg.txQueue = atoi(optarg); break;
+            case 'f': cfg.perEvent = atoi(optarg); break;
+            case 'u': cfg.updateEvents = atoi(optarg); break;
+            case 'p': cfg.bulkPackets = atoi(optarg); break;
+            case 'b': cfg.bulk.intervalMin = cfg.bulk.intervalMax = (uint16_t) (atof(optarg) / 1.25 + 0.5); break;
+            case 'i': cfg.idle.intervalMin = cfg.idle.intervalMax = (uint16_t) (atof(optarg) / 1.25 + 0.5); break;
+            case 'L': cfg.idle.latency = atoi(optarg); break;
+            case '1': cfg.bulk.phy = AMDTP_LINK_PHY_1M; break;
+            case 'v': cfg.verbose = true; break;
+            default : usage(argv[0]); return 0;
+        }
+    }
+
+    if (cfg.packets < 1 || cfg.periodMs < 1 || cfg.durationMs < cfg.periodMs || cfg.mtu < ATT_DEFAULT_MTU ||
+        cfg.mtu > ATT_MAX_MTU || cfg.txQueue < 1 || cfg.txQueue > QUEUE_SIZE || cfg.perEvent < 1 ||
+        cfg.bulk.intervalMin < 6 || cfg.idle.intervalMin < 6 || cfg.updateEvents < 0 || cfg.bulkPackets < 1 ||
+        cfg.bulkPackets > 255)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    printf("%d x %d bytes every %u ms for %u s, MTU %u, %d packets / event, request used after %d events\n"
+           "bulk %.2f ms %uM %u bytes, idle %.2f ms latency %u %uM %u bytes\n\n",
+           cfg.packets, AMDTP_MAX_PAYLOAD_SIZE, cfg.periodMs, cfg.durationMs / 1000, cfg.mtu, cfg.perEvent,
+           cfg.updateEvents, cfg.bulk.intervalMin * 1.25, cfg.bulk.phy, cfg.bulk.dataLength,
+           cfg.idle.intervalMin * 1.25, cfg.idle.latency, cfg.idle.phy, cfg.idle.dataLength);
+
+    printf("mode    bytes/s  burst ms    max ms  events/s  radio ms/s  requests\n");
+
+    simulate("idle", &cfg.idle, false);
+    failed += ! report();
+
+    simulate("bulk", &cfg.bulk, false);
+    failed += ! report();
+
+    // starts as the others at the idle parameters
+    simulate("auto", &cfg.idle, true);
+    failed += ! report();
+
+    return failed ? 1 : 0;
+}
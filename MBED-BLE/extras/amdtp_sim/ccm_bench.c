@@ -0,0 +1,160 @@
+/*
+ * ccm_bench.c : time of the AES-128-CCM of amdtp_ccm.c per AMDTP packet, from
+ * 20 bytes (one frame on the default MTU) to 512 bytes (a full packet), on a
+ * host.
+ *
+ * It first checks the AES block with FIPS-197 (appendix C.1) and CCM with
+ * packet vector #1 of RFC 3610, and that a changed byte is refused.
+ *
+ * Per size :
+ *   seal     encrypt + MIC, as the core does for each packet sent
+ *   open     decrypt + check the MIC
+ *   +key     seal with a new key schedule each packet, what the precomputed
+ *            session key schedule saves
+ *
+ * On the Apollo3 (Cortex-M4, 48MHz) expect roughly 50 - 100x these host times.
+ *
+ * compile with ./make_amdtp_sim, run ./ccm_bench
+ *
+ * paulvha / October 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include "amdtp_ccm.h"
+
+#define MAX_SIZE    512
+#define MIC_SIZE    4
+#define BENCH_BYTES (16 * 1024 * 1024)    // bytes to handle per size
+
+static uint8_t buf[MAX_SIZE + MIC_SIZE];
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static bool check(void)
+{
+    static const uint8_t aesOut[16] = {
+        0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30,
+        0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a };
+    static const uint8_t nonce[AMDTP_CCM_NONCE_SIZE] = {
+        0x00, 0x00, 0x00, 0x03, 0x02, 0x01, 0x00, 0xa0, 0xa1, 0xa2, 0xa3, 0xa4, 0xa5 };
+    static const uint8_t ccmOut[23 + 8] = {
+        0x58, 0x8c, 0x97, 0x9a, 0x61, 0xc6, 0x63, 0xd2, 0xf0, 0x66, 0xd0, 0xc2,
+        0xc0, 0xf9, 0x89, 0x80, 0x6d, 0x5f, 0x6b, 0x61, 0xda, 0xc3, 0x84,
+        0x17, 0xe8, 0xd1, 0x2c, 0xfd, 0xf9, 0x26, 0xe0 };
+    amdtpCcmKey_t ctx;
+    uint8_t key[16], block[16], aad[8], data[23 + 8];
+    int i;
+
+    for (i = 0; i < 16; i++)
+    {
+        key[i] = i;
+        block[i] = i * 0x11;
+    }
+
+    AmdtpCcmSetKey(&ctx, key);
+    AmdtpCcmBlock(&ctx, block, block);
+
+    if (memcmp(block, aesOut, 16) != 0) {
+        printf("AES FIPS-197 failed\n");
+        return false;
+    }
+
+    for (i = 0; i < 16; i++) key[i] = 0xc0 + i;
+    for (i = 0; i < 8; i++) aad[i] = i;
+    for (i = 0; i < 23; i++) data[i] = 8 + i;
+
+    AmdtpCcmSetKey(&ctx, key);
+    AmdtpCcmEncrypt(&ctx, nonce, aad, 8, data, 23, &data[23], 8);
+
+    if (memcmp(data, ccmOut, sizeof(ccmOut)) != 0) {
+        printf("CCM RFC 3610 packet vector #1 failed\n");
+        return false;
+    }
+
+    if (! AmdtpCcmDecrypt(&ctx, nonce, aad, 8, data, 23, &data[23], 8) || data[0] != 8 || data[22] != 30) {
+        printf("CCM decrypt failed\n");
+        return false;
+    }
+
+    AmdtpCcmEncrypt(&ctx, nonce, aad, 8, data, 23, &data[23], 8);
+    data[5] ^= 1;
+
+    if (AmdtpCcmDecrypt(&ctx, nonce, aad, 8, data, 23, &data[23], 8)) {
+        printf("CCM accepted a changed byte\n");
+        return false;
+    }
+
+    return true;
+}
+
+int main(void)
+{
+    static const uint16_t sizes[] = {20, 64, 128, 244, 512};
+    amdtpCcmKey_t ctx;
+    uint8_t key[AMDTP_CCM_KEY_SIZE], nonce[AMDTP_CCM_NONCE_SIZE] = {0}, aad = 0;
+    uint32_t i, n, loops, bad = 0;
+    double t, seal, open, rekey;
+
+    if (! check()) return 1;
+
+    for (i = 0; i < sizeof(key); i++) key[i] = rand();
+    for (i = 0; i < sizeof(buf); i++) buf[i] = rand();
+
+    AmdtpCcmSetKey(&ctx, key);
+
+    printf("AES-128-CCM, MIC %d   seal us  open us   +key us  MB/s seal\n", MIC_SIZE);
+
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        loops = BENCH_BYTES / sizes[i];
+
+        t = now();
+        for (n = 0; n < loops; n++)
+        {
+            nonce[0] = n;
+            AmdtpCcmEncrypt(&ctx, nonce, &aad, 1, buf, sizes[i], &buf[sizes[i]], MIC_SIZE);
+        }
+        seal = (now() - t) / loops * 1e6;
+
+        // the same packet over and over, so each one is correct
+        nonce[0] = 1;
+        AmdtpCcmEncrypt(&ctx, nonce, &aad, 1, buf, sizes[i], &buf[sizes[i]], MIC_SIZE);
+
+        t = now();
+        for (n = 0; n < loops; n++)
+        {
+            if (! AmdtpCcmDecrypt(&ctx, nonce, &aad, 1, buf, sizes[i], &buf[sizes[i]], MIC_SIZE)) bad++;
+            AmdtpCcmEncrypt(&ctx, nonce, &aad, 1, buf, sizes[i], &buf[sizes[i]], MIC_SIZE);
+        }
+        open = (now() - t) / loops * 1e6 - seal;
+
+        t = now();
+        for (n = 0; n < loops; n++)
+        {
+            key[0] = n;
+            AmdtpCcmSetKey(&ctx, key);
+            AmdtpCcmEncrypt(&ctx, nonce, &aad, 1, buf, sizes[i], &buf[sizes[i]], MIC_SIZE);
+        }
+        rekey = (now() - t) / loops * 1e6;
+
+        AmdtpCcmSetKey(&ctx, key);
+
+        printf("%6u bytes          %7.2f  %7.2f   %7.2f  %9.0f\n", sizes[i], seal, open, rekey,
+               sizes[i] / seal);
+    }
+
+    if (bad) printf("%u packets not accepted\n", bad);
+
+    return bad != 0;
+}
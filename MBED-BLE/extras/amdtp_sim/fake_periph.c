@@ -0,0 +1,612 @@
+/*
+ * fake_periph.c : amdtp servers as a local process, for the gateway mode of
+ * amdtc (ble_amdtp_raspPi/amdtc) on a Linux box without radios.
+ *
+ * Listens on a Unix stream socket, each connection is one server with its own
+ * AMDTP core that answers the commands of amdtp_server (HELLO, battery,
+ * temperature, BME280, ADC, pin, version) with made up values. SUBSCRIBE starts
+ * the telemetry of amdtp_server 4.2 : a batch of samples (amdtp_tlm.c) is pushed
+ * when it has the samples asked for, the timestamps are those of the interval.
+ * The messages on
+ * the socket are those of the sim link in amdtc_gw.h : after connect the MTU
+ * exchange, then one AMDTP frame per message.
+ *
+ * The link is not a socket at full speed : the frames of each connection are
+ * taken and given per connection event (-i), at most -f frames per direction,
+ * and -l loses frames both ways, so the AMDTP cores have the same work as over
+ * Bluetooth.
+ *
+ *  ./fake_periph -s /tmp/fake_periph.sock &
+ *  ./gateway_sim -s /tmp/fake_periph.sock -c 40     (or amdtc --gateway with sim: lines)
+ *
+ * compile with ./make_amdtp_sim, ./fake_periph -h for the options
+ *
+ * paulvha / October 2026
+ */
+
+#define _GNU_SOURCE             // accept4()
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <getopt.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "amdtp_core.h"
+#include "amdtp_tlm.h"
+#include "amdtc_cmd.h"
+#include "amdtc_gw.h"
+
+#define QUEUE_SIZE      64          // frames per direction per connection
+#define REPLY_SIZE      40
+
+typedef struct
+{
+    uint8_t     len;
+    uint8_t     data[ATT_MAX_MTU];
+}
+frame_t;
+
+typedef struct
+{
+    frame_t     frames[QUEUE_SIZE];
+    int         head, count;
+}
+queue_t;
+
+typedef struct
+{
+    int         fd;                 // -1 : free
+    int         index;              // for the values
+    amdtpCore_t core;
+    uint64_t    coreTimerAt;
+    queue_t     tx, rx;             // to and from the gateway
+    uint8_t     in[GW_SIM_MSG_SIZE * 2];
+    uint16_t    inLen;
+    uint8_t     reply[REPLY_SIZE];
+    uint16_t    replyLen;           // waits for the core, 0 if none
+    uint32_t    requests;
+
+    uint8_t     tlmFields;          // 0 : not subscribed
+    uint16_t    tlmIntervalMs;
+    uint8_t     tlmSamples;
+    uint64_t    tlmNext;            // time of the next sample
+    uint32_t    tlmCount;           // samples taken
+    uint32_t    tlmMissed;          // not taken, the batch was not sent yet
+    bool        tlmFull;            // the batch waits for the core
+    bool        tlmHeld;            // tlmSample waits for room in the batch
+    amdtpTlmSample_t tlmSample;
+    amdtpTlmEnc_t tlmEnc;
+    uint8_t     tlmBuf[AMDTP_TLM_MAX_SIZE + 2];
+}
+periph_t;
+
+typedef struct
+{
+    const char  *path;
+    uint16_t    mtu;
+    uint32_t    intervalMs;
+    int         framesPerEvent;
+    double      loss;
+    int         maxConn;
+    bool        keySet;
+    uint8_t     key[AMDTP_CCM_KEY_SIZE];
+    bool        noBme;
+    bool        verbose;
+}
+config_t;
+
+static config_t cfg = { "/tmp/fake_periph.sock", ATT_MAX_MTU, 30, 4, 0, 64, false, {0}, false, false };
+static periph_t *periphs;
+static int epfd;
+static uint64_t now;
+static uint32_t lossSeed = 0x5eed;
+static int accepted;
+static volatile sig_atomic_t stop;
+
+static uint64_t now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static uint32_t simRandom(uint32_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static bool lost(void)
+{
+    return cfg.loss > 0 && simRandom(&lossSeed) < cfg.loss * 4294967295.0;
+}
+
+static bool queuePut(queue_t *q, const uint8_t *buf, uint16_t len)
+{
+    frame_t *f;
+
+    if (q->count >= QUEUE_SIZE || len > ATT_MAX_MTU) return false;
+
+    f = &q->frames[(q->head + q->count) % QUEUE_SIZE];
+    memcpy(f->data, buf, len);
+    f->len = len;
+    q->count++;
+    return true;
+}
+
+static frame_t *queueGet(queue_t *q)
+{
+    frame_t *f;
+
+    if (q->count == 0) return NULL;
+
+    f = &q->frames[q->head];
+    q->head = (q->head + 1) % QUEUE_SIZE;
+    q->count--;
+    return f;
+}
+
+/*
+ * the values of server p, float_to_byte() of amdtp_server
+ */
+static uint8_t *put_float(uint8_t *p, float value)
+{
+    union { uint8_t array[4]; float value; } conv;
+
+    conv.value = value;
+    for (int i = 0; i < 4; i++) *p++ = conv.array[3-i];
+    return p;
+}
+
+/*
+ * telemetry, as telemetry_subscribe() .. of amdtp_server
+ */
+static void tlm_subscribe(periph_t *p, const uint8_t *data, uint16_t len)
+{
+    uint8_t fields = 0, samples = 1;
+    uint16_t interval = 1000;
+
+    AmdtpTlmGetSubscribe(data, len, &fields, &interval, &samples);
+
+    if (cfg.noBme) fields &= ~AMDTP_TLM_BME280;
+    if (interval < AMDTP_TLM_MIN_INTERVAL_MS) interval = AMDTP_TLM_MIN_INTERVAL_MS;
+    if (samples < 1) samples = 1;
+    if (samples > AMDTP_TLM_MAX_SAMPLES) samples = AMDTP_TLM_MAX_SAMPLES;
+
+    p->tlmFields = fields;
+    p->tlmIntervalMs = interval;
+    p->tlmSamples = samples;
+    p->tlmNext = now;
+    p->tlmFull = false;
+    p->tlmHeld = false;
+    AmdtpTlmEncInit(&p->tlmEnc, &p->tlmBuf[2], AMDTP_TLM_MAX_SIZE, fields);
+}
+
+static void tlm_sample(periph_t *p, amdtpTlmSample_t *s)
+{
+    // slow changes, the deltas are small as those of a real sensor
+    float drift = (p->tlmCount % 200) / 100.0f;
+
+    memset(s, 0, sizeof(amdtpTlmSample_t));
+    s->time = (uint32_t) p->tlmNext;
+    s->value[AMDTP_TLM_BATTERY] = AmdtpTlmToInt(100.0f - p->index % 40 - drift);
+    s->value[AMDTP_TLM_INTERNAL] = AmdtpTlmToInt(20.0f + p->index % 10 + drift);
+    s->value[AMDTP_TLM_TEMPERATURE] = AmdtpTlmToInt(18.0f + p->index % 10 + drift);
+    s->value[AMDTP_TLM_HUMIDITY] = AmdtpTlmToInt(40.0f + p->index % 30 - drift);
+    s->value[AMDTP_TLM_PRESSURE] = AmdtpTlmToInt(1013.25f - p->index * 0.1f + drift);
+    s->value[AMDTP_TLM_ALTITUDE] = AmdtpTlmToInt(10.0f + p->index - drift * 8);
+    p->tlmCount++;
+}
+
+// add the held sample, a batch without room for it is full
+static void tlm_add(periph_t *p)
+{
+    if (! p->tlmHeld || p->tlmFull) return;
+
+    if (AmdtpTlmEncAdd(&p->tlmEnc, &p->tlmSample)) {
+        p->tlmHeld = false;
+        if (AmdtpTlmEncCount(&p->tlmEnc) >= p->tlmSamples) p->tlmFull = true;
+    }
+    else
+        p->tlmFull = true;              // in the next batch
+}
+
+static void tlm_event(periph_t *p)
+{
+    for ( ; now >= p->tlmNext; p->tlmNext += p->tlmIntervalMs) {
+        if (p->tlmHeld) {
+            p->tlmMissed++;
+            continue;
+        }
+
+        tlm_sample(p, &p->tlmSample);
+        p->tlmHeld = true;
+        tlm_add(p);
+    }
+
+    if (! p->tlmFull) return;
+
+    p->tlmBuf[0] = AMDTP_CMD_TELEMETRY;
+    p->tlmBuf[1] = AmdtpTlmEncLen(&p->tlmEnc);
+
+    if (AmdtpCoreSend(&p->core, p->tlmBuf, p->tlmBuf[1] + 2) == AMDTP_STATUS_SUCCESS) {
+        AmdtpTlmEncInit(&p->tlmEnc, &p->tlmBuf[2], AMDTP_TLM_MAX_SIZE, p->tlmFields);
+        p->tlmFull = false;
+        tlm_add(p);
+    }
+}
+
+static void make_reply(periph_t *p, const uint8_t *buf, uint16_t len)
+{
+    uint8_t *d = &p->reply[2];
+    float drift = (p->requests % 100) / 100.0f;
+
+    p->reply[0] = buf[0];           // echo the command
+
+    switch (buf[0]) {
+
+        case AMDTP_CMD_REQ_BATTERY_LEVEL:
+            d = put_float(d, 100.0f - p->index % 40 - drift);
+            break;
+
+        case AMDTP_CMD_REQ_INTERNAL_TEMP_CEL:
+            d = put_float(d, 20.0f + p->index % 10 + drift);
+            break;
+
+        case AMDTP_CMD_REQ_INTERNAL_TEMP_FRH:
+            d = put_float(d, (20.0f + p->index % 10 + drift) * 1.8f + 32);
+            break;
+
+        case AMDTP_CMD_BME280:
+            *d++ = 'C';
+            d = put_float(d, 18.0f + p->index % 10 + drift);
+            d = put_float(d, 40.0f + p->index % 30);
+            d = put_float(d, 101325.0f - p->index * 10);
+            *d++ = 'M';
+            d = put_float(d, 10.0f + p->index);
+            break;
+
+        case AMDTP_CMD_ADC:
+            *d++ = len > 1 ? buf[1] : 0;
+            *d++ = (p->index * 10) >> 8;
+            *d++ = (p->index * 10) & 0xff;
+            break;
+
+        case AMDTP_CMD_READ_PIN:
+        case AMDTP_CMD_PIN_HIGH:
+        case AMDTP_CMD_PIN_LOW:
+            *d++ = len > 1 ? buf[1] : 0;
+            if (buf[0] == AMDTP_CMD_READ_PIN) *d++ = p->requests & 1;
+            break;
+
+        case AMDTP_CMD_VERSION:
+            *d++ = 4;
+            *d++ = 2;
+            break;
+
+        case AMDTP_CMD_SUBSCRIBE:
+            tlm_subscribe(p, &buf[1], len - 1);
+            d += AmdtpTlmPutSubscribe(d, p->tlmFields, p->tlmIntervalMs, p->tlmSamples);
+            break;
+
+        case AMDTP_CMD_UNSUBSCRIBE:
+            p->tlmFields = 0;
+            break;
+
+        default:                    // HELLO, LED .. : no data
+            break;
+    }
+
+    p->reply[1] = d - &p->reply[2];
+    p->replyLen = d - p->reply;
+    p->requests++;
+}
+
+/*
+ * core callbacks
+ */
+static bool periphSend(void *user, eAmdtpPktType_t type, uint8_t *buf, uint16_t len)
+{
+    periph_t *p = user;
+
+    (void) type;
+    return queuePut(&p->tx, buf, len);
+}
+
+static void periphReceived(void *user, uint8_t *buf, uint16_t len)
+{
+    periph_t *p = user;
+
+    // sent after AmdtpCoreReceive() returns, the core may still be busy
+    if (len > 0) make_reply(p, buf, len);
+}
+
+static void periphTimer(void *user, uint32_t ms)
+{
+    periph_t *p = user;
+
+    p->coreTimerAt = ms ? now + ms : 0;
+}
+
+static void periphRandom(void *user, uint8_t *buf, uint16_t len)
+{
+    (void) user;
+
+    for (uint16_t i = 0; i < len; i++) buf[i] = rand();
+}
+
+/*
+ * the socket
+ */
+static void periph_close(periph_t *p)
+{
+    if (cfg.verbose) printf("server %d : closed after %u requests, %u samples, %u missed\n", p->index,
+                            p->requests, p->tlmCount, p->tlmMissed);
+
+    epoll_ctl(epfd, EPOLL_CTL_DEL, p->fd, NULL);
+    close(p->fd);
+    p->fd = -1;
+}
+
+static bool sim_send(periph_t *p, uint8_t type, const uint8_t *buf, uint8_t len)
+{
+    uint8_t msg[GW_SIM_MSG_SIZE];
+    uint16_t n = GwSimMessage(msg, type, buf, len);
+
+    return send(p->fd, msg, n, MSG_DONTWAIT | MSG_NOSIGNAL) == n;
+}
+
+static void sim_msg(void *ctx, uint8_t type, uint8_t *data, uint8_t len)
+{
+    periph_t *p = ctx;
+    uint16_t mtu;
+    uint8_t m[2];
+
+    if (type == GW_SIM_MTU && len == 2) {
+        mtu = data[0] | data[1] << 8;
+        if (mtu > cfg.mtu) mtu = cfg.mtu;
+        AmdtpCoreSetMtu(&p->core, mtu);
+
+        m[0] = mtu & 0xff;
+        m[1] = mtu >> 8;
+        sim_send(p, GW_SIM_MTU, m, 2);
+    }
+    else if (type == GW_SIM_FRAME) {
+        // taken on the next connection event
+        queuePut(&p->rx, data, len);
+    }
+}
+
+static void periph_read(periph_t *p)
+{
+    ssize_t n = read(p->fd, &p->in[p->inLen], sizeof(p->in) - p->inLen);
+
+    if (n < 0 && (errno == EAGAIN || errno == EINTR)) return;
+
+    if (n <= 0) {
+        periph_close(p);
+        return;
+    }
+
+    p->inLen += n;
+    GwSimParse(p->in, &p->inLen, sim_msg, p);
+}
+
+static void periph_accept(int lfd)
+{
+    amdtpCoreCallbacks_t cb = {0};
+    struct epoll_event ev;
+    periph_t *p = NULL;
+    int fd, i;
+
+    fd = accept4(lfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) return;
+
+    for (i = 0; i < cfg.maxConn; i++) {
+        if (periphs[i].fd < 0) {
+            p = &periphs[i];
+            break;
+        }
+    }
+
+    // as a server that does not advertise any more
+    if (p == NULL) {
+        close(fd);
+        return;
+    }
+
+    memset(p, 0, sizeof(periph_t));
+    p->fd = fd;
+    p->index = accepted++;
+
+    cb.send = periphSend;
+    cb.received = periphReceived;
+    cb.timer = periphTimer;
+    cb.random = periphRandom;
+    cb.user = p;
+
+    AmdtpCoreSetCallbacks(&p->core, &cb);
+    if (cfg.keySet) AmdtpCoreSetKey(&p->core, cfg.key);
+    AmdtpCoreInit(&p->core);
+
+    ev.events = EPOLLIN;
+    ev.data.ptr = p;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+
+    if (cfg.verbose) printf("server %d : connected\n", p->index);
+}
+
+/*
+ * one connection event of server p
+ */
+static void periph_event(periph_t *p)
+{
+    frame_t *f;
+    int i;
+
+    if (p->coreTimerAt && now >= p->coreTimerAt) {
+        p->coreTimerAt = 0;
+        AmdtpCoreTimeout(&p->core);
+    }
+
+    for (i = 0; i < cfg.framesPerEvent && (f = queueGet(&p->rx)) != NULL; i++)
+        if (! lost()) AmdtpCoreReceive(&p->core, f->data, f->len);
+
+    if (p->replyLen && AmdtpCoreSend(&p->core, p->reply, p->replyLen) == AMDTP_STATUS_SUCCESS)
+        p->replyLen = 0;
+
+    // a reply goes first
+    if (p->tlmFields && p->replyLen == 0) tlm_event(p);
+
+    AmdtpCorePump(&p->core);
+
+    for (i = 0; i < cfg.framesPerEvent && p->tx.count; i++) {
+        f = &p->tx.frames[p->tx.head];
+
+        if (! lost() && ! sim_send(p, GW_SIM_FRAME, f->data, f->len)) break;      // socket full
+        queueGet(&p->tx);
+    }
+}
+
+static bool parse_key(const char *hex, uint8_t *key)
+{
+    unsigned int b;
+
+    if (strlen(hex) != AMDTP_CCM_KEY_SIZE * 2) return false;
+
+    for (int i = 0; i < AMDTP_CCM_KEY_SIZE; i++) {
+        if (! isxdigit((unsigned char) hex[i * 2]) || ! isxdigit((unsigned char) hex[i * 2 + 1])) return false;
+        if (sscanf(&hex[i * 2], "%2x", &b) != 1) return false;
+        key[i] = b;
+    }
+
+    return true;
+}
+
+static void on_signal(int sig)
+{
+    (void) sig;
+    stop = 1;
+}
+
+static void usage(const char *name)
+{
+    printf("%s [options]\n"
+           "  -s path  Unix socket (/tmp/fake_periph.sock)\n"
+           "  -m mtu   largest ATT MTU of the servers (%d)\n"
+           "  -i ms    connection interval (30)\n"
+           "  -f n     frames per connection event per direction (4)\n"
+           "  -l pct   frames lost in %% (0)\n"
+           "  -n n     servers at the same time (64)\n"
+           "  -k key   AMDTP key, 32 hex digits\n"
+           "  -B       no BME280 (a subscription leaves these fields out)\n"
+           "  -v       show connects\n", name, ATT_MAX_MTU);
+}
+
+int main(int argc, char *argv[])
+{
+    struct sockaddr_un addr;
+    struct epoll_event ev, events[64];
+    uint64_t nextEvent;
+    int opt, lfd, n, i, wait;
+
+    while ((opt = getopt(argc, argv, "s:m:i:f:l:n:k:Bvh")) != -1)
+    {
+        switch (opt)
+        {
+            case 's': cfg.path = optarg; break;
+            case 'm': cfg.mtu = atoi(optarg); break;
+            case 'i': cfg.intervalMs = atoi(optarg); break;
+            case 'f': cfg.framesPerEvent = atoi(optarg); break;
+            case 'l': cfg.loss = atof(optarg) / 100; break;
+            case 'n': cfg.maxConn = atoi(optarg); break;
+            case 'k':
+                if (! parse_key(optarg, cfg.key)) {
+                    usage(argv[0]);
+                    return 1;
+                }
+                cfg.keySet = true;
+                break;
+            case 'B': cfg.noBme = true; break;
+            case 'v': cfg.verbose = true; break;
+            default : usage(argv[0]); return 0;
+        }
+    }
+
+    if (cfg.mtu < AMDTP_MIN_MTU || cfg.mtu > ATT_MAX_MTU || cfg.intervalMs < 1 || cfg.framesPerEvent < 1 ||
+        cfg.maxConn < 1 || strlen(cfg.path) >= sizeof(addr.sun_path))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    periphs = calloc(cfg.maxConn, sizeof(periph_t));
+    if (periphs == NULL) return 1;
+    for (i = 0; i < cfg.maxConn; i++) periphs[i].fd = -1;
+
+    lfd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, cfg.path);
+    unlink(cfg.path);
+
+    if (lfd < 0 || bind(lfd, (struct sockaddr *) &addr, sizeof(addr)) < 0 || listen(lfd, 64) < 0) {
+        perror(cfg.path);
+        return 1;
+    }
+
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;                 // the listener
+    epoll_ctl(epfd, EPOLL_CTL_ADD, lfd, &ev);
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    srand(now_ms());
+
+    printf("fake_periph on %s : up to %d servers, MTU %u, interval %u ms, %d frames / event, loss %.1f %%\n",
+           cfg.path, cfg.maxConn, cfg.mtu, cfg.intervalMs, cfg.framesPerEvent, cfg.loss * 100);
+    fflush(stdout);
+
+    nextEvent = now_ms();
+
+    while (! stop) {
+        now = now_ms();
+        wait = nextEvent > now ? (int) (nextEvent - now) : 0;
+
+        n = epoll_wait(epfd, events, 64, wait);
+
+        for (i = 0; i < n; i++) {
+            if (events[i].data.ptr == NULL) periph_accept(lfd);
+            else periph_read(events[i].data.ptr);
+        }
+
+        now = now_ms();
+        if (now < nextEvent) continue;
+
+        // the connection event of all servers
+        for (i = 0; i < cfg.maxConn; i++)
+            if (periphs[i].fd >= 0) periph_event(&periphs[i]);
+
+        nextEvent += cfg.intervalMs;
+        if (nextEvent < now) nextEvent = now + cfg.intervalMs;
+    }
+
+    for (i = 0; i < cfg.maxConn; i++)
+        if (periphs[i].fd >= 0) periph_close(&periphs[i]);
+
+    close(lfd);
+    unlink(cfg.path);
+    printf("fake_periph : %d connections\n", accepted);
+
+    return 0;
+}
@@ -0,0 +1,353 @@
+/*
+ * gateway_sim.c : load test of the gateway mode of amdtc on a host.
+ *
+ * Runs amdtc_gw.c and amdtc_sink.c of ble_amdtp_raspPi/amdtc, the part of the
+ * gateway that handles a server, with -c connections to fake_periph. amdtc
+ * itself needs bluez and glib, here an epoll loop does what the glib loop of
+ * amdtc_gateway.c does for sim: lines : connect, the MTU exchange, give the
+ * frames to GwConnFrame(), call GwConnTick() when it asks and connect again
+ * after a close.
+ *
+ * At the end (-t seconds) one line with the totals :
+ *
+ *   connections  records  records/s  reply ms avg  max  timeouts  errors  reconnects  frames/record
+ *
+ * and with -v a line per connection. It fails (exit 1) when a connection got
+ * no records or a reply did not come.
+ *
+ * With -S the servers are not polled, the gateway subscribes to telemetry and
+ * each sample of a batch is a record. A second line then has the batches, the
+ * samples per batch and the bytes per sample :
+ *
+ *  ./gateway_sim -s /tmp/fake_periph.sock -c 40 -S bme280,battery:100:10
+ *
+ *  ./fake_periph -s /tmp/fake_periph.sock &
+ *  ./gateway_sim -s /tmp/fake_periph.sock -c 40 -t 10 -o json
+ *
+ * compile with ./make_amdtp_sim, ./gateway_sim -h for the options
+ *
+ * paulvha / October 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <ctype.h>
+#include <getopt.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "amdtp_core.h"
+#include "amdtc_gw.h"
+#include "amdtc_sink.h"
+
+#define RETRY_MS        1000        // connect again after a close
+
+typedef struct
+{
+    gwConn_t    conn;
+    int         fd;                 // -1 : not connected
+    bool        closing;
+    uint64_t    retryAt;
+    uint8_t     in[GW_SIM_MSG_SIZE * 2];
+    uint16_t    inLen;
+}
+client_t;
+
+typedef struct
+{
+    const char  *path;
+    int         connections;
+    uint32_t    seconds;
+    const char  *poll;
+    uint32_t    intervalMs;
+    const char  *sink;
+    const char  *subscribe;
+    uint16_t    mtu;
+    bool        verbose;
+}
+config_t;
+
+static config_t cfg = { "/tmp/fake_periph.sock", 40, 10, "battery,tempC,bme280", 1000, NULL, NULL, ATT_DEFAULT_MTU,
+                        false };
+static gwConfig_t gwCfg;
+static gwSink_t sink;
+static client_t *clients;
+static int epfd;
+
+static uint64_t now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*
+ * the sim link
+ */
+static bool simWrite(void *ctx, const uint8_t *buf, uint16_t len)
+{
+    client_t *c = ctx;
+    uint8_t msg[GW_SIM_MSG_SIZE];
+    uint16_t n;
+
+    if (c->fd < 0 || len > 255) return false;
+
+    n = GwSimMessage(msg, GW_SIM_FRAME, buf, len);
+    return send(c->fd, msg, n, MSG_DONTWAIT | MSG_NOSIGNAL) == n;
+}
+
+// not from within the core, the loop closes it
+static void simClose(void *ctx)
+{
+    client_t *c = ctx;
+
+    c->closing = true;
+}
+
+static const gwLink_t simLink = { simWrite, simClose };
+
+static void client_down(client_t *c)
+{
+    GwConnDown(&c->conn);
+
+    if (c->fd >= 0) {
+        epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+        close(c->fd);
+    }
+
+    c->fd = -1;
+    c->inLen = 0;
+    c->closing = false;
+    c->retryAt = now_ms() + RETRY_MS;
+}
+
+static void client_connect(client_t *c)
+{
+    struct sockaddr_un addr;
+    struct epoll_event ev;
+    uint8_t m[2] = { cfg.mtu & 0xff, cfg.mtu >> 8 };
+    uint8_t msg[GW_SIM_MSG_SIZE];
+
+    c->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, cfg.path, sizeof(addr.sun_path) - 1);
+
+    if (c->fd < 0 || connect(c->fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        if (c->fd >= 0) close(c->fd);
+        c->fd = -1;
+        c->retryAt = now_ms() + RETRY_MS;
+        return;
+    }
+
+    fcntl(c->fd, F_SETFL, fcntl(c->fd, F_GETFL) | O_NONBLOCK);
+
+    ev.events = EPOLLIN;
+    ev.data.ptr = c;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, c->fd, &ev);
+
+    send(c->fd, msg, GwSimMessage(msg, GW_SIM_MTU, m, 2), MSG_NOSIGNAL);
+}
+
+static void sim_msg(void *ctx, uint8_t type, uint8_t *data, uint8_t len)
+{
+    client_t *c = ctx;
+
+    if (c->closing) return;
+
+    if (type == GW_SIM_MTU && len == 2)
+        GwConnUp(&c->conn, data[0] | data[1] << 8, now_ms());
+    else if (type == GW_SIM_FRAME)
+        GwConnFrame(&c->conn, data, len, now_ms());
+}
+
+static void client_read(client_t *c)
+{
+    ssize_t n = read(c->fd, &c->in[c->inLen], sizeof(c->in) - c->inLen);
+
+    if (n < 0 && (errno == EAGAIN || errno == EINTR)) return;
+
+    if (n <= 0) {
+        client_down(c);
+        return;
+    }
+
+    c->inLen += n;
+    GwSimParse(c->in, &c->inLen, sim_msg, c);
+}
+
+static bool parse_key(const char *hex, uint8_t *key)
+{
+    unsigned int b;
+
+    if (strlen(hex) != AMDTP_CCM_KEY_SIZE * 2) return false;
+
+    for (int i = 0; i < AMDTP_CCM_KEY_SIZE; i++) {
+        if (! isxdigit((unsigned char) hex[i * 2]) || ! isxdigit((unsigned char) hex[i * 2 + 1])) return false;
+        if (sscanf(&hex[i * 2], "%2x", &b) != 1) return false;
+        key[i] = b;
+    }
+
+    return true;
+}
+
+static void usage(const char *name)
+{
+    printf("%s [options]\n"
+           "  -s path  Unix socket of fake_periph (/tmp/fake_periph.sock)\n"
+           "  -c n     connections (40)\n"
+           "  -t s     seconds to run (10)\n"
+           "  -p list  commands of each round (battery,tempC,bme280)\n"
+           "  -I ms    time between the rounds (1000)\n"
+           "  -o sink  write the records : json[:FILE], csv[:FILE] or unix:PATH (none)\n"
+           "  -S spec  subscribe to telemetry instead of polling, as bme280,battery:100:10\n"
+           "           (fields:ms between samples:samples per packet)\n"
+           "  -m mtu   ATT MTU (23)\n"
+           "  -k key   AMDTP key, 32 hex digits (as fake_periph -k)\n"
+           "  -v       a line per connection\n", name);
+}
+
+int main(int argc, char *argv[])
+{
+    struct epoll_event events[64];
+    uint64_t start, end, now;
+    uint32_t wait, w, records = 0, timeouts = 0, errors = 0, connects = 0, polled = 0, maxMs = 0;
+    uint32_t batches = 0, batchBytes = 0, frames = 0;
+    uint64_t sumMs = 0;
+    int opt, n, i;
+    char name[GW_NAME_SIZE];
+
+    while ((opt = getopt(argc, argv, "s:c:t:p:I:o:S:m:k:vh")) != -1)
+    {
+        switch (opt)
+        {
+            case 's': cfg.path = optarg; break;
+            case 'c': cfg.connections = atoi(optarg); break;
+            case 't': cfg.seconds = atoi(optarg); break;
+            case 'p': cfg.poll = optarg; break;
+            case 'I': cfg.intervalMs = atoi(optarg); break;
+            case 'o': cfg.sink = optarg; break;
+            case 'S': cfg.subscribe = optarg; break;
+            case 'm': cfg.mtu = atoi(optarg); break;
+            case 'k':
+                if (! parse_key(optarg, gwCfg.key)) {
+                    usage(argv[0]);
+                    return 1;
+                }
+                gwCfg.keySet = true;
+                break;
+            case 'v': cfg.verbose = true; break;
+            default : usage(argv[0]); return 0;
+        }
+    }
+
+    gwCfg.intervalMs = cfg.intervalMs;
+    gwCfg.replyMs = GW_REPLY_MS;
+
+    if (cfg.connections < 1 || cfg.seconds < 1 || cfg.intervalMs < 1 || cfg.mtu < AMDTP_MIN_MTU ||
+        cfg.mtu > ATT_MAX_MTU || ! GwConfigPoll(&gwCfg, cfg.poll) ||
+        (cfg.subscribe && ! GwConfigSubscribe(&gwCfg, cfg.subscribe)))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (cfg.sink && ! GwSinkOpen(&sink, cfg.sink)) {
+        fprintf(stderr, "can not open sink %s\n", cfg.sink);
+        return 1;
+    }
+
+    clients = calloc(cfg.connections, sizeof(client_t));
+    if (clients == NULL) return 1;
+
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+
+    for (i = 0; i < cfg.connections; i++) {
+        snprintf(name, sizeof(name), "sim:%s#%d", cfg.path, i + 1);
+        GwConnInit(&clients[i].conn, name, &gwCfg, cfg.sink ? &sink : NULL, &simLink, &clients[i]);
+        client_connect(&clients[i]);
+    }
+
+    start = now_ms();
+    end = start + cfg.seconds * 1000;
+
+    while ((now = now_ms()) < end) {
+        wait = 1000;
+
+        for (i = 0; i < cfg.connections; i++) {
+            client_t *c = &clients[i];
+
+            if (c->closing) client_down(c);
+
+            if (c->fd < 0) {
+                if (now >= c->retryAt) client_connect(c);
+                if (c->fd < 0) {
+                    w = c->retryAt > now ? c->retryAt - now : 0;
+                    if (w < wait) wait = w;
+                }
+                continue;
+            }
+
+            w = GwConnTick(&c->conn, now);
+            if (c->closing) w = 0;
+            if (w < wait) wait = w;
+        }
+
+        if (now + wait > end) wait = end - now;
+
+        n = epoll_wait(epfd, events, 64, wait);
+
+        for (i = 0; i < n; i++) client_read(events[i].data.ptr);
+    }
+
+    for (i = 0; i < cfg.connections; i++) {
+        gwStats_t *s = &clients[i].conn.stats;
+
+        records += s->records;
+        timeouts += s->timeouts;
+        errors += s->errors;
+        connects += s->connects;
+        polled += s->polled;
+        batches += s->batches;
+        batchBytes += s->batchBytes;
+        frames += s->frames;
+        sumMs += s->latencySumMs;
+        if (s->latencyMaxMs > maxMs) maxMs = s->latencyMaxMs;
+
+        if (cfg.verbose)
+            printf("%-40s connects %u records %u timeouts %u errors %u reply ms avg %u max %u\n",
+                   clients[i].conn.name, s->connects, s->records, s->timeouts, s->errors,
+                   s->polled ? (unsigned) (s->latencySumMs / s->polled) : 0, s->latencyMaxMs);
+    }
+
+    printf("connections  records  records/s  reply ms avg   max  timeouts  errors  reconnects  frames/record\n");
+    printf("%11d  %7u  %9.1f  %12u  %4u  %8u  %6u  %10d  %13.2f\n", cfg.connections, records,
+           records * 1000.0 / (now_ms() - start), polled ? (unsigned) (sumMs / polled) : 0, maxMs,
+           timeouts, errors, connects > (uint32_t) cfg.connections ? connects - cfg.connections : 0,
+           records ? (double) frames / records : 0);
+
+    if (cfg.subscribe)
+        printf("telemetry : %u batches, %.1f samples per batch, %.1f bytes per sample\n", batches,
+               batches ? (double) records / batches : 0, records ? (double) batchBytes / records : 0);
+
+    if (cfg.sink) {
+        if (sink.dropped) printf("sink : %u records dropped\n", sink.dropped);
+        GwSinkClose(&sink);
+    }
+
+    for (i = 0; i < cfg.connections; i++) {
+        if (clients[i].conn.stats.records == 0) {
+            printf("%s : no records\n", clients[i].conn.name);
+            return 1;
+        }
+    }
+
+    return timeouts ? 1 : 0;
+}
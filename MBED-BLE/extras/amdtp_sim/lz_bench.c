@@ -0,0 +1,203 @@
+/*
+ * lz_bench.c : compression ratio and speed of amdtp_lz.c on the kind of
+ * data that is sent with AMDTP, in packets of 512 bytes (or -p size) as
+ * the core compresses them.
+ *
+ * The corpus is made here :
+ *   bme280   records as example16 (4 floats, 4 bytes), slow changing values
+ *   sps30    text lines as a SPS30 sketch prints them
+ *   log      log lines with a time stamp
+ *   random   does not compress, the core then sends the packet as is
+ * Files given on the command line are added.
+ *
+ * Every packet is decompressed and compared.
+ *
+ * compile with ./make_amdtp_sim, run ./lz_bench [-p size] [file ...]
+ *
+ * paulvha / October 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+#include "amdtp_lz.h"
+
+#define CORPUS_SIZE     (64 * 1024)
+#define LOOPS           50
+
+static uint8_t corpus[CORPUS_SIZE];
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint32_t make_bme280(uint8_t *p, uint32_t max)
+{
+    struct { float humidity, pressure, altitude, temperature; uint8_t meter, celsius; int8_t cmd; uint8_t magic; } r;
+    uint32_t n = 0, i = 0;
+
+    while (n + sizeof(r) <= max)
+    {
+        r.humidity = 45.0f + (i % 50) * 0.1f;
+        r.pressure = 1013.25f - (i % 20) * 0.01f;
+        r.altitude = 12.5f;
+        r.temperature = 21.0f + (i % 30) * 0.05f;
+        r.meter = 1;
+        r.celsius = 1;
+        r.cmd = 7;
+        r.magic = 0xA5;
+        memcpy(p + n, &r, sizeof(r));
+        n += sizeof(r);
+        i++;
+    }
+    return n;
+}
+
+static uint32_t make_sps30(uint8_t *p, uint32_t max)
+{
+    char line[200];
+    uint32_t n = 0, i = 0, l;
+
+    while (1)
+    {
+        l = snprintf(line, sizeof(line),
+            "MassPM1: %.2f MassPM2: %.2f MassPM4: %.2f MassPM10: %.2f NumPM0: %.2f NumPM1: %.2f "
+            "NumPM2: %.2f NumPM4: %.2f NumPM10: %.2f PartSize: %.2f\n",
+            3.1 + (i % 7) * 0.13, 4.2 + (i % 5) * 0.11, 4.9, 5.3, 21.4 + (i % 3), 25.1, 25.3, 25.3, 25.4, 0.52);
+        if (n + l > max) break;
+        memcpy(p + n, line, l);
+        n += l;
+        i++;
+    }
+    return n;
+}
+
+static uint32_t make_log(uint8_t *p, uint32_t max)
+{
+    static const char *msg[] = {"sensor read ok", "notification sent", "connection interval 30ms",
+                                "buffer full, retry", "sensor read ok"};
+    char line[120];
+    uint32_t n = 0, i = 0, l;
+
+    while (1)
+    {
+        l = snprintf(line, sizeof(line), "[%02u:%02u:%02u] INFO %s\n",
+                     (i / 3600) % 24, (i / 60) % 60, i % 60, msg[(i * 7) % 5]);
+        if (n + l > max) break;
+        memcpy(p + n, line, l);
+        n += l;
+        i++;
+    }
+    return n;
+}
+
+static uint32_t make_random(uint8_t *p, uint32_t max)
+{
+    uint32_t n;
+
+    for (n = 0; n < max; n++) p[n] = rand();
+    return n;
+}
+
+static int bench(const char *name, const uint8_t *data, uint32_t len, uint16_t pkt)
+{
+    static uint8_t out[1024], back[1024];
+    uint32_t pos, raw = 0, sent = 0, loop;
+    uint16_t n, c, d;
+    double t, tc, td;
+
+    // ratio and check
+    for (pos = 0; pos < len; pos += n)
+    {
+        n = len - pos < pkt ? len - pos : pkt;
+        c = AmdtpLzCompress(data + pos, n, out, n - 1);
+
+        if (c > 0)
+        {
+            d = AmdtpLzDecompress(out, c, back, sizeof(back));
+
+            if (d != n || memcmp(back, data + pos, n) != 0) {
+                printf("%s : packet at %u does not decompress\n", name, pos);
+                return 1;
+            }
+        }
+
+        raw += n;
+        sent += c > 0 ? c : n;          // the core sends it as is when it does not get smaller
+    }
+
+    t = now();
+    for (loop = 0; loop < LOOPS; loop++)
+        for (pos = 0; pos < len; pos += pkt)
+            AmdtpLzCompress(data + pos, len - pos < pkt ? len - pos : pkt, out, sizeof(out));
+    tc = (now() - t) / LOOPS;
+
+    // decompress what compressed
+    td = 0;
+    for (pos = 0; pos < len; pos += pkt)
+    {
+        n = len - pos < pkt ? len - pos : pkt;
+        c = AmdtpLzCompress(data + pos, n, out, n - 1);
+        if (c == 0) continue;
+
+        t = now();
+        for (loop = 0; loop < LOOPS; loop++) AmdtpLzDecompress(out, c, back, sizeof(back));
+        td += (now() - t) / LOOPS;
+    }
+
+    printf("%-12s %8u %8u %7.1f%% %10.2f %10.2f\n", name, raw, sent, 100.0 * sent / raw,
+           tc * 1e6 / (raw / 1024.0), td * 1e6 / (raw / 1024.0));
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    static const struct { const char *name; uint32_t (*make)(uint8_t *, uint32_t); } gen[] = {
+        {"bme280", make_bme280}, {"sps30", make_sps30}, {"log", make_log}, {"random", make_random}};
+    uint16_t pkt = AMDTP_LZ_MAX_OFFSET;
+    uint32_t i, len;
+    int opt, ret = 0;
+    FILE *fp;
+
+    while ((opt = getopt(argc, argv, "p:h")) != -1)
+    {
+        if (opt == 'p') {
+            pkt = atoi(optarg);
+            if (pkt < 2 || pkt > AMDTP_LZ_MAX_OFFSET) pkt = AMDTP_LZ_MAX_OFFSET;
+        }
+        else {
+            printf("usage : %s [-p packet size (2 - 512)] [file ...]\n", argv[0]);
+            return 0;
+        }
+    }
+
+    printf("packets of %u bytes, us per KB on this host\n", pkt);
+    printf("corpus          bytes     sent   ratio   compress decompress\n");
+
+    for (i = 0; i < sizeof(gen) / sizeof(gen[0]); i++)
+    {
+        len = gen[i].make(corpus, CORPUS_SIZE);
+        ret |= bench(gen[i].name, corpus, len, pkt);
+    }
+
+    for (; optind < argc; optind++)
+    {
+        if ((fp = fopen(argv[optind], "rb")) == NULL) {
+            printf("%s : can not open\n", argv[optind]);
+            continue;
+        }
+
+        len = fread(corpus, 1, CORPUS_SIZE, fp);
+        fclose(fp);
+        if (len > 0) ret |= bench(argv[optind], corpus, len, pkt);
+    }
+
+    return ret;
+}
@@ -69,7 +69,7 @@
 #define AMDTP_LENGTH_SIZE_IN_PKT        2
 #define AMDTP_HEADER_SIZE_IN_PKT        2
 #define AMDTP_CRC_SIZE_IN_PKT           4
-#define AMDTP_PREFIX_SIZE_IN_PKT        AMDTP_LENGTH_SIZE_IN_PKT + AMDTP_HEADER_SIZE_IN_PKT
+#define AMDTP_PREFIX_SIZE_IN_PKT        (AMDTP_LENGTH_SIZE_IN_PKT + AMDTP_HEADER_SIZE_IN_PKT)
 
 #define PACKET_TYPE_BIT_OFFSET          12
 #define PACKET_TYPE_BIT_MASK            (0xf << PACKET_TYPE_BIT_OFFSET)
@@ -79,6 +79,10 @@
 #define PACKET_ENCRYPTION_BIT_MASK      (0x1 << PACKET_ENCRYPTION_BIT_OFFSET)
 #define PACKET_ACK_BIT_OFFSET           6
 #define PACKET_ACK_BIT_MASK             (0x1 << PACKET_ACK_BIT_OFFSET)
+#define PACKET_STREAM_BIT_OFFSET        5           // part of a stream (amdtp_core.h), added October 2026
+#define PACKET_STREAM_BIT_MASK          (0x1 << PACKET_STREAM_BIT_OFFSET)
+#define PACKET_COMPRESS_BIT_OFFSET      4           // data is compressed (amdtp_lz.h), added October 2026
+#define PACKET_COMPRESS_BIT_MASK        (0x1 << PACKET_COMPRESS_BIT_OFFSET)
 
 #define BYTES_TO_UINT16(n, p)     {n = ((uint16_t)(p)[0] + ((uint16_t)(p)[1] << 8));}
 #define BYTES_TO_UINT32(n, p)     {n = ((uint32_t)(p)[0] + ((uint32_t)(p)[1] << 8) + \
@@ -120,6 +124,9 @@ typedef enum eAmdtpControl
 {
     AMDTP_CONTROL_RESEND_REQ,
     AMDTP_CONTROL_SEND_READY,       // this is send /received to indicate next packet can be send
+    AMDTP_CONTROL_WINDOW_REQ,       // [version][window] offer sliding window mode (amdtp_core.h)
+    AMDTP_CONTROL_WINDOW_RSP,       // [version][window] agreed window, 0 is stop-and-wait
+    AMDTP_CONTROL_WINDOW_ACK,       // [sn][cumulative][bitmap 4 bytes]([sn high]) chunks received
     AMDTP_CONTROL_MAX
 }eAmdtpControl_t;
 
@@ -0,0 +1,375 @@
+// ****************************************************************************
+//
+//  amdtp_conn.c
+//! @file
+//!
+//! @brief AMDTP for several connections at the same time.
+//!
+//! See amdtp_conn.h for the pool and the transmit turns.
+//!
+//! added paulvha / October 2026
+//
+// ****************************************************************************
+
+#include <string.h>
+#include "amdtp_conn.h"
+
+#if AMDTP_MAX_CONNECTIONS < 1 || AMDTP_MAX_CONNECTIONS > 8
+#error "AMDTP_MAX_CONNECTIONS must be 1 - 8"
+#endif
+
+//*****************************************************************************
+//
+// helpers
+//
+//*****************************************************************************
+
+// another connection waits for room in the stack
+static bool
+othersWaiting(amdtpConnPool_t *pool, amdtpConn_t *c)
+{
+    uint8_t i;
+
+    for (i = 0; i < AMDTP_MAX_CONNECTIONS; i++)
+    {
+        if (&pool->conn[i] != c && pool->conn[i].handle != AMDTP_CONN_NONE && pool->conn[i].txWaiting)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// an ACK or CONTROL frame waits for room
+static bool
+ctrlWaiting(amdtpConnPool_t *pool)
+{
+    uint8_t i;
+
+    for (i = 0; i < AMDTP_MAX_CONNECTIONS; i++)
+    {
+        if (pool->conn[i].handle != AMDTP_CONN_NONE && pool->conn[i].ctrlLen)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// send the waiting ACK / CONTROL frames, false if the stack is still full
+static bool
+ctrlFlush(amdtpConnPool_t *pool)
+{
+    amdtpConn_t *c;
+    uint8_t i;
+
+    for (i = 0; i < AMDTP_MAX_CONNECTIONS; i++)
+    {
+        c = &pool->conn[(pool->next + i) % AMDTP_MAX_CONNECTIONS];
+
+        if (c->handle == AMDTP_CONN_NONE || c->ctrlLen == 0)
+        {
+            continue;
+        }
+
+        if (! pool->cb.send(c, (eAmdtpPktType_t) c->ctrlType, c->ctrl, c->ctrlLen))
+        {
+            return false;
+        }
+
+        c->ctrlLen = 0;
+        c->ctrlLate++;
+    }
+
+    return true;
+}
+
+// send of all cores : hold back window data frames when the turn is over
+static bool
+connSend(void *user, eAmdtpPktType_t type, uint8_t *buf, uint16_t len)
+{
+    amdtpConn_t *c = (amdtpConn_t *) user;
+    amdtpConnPool_t *pool = c->pool;
+    bool data = type == AMDTP_PKT_TYPE_DATA && c->core.txWindowed;
+
+    if (data && (ctrlWaiting(pool) ||
+                 (pool->quota && c->txCount >= pool->quota && othersWaiting(pool, c))))
+    {
+        c->txHeld++;
+        c->txWaiting = true;
+        return false;
+    }
+
+    if (! pool->cb.send(c, type, buf, len))
+    {
+        c->txWaiting = true;
+
+        // keep the last ACK / CONTROL frame for the next turn
+        if (type != AMDTP_PKT_TYPE_DATA && len <= sizeof(c->ctrl))
+        {
+            memcpy(c->ctrl, buf, len);
+            c->ctrlLen = (uint8_t) len;
+            c->ctrlType = (uint8_t) type;
+            return true;
+        }
+
+        return false;
+    }
+
+    if (data)
+    {
+        c->txCount++;
+    }
+
+    return true;
+}
+
+static void
+connCallbacks(amdtpConnPool_t *pool, amdtpConn_t *c)
+{
+    amdtpCoreCallbacks_t cb = pool->cb;
+
+    cb.send = connSend;
+    cb.user = c;
+    AmdtpCoreSetCallbacks(&c->core, &cb);
+}
+
+static void
+connReset(amdtpConn_t *c, uint16_t handle)
+{
+    AmdtpCoreInit(&c->core);        // also stops the timer
+    c->handle = handle;
+    c->txWaiting = false;
+    c->txCount = 0;
+    c->txHeld = 0;
+    c->ctrlLate = 0;
+    c->ctrlLen = 0;
+}
+
+//*****************************************************************************
+//
+// public functions, see amdtp_conn.h
+//
+//*****************************************************************************
+void
+AmdtpConnPoolInit(amdtpConnPool_t *pool, const amdtpCoreCallbacks_t *cb, void *user)
+{
+    uint8_t i;
+
+    memset(pool, 0, sizeof(amdtpConnPool_t));
+    pool->cb = *cb;
+    pool->user = user;
+    pool->quota = AMDTP_CONN_TX_QUOTA;
+
+    for (i = 0; i < AMDTP_MAX_CONNECTIONS; i++)
+    {
+        pool->conn[i].pool = pool;
+        pool->conn[i].handle = AMDTP_CONN_NONE;
+        connCallbacks(pool, &pool->conn[i]);
+        connReset(&pool->conn[i], AMDTP_CONN_NONE);
+    }
+}
+
+void
+AmdtpConnSetCallbacks(amdtpConnPool_t *pool, const amdtpCoreCallbacks_t *cb)
+{
+    uint8_t i;
+
+    pool->cb = *cb;
+
+    for (i = 0; i < AMDTP_MAX_CONNECTIONS; i++)
+    {
+        connCallbacks(pool, &pool->conn[i]);
+    }
+}
+
+amdtpConn_t *
+AmdtpConnFind(amdtpConnPool_t *pool, uint16_t handle)
+{
+    uint8_t i;
+
+    if (handle == AMDTP_CONN_NONE)
+    {
+        return NULL;
+    }
+
+    for (i = 0; i < AMDTP_MAX_CONNECTIONS; i++)
+    {
+        if (pool->conn[i].handle == handle)
+        {
+            return &pool->conn[i];
+        }
+    }
+
+    return NULL;
+}
+
+amdtpConn_t *
+AmdtpConnOpen(amdtpConnPool_t *pool, uint16_t handle)
+{
+    amdtpConn_t *c;
+    uint8_t i;
+
+    if (handle == AMDTP_CONN_NONE)
+    {
+        return NULL;
+    }
+
+    c = AmdtpConnFind(pool, handle);
+
+    if (c == NULL)
+    {
+        for (i = 0; i < AMDTP_MAX_CONNECTIONS && c == NULL; i++)
+        {
+            if (pool->conn[i].handle == AMDTP_CONN_NONE) c = &pool->conn[i];
+        }
+
+        if (c == NULL)
+        {
+            return NULL;            // pool is full
+        }
+    }
+
+    connReset(c, handle);
+    return c;
+}
+
+void
+AmdtpConnClose(amdtpConnPool_t *pool, uint16_t handle)
+{
+    amdtpConn_t *c = AmdtpConnFind(pool, handle);
+
+    if (c)
+    {
+        connReset(c, AMDTP_CONN_NONE);
+    }
+}
+
+void
+AmdtpConnResetTransfer(amdtpConnPool_t *pool, uint16_t handle)
+{
+    amdtpConn_t *c = AmdtpConnFind(pool, handle);
+
+    if (c)
+    {
+        AmdtpCoreResetTransfer(&c->core);
+        c->txWaiting = false;       // a waiting ACK / CONTROL frame is still sent
+    }
+}
+
+void
+AmdtpConnCloseAll(amdtpConnPool_t *pool)
+{
+    uint8_t i;
+
+    for (i = 0; i < AMDTP_MAX_CONNECTIONS; i++)
+    {
+        connReset(&pool->conn[i], AMDTP_CONN_NONE);
+    }
+}
+
+amdtpConn_t *
+AmdtpConnFirst(amdtpConnPool_t *pool)
+{
+    uint8_t i;
+
+    for (i = 0; i < AMDTP_MAX_CONNECTIONS; i++)
+    {
+        if (pool->conn[i].handle != AMDTP_CONN_NONE)
+        {
+            return &pool->conn[i];
+        }
+    }
+
+    return NULL;
+}
+
+uint8_t
+AmdtpConnCount(amdtpConnPool_t *pool)
+{
+    uint8_t i, n = 0;
+
+    for (i = 0; i < AMDTP_MAX_CONNECTIONS; i++)
+    {
+        if (pool->conn[i].handle != AMDTP_CONN_NONE) n++;
+    }
+
+    return n;
+}
+
+void
+AmdtpConnSetQuota(amdtpConnPool_t *pool, uint8_t quota)
+{
+    pool->quota = quota;
+}
+
+void
+AmdtpConnPump(amdtpConnPool_t *pool)
+{
+    amdtpConn_t *c;
+    uint8_t i;
+
+    for (i = 0; i < AMDTP_MAX_CONNECTIONS; i++)
+    {
+        pool->conn[i].txCount = 0;
+    }
+
+    if (! ctrlFlush(pool))
+    {
+        return;
+    }
+
+    // the flag of a peer is cleared just before its pump, so the peers
+    // before it in this turn still see it waiting
+    for (i = 0; i < AMDTP_MAX_CONNECTIONS; i++)
+    {
+        c = &pool->conn[(pool->next + i) % AMDTP_MAX_CONNECTIONS];
+
+        if (c->handle != AMDTP_CONN_NONE)
+        {
+            c->txWaiting = false;
+            AmdtpCorePump(&c->core);
+        }
+    }
+
+    // without a quota the first connection always goes first
+    if (pool->quota)
+    {
+        pool->next = (pool->next + 1) % AMDTP_MAX_CONNECTIONS;
+    }
+}
+
+void
+AmdtpConnSetCompress(amdtpConnPool_t *pool, bool enable)
+{
+    uint8_t i;
+
+    for (i = 0; i < AMDTP_MAX_CONNECTIONS; i++)
+    {
+        AmdtpCoreSetCompress(&pool->conn[i].core, enable);
+    }
+}
+
+void
+AmdtpConnSetKey(amdtpConnPool_t *pool, const uint8_t *key)
+{
+    uint8_t i;
+
+    for (i = 0; i < AMDTP_MAX_CONNECTIONS; i++)
+    {
+        AmdtpCoreSetKey(&pool->conn[i].core, key);
+    }
+}
+
+void
+AmdtpConnSetWindow(amdtpConnPool_t *pool, uint8_t window)
+{
+    uint8_t i;
+
+    for (i = 0; i < AMDTP_MAX_CONNECTIONS; i++)
+    {
+        AmdtpCoreSetWindow(&pool->conn[i].core, window);
+    }
+}
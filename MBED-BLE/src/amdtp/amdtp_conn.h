@@ -0,0 +1,187 @@
+// ****************************************************************************
+//
+//  amdtp_conn.h
+//! @file
+//!
+//! @brief AMDTP for several connections at the same time.
+//!
+//! A fixed pool of AMDTP_MAX_CONNECTIONS entries, each with its own
+//! amdtpCore_t, taken when a peer connects (AmdtpConnOpen) and given back
+//! when it disconnects (AmdtpConnClose). The front-end looks up the entry of
+//! a received frame by the connection handle of the BLE stack. All entries
+//! share the callbacks of the front-end : the user of each call is the
+//! amdtpConn_t, its handle says which peer, pool->user is the front-end.
+//!
+//! The transmit buffers of the BLE stack are shared by all connections. The
+//! first peer to refill them after a notification has gone out would keep
+//! them full, so the pool schedules the data frames of the window mode :
+//!
+//! - AmdtpConnPump() (the stack has room again) starts a new turn at the
+//!   next connection each time, round robin.
+//! - in a turn a peer can send up to "quota" data frames while another peer
+//!   is waiting for room. After that its send returns false as if the stack
+//!   is full, and the core sends the rest in a later turn.
+//! - an ACK or CONTROL frame that does not fit is kept (the core does not
+//!   repeat them) and goes first in the next turn. Until then no data frames
+//!   are sent, else a full stack could starve the ACK of a peer.
+//!
+//! Stop-and-wait peers (one frame at a time) are never held back.
+//!
+//! added paulvha / October 2026
+//
+// ****************************************************************************
+
+#ifndef AMDTP_CONN_H
+#define AMDTP_CONN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "amdtp_core.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#ifndef AMDTP_MAX_CONNECTIONS
+#define AMDTP_MAX_CONNECTIONS       4       // peers at the same time, 1 - 8
+#endif
+
+#ifndef AMDTP_CONN_TX_QUOTA
+#define AMDTP_CONN_TX_QUOTA         1       // data frames per peer per turn when others wait
+#endif
+
+#define AMDTP_CONN_NONE             0xFFFF  // handle of a free entry
+
+struct amdtpConnPool;
+
+//
+// one connection
+//
+typedef struct
+{
+    uint16_t                handle;         // connection handle, AMDTP_CONN_NONE is free
+    bool                    txWaiting;      // a data frame was held back or the stack was full
+    uint8_t                 txCount;        // data frames sent in this turn
+    uint32_t                txHeld;         // data frames held back for other peers
+    uint32_t                ctrlLate;       // ACK / CONTROL frames sent in a later turn
+    uint8_t                 ctrlType;       // ACK / CONTROL frame waiting for room
+    uint8_t                 ctrlLen;        // 0 if none
+    uint8_t                 ctrl[AMDTP_ACK_SIZE];
+    int                     sendTimeout;    // event of the send timeout of the front-end, 0 if none
+    struct amdtpConnPool    *pool;
+    amdtpCore_t             core;
+}
+amdtpConn_t;
+
+typedef struct amdtpConnPool
+{
+    amdtpConn_t             conn[AMDTP_MAX_CONNECTIONS];
+    amdtpCoreCallbacks_t    cb;             // of the front-end, user is the amdtpConn_t
+    void                    *user;          // the front-end
+    uint8_t                 quota;          // 0 : no limit and no turns, first come first served
+    uint8_t                 next;           // first connection of the next turn
+}
+amdtpConnPool_t;
+
+//*****************************************************************************
+//
+//! @brief Empty the pool and set the callbacks for all connections. The
+//! user in cb is not used, each call gets the amdtpConn_t.
+//
+//*****************************************************************************
+extern void AmdtpConnPoolInit(amdtpConnPool_t *pool, const amdtpCoreCallbacks_t *cb, void *user);
+
+//*****************************************************************************
+//
+//! @brief Change the callbacks of all connections (as AmdtpCoreSetCallbacks(),
+//! the window is set back to the default).
+//
+//*****************************************************************************
+extern void AmdtpConnSetCallbacks(amdtpConnPool_t *pool, const amdtpCoreCallbacks_t *cb);
+
+//*****************************************************************************
+//
+//! @brief A peer connected. Takes a free entry and starts its core as
+//! AmdtpCoreInit(). When the handle is already open its core is started again.
+//!
+//! @return the connection or NULL when the pool is full.
+//
+//*****************************************************************************
+extern amdtpConn_t *AmdtpConnOpen(amdtpConnPool_t *pool, uint16_t handle);
+
+//*****************************************************************************
+//
+//! @brief The peer disconnected, stop its timer and free the entry.
+//
+//*****************************************************************************
+extern void AmdtpConnClose(amdtpConnPool_t *pool, uint16_t handle);
+
+//*****************************************************************************
+//
+//! @brief Stop the packet or stream in progress of one connection
+//! (AmdtpCoreResetTransfer()). The negotiated window and session key stay.
+//
+//*****************************************************************************
+extern void AmdtpConnResetTransfer(amdtpConnPool_t *pool, uint16_t handle);
+
+//*****************************************************************************
+//
+//! @brief Stop all connections and free all entries.
+//
+//*****************************************************************************
+extern void AmdtpConnCloseAll(amdtpConnPool_t *pool);
+
+//*****************************************************************************
+//
+//! @brief The connection of handle, NULL if it is not open.
+//
+//*****************************************************************************
+extern amdtpConn_t *AmdtpConnFind(amdtpConnPool_t *pool, uint16_t handle);
+
+//*****************************************************************************
+//
+//! @brief The open connection with the lowest entry, NULL if none. For the
+//! front-end calls that do not give a handle.
+//
+//*****************************************************************************
+extern amdtpConn_t *AmdtpConnFirst(amdtpConnPool_t *pool);
+
+//*****************************************************************************
+//
+//! @brief Number of open connections.
+//
+//*****************************************************************************
+extern uint8_t AmdtpConnCount(amdtpConnPool_t *pool);
+
+//*****************************************************************************
+//
+//! @brief Data frames per peer per turn while others wait. 0 is no limit and
+//! the turn always starts at the first connection, as a single AMDTPS was.
+//
+//*****************************************************************************
+extern void AmdtpConnSetQuota(amdtpConnPool_t *pool, uint8_t quota);
+
+//*****************************************************************************
+//
+//! @brief The stack has room again : a new turn, pump the connections round
+//! robin (AmdtpCorePump()).
+//
+//*****************************************************************************
+extern void AmdtpConnPump(amdtpConnPool_t *pool);
+
+//*****************************************************************************
+//
+//! @brief AmdtpCoreSetCompress() / AmdtpCoreSetKey() / AmdtpCoreSetWindow()
+//! on every entry, also for the peers that connect later.
+//
+//*****************************************************************************
+extern void AmdtpConnSetCompress(amdtpConnPool_t *pool, bool enable);
+extern void AmdtpConnSetKey(amdtpConnPool_t *pool, const uint8_t *key);
+extern void AmdtpConnSetWindow(amdtpConnPool_t *pool, uint8_t window);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AMDTP_CONN_H
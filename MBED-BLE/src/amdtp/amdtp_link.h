@@ -0,0 +1,169 @@
+// ****************************************************************************
+//
+//  amdtp_link.h
+//! @file
+//!
+//! @brief AMDTP bulk mode : the connection parameters follow the transfers.
+//!
+//! A connection that is made for low power (a long connection interval,
+//! peripheral latency, 1M PHY, 27 byte link layer packets) moves a few
+//! hundred bytes per second. A transfer of a few kB is much faster with a
+//! short interval, the 2M PHY and the longest link layer packets (data length
+//! extension), but those cost power when nothing is sent.
+//!
+//! amdtpLink_t asks for the "bulk" parameters when a transfer starts and for
+//! the "idle" parameters once there was no transfer for idleMs. It looks at
+//! the AMDTP core : a transfer is a packet of more than one frame being sent
+//! or received, or a stream, and only while frames move. Bulk is asked for a
+//! stream at once, for packets at the bulkPackets-th packet in a row (packets
+//! with less than 2 idle intervals between them). A single packet, as a
+//! command, a reply or a batch of telemetry every second, does not switch :
+//! the request takes about as long as one packet at the idle parameters.
+//!
+//! The front-end calls AmdtpLinkUpdate() after it gave frames to the core
+//! and at least every AMDTP_LINK_POLL_MS, and does the request callback with
+//! its BLE stack :
+//!
+//!   - interval, latency and timeout : a peripheral sends an L2CAP connection
+//!     parameter update request, a central the LE Connection Update command.
+//!     The central decides, the peripheral can get other values.
+//!   - PHY : LE Set PHY, both sides can start it. A controller without 2M
+//!     stays at 1M.
+//!   - data length : LE Set Data Length, both sides.
+//!
+//! Each takes some connection events before it is used (the instant of the
+//! link layer procedure is at least 6 events later), see
+//! extras/amdtp_sim/bulk_sim for what that costs per transfer size.
+//!
+//! The ATT MTU is not part of it : the client can exchange it only once per
+//! connection, so it asks the largest MTU at the start (it costs nothing when
+//! idle). Set that with AmdtpCoreSetMtu() as before.
+//!
+//! added paulvha / October 2026
+//
+// ****************************************************************************
+
+#ifndef AMDTP_LINK_H
+#define AMDTP_LINK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "amdtp_core.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#ifndef AMDTP_LINK_IDLE_MS
+#define AMDTP_LINK_IDLE_MS          2000    // no transfer for this long : back to idle
+#endif
+
+#ifndef AMDTP_LINK_BULK_PACKETS
+#define AMDTP_LINK_BULK_PACKETS     2       // packets in a row before bulk is asked, 1 is the first one
+#endif
+
+#define AMDTP_LINK_POLL_MS          100     // call AmdtpLinkUpdate() at least this often
+
+#define AMDTP_LINK_PHY_1M           1
+#define AMDTP_LINK_PHY_2M           2
+
+#define AMDTP_LINK_MIN_DATA_LENGTH  27      // link layer payload without data length extension
+#define AMDTP_LINK_MAX_DATA_LENGTH  251
+
+typedef struct
+{
+    uint16_t    intervalMin;        // connection interval, 1.25 ms units (6 - 3200)
+    uint16_t    intervalMax;
+    uint16_t    latency;            // connection events the peripheral may skip
+    uint16_t    timeout;            // supervision timeout, 10 ms units
+    uint8_t     phy;                // AMDTP_LINK_PHY_1M or AMDTP_LINK_PHY_2M
+    uint16_t    dataLength;         // link layer payload, 27 - 251 bytes
+}
+amdtpLinkParams_t;
+
+// 7.5 - 15 ms, 2M, 251 bytes
+#define AMDTP_LINK_BULK_DEFAULT     { 6, 12, 0, 200, AMDTP_LINK_PHY_2M, AMDTP_LINK_MAX_DATA_LENGTH }
+
+// 100 - 125 ms, the peripheral may skip 4 events, 1M (range), 27 bytes
+#define AMDTP_LINK_IDLE_DEFAULT     { 80, 100, 4, 600, AMDTP_LINK_PHY_1M, AMDTP_LINK_MIN_DATA_LENGTH }
+
+typedef enum
+{
+    AMDTP_LINK_UNKNOWN,             // as the connection was made
+    AMDTP_LINK_IDLE,
+    AMDTP_LINK_BULK
+}
+eAmdtpLinkMode_t;
+
+typedef struct
+{
+    // ask the BLE stack for these parameters, bulk says which set
+    void (*request)(void *user, const amdtpLinkParams_t *params, bool bulk);
+    void *user;
+
+    amdtpLinkParams_t   bulk;
+    amdtpLinkParams_t   idle;
+    uint32_t            idleMs;
+    uint8_t             bulkPackets;
+    bool                enabled;
+
+    eAmdtpLinkMode_t    mode;
+    uint32_t            lastActiveMs;   // a transfer moved frames
+    uint32_t            lastBusyMs;     // a transfer was going on, moving or not
+    uint32_t            lastFrames;     // data frames sent and received by the core
+    uint32_t            firstPacket;    // packets sent and received before this transfer
+
+    uint32_t            bulkRequests;
+    uint32_t            idleRequests;
+}
+amdtpLink_t;
+
+//*****************************************************************************
+//
+//! @brief Start with the default parameters, AMDTP_LINK_IDLE_MS and
+//! AMDTP_LINK_BULK_PACKETS, enabled.
+//
+//*****************************************************************************
+extern void AmdtpLinkInit(amdtpLink_t *link, void (*request)(void *user, const amdtpLinkParams_t *params, bool bulk),
+                          void *user);
+
+//*****************************************************************************
+//
+//! @brief Set the bulk and idle parameters (NULL keeps them), the time
+//! without a transfer before idle is asked and the packets in a row before
+//! bulk is asked.
+//
+//*****************************************************************************
+extern void AmdtpLinkSetParams(amdtpLink_t *link, const amdtpLinkParams_t *bulk, const amdtpLinkParams_t *idle,
+                               uint32_t idleMs, uint8_t bulkPackets);
+
+//*****************************************************************************
+//
+//! @brief Turn the requests on or off. Off asks for idle if bulk was asked.
+//
+//*****************************************************************************
+extern void AmdtpLinkEnable(amdtpLink_t *link, bool enable, uint32_t nowMs);
+
+//*****************************************************************************
+//
+//! @brief A new connection : its parameters are what the central chose.
+//! Idle is asked after idleMs without a transfer.
+//
+//*****************************************************************************
+extern void AmdtpLinkReset(amdtpLink_t *link, uint32_t nowMs);
+
+//*****************************************************************************
+//
+//! @brief Look at the core and ask for bulk or idle when needed.
+//!
+//! @return true in bulk mode
+//
+//*****************************************************************************
+extern bool AmdtpLinkUpdate(amdtpLink_t *link, const amdtpCore_t *core, uint32_t nowMs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AMDTP_LINK_H
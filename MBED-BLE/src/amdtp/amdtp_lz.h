@@ -0,0 +1,69 @@
+// ****************************************************************************
+//
+//  amdtp_lz.h
+//! @file
+//!
+//! @brief Small LZ compression for AMDTP packets.
+//!
+//! LZSS on one packet (max AMDTP_MAX_PAYLOAD_SIZE bytes), there is no state
+//! between packets, so a lost or repeated packet does not matter.
+//!
+//! The output is a row of groups : a control byte followed by up to 8 items.
+//! Bit n (LSB first) of the control byte tells item n is :
+//!
+//!   0 : a literal byte
+//!   1 : a match of 2 bytes [offset - 1, low 8 bits]
+//!                          [bit 7 : offset - 1, bit 8][bits 0-6 : length - 3]
+//!       copy length (3 - 130) bytes from offset (1 - 512) bytes back
+//!
+//! The compressor keeps the last position of each 3 byte hash, with
+//! AMDTP_LZ_HASH_BITS 8 that is 512 bytes on the stack. Decompression needs
+//! no memory except the output.
+//!
+//! added paulvha / October 2026
+//
+// ****************************************************************************
+
+#ifndef AMDTP_LZ_H
+#define AMDTP_LZ_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#ifndef AMDTP_LZ_HASH_BITS
+#define AMDTP_LZ_HASH_BITS      8
+#endif
+
+#define AMDTP_LZ_MIN_MATCH      3
+#define AMDTP_LZ_MAX_MATCH      130
+#define AMDTP_LZ_MAX_OFFSET     512
+
+//*****************************************************************************
+//
+//! @brief Compress len bytes from in to out.
+//!
+//! @return the compressed length, or 0 when it does not fit in max bytes.
+//!         Call with max = len - 1 to only accept a smaller result.
+//
+//*****************************************************************************
+extern uint16_t AmdtpLzCompress(const uint8_t *in, uint16_t len, uint8_t *out, uint16_t max);
+
+//*****************************************************************************
+//
+//! @brief Decompress len bytes from in to out.
+//!
+//! @return the decompressed length, or 0 when the input is not valid or
+//!         the result is larger than max
+//
+//*****************************************************************************
+extern uint16_t AmdtpLzDecompress(const uint8_t *in, uint16_t len, uint8_t *out, uint16_t max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AMDTP_LZ_H
@@ -79,6 +79,11 @@
  * Slow... but for many sensor the 10 seconds will be acceptable. Also because of many sensors will
  * not create 512 bytes of data. For bult transfer.. this not a good solution
  *
+ * October 2026
+ * The protocol now runs in amdtp_core.c, this file connects it to the BLE stack. After
+ * subscribing the client offers a sliding window (AmdtpNegotiate). When the server accepts,
+ * up to 8 chunks are in flight, the receiver reports the received chunks in a bitmap and only
+ * missing chunks are repeated. Older servers ignore the offer and keep stop-and-wait.
  */
 
 #include <string.h>
@@ -86,7 +91,7 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include "amdtpc_protocol.h"
-#include "../crc32.h"
+#include "sec_api.h"                    // SecRand() of the Cordio stack
 
 #if (defined AMDTPC_Debug) || (defined AMDTPC_SHOW_DATA)
 void debug_float_c (float f);
@@ -94,18 +99,13 @@ void debug_print_c(const char* f, const char* F, uint16_t L);
 void debug_printf_c(const char * fmt, ...);
 #endif
 
-/* Control block (removed un-used variables) */
-static struct
-{
-    amdtpCb_t           core;               // defined in amdtp_common.h
-}
-amdtpsCb;
-
 /**
  * @brief constructor and initialize variables
  */
 AMDTPC::AMDTPC()
 {
+    memset(&_core, 0, sizeof(_core));
+    set_callbacks();
 }
 
 //*****************************************************************************
@@ -123,42 +123,100 @@ AMDTPC::amdtpc_init()
         debug_print_c(__func__, __FILE__, __LINE__);
     #endif
 
-    memset(&amdtpsCb, 0, sizeof(amdtpsCb));
-
-    amdtpsCb.core.lastRxPktSn = 0;                  // keep track of serial number 0 .. 15
-    amdtpsCb.core.txPktSn = 0;
-
-    resetPkt(&amdtpsCb.core.rxPkt);                 // set buffers
-    amdtpsCb.core.rxPkt.data = rxPktBuf;
+    AmdtpCoreInit(&_core);                  // stop-and-wait, serial numbers 0
+    AmdtpCoreSetMtu(&_core, _attMtuSize);   // MTU exchange can be before discovery ends
+}
 
-    resetPkt(&amdtpsCb.core.txPkt);
-    amdtpsCb.core.txPkt.data = txPktBuf;
+//*****************************************************************************
+//! @brief stop the transfer in progress, keep the session (added October 2026)
+//*****************************************************************************
+void
+AMDTPC::amdtpc_reset()
+{
+    AmdtpCoreResetTransfer(&_core);
+}
 
-    resetPkt(&amdtpsCb.core.ackPkt);
-    amdtpsCb.core.ackPkt.data = ackPktBuf;
+//*****************************************************************************
+//! @brief connect the AMDTP core to this instance
+//*****************************************************************************
+void
+AMDTPC::set_callbacks()
+{
+    amdtpCoreCallbacks_t cb;
+
+    memset(&cb, 0, sizeof(cb));
+    cb.send = core_send;
+    cb.received = core_received;
+    cb.sent = core_sent;
+    cb.streamReceived = core_stream_received;
+    cb.streamDone = core_stream_done;
+    cb.writable = core_writable;
+    cb.random = core_random;
+    cb.user = this;
+
+    // the window mode needs a timer to repeat lost chunks
+    if (_event_queue) cb.timer = core_timer;
+
+    // cut-through delivery of received data packets
+    if (_on_part_cb) {
+        cb.partReceived = core_part_received;
+        cb.partDone = core_part_done;
+    }
 
-    amdtpsCb.core.attMtuSize = ATT_DEFAULT_MTU;     // needed to break a package is pieces
+    AmdtpCoreSetCallbacks(&_core, &cb);
+}
 
-    amdtpsCb.core.txState = AMDTP_STATE_TX_IDLE;    // enable sending
+//*****************************************************************************
+//! @brief set event queue for the timer (added October 2026)
+//*****************************************************************************
+void
+AMDTPC::set_event_queue(events::EventQueue *event_queue)
+{
+    _event_queue = event_queue;
+    set_callbacks();
 }
+
 //*****************************************************************************
 //! @brief Set new MTU size
 //*****************************************************************************
 void
 AMDTPC::UpdateMTU(uint16_t newSize)
 {
-    amdtpsCb.core.attMtuSize = newSize;
+    _attMtuSize = newSize;
+    AmdtpCoreSetMtu(&_core, newSize);
+}
+
+//*****************************************************************************
+//! @brief offer the window mode to the server
+//*****************************************************************************
+void
+AMDTPC::AmdtpNegotiate()
+{
+    AmdtpCoreNegotiate(&_core);
+}
+
+bool
+AMDTPC::AmdtpWindowed()
+{
+    return _core.window > 0;
+}
+
+//*****************************************************************************
+//! @brief compress the data packets that are sent, if the peer supports it
+//*****************************************************************************
+void
+AMDTPC::AmdtpSetCompress(bool enable)
+{
+    AmdtpCoreSetCompress(&_core, enable);
 }
 
 //*****************************************************************************
-//! @brief reset package
+//! @brief encrypt the data packets, the peer needs the same key
 //*****************************************************************************
 void
-AMDTPC::resetPkt(amdtpPacket_t *pkt)
+AMDTPC::AmdtpSetKey(const uint8_t *key)
 {
-    pkt->offset = 0;        // no data in buffer to start from
-    pkt->header.pktType = AMDTP_PKT_TYPE_UNKNOWN; // unknown what is left
-    pkt->len = 0;           // no length in buffer
+    AmdtpCoreSetKey(&_core, key);
 }
 
 //*****************************************************************************
@@ -176,7 +234,7 @@ void AMDTPC::on_data_received(mbed::Callback<void(uint8_t *data, uint16_t len)>
 //!
 //! @param[in] cb The callback object that will be called when ACK is ready to send
 //*****************************************************************************
-void AMDTPC::on_ACK_write(mbed::Callback<void(uint8_t *data, uint16_t len)> cb)
+void AMDTPC::on_ACK_write(mbed::Callback<bool(uint8_t *data, uint16_t len)> cb)
 {
     _on_data_ACK_cb = cb;
 }
@@ -186,26 +244,83 @@ void AMDTPC::on_ACK_write(mbed::Callback<void(uint8_t *data, uint16_t len)> cb)
 //!
 //! @param[in] cb The callback object that will be called when data is ready to send
 //*****************************************************************************
-void AMDTPC::on_data_write(mbed::Callback<void(uint8_t *data, uint16_t len)> cb)
+void AMDTPC::on_data_write(mbed::Callback<bool(uint8_t *data, uint16_t len)> cb)
 {
     _on_data_write_cb = cb;
 }
 
 //*****************************************************************************
-//! @brief check for type of packet (Data or ACK) added version 3.1
-//! return true for data packet
+//
+// calls from the AMDTP core
+//
 //*****************************************************************************
-bool AMDTPC::Check_type(uint16_t len, uint8_t *pValue)
+bool
+AMDTPC::core_send(void *user, eAmdtpPktType_t type, uint8_t *buf, uint16_t len)
 {
-  uint16_t header;
+  AMDTPC *tp = (AMDTPC *) user;
 
-  BYTES_TO_UINT16(header, &pValue[2]);              // second 2 bytes is header
-  if((header & PACKET_TYPE_BIT_MASK) >> PACKET_TYPE_BIT_OFFSET == AMDTP_PKT_TYPE_DATA)
-    return true;
+#ifdef AMDTPC_SHOW_DATA
+  debug_printf_c("\r\n=========== %s sent =====================\r\n", type == AMDTP_PKT_TYPE_DATA ? "Data" : "Ack");
+  for (uint16_t i =0; i < len; i++) debug_printf_c("0x%02X ", buf[i]);
+  debug_printf_c("\r\n");
+#endif
+
+  if (type == AMDTP_PKT_TYPE_DATA) {
+    if (tp->_on_data_write_cb)
+      return tp->_on_data_write_cb(buf, len);
+#ifdef AMDTPC_Debug
+    debug_printf_c("Error missing call back for DATA.\n");
+#endif
+  }
+  else if (tp->_on_data_ACK_cb) {
+    return tp->_on_data_ACK_cb(buf, len);
+  }
 
   return false;
 }
 
+// a complete packet with correct CRC has been received
+void
+AMDTPC::core_received(void *user, uint8_t *buf, uint16_t len)
+{
+  AMDTPC *tp = (AMDTPC *) user;
+
+  // finally we are going to user level to handle the request
+  if (tp->_on_data_cb)
+    tp->_on_data_cb(buf, len);
+
+#ifdef AMDTPC_SHOW_DATA
+  else {
+    debug_printf_c("\r\n=========== received data (no callback was set) =====================\r\n");
+
+    for (uint16_t i =0; i < len; i++) debug_printf_c("0x%02X ", buf[i]);
+    debug_printf_c("\r\n");
+  }
+#endif
+}
+
+// (re)start or stop the retransmission timer
+void
+AMDTPC::core_timer(void *user, uint32_t ms)
+{
+  AMDTPC *tp = (AMDTPC *) user;
+
+  if (tp->_timer_id) {
+    tp->_event_queue->cancel(tp->_timer_id);
+    tp->_timer_id = 0;
+  }
+
+  if (ms > 0)
+    tp->_timer_id = tp->_event_queue->call_in(std::chrono::milliseconds(ms), mbed::callback(tp, &AMDTPC::timer_expired));
+}
+
+void
+AMDTPC::timer_expired()
+{
+  _timer_id = 0;
+  AmdtpCoreTimeout(&_core);
+}
+
 //*****************************************************************************
 //! parse a received message
 //!
@@ -217,595 +332,196 @@ bool AMDTPC::Check_type(uint16_t len, uint8_t *pValue)
 //! AMDTP_STATUS_RECEIVE_DONE = message is complete and correct. Ready to go
 //! AMDTP_STATUS_RECEIVE_CONTINUE = need more data packages. we are not complete yet.
 //!
+//! The handle is not used, data and ACK are recognised from the packet
 //*****************************************************************************
 eAmdtpStatus_t
 AMDTPC::AmdtpReceivePkt(uint8_t handle, uint16_t len, uint8_t *pValue)
 {
-  amdtpPacket_t *pkt;
-
-  uint8_t dataIdx = 0;
-  uint32_t calDataCrc = 0;
-  uint16_t header = 0;
-
-  static bool FirstPacket = true;
-  static bool Ptype;
-
 #ifdef AMDTPC_Debug
   debug_print_c(__func__, __FILE__, __LINE__);
 #endif
 
-  // do NOT use the handle to determine whether this is RX or ACK
-  // the program has changed to sent ACK now also over RX, given that
-  // some BLE stacks are repeating whatever is received over notify.
-  // When a NEW package is expected, check for the right package first
-  // and remember that in a static bool.
+  eAmdtpStatus_t st = AmdtpCoreReceive(&_core, pValue, len);
 
-  if (FirstPacket){
-    Ptype = Check_type(len, pValue);
-    FirstPacket = false;
-  }
-
-  if (Ptype)  pkt = &amdtpsCb.core.rxPkt;
-  else  pkt = &amdtpsCb.core.ackPkt;
-
-  // len must include length (2) and header (2)
-  if (pkt->offset == 0 && len < AMDTP_PREFIX_SIZE_IN_PKT)
-  {
 #ifdef AMDTPC_Debug
-    debug_printf_c("\rInvalid packet size !!!\n");
+  if (st != AMDTP_STATUS_RECEIVE_CONTINUE && st != AMDTP_STATUS_RECEIVE_DONE)
+    debug_printf_c("\rReceive status %d\n", st);
 #endif
-    FirstPacket = true;
-    AmdtpSendReply(AMDTP_STATUS_INVALID_PKT_LENGTH, NULL, 0);
-    return AMDTP_STATUS_INVALID_PKT_LENGTH;
-  }
-
-  // if new packet (not received packet(s) before, in case full message needs multiple packets
-  // to be sent
-
-  if (pkt->offset == 0)
-  {
-    NewChunkReceived = 0;                             // keep track on received packages
-    BYTES_TO_UINT16(pkt->len, pValue);                // first 2 bytes is length
-    BYTES_TO_UINT16(header, &pValue[2]);              // second 2 bytes is header
-    pkt->header.pktType = (header & PACKET_TYPE_BIT_MASK) >> PACKET_TYPE_BIT_OFFSET; // mask = 0xf, offset is 12 : top 4 bits
-    pkt->header.pktSn = (header & PACKET_SN_BIT_MASK) >> PACKET_SN_BIT_OFFSET;       // mask = 0xf , ofsset is 8 : next for 4 bits
-    pkt->header.encrypted = (header & PACKET_ENCRYPTION_BIT_MASK) >> PACKET_ENCRYPTION_BIT_OFFSET;  // mask = 1, offset is 7, next bit
-    pkt->header.ackEnabled = (header & PACKET_ACK_BIT_MASK) >> PACKET_ACK_BIT_OFFSET; // mask 1, offset is 6, next bit
-    dataIdx = AMDTP_PREFIX_SIZE_IN_PKT;     // 4
-
-#ifdef AMDTPC_Debug
-    debug_printf_c("\rpkt len = 0x%x, pkt header = 0x%x :\n", pkt->len, header);
-    switch (pkt->header.pktType) {
-      case  AMDTP_PKT_TYPE_DATA:
-        debug_printf_c("\rtype = %d : DATA ", pkt->header.pktType);
-        break;
-      case  AMDTP_PKT_TYPE_ACK:
-        debug_printf_c("\rtype = %d : ACK ", pkt->header.pktType);
-        break;
-      case  AMDTP_PKT_TYPE_CONTROL:
-        debug_printf_c("\rtype = %d : Control ", pkt->header.pktType);
-        break;
-      default:
-        debug_printf_c("\rtype = %d : Unknown ", pkt->header.pktType);
-        break;
-    }
-    debug_printf_c("sn = %d, enc = %d, ackEnabled = %d\n", pkt->header.pktSn, pkt->header.encrypted, pkt->header.ackEnabled);
-#endif
-  }
-
-  // make sure we have enough space for new data
-  if (pkt->offset + len - dataIdx > AMDTP_PACKET_SIZE)   // make sure it fits in 512 + 4 +4 (max length defined amdtp_common.h:  512)
-  {
-#ifdef AMDTPC_Debug
-    debug_printf_c("\rNot enough buffer size!!!\n");
-#endif
-
-    resetPkt(pkt);
-    FirstPacket = true;
-    AmdtpSendReply(AMDTP_STATUS_INSUFFICIENT_BUFFER, NULL, 0);
-    return AMDTP_STATUS_INSUFFICIENT_BUFFER;
-  }
-
-  // copy new data into buffer and also save crc into it if it's the last packet in a message
-  // 4 bytes crc is included in pkt length
-
-  memcpy(pkt->data + pkt->offset, pValue + dataIdx, len - dataIdx); // skip the header
-  pkt->offset += (len - dataIdx);
-
-  // whole packet received
-  if (pkt->offset >= pkt->len)
-  {
-    // next time again a new packet of a new message
-    FirstPacket = true;
-
-    uint32_t peerCrc = 0;
-    //
-    // check CRC
-    //
-    BYTES_TO_UINT32(peerCrc, pkt->data + pkt->len - AMDTP_CRC_SIZE_IN_PKT);
-    calDataCrc = CalcCrc32(0xFFFFFFFFU, pkt->len - AMDTP_CRC_SIZE_IN_PKT, pkt->data);
-
-    if (peerCrc != calDataCrc)
-    {
-#ifdef AMDTPC_Debug
-      debug_printf_c("\rcrc error :\ncalDataCrc = 0x%x ", calDataCrc);
-      debug_printf_c("peerCrc = 0x%x\n", peerCrc);
-#endif
-
-      // reset pkt
-      resetPkt(pkt);
-
-      AmdtpSendReply(AMDTP_STATUS_CRC_ERROR, NULL, 0);
-      return AMDTP_STATUS_CRC_ERROR;
-    }
 
-    // we have it all, now handle request
-    AmdtpPacketHandler((eAmdtpPktType_t)pkt->header.pktType, pkt->len - AMDTP_CRC_SIZE_IN_PKT, pkt->data);
-
-    return AMDTP_STATUS_RECEIVE_DONE;
- }
-
-  // if requested to confirm packet received (not on last packet)
-  if (pkt->header.pktType == AMDTP_PKT_TYPE_DATA && pkt->header.ackEnabled){
-
-    // count this new packet (the packet count starts with 1)
-    NewChunkReceived++;
-    AmdtpSendControl(AMDTP_CONTROL_SEND_READY, &NewChunkReceived,1);
-  }
-
-  // not all had been received
-  return AMDTP_STATUS_RECEIVE_CONTINUE;
+  return st;
 }
 
 //*****************************************************************************
 //
-// AMDTP packet handler
-// what to do now a complete package has been RECEIVED ?
+// Send data to server (called from Sketch)
+// return :
+// -1  error
+//  0  sending of package has been completed
+//  1  Pending to Send next chunk of data
 //
 //*****************************************************************************
-void
-AMDTPC::AmdtpPacketHandler(eAmdtpPktType_t type, uint16_t len, uint8_t *buf)
+int AMDTPC::AmdtpSendData(uint8_t *buf, uint16_t len)
 {
 #ifdef AMDTPC_Debug
   debug_print_c(__func__, __FILE__, __LINE__);
 #endif
 
-  switch(type)
-  {
-    case AMDTP_PKT_TYPE_DATA:
-      //
-      // data package received
-      //
-
-      // record packet serial number
-      amdtpsCb.core.lastRxPktSn = amdtpsCb.core.rxPkt.header.pktSn;
-
-      AmdtpSendReply(AMDTP_STATUS_SUCCESS, NULL, 0);
-
-      // finally we are going to user level to handle the request
-      if (_on_data_cb)
-        _on_data_cb(buf, len);
-
-#ifdef AMDTPC_SHOW_DATA
-      else {
-            debug_printf_c("\r\n=========== received data (no callback was set) =====================\r\n");
-
-            for (uint16_t i =0; i < len; i++) debug_printf_c("0x%02X ", buf[i]);
-            debug_printf_c("\r\n");
-      }
-#endif
-      resetPkt(&amdtpsCb.core.rxPkt);
-      break;
-
-    case AMDTP_PKT_TYPE_ACK:
-    {
-      eAmdtpStatus_t status = (eAmdtpStatus_t)buf[0];
-
-      if (amdtpsCb.core.txState != AMDTP_STATE_WAITING_ACK){
-
-#ifdef AMDTPC_Debug
-        debug_printf_c("Warning : Received an unexpected ACK\n");
-#endif
-      }
-
-      amdtpsCb.core.txState = AMDTP_STATE_TX_IDLE;
-
-      if (status == AMDTP_STATUS_CRC_ERROR || status == AMDTP_STATUS_RESEND_REPLY)
-      {
-        // resend packet
-        AmdtpSendPacketHandler();
-      }
-      else
-      {
-        // increase packet serial number if send successfully
-        if (status == AMDTP_STATUS_SUCCESS)
-        {
-          amdtpsCb.core.txPktSn++;
-
-          if (amdtpsCb.core.txPktSn == 16)     // max 4 bits part of the header (so count 0 - 15)
-          {
-            amdtpsCb.core.txPktSn = 0;
-          }
-        }
-
-        // reset send packet
-        resetPkt(&amdtpsCb.core.txPkt);
-      }
+  eAmdtpStatus_t st = AmdtpCoreSend(&_core, buf, len);
 
-      resetPkt(&amdtpsCb.core.ackPkt);
-    }
-      break;
-
-  case AMDTP_PKT_TYPE_CONTROL:
-  {
-    eAmdtpControl_t control = (eAmdtpControl_t)buf[0];
-    uint8_t resendPktSn = buf[1];
-
-    // we have send a packet and as we have more chunks of data
-    // to send but requested from the peripheral a confirmation
-    // so we can send next part
-    if (control == AMDTP_CONTROL_SEND_READY)
-    {
-        NewChunkReceived = resendPktSn;
-        AmdtpSendPacketHandler();
-    }
-
-    else if (control == AMDTP_CONTROL_RESEND_REQ)
-    {
-
-      resetPkt(&amdtpsCb.core.rxPkt);
-
-      if (resendPktSn > amdtpsCb.core.lastRxPktSn)
-      {
-        AmdtpSendReply(AMDTP_STATUS_RESEND_REPLY, NULL, 0);
-      }
-      else if (resendPktSn == amdtpsCb.core.lastRxPktSn)
-      {
-        AmdtpSendReply(AMDTP_STATUS_SUCCESS, NULL, 0);
-      }
+  if(st != AMDTP_STATUS_SUCCESS){
 #ifdef AMDTPC_Debug
-      else
-      {
-         debug_printf_c("\rWarning : Can not act on Control package resendPktSn = %d, lastRxPktSn = %d\n", resendPktSn, amdtpsCb.core.lastRxPktSn);
-      }
-    }
-    else
-    {
-      debug_printf_c("\rWarning : Unexpected contrl request  = %d\n", control);
+    debug_printf_c("\rData sending failed, status = %d, tx state = %d\n", st, _core.txState);
 #endif
-    }
-
-    resetPkt(&amdtpsCb.core.ackPkt);
+    return -1;
   }
-    break;
 
-  default:
-    break;
-  }
+  if (! AmdtpCoreSendComplete(&_core)) return 1;
+
+  return 0;
 }
 
 //*****************************************************************************
 //
-// create packet to send
+// Is sending chunk of data to server complete
+//
+// return :
+// True : complete sending chunk
+// false : not complete sending
 //
 //*****************************************************************************
-void
-AMDTPC::AmdtpBuildPkt(eAmdtpPktType_t type, bool encrypted, bool enableACK, uint8_t *buf, uint16_t len)
+bool AMDTPC::AmdtpSendComplete()
 {
-#ifdef AMDTPC_Debug
-  debug_print_c(__func__, __FILE__, __LINE__);
-#endif
-  uint16_t header = 0;
-  uint32_t calDataCrc;
-  amdtpPacket_t *pkt;
-
-  if (type == AMDTP_PKT_TYPE_DATA)
-  {
-    pkt = &amdtpsCb.core.txPkt;
-    header = amdtpsCb.core.txPktSn << PACKET_SN_BIT_OFFSET;  // add 4 bit serial number to right offset
-  }
-  else
-  {
-    pkt = &amdtpsCb.core.ackPkt;                             // acknowledgement of earlier send data
-  }
-
-  //
-  // Prepare header frame to be sent first
-  //
-  // length
-  pkt->len = len + AMDTP_PREFIX_SIZE_IN_PKT + AMDTP_CRC_SIZE_IN_PKT;  // len of data + header & len (4) + CRC (4 ytes)
-  pkt->data[0]  = (len + AMDTP_CRC_SIZE_IN_PKT) & 0xff;               // LSB
-  pkt->data[1]  = ((len + AMDTP_CRC_SIZE_IN_PKT) >> 8) & 0xff;        // MSB length
-
-  // header
-  header = header | (type << PACKET_TYPE_BIT_OFFSET);                 // add 4 bit type
-  if (encrypted)
-  {
-    header = header | (1 << PACKET_ENCRYPTION_BIT_OFFSET);            // set encryption bit (not used really)
-  }
-
-  if (pkt->len > (amdtpsCb.core.attMtuSize - 3)) {
-    header = header | (1 << PACKET_ACK_BIT_OFFSET);                   // set controlbit to send reply on receipt of chunk / packet
-  }
-
-  pkt->data[2] = (header & 0xff);                                     // set header
-  pkt->data[3] = (header >> 8);
-
-  // copy data
-  memcpy(&(pkt->data[AMDTP_PREFIX_SIZE_IN_PKT]), buf, len);           // now add the data
-  calDataCrc = CalcCrc32(0xFFFFFFFFU, len, buf);                      // calculate the CRC
-
-  // add checksum
-  pkt->data[AMDTP_PREFIX_SIZE_IN_PKT + len] = (calDataCrc & 0xff);    // add the 32 bit CRC
-  pkt->data[AMDTP_PREFIX_SIZE_IN_PKT + len + 1] = ((calDataCrc >> 8) & 0xff);
-  pkt->data[AMDTP_PREFIX_SIZE_IN_PKT + len + 2] = ((calDataCrc >> 16) & 0xff);
-  pkt->data[AMDTP_PREFIX_SIZE_IN_PKT + len + 3] = ((calDataCrc >> 24) & 0xff);
-
-#ifdef AMDTPC_SHOW_DATA
-
-  if (type == AMDTP_PKT_TYPE_DATA)
-    debug_printf_c("\r\n=========== Data Prepared for sending ====================\r\n");
-  else
-    debug_printf_c("\r\n=========== Ack Prepared for sending =====================\r\n");
-
-  for (uint16_t i =0; i < pkt->len; i++) debug_printf_c("0x%02X ", pkt->data[i]);
-  debug_printf_c("\r\n");
-#endif
-
+  return AmdtpCoreSendComplete(&_core);
 }
 
 //*****************************************************************************
 //
-// Send control message to Receiver
+// Streams (added October 2026), see amdtp_core.h
 //
 //*****************************************************************************
-void
-AMDTPC::AmdtpSendControl(eAmdtpControl_t control, uint8_t *data, uint16_t len)
+int AMDTPC::AmdtpStreamOpen(uint32_t len)
 {
 #ifdef AMDTPC_Debug
   debug_print_c(__func__, __FILE__, __LINE__);
 #endif
 
-  uint8_t buf[ATT_DEFAULT_PAYLOAD_LEN] = {0};
-
-  buf[0] = control;
-
-  // add any data
-  if (len > 0)  memcpy(buf + 1, data, len);
+  eAmdtpStatus_t st = AmdtpCoreStreamOpen(&_core, len);
 
-  amdtpsSendAck(AMDTP_PKT_TYPE_CONTROL, false, false, buf, len + 1);
-}
-
-//*****************************************************************************
-//
-// Send Reply (ACK - type with status and optional data) to Sender
-//
-//*****************************************************************************
-void
-AMDTPC::AmdtpSendReply(eAmdtpStatus_t status, uint8_t *data, uint16_t len)
-{
+  if(st != AMDTP_STATUS_SUCCESS){
 #ifdef AMDTPC_Debug
-  debug_print_c(__func__, __FILE__, __LINE__);
+    debug_printf_c("\rStream open failed, status = %d, peer version = %d\n", st, _core.peerVersion);
 #endif
+    return -1;
+  }
 
-  uint8_t buf[ATT_DEFAULT_PAYLOAD_LEN] = {0}; // max payload length for most PDU on bluetooth
-
-  buf[0] = status;                    // first byte is status
-
-  // add any data
-  if (len > 0)  memcpy(buf + 1, data, len);
-
-  amdtpsSendAck(AMDTP_PKT_TYPE_ACK, false, false, buf, len + 1);
+  return 0;
 }
 
-//*****************************************************************************
-//!
-//! @brief  : send acknowledgement over the ACK handle
-//! @param type : ack or control
-//! @param encrypted : set encryption (not used anywhere.. but who knows in the future ??)
-//! @param enableACK : not used anywhere.. but who knows in the future ??
-//! @param buf : data to sent
-//! @param len : length of data to sent
-//*****************************************************************************
-void
-AMDTPC::amdtpsSendAck(eAmdtpPktType_t type, bool encrypted, bool enableACK, uint8_t *buf, uint16_t len)
+uint16_t AMDTPC::AmdtpStreamWrite(uint8_t *buf, uint16_t len)
 {
-#ifdef AMDTPC_Debug
-  debug_print_c(__func__, __FILE__, __LINE__);
-#endif
-
-  // create packet with CRC etc
-  AmdtpBuildPkt(type, encrypted, enableACK, buf, len);
-
-  if (_on_data_ACK_cb)
-      _on_data_ACK_cb(amdtpsCb.core.ackPkt.data,amdtpsCb.core.ackPkt.len);
-  else
-      printf("Error missing call back for ACK \r\n");
+  return AmdtpCoreStreamWrite(&_core, buf, len);
 }
 
-//*****************************************************************************
-//!
-//! Send data to peripheral / server
-//!
-//! -1  error
-//!  0  sending of package has been completed
-//!  1  Sending data in multiple packages
-//*****************************************************************************
-int AMDTPC::AmdtpSendData(uint8_t *buf, uint16_t len)
+int AMDTPC::AmdtpStreamClose()
 {
-#ifdef AMDTPC_Debug
-  debug_print_c(__func__, __FILE__, __LINE__);
-#endif
-                                                        // encrypted, enableACK
-  eAmdtpStatus_t st = AmdtpsSendPacket(AMDTP_PKT_TYPE_DATA, false, false, buf, len);
+  return AmdtpCoreStreamClose(&_core) == AMDTP_STATUS_SUCCESS ? 0 : -1;
+}
 
-  if(st != AMDTP_STATUS_SUCCESS) return -1;
+void AMDTPC::on_stream_received(mbed::Callback<void(uint8_t *data, uint16_t len, uint32_t offset)> cb)
+{
+  _on_stream_cb = cb;
+}
 
-  if (SendingNOtComplete) return 1;
+void AMDTPC::on_stream_done(mbed::Callback<void(eAmdtpStatus_t status, uint32_t len)> cb)
+{
+  _on_stream_done_cb = cb;
+}
 
-  return 0;
+void AMDTPC::on_stream_writable(mbed::Callback<void()> cb)
+{
+  _on_writable_cb = cb;
 }
 
-//******************************************************************
-//! Is sending chunk of data to peripheral completed
-//!
-//! return :
-//! True : complete sending chunk
-//! false : not complete sending
-//!
-//******************************************************************
-bool AMDTPC::AmdtpSendComplete()
+void AMDTPC::on_stream_sent(mbed::Callback<void(eAmdtpStatus_t status)> cb)
 {
-  return(! SendingNOtComplete);
+  _on_sent_cb = cb;
 }
 
-//*****************************************************************************
-//
-// CONTINUE sending data to client (called from Sketch)
-// return :
-// -1  error
-//  0  sending of package has been completed
-//  1  Need to return to send next chunk of data
-//
-//*****************************************************************************
-/*
-int AMDTPC::AmdtpContSendData()
+void
+AMDTPC::core_sent(void *user, eAmdtpStatus_t status)
 {
-  if (! SendingNOtComplete) return -1;
+  AMDTPC *tp = (AMDTPC *) user;
 
-  AmdtpSendPacketHandler();
+  if (tp->_on_sent_cb) tp->_on_sent_cb(status);
+}
 
-  if (SendingNOtComplete) return 1;
+void
+AMDTPC::core_stream_received(void *user, uint8_t *buf, uint16_t len, uint32_t offset)
+{
+  AMDTPC *tp = (AMDTPC *) user;
 
-  return 0;
+  if (tp->_on_stream_cb) tp->_on_stream_cb(buf, len, offset);
 }
-*/
-//*****************************************************************************
-//
-//! @brief Send data to Client via notification
-//!
-//! @param type - packet type
-//! @param encrypted - is packet encrypted
-//! @param enableACK - does client need to response
-//! @param buf - data
-//! @param len - data length
-//!
-//! @return status
-//! AMDTP_STATUS_TX_NOT_READY;
-//! AMDTP_STATUS_BUSY
-//! AMDTP_STATUS_INVALID_PKT_LENGTH
-//! AMDTP_STATUS_SUCCESS
-//
-//*****************************************************************************
-eAmdtpStatus_t
-AMDTPC::AmdtpsSendPacket(eAmdtpPktType_t type, bool encrypted, bool enableACK, uint8_t *buf, uint16_t len)
+
+void
+AMDTPC::core_stream_done(void *user, eAmdtpStatus_t status, uint32_t len)
 {
-#ifdef AMDTPC_Debug
-  debug_print_c(__func__, __FILE__, __LINE__);
-#endif
+  AMDTPC *tp = (AMDTPC *) user;
 
-   //
-   // Check if the service is idle to send
-   //
-   if (amdtpsCb.core.txState != AMDTP_STATE_TX_IDLE)
-   {
 #ifdef AMDTPC_Debug
-    debug_printf_c("\rData sending failed, tx state = %d\n", amdtpsCb.core.txState);
+  debug_printf_c("\rStream received, status = %d, length %d\n", status, len);
 #endif
-    return AMDTP_STATUS_BUSY;
-  }
 
-  //
-  // Check if data length is valid
-  //
-  if ( len > AMDTP_MAX_PAYLOAD_SIZE )
-  {
-#ifdef AMDTPC_Debug
-    debug_printf_c("\rData sending failed, exceed maximum payload, len = %d.\n", len);
-#endif
-    return AMDTP_STATUS_INVALID_PKT_LENGTH;
-  }
-
-  // build packet to sent
-  AmdtpBuildPkt(type, encrypted, enableACK, buf, len);
+  if (tp->_on_stream_done_cb) tp->_on_stream_done_cb(status, len);
+}
 
-  // send packet
-  AmdtpSendPacketHandler();
+void
+AMDTPC::core_writable(void *user)
+{
+  AMDTPC *tp = (AMDTPC *) user;
 
-  return AMDTP_STATUS_SUCCESS;
+  if (tp->_on_writable_cb) tp->_on_writable_cb();
 }
 
 //*****************************************************************************
-//!
-//! sent data package. This will add the status around checks and break down
-//! in chuncks
-//!
+//! cut-through (added October 2026)
 //*****************************************************************************
-void
-AMDTPC::AmdtpSendPacketHandler()
+void AMDTPC::on_data_part(mbed::Callback<void(uint8_t *data, uint16_t len, uint16_t offset)> cb)
 {
-#ifdef AMDTPC_Debug
-  debug_print_c(__func__, __FILE__, __LINE__);
-#endif
-
-  uint16_t transferSize;
-  uint16_t remainingBytes;
-  static uint8_t PacketCount;
+  _on_part_cb = cb;
+  set_callbacks();
+}
 
-  amdtpPacket_t *txPkt = &amdtpsCb.core.txPkt;
+void AMDTPC::on_data_done(mbed::Callback<void(eAmdtpStatus_t status, uint16_t len)> cb)
+{
+  _on_part_done_cb = cb;
+}
 
-  if ( amdtpsCb.core.txState == AMDTP_STATE_TX_IDLE ) {
-    txPkt->offset = 0;
-    amdtpsCb.core.txState = AMDTP_STATE_SENDING;
-    PacketCount = 0;
-  }
+void
+AMDTPC::core_part_received(void *user, uint8_t *buf, uint16_t len, uint16_t offset)
+{
+  AMDTPC *tp = (AMDTPC *) user;
 
-  if ( amdtpsCb.core.txState == AMDTP_STATE_SENDING ) {
+  tp->_on_part_cb(buf, len, offset);
+}
 
-#ifdef AMDTPC_Debug
-    if (SendingNOtComplete) {
-        if (PacketCount != NewChunkReceived)
-            printf("Warning: Packages out of sequence. Got %d, expected %d.\n", NewChunkReceived, PacketCount);
-    }
-#endif
+void
+AMDTPC::core_part_done(void *user, eAmdtpStatus_t status, uint16_t len)
+{
+  AMDTPC *tp = (AMDTPC *) user;
 
-    // send small pieces of the packet. It just restricts sending to mtusize -3
-    // assumed mtusize is set during amdtpc_init()
-    if (txPkt->offset < txPkt->len)
-    {
-        remainingBytes = txPkt->len - txPkt->offset;
-        transferSize = ((amdtpsCb.core.attMtuSize - 3) > remainingBytes)
-                                            ? remainingBytes
-                                            : (amdtpsCb.core.attMtuSize - 3);
-
-        // send data packet to the characteristic
-        if (_on_data_write_cb)
-            _on_data_write_cb(&txPkt->data[txPkt->offset], transferSize);
-        else {
 #ifdef AMDTPC_Debug
-            debug_printf_c("Error missing call back for DATA.\n");
+  if (status != AMDTP_STATUS_SUCCESS) debug_printf_c("\rData packet failed, status = %d, length %d\n", status, len);
 #endif
-            return;
-        }
 
-        txPkt->offset += transferSize;
-
-        // check whether we are done
-        if(txPkt->offset >= txPkt->len) {
-
-            // done sent packet
-            amdtpsCb.core.txState = AMDTP_STATE_WAITING_ACK;
-            SendingNOtComplete = false;
-            return;
-       }
-       else {
-            // update packet count
-            PacketCount++;
+  if (tp->_on_part_done_cb) tp->_on_part_done_cb(status, len);
+}
 
-            SendingNOtComplete = true;
-        }
-    }
-  }
+void
+AMDTPC::core_random(void *user, uint8_t *buf, uint16_t len)
+{
+  // random from the controller (HCI LE Rand), as used by the stack for its own keys
+  SecRand(buf, (uint8_t) len);
 }
 
 #if (defined AMDTPC_Debug) || (defined AMDTPC_SHOW_DATA)
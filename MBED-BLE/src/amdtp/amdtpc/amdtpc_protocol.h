@@ -51,7 +51,9 @@
 #define AMDTPC_COMMON_H
 
 #include "../amdtp_common.h"
+#include "../amdtp_core.h"
 #include "ble/BLE.h"
+#include "events/EventQueue.h"
 
 /* BLE_DEBUG will show the routines and debug information
  * AMDTP_SHOW_DATA will show the data being received and sent
@@ -63,7 +65,7 @@
 
 // Server version
 #define MAJOR_SERVERVERSION 1         // new features implemented that require update to client
-#define MINOR_SERVERVERSION 0         // bug fixes, better calculation / layout
+#define MINOR_SERVERVERSION 1         // bug fixes, better calculation / layout
 
 //*****************************************************************************
 //
@@ -81,6 +83,12 @@ class AMDTPC
      */
     void amdtpc_init();
 
+    /**
+     * stop the packet or stream in progress, after a timeout. The
+     * negotiated window and session key stay (added October 2026)
+     */
+    void amdtpc_reset();
+
     /**
      * user program to store any data received from connected device
      */
@@ -95,7 +103,7 @@ class AMDTPC
      * return
      * -1  error
      *  0  sending of package has been completed
-     *  1  Need to return to send next chunk of data (call AmdtpContSendData())
+     *  1  Pending, the next chunks are sent when the server is ready
      */
     int AmdtpSendData(uint8_t *buf, uint16_t len);
 
@@ -115,56 +123,142 @@ class AMDTPC
 
     /**
      * set call back for sending formatted ACK to server
+     * return false if it could not be written
      */
-    void on_ACK_write(mbed::Callback<void(uint8_t *data, uint16_t len)> cb);
+    void on_ACK_write(mbed::Callback<bool(uint8_t *data, uint16_t len)> cb);
 
     /**
      * set call back for sending formatted data to server
+     * return false if it could not be written
      */
-    void on_data_write(mbed::Callback<void(uint8_t *data, uint16_t len)> cb);
+    void on_data_write(mbed::Callback<bool(uint8_t *data, uint16_t len)> cb);
 
     /**
      *  if new MTU size has been agreed with Server / peripheral
      */
     void UpdateMTU(uint16_t newSize);
 
-private:
+    /**
+     * set the event queue for the retransmission timer. Without it only
+     * stop-and-wait is used (added October 2026)
+     */
+    void set_event_queue(events::EventQueue *event_queue);
+
+    /**
+     * offer the sliding window mode to the server, after subscribing
+     */
+    void AmdtpNegotiate();
+
+    /**
+     * true when the window mode has been agreed with the server.
+     * The frames can then be written without response.
+     */
+    bool AmdtpWindowed();
+
+    /**
+     * compress the data packets that are sent (amdtp_lz.h), only when the
+     * peer has AMDTP version 3 or later. Off by default (added October 2026)
+     */
+    void AmdtpSetCompress(bool enable);
+
+    /**
+     * encrypt the data packets with AES-CCM (amdtp_ccm.h) with this key of
+     * 16 bytes, NULL is off. The peer needs the same key and AMDTP version 4,
+     * the session key is agreed at the negotiation. With a key only encrypted
+     * data is sent and accepted. Set before connecting (added October 2026)
+     */
+    void AmdtpSetKey(const uint8_t *key);
+
+    /**
+     * send a stream of len bytes, larger than AMDTP_MAX_PAYLOAD_SIZE
+     * (AMDTP_STREAM_LEN_UNKNOWN if not known). Write the data in parts with
+     * AmdtpStreamWrite() and end with AmdtpStreamClose(). Needs a peer that
+     * supports streams (added October 2026)
+     *
+     * return
+     * -1  error (not connected, busy or not supported by the peer)
+     *  0  stream is open
+     */
+    int AmdtpStreamOpen(uint32_t len);
 
-    bool Check_type(uint16_t len, uint8_t *pValue);
+    /**
+     * add data to the stream
+     * return the number of bytes accepted. When less than len, write the
+     * rest after the call back set with on_stream_writable()
+     */
+    uint16_t AmdtpStreamWrite(uint8_t *buf, uint16_t len);
 
-    void AmdtpBuildPkt(eAmdtpPktType_t type, bool encrypted, bool enableACK, uint8_t *buf, uint16_t len);
+    /**
+     * end the stream. AmdtpSendComplete() is true once the peer has
+     * received all, the call back set with on_stream_sent() gives the result
+     */
+    int AmdtpStreamClose();
 
-    void AmdtpSendReply( eAmdtpStatus_t status, uint8_t *data, uint16_t len);
+    /**
+     * call backs for a stream that is received : each part as it comes in
+     * and the result (status, total length) at the end
+     */
+    void on_stream_received(mbed::Callback<void(uint8_t *data, uint16_t len, uint32_t offset)> cb);
+    void on_stream_done(mbed::Callback<void(eAmdtpStatus_t status, uint32_t len)> cb);
 
-    void AmdtpSendControl( eAmdtpControl_t control, uint8_t *data, uint16_t len);
+    /**
+     * call backs for a stream that is sent : room to write again, and the
+     * result of the stream (or of a packet sent with AmdtpSendData())
+     */
+    void on_stream_writable(mbed::Callback<void()> cb);
+    void on_stream_sent(mbed::Callback<void(eAmdtpStatus_t status)> cb);
 
-    void AmdtpSendPacketHandler();
+    /**
+     * cut-through : each part of a received data packet as it comes in,
+     * before the CRC is known, and the result (status, length) at the end.
+     * The call back set with on_data_received() is then not used. Streams
+     * are not changed (added October 2026)
+     */
+    void on_data_part(mbed::Callback<void(uint8_t *data, uint16_t len, uint16_t offset)> cb);
+    void on_data_done(mbed::Callback<void(eAmdtpStatus_t status, uint16_t len)> cb);
 
-    void AmdtpPacketHandler(eAmdtpPktType_t type, uint16_t len, uint8_t *buf);
+private:
 
-    void resetPkt(amdtpPacket_t *pkt);
+    // protocol state, see amdtp_core.h
+    amdtpCore_t _core;
 
-    void amdtpsSendAck(eAmdtpPktType_t type, bool encrypted, bool enableACK, uint8_t *buf, uint16_t len);
+    // calls from the AMDTP core
+    static bool core_send(void *user, eAmdtpPktType_t type, uint8_t *buf, uint16_t len);
+    static void core_received(void *user, uint8_t *buf, uint16_t len);
+    static void core_timer(void *user, uint32_t ms);
+    static void core_sent(void *user, eAmdtpStatus_t status);
+    static void core_stream_received(void *user, uint8_t *buf, uint16_t len, uint32_t offset);
+    static void core_stream_done(void *user, eAmdtpStatus_t status, uint32_t len);
+    static void core_writable(void *user);
+    static void core_part_received(void *user, uint8_t *buf, uint16_t len, uint16_t offset);
+    static void core_part_done(void *user, eAmdtpStatus_t status, uint16_t len);
+    static void core_random(void *user, uint8_t *buf, uint16_t len);
+    void timer_expired();
 
-    eAmdtpStatus_t AmdtpsSendPacket(eAmdtpPktType_t type, bool encrypted, bool enableACK, uint8_t *buf, uint16_t len);
+    void set_callbacks();
 
-    uint8_t rxPktBuf[AMDTP_PACKET_SIZE];        // about 512 + 4 + 4
-    uint8_t txPktBuf[AMDTP_PACKET_SIZE];
-    uint8_t txDecode[AMDTP_PACKET_SIZE];
-    uint8_t ackPktBuf[AMDTP_ACK_SIZE];
+    events::EventQueue *_event_queue = nullptr;
+    int _timer_id = 0;
+    uint16_t _attMtuSize = ATT_DEFAULT_MTU;
 
     // store the user instructed function for call back
     mbed::Callback<void(uint8_t *data, uint16_t len)> _on_data_cb;
 
-    // in case as running as CLIENT, call back to write formatted ACK data to server
-    mbed::Callback<void(uint8_t *data, uint16_t len)> _on_data_ACK_cb;
+    // streams
+    mbed::Callback<void(uint8_t *data, uint16_t len, uint32_t offset)> _on_stream_cb;
+    mbed::Callback<void(eAmdtpStatus_t status, uint32_t len)> _on_stream_done_cb;
+    mbed::Callback<void()> _on_writable_cb;
+    mbed::Callback<void(eAmdtpStatus_t status)> _on_sent_cb;
 
-    // in case as running as CLIENT, call back to write formatted data to server
-    mbed::Callback<void(uint8_t *data, uint16_t len)> _on_data_write_cb;
+    // cut-through
+    mbed::Callback<void(uint8_t *data, uint16_t len, uint16_t offset)> _on_part_cb;
+    mbed::Callback<void(eAmdtpStatus_t status, uint16_t len)> _on_part_done_cb;
 
-    bool SendingNOtComplete = false;
+    // in case as running as CLIENT, call back to write formatted ACK data to server
+    mbed::Callback<bool(uint8_t *data, uint16_t len)> _on_data_ACK_cb;
 
-    uint8_t NewChunkReceived;
+    // in case as running as CLIENT, call back to write formatted data to server
+    mbed::Callback<bool(uint8_t *data, uint16_t len)> _on_data_write_cb;
 };
 
 #endif // AMDTPC_COMMON_H
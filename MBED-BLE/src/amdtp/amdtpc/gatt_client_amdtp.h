@@ -19,6 +19,13 @@
   But has many more features added
 
   Version 1.0 / January 2022 / paulvha
+
+  Version 1.1 / October 2026 / paulvha
+   - offer the AMDTP sliding window mode after subscribing
+   - write without response in window mode
+   - pass the agreed MTU to AMDTP
+   - streams larger than 512 bytes (StreamOpen / StreamWrite / StreamClose)
+   - a send timeout stops only the transfer, the session key stays
  */
 /*****************************************************************************
  * this file contains initializing AMDTP:
@@ -51,6 +58,15 @@
 // hardcoded call back to Sketch
 extern void StoreDataReceived(uint8_t *data, uint16_t len);
 
+// optional call backs to sketch for a received stream (added October 2026)
+extern void StoreStreamReceived(uint8_t *data, uint16_t len, uint32_t offset) __attribute__((weak));
+extern void StreamReceivedDone(eAmdtpStatus_t status, uint32_t len) __attribute__((weak));
+
+// optional cut-through call backs to sketch, when present StoreDataReceived() is
+// not called but each part of a data packet as it arrives (added October 2026)
+extern void StoreDataPart(uint8_t *data, uint16_t len, uint16_t offset) __attribute__((weak));
+extern void DataPartDone(eAmdtpStatus_t status, uint16_t len) __attribute__((weak));
+
 // wait max 15 seconds
 static const std::chrono::milliseconds TimeOutSending = 15000ms;
 
@@ -104,6 +120,9 @@ public:
     _client = &_ble->gattClient();
     _gap = &_ble->gap();              // needed for terminate / disconnect
 
+    // needed for the AMDTP retransmission timer
+    _tp.set_event_queue(_event_queue);
+
     // initialize the needed service and characteristics
     AddServiceFilter(String (ATT_UUID_AMDTP_SERVICE));
 
@@ -115,6 +134,12 @@ public:
     _tp.on_ACK_write(mbed::callback(this, &GattClientAMDTP::Write_ACK_Char));
     _tp.on_data_write(mbed::callback(this, &GattClientAMDTP::Write_data_Char));
     _tp.on_data_received(mbed::callback(this, &GattClientAMDTP::Data_From_AMDTP));
+    _tp.on_stream_received(mbed::callback(this, &GattClientAMDTP::Stream_From_AMDTP));
+    _tp.on_stream_done(mbed::callback(this, &GattClientAMDTP::Stream_Done_AMDTP));
+    if (StoreDataPart) {
+      _tp.on_data_part(mbed::callback(StoreDataPart));
+      _tp.on_data_done(mbed::callback(this, &GattClientAMDTP::Data_Done_AMDTP));
+    }
   }
 
   /**
@@ -131,6 +156,7 @@ public:
 
     // sending in chunks, set timeout on receiving
     if (ret == 1) {
+        if (cancelhandle > 0) _event_queue->cancel(cancelhandle);
         cancelhandle = _event_queue->call_in(TimeOutSending,[this]() { TimedOutSend(); });
     }
     return ret;
@@ -141,20 +167,40 @@ public:
    */
   void TimedOutSend()
   {
-      if (_tp.AmdtpSendComplete()){
-        if (cancelhandle > 0) {
-            _event_queue->cancel(cancelhandle);
-            cancelhandle = 0;
-        }
+      cancelhandle = 0;
 
-      }
-      else {
+      if (! _tp.AmdtpSendComplete()) {
         printf("%s: Failed to get response data from Central\n",__FILE__);
-        // reset all pointers of the amdtp service
-        _tp.amdtpc_init();
+        // stop the transfer, the negotiated window and session key stay
+        _tp.amdtpc_reset();
       }
   }
 
+ /**
+  * Send a stream of len bytes (can be more than 512) to the Server with AMDTP.
+  * Write the data with StreamWrite() and end with StreamClose(),
+  * IsSendingComplete() is true once all has been received.
+  *
+  * return:
+  * -1  error (not connected, busy or the Server does not support streams)
+  *  0  stream is open
+  */
+  int StreamOpen(uint32_t len)
+  {
+    return _tp.AmdtpStreamOpen(len);
+  }
+
+  /* return the number of bytes taken, try the rest again a little later */
+  uint16_t StreamWrite(uint8_t *sdata, uint16_t slen)
+  {
+    return _tp.AmdtpStreamWrite(sdata, slen);
+  }
+
+  int StreamClose()
+  {
+    return _tp.AmdtpStreamClose();
+  }
+
  /**
    * Check that all packages have been sent (in case multiple chunk are needed)
    *
@@ -306,8 +352,10 @@ public:
       //for (uint16_t i =0; i < len ; i++ ) printf("%x ", data[i]);
       //printf("\r\n");
 
+      // in window mode more frames are in flight, a write request would
+      // block until the server has responded to the previous one
       ble_error_t error = _client->write(
-        GattClient::GATT_OP_WRITE_REQ,  //GATT_OP_WRITE_CMD,
+        _tp.AmdtpWindowed() ? GattClient::GATT_OP_WRITE_CMD : GattClient::GATT_OP_WRITE_REQ,
         _connection_handle,
         _CharUUIDs[indx].handle,
         len,
@@ -325,14 +373,33 @@ public:
    * reply to all when a notify characteristic is updated. hence we
    * now use the RX (for server/peripheral) characteristic
    */
-  void Write_ACK_Char(uint8_t *data, uint16_t len)
+  bool Write_ACK_Char(uint8_t *data, uint16_t len)
   {
-    WriteChar(RX, data, len);
+    return WriteChar(RX, data, len);
   }
 
-  void Write_data_Char(uint8_t *data, uint16_t len)
+  bool Write_data_Char(uint8_t *data, uint16_t len)
   {
-    WriteChar(RX, data, len) ;    // what is RX for server is TX for client
+    return WriteChar(RX, data, len) ;    // what is RX for server is TX for client
+  }
+
+  /**
+   * call backs from AMDTP for a received stream, forwarded to the sketch
+   * when it has the functions
+   */
+  void Stream_From_AMDTP(uint8_t *data, uint16_t len, uint32_t offset)
+  {
+    if (StoreStreamReceived) StoreStreamReceived(data, len, offset);
+  }
+
+  void Stream_Done_AMDTP(eAmdtpStatus_t status, uint32_t len)
+  {
+    if (StreamReceivedDone) StreamReceivedDone(status, len);
+  }
+
+  void Data_Done_AMDTP(eAmdtpStatus_t status, uint16_t len)
+  {
+    if (DataPartDone) DataPartDone(status, len);
   }
 
   /**
@@ -374,6 +441,7 @@ public:
   {
     _connection_handle = event.getConnectionHandle();
     _DiscoverySuccess = false;
+    _tp.UpdateMTU(ATT_DEFAULT_MTU);     // until the MTU exchange
 
     // setup the event handlers called during the process
     _client->onDataWritten().add(as_cb(&Self::when_descriptor_written));
@@ -655,6 +723,7 @@ private:
     // did we find all the characteristics
     if (_CharUUIDs[RX].handle && _CharUUIDs[TX].handle && _CharUUIDs[ACK].handle) {
       _tp.amdtpc_init();
+      _tp.AmdtpNegotiate();         // all subscribed, offer the window mode
       _DiscoverySuccess = true;
     }
   }
@@ -914,7 +983,6 @@ private:
 
   /**
   * Implementation of GattClient::EventHandler::onAttMtuChange event
-  * TODO :
   */
   virtual void onAttMtuChange(
     ble::connection_handle_t connectionHandle,
@@ -927,6 +995,8 @@ private:
           attMtuSize
           /* maximum size of an attribute written in a single operation is one less */
       );
+
+      _tp.UpdateMTU(attMtuSize);
     }
 
   /**
@@ -16,6 +16,8 @@
  * @brief AmbiqMicro Data Transfer Protocol service definition
  *
  * paulvha / January 2022
+ *
+ * October 2026 : TX and ACK notification to one connection
  */
 
 #ifndef MBED_BLE_SVC_AMDTPS_H
@@ -131,26 +133,50 @@ public:
        // printf("amdtpServ.h update RX: len %d handle : %d, numbytes %d\r\n", len, amdtp_RX.getValueHandle(), _RX.getNumValueBytes());
     }
 
-    void TX_update(uint8_t *data, uint8_t len) {
+    bool TX_update(uint8_t *data, uint8_t len) {
         _TX.update(data, len);
-        _ble.gattServer().write(
+        return _ble.gattServer().write(
             amdtp_TX.getValueHandle(),
             _TX.getPointer(),
             _TX.getNumValueBytes()
-        );
+        ) == BLE_ERROR_NONE;
        // printf("amdtpServ.h update TX: handle %d, len %d handle : %d, numbytes %d\r\n", amdtp_TX.getValueHandle(), len, amdtp_TX.getValueHandle(), _TX.getNumValueBytes());
     }
 
-    void ACK_update(uint8_t *data, uint8_t len) {
+    bool ACK_update(uint8_t *data, uint8_t len) {
         _ACK.update(data, len);
-        _ble.gattServer().write(
+        return _ble.gattServer().write(
             amdtp_ACK.getValueHandle(),
             _ACK.getPointer(),
             _ACK.getNumValueBytes()
-        );
+        ) == BLE_ERROR_NONE;
        // printf("amdtpServ.h update ACK: len %d handle : %d, numbytes %d\r\n", len, amdtp_ACK.getValueHandle(), _ACK.getNumValueBytes());
     }
 
+    /**
+     * As above, but the notification only goes to the client on connection
+     * conn, for AMDTP with several clients at the same time (October 2026)
+     */
+    bool TX_update(ble::connection_handle_t conn, uint8_t *data, uint8_t len) {
+        _TX.update(data, len);
+        return _ble.gattServer().write(
+            conn,
+            amdtp_TX.getValueHandle(),
+            _TX.getPointer(),
+            _TX.getNumValueBytes()
+        ) == BLE_ERROR_NONE;
+    }
+
+    bool ACK_update(ble::connection_handle_t conn, uint8_t *data, uint8_t len) {
+        _ACK.update(data, len);
+        return _ble.gattServer().write(
+            conn,
+            amdtp_ACK.getValueHandle(),
+            _ACK.getPointer(),
+            _ACK.getNumValueBytes()
+        ) == BLE_ERROR_NONE;
+    }
+
 protected:
     /**
      * Construct and add to the GattServer AMDTP service.
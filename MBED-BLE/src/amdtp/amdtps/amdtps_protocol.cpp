@@ -82,13 +82,24 @@
  * Not fast... but for many sensor this speed  will be acceptable as most produce only a small
  * amount of bytes
  *
+ * October 2026
+ * The protocol now runs in amdtp_core.c, this file connects it to the BLE stack. When the
+ * client offers it (WINDOW_REQ) and an event queue is set for the timer, the packets are
+ * sent with a sliding window: up to 8 chunks in flight, the receiver reports the received
+ * chunks in a bitmap and only missing chunks are repeated. Older clients keep the
+ * stop-and-wait described above.
+ *
+ * Several Centrals can use AMDTP at the same time, each connection has its own state
+ * from the pool in amdtp_conn.c and its frames are sent only to that Central. As the
+ * Centrals share the buffers of the BLE stack they take turns to send.
  */
 #include <string.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include "amdtps_protocol.h"
-#include "../crc32.h"
+#include "sec_api.h"                    // SecRand() of the Cordio stack
+#include "rtos/Kernel.h"
 
 #if (defined AMDTPS_Debug) || (defined AMDTPS_SHOW_DATA)
 #warning defined debug
@@ -97,20 +108,21 @@ void debug_print_s(const char* f, const char* F, uint16_t L);
 void debug_printf_s(const char * fmt, ...);
 #endif
 
-/* Control block */
-static struct
-{
-    bool                txReady;            // TRUE if ready to send notifications
-    amdtpCb_t           core;               // defined in amdtp_common.h
-}
-amdtpsCb;
-
 /**
  * @brief constructor and initialize variables
  */
 AMDTPS::AMDTPS(BLE &ble):
-    _AmdtpService(ble)
+    _AmdtpService(ble),
+    _ble(ble)
 {
+    amdtpCoreCallbacks_t cb;
+
+    make_callbacks(&cb);
+    AmdtpConnPoolInit(&_pool, &cb, this);
+
+    // the user of a request is the entry of the pool, for its handle
+    for (int i = 0; i < AMDTP_MAX_CONNECTIONS; i++)
+        AmdtpLinkInit(&_link[i], link_request, &_pool.conn[i]);
 }
 
 //*****************************************************************************
@@ -128,471 +140,403 @@ AMDTPS::amdtps_init()
         debug_print_s(__func__, __FILE__, __LINE__);
     #endif
 
-    memset(&amdtpsCb, 0, sizeof(amdtpsCb));
-
-    amdtpsCb.core.lastRxPktSn = 0;                  // keep track of serial number 0 .. 15
-    amdtpsCb.core.txPktSn = 0;
-
-    resetPkt(&amdtpsCb.core.rxPkt);                 // set buffers
-    amdtpsCb.core.rxPkt.data = rxPktBuf;
-
-    resetPkt(&amdtpsCb.core.txPkt);
-    amdtpsCb.core.txPkt.data = txPktBuf;
-
-    resetPkt(&amdtpsCb.core.ackPkt);
-    amdtpsCb.core.ackPkt.data = ackPktBuf;
-
-    amdtpsCb.core.attMtuSize = ATT_DEFAULT_MTU;     // needed to break a package is pieces
+    for (int i = 0; i < AMDTP_MAX_CONNECTIONS; i++)
+        send_timeout_stop(&_pool.conn[i]);
 
-    amdtpsCb.core.txState = AMDTP_STATE_TX_IDLE;    // enable sending
-    amdtpsCb.txReady = true;
+    AmdtpConnCloseAll(&_pool);
+    _txReady = true;
 }
 
 //*****************************************************************************
-//! @brief reset package
+//! @brief start one connection again : stop-and-wait, MTU 23, serial numbers 0
 //*****************************************************************************
 void
-AMDTPS::resetPkt(amdtpPacket_t *pkt)
+AMDTPS::amdtps_init(ble::connection_handle_t conn)
 {
-    pkt->offset = 0;        // no data in buffer to start from
-    pkt->header.pktType = AMDTP_PKT_TYPE_UNKNOWN; // unknown what is left
-    pkt->len = 0;           // no length in buffer
+    if (find(conn)) AmdtpConnOpen(&_pool, (uint16_t) conn);
 }
 
 //*****************************************************************************
-//! Set callback to user program when data is ready to be returned.
-//!
-//! @param[in] cb The callback object that will be called when received data is ready
+//! @brief stop the transfer of one connection, keep the session (added October 2026)
 //*****************************************************************************
-void AMDTPS::on_data_received(mbed::Callback<void(uint8_t *data, uint16_t len)> cb)
+void
+AMDTPS::amdtps_reset(ble::connection_handle_t conn)
 {
-   _on_data_cb = cb;
+    AmdtpConnResetTransfer(&_pool, (uint16_t) conn);
 }
 
 //*****************************************************************************
-//! @brief check for type of packet (Data or ACK) added version 3.1
-//! return true for data packet
+//! @brief send timeout per connection (added October 2026)
 //*****************************************************************************
-bool AMDTPS::Check_type(uint16_t len, uint8_t *pValue)
+void
+AMDTPS::AmdtpSendTimeoutStart(ble::connection_handle_t conn, std::chrono::milliseconds timeout,
+                              mbed::Callback<void(ble::connection_handle_t conn)> cb)
 {
-  uint16_t header;
+    amdtpConn_t *c = AmdtpConnFind(&_pool, (uint16_t) conn);
 
-  BYTES_TO_UINT16(header, &pValue[2]);              // second 2 bytes is header
-  if((header & PACKET_TYPE_BIT_MASK) >> PACKET_TYPE_BIT_OFFSET == AMDTP_PKT_TYPE_DATA)
-    return true;
+    if (c == NULL || _event_queue == nullptr) return;
 
-  return false;
+    send_timeout_stop(c);
+    c->sendTimeout = _event_queue->call_in(timeout, [c, cb]() { c->sendTimeout = 0; cb(c->handle); });
 }
 
-//*****************************************************************************
-//! parse a received message
-//!
-//! Makes sure to receive a complete correct message
-//!
-//! AMDTP_STATUS_INVALID_PKT_LENGTH = Not enough data to start extracting the message
-//! AMDTP_STATUS_INSUFFICIENT_BUFFER = not enough space to store the received message
-//! AMDTP_STATUS_CRC_ERROR = CRC is not correct
-//! AMDTP_STATUS_RECEIVE_DONE = message is complete and correct. Ready to go
-//! AMDTP_STATUS_RECEIVE_CONTINUE = need more data packages. we are not complete yet.
-//!
-//!
-//*****************************************************************************
-eAmdtpStatus_t
-AMDTPS::AmdtpReceivePkt(uint8_t handle, uint16_t len, uint8_t *pValue)
+void
+AMDTPS::AmdtpSendTimeoutStop(ble::connection_handle_t conn)
 {
-  amdtpPacket_t *pkt;
-
-  uint8_t dataIdx = 0;
-  uint32_t calDataCrc = 0;
-  uint16_t header = 0;
-
-  static bool FirstPacket = true;
-  static bool Ptype;
-
-#ifdef AMDTPS_Debug
-  debug_print_s(__func__, __FILE__, __LINE__);
-#endif
-
-  // do NOT use the handle to determine whether this is RX or ACK
-  // the program has changed to sent ACK now also over RX, given that
-  // some stacks are repeating whatever is received over notify.
-  // When a NEW package is expected, check for the right package first
-  // and remember that in a static bool.
+    amdtpConn_t *c = AmdtpConnFind(&_pool, (uint16_t) conn);
 
-  if (FirstPacket){
-    Ptype = Check_type(len, pValue);
-    FirstPacket = false;
-  }
+    if (c) send_timeout_stop(c);
+}
 
-  if (Ptype) pkt = &amdtpsCb.core.rxPkt;
-  else pkt = &amdtpsCb.core.ackPkt;
+void
+AMDTPS::send_timeout_stop(amdtpConn_t *c)
+{
+    if (c->sendTimeout) {
+        _event_queue->cancel(c->sendTimeout);
+        c->sendTimeout = 0;
+    }
+}
 
-  // len must include length (2) and header (2)
-  if (pkt->offset == 0 && len < AMDTP_PREFIX_SIZE_IN_PKT)
-  {
-#ifdef AMDTPS_Debug
-    debug_printf_s("\rInvalid packet size !!!\n");
-#endif
-    FirstPacket = true;
-    AmdtpSendReply(AMDTP_STATUS_INVALID_PKT_LENGTH, NULL, 0);
-    return AMDTP_STATUS_INVALID_PKT_LENGTH;
-  }
+//*****************************************************************************
+//! @brief connections (added October 2026)
+//*****************************************************************************
+bool
+AMDTPS::AmdtpConnect(ble::connection_handle_t conn)
+{
+    amdtpConn_t *c = AmdtpConnOpen(&_pool, (uint16_t) conn);
 
-  // if new packet (not received packet(s) before, in case full message needs multiple packets
-  // to be sent
+    if (c == NULL) return false;
 
-  if (pkt->offset == 0)
-  {
-    NewChunkReceived = 0;                             // reset data chunk counter
-    BYTES_TO_UINT16(pkt->len, pValue);                // first 2 bytes is length
-    BYTES_TO_UINT16(header, &pValue[2]);              // second 2 bytes is header
-    pkt->header.pktType = (header & PACKET_TYPE_BIT_MASK) >> PACKET_TYPE_BIT_OFFSET; // mask = 0xf, offset is 12 : top 4 bits
-    pkt->header.pktSn = (header & PACKET_SN_BIT_MASK) >> PACKET_SN_BIT_OFFSET;       // mask = 0xf , ofsset is 8 : next for 4 bits
-    pkt->header.encrypted = (header & PACKET_ENCRYPTION_BIT_MASK) >> PACKET_ENCRYPTION_BIT_OFFSET;  // mask = 1, offset is 7, next bit
-    pkt->header.ackEnabled = (header & PACKET_ACK_BIT_MASK) >> PACKET_ACK_BIT_OFFSET; // mask 1, offset is 6, next bit
-    dataIdx = AMDTP_PREFIX_SIZE_IN_PKT;     // 4
+    AmdtpLinkReset(&_link[c - _pool.conn], now_ms());
+    AmdtpLinkEnable(&_link[c - _pool.conn], _bulk, now_ms());
+    return true;
+}
 
-#ifdef AMDTPS_Debug
-    debug_printf_s("\rpkt len = 0x%x, pkt header = 0x%x :\n", pkt->len, header);
-    switch (pkt->header.pktType) {
-      case  AMDTP_PKT_TYPE_DATA:
-        debug_printf_s("\rtype = %d : DATA ", pkt->header.pktType);
-        break;
-      case  AMDTP_PKT_TYPE_ACK:
-        debug_printf_s("\rtype = %d : ACK ", pkt->header.pktType);
-        break;
-      case  AMDTP_PKT_TYPE_CONTROL:
-        debug_printf_s("\rtype = %d : Control ", pkt->header.pktType);
-        break;
-      default:
-        debug_printf_s("\rtype = %d : Unknown ", pkt->header.pktType);
-        break;
-    }
-    debug_printf_s("sn = %d, enc = %d, ackEnabled = %d\n", pkt->header.pktSn, pkt->header.encrypted, pkt->header.ackEnabled);
-#endif
-  }
+void
+AMDTPS::AmdtpDisconnect(ble::connection_handle_t conn)
+{
+    AmdtpSendTimeoutStop(conn);
+    AmdtpConnClose(&_pool, (uint16_t) conn);
+}
 
-  // make sure we have enough space for new data
-  if (pkt->offset + len - dataIdx > AMDTP_PACKET_SIZE)   // make sure it fits in 512 + 4 +4 (max length defined amdtp_common.h:  512)
-  {
-#ifdef AMDTPS_Debug
-    debug_printf_s("\rNot enough buffer size!!!\n");
-#endif
+uint8_t
+AMDTPS::AmdtpConnections()
+{
+    return AmdtpConnCount(&_pool);
+}
 
-    resetPkt(pkt);
-    FirstPacket = true;
-    AmdtpSendReply(AMDTP_STATUS_INSUFFICIENT_BUFFER, NULL, 0);
-    return AMDTP_STATUS_INSUFFICIENT_BUFFER;
-  }
+ble::connection_handle_t
+AMDTPS::AmdtpConnection()
+{
+    return _current;
+}
 
-  // copy new data into buffer and also save crc into it if it's the last packet in a message
-  // 4 bytes crc is included in pkt length
+ble::connection_handle_t
+AMDTPS::AmdtpDefaultConnection()
+{
+    amdtpConn_t *c = AmdtpConnFirst(&_pool);
 
-  memcpy(pkt->data + pkt->offset, pValue + dataIdx, len - dataIdx); // skip the header
-  pkt->offset += (len - dataIdx);
+    return c ? c->handle : AMDTP_CONN_NONE;
+}
 
-  // whole packet received
-  if (pkt->offset >= pkt->len)
-  {
-    // next time again a new packet of a new message
-    FirstPacket = true;
+// the core of a connection, NULL if not open
+amdtpCore_t *
+AMDTPS::find(ble::connection_handle_t conn)
+{
+    amdtpConn_t *c = AmdtpConnFind(&_pool, (uint16_t) conn);
 
-    uint32_t peerCrc = 0;
-    //
-    // check CRC
-    //
-    BYTES_TO_UINT32(peerCrc, pkt->data + pkt->len - AMDTP_CRC_SIZE_IN_PKT);
-    calDataCrc = CalcCrc32(0xFFFFFFFFU, pkt->len - AMDTP_CRC_SIZE_IN_PKT, pkt->data);
+    return c ? &c->core : NULL;
+}
 
-    if (peerCrc != calDataCrc)
-    {
-#ifdef AMDTPS_Debug
-      debug_printf_s("\rcrc error :\ncalDataCrc = 0x%x ", calDataCrc);
-      debug_printf_s("peerCrc = 0x%x\n", peerCrc);
-#endif
+// the instance of a call from the core, remember the connection for AmdtpConnection()
+AMDTPS *
+AMDTPS::from(void *user)
+{
+    amdtpConn_t *c = (amdtpConn_t *) user;
+    AMDTPS *tp = (AMDTPS *) c->pool->user;
 
-      // reset pkt
-      resetPkt(pkt);
+    tp->_current = c->handle;
+    return tp;
+}
 
-      AmdtpSendReply(AMDTP_STATUS_CRC_ERROR, NULL, 0);
-      return AMDTP_STATUS_CRC_ERROR;
+//*****************************************************************************
+//! @brief connect the AMDTP core to this instance
+//*****************************************************************************
+void
+AMDTPS::make_callbacks(amdtpCoreCallbacks_t *cb)
+{
+    memset(cb, 0, sizeof(amdtpCoreCallbacks_t));
+    cb->send = core_send;
+    cb->received = core_received;
+    cb->sent = core_sent;
+    cb->streamReceived = core_stream_received;
+    cb->streamDone = core_stream_done;
+    cb->writable = core_writable;
+    cb->random = core_random;
+
+    // the window mode needs a timer to repeat lost chunks
+    if (_event_queue) cb->timer = core_timer;
+
+    // cut-through delivery of received data packets
+    if (_on_part_cb) {
+        cb->partReceived = core_part_received;
+        cb->partDone = core_part_done;
     }
+}
 
-    // we have it all, now handle request
-    AmdtpPacketHandler((eAmdtpPktType_t)pkt->header.pktType, pkt->len - AMDTP_CRC_SIZE_IN_PKT, pkt->data);
-
-    return AMDTP_STATUS_RECEIVE_DONE;
-  }
-  // if requested to confirm packet received (not on last packet)
-  if (pkt->header.pktType == AMDTP_PKT_TYPE_DATA && pkt->header.ackEnabled){
+void
+AMDTPS::set_callbacks()
+{
+    amdtpCoreCallbacks_t cb;
 
-    // count this new packet (the packet count starts with 1)
-    NewChunkReceived++;
-    AmdtpSendControl(AMDTP_CONTROL_SEND_READY, &NewChunkReceived,1);
-  }
-  // not all had been received
-  return AMDTP_STATUS_RECEIVE_CONTINUE;
+    make_callbacks(&cb);
+    AmdtpConnSetCallbacks(&_pool, &cb);     // the pool sets the user of each connection
 }
 
 //*****************************************************************************
-//
-// AMDTP packet handler
-// what to do now a complete package has been RECEIVED ?
-//
+//! @brief set event queue for the timer (added October 2026)
 //*****************************************************************************
 void
-AMDTPS::AmdtpPacketHandler(eAmdtpPktType_t type, uint16_t len, uint8_t *buf)
+AMDTPS::set_event_queue(events::EventQueue *event_queue)
 {
-#ifdef AMDTPS_Debug
-  debug_print_s(__func__, __FILE__, __LINE__);
-#endif
+    _event_queue = event_queue;
+    set_callbacks();
+    link_start();
+}
 
-  switch(type)
-  {
-    case AMDTP_PKT_TYPE_DATA:
-      //
-      // data package received
-      //
-      // record packet serial number
+//*****************************************************************************
+//! @brief bulk mode (added October 2026)
+//*****************************************************************************
+void
+AMDTPS::AmdtpSetBulkMode(bool enable)
+{
+    _bulk = enable;
 
-      amdtpsCb.core.lastRxPktSn = amdtpsCb.core.rxPkt.header.pktSn;
+    for (int i = 0; i < AMDTP_MAX_CONNECTIONS; i++) {
+        if (_pool.conn[i].handle != AMDTP_CONN_NONE) AmdtpLinkEnable(&_link[i], enable, now_ms());
+    }
 
-      AmdtpSendReply(AMDTP_STATUS_SUCCESS, NULL, 0);
+    if (! enable && _link_id) {
+        _event_queue->cancel(_link_id);
+        _link_id = 0;
+    }
 
-      // finally we are going to user level to handle the request
-      if (_on_data_cb)
-        _on_data_cb(buf, len);
+    link_start();
+}
 
-#ifdef AMDTPS_SHOW_DATA
-      else {
-            debug_printf_s("\r\n=========== received data (no callback was set) =====================\r\n");
+// poll the links every AMDTP_LINK_POLL_MS, once there is an event queue
+void
+AMDTPS::link_start()
+{
+    if (_bulk && _event_queue && ! _link_id)
+        _link_id = _event_queue->call_every(std::chrono::milliseconds(AMDTP_LINK_POLL_MS), [this]() { link_poll(); });
+}
 
-            for (uint16_t i =0; i < len; i++) debug_printf_s("0x%02X ", buf[i]);
-            debug_printf_s("\r\n");
-      }
-#endif
-      resetPkt(&amdtpsCb.core.rxPkt);
-      break;
+void
+AMDTPS::link_poll()
+{
+    uint32_t now = now_ms();
 
-    case AMDTP_PKT_TYPE_ACK:
-    {
-      eAmdtpStatus_t status = (eAmdtpStatus_t)buf[0];
+    for (int i = 0; i < AMDTP_MAX_CONNECTIONS; i++) {
+        if (_pool.conn[i].handle != AMDTP_CONN_NONE) AmdtpLinkUpdate(&_link[i], &_pool.conn[i].core, now);
+    }
+}
 
-      if (amdtpsCb.core.txState != AMDTP_STATE_WAITING_ACK){
+// the Central decides, it can give other values. The data length of the
+// link layer is not asked : mbed has no call for it, Cordio uses the
+// largest one its configuration allows
+void
+AMDTPS::link_request(void *user, const amdtpLinkParams_t *params, bool bulk)
+{
+    amdtpConn_t *c = (amdtpConn_t *) user;
+    AMDTPS *tp = (AMDTPS *) c->pool->user;
+    ble::phy_set_t phys(params->phy == AMDTP_LINK_PHY_2M ? ble::phy_t::LE_2M : ble::phy_t::LE_1M);
 
 #ifdef AMDTPS_Debug
-        debug_printf_s("Warning : Received an unexpected ACK\n");
+    debug_printf_s("\rAsk %s : interval %d - %d, latency %d, PHY %dM\n", bulk ? "bulk" : "idle",
+                   params->intervalMin, params->intervalMax, params->latency, params->phy);
 #endif
-      }
-
-      amdtpsCb.core.txState = AMDTP_STATE_TX_IDLE;
-
-      if (status == AMDTP_STATUS_CRC_ERROR || status == AMDTP_STATUS_RESEND_REPLY)
-      {
-        // resend packet
-        AmdtpSendPacketHandler();
-      }
-      else
-      {
-        // increase packet serial number if send successfully
-        if (status == AMDTP_STATUS_SUCCESS)
-        {
-          amdtpsCb.core.txPktSn++;
-
-          if (amdtpsCb.core.txPktSn == 16)     // max 4 bits part of the header (so count 0 - 15)
-          {
-            amdtpsCb.core.txPktSn = 0;
-          }
-        }
 
-        // reset send packet
-        resetPkt(&amdtpsCb.core.txPkt);
-      }
+    tp->_ble.gap().updateConnectionParameters(c->handle, ble::conn_interval_t(params->intervalMin),
+                                              ble::conn_interval_t(params->intervalMax),
+                                              ble::slave_latency_t(params->latency),
+                                              ble::supervision_timeout_t(params->timeout));
 
-      resetPkt(&amdtpsCb.core.ackPkt);
-    }
-      break;
+    tp->_ble.gap().setPhy(c->handle, &phys, &phys, ble::coded_symbol_per_bit_t::UNDEFINED);
+}
 
-  case AMDTP_PKT_TYPE_CONTROL:
-  {
-    eAmdtpControl_t control = (eAmdtpControl_t)buf[0];
-    uint8_t resendPktSn = buf[1];
-
-    // we have more chunks of data to send so we requested
-    // from the peripheral a confirmation that we can send next part
-    if (control == AMDTP_CONTROL_SEND_READY)
-    {
-       NewChunkReceived = resendPktSn;
-       AmdtpSendPacketHandler();
+uint32_t
+AMDTPS::now_ms()
+{
+    return (uint32_t) std::chrono::duration_cast<std::chrono::milliseconds>(rtos::Kernel::Clock::now().time_since_epoch()).count();
+}
+
+//*****************************************************************************
+//! @brief Set new MTU size
+//*****************************************************************************
+void
+AMDTPS::UpdateMTU(ble::connection_handle_t conn, uint16_t newSize)
+{
+    amdtpCore_t *core = find(conn);
+
+    if (core == NULL) {
+      // MTU exchange before the connection was given
+      amdtpConn_t *c = AmdtpConnOpen(&_pool, (uint16_t) conn);
+      if (c == NULL) return;
+      core = &c->core;
     }
 
-    else if (control == AMDTP_CONTROL_RESEND_REQ)
-    {
+    AmdtpCoreSetMtu(core, newSize);
+}
 
-      resetPkt(&amdtpsCb.core.rxPkt);
+//*****************************************************************************
+//! @brief the stack has room for notifications again, send waiting chunks
+//*****************************************************************************
+void
+AMDTPS::AmdtpPump()
+{
+    AmdtpConnPump(&_pool);
+}
 
-      if (resendPktSn > amdtpsCb.core.lastRxPktSn)
-      {
-        AmdtpSendReply(AMDTP_STATUS_RESEND_REPLY, NULL, 0);
-      }
-      else if (resendPktSn == amdtpsCb.core.lastRxPktSn)
-      {
-        AmdtpSendReply(AMDTP_STATUS_SUCCESS, NULL, 0);
-      }
-#ifdef AMDTPS_Debug
-      else
-      {
-         debug_printf_s("\rCan not act on Control package resendPktSn = %d, lastRxPktSn = %d\n", resendPktSn, amdtpsCb.core.lastRxPktSn);
-      }
-    }
-    else
-    {
-      debug_printf_s("\rUnexpected contrl request  = %d\n", control);
-#endif
-    }
+//*****************************************************************************
+//! @brief compress the data packets that are sent, if the peer supports it
+//*****************************************************************************
+void
+AMDTPS::AmdtpSetCompress(bool enable)
+{
+    AmdtpConnSetCompress(&_pool, enable);
+}
 
-    resetPkt(&amdtpsCb.core.ackPkt);
-  }
-    break;
+//*****************************************************************************
+//! @brief encrypt the data packets, the peer needs the same key
+//*****************************************************************************
+void
+AMDTPS::AmdtpSetKey(const uint8_t *key)
+{
+    AmdtpConnSetKey(&_pool, key);
+}
 
-  default:
-    break;
-  }
+//*****************************************************************************
+//! Set callback to user program when data is ready to be returned.
+//!
+//! @param[in] cb The callback object that will be called when received data is ready
+//*****************************************************************************
+void AMDTPS::on_data_received(mbed::Callback<void(uint8_t *data, uint16_t len)> cb)
+{
+   _on_data_cb = cb;
 }
 
 //*****************************************************************************
 //
-// create packet to send
+// calls from the AMDTP core
 //
 //*****************************************************************************
-void
-AMDTPS::AmdtpBuildPkt(eAmdtpPktType_t type, bool encrypted, bool enableACK, uint8_t *buf, uint16_t len)
+
+// data goes out on the TX characteristic, ACK and CONTROL on ACK, only to this connection
+bool
+AMDTPS::core_send(void *user, eAmdtpPktType_t type, uint8_t *buf, uint16_t len)
 {
-#ifdef AMDTPS_Debug
-  debug_print_s(__func__, __FILE__, __LINE__);
+  amdtpConn_t *c = (amdtpConn_t *) user;
+  AMDTPS *tp = (AMDTPS *) c->pool->user;
+
+#ifdef AMDTPS_SHOW_DATA
+  debug_printf_s("\r\n=========== %s sent =====================\r\n", type == AMDTP_PKT_TYPE_DATA ? "Data" : "Ack");
+  for (uint16_t i =0; i < len; i++) debug_printf_s("0x%02X ", buf[i]);
+  debug_printf_s("\r\n");
 #endif
-  uint16_t header = 0;
-  uint32_t calDataCrc;
-  amdtpPacket_t *pkt;
 
   if (type == AMDTP_PKT_TYPE_DATA)
-  {
-    pkt = &amdtpsCb.core.txPkt;
-    header = amdtpsCb.core.txPktSn << PACKET_SN_BIT_OFFSET;  // add 4 bit serial number to right offset
-  }
-  else
-  {
-    pkt = &amdtpsCb.core.ackPkt;                             // acknowledgement of earlier received data
-  }
+    return tp->_AmdtpService.TX_update(c->handle, buf, len);
 
-  //
-  // Prepare header frame to be sent first
-  //
-  // length
-  pkt->len = len + AMDTP_PREFIX_SIZE_IN_PKT + AMDTP_CRC_SIZE_IN_PKT;  // len of data + header & len (4) + CRC (4 ytes)
-  pkt->data[0]  = (len + AMDTP_CRC_SIZE_IN_PKT) & 0xff;               // LSB
-  pkt->data[1]  = ((len + AMDTP_CRC_SIZE_IN_PKT) >> 8) & 0xff;        // MSB length
-
-  // header
-  header = header | (type << PACKET_TYPE_BIT_OFFSET);                 // add 4 bit type
-  if (encrypted)
-  {
-    header = header | (1 << PACKET_ENCRYPTION_BIT_OFFSET);            // set encryption bit (not used really)
-  }
-
-  if (pkt->len > (amdtpsCb.core.attMtuSize - 3)) {
-    header = header | (1 << PACKET_ACK_BIT_OFFSET);                   // set controlbit to send reply on receipt
-  }
-
-  pkt->data[2] = (header & 0xff);                                     // set header
-  pkt->data[3] = (header >> 8);
+  return tp->_AmdtpService.ACK_update(c->handle, buf, len);
+}
 
-  // copy data
-  memcpy(&(pkt->data[AMDTP_PREFIX_SIZE_IN_PKT]), buf, len);           // now add the data
-  calDataCrc = CalcCrc32(0xFFFFFFFFU, len, buf);                      // calculate the CRC
+// a complete packet with correct CRC has been received
+void
+AMDTPS::core_received(void *user, uint8_t *buf, uint16_t len)
+{
+  AMDTPS *tp = from(user);
 
-  // add checksum
-  pkt->data[AMDTP_PREFIX_SIZE_IN_PKT + len] = (calDataCrc & 0xff);    // add the 32 bit CRC
-  pkt->data[AMDTP_PREFIX_SIZE_IN_PKT + len + 1] = ((calDataCrc >> 8) & 0xff);
-  pkt->data[AMDTP_PREFIX_SIZE_IN_PKT + len + 2] = ((calDataCrc >> 16) & 0xff);
-  pkt->data[AMDTP_PREFIX_SIZE_IN_PKT + len + 3] = ((calDataCrc >> 24) & 0xff);
+  // finally we are going to user level to handle the request
+  if (tp->_on_data_cb)
+    tp->_on_data_cb(buf, len);
 
 #ifdef AMDTPS_SHOW_DATA
-  if (type == AMDTP_PKT_TYPE_DATA)
-    debug_printf_s("\r\n=========== Data Prepared for sending ====================\r\n");
-  else
-    debug_printf_s("\r\n=========== Ack Prepared for sending =====================\r\n");
+  else {
+    debug_printf_s("\r\n=========== received data (no callback was set) =====================\r\n");
 
-  for (uint16_t i =0; i < pkt->len; i++) debug_printf_s("0x%02X ", pkt->data[i]);
-  debug_printf_s("\r\n");
+    for (uint16_t i =0; i < len; i++) debug_printf_s("0x%02X ", buf[i]);
+    debug_printf_s("\r\n");
+  }
 #endif
-
 }
 
-//*****************************************************************************
-//
-// Send control message to Receiver
-//
-//*****************************************************************************
+// (re)start or stop the retransmission timer of a connection
 void
-AMDTPS::AmdtpSendControl(eAmdtpControl_t control, uint8_t *data, uint16_t len)
+AMDTPS::core_timer(void *user, uint32_t ms)
 {
-#ifdef AMDTPS_Debug
-  debug_print_s(__func__, __FILE__, __LINE__);
-#endif
-
-  uint8_t buf[ATT_DEFAULT_PAYLOAD_LEN] = {0};
+  amdtpConn_t *c = (amdtpConn_t *) user;
+  AMDTPS *tp = (AMDTPS *) c->pool->user;
+  int i = c - tp->_pool.conn;
 
-  buf[0] = control;
+  if (tp->_timer_id[i]) {
+    tp->_event_queue->cancel(tp->_timer_id[i]);
+    tp->_timer_id[i] = 0;
+  }
 
-  // add any data
-  if (len > 0)  memcpy(buf + 1, data, len);
+  if (ms > 0)
+    tp->_timer_id[i] = tp->_event_queue->call_in(std::chrono::milliseconds(ms), [tp, c]() { tp->timer_expired(c); });
+}
 
-  amdtpsSendAck(AMDTP_PKT_TYPE_CONTROL, false, false, buf, len + 1);
+void
+AMDTPS::timer_expired(amdtpConn_t *c)
+{
+  _timer_id[c - _pool.conn] = 0;
+  AmdtpCoreTimeout(&c->core);
 }
 
 //*****************************************************************************
-//
-// Send Reply (ACK - type with status and optional data) to Sender
-//
+//! parse a received message
+//!
+//! Makes sure to receive a complete correct message
+//!
+//! AMDTP_STATUS_INVALID_PKT_LENGTH = Not enough data to start extracting the message
+//! AMDTP_STATUS_INSUFFICIENT_BUFFER = not enough space to store the received message
+//! AMDTP_STATUS_CRC_ERROR = CRC is not correct
+//! AMDTP_STATUS_RECEIVE_DONE = message is complete and correct. Ready to go
+//! AMDTP_STATUS_RECEIVE_CONTINUE = need more data packages. we are not complete yet.
+//!
+//! RX and ACK are not told apart on the characteristic handle, the program
+//! has changed to sent ACK now also over RX, given that some stacks are
+//! repeating whatever is received over notify. The connection handle selects
+//! the AMDTP state of the Central (October 2026).
 //*****************************************************************************
-void
-AMDTPS::AmdtpSendReply(eAmdtpStatus_t status, uint8_t *data, uint16_t len)
+eAmdtpStatus_t
+AMDTPS::AmdtpReceivePkt(ble::connection_handle_t conn, uint16_t len, uint8_t *pValue)
 {
 #ifdef AMDTPS_Debug
   debug_print_s(__func__, __FILE__, __LINE__);
 #endif
 
-  uint8_t buf[ATT_DEFAULT_PAYLOAD_LEN] = {0}; // max payload length for most PDU on bluetooth
+  amdtpConn_t *c = AmdtpConnFind(&_pool, (uint16_t) conn);
 
-  buf[0] = status;                    // first byte is status
+  if (c == NULL) c = AmdtpConnOpen(&_pool, (uint16_t) conn);
 
-  // add any data
-  if (len > 0)  memcpy(buf + 1, data, len);
+  if (c == NULL) {
+#ifdef AMDTPS_Debug
+    debug_printf_s("\rNo AMDTP connection free for handle %d\n", conn);
+#endif
+    return AMDTP_STATUS_BUSY;
+  }
 
-  amdtpsSendAck(AMDTP_PKT_TYPE_ACK, false, false, buf, len + 1);
-}
+  eAmdtpStatus_t st = AmdtpCoreReceive(&c->core, pValue, len);
 
-//*****************************************************************************
-//
-// @brief  : send acknowledgement over the ACK handle
-// @param type : ack or control
-// @param encrypted : set encryption (not used anywhere.. but who knows in the future ??)
-// @param enableACK : not used anywhere.. but who knows in the future ??
-// @param buf : data to sent
-// @param len : length of data to sent
-//*****************************************************************************
-void
-AMDTPS::amdtpsSendAck(eAmdtpPktType_t type, bool encrypted, bool enableACK, uint8_t *buf, uint16_t len)
-{
 #ifdef AMDTPS_Debug
-  debug_print_s(__func__, __FILE__, __LINE__);
+  if (st != AMDTP_STATUS_RECEIVE_CONTINUE && st != AMDTP_STATUS_RECEIVE_DONE)
+    debug_printf_s("\rReceive status %d\n", st);
 #endif
 
-  // create packet with CRC etc
-  AmdtpBuildPkt(type, encrypted, enableACK, buf, len);
-
-  _AmdtpService.ACK_update(amdtpsCb.core.ackPkt.data,amdtpsCb.core.ackPkt.len);
+  return st;
 }
 
 //*****************************************************************************
@@ -605,18 +549,39 @@ AMDTPS::amdtpsSendAck(eAmdtpPktType_t type, bool encrypted, bool enableACK, uint
 //
 //*****************************************************************************
 int AMDTPS::AmdtpSendData(uint8_t *buf, uint16_t len)
+{
+  return AmdtpSendData(AmdtpDefaultConnection(), buf, len);
+}
+
+int AMDTPS::AmdtpSendData(ble::connection_handle_t conn, uint8_t *buf, uint16_t len)
 {
 #ifdef AMDTPS_Debug
   debug_print_s(__func__, __FILE__, __LINE__);
 #endif
-  //                                                      encrypted, enableACK
-  eAmdtpStatus_t st = AmdtpsSendPacket(AMDTP_PKT_TYPE_DATA, false, false, buf, len);
+
+  amdtpCore_t *core = find(conn);
+
+  //
+  // Check if ready to send notification and if running as server
+  //
+  if (! _txReady || core == NULL)
+  {
+#ifdef AMDTPS_Debug
+    debug_printf_s("data sending failed, Not ready for notification.\n");
+#endif
+    return -1;
+  }
+
+  eAmdtpStatus_t st = AmdtpCoreSend(core, buf, len);
 
   if(st != AMDTP_STATUS_SUCCESS){
-       return -1;
+#ifdef AMDTPS_Debug
+    debug_printf_s("\rData sending failed, status = %d, tx state = %d\n", st, core->txState);
+#endif
+    return -1;
   }
 
-  if (SendingNOtComplete) return 1;
+  if (! AmdtpCoreSendComplete(core)) return 1;
 
   return 0;
 }
@@ -633,142 +598,168 @@ int AMDTPS::AmdtpSendData(uint8_t *buf, uint16_t len)
 
 bool AMDTPS::AmdtpSendComplete()
 {
-  return(! SendingNOtComplete);
+  return AmdtpSendComplete(AmdtpDefaultConnection());
+}
+
+// a connection that is gone has nothing left to send
+bool AMDTPS::AmdtpSendComplete(ble::connection_handle_t conn)
+{
+  amdtpCore_t *core = find(conn);
+
+  return core == NULL || AmdtpCoreSendComplete(core);
 }
 
 //*****************************************************************************
 //
-//! @brief Send data to Client via notification
-//!
-//! @param type - packet type
-//! @param encrypted - is packet encrypted
-//! @param enableACK - does client need to response
-//! @param buf - data
-//! @param len - data length
-//!
-//! @return status
-//! AMDTP_STATUS_TX_NOT_READY;
-//! AMDTP_STATUS_BUSY
-//! AMDTP_STATUS_INVALID_PKT_LENGTH
-//! AMDTP_STATUS_SUCCESS
-//!
+// Streams (added October 2026), see amdtp_core.h
+//
 //*****************************************************************************
-eAmdtpStatus_t
-AMDTPS::AmdtpsSendPacket(eAmdtpPktType_t type, bool encrypted, bool enableACK, uint8_t *buf, uint16_t len)
+int AMDTPS::AmdtpStreamOpen(uint32_t len)
+{
+  return AmdtpStreamOpen(AmdtpDefaultConnection(), len);
+}
+
+int AMDTPS::AmdtpStreamOpen(ble::connection_handle_t conn, uint32_t len)
 {
 #ifdef AMDTPS_Debug
   debug_print_s(__func__, __FILE__, __LINE__);
 #endif
 
-  //
-  // Check if ready to send notification and if running as server
-  //
-  if (! amdtpsCb.txReady )
-  {
+  amdtpCore_t *core = find(conn);
 
-#ifdef AMDTPS_Debug
-    debug_printf_s("data sending failed, Not ready for notification.\n");
-#endif
-    return AMDTP_STATUS_TX_NOT_READY;
-  }
+  if (! _txReady || core == NULL) return -1;
 
-  //
-  // Check if the service is idle to send
-  //
-  if (amdtpsCb.core.txState != AMDTP_STATE_TX_IDLE)
-  {
+  eAmdtpStatus_t st = AmdtpCoreStreamOpen(core, len);
 
+  if(st != AMDTP_STATUS_SUCCESS){
 #ifdef AMDTPS_Debug
-    debug_printf_s("\rData sending failed, tx state = %d\n", amdtpsCb.core.txState);
+    debug_printf_s("\rStream open failed, status = %d, peer version = %d\n", st, core->peerVersion);
 #endif
-    return AMDTP_STATUS_BUSY;
+    return -1;
   }
 
-  //
-  // Check if data length is valid
-  //
-  if ( len > AMDTP_MAX_PAYLOAD_SIZE )
-  {
-#ifdef AMDTPS_Debug
-    debug_printf_s("\rData sending failed, exceed maximum payload, len = %d.\n", len);
-#endif
-    return AMDTP_STATUS_INVALID_PKT_LENGTH;
-  }
+  return 0;
+}
+
+uint16_t AMDTPS::AmdtpStreamWrite(uint8_t *buf, uint16_t len)
+{
+  return AmdtpStreamWrite(AmdtpDefaultConnection(), buf, len);
+}
 
-  // build packet to sent
-  AmdtpBuildPkt(type, encrypted, enableACK, buf, len);
+uint16_t AMDTPS::AmdtpStreamWrite(ble::connection_handle_t conn, uint8_t *buf, uint16_t len)
+{
+  amdtpCore_t *core = find(conn);
 
-  // send packet
-  AmdtpSendPacketHandler();
+  return core ? AmdtpCoreStreamWrite(core, buf, len) : 0;
+}
 
-  return AMDTP_STATUS_SUCCESS;
+int AMDTPS::AmdtpStreamClose()
+{
+  return AmdtpStreamClose(AmdtpDefaultConnection());
+}
+
+int AMDTPS::AmdtpStreamClose(ble::connection_handle_t conn)
+{
+  amdtpCore_t *core = find(conn);
+
+  return core && AmdtpCoreStreamClose(core) == AMDTP_STATUS_SUCCESS ? 0 : -1;
+}
+
+void AMDTPS::on_stream_received(mbed::Callback<void(uint8_t *data, uint16_t len, uint32_t offset)> cb)
+{
+  _on_stream_cb = cb;
+}
+
+void AMDTPS::on_stream_done(mbed::Callback<void(eAmdtpStatus_t status, uint32_t len)> cb)
+{
+  _on_stream_done_cb = cb;
+}
+
+void AMDTPS::on_stream_writable(mbed::Callback<void()> cb)
+{
+  _on_writable_cb = cb;
+}
+
+void AMDTPS::on_stream_sent(mbed::Callback<void(eAmdtpStatus_t status)> cb)
+{
+  _on_sent_cb = cb;
 }
 
-//*****************************************************************************
-//
-// sent data package. This will add the status around checks and break down
-// in chuncks
-//
-//*****************************************************************************
 void
-AMDTPS::AmdtpSendPacketHandler()
+AMDTPS::core_sent(void *user, eAmdtpStatus_t status)
 {
-#ifdef AMDTPS_Debug
-  debug_print_s(__func__, __FILE__, __LINE__);
-#endif
+  AMDTPS *tp = from(user);
 
-  uint16_t transferSize;
-  uint16_t remainingBytes;
-  static uint8_t PacketCount;          // counter for chunks of data
+  if (tp->_on_sent_cb) tp->_on_sent_cb(status);
+}
 
-  amdtpPacket_t *txPkt = &amdtpsCb.core.txPkt;
+void
+AMDTPS::core_stream_received(void *user, uint8_t *buf, uint16_t len, uint32_t offset)
+{
+  AMDTPS *tp = from(user);
 
-  if (amdtpsCb.core.txState == AMDTP_STATE_TX_IDLE ) {
-    txPkt->offset = 0;
-    amdtpsCb.core.txState = AMDTP_STATE_SENDING;
-    PacketCount = 0;
-  }
+  if (tp->_on_stream_cb) tp->_on_stream_cb(buf, len, offset);
+}
 
-  if (amdtpsCb.core.txState == AMDTP_STATE_SENDING ) {
+void
+AMDTPS::core_stream_done(void *user, eAmdtpStatus_t status, uint32_t len)
+{
+  AMDTPS *tp = from(user);
 
-#ifdef AMDTPC_Debug
-    if (SendingNOtComplete) {
-        if (PacketCount != NewChunkReceived)
-            printf("Warning: packages out of sequence. Got %d, expected %d.\n", NewChunkReceived, PacketCount);
-    }
+#ifdef AMDTPS_Debug
+  debug_printf_s("\rStream received, status = %d, length %d\n", status, len);
 #endif
 
-    // send small pieces of the packet. It just restricts sending to mtusize -3
-    // assumed mtusize is set during amdtp_init()
-    if (txPkt->offset < txPkt->len)
-    {
-        remainingBytes = txPkt->len - txPkt->offset;
-        transferSize = ((amdtpsCb.core.attMtuSize - 3) > remainingBytes)
-                                            ? remainingBytes
-                                            : (amdtpsCb.core.attMtuSize - 3);
+  if (tp->_on_stream_done_cb) tp->_on_stream_done_cb(status, len);
+}
+
+void
+AMDTPS::core_writable(void *user)
+{
+  AMDTPS *tp = from(user);
+
+  if (tp->_on_writable_cb) tp->_on_writable_cb();
+}
+
+//*****************************************************************************
+//! cut-through (added October 2026)
+//*****************************************************************************
+void AMDTPS::on_data_part(mbed::Callback<void(uint8_t *data, uint16_t len, uint16_t offset)> cb)
+{
+  _on_part_cb = cb;
+  set_callbacks();
+}
 
-        _AmdtpService.TX_update(&txPkt->data[txPkt->offset], transferSize);
+void AMDTPS::on_data_done(mbed::Callback<void(eAmdtpStatus_t status, uint16_t len)> cb)
+{
+  _on_part_done_cb = cb;
+}
 
-        txPkt->offset += transferSize;
+void
+AMDTPS::core_part_received(void *user, uint8_t *buf, uint16_t len, uint16_t offset)
+{
+  AMDTPS *tp = from(user);
 
-        // check whether we are done
-        if(txPkt->offset >= txPkt->len){
+  tp->_on_part_cb(buf, len, offset);
+}
 
-            // done sending packet
-            amdtpsCb.core.txState = AMDTP_STATE_WAITING_ACK;
-            SendingNOtComplete = false;
-            return;
-        }
-        else {
+void
+AMDTPS::core_part_done(void *user, eAmdtpStatus_t status, uint16_t len)
+{
+  AMDTPS *tp = from(user);
 
-            // update packet counter (start with 1)
-            PacketCount++;
+#ifdef AMDTPS_Debug
+  if (status != AMDTP_STATUS_SUCCESS) debug_printf_s("\rData packet failed, status = %d, length %d\n", status, len);
+#endif
 
-            // indicate we are NOT ready with sending
-            SendingNOtComplete = true;
-        }
-    }
-  }
+  if (tp->_on_part_done_cb) tp->_on_part_done_cb(status, len);
+}
+
+void
+AMDTPS::core_random(void *user, uint8_t *buf, uint16_t len)
+{
+  // random from the controller (HCI LE Rand), as used by the stack for its own keys
+  SecRand(buf, (uint8_t) len);
 }
 
 #if (defined AMDTPS_Debug) || (defined AMDTPS_SHOW_DATA)
@@ -51,7 +51,11 @@
 #define AMDTPS_PROTOCOL_H
 
 #include "../amdtp_common.h"
+#include "../amdtp_core.h"
+#include "../amdtp_conn.h"
+#include "../amdtp_link.h"
 #include "ble/BLE.h"
+#include "events/EventQueue.h"
 #include "amdtpServ.h"
 
 /* BLE_DEBUG will show the routines and debug information
@@ -65,7 +69,7 @@
 
 // Server version
 #define MAJOR_SERVERVERSION 1         // new features implemented that require update to client
-#define MINOR_SERVERVERSION 0         // bug fixes, better calculation / layout
+#define MINOR_SERVERVERSION 1         // bug fixes, better calculation / layout
 
 //*****************************************************************************
 //
@@ -79,15 +83,62 @@ class AMDTPS
     AMDTPS(BLE &ble);
 
    /**
-     * initialize the amdtp services
+     * initialize the amdtp services, all connections are closed
      */
     void amdtps_init();
 
+    /**
+     * start AMDTP of one connection again, as after connecting
+     */
+    void amdtps_init(ble::connection_handle_t conn);
+
+    /**
+     * stop the packet or stream in progress of one connection, after a
+     * timeout. The negotiated window and session key stay (added October 2026)
+     */
+    void amdtps_reset(ble::connection_handle_t conn);
+
+    /**
+     * timeout of a packet sent in chunks, one per connection (kept in its
+     * entry of the pool). Start replaces the timeout of that connection only,
+     * cb gets the connection when it expires. Needs the event queue. The
+     * timeout is stopped as well when the connection closes (added October 2026)
+     */
+    void AmdtpSendTimeoutStart(ble::connection_handle_t conn, std::chrono::milliseconds timeout,
+                               mbed::Callback<void(ble::connection_handle_t conn)> cb);
+    void AmdtpSendTimeoutStop(ble::connection_handle_t conn);
+
+    /**
+     * Centrals that connect and disconnect. Each connection has its own AMDTP
+     * state from a pool of AMDTP_MAX_CONNECTIONS (amdtp_conn.h).
+     * AmdtpConnect() returns false when the pool is full (added October 2026)
+     */
+    bool AmdtpConnect(ble::connection_handle_t conn);
+    void AmdtpDisconnect(ble::connection_handle_t conn);
+
+    /**
+     * number of connections with AMDTP
+     */
+    uint8_t AmdtpConnections();
+
+    /**
+     * the connection of the call back that is running (e.g. the data
+     * received), outside a call back the last one
+     */
+    ble::connection_handle_t AmdtpConnection();
+
+    /**
+     * the connection used by the calls without a connection handle, the
+     * first one in the pool. AMDTP_CONN_NONE when none
+     */
+    ble::connection_handle_t AmdtpDefaultConnection();
+
     /**
      * user program to store any data received from connected device
-     * called from gatt_server_amdtp.h
+     * called from gatt_server_amdtp.h with the connection it came from. A
+     * connection that was not given with AmdtpConnect() is added
      */
-    eAmdtpStatus_t AmdtpReceivePkt(uint8_t handle, uint16_t len, uint8_t *pValue);
+    eAmdtpStatus_t AmdtpReceivePkt(ble::connection_handle_t conn, uint16_t len, uint8_t *pValue);
 
     /**
      * user program to store data to be send to connected device
@@ -102,6 +153,7 @@ class AMDTPS
      *  1  Need to return to send next chunk of data (call  AmdtpContSendData())
      */
     int AmdtpSendData(uint8_t *buf, uint16_t len);
+    int AmdtpSendData(ble::connection_handle_t conn, uint8_t *buf, uint16_t len);
 
     /**
      * called to check that in case sending chunks of data is complete
@@ -110,6 +162,7 @@ class AMDTPS
      *  False : Not complete
      */
     bool AmdtpSendComplete();
+    bool AmdtpSendComplete(ble::connection_handle_t conn);
 
     /**
      * must be called by user program to set a routine to receive and handle
@@ -118,38 +171,157 @@ class AMDTPS
      */
     void on_data_received(mbed::Callback<void(uint8_t *data, uint16_t len)> cb);
 
+    /**
+     * set the event queue for the retransmission timer. Without it only
+     * stop-and-wait is used (added October 2026)
+     */
+    void set_event_queue(events::EventQueue *event_queue);
+
+    /**
+     * new MTU size has been agreed with the client
+     */
+    void UpdateMTU(ble::connection_handle_t conn, uint16_t newSize);
+
+    /**
+     * the BLE stack has room for notifications again. The connections
+     * take turns to send, see amdtp_conn.h
+     */
+    void AmdtpPump();
+
+    /**
+     * compress the data packets that are sent (amdtp_lz.h), only when the
+     * peer has AMDTP version 3 or later. Off by default (added October 2026)
+     */
+    void AmdtpSetCompress(bool enable);
+
+    /**
+     * encrypt the data packets with AES-CCM (amdtp_ccm.h) with this key of
+     * 16 bytes, NULL is off. The peer needs the same key and AMDTP version 4,
+     * the session key is agreed at the negotiation. With a key only encrypted
+     * data is sent and accepted. Set before connecting (added October 2026)
+     *
+     * Compression and the key are the same for all connections.
+     */
+    void AmdtpSetKey(const uint8_t *key);
+
+    /**
+     * bulk mode (amdtp_link.h) : ask each Central for a short connection
+     * interval and the 2M PHY while a transfer is going on, and for a long
+     * interval with latency 2 seconds after it. Needs the event queue, off by
+     * default. The data length is left to the stack, mbed has no call for it
+     * (added October 2026)
+     */
+    void AmdtpSetBulkMode(bool enable);
+
+    /**
+     * send a stream of len bytes, larger than AMDTP_MAX_PAYLOAD_SIZE
+     * (AMDTP_STREAM_LEN_UNKNOWN if not known). Write the data in parts with
+     * AmdtpStreamWrite() and end with AmdtpStreamClose(). Needs a peer that
+     * supports streams (added October 2026)
+     *
+     * return
+     * -1  error (not connected, busy or not supported by the peer)
+     *  0  stream is open
+     */
+    int AmdtpStreamOpen(uint32_t len);
+    int AmdtpStreamOpen(ble::connection_handle_t conn, uint32_t len);
+
+    /**
+     * add data to the stream
+     * return the number of bytes accepted. When less than len, write the
+     * rest after the call back set with on_stream_writable()
+     */
+    uint16_t AmdtpStreamWrite(uint8_t *buf, uint16_t len);
+    uint16_t AmdtpStreamWrite(ble::connection_handle_t conn, uint8_t *buf, uint16_t len);
+
+    /**
+     * end the stream. AmdtpSendComplete() is true once the peer has
+     * received all, the call back set with on_stream_sent() gives the result
+     */
+    int AmdtpStreamClose();
+    int AmdtpStreamClose(ble::connection_handle_t conn);
+
+    /**
+     * call backs for a stream that is received : each part as it comes in
+     * and the result (status, total length) at the end
+     */
+    void on_stream_received(mbed::Callback<void(uint8_t *data, uint16_t len, uint32_t offset)> cb);
+    void on_stream_done(mbed::Callback<void(eAmdtpStatus_t status, uint32_t len)> cb);
+
+    /**
+     * call backs for a stream that is sent : room to write again, and the
+     * result of the stream (or of a packet sent with AmdtpSendData())
+     */
+    void on_stream_writable(mbed::Callback<void()> cb);
+    void on_stream_sent(mbed::Callback<void(eAmdtpStatus_t status)> cb);
+
+    /**
+     * cut-through : each part of a received data packet as it comes in,
+     * before the CRC is known, and the result (status, length) at the end.
+     * The call back set with on_data_received() is then not used. Streams
+     * are not changed (added October 2026)
+     */
+    void on_data_part(mbed::Callback<void(uint8_t *data, uint16_t len, uint16_t offset)> cb);
+    void on_data_done(mbed::Callback<void(eAmdtpStatus_t status, uint16_t len)> cb);
+
 private:
 
     AmdtpService _AmdtpService;
 
-    bool Check_type(uint16_t len, uint8_t *pValue);
-
-    void AmdtpBuildPkt(eAmdtpPktType_t type, bool encrypted, bool enableACK, uint8_t *buf, uint16_t len);
+    // protocol state per connection, see amdtp_conn.h and amdtp_core.h
+    amdtpConnPool_t _pool;
 
-    void AmdtpSendReply( eAmdtpStatus_t status, uint8_t *data, uint16_t len);
+    bool _txReady = false;
 
-    void AmdtpSendControl( eAmdtpControl_t control, uint8_t *data, uint16_t len);
+    // connection of the call back that runs
+    ble::connection_handle_t _current = AMDTP_CONN_NONE;
 
-    void AmdtpSendPacketHandler();
+    amdtpCore_t *find(ble::connection_handle_t conn);
+    static AMDTPS *from(void *user);
 
-    void AmdtpPacketHandler(eAmdtpPktType_t type, uint16_t len, uint8_t *buf);
+    // calls from the AMDTP core
+    static bool core_send(void *user, eAmdtpPktType_t type, uint8_t *buf, uint16_t len);
+    static void core_received(void *user, uint8_t *buf, uint16_t len);
+    static void core_timer(void *user, uint32_t ms);
+    static void core_sent(void *user, eAmdtpStatus_t status);
+    static void core_stream_received(void *user, uint8_t *buf, uint16_t len, uint32_t offset);
+    static void core_stream_done(void *user, eAmdtpStatus_t status, uint32_t len);
+    static void core_writable(void *user);
+    static void core_part_received(void *user, uint8_t *buf, uint16_t len, uint16_t offset);
+    static void core_part_done(void *user, eAmdtpStatus_t status, uint16_t len);
+    static void core_random(void *user, uint8_t *buf, uint16_t len);
+    void timer_expired(amdtpConn_t *c);
+    void send_timeout_stop(amdtpConn_t *c);
 
-    void resetPkt(amdtpPacket_t *pkt);
+    // bulk mode, a link per entry of the pool
+    static void link_request(void *user, const amdtpLinkParams_t *params, bool bulk);
+    void link_poll();
+    void link_start();
+    static uint32_t now_ms();
 
-    void amdtpsSendAck(eAmdtpPktType_t type, bool encrypted, bool enableACK, uint8_t *buf, uint16_t len);
+    void make_callbacks(amdtpCoreCallbacks_t *cb);
+    void set_callbacks();
 
-    eAmdtpStatus_t AmdtpsSendPacket(eAmdtpPktType_t type, bool encrypted, bool enableACK, uint8_t *buf, uint16_t len);
+    events::EventQueue *_event_queue = nullptr;
+    int _timer_id[AMDTP_MAX_CONNECTIONS] = {0};
 
-    uint8_t rxPktBuf[AMDTP_PACKET_SIZE];        // about 512 + 4 + 4
-    uint8_t txPktBuf[AMDTP_PACKET_SIZE];
-    uint8_t ackPktBuf[AMDTP_ACK_SIZE];
+    BLE &_ble;
+    amdtpLink_t _link[AMDTP_MAX_CONNECTIONS];
+    bool _bulk = false;
+    int _link_id = 0;
 
     // store the user instructed function for call back
     mbed::Callback<void(uint8_t *data, uint16_t len)> _on_data_cb;
 
-    bool SendingNOtComplete = false;            // in case of multipacket
+    // streams
+    mbed::Callback<void(uint8_t *data, uint16_t len, uint32_t offset)> _on_stream_cb;
+    mbed::Callback<void(eAmdtpStatus_t status, uint32_t len)> _on_stream_done_cb;
+    mbed::Callback<void()> _on_writable_cb;
+    mbed::Callback<void(eAmdtpStatus_t status)> _on_sent_cb;
 
-    uint8_t NewChunkReceived;                   // data chunk packetnumber
+    // cut-through
+    mbed::Callback<void(uint8_t *data, uint16_t len, uint16_t offset)> _on_part_cb;
+    mbed::Callback<void(eAmdtpStatus_t status, uint16_t len)> _on_part_done_cb;
 };
 
 #endif // AMDTPS_PROTOCOL_H
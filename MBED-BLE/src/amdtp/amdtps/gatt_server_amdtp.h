@@ -27,6 +27,16 @@
  * Adjusted paulvha
  *
  * Version 1.0 / February 2022
+ *
+ * Version 1.1 / October 2026
+ *  - AMDTP sliding window mode (accepted when offered by the client)
+ *  - pass the agreed MTU and the transmit-done events to AMDTP
+ *  - streams larger than 512 bytes (StreamOpen / StreamWrite / StreamClose)
+ *  - several Centrals at the same time (AMDTP_MAX_CONNECTIONS), each with its own
+ *    AMDTP state. Advertising continues while there is room for another one
+ *  - SetBulkMode() : fast connection parameters during a transfer (amdtp_link.h)
+ *  - the send timeout is kept per central. A timeout stops only the transfer
+ *    of that central, a refused send changes nothing (the session key stays)
  */
 
 /*****************************************************************************
@@ -42,10 +52,20 @@
 // hardcoded call back to sketch
 extern void StoreDataReceived(uint8_t *data, uint16_t len);
 
+// optional call backs to sketch for a received stream (added October 2026)
+extern void StoreStreamReceived(uint8_t *data, uint16_t len, uint32_t offset) __attribute__((weak));
+extern void StreamReceivedDone(eAmdtpStatus_t status, uint32_t len) __attribute__((weak));
+
+// optional cut-through call backs to sketch, when present StoreDataReceived() is
+// not called but each part of a data packet as it arrives (added October 2026)
+extern void StoreDataPart(uint8_t *data, uint16_t len, uint16_t offset) __attribute__((weak));
+extern void DataPartDone(eAmdtpStatus_t status, uint16_t len) __attribute__((weak));
+
 // wait max 15 seconds
 static const std::chrono::milliseconds TimeOutSending = 15000ms;
 
-class GattServAMDTP : private mbed::NonCopyable<GattServAMDTP>, public ble::Gap::EventHandler{
+class GattServAMDTP : private mbed::NonCopyable<GattServAMDTP>, public ble::Gap::EventHandler,
+                      public GattServer::EventHandler {
 public:
 
   GattServAMDTP(BLE &ble, events::EventQueue &event_queue) :
@@ -63,10 +83,17 @@ public:
   void start()
   {
     _ble.init(this, &GattServAMDTP::on_init_complete);
+    _tp.set_event_queue(&_event_queue);     // AMDTP retransmission timer
     _tp.amdtps_init();
 
     // set call back for data received
     _tp.on_data_received(mbed::callback(this, &GattServAMDTP::Data_From_AMDTP));
+    _tp.on_stream_received(mbed::callback(this, &GattServAMDTP::Stream_From_AMDTP));
+    _tp.on_stream_done(mbed::callback(this, &GattServAMDTP::Stream_Done_AMDTP));
+    if (StoreDataPart) {
+      _tp.on_data_part(mbed::callback(StoreDataPart));
+      _tp.on_data_done(mbed::callback(this, &GattServAMDTP::Data_Done_AMDTP));
+    }
     _event_queue.dispatch_forever();
   }
 
@@ -87,6 +114,33 @@ public:
     return _IsConnected;
   }
 
+  /**
+   * bulk mode : ask the Central for a short interval and the 2M PHY while
+   * AMDTP sends or receives more than one packet, back to a long interval
+   * with latency 2 seconds after it. Off by default, call before start()
+   */
+  void SetBulkMode(bool enable)
+  {
+    _tp.AmdtpSetBulkMode(enable);
+  }
+
+  /**
+   * number of centrals / clients connected
+   */
+  uint8_t ConnectionCount()
+  {
+    return _tp.AmdtpConnections();
+  }
+
+  /**
+   * the connection of the central the data came from, call in
+   * StoreDataReceived() (or the other call backs)
+   */
+  ble::connection_handle_t GetConnection()
+  {
+    return _tp.AmdtpConnection();
+  }
+
   /**
    * set as soon as advertising is started
    * reset when connected
@@ -97,7 +151,8 @@ public:
   }
 
  /**
-  * Send data to central with AMDTP
+  * Send data to central with AMDTP. Without a connection it goes to the
+  * first central that connected and is still there
   *
   * return:
   * -2  Not connected
@@ -109,27 +164,74 @@ public:
   /* send data to central */
   int SendToCentral(uint8_t *sdata, uint16_t slen)
   {
-    if (! _IsConnected) return -2;
+    return SendToCentral(_tp.AmdtpDefaultConnection(), sdata, slen);
+  }
+
+  int SendToCentral(ble::connection_handle_t conn, uint8_t *sdata, uint16_t slen)
+  {
+    if (! _IsConnected || conn == AMDTP_CONN_NONE) return -2;
 
     // send to AMDTP to handle
-    int ret = _tp.AmdtpSendData(sdata, slen);
+    int ret = _tp.AmdtpSendData(conn, sdata, slen);
 
+    // refused (busy, no session key yet or too long) : nothing was started,
+    // the transfer in progress and the session are left alone
     if (ret == -1 ) {
-
         printf("%s: Failed to sent data for Central\n",__FILE__);
-
-        // reset all pointers of the amdtp service
-        _tp.amdtps_init();
     }
 
-    // sending in chunks, set timeout on receiving
+    // sending in chunks, set timeout on receiving for this central
     else if (ret == 1) {
-        cancelhandle = _event_queue.call_in(TimeOutSending,[this]() { TimedOutSend(); });
+        _tp.AmdtpSendTimeoutStart(conn, TimeOutSending, mbed::callback(this, &GattServAMDTP::TimedOutSend));
     }
 
     return(ret);
   }
 
+ /**
+  * Send a stream of len bytes (can be more than 512) to the Central with AMDTP.
+  * Write the data with StreamWrite() and end with StreamClose(),
+  * IsSendingComplete() is true once all has been received.
+  *
+  * return:
+  * -1  error (not connected, busy or the Central does not support streams)
+  *  0  stream is open
+  */
+  int StreamOpen(uint32_t len)
+  {
+    if (! _IsConnected) return -1;
+
+    return _tp.AmdtpStreamOpen(len);
+  }
+
+  int StreamOpen(ble::connection_handle_t conn, uint32_t len)
+  {
+    if (! _IsConnected) return -1;
+
+    return _tp.AmdtpStreamOpen(conn, len);
+  }
+
+  /* return the number of bytes taken, try the rest again a little later */
+  uint16_t StreamWrite(uint8_t *sdata, uint16_t slen)
+  {
+    return _tp.AmdtpStreamWrite(sdata, slen);
+  }
+
+  uint16_t StreamWrite(ble::connection_handle_t conn, uint8_t *sdata, uint16_t slen)
+  {
+    return _tp.AmdtpStreamWrite(conn, sdata, slen);
+  }
+
+  int StreamClose()
+  {
+    return _tp.AmdtpStreamClose();
+  }
+
+  int StreamClose(ble::connection_handle_t conn)
+  {
+    return _tp.AmdtpStreamClose(conn);
+  }
+
  /**
    * Check that all packages have been sent (in case multiple chunk are needed)
    *
@@ -140,20 +242,41 @@ public:
    */
   bool IsSendingComplete()
   {
+    return IsSendingComplete(_tp.AmdtpDefaultConnection());
+  }
 
-    if (_tp.AmdtpSendComplete()){
+  bool IsSendingComplete(ble::connection_handle_t conn)
+  {
+
+    if (_tp.AmdtpSendComplete(conn)){
 
-        // cancel timeout check
-        if (cancelhandle > 0) {
-            _event_queue.cancel(cancelhandle);
-            cancelhandle = 0;
-        }
+        // cancel timeout check of this central
+        _tp.AmdtpSendTimeoutStop(conn);
         return true;
     }
 
     return false;
   }
 
+ /**
+  * call backs from AMDTP for a received stream, forwarded to the sketch
+  * when it has the functions
+  */
+ void Stream_From_AMDTP(uint8_t *data, uint16_t len, uint32_t offset)
+ {
+   if (StoreStreamReceived) StoreStreamReceived(data, len, offset);
+ }
+
+ void Stream_Done_AMDTP(eAmdtpStatus_t status, uint32_t len)
+ {
+   if (StreamReceivedDone) StreamReceivedDone(status, len);
+ }
+
+ void Data_Done_AMDTP(eAmdtpStatus_t status, uint16_t len)
+ {
+   if (DataPartDone) DataPartDone(status, len);
+ }
+
  /**
    * call back from AMDTP when data is ready to be returned.
    *
@@ -178,6 +301,9 @@ private:
     /* this allows us to receive events like onConnectionComplete() */
     _ble.gap().setEventHandler(this);
 
+    /* MTU changes and notifications that have been sent */
+    _ble.gattServer().setEventHandler(this);
+
     _ble.gattServer().onDataWritten(this, &GattServAMDTP::onDataWritten);
 
     start_advertising();
@@ -197,26 +323,31 @@ private:
     printf(" error_code %d\r\n",params->error_code );
 */
 
-    // send to AMDTP
-    _tp.AmdtpReceivePkt(params->handle, params->len, (uint8_t *) params->data);
+    // send to AMDTP of this central
+    _tp.AmdtpReceivePkt(params->connHandle, params->len, (uint8_t *) params->data);
+  }
+
+  /* new MTU agreed with the Central / client */
+  virtual void onAttMtuChange(ble::connection_handle_t connectionHandle, uint16_t attMtuSize)
+  {
+    _tp.UpdateMTU(connectionHandle, attMtuSize);
+  }
+
+  /* notifications have been sent, room for the next window frames of the centrals in turn */
+  virtual void onDataSent(const GattDataSentCallbackParams &params)
+  {
+    _tp.AmdtpPump();
   }
 
  /**
-   * timeout is set when sending in multipacket mode
+   * timeout is set when sending in multipacket mode, one per central
    */
-  void TimedOutSend()
+  void TimedOutSend(ble::connection_handle_t conn)
   {
-      if (_tp.AmdtpSendComplete()){
-        if (cancelhandle > 0) {
-            _event_queue.cancel(cancelhandle);
-            cancelhandle = 0;
-        }
-
-      }
-      else {
+      if (! _tp.AmdtpSendComplete(conn)) {
         printf("%s: Failed to get response data from Central\n",__FILE__);
-        // reset all pointers of the amdtp service
-        _tp.amdtps_init();
+        // stop the transfer of this central, the negotiated session stays
+        _tp.amdtps_reset(conn);
       }
   }
 
@@ -273,6 +404,16 @@ private:
     if (event.getStatus() == ble_error_t::BLE_ERROR_NONE) {
      _IsConnected = true;
      _IsAdvertising = false;
+
+     if (! _tp.AmdtpConnect(event.getConnectionHandle())) {
+       printf("%s: No room for AMDTP of another Central\r\n",__FILE__);
+       _ble.gap().disconnect(event.getConnectionHandle(), ble::local_disconnection_reason_t::USER_TERMINATION);
+       return;
+     }
+
+     // room for another Central (the stack also needs cordio.max-connections)
+     if (_tp.AmdtpConnections() < AMDTP_MAX_CONNECTIONS)
+       _IsAdvertising = _ble.gap().startAdvertising(ble::LEGACY_ADVERTISING_HANDLE) == BLE_ERROR_NONE;
     }
     else {
       printf("%s: Error connecting\r\n",__FILE__);
@@ -283,10 +424,12 @@ private:
   virtual void onDisconnectionComplete(const ble::DisconnectionCompleteEvent &event)
   {
     printf("Client disconnected, restarting advertising\r\n");
-    _IsConnected = false;
 
-    // reset the amdtps
-    _tp.amdtps_init();
+    // free the amdtps of this client
+    _tp.AmdtpDisconnect(event.getConnectionHandle());
+    _IsConnected = _tp.AmdtpConnections() > 0;
+
+    if (_IsAdvertising) return;
 
     ble_error_t error = _ble.gap().startAdvertising(ble::LEGACY_ADVERTISING_HANDLE);
 
@@ -294,6 +437,8 @@ private:
       printf("%s startAdvertising() failed\r\n",__FILE__);
       return;
     }
+
+    _IsAdvertising = true;
   }
 
 private:
@@ -309,7 +454,6 @@ private:
 
   bool _IsConnected = false;
   bool _IsAdvertising = false;
-  int cancelhandle = 0;
 };
 
 #endif //BLE_GATT_SRV_AMDTP_H
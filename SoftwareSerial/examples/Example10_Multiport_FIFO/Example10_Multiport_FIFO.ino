@@ -0,0 +1,89 @@
+/*
+  Author: Paul van Haastrecht
+  Created: October 2026
+  License: MIT. See SparkFun Arduino Apollo3 Project for more information
+
+  Feel like supporting open source hardware? Buy a board from SparkFun!
+  https://www.sparkfun.com/artemis
+
+  PURPOSE:
+  =======
+  This example shows how to receive on 3 ports at the same time, e.g. a GPS and 2 sensors.
+
+  BACKGROUND:
+  ==========
+  Without FIFO mode only one port can listen, switching with listen() loses the bytes that come in on
+  the other ports. Ports in FIFO mode (setRxFifo(true), see example9) all listen at the same time, up
+  to AP3_SS_RX_PORTS (4). Each has its own receive buffer and statistics.
+
+  All RX pins share the same GPIO interrupt, that takes about 18us per level change. The bench on a host
+  (extras/ss_sim, ./ss_bench -P, see the readme) shows 4 ports at 14400, 2 at 19200 or 3 ports at 9600
+  with one at 19200 work. Keep the baud rates low when the sensors allow it.
+
+  Every 10 seconds the statistics of each port are displayed.
+
+  Hardware Connections:
+  Connect the TX of each device to the RX pin of a port, and GND to GND.
+    GPS       TX -> D7    (9600)
+    sensor A  TX -> D2    (9600)
+    sensor B  TX -> D4    (9600)
+  Load this code
+  Open Arduino serial monitor at 115200
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <SoftwareSerial.h>
+
+SoftwareSerial gps(D7, D8);       //RX, TX - Any pins can be used
+SoftwareSerial sensorA(D2, D3);
+SoftwareSerial sensorB(D4, D5);
+
+SoftwareSerial *ports[] = { &gps, &sensorA, &sensorB };
+const char *names[] = { "GPS", "sensor A", "sensor B" };
+
+#define NUM_PORTS 3
+
+unsigned long lastReport = 0;
+
+void setup() {
+  Serial.begin(115200);
+  Serial.println("Software Serial Example 10 : receive on 3 ports at the same time");
+
+  for (int i = 0; i < NUM_PORTS; i++) {
+    ports[i]->setRxFifo(true);  // must be called before begin()
+    ports[i]->begin(9600);      // begin() calls listen(), the other ports keep listening
+  }
+}
+
+void loop() {
+
+  // the GPS sentences are displayed
+  while (gps.available()) Serial.write(gps.read());
+
+  // the sensor data is only counted here
+  while (sensorA.available()) sensorA.read();
+  while (sensorB.available()) sensorB.read();
+
+  if (millis() - lastReport > 10000)
+  {
+    ssRxStats_t st;
+
+    Serial.println("\nport       bytes  overflows  edges lost  framing  parity");
+
+    for (int i = 0; i < NUM_PORTS; i++) {
+      ports[i]->getRxStats(&st, true);   // and clear them
+      Serial.printf("%-9s %6lu %10lu %11lu %8lu %7lu\n", names[i], (unsigned long) st.bytes,
+                    (unsigned long) st.overflows, (unsigned long) st.edgesLost, (unsigned long) st.framing,
+                    (unsigned long) st.parity);
+    }
+
+    lastReport = millis();
+  }
+}
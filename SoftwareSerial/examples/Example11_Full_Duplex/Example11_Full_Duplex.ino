@@ -0,0 +1,79 @@
+/*
+  Author: Paul van Haastrecht
+  Created: October 2026
+  License: MIT. See SparkFun Arduino Apollo3 Project for more information
+
+  Feel like supporting open source hardware? Buy a board from SparkFun!
+  https://www.sparkfun.com/artemis
+
+  PURPOSE:
+  =======
+  This example shows sending and receiving at the same time on one port (full duplex).
+
+  BACKGROUND:
+  ==========
+  Without FIFO mode sending stops the receiving, a byte that comes in while a reply is sent is lost.
+  A port in FIFO mode (setRxFifo(true), see example9) keeps receiving : the bits that are sent are
+  scheduled on the same timer compare as the receiving, so a reply can start while the request is
+  still coming in.
+
+  Each byte that is received is sent back at once, with the bytes in between still coming in. Type a
+  long line in the terminal, it is echoed while it is received. Every 10 seconds the statistics are
+  displayed.
+
+  The bench on a host (extras/ss_sim, ./ss_bench -d, see the readme) shows receiving and sending at the
+  same time is fine up to 19200, and 9600 with other ports receiving.
+
+  Hardware Connections:
+  Connect a USB-to-serial adapter (3.3V) to the port, and GND to GND.
+    adapter TX -> D7   (RX of the port)
+    adapter RX -> D8   (TX of the port)
+  Open a terminal program on the adapter at 19200
+  Load this code
+  Open Arduino serial monitor at 115200
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <SoftwareSerial.h>
+
+SoftwareSerial mySerial(D7, D8);  //RX, TX - Any pins can be used
+
+unsigned long lastReport = 0;
+unsigned long echoed = 0;
+
+void setup() {
+  Serial.begin(115200);
+  Serial.println("Software Serial Example 11 : full duplex");
+
+  mySerial.setRxFifo(true);   // must be called before begin()
+  mySerial.begin(19200);
+}
+
+void loop() {
+
+  // write() puts the byte in the TX buffer, receiving goes on while it is sent
+  while (mySerial.available()) {
+    mySerial.write(mySerial.read());
+    echoed++;
+  }
+
+  if (millis() - lastReport > 10000)
+  {
+    ssRxStats_t st;
+
+    mySerial.getRxStats(&st, true);   // and clear them
+    Serial.printf("echoed %lu, received %lu, overflows %lu, edges lost %lu, framing %lu, parity %lu\n",
+                  echoed, (unsigned long) st.bytes, (unsigned long) st.overflows, (unsigned long) st.edgesLost,
+                  (unsigned long) st.framing, (unsigned long) st.parity);
+
+    echoed = 0;
+    lastReport = millis();
+  }
+}
@@ -10,6 +10,7 @@
   This example shows how to enable multiple software serial ports at 19200bps.
   You can only receive on one pin at a time. Use .listen() to switch between
   RX pins.
+  To receive on several pins at the same time, see Example10_Multiport_FIFO.
 
   Note: When multiple ports are enabled receiving at 38400 is no longer
   possible. This is because the receive interrupt has additional overhead
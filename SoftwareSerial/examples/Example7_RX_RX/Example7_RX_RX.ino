@@ -10,6 +10,7 @@
   Any pin can be used for TX or RX.
 
   Note: In this SoftwareSerial library you cannot TX and RX at the same time.
+  Only a port in FIFO mode can (setRxFifo(true), see example11).
   TX gets priority. So if Artemis is receiving a string of characters
   and you do a Serial.print() the print will begin immediately and any additional
   RX characters will be lost.
@@ -0,0 +1,89 @@
+/*
+  Author: Paul van Haastrecht
+  Created: October 2026
+  License: MIT. See SparkFun Arduino Apollo3 Project for more information
+
+  Feel like supporting open source hardware? Buy a board from SparkFun!
+  https://www.sparkfun.com/artemis
+
+  PURPOSE:
+  =======
+  This example shows how to receive at 38400 with the FIFO receive mode.
+
+  BACKGROUND:
+  ==========
+  Normally the bits of a byte are made in the interrupt of the RX pin (rxBit()). That takes 3 - 8us
+  for each level change, on top of the 18us it already takes the V2 library to call that interrupt.
+  At 38400 (26us a bit) that does not fit for all byte values.
+
+  With setRxFifo(true) the interrupt only stores the time of the level change. The bytes are made from
+  those times at the end of each byte, in the timer interrupt. That can be interrupted by the RX pin, so
+  no level change is missed. The stop bit is checked as well, a low stop bit (or a sender that is too
+  far off) is reported as a framing error by rxErrors().
+
+  The bench on a host (extras/ss_sim, see the readme) shows that 38400 is then stable for all byte values
+  and configurations, also with a sender that is a few % off. Above 38400 is still not possible : the 18us
+  before the interrupt is called is longer than a bit.
+
+  Hardware Connections:
+  Attach a USB to serial converter (https://www.sparkfun.com/products/15096)
+  Connect
+    GND on SerialBasic <-> GND on Artemis
+    RXO on SerialBasic <-> Pin 8 on Artemis
+    TXO on SerialBasic <-> Pin 7 on Artemis
+  Load this code
+  Open Arduino serial monitor at 115200
+  Open Terminal window (TeraTerm) at 38400
+  Send a file from the terminal window, you should see it in Arduino monitor
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <SoftwareSerial.h>
+SoftwareSerial mySerial(D7, D8); //RX, TX - Any pins can be used
+
+unsigned long received = 0;
+unsigned long lastReport = 0;
+
+void setup() {
+  //We set the serial monitor speed high so that we spend less time printing the output
+  //and more time checking mySerial.available()
+  Serial.begin(115200);
+  Serial.println("Software Serial Example 9 : FIFO receive");
+
+  mySerial.setRxFifo(true);  // must be called before begin()
+  mySerial.begin(38400);
+}
+
+void loop() {
+
+  while (mySerial.available())
+  {
+    byte incoming = mySerial.read();
+    Serial.write(incoming);
+    received++;
+  }
+
+  // report errors every 5 seconds
+  if (millis() - lastReport > 5000)
+  {
+    uint8_t err = mySerial.rxErrors();
+
+    if (err & SS_RX_FRAMING) Serial.println("\nFraming error(s)");
+    if (err & SS_RX_PARITY) Serial.println("\nParity error(s)");
+    if (mySerial.overflow()) Serial.println("\nBuffer overflow");
+
+    if (err || received) {
+      Serial.print("\nReceived ");
+      Serial.println(received);
+    }
+
+    lastReport = millis();
+  }
+}
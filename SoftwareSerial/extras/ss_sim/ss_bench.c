@@ -0,0 +1,1506 @@
+/*
+ * ss_bench.c : the receive decoder of SoftwareSerial (src/ss_decoder.h) on a
+ * host, fed with synthesized edges instead of a scope on the RX pin.
+ *
+ * A sender makes the frames (start, data LSB first, parity, stop bits) of
+ * random bytes and of all byte values, back to back, at a baud rate that can
+ * be off (skew). The edges go through a model of the Apollo3 interrupts :
+ *
+ *  - an edge sets the GPIO interrupt. It is taken when the CPU is free, the
+ *    status is cleared clear us later and rxBit() reads STTMR latency us
+ *    after the edge (+ 0 .. jitter us). An edge before that clear is lost.
+ *  - rxBit() takes edgeBase + edgePerBit x bits us (3.3us for 1 bit,
+ *    4.6 for 2 .. as measured, see SoftwareSerial.cpp)
+ *  - the STIMER compare fires ticksPerByte after the STTMR of the start bit,
+ *    rxEndOfByte() starts cmpLatency us later when the CPU is free and takes
+ *    endTime us. An edge during rxEndOfByte() is cleared (lost).
+ *  - both have the same priority, GPIO first when at the same time.
+ *
+ * The fifo model is setRxFifo() : rxEdge() only stores STTMR (0.5us) and the
+ * compare, that the GPIO interrupt can interrupt, makes the bytes with
+ * ssDecoderNext() half a bit after the last stop bit started.
+ *
+ * It maps the highest baud rate per configuration where every byte is
+ * received right, for Mbed bypassed (BYPASS_MBED_INTERRUPT) and not, with a
+ * sender on the nominal baud rate and 2% off. The latency and times are
+ * those of the comments in SoftwareSerial.cpp / h, they can be changed with
+ * the options to see what a faster interrupt path would give.
+ *
+ *  ./ss_bench              the table
+ *  ./ss_bench -t           self test, exit 1 on a failure
+ *  ./ss_bench -b 38400 -c 8E1 -v     one baud rate and configuration
+ *  ./ss_bench -e           decoder time on this host and the longest latency
+ *  ./ss_bench -P           multi-port : up to 4 ports in FIFO mode at once
+ *  ./ss_bench -d           full duplex on a port in FIFO mode
+ *  ./ss_bench -h           options
+ *
+ * compile with ./make_ss_sim
+ *
+ * paulvha / October 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "ss_decoder.h"
+
+#define TIMER_FREQ      3000000L    // STIMER, as SoftwareSerial.h
+#define TICKS_US        3.0         // STIMER ticks per us
+#define MAX_BYTES       4096
+#define MAX_EDGES       (MAX_BYTES * 12)
+#define START_US        100.0       // first start bit
+
+typedef struct
+{
+  const char *name;
+  uint8_t dataBits;
+  uint8_t parity;                   // 0 none, 1 odd, 2 even
+  uint8_t stopBits;
+} config_t;
+
+static const config_t configs[] =
+{
+  { "8N1", 8, 0, 1 }, { "8N2", 8, 0, 2 }, { "8E1", 8, 2, 1 }, { "8O1", 8, 1, 1 },
+  { "8E2", 8, 2, 2 }, { "8O2", 8, 1, 2 }, { "7N1", 7, 0, 1 }, { "7N2", 7, 0, 2 },
+  { "7E1", 7, 2, 1 }, { "7O1", 7, 1, 1 }, { "7E2", 7, 2, 2 }, { "7O2", 7, 1, 2 },
+  { "6N1", 6, 0, 1 }, { "6N2", 6, 0, 2 }, { "6E1", 6, 2, 1 }, { "6O1", 6, 1, 1 },
+  { "6E2", 6, 2, 2 }, { "6O2", 6, 1, 2 }, { "5N1", 5, 0, 1 }, { "5N2", 5, 0, 2 },
+  { "5E1", 5, 2, 1 }, { "5O1", 5, 1, 1 }, { "5E2", 5, 2, 2 }, { "5O2", 5, 1, 2 },
+};
+
+#define NUM_CONFIGS     (sizeof(configs) / sizeof(config_t))
+#define TABLE_CONFIGS   8                       // 8xx and 7N1 unless -a
+
+static const uint32_t bauds[] =
+{
+  1200, 2400, 4800, 9600, 14400, 19200, 28800, 38400, 57600, 76800, 115200
+};
+
+#define NUM_BAUDS       (sizeof(bauds) / sizeof(uint32_t))
+
+typedef struct
+{
+  const char *name;
+  double latency;                   // us from the edge to reading STTMR in rxBit()
+  double jitter;                    // us extra latency, 0 .. jitter
+  double clear;                     // us from the edge to the clear of the GPIO status
+  double edgeBase;                  // us in rxBit() : edgeBase + edgePerBit x bits
+  double edgePerBit;
+  double cmpLatency;                // us from the compare to rxEndOfByte()
+  double endTime;                   // us in rxEndOfByte()
+  bool fifo;                        // FIFO mode : rxEdge() only stores STTMR
+} model_t;
+
+/* FIFO mode : rxBit() is about 0.5us (STTMR in the FIFO), the compare
+ * interrupt has a lower priority than the GPIO and does not delay it */
+static model_t models[] =
+{
+  { "bypass", 18.0, 2.0, 3.5, 2.1, 1.2, 1.0, 6.0, false },
+  { "mbed",   22.0, 2.0, 3.5, 2.1, 1.2, 1.0, 6.0, false },
+  { "fifo",   18.0, 2.0, 3.5, 0.5, 0.0, 1.0, 0.0, true },
+};
+
+#define NUM_MODELS      (sizeof(models) / sizeof(model_t))
+
+typedef struct
+{
+  uint32_t  bytes;                  // sent
+  uint32_t  received;
+  uint32_t  errors;                 // bytes wrong or missing
+  uint32_t  extra;                  // bytes that did not start on a start bit
+  uint32_t  framing;                // flagged by the decoder
+  uint32_t  parity;
+  uint32_t  lost;                   // edges lost on the GPIO interrupt
+  double    maxBusy;                // longest time the CPU was in an interrupt
+} result_t;
+
+static double edges[MAX_EDGES];     // us, the level changes on the RX pin
+static uint8_t sent[MAX_BYTES];
+static uint8_t received[MAX_BYTES * 2];
+static uint8_t status[MAX_BYTES * 2];
+static double startEdge[MAX_BYTES * 2];   // us, the edge rxBit() took as start bit
+static double frameTime, bitTime;         // us, of the sender
+
+static bool verbose = false;
+static bool printable = false;      // only 0x20 - 0x7E, readable text
+static uint32_t timerBase = 1000;   // STTMR at t = 0, to test the wrap
+
+static uint8_t parityBit(const config_t *c, uint8_t b)
+{
+  uint8_t ones = 0, x;
+
+  for (x = 0; x < c->dataBits; x++)
+    if (b & (1 << x)) ones++;
+
+  return c->parity == 1 ? !(ones & 1) : (ones & 1);
+}
+
+/* a level per bit of each frame, the edges where it changes.
+ * badParity / badStop : make that bit of every frame wrong */
+static int makeEdges(const config_t *c, const uint8_t *bytes, int n, double bitUs, int gapBits,
+                     bool badParity, bool badStop)
+{
+  bool level = true, bit;
+  double t = START_US;
+  int e = 0, i, b, frame = 1 + c->dataBits + (c->parity ? 1 : 0) + c->stopBits + gapBits;
+
+  bitTime = bitUs;
+  frameTime = frame * bitUs;
+
+  for (i = 0; i < n; i++)
+  {
+    for (b = 0; b < frame; b++)
+    {
+      if (b == 0) bit = false;
+      else if (b <= c->dataBits) bit = bytes[i] & (1 << (b - 1));
+      else if (c->parity && b == c->dataBits + 1) bit = parityBit(c, bytes[i]) ^ badParity;
+      else if (badStop && b == c->dataBits + (c->parity ? 1 : 0) + 1) bit = false;
+      else bit = true;
+
+      if (bit != level)
+      {
+        edges[e++] = t;
+        level = bit;
+      }
+
+      t += bitUs;
+    }
+  }
+
+  // back to idle at the end
+  if (! level) edges[e++] = t;
+
+  return e;
+}
+
+static double jitter(const model_t *m)
+{
+  return m->jitter * (rand() / (RAND_MAX + 1.0));
+}
+
+static uint32_t sttmr(double t)
+{
+  return timerBase + (uint32_t)(t * TICKS_US);
+}
+
+// run the edges through the interrupt model and the decoder
+static int simulate(const config_t *c, const model_t *m, uint32_t baud, int numEdges, result_t *r)
+{
+  ssDecoder_t d;
+  double cpuFree = 0, endAt = 0, edge, s, capture, busy;
+  int e = 0, n = 0;
+  uint8_t bits;
+
+  ssDecoderInit(&d, TIMER_FREQ, baud, c->dataBits, c->parity, c->stopBits);
+
+  while (e < numEdges || d.active)
+  {
+    double gpio = 1e30, end = 1e30;
+
+    // an edge while the CPU is busy waits for it
+    if (e < numEdges) gpio = edges[e] > cpuFree ? edges[e] : cpuFree;
+    if (d.active) end = endAt > cpuFree ? endAt : cpuFree;
+
+    if (gpio <= end)
+    {
+      s = gpio;
+      edge = edges[e++];
+
+      // edges until the status is cleared are the same interrupt
+      while (e < numEdges && edges[e] <= s + m->clear)
+      {
+        r->lost++;
+        e++;
+      }
+
+      capture = s + m->latency + jitter(m);
+      bits = d.bits;
+
+      if (ssDecoderEdge(&d, sttmr(capture)))
+      {
+        endAt = capture + d.ticksPerByte / TICKS_US + m->cmpLatency;
+        if (n < MAX_BYTES * 2) startEdge[n] = edge;
+      }
+
+      cpuFree = capture + m->edgeBase + m->edgePerBit * (uint8_t)(d.bits - bits);
+    }
+    else
+    {
+      s = end;
+
+      if (n < MAX_BYTES * 2)
+      {
+        status[n] = ssDecoderEnd(&d, &received[n]);
+        if (status[n] & SS_RX_FRAMING) r->framing++;
+        if (status[n] & SS_RX_PARITY) r->parity++;
+        n++;
+      }
+      else
+      {
+        uint8_t dummy;
+        ssDecoderEnd(&d, &dummy);
+      }
+
+      cpuFree = s + m->endTime;
+
+      // edges during rxEndOfByte() are cleared at its end
+      while (e < numEdges && edges[e] <= cpuFree)
+      {
+        r->lost++;
+        e++;
+      }
+    }
+
+    busy = cpuFree - s;
+    if (busy > r->maxBusy) r->maxBusy = busy;
+  }
+
+  r->received += n;
+  return n;
+}
+
+// FIFO mode : the same edges through rxBit() with the FIFO and the deferred decoder
+static int simulateFifo(const config_t *c, const model_t *m, uint32_t baud, int numEdges, result_t *r)
+{
+  static uint32_t pushTick[MAX_EDGES];
+  static double pushEdge[MAX_EDGES];
+  static ssEdgeFifo_t f;
+  ssDecoder_t d;
+  double cpuFree = 0, cmpAt = 0, edge, s, capture, busy;
+  bool rxInUse = false;
+  int e = 0, n = 0, pushed = 0, k = 0;
+  uint8_t b, st;
+
+  ssDecoderInit(&d, TIMER_FREQ, baud, c->dataBits, c->parity, c->stopBits);
+  ssDecoderDeferred(&d);
+  ssEdgeFifoReset(&f);
+  f.lost = 0;
+
+  while (e < numEdges || rxInUse)
+  {
+    double gpio = 1e30, cmp = 1e30;
+
+    if (e < numEdges) gpio = edges[e] > cpuFree ? edges[e] : cpuFree;
+    if (rxInUse) cmp = cmpAt > cpuFree ? cmpAt : cpuFree;
+
+    if (gpio <= cmp)
+    {
+      s = gpio;
+      edge = edges[e++];
+
+      while (e < numEdges && edges[e] <= s + m->clear)
+      {
+        r->lost++;
+        e++;
+      }
+
+      capture = s + m->latency + jitter(m);
+      pushTick[pushed] = sttmr(capture);
+      pushEdge[pushed++] = edge;
+      ssEdgePush(&f, sttmr(capture));
+
+      if (! rxInUse)
+      {
+        rxInUse = true;
+        cmpAt = capture + d.ticksEnd / TICKS_US + m->cmpLatency;
+      }
+
+      cpuFree = capture + m->edgeBase;
+      busy = cpuFree - s;
+      if (busy > r->maxBusy) r->maxBusy = busy;
+    }
+    else
+    {
+      // as rxFifoDecode()
+      while (ssDecoderNext(&d, &f, sttmr(cmp), &b, &st))
+      {
+        if (n >= MAX_BYTES * 2) continue;
+
+        // the real edge of the start bit
+        while (k < pushed && pushTick[k] != d.startTime) k++;
+        startEdge[n] = k < pushed ? pushEdge[k] : 0;
+
+        received[n] = b;
+        status[n] = st;
+        if (st & SS_RX_FRAMING) r->framing++;
+        if (st & SS_RX_PARITY) r->parity++;
+        n++;
+      }
+
+      if (d.active)
+        cmpAt = cmp + (d.startTime + d.ticksEnd - sttmr(cmp)) / TICKS_US;
+      else if (ssEdgeFifoEmpty(&f))
+        rxInUse = false;
+      else
+        cmpAt = cmp + d.ticksEnd / TICKS_US;
+    }
+  }
+
+  r->lost += f.lost;
+  r->received += n;
+  return n;
+}
+
+/* a byte belongs to the frame of its start bit, a byte that did not start
+ * on a start bit is extra. Errors are the frames without their byte */
+static uint32_t compare(const config_t *c, const uint8_t *bytes, int n, int got, result_t *r)
+{
+  static bool ok[MAX_BYTES];
+  uint32_t errors = 0;
+  double pos;
+  int i, f;
+
+  memset(ok, 0, sizeof(ok));
+
+  for (i = 0; i < got; i++)
+  {
+    pos = (startEdge[i] - START_US) / frameTime;
+    f = (int)(pos + 0.5);
+
+    if (f >= n || (pos - f) * frameTime > bitTime / 2 || (f - pos) * frameTime > bitTime / 2)
+    {
+      if (verbose && r->extra < 10)
+        printf("  extra byte 0x%02X status %d, started at %.1f us\n", received[i], status[i], startEdge[i]);
+      r->extra++;
+    }
+    else if (received[i] == bytes[f])
+      ok[f] = true;
+    else if (verbose && errors < 10)
+      printf("  byte %d : sent 0x%02X got 0x%02X status %d\n", f, bytes[f], received[i], status[i]);
+  }
+
+  for (f = 0; f < n; f++)
+    if (! ok[f]) errors++;
+
+  r->bytes += n;
+  r->errors += errors;
+  return errors + r->extra;
+}
+
+// all byte values of the configuration, then random ones
+static int makeBytes(const config_t *c, int n)
+{
+  int i, all = 1 << c->dataBits;
+
+  for (i = 0; i < n; i++)
+  {
+    if (printable && c->dataBits >= 7)
+      sent[i] = 0x20 + (i < 0x5f ? i : rand() % 0x5f);
+    else
+      sent[i] = (i < all ? i : rand()) & (all - 1);
+  }
+
+  return n;
+}
+
+static void run(const config_t *c, const model_t *m, uint32_t baud, double skew, int n, int gap, result_t *r)
+{
+  int numEdges, got;
+
+  makeBytes(c, n);
+  numEdges = makeEdges(c, sent, n, 1e6 / baud * (1 + skew / 100), gap, false, false);
+  got = m->fifo ? simulateFifo(c, m, baud, numEdges, r) : simulate(c, m, baud, numEdges, r);
+  compare(c, sent, n, got, r);
+}
+
+/* per model a line per configuration and sender : the % of the bytes
+ * wrong or missing per baud rate ("ok" : none and no extra bytes) and the
+ * highest baud rate that is ok. A sender that is slow can fail on the low
+ * baud rates only : the last edge comes after rxEndOfByte() */
+static void table(int numConfigs, int n, int gap, double skew)
+{
+  double skews[3] = { -skew, 0, skew };
+  uint32_t best;
+  unsigned cf, mo, sk, b;
+  result_t r;
+
+  printf("bytes wrong per baud rate, %d %s per run, back to back%s\n", n, printable ? "text bytes" : "bytes",
+         gap ? " with an idle gap" : "");
+
+  for (mo = 0; mo < NUM_MODELS; mo++)
+  {
+    printf("\n%s : latency %.1f us, jitter %.1f us\n\nconfig sender ", models[mo].name, models[mo].latency,
+           models[mo].jitter);
+    for (b = 0; b < NUM_BAUDS; b++) printf("%7u", bauds[b]);
+    printf("    max\n");
+
+    for (cf = 0; cf < (unsigned) numConfigs; cf++)
+    {
+      for (sk = 0; sk < 3; sk++)
+      {
+        printf("%-6s %+5.1f%% ", configs[cf].name, skews[sk]);
+        best = 0;
+
+        for (b = 0; b < NUM_BAUDS; b++)
+        {
+          memset(&r, 0, sizeof(r));
+          run(&configs[cf], &models[mo], bauds[b], skews[sk], n, gap, &r);
+
+          if (r.errors == 0 && r.extra == 0)
+          {
+            printf("     ok");
+            best = bauds[b];
+          }
+          else
+            printf(" %5.1f%%", 100.0 * r.errors / n);
+        }
+
+        printf(" %6u\n", best);
+      }
+    }
+  }
+}
+
+/* multi-port : ports in FIFO mode on the same GPIO interrupt and compare,
+ * each sender on its own phase. The GPIO interrupt serves all pins with an
+ * edge until the status is cleared, one after the other. The compare runs
+ * ssDecoderNext() for every port and is armed for the first byte due, as
+ * rxEdge() / rxPortsService() / rxPortsSchedule() */
+#define MAX_PORTS       4
+#define PORT_BYTES      1024
+#define PORT_EDGES      (PORT_BYTES * 12)
+#define PIN_US          5.0         // per next pin in the same GPIO interrupt, not measured
+
+typedef struct
+{
+  const config_t *c;
+  uint32_t  baud;
+  double    skew;                   // % sender off
+  double    offset;                 // us, first start bit after START_US
+  int       n;
+  uint8_t   sent[PORT_BYTES];
+  double    edges[PORT_EDGES];
+  int       numEdges, e;
+  double    frameTime, bitTime;
+
+  ssDecoder_t  d;
+  ssEdgeFifo_t f;
+  uint32_t  pushTick[PORT_EDGES];
+  double    pushEdge[PORT_EDGES];
+  int       pushed, k;
+
+  uint8_t   received[PORT_BYTES * 2];
+  uint8_t   status[PORT_BYTES * 2];
+  double    startEdge[PORT_BYTES * 2];
+  int       got;
+  result_t  r;
+} port_t;
+
+static port_t ports[MAX_PORTS];
+
+/* full duplex : port 0 sends these bytes while it receives, the bits are
+ * events on the same compare as txDuplexStart() / txDuplex() */
+#define TX_US           1.0         // from the compare to the level change on the TX pin, not measured
+
+typedef struct
+{
+  int       n;                      // bytes to send, 0 : none
+  uint8_t   bytes[PORT_BYTES];
+  double    at;                     // us, write() of the first byte
+  double    edges[PORT_EDGES];      // us, the level changes on the TX pin
+  int       numEdges;
+  double    maxLate;                // us, latest level change after its time
+} tx_t;
+
+static tx_t tx;
+
+static void setupPort(port_t *p, const config_t *c, uint32_t baud, double skew, double offset, int n)
+{
+  int i;
+
+  p->c = c;
+  p->baud = baud;
+  p->skew = skew;
+  p->offset = offset;
+  p->n = n;
+
+  makeBytes(c, n);
+  memcpy(p->sent, sent, n);
+  p->numEdges = makeEdges(c, sent, n, 1e6 / baud * (1 + skew / 100), 0, false, false);
+  for (i = 0; i < p->numEdges; i++) p->edges[i] = edges[i] + offset;
+  p->frameTime = frameTime;
+  p->bitTime = bitTime;
+  memset(&p->r, 0, sizeof(result_t));
+}
+
+// us at which STTMR is tick, from t
+static double atTick(double t, uint32_t tick)
+{
+  return t + (int32_t)(tick - sttmr(t)) / TICKS_US;
+}
+
+// full duplex : the level of bit txBit of the frame at t, which should be at due
+static void txLevel(uint16_t frame, uint8_t txBit, bool *level, double t, double due)
+{
+  bool l = (frame >> txBit) & 1;
+
+  if (l == *level) return;
+
+  if (tx.numEdges < PORT_EDGES) tx.edges[tx.numEdges++] = t;
+  if (t - due > tx.maxLate) tx.maxLate = t - due;
+  *level = l;
+}
+
+static void simulatePorts(int numPorts, const model_t *m)
+{
+  ssTimer_t tm = { false, 0 };
+  double gpioFree = 0, cmpAt = 0, s, t, capture, edge, busy, write;
+  uint32_t tick, due, now, txStart = 0, txDue = 0;
+  uint16_t frame = 0;
+  uint8_t b, st, txBit = 0, txBits = 0;
+  bool idle, txActive = false, level = true;
+  const config_t *c = ports[0].c;
+  port_t *p;
+  int i, txNext = 0;
+
+  tx.numEdges = 0;
+  tx.maxLate = 0;
+  write = tx.n ? tx.at : 1e30;
+
+  for (i = 0; i < numPorts; i++)
+  {
+    p = &ports[i];
+    ssDecoderInit(&p->d, TIMER_FREQ, p->baud, p->c->dataBits, p->c->parity, p->c->stopBits);
+    ssDecoderDeferred(&p->d);
+    ssEdgeFifoReset(&p->f);
+    p->f.lost = 0;
+    p->e = p->pushed = p->k = p->got = 0;
+  }
+
+  for (;;)
+  {
+    double gpio = 1e30, cmp = 1e30;
+
+    for (i = 0; i < numPorts; i++)
+      if (ports[i].e < ports[i].numEdges && ports[i].edges[ports[i].e] < gpio) gpio = ports[i].edges[ports[i].e];
+
+    if (gpio < 1e30 && gpio < gpioFree) gpio = gpioFree;
+
+    // the compare has a lower priority, it waits for the GPIO interrupt
+    if (tm.armed) cmp = (cmpAt > gpioFree ? cmpAt : gpioFree) + m->cmpLatency;
+
+    if (gpio == 1e30 && cmp == 1e30 && write == 1e30) break;
+
+    // as write() : the start bit of the first byte
+    if (write < 1e30 && write <= gpio && write <= cmp)
+    {
+      t = write > gpioFree ? write : gpioFree;
+      write = 1e30;
+
+      txStart = sttmr(t);
+      txBits = ssTxFrame(c->dataBits, c->parity ? 1 : 0, c->stopBits, tx.bytes[0], parityBit(c, tx.bytes[0]), false,
+                         &frame);
+      txLevel(frame, 0, &level, t, t);
+      txNext = 1;
+      txBit = 1;
+      txDue = txStart + ssTxTicks(TIMER_FREQ, ports[0].baud, txBit);
+      txActive = true;
+      if (ssTimerOffer(&tm, txDue)) cmpAt = atTick(t, tm.due);
+      continue;
+    }
+
+    if (gpio <= cmp)
+    {
+      s = gpio;
+      t = s + m->latency + jitter(m);
+
+      for (i = 0; i < numPorts; i++)
+      {
+        p = &ports[i];
+
+        if (p->e >= p->numEdges || p->edges[p->e] > s + m->clear) continue;
+
+        edge = p->edges[p->e++];
+
+        while (p->e < p->numEdges && p->edges[p->e] <= s + m->clear)
+        {
+          p->r.lost++;
+          p->e++;
+        }
+
+        // as rxEdge()
+        capture = t;
+        tick = sttmr(capture);
+        idle = ! p->d.active && ssEdgeFifoEmpty(&p->f);
+        p->pushTick[p->pushed] = tick;
+        p->pushEdge[p->pushed++] = edge;
+        ssEdgePush(&p->f, tick);
+
+        if (idle && ssTimerOffer(&tm, tick + p->d.ticksEnd)) cmpAt = atTick(capture, tm.due);
+
+        t = capture + m->edgeBase + PIN_US;
+      }
+
+      gpioFree = t - PIN_US;
+      busy = gpioFree - s;
+      for (i = 0; i < numPorts; i++)
+        if (busy > ports[i].r.maxBusy) ports[i].r.maxBusy = busy;
+    }
+    else
+    {
+      // as rxPortsService()
+      now = sttmr(cmp);
+      tm.armed = false;
+
+      // as txDuplex(), first the bit
+      if (txActive && (int32_t)(now + SS_MIN_TICKS - txDue) >= 0)
+      {
+        t = cmp + TX_US;
+
+        if (txBit < txBits)
+        {
+          txLevel(frame, txBit, &level, t, atTick(cmp, txDue));
+          txBit++;
+          txDue = txStart + ssTxTicks(TIMER_FREQ, ports[0].baud, txBit);
+        }
+        else if (txNext == tx.n)
+          txActive = false;
+        else
+        {
+          // as txDuplexStart(), right after the stop bit(s)
+          txBits = ssTxFrame(c->dataBits, c->parity ? 1 : 0, c->stopBits, tx.bytes[txNext],
+                             parityBit(c, tx.bytes[txNext]), false, &frame);
+          txNext++;
+          txLevel(frame, 0, &level, t, atTick(cmp, txDue));
+          txStart = txDue;
+          txBit = 1;
+          txDue = txStart + ssTxTicks(TIMER_FREQ, ports[0].baud, txBit);
+        }
+      }
+
+      for (i = 0; i < numPorts; i++)
+      {
+        p = &ports[i];
+
+        while (ssDecoderNext(&p->d, &p->f, now, &b, &st))
+        {
+          if (p->got >= PORT_BYTES * 2) continue;
+
+          while (p->k < p->pushed && p->pushTick[p->k] != p->d.startTime) p->k++;
+          p->startEdge[p->got] = p->k < p->pushed ? p->pushEdge[p->k] - p->offset : 0;
+
+          p->received[p->got] = b;
+          p->status[p->got] = st;
+          if (st & SS_RX_FRAMING) p->r.framing++;
+          if (st & SS_RX_PARITY) p->r.parity++;
+          p->got++;
+        }
+      }
+
+      // as rxPortsSchedule()
+      for (i = 0; i < numPorts; i++)
+        if (ssDecoderDue(&ports[i].d, &ports[i].f, &due)) ssTimerOffer(&tm, due);
+
+      if (txActive) ssTimerOffer(&tm, txDue);
+
+      if (tm.armed) cmpAt = cmp + ssTimerDelta(&tm, now) / TICKS_US;
+    }
+  }
+
+  for (i = 0; i < numPorts; i++)
+  {
+    p = &ports[i];
+    p->r.lost += p->f.lost;
+    p->r.received += p->got;
+
+    // compare() works on the single port globals
+    memcpy(received, p->received, p->got);
+    memcpy(status, p->status, p->got);
+    memcpy(startEdge, p->startEdge, p->got * sizeof(double));
+    frameTime = p->frameTime;
+    bitTime = p->bitTime;
+    compare(p->c, p->sent, p->n, p->got, &p->r);
+  }
+}
+
+/* n ports 8N1 at the same baud rate, random phase, each sender random up to
+ * skew % off : the % of the bytes wrong of all ports */
+static double portsWrong(int numPorts, const model_t *m, uint32_t baud, double skew, int n, bool *ok)
+{
+  uint32_t errors = 0, bytes = 0;
+  int i;
+
+  for (i = 0; i < numPorts; i++)
+    setupPort(&ports[i], &configs[0], baud, skew * (2.0 * rand() / RAND_MAX - 1),
+              (1e6 / baud) * 10 * rand() / RAND_MAX, n);
+
+  simulatePorts(numPorts, m);
+
+  *ok = true;
+  for (i = 0; i < numPorts; i++)
+  {
+    errors += ports[i].r.errors;
+    bytes += ports[i].r.bytes;
+    if (ports[i].r.errors || ports[i].r.extra) *ok = false;
+  }
+
+  return 100.0 * errors / bytes;
+}
+
+// the multi-port table, and one run of 4 ports as GPS / sensors
+static void portsTable(int n, double skew)
+{
+  static const struct { const char *config; uint32_t baud; } mix[MAX_PORTS] =
+  {
+    { "8N1", 9600 }, { "8N1", 9600 }, { "8E1", 9600 }, { "8N1", 19200 }
+  };
+  const model_t *m = &models[2];
+  uint32_t best;
+  double wrong;
+  bool ok;
+  unsigned b, c;
+  int np, i;
+  port_t *p;
+
+  if (n > PORT_BYTES) n = PORT_BYTES;
+
+  printf("multi-port (fifo model, %.1f us per next pin) : %d bytes per port, 8N1, all ports at the same\n"
+         "baud rate, random phase, each sender up to %.1f%% off. Bytes wrong of all ports :\n\nports ",
+         PIN_US, n, skew);
+  for (b = 0; b < NUM_BAUDS; b++) printf("%7u", bauds[b]);
+  printf("    max\n");
+
+  for (np = 1; np <= MAX_PORTS; np++)
+  {
+    printf("%5d ", np);
+    best = 0;
+
+    for (b = 0; b < NUM_BAUDS; b++)
+    {
+      wrong = portsWrong(np, m, bauds[b], skew, n, &ok);
+      if (ok)
+      {
+        printf("     ok");
+        best = bauds[b];
+      }
+      else
+        printf(" %5.1f%%", wrong);
+    }
+
+    printf(" %6u\n", best);
+  }
+
+  printf("\nmixed, each sender up to %.1f%% off :\n\n", skew);
+
+  for (i = 0; i < MAX_PORTS; i++)
+  {
+    for (c = 0; c < NUM_CONFIGS; c++)
+      if (strcmp(configs[c].name, mix[i].config) == 0) break;
+
+    setupPort(&ports[i], &configs[c], mix[i].baud, skew * (2.0 * rand() / RAND_MAX - 1),
+              (1e6 / mix[i].baud) * 10 * rand() / RAND_MAX, n);
+  }
+
+  simulatePorts(MAX_PORTS, m);
+
+  for (i = 0; i < MAX_PORTS; i++)
+  {
+    p = &ports[i];
+    printf("  port %d %s %6u %+5.1f%% : bytes %u, errors %u, extra %u, framing %u, parity %u, edges lost %u\n", i,
+           p->c->name, p->baud, p->skew, p->r.bytes, p->r.errors, p->r.extra, p->r.framing, p->r.parity, p->r.lost);
+  }
+}
+
+// the level of a line at t, idle high before the first edge
+static bool levelAt(const double *e, int n, double t)
+{
+  int lo = 0, hi = n;
+
+  // edges up to t
+  while (lo < hi)
+  {
+    int mid = (lo + hi) / 2;
+
+    if (e[mid] <= t) lo = mid + 1;
+    else hi = mid;
+  }
+
+  return (lo & 1) == 0;
+}
+
+/* the receiver on the other side of the TX pin : a start bit on each falling
+ * edge, the bits sampled in the middle. bad : a wrong parity or stop bit */
+static int sampleLine(const double *e, int n, const config_t *c, double bitUs, uint8_t *out, bool *bad, int max)
+{
+  int i = 0, got = 0, b, bits = c->dataBits + (c->parity ? 1 : 0);
+  double start, stop;
+  uint8_t v;
+
+  while (got < max)
+  {
+    while (i < n && (i & 1)) i++;     // the next falling edge
+    if (i >= n) break;
+
+    start = e[i];
+    v = 0;
+
+    for (b = 0; b < c->dataBits; b++)
+      if (levelAt(e, n, start + (b + 1.5) * bitUs)) v |= 1 << b;
+
+    stop = start + (bits + 1.5) * bitUs;
+
+    bad[got] = ! levelAt(e, n, stop) ||
+               (c->parity && levelAt(e, n, start + (c->dataBits + 1.5) * bitUs) != parityBit(c, v));
+    out[got++] = v;
+
+    while (i < n && e[i] <= stop) i++;
+  }
+
+  return got;
+}
+
+/* full duplex on port 0 : nReq bytes sent from write() at START_US, nReply
+ * bytes received from replyAt bits after the start bit of the last byte sent
+ * (n bytes back to back). other : ports 1.. receive at the same time.
+ * Returns the bytes sent that the other side got wrong or not at all */
+static int duplex(const config_t *c, const model_t *m, uint32_t baud, int nReq, int nReply, double replyAt,
+                  double skew, int other)
+{
+  static uint8_t heard[PORT_BYTES];
+  static bool bad[PORT_BYTES];
+  double bitUs = 1e6 / baud, frame = (1 + c->dataBits + (c->parity ? 1 : 0) + c->stopBits) * bitUs;
+  int i, got, wrong = 0;
+
+  tx.n = nReq;
+  tx.at = START_US;
+  for (i = 0; i < nReq; i++) tx.bytes[i] = rand() & (0xff >> (8 - c->dataBits));
+
+  // the reply, ideal times of the request
+  setupPort(&ports[0], c, baud, skew, (nReq - 1) * frame + replyAt * bitUs, nReply);
+
+  for (i = 1; i <= other; i++)
+    setupPort(&ports[i], &configs[0], 9600, 0, 29.0 * i, nReply);
+
+  simulatePorts(1 + other, m);
+  tx.n = 0;
+
+  got = sampleLine(tx.edges, tx.numEdges, c, bitUs, heard, bad, PORT_BYTES);
+  for (i = 0; i < nReq; i++)
+    if (i >= got || heard[i] != tx.bytes[i] || bad[i]) wrong++;
+
+  return wrong;
+}
+
+/* full duplex on one port, 8N1 : a request and the reply at once (zero
+ * turnaround, from the middle of the last stop bit) and both directions
+ * sending all the time. The bits sent are late when a GPIO interrupt runs */
+static void duplexTable(int n, double skew)
+{
+  const config_t *c = &configs[0];
+  const model_t *m = &models[2];
+  int txWrong;
+  unsigned b;
+  port_t *p = &ports[0];
+
+  if (n > PORT_BYTES) n = PORT_BYTES;
+
+  printf("full duplex, one port in FIFO mode, 8N1, other side %+.1f%% off. Bytes wrong, the latest bit sent\n\n",
+         skew);
+  printf("                 request 8 bytes, reply %d    both ways %d bytes at the same time\n", n, n);
+  printf("  baud  bit us     reply   sent    late        reply   sent    late\n");
+
+  for (b = 0; b < NUM_BAUDS; b++)
+  {
+    printf("%6u %7.1f", bauds[b], 1e6 / bauds[b]);
+
+    txWrong = duplex(c, m, bauds[b], 8, n, 9.5, skew, 0);
+    printf("   %7u %6d %5.1fus", p->r.errors + p->r.extra, txWrong, tx.maxLate);
+
+    txWrong = duplex(c, m, bauds[b], n, n, 3.3 - (n - 1) * 10, skew, 0);
+    printf("    %7u %6d %5.1fus\n", p->r.errors + p->r.extra, txWrong, tx.maxLate);
+  }
+}
+
+static double now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* edge replay : the time of the decoder itself on this host, per byte and
+ * edge, from the rxBit() / rxEndOfByte() routines and from the FIFO */
+static void replayThroughput(const config_t *c, uint32_t baud)
+{
+  static uint32_t ticks[MAX_EDGES];
+  static ssEdgeFifo_t f;
+  ssDecoder_t d;
+  int numEdges, i, e, rounds = 200, got;
+  double t, isr, fifo;
+  uint8_t b, st;
+  volatile uint8_t sum = 0;
+
+  makeBytes(c, MAX_BYTES);
+  numEdges = makeEdges(c, sent, MAX_BYTES, 1e6 / baud, 0, false, false);
+  for (i = 0; i < numEdges; i++) ticks[i] = sttmr(edges[i]);
+
+  // rxBit() / rxEndOfByte() : the end of a byte is the edge after ticksPerByte
+  ssDecoderInit(&d, TIMER_FREQ, baud, c->dataBits, c->parity, c->stopBits);
+  t = now();
+  for (i = 0; i < rounds; i++)
+  {
+    uint32_t start = 0;
+
+    for (e = 0; e < numEdges; e++)
+    {
+      if (d.active && ticks[e] - start >= d.ticksPerByte)
+      {
+        ssDecoderEnd(&d, &b);
+        sum += b;
+      }
+      if (ssDecoderEdge(&d, ticks[e])) start = ticks[e];
+    }
+    if (d.active)
+    {
+      ssDecoderEnd(&d, &b);
+      sum += b;
+    }
+  }
+  isr = (now() - t) / rounds;
+
+  // FIFO : in parts of 16 edges, as the compare would see them
+  ssDecoderDeferred(&d);
+  got = 0;
+  t = now();
+  for (i = 0; i < rounds; i++)
+  {
+    ssEdgeFifoReset(&f);
+    for (e = 0; e < numEdges; e++)
+    {
+      ssEdgePush(&f, ticks[e]);
+      if ((e & 15) == 15)
+        while (ssDecoderNext(&d, &f, ticks[e], &b, &st))
+        {
+          sum += b;
+          got++;
+        }
+    }
+    while (ssDecoderNext(&d, &f, ticks[numEdges - 1] + d.ticksEnd, &b, &st))
+    {
+      sum += b;
+      got++;
+    }
+  }
+  fifo = (now() - t) / rounds;
+
+  printf("%-6s %6.1f %8.1f %8.1f %14.0f    %s\n", c->name, (double) numEdges / MAX_BYTES, isr * 1e9 / MAX_BYTES,
+         fifo * 1e9 / MAX_BYTES, MAX_BYTES / fifo, got / rounds == MAX_BYTES ? "" : "bytes missing");
+}
+
+/* the longest latency edge to STTMR (+ jitter) without errors, from 1us up
+ * in steps of 0.5us, or 0 if 1us fails already */
+static double budget(const model_t *base, uint32_t baud)
+{
+  model_t m = *base;
+  double lat, ok = 0;
+  result_t r;
+
+  for (lat = 1.0; lat <= 100.0; lat += 0.5)
+  {
+    m.latency = lat;
+    m.clear = base->clear < lat ? base->clear : lat;
+
+    memset(&r, 0, sizeof(r));
+    run(&configs[0], &m, baud, 0, 1000, 0, &r);
+    if (r.errors || r.extra) break;
+    ok = lat;
+  }
+
+  return ok;
+}
+
+static void replay(void)
+{
+  unsigned i;
+
+  printf("edge replay : decoder time on this host, %d random bytes\n\n", MAX_BYTES);
+  printf("config  edges  ns/byte  ns/byte    bytes/s\n"
+         "       /byte      ISR     FIFO       FIFO\n");
+  for (i = 0; i < TABLE_CONFIGS; i++) replayThroughput(&configs[i], 115200);
+
+  printf("\nlongest interrupt latency (edge to STTMR in rxBit(), us) without errors, 8N1,\n"
+         "jitter %.1f us (max 100). It is %.1f us with Mbed bypassed.\n\n", models[0].jitter, models[0].latency);
+  printf("  baud  bit us  rxBit()  FIFO\n");
+
+  for (i = 0; i < NUM_BAUDS; i++)
+    printf("%6u %7.1f %8.1f %5.1f\n", bauds[i], 1e6 / bauds[i], budget(&models[0], bauds[i]),
+           budget(&models[2], bauds[i]));
+}
+
+/* the decoder as rxBit() / rxEndOfByte() were before, to check it is
+ * unchanged. The differences : the bits above dataBits are zero and no
+ * inverting. */
+typedef struct
+{
+  uint32_t lastBitTime;
+  uint8_t bitCounter, incomingByte;
+  bool bitType;
+} ref_t;
+
+static bool refEdge(ref_t *x, const ssDecoder_t *d, uint32_t bitTime)
+{
+  if (x->lastBitTime == 0)
+  {
+    x->lastBitTime = bitTime;
+    return true;
+  }
+
+  uint8_t numberOfBits = (bitTime - x->lastBitTime) / d->ticksPerBit;
+  if (numberOfBits == 0) numberOfBits = 1;
+
+  if (d->parity)
+    if (numberOfBits + x->bitCounter > d->dataBits + d->parityBits)
+      numberOfBits--;
+
+  x->bitCounter += numberOfBits;
+  while (numberOfBits--)
+  {
+    x->incomingByte >>= 1;
+    if (x->bitType) x->incomingByte |= 0x80;
+  }
+
+  x->bitType = !x->bitType;
+  x->lastBitTime = bitTime;
+  return false;
+}
+
+static uint8_t refEnd(ref_t *x, const ssDecoder_t *d)
+{
+  uint8_t b;
+
+  x->bitCounter--;
+  if (d->parity)
+  {
+    x->bitCounter = x->bitCounter - d->parityBits;
+    if (x->bitType == true) x->bitCounter++;
+  }
+
+  while (x->bitCounter < 8)
+  {
+    x->incomingByte >>= 1;
+    if (x->bitType == true)
+      if (x->bitCounter < d->dataBits) x->incomingByte |= 0x80;
+    x->bitCounter++;
+  }
+
+  // it inverted the byte for invertLogic, but then the edges give the
+  // right byte already (the start bit is the first edge, low or high)
+  b = x->incomingByte;
+
+  x->lastBitTime = 0;
+  x->bitCounter = 0;
+  x->bitType = false;
+
+  return b & (0xff >> (8 - d->dataBits));
+}
+
+// random edge times, also too many or too few in a byte
+static bool checkReference(const config_t *c, uint32_t baud)
+{
+  ssDecoder_t d;
+  ref_t x;
+  uint32_t t = 1000, tick = TIMER_FREQ / baud;
+  uint8_t b;
+  int i, k, edgesInByte;
+
+  ssDecoderInit(&d, TIMER_FREQ, baud, c->dataBits, c->parity, c->stopBits);
+  memset(&x, 0, sizeof(x));
+
+  for (i = 0; i < 20000; i++)
+  {
+    edgesInByte = rand() % 12;
+    t += tick;
+
+    for (k = 0; k <= edgesInByte; k++)
+    {
+      if (ssDecoderEdge(&d, t) != refEdge(&x, &d, t)) return false;
+      t += 1 + rand() % (3 * tick);
+    }
+
+    if (refEnd(&x, &d) != (ssDecoderEnd(&d, &b), b)) return false;
+  }
+
+  return true;
+}
+
+// FIFO mode : as selfTest(), also a low stop bit with 1 stop bit and a sender that is off
+static int selfTestFifo(void)
+{
+  model_t ideal = models[2];
+  int fails = 0, numEdges, got, all, sk;
+  unsigned cf;
+  result_t r;
+
+  ideal.jitter = 0;
+
+  for (cf = 0; cf < NUM_CONFIGS; cf++)
+  {
+    const config_t *c = &configs[cf];
+
+    all = 1 << c->dataBits;
+
+    memset(&r, 0, sizeof(r));
+    makeBytes(c, all);
+    numEdges = makeEdges(c, sent, all, 1e6 / 9600, 1, false, false);
+    got = simulateFifo(c, &ideal, 9600, numEdges, &r);
+    if (compare(c, sent, all, got, &r) || r.framing || r.parity)
+    {
+      printf("FAIL fifo %s : %u errors, %u extra, %u framing, %u parity\n", c->name, r.errors, r.extra, r.framing,
+             r.parity);
+      fails++;
+    }
+
+    if (c->parity)
+    {
+      memset(&r, 0, sizeof(r));
+      numEdges = makeEdges(c, sent, all, 1e6 / 9600, 1, true, false);
+      got = simulateFifo(c, &ideal, 9600, numEdges, &r);
+      if (compare(c, sent, all, got, &r) || r.parity != (uint32_t) all || r.framing)
+      {
+        printf("FAIL fifo %s bad parity : %u errors, %u parity flagged of %d\n", c->name, r.errors, r.parity, all);
+        fails++;
+      }
+    }
+
+    // the (first) stop bit low, one idle bit after it
+    memset(&r, 0, sizeof(r));
+    numEdges = makeEdges(c, sent, all, 1e6 / 9600, 1, false, true);
+    got = simulateFifo(c, &ideal, 9600, numEdges, &r);
+    if (r.framing != (uint32_t) all)
+    {
+      printf("FAIL fifo %s bad stop bit : %u framing flagged of %d\n", c->name, r.framing, all);
+      fails++;
+    }
+  }
+
+  // a sender 3% off, all speeds up to 38400, with jitter
+  for (sk = -3; sk <= 3; sk += 6)
+  {
+    for (cf = 0; cf < 8; cf++)
+    {
+      memset(&r, 0, sizeof(r));
+      run(&configs[0], &models[2], bauds[cf], sk, 1000, 0, &r);
+      if (r.errors || r.extra)
+      {
+        printf("FAIL fifo %u sender %+d%% : %u errors %u extra\n", bauds[cf], sk, r.errors, r.extra);
+        fails++;
+      }
+    }
+  }
+
+  // STTMR wraps
+  timerBase = 0xFFFFFFFFU - 200 * 3 * 1042;
+  memset(&r, 0, sizeof(r));
+  run(&configs[0], &ideal, 9600, 0, 256, 0, &r);
+  timerBase = 1000;
+  if (r.errors || r.extra)
+  {
+    printf("FAIL fifo STTMR wrap : %u errors\n", r.errors);
+    fails++;
+  }
+
+  return fails;
+}
+
+static int selfTestPorts(void)
+{
+  static const struct { int config; uint32_t baud; double skew; } set[2][MAX_PORTS] =
+  {
+    { { 0, 9600, 0 }, { 2, 9600, 0 }, { 7, 9600, 0 }, { 5, 9600, 0 } },             // 8N1 8E1 7N2 8O2
+    { { 0, 9600, 1 }, { 2, 9600, -1 }, { 6, 4800, 1 }, { 0, 19200, -1 } },          // 8N1 8E1 7N1 8N1
+  };
+  model_t ideal = models[2];
+  int fails = 0, i, s, all;
+  port_t *p;
+
+  ideal.jitter = 0;
+
+  // all byte values on each port, interleaved
+  for (s = 0; s < 2; s++)
+  {
+    for (i = 0; i < MAX_PORTS; i++)
+    {
+      all = 1 << configs[set[s][i].config].dataBits;
+      setupPort(&ports[i], &configs[set[s][i].config], set[s][i].baud, set[s][i].skew, 37.0 * i, all * 2);
+    }
+
+    simulatePorts(MAX_PORTS, s ? &models[2] : &ideal);
+
+    for (i = 0; i < MAX_PORTS; i++)
+    {
+      p = &ports[i];
+      if (p->r.errors || p->r.extra || p->r.framing || p->r.parity || p->r.lost)
+      {
+        printf("FAIL ports set %d port %d %s %u : %u errors, %u extra, %u framing, %u parity, %u lost\n", s, i,
+               p->c->name, p->baud, p->r.errors, p->r.extra, p->r.framing, p->r.parity, p->r.lost);
+        fails++;
+      }
+    }
+  }
+
+  // the edges of 2 ports at the same time
+  for (i = 0; i < 2; i++) setupPort(&ports[i], &configs[0], 19200, 0, 0, 512);
+  simulatePorts(2, &ideal);
+  for (i = 0; i < 2; i++)
+  {
+    if (ports[i].r.errors || ports[i].r.extra)
+    {
+      printf("FAIL ports same phase port %d : %u errors, %u extra\n", i, ports[i].r.errors, ports[i].r.extra);
+      fails++;
+    }
+  }
+
+  return fails;
+}
+
+static int selfTestDuplex(void)
+{
+  static const int set[] = { 0, 2, 11 };          // 8N1 8E1 7O2
+  static const uint32_t speed[] = { 9600, 19200 };
+  int fails = 0, i, j, sk, txWrong;
+  port_t *p = &ports[0];
+
+  // a request of 8 bytes, the reply from the middle of the (first) stop bit of the last one
+  for (i = 0; i < 3; i++)
+  {
+    const config_t *c = &configs[set[i]];
+
+    for (j = 0; j < 2; j++)
+    {
+      for (sk = -1; sk <= 1; sk += 2)
+      {
+        txWrong = duplex(c, &models[2], speed[j], 8, 256, 1 + c->dataBits + (c->parity ? 1 : 0) + 0.5, sk, 0);
+        if (txWrong || p->r.errors || p->r.extra || p->r.framing || p->r.parity)
+        {
+          printf("FAIL duplex %s %u reply %+d%% : %d sent wrong, %u errors, %u extra, %u framing, %u parity\n",
+                 c->name, speed[j], sk, txWrong, p->r.errors, p->r.extra, p->r.framing, p->r.parity);
+          fails++;
+        }
+      }
+    }
+  }
+
+  // both ways at the same time : 9600 with a port at 9600 next to it, 19200 alone
+  for (j = 0; j < 2; j++)
+  {
+    txWrong = duplex(&configs[0], &models[2], speed[j], 512, 512, 3.3 - 511 * 10, 1, 1 - j);
+    if (txWrong || p->r.errors || p->r.extra || (j == 0 && (ports[1].r.errors || ports[1].r.extra)))
+    {
+      printf("FAIL duplex both ways %u : %d sent wrong, %u errors, %u extra\n", speed[j], txWrong, p->r.errors,
+             p->r.extra);
+      fails++;
+    }
+  }
+
+  return fails;
+}
+
+static int selfTest(void)
+{
+  const model_t ideal = { "ideal", 18.0, 0, 3.5, 2.1, 1.2, 1.0, 6.0 };
+  int fails = 0, numEdges, got, i, all;
+  unsigned cf;
+  result_t r;
+
+  for (cf = 0; cf < NUM_CONFIGS; cf++)
+  {
+    const config_t *c = &configs[cf];
+
+    all = 1 << c->dataBits;
+
+    // all byte values, one gap bit, at 9600
+    memset(&r, 0, sizeof(r));
+    makeBytes(c, all);
+    numEdges = makeEdges(c, sent, all, 1e6 / 9600, 1, false, false);
+    got = simulate(c, &ideal, 9600, numEdges, &r);
+    if (compare(c, sent, all, got, &r) || r.framing || r.parity)
+    {
+      printf("FAIL %s : %u errors, %u extra, %u framing, %u parity\n", c->name, r.errors, r.extra, r.framing,
+             r.parity);
+      fails++;
+    }
+
+    // every parity bit wrong : flagged, data still right
+    if (c->parity)
+    {
+      memset(&r, 0, sizeof(r));
+      numEdges = makeEdges(c, sent, all, 1e6 / 9600, 1, true, false);
+      got = simulate(c, &ideal, 9600, numEdges, &r);
+      if (compare(c, sent, all, got, &r) || r.parity != (uint32_t) all || r.framing)
+      {
+        printf("FAIL %s bad parity : %u errors, %u parity flagged of %d\n", c->name, r.errors, r.parity, all);
+        fails++;
+      }
+    }
+
+    // the first stop bit low : seen with 2 stop bits
+    if (c->stopBits == 2)
+    {
+      memset(&r, 0, sizeof(r));
+      numEdges = makeEdges(c, sent, all, 1e6 / 9600, 1, false, true);
+      got = simulate(c, &ideal, 9600, numEdges, &r);
+      if (r.framing != (uint32_t) all)
+      {
+        printf("FAIL %s bad stop bit : %u framing flagged of %d\n", c->name, r.framing, all);
+        fails++;
+      }
+    }
+
+    if (! checkReference(c, 19200))
+    {
+      printf("FAIL %s : not the same as the old rxBit() / rxEndOfByte()\n", c->name);
+      fails++;
+    }
+  }
+
+  // STTMR wraps in the middle of the bytes
+  timerBase = 0xFFFFFFFFU - 200 * 3 * 1042;
+  memset(&r, 0, sizeof(r));
+  run(&configs[0], &ideal, 9600, 0, 256, 0, &r);
+  timerBase = 1000;
+  if (r.errors || r.extra)
+  {
+    printf("FAIL STTMR wrap : %u errors\n", r.errors);
+    fails++;
+  }
+
+  // what the README says : 19200 is stable, with and without Mbed
+  for (i = 0; i < (int) NUM_MODELS; i++)
+  {
+    memset(&r, 0, sizeof(r));
+    run(&configs[0], &models[i], 19200, 0, 2000, 0, &r);
+    if (r.errors || r.extra)
+    {
+      printf("FAIL %s 19200 8N1 : %u errors %u extra\n", models[i].name, r.errors, r.extra);
+      fails++;
+    }
+  }
+
+  fails += selfTestFifo();
+  fails += selfTestPorts();
+  fails += selfTestDuplex();
+
+  printf("%s\n", fails ? "self test FAILED" : "self test passed");
+  return fails ? 1 : 0;
+}
+
+static void usage(const char *name)
+{
+  printf("%s [options]\n\n"
+         "  -a         all configurations in the table (else 8xx and 7N1)\n"
+         "  -b baud    one baud rate (with -c), else the table\n"
+         "  -c config  as 8N1, 7E2 (default 8N1)\n"
+         "  -d         full duplex : request / reply and both ways on one port in FIFO mode\n"
+         "  -e         edge replay : decoder time and the longest interrupt latency per baud rate\n"
+         "  -g bits    idle bits between the bytes (default 0)\n"
+         "  -j us      jitter of the latency (default %.1f)\n"
+         "  -k %%       sender baud rate off (default 1, with -b 0)\n"
+         "  -l us      latency edge to STTMR in rxBit(), both models (default %.1f / %.1f)\n"
+         "  -m model   bypass, mbed or fifo with -b (default bypass)\n"
+         "  -n bytes   per run (default 2000, max %d)\n"
+         "  -p         readable text (0x20 - 0x7E), else all byte values\n"
+         "  -P         multi-port : 1 - %d ports in FIFO mode at the same time\n"
+         "  -r seed    random seed\n"
+         "  -t         self test\n"
+         "  -v         show the errors\n",
+         name, models[0].jitter, models[0].latency, models[1].latency, MAX_BYTES, MAX_PORTS);
+}
+
+int main(int argc, char *argv[])
+{
+  const config_t *c = &configs[0];
+  const model_t *m = &models[0];
+  int opt, n = 2000, gap = 0, numConfigs = TABLE_CONFIGS;
+  uint32_t baud = 0;
+  double skew = 1.0;
+  bool skewSet = false, multi = false, full = false;
+  unsigned i;
+  result_t r;
+
+  while ((opt = getopt(argc, argv, "ab:c:deg:j:k:l:m:n:pPr:tvh")) != -1)
+  {
+    switch (opt)
+    {
+      case 'a': numConfigs = NUM_CONFIGS; break;
+      case 'b': baud = atoi(optarg); break;
+      case 'c':
+        for (i = 0; i < NUM_CONFIGS; i++)
+          if (strcasecmp(optarg, configs[i].name) == 0) break;
+        if (i == NUM_CONFIGS)
+        {
+          printf("unknown config %s\n", optarg);
+          return 1;
+        }
+        c = &configs[i];
+        break;
+      case 'd': full = true; break;
+      case 'e':
+        replay();
+        return 0;
+      case 'g': gap = atoi(optarg); break;
+      case 'j':
+        for (i = 0; i < NUM_MODELS; i++) models[i].jitter = atof(optarg);
+        break;
+      case 'k': skew = atof(optarg); skewSet = true; break;
+      case 'l':
+        for (i = 0; i < NUM_MODELS; i++) models[i].latency = atof(optarg);
+        break;
+      case 'm':
+        for (i = 0; i < NUM_MODELS; i++)
+          if (strcmp(optarg, models[i].name) == 0) break;
+        if (i == NUM_MODELS)
+        {
+          printf("unknown model %s\n", optarg);
+          return 1;
+        }
+        m = &models[i];
+        break;
+      case 'n':
+        n = atoi(optarg);
+        if (n < 1 || n > MAX_BYTES) n = MAX_BYTES;
+        break;
+      case 'p': printable = true; break;
+      case 'P': multi = true; break;
+      case 'r': srand(atoi(optarg)); break;
+      case 't': return selfTest();
+      case 'v': verbose = true; break;
+      default:
+        usage(argv[0]);
+        return 0;
+    }
+  }
+
+  if (full)
+  {
+    duplexTable(n, skew);
+    return 0;
+  }
+
+  if (multi)
+  {
+    portsTable(n, skew);
+    return 0;
+  }
+
+  if (baud == 0)
+  {
+    table(numConfigs, n, gap, skew);
+    return 0;
+  }
+
+  memset(&r, 0, sizeof(r));
+  run(c, m, baud, skewSet ? skew : 0, n, gap, &r);
+
+  printf("%s %u baud, %s (latency %.1f us, jitter %.1f us), sender %+.1f%%\n", c->name, baud, m->name, m->latency,
+         m->jitter, skewSet ? skew : 0);
+  printf("  bytes %u, received %u, errors %u, extra %u (framing %u, parity %u flagged), edges lost %u\n",
+         r.bytes, r.received, r.errors, r.extra, r.framing, r.parity, r.lost);
+  printf("  bit time %.1f us, longest interrupt %.1f us\n", 1e6 / baud, r.maxBusy);
+
+  return r.errors || r.extra ? 1 : 0;
+}
@@ -21,7 +21,7 @@
     RX characters will be lost.
     * Uses Timer/Compare module H (aka 7). This will remove PWM capabilities
     on pads 11, 37, 48, and 49.
-    * Parity is supported during TX but not checked during RX.
+    * Parity is supported during TX and checked during RX (see rxErrors()).
     * Enabling multiple ports causes 19200 RX to fail (because there is additional instance switching overhead)
 
   Development environment specifics:
@@ -54,6 +54,12 @@
 
 SoftwareSerial *ap3_active_softwareserial_handle = 0;
 
+// FIFO mode : the ports that listen, they share the compare (October 2026)
+SoftwareSerial *ap3_rx_ports[AP3_SS_RX_PORTS];
+uint8_t ap3_rx_listening = 0;
+ssTimer_t ap3_timer;
+volatile bool ap3_tx_duplex = false;   // a FIFO port is sending, its bits are events on the compare
+
 //Uncomment to enable debug pulses and Serial.prints
 //#define DEBUG
 
@@ -74,6 +80,17 @@ inline void _software_serial_isr(void *id)
   handle->rxBit();
 }
 
+// FIFO mode, see setRxFifo()
+#ifdef BYPASS_MBED_INTERRUPT
+void _software_serial_fifo_isr(uint32_t id, gpio_irq_event event)
+#else
+inline void _software_serial_fifo_isr(void *id)
+#endif
+{
+  SoftwareSerial *handle = (SoftwareSerial *)id;
+  handle->rxEdge();
+}
+
 //Constructor
 SoftwareSerial::SoftwareSerial(PinName rxPin, PinName txPin, bool invertLogic)
 {
@@ -97,13 +114,26 @@ void SoftwareSerial::begin(uint32_t baudRate, int comp)
 
 void SoftwareSerial::listen()
 {
+  if (_rxFifo)
+  {
+    listenFifo();
+    return;
+  }
+
   // Disable the timer interrupt in the NVIC.
   NVIC_DisableIRQ(STIMER_CMPR7_IRQn);
 
   if (ap3_active_softwareserial_handle != NULL)
     ap3_active_softwareserial_handle->stopListening(); //Gracefully shut down previous instance
 
-  lastBitTime = 0; //Reset for next byte
+  // a port without FIFO listens alone
+  for (int i = 0; i < AP3_SS_RX_PORTS; i++)
+    if (ap3_rx_ports[i] != NULL) ap3_rx_ports[i]->rxPortRemove();
+
+  ssDecoderReset(&rxDecoder); //Reset for next byte
+
+  // rxBit() and rxEndOfByte() do not interrupt each other (FIFO mode changes that)
+  NVIC_SetPriority(STIMER_CMPR7_IRQn, NVIC_GetPriority(GPIO_IRQn));
 
   //Clear pin change interrupt
   am_hal_gpio_interrupt_clear(AM_HAL_GPIO_BIT(digitalPinToInterrupt(_rxPin)));
@@ -119,9 +149,86 @@ void SoftwareSerial::listen()
   ap3_active_softwareserial_handle = this;
 
   //Attach this instance RX pin to PCI
-  attachInterruptParam(_rxPin, _software_serial_isr,  CHANGE, (void *)this);
+  attachInterruptParam(_rxPin, _rxFifo ? _software_serial_fifo_isr : _software_serial_isr,  CHANGE, (void *)this);
+#endif
+
+}
+
+/* FIFO mode : listen next to the other ports in FIFO mode, up to
+ * AP3_SS_RX_PORTS. A port without FIFO mode that listens is stopped. */
+void SoftwareSerial::listenFifo()
+{
+  int i, spot = -1;
+
+  if (ap3_active_softwareserial_handle != NULL && ! ap3_active_softwareserial_handle->_rxFifo &&
+      ! ap3_active_softwareserial_handle->txInUse)
+  {
+    ap3_active_softwareserial_handle->stopListening();
+  }
+
+  for (i = 0; i < AP3_SS_RX_PORTS; i++)
+  {
+    if (ap3_rx_ports[i] == this) return;                // listening already
+    if (ap3_rx_ports[i] == NULL && spot < 0) spot = i;
+  }
+
+  if (spot < 0) {
+    Serial.println("SoftwareSerial : too many ports listening, see AP3_SS_RX_PORTS\n");
+    return;
+  }
+
+  ssDecoderReset(&rxDecoder); //Reset for next byte
+  ssEdgeFifoReset(&rxEdges);
+
+  // rxEdge() must be able to interrupt the decoding in rxPortsService()
+  NVIC_SetPriority(STIMER_CMPR7_IRQn, NVIC_GetPriority(GPIO_IRQn) + 1);
+
+  //Clear pin change interrupt
+  am_hal_gpio_interrupt_clear(AM_HAL_GPIO_BIT(digitalPinToInterrupt(_rxPin)));
+
+  ap3_rx_ports[spot] = this;
+  ap3_rx_listening++;
+
+  // the other ports may wait for the compare : it is only disabled when
+  // no port listens
+#ifdef BYPASS_MBED_INTERRUPT
+  SetInterrupt(_rxPin);
+#else
+  if (ap3_active_softwareserial_handle == NULL || ! ap3_active_softwareserial_handle->txInUse)
+    ap3_active_softwareserial_handle = this;
+
+  attachInterruptParam(_rxPin, _software_serial_fifo_isr,  CHANGE, (void *)this);
+#endif
+
+  rxPortsSchedule();
+}
+
+// FIFO mode : stop listening, the other ports continue
+void SoftwareSerial::rxPortRemove()
+{
+  bool others = false;
+
+  for (int i = 0; i < AP3_SS_RX_PORTS; i++)
+  {
+    if (ap3_rx_ports[i] == this)
+    {
+      ap3_rx_ports[i] = NULL;
+      ap3_rx_listening--;
+    }
+    else if (ap3_rx_ports[i] != NULL) others = true;
+  }
+
+#ifdef BYPASS_MBED_INTERRUPT
+  RemoveInterrupt(_rxPin);
+#else
+  detachInterrupt(_rxPin);
 #endif
 
+  if (! others && (ap3_active_softwareserial_handle == NULL || ! ap3_active_softwareserial_handle->txInUse))
+  {
+    ap3_timer.armed = false;
+    NVIC_DisableIRQ(STIMER_CMPR7_IRQn);
+  }
 }
 
 #ifdef BYPASS_MBED_INTERRUPT
@@ -141,14 +248,15 @@ void SoftwareSerial::SetInterrupt(PinName pinName)
     indexPinMode(index, INPUT);
 
     // init IRQ and set the routine to call on interrupt
-    gpio_irq_init(&gpio_irq, pinName, (& _software_serial_isr), (uint32_t)this);
+    gpio_irq_init(&gpio_irq, pinName, _rxFifo ? (& _software_serial_fifo_isr) : (& _software_serial_isr), (uint32_t)this);
 
     // set interrupts (both directions)
     gpio_irq_set(&gpio_irq, IRQ_RISE, 1);
     gpio_irq_set(&gpio_irq, IRQ_FALL, 1);
 
-    //Point to new instance's cmpr7 ISR
-    ap3_active_softwareserial_handle = this;
+    //Point to new instance's cmpr7 ISR (FIFO mode : unless another port is sending)
+    if (! _rxFifo || ap3_active_softwareserial_handle == NULL || ! ap3_active_softwareserial_handle->txInUse)
+      ap3_active_softwareserial_handle = this;
 
     gpio_irq_enable(&gpio_irq);
 }
@@ -161,6 +269,12 @@ void SoftwareSerial::RemoveInterrupt(PinName pinName)
 
 void SoftwareSerial::stopListening()
 {
+  if (_rxFifo)
+  {
+    rxPortRemove();
+    return;
+  }
+
   // Disable the timer interrupt in the NVIC.
   NVIC_DisableIRQ(STIMER_CMPR7_IRQn);
 
@@ -170,11 +284,19 @@ void SoftwareSerial::stopListening()
   detachInterrupt(_rxPin);
 #endif
 
-  ap3_active_softwareserial_handle == NULL;
+  if (ap3_active_softwareserial_handle == this) ap3_active_softwareserial_handle = NULL;
 }
 
 bool SoftwareSerial::isListening()
 {
+  if (_rxFifo)
+  {
+    for (int i = 0; i < AP3_SS_RX_PORTS; i++)
+      if (ap3_rx_ports[i] == this) return (true);
+
+    return (false);
+  }
+
   return (this == ap3_active_softwareserial_handle);
 }
 
@@ -238,16 +360,23 @@ void SoftwareSerial::begin(uint32_t baudRate, uint16_t SSconfig, int comp)
 // calculate the ticks per bit
 void SoftwareSerial::calcTicks() {
 
-  rxSysTicksPerBit = (TIMER_FREQ / _baudRate) * 0.98;  //Shorten the number of sysTicks a small amount because we are doing a mod operation
-  txSysTicksPerBit = (TIMER_FREQ / _baudRate) - _comp; //Shorten the txSysTicksPerBit by the number of ticks needed to run the txHandler ISR
+  // RX ticks per bit (shortened a small amount because we are doing a divide) and per byte
+  ssDecoderInit(&rxDecoder, TIMER_FREQ, _baudRate, _dataBits, _parity, _stopBits);
+  if (_rxFifo) ssDecoderDeferred(&rxDecoder);
 
-  rxSysTicksPerByte = (TIMER_FREQ / _baudRate) * (_dataBits + _parityBits + _stopBits);
+  txSysTicksPerBit = (TIMER_FREQ / _baudRate) - _comp; //Shorten the txSysTicksPerBit by the number of ticks needed to run the txHandler ISR
 
   txSysTicksPerStopBit = txSysTicksPerBit * _stopBits;
 }
 
 void SoftwareSerial::end(void)
 {
+  if (_rxFifo)
+  {
+    rxPortRemove();
+    return;
+  }
+
 #ifdef BYPASS_MBED_INTERRUPT
   RemoveInterrupt(_rxPin);
 #else
@@ -303,19 +432,56 @@ bool SoftwareSerial::overflow()
   return (false);
 }
 
+//Returns the receive errors (SS_RX_FRAMING, SS_RX_PARITY) since the last call
+//Clears them when called
+uint8_t SoftwareSerial::rxErrors()
+{
+  uint8_t errors = _rxErrors;
+
+  _rxErrors = 0;
+  return (errors);
+}
+
+//Copies the receive statistics since begin() or the last clear
+void SoftwareSerial::getRxStats(ssRxStats_t *stats, bool clear)
+{
+  _rxStats.edgesLost = rxEdges.lost;
+  *stats = _rxStats;
+
+  if (clear)
+  {
+    memset(&_rxStats, 0, sizeof(_rxStats));
+    rxEdges.lost = 0;
+  }
+}
+
 //Required for print
 size_t SoftwareSerial::write(uint8_t toSend)
 {
-  //As soon as user wants to send something, turn off RX interrupts
+  //As soon as user wants to send something, turn off RX interrupts (not in FIFO mode)
   if (txInUse == false)
   {
+    SoftwareSerial *handle = ap3_active_softwareserial_handle;
+
+    // one port sends at a time, the compare is shared
+    if (handle != NULL && handle != this)
+    {
+      while (handle->txInUse) {}
+      if (! handle->_rxFifo) handle->stopListening();
+    }
+
+    // FIFO mode : full duplex, this port continues receiving
+    if (! _rxFifo)
+    {
 #ifdef BYPASS_MBED_INTERRUPT
-  RemoveInterrupt(_rxPin);
+      RemoveInterrupt(_rxPin);
 #else
-  detachInterrupt(_rxPin);
+      detachInterrupt(_rxPin);
 #endif
+    }
 
     rxInUse = false;
+    ap3_active_softwareserial_handle = this;
   }
 
   //See if we are going to overflow buffer
@@ -334,6 +500,10 @@ size_t SoftwareSerial::write(uint8_t toSend)
   //See if hardware is available
   if (txInUse == false)
   {
+    // full duplex : the compare may come for a port, not before the first bit is set
+    uint32_t primask = __get_PRIMASK();
+    if (_rxFifo) __disable_irq();
+
     txInUse = true;
 
     //Start sending this byte immediately
@@ -343,7 +513,13 @@ size_t SoftwareSerial::write(uint8_t toSend)
     //Calc parity
     calcParityBit();
 
-    beginTX();
+    if (_rxFifo)
+    {
+      txDuplexStart(CTIMER->STTMR);
+      __set_PRIMASK(primask);
+    }
+    else
+      beginTX();
   }
   return (1);
 }
@@ -364,6 +540,31 @@ size_t SoftwareSerial::write(const char *str)
   return write((const uint8_t *)str, strlen(str));
 }
 
+/* FIFO mode (October 2026), call before begin()
+ *
+ * rxEdge() only stores the STTMR of each edge in a FIFO (about 0.5us instead
+ * of 3.3 - 7.8us in rxBit()). The bytes are made from it in the compare
+ * interrupt, that rxEdge() can interrupt. It looks at all edges of a byte, so
+ * it can round the bit times and check the stop bit.
+ *
+ * The 18us before rxEdge() is called remains. extras/ss_sim/ss_bench shows
+ * that receiving all byte values is then reliable up to 38400 (19200 with
+ * rxBit()) and with a sender a few % off.
+ *
+ * Ports in FIFO mode listen at the same time (up to AP3_SS_RX_PORTS), with
+ * one compare for the next byte of all (rxPortsService()).
+ *
+ * Sending on a port in FIFO mode is full duplex : it keeps receiving. Each
+ * bit is an event on the same compare, at a fixed time from the start bit
+ * (txDuplex()), so estimateTxComp() and the compensation of begin() are not
+ * used. A GPIO interrupt that runs when a bit is due delays that bit (up to
+ * about 23us), ss_bench -d shows this is fine up to 19200 on one port and 9600
+ * with other ports receiving. */
+void SoftwareSerial::setRxFifo(bool act)
+{
+  _rxFifo = act;
+}
+
 // enable estimate baudrate compensation
 void SoftwareSerial::estimateTxComp(bool act){
   if (act) _BaudrateCompensation = true;
@@ -439,28 +640,33 @@ void SoftwareSerial::beginTX()
 //Sets global variable _parityBit
 void SoftwareSerial::calcParityBit()
 {
-  // if invert is requested
-  if(_invertLogic)  outgoingByte = ~outgoingByte;
-
-  if (_parity == 0)
-    return; //No parity
-
-  uint8_t ones = 0;
-  for (uint8_t x = 0; x < _dataBits; x++)
+  if (_parity != 0)
   {
-    if (outgoingByte & (0x01 << x))
+    uint8_t ones = 0;
+    for (uint8_t x = 0; x < _dataBits; x++)
     {
-      ones++;
+      if (outgoingByte & (0x01 << x))
+      {
+        ones++;
+      }
     }
-  }
 
-  if (_parity == 1) //Odd
-  {
-    _parityForByte = !(ones % 2);
+    if (_parity == 1) //Odd
+    {
+      _parityForByte = !(ones % 2);
+    }
+    else //Even
+    {
+      _parityForByte = (ones % 2);
+    }
   }
-  else //Even
+
+  // if invert is requested, the parity bit of the data before inverting, inverted as the data
+  // (October 2026, it was the parity of the inverted data)
+  if (_invertLogic)
   {
-    _parityForByte = (ones % 2);
+    outgoingByte = ~outgoingByte;
+    _parityForByte = !_parityForByte;
   }
 }
 
@@ -642,6 +848,7 @@ ap3_err_t SoftwareSerial::softwareserialSetConfig(uint16_t SSconfig)
  *
  */
 //ISR that is called each bit transition on RX pin
+//The bits are counted in ssDecoderEdge() (ss_decoder.h), inline as before
 void SoftwareSerial::rxBit(void)
 {
   uint32_t bitTime = CTIMER->STTMR; //Capture current system time
@@ -651,105 +858,158 @@ void SoftwareSerial::rxBit(void)
 #endif
 
   // start of byte
-  if (lastBitTime == 0)
+  if (ssDecoderEdge(&rxDecoder, bitTime))
   {
-    lastBitTime = bitTime;
     rxInUse = true; //Indicate we are now in process of receiving a byte
 
     // Setup cmpr7 interrupt to handle overall timeout for a byte
-    AM_REGVAL(AM_REG_STIMER_COMPARE(0, 7)) = rxSysTicksPerByte; //Direct reg write to decrease execution time
+    AM_REGVAL(AM_REG_STIMER_COMPARE(0, 7)) = rxDecoder.ticksPerByte; //Direct reg write to decrease execution time
 
     // Enable the timer interrupt in the NVIC.
     NVIC_EnableIRQ(STIMER_CMPR7_IRQn);
   }
+
+#ifdef PROC_DEBUG_PIN
+  am_hal_gpio_output_clear(PROC_DEBUG_PIN);
+#endif
+}
+
+// full duplex : start sending outgoingByte (calcParityBit() done) at start
+void SoftwareSerial::txDuplexStart(uint32_t start)
+{
+  _txBits = ssTxFrame(_dataBits, _parityBits, _stopBits, outgoingByte, _parityForByte, _invertLogic, &_txFrame);
+  _txStart = start;
+
+  //Initiate start bit
+  digitalWrite(_txPin, _invertLogic ? HIGH : LOW);
+
+  _txBit = 1;
+  _txDue = _txStart + ssTxTicks(TIMER_FREQ, _baudRate, _txBit);
+  ap3_tx_duplex = true;
+
+  rxPortsArm(_txDue);
+}
+
+// full duplex : from rxPortsService(), the next bit if it is due
+void SoftwareSerial::txDuplex(uint32_t now)
+{
+  // the compare can be for a byte of a port
+  if ((int32_t)(now + SS_MIN_TICKS - _txDue) < 0) return;
+
+  if (_txBit < _txBits)
+  {
+    digitalWrite(_txPin, (_txFrame >> _txBit) & 0x01 ? HIGH : LOW);
+    _txBit++;
+    _txDue = _txStart + ssTxTicks(TIMER_FREQ, _baudRate, _txBit);
+  }
+
+  // end of the stop bit(s) : are we done sending all bytes ??
+  else if (txBufferTail == txBufferHead)
+  {
+    ap3_tx_duplex = false;
+    txInUse = false;
+  }
   else
   {
-    //Calculate the number of bits that have occured since last PCI
-    uint8_t numberOfBits = (bitTime - lastBitTime) / rxSysTicksPerBit;
+    //Send next byte in buffer, right after the stop bit(s)
+    txBufferTail = (txBufferTail + 1) % AP3_SS_BUFFER_SIZE;
+    outgoingByte = txBuffer[txBufferTail];
+    calcParityBit();
+    txDuplexStart(_txDue);
+  }
+}
 
-    // timing is critical and if interrupt happend on the edge of timing
-    // we must at least have 1 bit
-    if (numberOfBits == 0) numberOfBits = 1;
+//ISR that is called each bit transition on RX pin in FIFO mode
+void SoftwareSerial::rxEdge(void)
+{
+  uint32_t bitTime = CTIMER->STTMR; //Capture current system time
+  bool idle = ! rxDecoder.active && ssEdgeFifoEmpty(&rxEdges);
 
-    if (_parity)
-    {
-      if (numberOfBits + bitCounter > _dataBits + _parityBits)
-      {
-        numberOfBits--; //Exclude parity bit from byte shift
-      }
-    }
+  ssEdgePush(&rxEdges, bitTime);
 
-    bitCounter += numberOfBits;
+  // first edge : compare at the end of the byte, unless another port has it earlier
+  if (idle) rxPortsArm(bitTime + rxDecoder.ticksEnd);
+}
 
-    while (numberOfBits--)  //Add bits of the current bitType (either 1 or 0) to our byte
-    {
-#ifdef TIME_DEBUG_PIN
-    // am_hal_gpio_output_set(TIME_DEBUG_PIN);       // show the number of bits detected on the time debug pin
-#endif
-      incomingByte >>= 1;
+// FIFO mode : (re)arm the compare if due is before the armed one
+void SoftwareSerial::rxPortsArm(uint32_t due)
+{
+  SoftwareSerial *handle = ap3_active_softwareserial_handle;
 
-      // if line was HIGH
-      if (bitType)  incomingByte |= 0x80;
+  // a port without FIFO mode is sending : rxPortsService() is called at each bit
+  if (handle != NULL && handle->txInUse && ! handle->_rxFifo) return;
 
-#ifdef TIME_DEBUG_PIN
-    //am_hal_gpio_output_clear(TIME_DEBUG_PIN);
-#endif
-    }
+  // rxEdge() on a higher priority may arm it as well
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
 
-    bitType = !bitType;    //Next bit will be inverse of this bit
-    lastBitTime = bitTime; //Remember this bit time as the starting time for the next PCI
+  if (ssTimerOffer(&ap3_timer, due))
+  {
+    AM_REGVAL(AM_REG_STIMER_COMPARE(0, 7)) = ssTimerDelta(&ap3_timer, CTIMER->STTMR); //Direct reg write to decrease execution time
+    NVIC_EnableIRQ(STIMER_CMPR7_IRQn);
   }
 
-#ifdef PROC_DEBUG_PIN
-  am_hal_gpio_output_clear(PROC_DEBUG_PIN);
-#endif
+  __set_PRIMASK(primask);
 }
 
-// called when we should have received a complete byte
-void SoftwareSerial::rxEndOfByte()
+// FIFO mode : arm the compare for the first port with a byte pending
+void SoftwareSerial::rxPortsSchedule()
 {
+  uint32_t due;
 
-#ifdef TIME_DEBUG_PIN
-  am_hal_gpio_output_set(TIME_DEBUG_PIN);
-#endif
+  for (int i = 0; i < AP3_SS_RX_PORTS; i++)
+  {
+    SoftwareSerial *port = ap3_rx_ports[i];
 
-  //Finish out bytes that are less than 8 bits
-#ifdef DEBUG
-//  Serial.printf("bitCounter: %d\n", bitCounter);
-//  Serial.printf("incoming: 0x%02X\n", incomingByte);
-#endif
-  bitCounter--; //Remove start bit from count
+    if (port == NULL) continue;
 
-  //Edge case where we need to do an additional byte shift because we had data bits followed by a parity bit of same value
-  if (_parity)
-  {
-    bitCounter = bitCounter - _parityBits; //Remove parity bit from count
-    if (bitType == true)
-      bitCounter++;
+    if (ssDecoderDue(&port->rxDecoder, &port->rxEdges, &due)) rxPortsArm(due);
   }
 
-#ifdef DEBUG
-//  Serial.printf("bitCounter: %d\n", bitCounter);
-#endif
+  // full duplex : the next bit
+  if (ap3_tx_duplex) rxPortsArm(ap3_active_softwareserial_handle->_txDue);
+
+  // nothing pending and no port is sending, unless rxEdge() just armed it
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
 
-  while (bitCounter < 8)
+  if (! ap3_timer.armed && (ap3_active_softwareserial_handle == NULL || ! ap3_active_softwareserial_handle->txInUse))
+    NVIC_DisableIRQ(STIMER_CMPR7_IRQn);
+
+  __set_PRIMASK(primask);
+}
+
+// FIFO mode : called from the compare, the bit to send and the bytes of all listening ports
+void SoftwareSerial::rxPortsService()
+{
+  uint8_t incomingByte, status;
+  uint32_t now = CTIMER->STTMR;
+
+  // an edge from now on arms the compare itself
+  ap3_timer.armed = false;
+
+  // first the bit, its timing counts
+  if (ap3_tx_duplex) ap3_active_softwareserial_handle->txDuplex(now);
+
+  for (int i = 0; i < AP3_SS_RX_PORTS; i++)
   {
-    incomingByte >>= 1;
-    if (bitType == true)
-      if (bitCounter < _dataBits)
-      {
-#ifdef DEBUG
-//        Serial.println("Add bit");
-#endif
-        incomingByte |= 0x80;
-      }
-    bitCounter++;
+    SoftwareSerial *port = ap3_rx_ports[i];
+
+    if (port == NULL) continue;
+
+    while (ssDecoderNext(&port->rxDecoder, &port->rxEdges, now, &incomingByte, &status))
+      port->rxStore(incomingByte, status);
   }
 
-  //TODO - Check parity bit if parity is enabled
+  rxPortsSchedule();
+}
 
-  if (_invertLogic)
-    incomingByte = ~incomingByte;
+// add a received byte to the buffer
+void SoftwareSerial::rxStore(uint8_t incomingByte, uint8_t status)
+{
+  _rxErrors |= status;
+  if (status & SS_RX_FRAMING) _rxStats.framing++;
+  if (status & SS_RX_PARITY) _rxStats.parity++;
 
   //See if we are going to overflow buffer
   uint8_t nextSpot = (rxBufferHead + 1) % AP3_SS_BUFFER_SIZE;
@@ -758,6 +1018,7 @@ void SoftwareSerial::rxEndOfByte()
     //Add this byte to the buffer
     rxBuffer[nextSpot] = incomingByte;
     rxBufferHead = nextSpot;
+    _rxStats.bytes++;
   }
   else
   {
@@ -766,11 +1027,28 @@ void SoftwareSerial::rxEndOfByte()
   am_hal_gpio_output_set(TIME_DEBUG_PIN);
 #endif
     _rxBufferOverflow = true;
+    _rxStats.overflows++;
   }
+}
+
+// called when we should have received a complete byte
+void SoftwareSerial::rxEndOfByte()
+{
+  uint8_t incomingByte, status;
+
+#ifdef TIME_DEBUG_PIN
+  am_hal_gpio_output_set(TIME_DEBUG_PIN);
+#endif
+
+  //Finish out bytes that are less than 8 bits, check parity
+  status = ssDecoderEnd(&rxDecoder, &incomingByte);
+
+#ifdef DEBUG
+//  Serial.printf("incoming: 0x%02X\n", incomingByte);
+#endif
+
+  rxStore(incomingByte, status);
 
-  lastBitTime = 0; //Reset for next byte
-  bitCounter = 0;
-  bitType = false;
   rxInUse = false; //Release so that we can TX if needed
 
   am_hal_gpio_interrupt_clear(AM_HAL_GPIO_BIT(digitalPinToInterrupt(_rxPin)));//Clear any residual PCIs
@@ -903,14 +1181,20 @@ extern "C" void am_stimer_cmpr7_isr(void)
   {
     am_hal_stimer_int_clear(AM_HAL_STIMER_INT_COMPAREH);
 
-    if (ap3_active_softwareserial_handle->rxInUse == true)
+    if (ap3_active_softwareserial_handle != NULL && ! ap3_tx_duplex)
     {
-      ap3_active_softwareserial_handle->rxEndOfByte();
-    }
-    else if (ap3_active_softwareserial_handle->txInUse == true)
-    {
-      ap3_active_softwareserial_handle->txHandler();
+      if (ap3_active_softwareserial_handle->rxInUse == true)
+      {
+        ap3_active_softwareserial_handle->rxEndOfByte();
+      }
+      else if (ap3_active_softwareserial_handle->txInUse == true)
+      {
+        ap3_active_softwareserial_handle->txHandler();
+      }
     }
+
+    // FIFO mode : the bits to send and the bytes of all listening ports
+    if (ap3_rx_listening || ap3_tx_duplex) SoftwareSerial::rxPortsService();
   }
 
 #ifdef PROC_DEBUG_PIN
@@ -22,14 +22,15 @@
   Any pin can be used for software serial receive or transmit
   at 300 to 115200bps and anywhere inbetween.
   Limitations (similar to Arduino core SoftwareSerial):
-    * RX on one pin at a time.
-    * No TX and RX at the same time.
+    * RX on one pin at a time, unless the ports use setRxFifo(true) (up to AP3_SS_RX_PORTS).
+    * No TX and RX at the same time, unless the port uses setRxFifo(true) (full duplex).
     * TX gets priority. So if Artemis is receiving a string of characters
     and you do a Serial.print() the print will begin immediately and any additional
-    RX characters will be lost.
+    RX characters will be lost (not in FIFO mode).
     * Uses Timer/Compare module H (aka 7). This will remove PWM capabilities
     on pads 11, 37, 48, and 49.
-    * Parity is supported during TX but not checked during RX.
+    * Parity is supported during TX and checked during RX (see rxErrors()).
+    * setRxFifo(true) before begin() : RX from a FIFO of edge times, stable to 38400 (see readme).
     * Enabling multiple ports causes 115200 RX to fail (because there is additional instance switching overhead)
 
   Development environment specifics:
@@ -49,9 +50,24 @@
 #include "Arduino.h"
 #include <Stream.h>
 #include "gpio_irq_api.h"
+#include "ss_decoder.h"
 
 #define AP3_SS_BUFFER_SIZE 128 //Limit to 128 bytes
 
+#ifndef AP3_SS_RX_PORTS
+#define AP3_SS_RX_PORTS 4 //Ports in FIFO mode that can listen at the same time
+#endif
+
+// receive statistics of a port, see getRxStats() (October 2026)
+typedef struct
+{
+  uint32_t bytes;         // stored in the receive buffer
+  uint32_t overflows;     // lost, the receive buffer was full
+  uint32_t edgesLost;     // FIFO mode : lost, the edge FIFO was full
+  uint32_t framing;       // with SS_RX_FRAMING
+  uint32_t parity;        // with SS_RX_PARITY
+} ssRxStats_t;
+
 #define TIMER_FREQ 3000000L
 
 /** Added October 2021
@@ -96,6 +112,8 @@ public:
   int peek();
   void flush();
   bool overflow();
+  uint8_t rxErrors();               // October 2026
+  void getRxStats(ssRxStats_t *stats, bool clear = false);   // October 2026
 
   virtual size_t write(uint8_t toSend);
   virtual size_t write(const uint8_t *buffer, size_t size);
@@ -106,7 +124,10 @@ public:
   int16_t getTxComp();              // may 2023
 
   void rxBit(void);
+  void rxEdge(void);                // FIFO mode, October 2026
   void rxEndOfByte(void);
+  void setRxFifo(bool act);         // October 2026
+  static void rxPortsService(void); // FIFO mode, from the compare
 
   volatile bool rxInUse = false;
   volatile bool txInUse = false;
@@ -123,7 +144,6 @@ private:
   volatile uint8_t rxBuffer[AP3_SS_BUFFER_SIZE];
   volatile uint8_t rxBufferHead = 0;
   uint8_t rxBufferTail = 0;
-  volatile uint8_t incomingByte = 0;
 
   PinName _rxPin;
   PinName _txPin;
@@ -135,15 +155,31 @@ private:
   uint8_t _ExpectBits = 0;
   bool _invertLogic;
 
-  //For RX
-  uint16_t rxSysTicksPerBit = 0;
-  uint32_t rxSysTicksPerByte = 0;
-
-  volatile uint8_t numberOfBits[10];
-  volatile uint32_t lastBitTime = 0;
-  volatile uint8_t bitCounter;
-  volatile bool bitType = false;
+  //For RX, the byte reconstruction is in ss_decoder.h (October 2026)
+  ssDecoder_t rxDecoder;
+  volatile uint8_t _rxErrors = 0;   // SS_RX_FRAMING | SS_RX_PARITY since rxErrors()
   bool _rxBufferOverflow = false;
+  ssRxStats_t _rxStats = {};
+  void rxStore(uint8_t incomingByte, uint8_t status);
+
+  // FIFO mode : rxEdge() stores the edge times, rxPortsService() makes the bytes
+  bool _rxFifo = false;
+  ssEdgeFifo_t rxEdges = {};
+  void listenFifo();
+  void rxPortRemove();
+  static void rxPortsArm(uint32_t due);
+  static void rxPortsSchedule();
+
+  // full duplex : the frame that is sent, bit by bit on the compare
+  uint16_t _txFrame = 0;
+  uint8_t _txBit = 0;
+  uint8_t _txBits = 0;
+  uint32_t _txStart = 0;
+  volatile uint32_t _txDue = 0;
+  void txDuplexStart(uint32_t start);
+  void txDuplex(uint32_t now);
+
+  volatile uint8_t bitCounter;      // TX
 
 #ifdef BYPASS_MBED_INTERRUPT
   gpio_t gpio;                      // handle for GPIO
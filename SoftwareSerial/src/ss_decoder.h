@@ -0,0 +1,387 @@
+/*
+  ss_decoder.h : the receive decoder of SoftwareSerial
+
+  rxBit() and rxEndOfByte() used to do the register access and the byte
+  reconstruction in one. The reconstruction is now here, without any
+  register access, so the same code can run on a host (see
+  extras/ss_sim/ss_bench.c) with synthesized edges.
+
+  The input are the times (STIMER ticks) of the level changes on the RX pin.
+  The level itself is not needed: the first edge is the start bit, every
+  next edge is the other level. With invertLogic the levels on the line are
+  the other way around, but the edges are the same, so the byte is not
+  inverted here. The number of bits between two edges is the time between
+  them divided by a bit time that is 2% short, as before.
+
+  ssDecoderEdge() is called from rxBit() for each edge. It returns true on
+  the start bit : the caller then sets the STIMER compare to fire after
+  ticksPerByte (data + parity + stop bits). That compare calls ssDecoderEnd(),
+  which adds the bits after the last edge, checks the parity and returns the
+  byte.
+
+  With one stop bit the compare fires at the start of the stop bit, so the
+  stop bit itself is not seen. A framing error is a frame where an edge came
+  inside the stop bit(s) (a low stop bit with 2 stop bits, a too slow sender,
+  noise) or where no edge came after the start bit (break or lost edge).
+
+  The routines are static inline : rxBit() takes as many instructions as
+  before.
+
+  FIFO mode (SoftwareSerial::setRxFifo()) : rxEdge() only puts the STTMR of
+  each edge in an ssEdgeFifo_t, ssDecoderNext() makes the bytes later from
+  the compare interrupt. It can look at all edges of a byte, so it rounds
+  the bits between two edges (instead of the 2% short bit time) and the byte
+  ends in the middle of the last stop bit : the stop bit is checked and a
+  sender can be a few % off either way.
+
+  Multi-port : each port in FIFO mode has its own ssEdgeFifo_t and
+  ssDecoder_t, the ports share the compare. ssDecoderDue() is when a port
+  has its next byte, the ssTimer_t keeps the earliest of all ports. The
+  compare interrupt calls ssDecoderNext() for every port and arms the next
+  compare from ssDecoderDue().
+
+  Full duplex : a port in FIFO mode that sends keeps receiving. Each bit it
+  sends is an event on the same compare : ssTxTicks() is when bit k of the
+  frame (ssTxFrame()) starts, counted from the start bit, and the ssTimer_t
+  gets the earliest of that and the bytes of the ports.
+
+  paulvha / October 2026
+*/
+
+#ifndef _SS_DECODER_H
+#define _SS_DECODER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// returned by ssDecoderEnd()
+#define SS_RX_OK        0x00
+#define SS_RX_FRAMING   0x01      // an edge inside the stop bit(s) or no edge after the start bit
+#define SS_RX_PARITY    0x02      // parity bit does not match the data bits
+
+// ticks, the shortest compare : a byte or bit that is due already
+#define SS_MIN_TICKS 6
+
+// edges in the FIFO, a power of 2. A byte is up to 10 edges (0x55 8N1)
+#ifndef SS_EDGE_FIFO_SIZE
+#define SS_EDGE_FIFO_SIZE 32
+#endif
+
+// the edge times from rxEdge() to the decoder, one writer and one reader
+typedef struct
+{
+  volatile uint32_t time[SS_EDGE_FIFO_SIZE];
+  volatile uint8_t  head;         // written by rxEdge()
+  volatile uint8_t  tail;         // written by the decoder
+  volatile uint32_t lost;         // edges that did not fit
+} ssEdgeFifo_t;
+
+typedef struct
+{
+  // set by ssDecoderInit()
+  uint8_t   dataBits;             // 5, 6, 7, or 8
+  uint8_t   parity;               // 0 none, 1 odd, 2 even
+  uint8_t   parityBits;           // 0 or 1
+  uint8_t   stopBits;             // 1 or 2
+  uint16_t  ticksPerBit;          // shortened by 2% because we are doing a divide
+  uint32_t  ticksPerByte;         // start bit to the (last) stop bit
+  uint16_t  ticksBit;             // not shortened, FIFO mode
+  uint32_t  ticksEnd;             // start bit to the middle of the last stop bit, FIFO mode
+  bool      deferred;             // FIFO mode : ssDecoderNext()
+
+  // per byte
+  bool      active;               // start bit seen
+  uint32_t  lastBitTime;
+  uint32_t  startTime;            // FIFO mode
+  bool      lineLow;              // FIFO mode : the byte ended with the line low
+  uint8_t   bitCounter;           // bits shifted in, including the start bit
+  uint8_t   bits;                 // bits between the edges, as on the line
+  bool      bitType;              // level since the last edge, start bit is false
+  bool      parityLevel;
+  uint8_t   incomingByte;
+} ssDecoder_t;
+
+// multi-port and full duplex : the compare of all ports and the TX bits
+typedef struct
+{
+  volatile bool     armed;
+  volatile uint32_t due;          // STTMR of the next compare
+} ssTimer_t;
+
+// ready for a start bit
+static inline void ssDecoderReset(ssDecoder_t *d)
+{
+  d->active = false;
+  d->bitCounter = 0;
+  d->bits = 0;
+  d->bitType = false;
+  d->lineLow = false;
+}
+
+static inline void ssDecoderInit(ssDecoder_t *d, uint32_t timerFreq, uint32_t baudRate, uint8_t dataBits,
+                                 uint8_t parity, uint8_t stopBits)
+{
+  d->dataBits = dataBits;
+  d->parity = parity;
+  d->parityBits = parity ? 1 : 0;
+  d->stopBits = stopBits;
+
+  d->ticksPerBit = (timerFreq / baudRate) * 0.98;
+  d->ticksPerByte = (timerFreq / baudRate) * (dataBits + d->parityBits + stopBits);
+  d->ticksBit = timerFreq / baudRate;
+  d->ticksEnd = d->ticksPerByte + d->ticksBit / 2;
+  d->deferred = false;
+
+  d->lastBitTime = 0;
+  d->startTime = 0;
+  d->lineLow = false;
+  d->parityLevel = false;
+  d->incomingByte = 0;
+  ssDecoderReset(d);
+}
+
+// for ssDecoderNext() instead of ssDecoderEdge() / ssDecoderEnd() from the ISRs
+static inline void ssDecoderDeferred(ssDecoder_t *d)
+{
+  d->deferred = true;
+}
+
+// the bits of the level since the last edge, up to the edge at bitTime
+static inline void ssDecoderAdd(ssDecoder_t *d, uint8_t numberOfBits, uint32_t bitTime)
+{
+  // timing is critical and if interrupt happend on the edge of timing
+  // we must at least have 1 bit
+  if (numberOfBits == 0) numberOfBits = 1;
+
+  if (d->parity)
+  {
+    if (numberOfBits + d->bitCounter > d->dataBits + d->parityBits)
+    {
+      // these bits include the parity bit (position dataBits + 1)
+      if (d->bits <= d->dataBits + 1) d->parityLevel = d->bitType;
+
+      d->bits++;
+      numberOfBits--; //Exclude parity bit from byte shift
+    }
+  }
+
+  d->bits += numberOfBits;
+  d->bitCounter += numberOfBits;
+
+  while (numberOfBits--)  //Add bits of the current bitType (either 1 or 0) to our byte
+  {
+    d->incomingByte >>= 1;
+
+    // if line was HIGH
+    if (d->bitType) d->incomingByte |= 0x80;
+  }
+
+  d->bitType = !d->bitType;    //Next bit will be inverse of this bit
+  d->lastBitTime = bitTime;    //Remember this bit time as the starting time for the next edge
+}
+
+// an edge on the RX pin at bitTime, true if it is the start bit
+static inline bool ssDecoderEdge(ssDecoder_t *d, uint32_t bitTime)
+{
+  if (! d->active)
+  {
+    d->active = true;
+    d->lastBitTime = bitTime;
+    return true;
+  }
+
+  //Calculate the number of bits that have occured since last edge
+  ssDecoderAdd(d, (bitTime - d->lastBitTime) / d->ticksPerBit, bitTime);
+
+  return false;
+}
+
+// the end of the byte (ticksPerByte after the start bit), the decoder is
+// ready for the next start bit after this
+static inline uint8_t ssDecoderEnd(ssDecoder_t *d, uint8_t *byte)
+{
+  uint8_t status = SS_RX_OK;
+  uint8_t stopBit = 1 + d->dataBits + d->parityBits;    // first bit after data and parity
+  uint8_t v;
+  bool low;
+
+  // no edge after the parity bit : it has the level since the last edge
+  if (d->parity && d->bits <= d->dataBits + 1)
+    d->parityLevel = d->bitType;
+
+  if (d->bits == 0 || d->bits > stopBit) status |= SS_RX_FRAMING;
+
+  // FIFO mode ends in the middle of the (last) stop bit : it must be high
+  if (d->deferred && ! d->bitType) status |= SS_RX_FRAMING;
+
+  //Finish out bytes that are less than 8 bits
+  d->bitCounter--; //Remove start bit from count
+
+  //Edge case where we need to do an additional byte shift because we had data bits followed by a parity bit of same value
+  if (d->parity)
+  {
+    d->bitCounter = d->bitCounter - d->parityBits; //Remove parity bit from count
+    if (d->bitType == true)
+      d->bitCounter++;
+  }
+
+  while (d->bitCounter < 8)
+  {
+    d->incomingByte >>= 1;
+    if (d->bitType == true)
+      if (d->bitCounter < d->dataBits)
+        d->incomingByte |= 0x80;
+    d->bitCounter++;
+  }
+
+  v = d->incomingByte & (0xff >> (8 - d->dataBits));
+
+  if (d->parity)
+  {
+    v ^= v >> 4;
+    v ^= v >> 2;
+    v ^= v >> 1;
+
+    // odd : data bits and parity bit have an odd number of ones
+    if (((v ^ d->parityLevel) & 1) != (d->parity == 1))
+      status |= SS_RX_PARITY;
+  }
+
+  *byte = d->incomingByte & (0xff >> (8 - d->dataBits));
+
+  // FIFO mode : if the line is low, the next edge is it going high, not a start bit
+  low = d->deferred && ! d->bitType;
+
+  ssDecoderReset(d);
+  d->lineLow = low;
+
+  return status;
+}
+
+static inline void ssEdgeFifoReset(ssEdgeFifo_t *f)
+{
+  f->head = f->tail = 0;
+}
+
+static inline bool ssEdgeFifoEmpty(const ssEdgeFifo_t *f)
+{
+  return f->head == f->tail;
+}
+
+// from rxEdge(), false if full
+static inline bool ssEdgePush(ssEdgeFifo_t *f, uint32_t bitTime)
+{
+  uint8_t next = (f->head + 1) & (SS_EDGE_FIFO_SIZE - 1);
+
+  if (next == f->tail)
+  {
+    f->lost++;
+    return false;
+  }
+
+  f->time[f->head] = bitTime;
+  f->head = next;
+  return true;
+}
+
+/* FIFO mode : the next byte from the edges, false if there is no complete
+ * byte (yet). A byte is complete when an edge came ticksEnd after its start
+ * bit (that edge is the next start bit) or when now is past that. rxEdge()
+ * must not be pending with an edge before now : the compare interrupt has a
+ * lower priority. d->active is true after false if a byte is started. */
+static inline bool ssDecoderNext(ssDecoder_t *d, ssEdgeFifo_t *f, uint32_t now, uint8_t *byte, uint8_t *status)
+{
+  uint32_t bitTime;
+
+  while (f->tail != f->head)
+  {
+    bitTime = f->time[f->tail];
+
+    if (d->lineLow)
+    {
+      d->lineLow = false;
+    }
+    else if (! d->active)
+    {
+      d->active = true;
+      d->startTime = d->lastBitTime = bitTime;
+    }
+    else if (bitTime - d->startTime >= d->ticksEnd)
+    {
+      break;    // the start bit of the next byte
+    }
+    else
+    {
+      // rounded, as all edges are on the same latency
+      ssDecoderAdd(d, (bitTime - d->lastBitTime + d->ticksBit / 2) / d->ticksBit, bitTime);
+    }
+
+    f->tail = (f->tail + 1) & (SS_EDGE_FIFO_SIZE - 1);
+  }
+
+  if (! d->active) return false;
+
+  if (f->tail == f->head && now - d->startTime < d->ticksEnd) return false;
+
+  *status = ssDecoderEnd(d, byte);
+  return true;
+}
+
+/* multi-port : the STTMR at which ssDecoderNext() has the next byte, false if
+ * nothing is pending. Without a start bit yet, it is counted from the first
+ * edge in the FIFO : that can be the end of a low stop bit, the compare is
+ * then early and asks again. */
+static inline bool ssDecoderDue(const ssDecoder_t *d, const ssEdgeFifo_t *f, uint32_t *due)
+{
+  if (d->active)
+    *due = d->startTime + d->ticksEnd;
+  else if (f->tail != f->head)
+    *due = f->time[f->tail] + d->ticksEnd;
+  else
+    return false;
+
+  return true;
+}
+
+/* full duplex : the levels on the TX pin of a frame, bit 0 (the start bit)
+ * first, returns the number of bits. levels and parityLevel as on the pin
+ * (after inverting) */
+static inline uint8_t ssTxFrame(uint8_t dataBits, uint8_t parityBits, uint8_t stopBits, uint8_t levels,
+                                bool parityLevel, bool invertLogic, uint16_t *frame)
+{
+  uint8_t bits = 1 + dataBits;
+  uint16_t f = invertLogic ? 1 : 0;
+
+  f |= (uint16_t)(levels & (0xff >> (8 - dataBits))) << 1;
+  if (parityBits) f |= (uint16_t) parityLevel << bits++;
+  while (stopBits--) f |= (uint16_t)(invertLogic ? 0 : 1) << bits++;
+
+  *frame = f;
+  return bits;
+}
+
+// full duplex : ticks from the start bit to bit k, rounded per bit so it does not drift
+static inline uint32_t ssTxTicks(uint32_t timerFreq, uint32_t baudRate, uint8_t k)
+{
+  return ((uint32_t) k * timerFreq + baudRate / 2) / baudRate;
+}
+
+// true if the compare must be (re)armed for due : nothing armed or it is earlier
+static inline bool ssTimerOffer(ssTimer_t *t, uint32_t due)
+{
+  if (t->armed && (int32_t)(due - t->due) >= 0) return false;
+
+  t->due = due;
+  t->armed = true;
+  return true;
+}
+
+// ticks from now to the compare, for the STIMER compare register
+static inline uint32_t ssTimerDelta(const ssTimer_t *t, uint32_t now)
+{
+  int32_t delta = (int32_t)(t->due - now);
+
+  return delta < SS_MIN_TICKS ? SS_MIN_TICKS : (uint32_t) delta;
+}
+
+#endif // _SS_DECODER_H
@@ -0,0 +1,97 @@
+// ****************************************************************************
+//
+//  amdtp_ackq.c
+//! @file
+//!
+//! @brief ACK and CONTROL frames of the client, sent when the HCI layer has
+//! room. See amdtp_ackq.h.
+//!
+//! added paulvha / October 2026
+//
+// ****************************************************************************
+
+#include <string.h>
+#include "amdtp_ackq.h"
+
+void
+AmdtpAckqInit(amdtpAckq_t *q, uint8_t (*credits)(void *user),
+              bool (*write)(void *user, const uint8_t *buf, uint8_t len), void *user)
+{
+    memset(q, 0, sizeof(amdtpAckq_t));
+    q->credits = credits;
+    q->write = write;
+    q->user = user;
+}
+
+bool
+AmdtpAckqPut(amdtpAckq_t *q, const uint8_t *buf, uint16_t len)
+{
+    amdtpAckqFrame_t *f;
+
+    if (q->count >= AMDTP_ACKQ_SIZE || len > AMDTP_ACKQ_FRAME)
+    {
+        q->stats.full++;
+        return false;
+    }
+
+    f = &q->frame[(q->head + q->count) % AMDTP_ACKQ_SIZE];
+    memcpy(f->buf, buf, len);
+    f->len = (uint8_t) len;
+    q->count++;
+    return true;
+}
+
+bool
+AmdtpAckqPump(amdtpAckq_t *q, uint32_t now)
+{
+    amdtpAckqFrame_t *f;
+
+    while (q->count)
+    {
+        // wait after a failed write (wraps with millis() after 49 days)
+        if (q->backoff && (int32_t) (now - q->retryAt) < 0)
+        {
+            return false;
+        }
+
+        if (q->credits && q->credits(q->user) == 0)
+        {
+            q->stats.noCredit++;
+            return false;
+        }
+
+        f = &q->frame[q->head];
+
+        if (! q->write(q->user, f->buf, f->len))
+        {
+            q->stats.retries++;
+
+            if (++q->tries < AMDTP_ACKQ_TRIES)
+            {
+                q->backoff = q->backoff ? q->backoff * 2 : AMDTP_ACKQ_BACKOFF_MIN;
+                if (q->backoff > AMDTP_ACKQ_BACKOFF_MAX) q->backoff = AMDTP_ACKQ_BACKOFF_MAX;
+                q->retryAt = now + q->backoff;
+                return false;
+            }
+
+            q->stats.dropped++;
+        }
+        else
+        {
+            q->stats.sent++;
+        }
+
+        q->head = (q->head + 1) % AMDTP_ACKQ_SIZE;
+        q->count--;
+        q->tries = 0;
+        q->backoff = 0;
+    }
+
+    return true;
+}
+
+uint8_t
+AmdtpAckqCount(amdtpAckq_t *q)
+{
+    return q->count;
+}
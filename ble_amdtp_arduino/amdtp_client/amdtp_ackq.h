@@ -0,0 +1,125 @@
+// ****************************************************************************
+//
+//  amdtp_ackq.h
+//! @file
+//!
+//! @brief ACK and CONTROL frames of the client, sent when the HCI layer has
+//! room instead of after a fixed delay.
+//!
+//! The core asks for an ACK (or SEND_READY) while it handles a received frame,
+//! which is inside the notification callback of ArduinoBLE. Writing there
+//! makes ArduinoBLE poll HCI from within its own poll, and a write while all
+//! ACL buffers of the controller are in use waits there as well. Version 4.0
+//! "solved" that with a delay(700) before each ACK, which limits a transfer
+//! to one frame per 700 ms.
+//!
+//! Now AckChar_Write() only puts the frame in this queue. AmdtpAckqPump(),
+//! from loop() after BLE.poll(), writes it when the controller has a free
+//! ACL buffer (credits : the buffers of LE Read Buffer Size minus the packets
+//! not yet reported in Number Of Completed Packets). A write that fails is
+//! tried again after 5, 10, 20 .. AMDTP_ACKQ_BACKOFF_MAX ms, after
+//! AMDTP_ACKQ_TRIES the frame is dropped (the sender repeats the frame it is
+//! waiting for on its timeout).
+//!
+//! No Arduino code in here, extras/amdtp_sim/bridge_sim uses the same file on
+//! a host.
+//!
+//! added paulvha / October 2026
+//
+// ****************************************************************************
+
+#ifndef AMDTP_ACKQ_H
+#define AMDTP_ACKQ_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define AMDTP_ACKQ_SIZE             4       // frames waiting
+#define AMDTP_ACKQ_FRAME            20      // largest frame (AMDTP_ACK_SIZE)
+#define AMDTP_ACKQ_TRIES            6       // writes of a frame before it is dropped
+#define AMDTP_ACKQ_BACKOFF_MIN      5       // ms after the first failed write
+#define AMDTP_ACKQ_BACKOFF_MAX      80      // ms, the wait doubles up to this
+
+typedef struct
+{
+    uint8_t                 len;
+    uint8_t                 buf[AMDTP_ACKQ_FRAME];
+}
+amdtpAckqFrame_t;
+
+typedef struct
+{
+    uint32_t                sent;           // frames written
+    uint32_t                noCredit;       // pumps that found no free buffer
+    uint32_t                retries;        // writes that failed
+    uint32_t                dropped;        // frames given up after AMDTP_ACKQ_TRIES
+    uint32_t                full;           // frames refused, queue full
+}
+amdtpAckqStats_t;
+
+typedef struct
+{
+    amdtpAckqFrame_t        frame[AMDTP_ACKQ_SIZE];
+    uint8_t                 head;
+    uint8_t                 count;
+    uint8_t                 tries;          // failed writes of the first frame
+    uint16_t                backoff;        // ms, 0 : not waiting
+    uint32_t                retryAt;        // ms
+
+    //! free ACL buffers of the controller, 1 if not known
+    uint8_t                 (*credits)(void *user);
+
+    //! write a frame, false if it failed
+    bool                    (*write)(void *user, const uint8_t *buf, uint8_t len);
+
+    void                    *user;
+    amdtpAckqStats_t        stats;
+}
+amdtpAckq_t;
+
+//*****************************************************************************
+//
+//! @brief Empty the queue and set the callbacks.
+//
+//*****************************************************************************
+extern void AmdtpAckqInit(amdtpAckq_t *q, uint8_t (*credits)(void *user),
+                          bool (*write)(void *user, const uint8_t *buf, uint8_t len), void *user);
+
+//*****************************************************************************
+//
+//! @brief Add a frame.
+//!
+//! @return false if the queue is full or the frame too long. The core then
+//! keeps the frame and gives it again on AmdtpCorePump().
+//
+//*****************************************************************************
+extern bool AmdtpAckqPut(amdtpAckq_t *q, const uint8_t *buf, uint16_t len);
+
+//*****************************************************************************
+//
+//! @brief Write the waiting frames, as many as there are credits.
+//!
+//! @param now  time in ms (millis())
+//!
+//! @return true if the queue is empty after this.
+//
+//*****************************************************************************
+extern bool AmdtpAckqPump(amdtpAckq_t *q, uint32_t now);
+
+//*****************************************************************************
+//
+//! @brief Frames waiting.
+//
+//*****************************************************************************
+extern uint8_t AmdtpAckqCount(amdtpAckq_t *q);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AMDTP_ACKQ_H
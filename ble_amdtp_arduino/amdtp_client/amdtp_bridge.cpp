@@ -7,14 +7,21 @@
  *  
  * Version 3.1 / December 2020 / paulvha
  *  Now sending ACK on TX handle instead of ACK handle
+ *
+ * Version 4.1 / October 2026 / paulvha
+ *  the characteristics are raw bytes now, no String and no 0x7E 0x20 escape. A
+ *  received frame is given as is to AmdtpReceivePkt().
+ *
+ * Version 4.2 / October 2026 / paulvha
+ *  no delay(700) before an ACK : it is queued (amdtp_ackq.c) and written from
+ *  CheckConnect() when the controller has a free buffer.
  */
  
 #include "ArduinoBLE.h"
+#include "utility/HCI.h"
 #include "amdtp_common.h"
 #include "amdtp_bridge.h"
-
-uint8_t ReceivedBuf[MAXRECEIVEBUF]; // encode
-uint16_t ReceivedLen;               // encode
+#include "amdtp_ackq.h"
 
 // keep track of connection status
 uint8_t AMD_stat = AMD_IDLE;
@@ -24,6 +31,7 @@ BLECharacteristic TxChar;
 BLECharacteristic AckChar;
 BLEDevice peripheral;
 bool LastPacketSendWasData;       // problem with Notify in ArduinoBLE
+amdtpAckq_t AckQueue;             // ACK / CONTROL frames waiting for the controller
 
 //****************************************
 //
@@ -37,11 +45,8 @@ void RxChar_Received(BLEDevice central, BLECharacteristic characteristic) {
   Serial.print(F("\rRX receive "));
 #endif
 
-  String a = (const char*) characteristic.value();
-  int vsize = characteristic.valueSize();
-  encode_receipt(a,vsize);
-  
-  AmdtpReceivePkt(AMDTP_PKT_TYPE_DATA, ReceivedLen, ReceivedBuf);
+  show_receipt(characteristic);
+  AmdtpReceivePkt(AMDTP_PKT_TYPE_DATA, characteristic.valueLength(), (uint8_t *) characteristic.value());
 }
 
 // not expected to receive anything on the TX characteristic
@@ -51,9 +56,7 @@ void TxChar_Received(BLEDevice central, BLECharacteristic characteristic) {
   Serial.print(F("\rTX receive "));
 #endif
 
-  String a = (const char*) characteristic.value();
-  int vsize = characteristic.valueSize();
-  encode_receipt(a,vsize);
+  show_receipt(characteristic);
 }
 
 void AckChar_Received(BLEDevice central, BLECharacteristic characteristic) {
@@ -74,10 +77,8 @@ void AckChar_Received(BLEDevice central, BLECharacteristic characteristic) {
    return;
   }
 */
-  String a = (const char*) characteristic.value();
-  int vsize = characteristic.valueSize();
-  encode_receipt(a,vsize);
-  AmdtpReceivePkt(AMDTP_PKT_TYPE_ACK, ReceivedLen, ReceivedBuf);
+  show_receipt(characteristic);
+  AmdtpReceivePkt(AMDTP_PKT_TYPE_ACK, characteristic.valueLength(), (uint8_t *) characteristic.value());
 }
 
 //****************************************
@@ -97,75 +98,53 @@ void TxChar_Write(uint8_t *value, uint16_t vlen) {
   TxChar.writeValue(value, (int) vlen);
 }
 
-// send data packet over the ACK characteristic
-void AckChar_Write(uint8_t *value, uint16_t vlen) {
+// send ACK / CONTROL packet : queue it, CheckConnect() writes it
+bool AckChar_Write(uint8_t *value, uint16_t vlen) {
   
 #ifdef BLE_Debug
   Serial.println(F("\rAck write"));
 #endif
 
+  // false if the queue is full, the core keeps it for AmdtpcPump()
+  return AmdtpAckqPut(&AckQueue, value, vlen);
+}
+
+// free ACL buffers of the controller (LE buffers minus not completed packets)
+static uint8_t AckCredits(void *user) {
+#ifdef HCI_AVAILABLE_PACKETS          // ArduinoBLE_P
+  return HCI.availablePackets();
+#else
+  return 1;                           // not known, writeValue() waits for a buffer itself
+#endif
+}
+
+// write a queued ACK / CONTROL packet
+static bool AckWrite(void *user, const uint8_t *value, uint8_t vlen) {
+  
   LastPacketSendWasData = false;
 
   // now sending over TX instead of ACK handle. The ACK write is repeated as it is a notify-channel
   // and generates more traffic and makes the connection unstable
   
   //AckChar.writeValue(value, (int) vlen);  
-  delay(700);    // apperently a delay is needed to make it stable on HCI layer
-  TxChar.writeValue(value, (int) vlen);
+  return TxChar.writeValue(value, (int) vlen) != 0;
 }
 
 //*******************************************************************************************
-// As we receive bytes on a String characteristic, we can not have a zero in the middle of the 
-// bytes to be received. As the sender side we translate a zero to 0x73 0x20. This routine
-// will just do the opposite and translate 0x7e 0x20 back to 0x0. THis is done in gatt.c on 
-// Linux/ Ubuntu.
-// 
-// Hope and pray that 0x7e 0x20 strings do not happen ... else we extend the decode one morestep.
+// The characteristics of the server are raw bytes (4.1), a zero in a frame is received as is.
+// The value of the characteristic is handed to the AMDTP core without a copy, the core only
+// reads it.
 //********************************************************************************************
-void encode_receipt(String a, int vsize)
+void show_receipt(BLECharacteristic characteristic)
 {
-  char save = 0x0;
-  ReceivedLen = 0;
-
-  for (int i = 0; i < vsize; i++) {
-
-    char c = a[i];
-    
-    // Header character for 0x0 ??
-    if (c == 0x7E && save == 0x0) {
-        save = 0x7E;
-        continue;
-    }
-    
-    // did we get a header character before
-    if (save == 0x7E) {
-      
-      // if next is 0x20 then the real character was 0x0;
-      if (c == 0x20)  c = 0x0;
-
-      // the previous 0x7E was not header, add now
-      else {
-        ReceivedBuf[ReceivedLen++] = save;
-      }
-
-    save = 0x0; // reset header
-    }
-
-    // Store real current character
-    ReceivedBuf[ReceivedLen++] = c;
-  }
-  
 #ifdef BLE_SHOW_DATA
+  const uint8_t *a = characteristic.value();
+  int vsize = characteristic.valueLength();
   
-  Serial.printf("\r\nRaw received (length %d) : ",vsize);
+  Serial.printf("\r\nReceived (length %d) : ",vsize);
   for (int i = 0; i < vsize; i++) {
     Serial.print(" 0x");  Serial.print(a[i],HEX);
   }
-  
-  Serial.printf("\r\nAfter encode (size %d) :", ReceivedLen);
-  for (size_t i = 0; i < ReceivedLen; i++) {
-    Serial.print(" 0x"); Serial.print(ReceivedBuf[i],HEX);
-  }
 
   Serial.println();
 #endif
@@ -184,6 +163,7 @@ bool StartBLE()
   // begin initialization
   if (!BLE.begin()) return false;
 
+  AmdtpAckqInit(&AckQueue, AckCredits, AckWrite, NULL);
   return true;
 }
 
@@ -193,6 +173,9 @@ bool CheckConnect()
   // poll the central for events
   BLE.poll();
 
+  // write the waiting ACKs, once empty the core can give the one it kept
+  if (AmdtpAckqPump(&AckQueue, millis())) AmdtpcPump();
+
   if ( !peripheral.connected()){
     AMD_stat = AMD_IDLE;
     return(false);
@@ -350,8 +333,8 @@ extern "C" void SendDataPacket(uint8_t *value, uint16_t vlen) {
   TxChar_Write(value, vlen);
 }
 
-extern "C" void SendAckPacket(uint8_t *value, uint16_t vlen) {
-  AckChar_Write(value, vlen);
+extern "C" bool SendAckPacket(uint8_t *value, uint16_t vlen) {
+  return AckChar_Write(value, vlen);
 }
 extern void set_led_high( void ){
   digitalWrite(LED_BUILTIN, HIGH);
@@ -34,6 +34,9 @@ typedef enum eAmdtpcmd
     AMDTP_CMD_CUSTOM3,
     AMDTP_CMD_CUSTOM4,
     AMDTP_CMD_CUSTOM5,
+    AMDTP_CMD_SUBSCRIBE,            // batched telemetry (amdtp_tlm.h), server 4.2
+    AMDTP_CMD_UNSUBSCRIBE,
+    AMDTP_CMD_TELEMETRY,            // a batch, pushed by the server
     AMDTP_CMD_MAX
 }eAmdtpPktcmd_t;
 
@@ -57,9 +60,8 @@ void RxChar_Received(BLEDevice central, BLECharacteristic characteristic);
 void TxChar_Received(BLEDevice central, BLECharacteristic characteristic);
 void AckChar_Received(BLEDevice central, BLECharacteristic characteristic);
 void TxChar_Write(uint8_t *value, uint16_t vlen);
-void AckChar_Write(uint8_t *value, uint16_t vlen);
-void encode_receipt(String a, int vsize);
-void PrepSending(uint8_t *value, uint16_t vlen);
+bool AckChar_Write(uint8_t *value, uint16_t vlen);
+void show_receipt(BLECharacteristic characteristic);
 
 // for client
 bool StartBLE();
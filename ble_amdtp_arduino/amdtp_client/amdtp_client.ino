@@ -31,13 +31,26 @@
  Version 3.1 / December 2020 / paulvha
  *  Now sending ACK on TX handle instead of ACK handle
  *  Addded comment to handle crc32.c errors. see top crc32.c / .h
+
+ Version 4.0 / October 2026 / paulvha
+ *  the protocol is now amdtp_core.c, the same as MBED-BLE and amdtc. Larger packets
+ *  are sent a frame at a time, after SEND_READY from the server. Needs server 4.x
+
+ Version 4.1 / October 2026 / paulvha
+ *  no more 0x7E 0x20 escape for a zero, the server has raw byte characteristics and
+ *  a frame can use the full MTU (20 instead of 10 bytes). Needs server 4.1
+
+ Version 4.2 / October 2026 / paulvha
+ *  no delay(700) before each ACK / SEND_READY any more. They are queued (amdtp_ackq.c) and
+ *  written from CheckConnect() when the controller has a free buffer, a failed write is tried
+ *  again after 5 - 80 ms. About 16 instead of 1.3 frames per second (MBED-BLE/extras/amdtp_sim/bridge_sim)
 */
 /********************************************************************************************************************
  *******************************************************************************************************************/
 
 // version number
-#define MAJOR_CLIENTVERSION 3     // new features
-#define MINOR_CLIENTVERSION 1     // bug fixes, better calculation/ layout
+#define MAJOR_CLIENTVERSION 4     // new features
+#define MINOR_CLIENTVERSION 2     // bug fixes, better calculation/ layout
 
 //*********************************************************************
 //  NO CHANGES NEEDED BEYOND THIS POINT
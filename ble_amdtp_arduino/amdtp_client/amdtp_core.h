@@ -0,0 +1,501 @@
+// ****************************************************************************
+//
+//  amdtp_core.h
+//! @file
+//!
+//! @brief Transport independent AMDTP protocol core.
+//!
+//! The state machine of the AMD transfer protocol, without any BLE, mbed or
+//! static state. Everything for one connection is in an amdtpCore_t, the
+//! front-end (AMDTPS, AMDTPC or a host simulation) hands it the received
+//! frames and provides callbacks to send frames, to deliver a received packet
+//! and to run a single timer.
+//!
+//! Two transfer modes:
+//!
+//! stop-and-wait (legacy)
+//!   As the original AMDTP: when a packet needs more than one frame, the
+//!   receiver answers every frame with a CONTROL SEND_READY before the next
+//!   one is sent. Always used until sliding window has been agreed, so the
+//!   core works with every existing AMDTP peer.
+//!
+//! sliding window
+//!   Up to "window" frames are in flight. The receiver places every frame on
+//!   its position, reports the received frames with a WINDOW_ACK (cumulative
+//!   count + bitmap of the frames after it) every window / 2 frames or when a
+//!   gap shows, and sends the final ACK once the packet is complete and the
+//!   CRC is correct. The sender only repeats the missing frames, on a gap in
+//!   the bitmap or after AMDTP_RETX_TIMEOUT_MS without progress.
+//!
+//!   A window frame is [chunk][0xF0 | sn][chunk size] + part of the packet,
+//!   which is the same length / header / data / CRC layout as in legacy mode.
+//!   The second byte of the first legacy frame is the length MSB (max 2), so
+//!   a receiver can always tell the two apart. ACK and CONTROL packets are
+//!   never split and stay in legacy format.
+//!
+//! Negotiation: the client sends CONTROL WINDOW_REQ [version][window] once it
+//! has subscribed. A peer that knows the window mode answers WINDOW_RSP with
+//! the smallest of both windows, and from then on both sides send new
+//! packets in that mode. Older peers ignore the unknown control code, and
+//! the connection stays stop-and-wait.
+//!
+//! Streams (version 2): a payload of any length (32 bits) is sent as a row
+//! of data packets with PACKET_STREAM_BIT set in the header. Each starts with
+//! [flags], followed by the total length (4 bytes) when AMDTP_STREAM_OPEN is
+//! set and the CRC32 of all stream data (4 bytes) when AMDTP_STREAM_CLOSE is
+//! set, and then the data. The data is written in parts into a staging
+//! buffer, which is sent as soon as the previous packet is acknowledged, so
+//! the whole message never has to be in memory. Only used when the peer
+//! reported version 2 or higher at negotiation.
+//!
+//! Compression (version 3): with AmdtpCoreSetCompress() a data packet is
+//! compressed (amdtp_lz.h) and sent with PACKET_COMPRESS_BIT set when that
+//! makes it smaller. The CRC is over the bytes that are sent. The receiver
+//! decompresses before delivery, so streams and data packets are the same
+//! for the front-end. Only used when the peer reported version 3 or higher
+//! at negotiation, each side decides for its own direction.
+//!
+//! Encryption (version 4): with the same key set on both sides with
+//! AmdtpCoreSetKey(), WINDOW_REQ and WINDOW_RSP also carry 8 random bytes
+//! of each side and the session key is AES(key, random client | random
+//! server), as the BLE link layer does. A data packet is then sent with
+//! PACKET_ENCRYPTION_BIT set as [counter 4][AES-CCM data][MIC 4]
+//! (amdtp_ccm.h), after the compression. The nonce is the counter and the
+//! direction, the stream and compress bits are authenticated. The counter
+//! must go up, so a repeated packet is dropped. With a key, data is only
+//! sent and accepted encrypted : until the session key is agreed sending
+//! returns AMDTP_STATUS_TX_NOT_READY, and received packets that are not
+//! encrypted or have a wrong MIC are dropped (stats.authErrors). The
+//! transport still acknowledges them, a repeat would not help.
+//!
+//! Extended sequence numbers (version 5): the 4 bit serial number of the
+//! header wraps after 16 packets, so a late or repeated frame of an older
+//! packet can look like a new one. When both sides reported version 5 a
+//! window frame is [chunk][0xE0 | sn][chunk size][sn 16 bits] + data, the
+//! final ACK [status][sn 16 bits] and WINDOW_ACK gets the high byte of the
+//! sn at the end. The receiver drops every frame of a packet it already
+//! delivered or that is older than the packet in progress
+//! (stats.framesStale), instead of abandoning that packet, and places frames
+//! that arrive out of order on their chunk index (stats.framesReordered).
+//! The serial number goes up for every packet, also one that failed, so the
+//! receiver never takes a new packet for a repeat. A peer with a lower
+//! version gets the 3 byte header, the receiver answers in the format of
+//! the frame it got.
+//!
+//! added paulvha / October 2026
+//
+// ****************************************************************************
+
+#ifndef AMDTP_CORE_H
+#define AMDTP_CORE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "amdtp_common.h"
+#include "amdtp_ccm.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+//*****************************************************************************
+//
+// Configurable settings
+//
+//*****************************************************************************
+#define AMDTP_CORE_VERSION          5
+#define AMDTP_STREAM_MIN_VERSION    2       // peer version that understands streams
+#define AMDTP_COMPRESS_MIN_VERSION  3       // peer version that decompresses
+#define AMDTP_ENCRYPT_MIN_VERSION   4       // peer version that exchanges a session key
+#define AMDTP_EXTSN_MIN_VERSION     5       // peer version that knows the 16 bit serial number
+
+#ifndef AMDTP_WINDOW_DEFAULT
+#define AMDTP_WINDOW_DEFAULT        8       // frames in flight offered at negotiation
+#endif
+
+#define AMDTP_WINDOW_MAX            32      // limited by the 32 bit WINDOW_ACK bitmap
+
+#ifndef AMDTP_RETX_TIMEOUT_MS
+#define AMDTP_RETX_TIMEOUT_MS       1000    // resend missing frames without progress
+#endif
+
+#ifndef AMDTP_BUSY_RETRY_MS
+#define AMDTP_BUSY_RETRY_MS         5       // try again when the transport was full
+#endif
+
+#ifndef AMDTP_MAX_RETRIES
+#define AMDTP_MAX_RETRIES           5       // timeouts before a packet fails
+#endif
+
+#define AMDTP_MIN_MTU               11      // 8 bytes per frame, see AmdtpCoreSetMtu()
+
+#define AMDTP_WIN_MARK              0xF0    // second byte of a window frame
+#define AMDTP_WIN_HDR_SIZE          3       // [chunk][0xF0 | sn][chunk size]
+#define AMDTP_WIN_EXT_MARK          0xE0    // second byte of an extended window frame
+#define AMDTP_WIN_EXT_HDR_SIZE      5       // [chunk][0xE0 | sn][chunk size][sn 16 bits]
+#define AMDTP_WIN_MAX_CHUNKS        64      // bitmaps are 64 bits
+
+#define AMDTP_STREAM_OPEN           0x01    // first packet, total length follows
+#define AMDTP_STREAM_CLOSE          0x02    // last packet, CRC32 of the stream follows
+#define AMDTP_STREAM_PREFIX_SIZE    9       // flags + length + CRC
+#define AMDTP_STREAM_DATA_SIZE      (AMDTP_MAX_PAYLOAD_SIZE - AMDTP_STREAM_PREFIX_SIZE)
+#define AMDTP_STREAM_LEN_UNKNOWN    0xFFFFFFFFU
+
+#define AMDTP_SEC_CTR_SIZE          4       // packet counter in front of the data
+#define AMDTP_SEC_MIC_SIZE          4       // MIC after the data
+#define AMDTP_SEC_SIZE              (AMDTP_SEC_CTR_SIZE + AMDTP_SEC_MIC_SIZE)
+#define AMDTP_SEC_SKD_SIZE          8       // random bytes of each side for the session key
+
+// an encrypted packet of AMDTP_MAX_PAYLOAD_SIZE is AMDTP_SEC_SIZE longer
+#define AMDTP_CORE_PACKET_SIZE      (AMDTP_PACKET_SIZE + AMDTP_SEC_SIZE)
+
+//*****************************************************************************
+//
+// Callbacks to the front-end
+//
+//*****************************************************************************
+typedef struct
+{
+    // send a frame. type is DATA for data frames, ACK or CONTROL otherwise,
+    // so the front-end can select the characteristic. return false when
+    // the frame could not be queued (data frames are tried again later)
+    bool (*send)(void *user, eAmdtpPktType_t type, uint8_t *buf, uint16_t len);
+
+    // a complete data packet with a correct CRC was received
+    void (*received)(void *user, uint8_t *buf, uint16_t len);
+
+    // optional : the peer acknowledged (or refused) the packet that was sent
+    void (*sent)(void *user, eAmdtpStatus_t status);
+
+    // optional : call AmdtpCoreTimeout() after ms, 0 cancels the timer. A
+    // new call replaces the running timer. Without it only stop-and-wait
+    void (*timer)(void *user, uint32_t ms);
+
+    // optional : part of a received stream, offset is the position in the
+    // stream. Without it received streams are ignored
+    void (*streamReceived)(void *user, uint8_t *buf, uint16_t len, uint32_t offset);
+
+    // optional : a received stream is closed. status is AMDTP_STATUS_SUCCESS,
+    // AMDTP_STATUS_CRC_ERROR, AMDTP_STATUS_INVALID_PKT_LENGTH or (a new stream
+    // was opened before the close) AMDTP_STATUS_UNKNOWN_ERROR
+    void (*streamDone)(void *user, eAmdtpStatus_t status, uint32_t len);
+
+    // optional : AmdtpCoreStreamWrite() can accept data again. For a stream
+    // that is sent, the sent callback is called once, after the last packet
+    void (*writable)(void *user);
+
+    // optional : cut-through. Each part of a received data packet is given as
+    // it arrives, offset is the position in the packet. The CRC is not known
+    // yet, partDone gives the result at the end : AMDTP_STATUS_SUCCESS,
+    // AMDTP_STATUS_CRC_ERROR, AMDTP_STATUS_INSUFFICIENT_BUFFER,
+    // AMDTP_STATUS_INVALID_PKT_LENGTH or (a new packet started before the end)
+    // AMDTP_STATUS_UNKNOWN_ERROR, and len the bytes given. The received
+    // callback is then not called. Stream, compressed and encrypted packets
+    // (all, with a key) are not affected, they go to the received callback
+    void (*partReceived)(void *user, uint8_t *buf, uint16_t len, uint16_t offset);
+    void (*partDone)(void *user, eAmdtpStatus_t status, uint16_t len);
+
+    // optional : fill buf with len random bytes, for the session key. Without
+    // it the packets are not encrypted
+    void (*random)(void *user, uint8_t *buf, uint16_t len);
+
+    void *user;
+}
+amdtpCoreCallbacks_t;
+
+typedef struct
+{
+    uint32_t    packetsSent;        // packets acknowledged by the peer
+    uint32_t    packetsReceived;    // packets delivered
+    uint32_t    framesSent;         // data frames, including repeats
+    uint32_t    framesResent;       // data frames sent again
+    uint32_t    framesReceived;     // data frames
+    uint32_t    framesDuplicate;    // data frames that were already received
+    uint32_t    controlSent;        // ACK and CONTROL packets
+    uint32_t    sendBusy;           // data frames refused by the transport
+    uint32_t    timeouts;           // retransmission timeouts
+    uint32_t    crcErrors;          // received packets with a wrong CRC (or not decompressed)
+    uint32_t    streamsSent;        // streams acknowledged by the peer
+    uint32_t    streamsReceived;    // streams closed with a correct length and CRC
+    uint32_t    packetsCompressed;  // data packets sent compressed
+    uint32_t    bytesSaved;         // by the compression of the packets sent
+    uint32_t    authErrors;         // received packets dropped : not encrypted, wrong MIC or repeated
+    uint32_t    framesReordered;    // window frames received after a higher frame of the packet
+    uint32_t    framesStale;        // window frames of a packet that was delivered or abandoned
+}
+amdtpCoreStats_t;
+
+//
+// CRC of a packet that is received, calculated as the frames come in. The
+// last 4 bytes of the packet are the CRC of the peer, kept apart
+//
+typedef struct
+{
+    uint32_t    crc;
+    uint8_t     peer[AMDTP_CRC_SIZE_IN_PKT];
+}
+amdtpRxCrc_t;
+
+//
+// the state of one connection
+//
+typedef struct
+{
+    amdtpCoreCallbacks_t cb;
+    uint16_t            attMtuSize;         // expected MTU size
+    uint8_t             localWindow;        // window we offer, 0 is stop-and-wait only
+    uint8_t             window;             // agreed window, 0 is stop-and-wait
+    uint8_t             peerVersion;        // from the negotiation, 0 if none
+    bool                localCompress;      // compress packets sent, AmdtpCoreSetCompress()
+    bool                keySet;             // key set with AmdtpCoreSetKey()
+    uint8_t             key[AMDTP_CCM_KEY_SIZE];
+
+    // encryption
+    bool                secure;             // session key agreed
+    bool                initiator;          // we sent WINDOW_REQ, the direction in the nonce
+    bool                skdValid;           // skd was sent in WINDOW_REQ
+    uint8_t             skd[AMDTP_SEC_SKD_SIZE];
+    amdtpCcmKey_t       sessionKey;         // key schedule of the session key
+    uint32_t            txCounter;          // next packet counter to send
+    uint32_t            rxCounter;          // last packet counter received
+    bool                rxCounterValid;
+
+    // receive
+    amdtpPacket_t       rxPkt;              // data packet
+    amdtpPacket_t       ackPkt;             // ACK / CONTROL packet
+    amdtpPacket_t       *rxCur;             // legacy packet in progress, NULL if none
+    uint8_t             lastRxPktSn;        // last received data packet serial number
+    bool                rxSnValid;          // lastRxPktSn is set
+    uint8_t             rxChunkCount;      // legacy frames received in this packet
+    amdtpRxCrc_t        rxPktCrc;           // legacy : CRC of rxPkt
+    amdtpRxCrc_t        rxAckCrc;           // legacy : CRC of ackPkt
+    bool                rxCut;              // legacy : rxPkt is given cut-through
+    bool                rxWinActive;        // window packet in progress
+    bool                rxWinExt;           // it came with extended frames
+    uint16_t            rxWinSn;            // 16 bits with rxWinExt, else 4
+    uint16_t            lastRxExtSn;        // last delivered extended packet
+    bool                rxExtSnValid;       // lastRxExtSn is set
+    uint8_t             rxWinChunkSize;
+    uint8_t             rxWinChunks;        // number of frames, 0 until frame 0 is in
+    uint8_t             rxWinHighest;       // highest frame received
+    uint8_t             rxWinNew;           // frames since the last WINDOW_ACK
+    uint64_t            rxWinMap;           // frames received
+    uint8_t             rxWinFolded;        // frames 0.. in rxWinCrc
+    uint32_t            rxWinCrc;
+    bool                rxWinCut;           // window packet is given cut-through
+
+    // transmit
+    eAmdtpState_t       txState;
+    amdtpPacket_t       txPkt;
+    uint16_t            txPktSn;            // data packet serial number for Tx, 4 bits in the header
+    bool                txWindowed;         // current packet uses the window mode
+    bool                txExt;              // current packet uses extended window frames
+    bool                sendingNotComplete; // legacy : frames left to send
+    uint8_t             txChunkCount;       // legacy : frames sent
+    uint8_t             txChunkSize;
+    uint8_t             txChunks;
+    uint8_t             txRetries;
+    bool                txBlocked;          // transport was full, retry timer runs
+    bool                txResetReq;         // legacy : RESEND_REQ sent by a reset, its reply is not for the packet
+    uint8_t             txAckLen;           // ACK / CONTROL in txAckBuf the transport refused, 0 if none
+    uint8_t             txAckType;
+    uint64_t            txAcked;            // frames confirmed by WINDOW_ACK
+    uint64_t            txPending;          // frames to send (again)
+    uint64_t            txSent;             // frames sent at least once
+    uint64_t            txFastResent;       // frames resent on a gap since the last timeout
+
+    // stream transmit
+    bool                txStreamOpen;       // between AmdtpCoreStreamOpen() and the last ACK
+    bool                txStreamFirst;      // next packet gets AMDTP_STREAM_OPEN
+    bool                txStreamClosing;    // AmdtpCoreStreamClose() was called
+    bool                txStreamPkt;        // packet in progress is part of the stream
+    bool                txStreamLast;       // packet in progress has AMDTP_STREAM_CLOSE
+    uint32_t            txStreamLen;        // announced length
+    uint32_t            txStreamCount;      // bytes accepted
+    uint32_t            txStreamCrc;        // running CRC of the bytes accepted
+    uint16_t            txStreamFill;       // bytes in txStreamBuf
+
+    // stream receive
+    bool                rxStreamOpen;
+    uint32_t            rxStreamLen;
+    uint32_t            rxStreamCount;
+    uint32_t            rxStreamCrc;
+
+    amdtpCoreStats_t    stats;
+
+    uint8_t             rxPktBuf[AMDTP_CORE_PACKET_SIZE];
+    uint8_t             txPktBuf[AMDTP_CORE_PACKET_SIZE];
+    uint8_t             rxAckBuf[AMDTP_ACK_SIZE];
+    uint8_t             txAckBuf[AMDTP_ACK_SIZE];
+    uint8_t             txFrame[ATT_MAX_MTU];
+    uint8_t             txStreamBuf[AMDTP_STREAM_DATA_SIZE];
+    uint8_t             lzBuf[AMDTP_MAX_PAYLOAD_SIZE];     // compressed packet to send
+    uint8_t             rxPlainBuf[AMDTP_MAX_PAYLOAD_SIZE]; // decompressed packet received
+}
+amdtpCore_t;
+
+//*****************************************************************************
+//
+// Function prototypes
+//
+//*****************************************************************************
+
+//*****************************************************************************
+//
+//! @brief Reset the connection state, keeps the callbacks and the window.
+//!
+//! To be called at start and after each (dis)connect. Starts stop-and-wait
+//! at the default MTU.
+//
+//*****************************************************************************
+extern void AmdtpCoreInit(amdtpCore_t *core);
+
+//*****************************************************************************
+//
+//! @brief Stop the packet or stream in progress, both ways.
+//!
+//! For a transfer that timed out. The packet being sent is reported as
+//! failed, a packet being received is dropped. The agreed window, MTU,
+//! serial numbers and session key stay, so no new negotiation is needed.
+//! A stop-and-wait packet cut off halfway sends a RESEND_REQ, so the peer
+//! drops the frames it holds.
+//
+//*****************************************************************************
+extern void AmdtpCoreResetTransfer(amdtpCore_t *core);
+
+//*****************************************************************************
+//
+//! @brief Set the callbacks, before the first AmdtpCoreInit().
+//
+//*****************************************************************************
+extern void AmdtpCoreSetCallbacks(amdtpCore_t *core, const amdtpCoreCallbacks_t *cb);
+
+//*****************************************************************************
+//
+//! @brief Set the ATT MTU, used for new packets.
+//!
+//! A transport that makes a frame longer on the way can pass less than
+//! ATT_DEFAULT_MTU, down to AMDTP_MIN_MTU. New packets are then sent
+//! stop-and-wait, the window frames need at least ATT_DEFAULT_MTU.
+//! Clipped to ATT_MAX_MTU.
+//
+//*****************************************************************************
+extern void AmdtpCoreSetMtu(amdtpCore_t *core, uint16_t attMtuSize);
+
+//*****************************************************************************
+//
+//! @brief Set the window to offer, 0 disables the window mode.
+//!
+//! Clipped to AMDTP_WINDOW_MAX. Forced to 0 without a timer callback.
+//
+//*****************************************************************************
+extern void AmdtpCoreSetWindow(amdtpCore_t *core, uint8_t window);
+
+//*****************************************************************************
+//
+//! @brief Compress the data packets that are sent, when the peer supports it.
+//!
+//! Kept by AmdtpCoreInit(). Off by default.
+//
+//*****************************************************************************
+extern void AmdtpCoreSetCompress(amdtpCore_t *core, bool enable);
+
+//*****************************************************************************
+//
+//! @brief Set the key (AMDTP_CCM_KEY_SIZE bytes) to encrypt the data
+//! packets, NULL turns encryption off.
+//!
+//! Both sides need the same key and the random callback. Set it before
+//! connecting, kept by AmdtpCoreInit(). The session key is agreed at the
+//! negotiation.
+//
+//*****************************************************************************
+extern void AmdtpCoreSetKey(amdtpCore_t *core, const uint8_t *key);
+
+//*****************************************************************************
+//
+//! @brief Offer the window mode to the peer (client, after subscribing).
+//
+//*****************************************************************************
+extern void AmdtpCoreNegotiate(amdtpCore_t *core);
+
+//*****************************************************************************
+//
+//! @brief Handle a received frame.
+//!
+//! @return status as the original AmdtpReceivePkt()
+//
+//*****************************************************************************
+extern eAmdtpStatus_t AmdtpCoreReceive(amdtpCore_t *core, uint8_t *buf, uint16_t len);
+
+//*****************************************************************************
+//
+//! @brief Start sending a data packet.
+//!
+//! @return AMDTP_STATUS_SUCCESS, AMDTP_STATUS_BUSY,
+//!         AMDTP_STATUS_INVALID_PKT_LENGTH or (a key is set, but no session
+//!         key agreed) AMDTP_STATUS_TX_NOT_READY
+//
+//*****************************************************************************
+extern eAmdtpStatus_t AmdtpCoreSend(amdtpCore_t *core, uint8_t *buf, uint16_t len);
+
+//*****************************************************************************
+//
+//! @brief True when all frames of the packet have been sent (stop-and-wait)
+//! or the peer acknowledged the packet (window).
+//
+//*****************************************************************************
+extern bool AmdtpCoreSendComplete(amdtpCore_t *core);
+
+//*****************************************************************************
+//
+//! @brief Send pending frames, e.g. when the transport has room again. An ACK
+//! or CONTROL the transport refused goes first.
+//
+//*****************************************************************************
+extern void AmdtpCorePump(amdtpCore_t *core);
+
+//*****************************************************************************
+//
+//! @brief The timer set with the timer callback has expired.
+//
+//*****************************************************************************
+extern void AmdtpCoreTimeout(amdtpCore_t *core);
+
+//*****************************************************************************
+//
+//! @brief Start sending a stream of len bytes.
+//!
+//! len can be AMDTP_STREAM_LEN_UNKNOWN, the receiver then gets the length at
+//! the close.
+//!
+//! @return AMDTP_STATUS_SUCCESS, AMDTP_STATUS_BUSY or
+//!         AMDTP_STATUS_TX_NOT_READY (the peer does not support streams,
+//!         or a key is set but no session key agreed)
+//
+//*****************************************************************************
+extern eAmdtpStatus_t AmdtpCoreStreamOpen(amdtpCore_t *core, uint32_t len);
+
+//*****************************************************************************
+//
+//! @brief Add data to the open stream.
+//!
+//! @return the number of bytes accepted, 0 when the staging buffer is full
+//!         (try again after the writable callback) or no stream is open
+//
+//*****************************************************************************
+extern uint16_t AmdtpCoreStreamWrite(amdtpCore_t *core, const uint8_t *buf, uint16_t len);
+
+//*****************************************************************************
+//
+//! @brief Close the stream, the sent callback reports the result.
+//
+//*****************************************************************************
+extern eAmdtpStatus_t AmdtpCoreStreamClose(amdtpCore_t *core);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AMDTP_CORE_H
@@ -54,6 +54,23 @@ extern "C" {
 /*************************************************************************************************/
 uint32_t CalcCrc32(uint32_t crcInit, uint32_t len, uint8_t *pBuf);
 
+/*************************************************************************************************/
+/*
+ *  Incremental CRC-32 (paulvha / October 2026)
+ *
+ *  Start with crc = 0 and pass the result back to continue over the next part.
+ *  The result is the same as zlib crc32() and CalcCrc32(0xFFFFFFFF, len, pBuf).
+ *
+ *  CRC32_SLICE 8 : slicing-by-8, 7 Kbyte extra tables in RAM (made on first call)
+ *  CRC32_SLICE 1 : one byte at the time with crc32Table (as CalcCrc32)
+ */
+/*************************************************************************************************/
+#ifndef CRC32_SLICE
+#define CRC32_SLICE 8
+#endif
+
+uint32_t AmdtpCrc32(uint32_t crc, const uint8_t *pBuf, uint32_t len);
+
 #ifdef __cplusplus
 };
 #endif
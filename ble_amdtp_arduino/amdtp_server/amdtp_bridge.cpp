@@ -7,19 +7,26 @@
  *  
  * Version 3.1 / December 2020 / paulvha
  *  adding a delay in sending ACK (communication fails often with an ACk)
+ *
+ * Version 4.1 / October 2026 / paulvha
+ *  the characteristics are raw bytes now, no String and no 0x7E 0x20 escape. A
+ *  received frame is given as is to AmdtpReceivePkt().
+ *
+ * Version 4.3 / October 2026 / paulvha
+ *  SetLinkParams() : the bulk mode of amdtp_link.c asks the central for other
+ *  connection parameters (needs ArduinoBLE_P 3.3.4, HCI_LINK_UPDATE)
  */
 
 #include "amdtp_common.h"
 #include "amdtp_bridge.h"
-
-uint8_t ReceivedBuf[100]; // encode
-uint16_t ReceivedLen;     // encode
-String s_value;           // sending
+#include "utility/HCI.h"      // HCI_LINK_UPDATE
 
 void blePeripheralConnectHandler(BLEDevice central) {
 
   Serial.print("\rConnected event, central: ");
   Serial.println(central.address());
+
+  amdtps_connected(millis());
 }
 
 void blePeripheralDisconnectHandler(BLEDevice central) {
@@ -29,6 +36,9 @@ void blePeripheralDisconnectHandler(BLEDevice central) {
   
   // reset all pointers
   amdtps_init();
+
+  // stop the telemetry
+  server_disconnected();
 }
 ////////////////////////////////////////////////////////
 // receiving data over the handles                    //
@@ -39,10 +49,8 @@ void RxChar_Received(BLEDevice central, BLECharacteristic characteristic) {
   Serial.print(F("\r\nRX receive "));
 #endif
 
-  String a = (const char*) characteristic.value();
-  int vsize = a.length();
-  encode_receipt(a,vsize);
-  AmdtpReceivePkt(AMDTP_PKT_TYPE_DATA, ReceivedLen, ReceivedBuf);
+  show_receipt(characteristic);
+  AmdtpReceivePkt(AMDTP_PKT_TYPE_DATA, characteristic.valueLength(), (uint8_t *) characteristic.value());
 }
 
 // not expected to receive anything on the TX characteristic
@@ -52,9 +60,7 @@ void TxChar_Received(BLEDevice central, BLECharacteristic characteristic) {
   Serial.print(F("\r\nTX receive??? "));
 #endif
 
-  String a = (const char*) characteristic.value();
-  int vsize = a.length();
-  encode_receipt(a,vsize);
+  show_receipt(characteristic);
 }
 
 void AckChar_Received(BLEDevice central, BLECharacteristic characteristic) {
@@ -63,11 +69,8 @@ void AckChar_Received(BLEDevice central, BLECharacteristic characteristic) {
   Serial.print(F("\r\nACK receive"));
 #endif
 
-  String a = (const char*) characteristic.value();
-  int vsize = a.length();
-  encode_receipt(a,vsize);
-  
-  AmdtpReceivePkt(AMDTP_PKT_TYPE_ACK, ReceivedLen, ReceivedBuf);
+  show_receipt(characteristic);
+  AmdtpReceivePkt(AMDTP_PKT_TYPE_ACK, characteristic.valueLength(), (uint8_t *) characteristic.value());
 }
 
 ////////////////////////////////////////////////////////
@@ -81,9 +84,9 @@ void TxChar_Write(uint8_t *value, uint16_t vlen) {
   Serial.print(F("\r\nTX / data packet write: "));
 #endif
 
-  PrepSending(value,vlen);
+  show_sending(value, vlen);
   
-  TxChar.writeValue(s_value);
+  TxChar.writeValue(value, (int) vlen);
 }
 
 void AckChar_Write(uint8_t *value, uint16_t vlen) {
@@ -92,84 +95,44 @@ void AckChar_Write(uint8_t *value, uint16_t vlen) {
   Serial.print(F("\r\nAck write:"));
 #endif
 
-  PrepSending(value,vlen);
+  show_sending(value, vlen);
   
   // wait to improve stability of responds
   // have seen that Ack-packages get lost by the Apollo HCI layer
   // if sent to quickly. We have only seen this fail with sending ACK
   delay(500); 
   
-  AckChar.writeValue(s_value);
+  AckChar.writeValue(value, (int) vlen);
 }
 
 /////////////////////////////////////////////////////////////
-// Supporting routines for sending                         //
+// Supporting routines                                     //
 /////////////////////////////////////////////////////////////
-// create String to send
-void PrepSending(uint8_t *value, uint16_t vlen) {
-  
-  s_value = "";
-  for (size_t i = 0; i < vlen; i++)  s_value += (char) value[i];
+/*
+ * The characteristics are raw bytes (BLECharacteristic, not BLEStringCharacteristic),
+ * so a zero in a frame is sent and received as is. The value of the characteristic
+ * is handed to the AMDTP core without a copy, the core only reads it.
+ */
+void show_sending(uint8_t *value, uint16_t vlen) {
   
 #ifdef BLE_Debug
-  for (size_t i = 0; i < s_value.length(); i++) {
-    Serial.print(" 0x"); Serial.print(s_value[i],HEX);
+  for (size_t i = 0; i < vlen; i++) {
+    Serial.print(" 0x"); Serial.print(value[i],HEX);
   }
   Serial.println();
 #endif
 }
 
-/*
- * As we receive bytes on a String characteristic, we can not have a zero in the middle of the 
- * bytes to be received. At the sender side we translate a zero to 0x73 0x20. This routine
- * will just do the opposite and translate 0x7e 0x20 back to 0x0. This is done in gatt.c on 
- * Linux / Ubuntu.
- * 
- * Hope and pray that 0x7e 0x20 strings do not happen ... else we extend the decode one morestep.
- */
-void encode_receipt(String a, int vsize)
-{
-  char save = 0x0;
-  ReceivedLen = 0;
-
-  for (int i = 0; i < vsize; i++) {
-
-    char c = a[i];
-    
-    // Header character for 0x0 ??
-    if (c == 0x7E && save == 0x0) {
-        save = 0x7E;
-        continue;
-    }
-    
-    // did we get a header character before
-    if (save == 0x7E) {
-      
-      // if next is 0x20 then the real character was 0x0;
-      if (c == 0x20)  c = 0x0;
-
-      // the previous 0x7E was not header, add now
-      else {
-        ReceivedBuf[ReceivedLen++] = save;
-      }
-
-    save = 0x0; // reset header
-    }
-
-    // Store real current character
-    ReceivedBuf[ReceivedLen++] = c;
-  }
+void show_receipt(BLECharacteristic characteristic) {
   
 #ifdef BLE_SHOW_DATA
-  Serial.printf("\r\nRaw received (length %d) : ",vsize);
+  const uint8_t *a = characteristic.value();
+  int vsize = characteristic.valueLength();
+  
+  Serial.printf("\r\nReceived (length %d) : ",vsize);
   for (int i = 0; i < vsize; i++) {
     Serial.print(" 0x");  Serial.print(a[i],HEX);
   }
-  
-  Serial.printf("\r\nAfter encode (size %d) :", ReceivedLen);
-  for (int i = 0; i < ReceivedLen; i++) {
-    Serial.print(" 0x"); Serial.print(ReceivedBuf[i],HEX);
-  }
 
   Serial.println();
 #endif
@@ -191,6 +154,27 @@ extern "C" void SendDataPacket(uint8_t *value, uint16_t vlen) {
 extern "C" void SendAckPacket(uint8_t *value, uint16_t vlen) {
   AckChar_Write(value, vlen);
 }
+
+#ifdef AMDTP_BULK_MODE
+// the central decides, it can give other values or refuse the PHY / data length
+extern "C" void SetLinkParams(void *user, const amdtpLinkParams_t *params, bool bulk) {
+
+#ifdef HCI_LINK_UPDATE
+  BLEDevice central = BLE.central();
+
+  if (! central) return;
+
+#ifdef BLE_SHOW_DATA
+  Serial.printf("\rAsk %s : interval %d - %d, latency %d, PHY %dM, %d bytes\n", bulk ? "bulk" : "idle",
+                params->intervalMin, params->intervalMax, params->latency, params->phy, params->dataLength);
+#endif
+
+  central.updateConnection(params->intervalMin, params->intervalMax, params->latency, params->timeout);
+  central.setPhy(params->phy);
+  central.setDataLength(params->dataLength);
+#endif // HCI_LINK_UPDATE
+}
+#endif // AMDTP_BULK_MODE
 extern void set_led_high( void ){
   digitalWrite(LED_BUILTIN, HIGH);
 }
@@ -7,6 +7,9 @@
  *  
  * Version 3.1 / December 2020 / paulvha
  *  adding a delay in sending ACK (communication fails often with an ACk)
+ *
+ * Version 4.2 / October 2026 / paulvha
+ *  added AMDTP_CMD_SUBSCRIBE, AMDTP_CMD_UNSUBSCRIBE and AMDTP_CMD_TELEMETRY
  */
 
 #ifndef _BLE_AMDTP_H_
@@ -14,6 +17,10 @@
 
 #include <ArduinoBLE.h>
 #include <Arduino.h>
+#include "amdtp_common.h"
+#ifdef AMDTP_BULK_MODE
+#include "amdtp_link.h"
+#endif
 
 // command to sent between client and server
 // make sure to stay in sync with the list on the client !!!
@@ -42,6 +49,9 @@ typedef enum eAmdtpcmd
     AMDTP_CMD_CUSTOM3,
     AMDTP_CMD_CUSTOM4,
     AMDTP_CMD_CUSTOM5,
+    AMDTP_CMD_SUBSCRIBE,            // batched telemetry (amdtp_tlm.h), server 4.2
+    AMDTP_CMD_UNSUBSCRIBE,
+    AMDTP_CMD_TELEMETRY,            // a batch, pushed by the server
     AMDTP_CMD_MAX
 }eAmdtpPktcmd_t;
 
@@ -65,12 +75,13 @@ void AckChar_Received(BLEDevice central, BLECharacteristic characteristic);
 void TxChar_Write(uint8_t *value, uint16_t vlen);
 void AckChar_Write(uint8_t *value, uint16_t vlen);
 void UserRequestReceived(uint8_t * buf, uint16_t len);
-void encode_receipt(String a, int vsize);
-void PrepSending(uint8_t *value, uint16_t vlen);
+void show_receipt(BLECharacteristic characteristic);
+void show_sending(uint8_t *value, uint16_t vlen);
 
 extern void set_led_high( void );
 extern void set_led_low( void );
-extern BLEStringCharacteristic TxChar;
-extern BLEStringCharacteristic AckChar;
+extern void server_disconnected( void );
+extern BLECharacteristic TxChar;
+extern BLECharacteristic AckChar;
 
 #endif // _BLE_AMDTP_H_
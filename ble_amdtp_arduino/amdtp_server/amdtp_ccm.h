@@ -0,0 +1,89 @@
+// ****************************************************************************
+//
+//  amdtp_ccm.h
+//! @file
+//!
+//! @brief AES-128-CCM for AMDTP packets.
+//!
+//! CCM as in NIST SP800-38C / RFC 3610 with a 13 byte nonce (2 byte length
+//! field), the same as the BLE link layer. The AES key schedule is made once
+//! per key with AmdtpCcmSetKey(), after that a packet only costs the block
+//! operations : about 2 AES blocks per 16 bytes (CBC-MAC and counter mode).
+//!
+//! The data is encrypted and decrypted in place, the MIC (4 - 16 bytes) is
+//! written or checked at mic, which can directly follow the data.
+//!
+//! Only the AES encryption is needed (also to decrypt in CCM). The tables
+//! are const, so in flash on an MCU : 256 bytes S-box and 1 Kbyte T-table.
+//!
+//! added paulvha / October 2026
+//
+// ****************************************************************************
+
+#ifndef AMDTP_CCM_H
+#define AMDTP_CCM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define AMDTP_CCM_KEY_SIZE      16
+#define AMDTP_CCM_BLOCK_SIZE    16
+#define AMDTP_CCM_NONCE_SIZE    13
+
+//
+// AES-128 key schedule, 11 round keys
+//
+typedef struct
+{
+    uint32_t    rk[44];
+}
+amdtpCcmKey_t;
+
+//*****************************************************************************
+//
+//! @brief Make the key schedule for key (AMDTP_CCM_KEY_SIZE bytes).
+//
+//*****************************************************************************
+extern void AmdtpCcmSetKey(amdtpCcmKey_t *ctx, const uint8_t *key);
+
+//*****************************************************************************
+//
+//! @brief Encrypt one block (AMDTP_CCM_BLOCK_SIZE bytes), in and out can be
+//! the same.
+//
+//*****************************************************************************
+extern void AmdtpCcmBlock(const amdtpCcmKey_t *ctx, const uint8_t *in, uint8_t *out);
+
+//*****************************************************************************
+//
+//! @brief Encrypt len bytes in buf and write the MIC of micLen bytes (even,
+//! 4 - 16) to mic. aad (aadLen bytes, can be 0) is authenticated, not
+//! encrypted.
+//
+//*****************************************************************************
+extern void AmdtpCcmEncrypt(const amdtpCcmKey_t *ctx, const uint8_t *nonce,
+                            const uint8_t *aad, uint16_t aadLen,
+                            uint8_t *buf, uint16_t len, uint8_t *mic, uint8_t micLen);
+
+//*****************************************************************************
+//
+//! @brief Decrypt len bytes in buf and check the MIC.
+//!
+//! @return true when the MIC is correct. Else buf is not valid and should be
+//!         dropped.
+//
+//*****************************************************************************
+extern bool AmdtpCcmDecrypt(const amdtpCcmKey_t *ctx, const uint8_t *nonce,
+                            const uint8_t *aad, uint16_t aadLen,
+                            uint8_t *buf, uint16_t len, const uint8_t *mic, uint8_t micLen);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AMDTP_CCM_H
@@ -49,7 +49,22 @@
 // changed structure to detect ACK packet from host is being sent of TX. 
 // This has been changed as ACK-handle is notify and repeats what has been sent by
 // host, causing unnecessary traffic and unstable communication
-
+//
+// version 4.0 / October 2026 / paulvha
+// The protocol state machine is now amdtp_core.c, the same core as used by
+// MBED-BLE and amdtc (copy of MBED-BLE/src/amdtp/amdtp_core.c, do not change
+// here). This file connects it to amdtp_bridge.cpp : the 0x7E 0x20 escape and
+// the characteristic to use. Multi-frame packets now wait for SEND_READY from
+// the client instead of a delay(500) between the frames.
+//
+// version 4.1 / October 2026 / paulvha
+// The characteristics are raw bytes now : frames are sent as built by the core,
+// without the 0x7E 0x20 escape for a zero, and can use the full MTU.
+//
+// version 4.3 / October 2026 / paulvha
+// AMDTP_BULK_MODE : amdtp_link.c (copy of MBED-BLE/src/amdtp/amdtp_link.c) asks
+// for other connection parameters as the core starts or ends a transfer, see
+// amdtps_poll().
 //
 //*****************************************************************************
 
@@ -58,6 +73,10 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include "amdtp_common.h"
+#include "amdtp_core.h"
+#ifdef AMDTP_BULK_MODE
+#include "amdtp_link.h"
+#endif
 //#include "crc32.h"
 
 #if (defined BLE_Debug) || (defined BLE_SHOW_DATA)    // amdtp_common.h
@@ -70,489 +89,153 @@ extern void debug_float (float f);
 extern void UserRequestRec(uint8_t * buf, uint16_t len);
 extern void SendDataPacket(uint8_t *value, uint16_t vlen);
 extern void SendAckPacket(uint8_t *value, uint16_t vlen);
-
-uint8_t rxPktBuf[AMDTP_PACKET_SIZE];        // about 512 + 4 + 4
-uint8_t txPktBuf[AMDTP_PACKET_SIZE];
-uint8_t txDecode[AMDTP_PACKET_SIZE];
-uint8_t ackPktBuf[20];
+#ifdef AMDTP_BULK_MODE
+extern void SetLinkParams(void *user, const amdtpLinkParams_t *params, bool bulk);
+#endif
 
 /* Control block */
 static struct
 {
-    uint8_t             *txdecode;           // store decoded data
     bool                txReady;            // TRUE if ready to send notifications
-    amdtpCb_t           core;
+    amdtpCore_t         core;
+#ifdef AMDTP_BULK_MODE
+    amdtpLink_t         link;               // bulk mode
+#endif
 }
 amdtpsCb;
 
 //*****************************************************************************
 //
-//! @brief initialize amdtp service
-//!
-//!
-//! @return None
+// core callback : send a frame, data over TX, ACK and control over ACK
 //
 //*****************************************************************************
-void
-amdtps_init()
+static bool
+amdtpsCoreSend(void *user, eAmdtpPktType_t type, uint8_t *buf, uint16_t len)
 {
-    #ifdef BLE_Debug
-        debug_print(__func__, __FILE__, __LINE__);
-    #endif
-
-    memset(&amdtpsCb, 0, sizeof(amdtpsCb));
-
-    amdtpsCb.core.lastRxPktSn = 0;                  // keep track of serial number 0 .. 15
-    amdtpsCb.core.txPktSn = 0;
-
-    resetPkt(&amdtpsCb.core.rxPkt);                 // set buffers
-    amdtpsCb.core.rxPkt.data = rxPktBuf;
- 
-    resetPkt(&amdtpsCb.core.txPkt);
-    amdtpsCb.core.txPkt.data = txPktBuf;
+#ifdef BLE_SHOW_DATA
+  if (type == AMDTP_PKT_TYPE_DATA)
+    debug_printf("\r\n=========== Data frame for sending ====================\r\n");
+  else
+    debug_printf("\r\n=========== Ack frame for sending =====================\r\n");
 
-    resetPkt(&amdtpsCb.core.ackPkt);
-    amdtpsCb.core.ackPkt.data = ackPktBuf;
+  for (uint16_t i = 0; i < len; i++) debug_printf("0x%02X ", buf[i]);
+  debug_printf("\r\n");
+#endif
 
-    amdtpsCb.txdecode = txDecode;
-    amdtpsCb.core.attMtuSize = ATT_DEFAULT_MTU;     // needed to break a package is pieces
- 
-    amdtpsCb.core.txState = AMDTP_STATE_TX_IDLE;    // enable sending
-    amdtpsCb.txReady = true;
-}
+  // sent it (in amdtp_bridge.cpp)
+  if (type == AMDTP_PKT_TYPE_DATA)
+    SendDataPacket(buf, len);
+  else
+    SendAckPacket(buf, len);
 
-//*****************************************************************************
-//! @brief reset package
-//*****************************************************************************
-void
-resetPkt(amdtpPacket_t *pkt)
-{
-    pkt->offset = 0;        // no data in buffer to start from
-    pkt->header.pktType = AMDTP_PKT_TYPE_UNKNOWN; // unknown what is left
-    pkt->len = 0;           // no length in buffer
+  return true;
 }
 
 //*****************************************************************************
-//! @brief check for type of packet (Data or ACK) added version 3.1 
-// return true for data packet
-//*****************************************************************************
-bool Check_type(uint16_t len, uint8_t *pValue)
-{
-  uint16_t header;
-  
-  BYTES_TO_UINT16(header, &pValue[2]);              // second 2 bytes is header
-  if((header & PACKET_TYPE_BIT_MASK) >> PACKET_TYPE_BIT_OFFSET == AMDTP_PKT_TYPE_DATA)
-    return true;
-    
-  return false;
-}
-//*****************************************************************************
-// parse a received message
 //
-// Makes sure to receive a complete correct message
+// core callback : a complete packet with correct CRC was received
 //
-// AMDTP_STATUS_INVALID_PKT_LENGTH = Not enough data to start extracting the message
-// AMDTP_STATUS_INSUFFICIENT_BUFFER = not enough space to store the received message
-// AMDTP_STATUS_CRC_ERROR = CRC is not correct
-// AMDTP_STATUS_RECEIVE_DONE = message is complete and correct. Ready to go
-// AMDTP_STATUS_RECEIVE_CONTINUE = need more data packages. we are not complete yet.
-//
-// November 2020 / paulvha
-// Changed to use the handle as indicator or Data or Acknowledge. This because
-// Ackknowledge is now written by client ( host) to server (Slave) using the same
-// TX handle. This has been done as ArduinoBlE will repeat a write to ACK-handle
-// as this is also a NOtification handle. Leading to issue in handling response
-// 
 //*****************************************************************************
-eAmdtpStatus_t
-AmdtpReceivePkt(uint8_t handle, uint16_t len, uint8_t *pValue)
+static void
+amdtpsCoreReceived(void *user, uint8_t *buf, uint16_t len)
 {
-  amdtpPacket_t *pkt;
-
-  uint8_t dataIdx = 0;
-  uint32_t calDataCrc = 0;
-  uint16_t header = 0;
-  
-  static bool FirstPacket = true;
-  static bool Ptype;
-
-#ifdef BLE_Debug
-  debug_print(__func__, __FILE__, __LINE__);
-#endif
-
-  // do NOT use the handle to determine whether this is RX or ACK
-  // the program has chaned to sent ACK now also over RX, given that
-  // ArduinoBLE is repeating whatever is received over notify.
-  // When a NEW package is expected, check for the right package first
-  // and remember that in a static bool. added version 3.1 
-
-  if (FirstPacket){
-    Ptype = Check_type(len, pValue);
-    FirstPacket = false;
-  }
-
-  if (Ptype)  pkt = &amdtpsCb.core.rxPkt;
-  else  pkt = &amdtpsCb.core.ackPkt;
-
-  // len must include length (2) and header (2)
-  if (pkt->offset == 0 && len < AMDTP_PREFIX_SIZE_IN_PKT)
-  {
-#ifdef BLE_Debug
-    debug_printf("\rInvalid packet size !!!\n");
-#endif
-    FirstPacket = true;
-    AmdtpSendReply(AMDTP_STATUS_INVALID_PKT_LENGTH, NULL, 0);
-    return AMDTP_STATUS_INVALID_PKT_LENGTH;
-  }
-
-  // if new packet (not received packet(s) before, in case full message needs multiple packets
-  // to be sent
-  
-  if (pkt->offset == 0)
-  {
-    BYTES_TO_UINT16(pkt->len, pValue);                // first 2 bytes is length
-    BYTES_TO_UINT16(header, &pValue[2]);              // second 2 bytes is header
-    pkt->header.pktType = (header & PACKET_TYPE_BIT_MASK) >> PACKET_TYPE_BIT_OFFSET; // mask = 0xf, offset is 12 : top 4 bits
-    pkt->header.pktSn = (header & PACKET_SN_BIT_MASK) >> PACKET_SN_BIT_OFFSET;       // mask = 0xf , ofsset is 8 : next for 4 bits
-    pkt->header.encrypted = (header & PACKET_ENCRYPTION_BIT_MASK) >> PACKET_ENCRYPTION_BIT_OFFSET;  // mask = 1, offset is 7, next bit
-    pkt->header.ackEnabled = (header & PACKET_ACK_BIT_MASK) >> PACKET_ACK_BIT_OFFSET; // mask 1, offset is 6, next bit
-    dataIdx = AMDTP_PREFIX_SIZE_IN_PKT;     // 4
-
-#ifdef BLE_Debug
-    debug_printf("\rpkt len = 0x%x, pkt header = 0x%x :\n", pkt->len, header);
-    switch (pkt->header.pktType) {
-      case  AMDTP_PKT_TYPE_DATA:
-        debug_printf("\rtype = %d : DATA ", pkt->header.pktType);
-        break;
-      case  AMDTP_PKT_TYPE_ACK:
-        debug_printf("\rtype = %d : ACK ", pkt->header.pktType);
-        break;
-      case  AMDTP_PKT_TYPE_CONTROL:
-        debug_printf("\rtype = %d : Control ", pkt->header.pktType);
-        break;
-      default:
-        debug_printf("\rtype = %d : Unknown ", pkt->header.pktType);
-        break;
-    }
-    debug_printf("sn = %d, enc = %d, ackEnabled = %d\n", pkt->header.pktSn, pkt->header.encrypted, pkt->header.ackEnabled);
-#endif
-  }
-
-  // make sure we have enough space for new data
-  if (pkt->offset + len - dataIdx > AMDTP_PACKET_SIZE)   // make sure it fits in 512 + 4 +4 (max length defined amdtp_common.h:  512)
-  {
-#ifdef BLE_Debug
-    debug_printf("\rNot enough buffer size!!!\n");
-#endif
-
-    resetPkt(pkt);
-    FirstPacket = true;
-    AmdtpSendReply(AMDTP_STATUS_INSUFFICIENT_BUFFER, NULL, 0);
-    return AMDTP_STATUS_INSUFFICIENT_BUFFER;
-  }
-
-  // copy new data into buffer and also save crc into it if it's the last packet in a message
-  // 4 bytes crc is included in pkt length
-  
-  memcpy(pkt->data + pkt->offset, pValue + dataIdx, len - dataIdx); // skip the header
-  pkt->offset += (len - dataIdx);
-
-  // whole packet received
-  if (pkt->offset >= pkt->len)
-  {
-    uint32_t peerCrc = 0;
-    //
-    // check CRC
-    //
-    BYTES_TO_UINT32(peerCrc, pkt->data + pkt->len - AMDTP_CRC_SIZE_IN_PKT);
-    calDataCrc = CalcCrc32(0xFFFFFFFFU, pkt->len - AMDTP_CRC_SIZE_IN_PKT, pkt->data);
-
-    if (peerCrc != calDataCrc)
-    {
-#ifdef BLE_Debug
-      debug_printf("\rcrc error :\ncalDataCrc = 0x%x ", calDataCrc);
-      debug_printf("peerCrc = 0x%x\n", peerCrc);
-#endif
-      
-      // reset pkt
-      resetPkt(pkt);
-
-      // next time again a new packet of a new message
-      FirstPacket = true;
-
-      AmdtpSendReply(AMDTP_STATUS_CRC_ERROR, NULL, 0);
-      return AMDTP_STATUS_CRC_ERROR;
-    }
-
-    // we have it all, now handle request
-    AmdtpPacketHandler((eAmdtpPktType_t)pkt->header.pktType, pkt->len - AMDTP_CRC_SIZE_IN_PKT, pkt->data);
-
-    // next time again a new packet of a new message
-    FirstPacket = true;
-    
-    return AMDTP_STATUS_RECEIVE_DONE;
- }
-
-  // not all had been received
-  return AMDTP_STATUS_RECEIVE_CONTINUE;
+  // finally we are going to user level to handle the request
+  UserRequestRec(buf, len);
 }
 
 //*****************************************************************************
 //
-// AMDTP packet handler 
-// what to do now a complete package has been RECEIVED ?
+//! @brief initialize amdtp service
+//!
+//!
+//! @return None
 //
 //*****************************************************************************
 void
-AmdtpPacketHandler(eAmdtpPktType_t type, uint16_t len, uint8_t *buf)
+amdtps_init()
 {
-#ifdef BLE_Debug
-  debug_print(__func__, __FILE__, __LINE__);
-#endif
-
-  switch(type)
-  {
-    case AMDTP_PKT_TYPE_DATA:
-      //
-      // data package received
-      //
-      // record packet serial number
-
-      amdtpsCb.core.lastRxPktSn = amdtpsCb.core.rxPkt.header.pktSn;
-      
-      AmdtpSendReply(AMDTP_STATUS_SUCCESS, NULL, 0);
-      
-      // finally we are going to user level to handle the request
-      UserRequestRec(buf, len);
-
-      resetPkt(&amdtpsCb.core.rxPkt);
-      break;
+    #ifdef BLE_Debug
+        debug_print(__func__, __FILE__, __LINE__);
+    #endif
 
-    case AMDTP_PKT_TYPE_ACK:
-    {
-      eAmdtpStatus_t status = (eAmdtpStatus_t)buf[0];
-      
-      if (amdtpsCb.core.txState != AMDTP_STATE_WAITING_ACK){
-#ifdef BLE_Debug
-        debug_printf("Warning : Received an unexpected ACK\n");
-#endif
-      }
-      
-      amdtpsCb.core.txState = AMDTP_STATE_TX_IDLE;
+    // no timer : the core stays stop-and-wait
+    amdtpCoreCallbacks_t cb = {0};
+    cb.send = amdtpsCoreSend;
+    cb.received = amdtpsCoreReceived;
 
-      if (status == AMDTP_STATUS_CRC_ERROR || status == AMDTP_STATUS_RESEND_REPLY)
-      {
-        // resend packet
-        AmdtpSendPacketHandler();
-      }
-      else
-      {
-        // increase packet serial number if send successfully
-        if (status == AMDTP_STATUS_SUCCESS)
-        {
-          amdtpsCb.core.txPktSn++;
-            
-          if (amdtpsCb.core.txPktSn == 16)     // max 4 bits part of the header (so count 0 - 15)
-          {
-            amdtpsCb.core.txPktSn = 0;
-          }
-        }
+    memset(&amdtpsCb, 0, sizeof(amdtpsCb));
 
-        // reset send packet
-        resetPkt(&amdtpsCb.core.txPkt);
-      }
-      
-      resetPkt(&amdtpsCb.core.ackPkt);
-    }
-      break;
+    AmdtpCoreSetCallbacks(&amdtpsCb.core, &cb);
+    AmdtpCoreInit(&amdtpsCb.core);
 
-  case AMDTP_PKT_TYPE_CONTROL:
-  {
-    eAmdtpControl_t control = (eAmdtpControl_t)buf[0];
-    uint8_t resendPktSn = buf[1];
-    
-    if (control == AMDTP_CONTROL_RESEND_REQ)
-    {
+    // needed to break a package is pieces
+    AmdtpCoreSetMtu(&amdtpsCb.core, ATT_DEFAULT_MTU);
 
-      resetPkt(&amdtpsCb.core.rxPkt);
-      
-      if (resendPktSn > amdtpsCb.core.lastRxPktSn)
-      {
-        AmdtpSendReply(AMDTP_STATUS_RESEND_REPLY, NULL, 0);
-      }
-      else if (resendPktSn == amdtpsCb.core.lastRxPktSn)
-      {
-        AmdtpSendReply(AMDTP_STATUS_SUCCESS, NULL, 0);
-      }
-#ifdef BLE_Debug
-      else
-      {
-         debug_printf("\rCan not act on Control package resendPktSn = %d, lastRxPktSn = %d\n", resendPktSn, amdtpsCb.core.lastRxPktSn);
-      }
-    }
-    else
-    {
-      debug_printf("\rUnexpected contrl request  = %d\n", control);
+#ifdef AMDTP_BULK_MODE
+    // SetLinkParams() in amdtp_bridge.cpp asks the central
+    AmdtpLinkInit(&amdtpsCb.link, SetLinkParams, NULL);
 #endif
-    }
-    
-    resetPkt(&amdtpsCb.core.ackPkt);
-  }
-    break;
 
-  default:
-    break;
-  }
+    amdtpsCb.txReady = true;
 }
 
 //*****************************************************************************
 //
-// create packet to send
+//! @brief a central connected, the connection is as it has chosen
 //
 //*****************************************************************************
 void
-AmdtpBuildPkt(eAmdtpPktType_t type, bool encrypted, bool enableACK, uint8_t *buf, uint16_t len)
+amdtps_connected(uint32_t nowMs)
 {
-#ifdef BLE_Debug
-  debug_print(__func__, __FILE__, __LINE__);
-#endif
-  uint16_t header = 0;
-  uint32_t calDataCrc;
-  amdtpPacket_t *pkt;
-
-  if (type == AMDTP_PKT_TYPE_DATA)
-  {
-    pkt = &amdtpsCb.core.txPkt;
-    header = amdtpsCb.core.txPktSn << PACKET_SN_BIT_OFFSET;  // add 4 bit serial number to right offset
-  }
-  else
-  {
-    pkt = &amdtpsCb.core.ackPkt;                             // acknowledgement of earlier received data
-  }
-
-  //
-  // Prepare header frame to be sent first
-  //
-  // length
-  pkt->len = len + AMDTP_PREFIX_SIZE_IN_PKT + AMDTP_CRC_SIZE_IN_PKT;  // len of data + header & len (4) + CRC (4 ytes)
-  pkt->data[0]  = (len + AMDTP_CRC_SIZE_IN_PKT) & 0xff;               // LSB
-  pkt->data[1]  = ((len + AMDTP_CRC_SIZE_IN_PKT) >> 8) & 0xff;        // MSB length
-
-  // header
-  header = header | (type << PACKET_TYPE_BIT_OFFSET);                 // add 4 bit type
-  if (encrypted)
-  {
-    header = header | (1 << PACKET_ENCRYPTION_BIT_OFFSET);            // set encryption bit (not used really)
-  }
-  if (enableACK)
-  {
-    header = header | (1 << PACKET_ACK_BIT_OFFSET);                   // set acknowledgement bit (NOT used at all, but maybe future function
-  }
-  pkt->data[2] = (header & 0xff);                                     // set header
-  pkt->data[3] = (header >> 8);
-
-  // copy data
-  memcpy(&(pkt->data[AMDTP_PREFIX_SIZE_IN_PKT]), buf, len);           // now add the data
-  calDataCrc = CalcCrc32(0xFFFFFFFFU, len, buf);                      // calculate the CRC
-
-  // add checksum
-  pkt->data[AMDTP_PREFIX_SIZE_IN_PKT + len] = (calDataCrc & 0xff);    // add the 32 bit CRC
-  pkt->data[AMDTP_PREFIX_SIZE_IN_PKT + len + 1] = ((calDataCrc >> 8) & 0xff);
-  pkt->data[AMDTP_PREFIX_SIZE_IN_PKT + len + 2] = ((calDataCrc >> 16) & 0xff);
-  pkt->data[AMDTP_PREFIX_SIZE_IN_PKT + len + 3] = ((calDataCrc >> 24) & 0xff);
-
-#ifdef BLE_SHOW_DATA
-  
-  if (type == AMDTP_PKT_TYPE_DATA)
-    debug_printf("\r\n=========== Data Prepared for sending ====================\r\n");
-  else
-    debug_printf("\r\n=========== Ack Prepared for sending =====================\r\n");
-    
-  for (uint16_t i =0; i < pkt->len; i++) debug_printf("0x%02X ", pkt->data[i]);
-  debug_printf("\r\n");
-#endif
-
-  // decode the 0x0. We send data using STRING characterisc. it does not allow 0x0
-  // in the data
-  uint16_t decoded_len = decode_sent(pkt->data, pkt->len);
-
-  // copy back
-  pkt->len = 0;
-  for (uint16_t i = 0; i < decoded_len; i++) pkt->data[pkt->len++] = amdtpsCb.txdecode[i];
-
-#ifdef BLE_SHOW_DATA
-  debug_printf("\r\n============== Decoded ========================\r\n");
-  debug_printf("\r\nlength %d\r\n",pkt->len);
-  for (uint16_t i =0; i < pkt->len; i++) debug_printf("0x%02X ", pkt->data[i]);
-  debug_printf("\r\n\n");
+#ifdef AMDTP_BULK_MODE
+    AmdtpLinkReset(&amdtpsCb.link, nowMs);
 #endif
 }
 
 //*****************************************************************************
 //
-// Send control message to Receiver
+//! @brief call from loop() : bulk parameters while the core sends or receives
+//! a packet of more than one frame, idle parameters after 2 seconds without
 //
 //*****************************************************************************
 void
-AmdtpSendControl(eAmdtpControl_t control, uint8_t *data, uint16_t len)
+amdtps_poll(uint32_t nowMs)
 {
-#ifdef BLE_Debug
-  debug_print(__func__, __FILE__, __LINE__);
+#ifdef AMDTP_BULK_MODE
+    AmdtpLinkUpdate(&amdtpsCb.link, &amdtpsCb.core, nowMs);
 #endif
-
-  uint8_t buf[ATT_DEFAULT_PAYLOAD_LEN] = {0};
-
-  buf[0] = control;
-  
-  // add any data
-  if (len > 0)  memcpy(buf + 1, data, len);
-  
-  amdtpsSendAck(AMDTP_PKT_TYPE_CONTROL, false, false, buf, len + 1);
 }
 
 //*****************************************************************************
+// parse a received frame
 //
-// Send Reply (ACK - type with status and optional data) to Sender
+// The core finds out whether this is data or an acknowledge from the frame
+// itself, the client writes both on the RX characteristic (version 3.1). The
+// handle is not used.
 //
+// AMDTP_STATUS_INVALID_PKT_LENGTH = Not enough data to start extracting the message
+// AMDTP_STATUS_INSUFFICIENT_BUFFER = not enough space to store the received message
+// AMDTP_STATUS_CRC_ERROR = CRC is not correct
+// AMDTP_STATUS_RECEIVE_DONE = message is complete and correct. Ready to go
+// AMDTP_STATUS_RECEIVE_CONTINUE = need more data packages. we are not complete yet.
 //*****************************************************************************
-void
-AmdtpSendReply(eAmdtpStatus_t status, uint8_t *data, uint16_t len)
+eAmdtpStatus_t
+AmdtpReceivePkt(uint8_t handle, uint16_t len, uint8_t *pValue)
 {
+  eAmdtpStatus_t status;
+
 #ifdef BLE_Debug
   debug_print(__func__, __FILE__, __LINE__);
 #endif
 
-  uint8_t buf[ATT_DEFAULT_PAYLOAD_LEN] = {0}; // max payload length for most PDU on bluetooth
+  status = AmdtpCoreReceive(&amdtpsCb.core, pValue, len);
 
-  buf[0] = status;                    // first byte is status
-  
-  // add any data
-  if (len > 0)  memcpy(buf + 1, data, len);
-
-  amdtpsSendAck(AMDTP_PKT_TYPE_ACK, false, false, buf, len + 1);
-}
-
-//*****************************************************************************
-//
-// @brief  : send acknowledgement over the ACK handle
-// @param type : ack or control
-// @param encrypted : set encryption (not used anywhere.. but who knows in the future ??)
-// @param enableACK : not used anywhere.. but who knows in the future ??
-// @param buf : data to sent
-// @param len : length of data to sent
-//*****************************************************************************
-void
-amdtpsSendAck(eAmdtpPktType_t type, bool encrypted, bool enableACK, uint8_t *buf, uint16_t len)
-{
 #ifdef BLE_Debug
-  debug_print(__func__, __FILE__, __LINE__);
+  if (status != AMDTP_STATUS_RECEIVE_CONTINUE && status != AMDTP_STATUS_RECEIVE_DONE)
+    debug_printf("\rReceive error %d\n", status);
 #endif
-      
-  // create packet with CRC etc
-  AmdtpBuildPkt(type, encrypted, enableACK, buf, len);
-      
-  // sent it (in amdtp_bridge.cpp)
-  SendAckPacket(amdtpsCb.core.ackPkt.data,amdtpsCb.core.ackPkt.len);
+
+  return status;
 }
 
 //*****************************************************************************
@@ -566,35 +249,6 @@ bool AmdtpSendData(uint8_t *buf, uint16_t len)
   debug_print(__func__, __FILE__, __LINE__);
 #endif
 
-  eAmdtpStatus_t st = AmdtpsSendPacket(AMDTP_PKT_TYPE_DATA, false, false, buf, len);
-
-  if(st != AMDTP_STATUS_SUCCESS) return false;
-  return true;
-}
-
-//*****************************************************************************
-//
-//! @brief Send data to Client via notification
-//!
-//! @param type - packet type
-//! @param encrypted - is packet encrypted
-//! @param enableACK - does client need to response
-//! @param buf - data
-//! @param len - data length
-//!
-//! @return status
-// AMDTP_STATUS_TX_NOT_READY;
-// AMDTP_STATUS_BUSY
-// AMDTP_STATUS_INVALID_PKT_LENGTH
-// AMDTP_STATUS_SUCCESS
-//
-//*****************************************************************************
-eAmdtpStatus_t
-AmdtpsSendPacket(eAmdtpPktType_t type, bool encrypted, bool enableACK, uint8_t *buf, uint16_t len)
-{
-#ifdef BLE_Debug
-  debug_print(__func__, __FILE__, __LINE__);
-#endif
   //
   // Check if ready to send notification
   //
@@ -603,111 +257,18 @@ AmdtpsSendPacket(eAmdtpPktType_t type, bool encrypted, bool enableACK, uint8_t *
 #ifdef BLE_Debug
     debug_printf("data sending failed, not ready for notification.");
 #endif
-    return AMDTP_STATUS_TX_NOT_READY;
+    return false;
   }
 
-  //
-  // Check if the service is idle to send
-  //
-  if ( amdtpsCb.core.txState != AMDTP_STATE_TX_IDLE )
-  {
-#ifdef BLE_Debug
-    debug_printf("\rData sending failed, tx state = %d\n", amdtpsCb.core.txState);
-#endif
-    return AMDTP_STATUS_BUSY;
-  }
+  eAmdtpStatus_t st = AmdtpCoreSend(&amdtpsCb.core, buf, len);
 
-  //
-  // Check if data length is valid
-  //
-  if ( len > AMDTP_MAX_PAYLOAD_SIZE )
+  if(st != AMDTP_STATUS_SUCCESS)
   {
 #ifdef BLE_Debug
-    debug_printf("\rData sending failed, exceed maximum payload, len = %d.\n", len);
-#endif
-    return AMDTP_STATUS_INVALID_PKT_LENGTH;
-  }
-  // build packet to sent
-  AmdtpBuildPkt(type, encrypted, enableACK, buf, len);
-
-  // send packet
-  AmdtpSendPacketHandler();
-
-  return AMDTP_STATUS_SUCCESS;
-}
-
-//*****************************************************************************
-//
-// sent data package. This will add the status around checks
-//
-//*****************************************************************************
-void
-AmdtpSendPacketHandler()
-{
-#ifdef BLE_Debug
-  debug_print(__func__, __FILE__, __LINE__);
-  #endif
-  
-  uint16_t transferSize = 0;
-  uint16_t remainingBytes = 0;
-  
-  amdtpPacket_t *txPkt = &amdtpsCb.core.txPkt;
-  
-  if ( amdtpsCb.core.txState == AMDTP_STATE_TX_IDLE ) {
-    txPkt->offset = 0;
-    amdtpsCb.core.txState = AMDTP_STATE_SENDING;
-
-    // send small pieces of the packet. ArduinoBLE does not seem to break down in
-    // chunks with sending with Notify. it just restricts sending to mtusize -3
-    // assumed mtusize is set during amdtp_init()
-    while (txPkt->offset < txPkt->len)
-    {
-     remainingBytes = txPkt->len - txPkt->offset;
-     transferSize = ((amdtpsCb.core.attMtuSize - 3) > remainingBytes)
-                                            ? remainingBytes
-                                            : (amdtpsCb.core.attMtuSize - 3);
-     
-     // send data packet (in amdtp_bridge.cpp)
-     SendDataPacket(&txPkt->data[txPkt->offset], transferSize);
-     txPkt->offset += transferSize;
-
-     // check whether we are done
-     if(txPkt->offset >= txPkt->len){
-      
-      // done sent packet
-      amdtpsCb.core.txState = AMDTP_STATE_WAITING_ACK;
-      return;
-     }
-
-     delay(500);  // wait 0.5 seconds between sending packets
-    }
-  }
-  else {
-#ifdef BLE_Debug
-    debug_printf("Could not send txState is not IDLE\n");
+    debug_printf("\rData sending failed, status = %d\n", st);
 #endif
+    return false;
   }
-}
-
-//***************************************************************************************
-// As we sent to String Characteristic on Artemis, we can not afford zero in the middle
-// we replace with a 0x7E + 0x20 (hopefully unique enough)
-// to be decoded on receipt first as this can also impact the CRC
-// paulvha October 2020
-//***************************************************************************************
-uint16_t decode_sent(uint8_t *value, uint16_t vlen)
-{
-  uint16_t l, ll=0;
 
-  for (l = 0; l < vlen; l++) {
-    if (value[l] == 0x0) {
-        amdtpsCb.txdecode[ll++] = 0x7E;  // SPECIAL
-        amdtpsCb.txdecode[ll++] = 0x20;  // SPECIAL
-    }
-    else
-    {
-        amdtpsCb.txdecode[ll++] = value[l];
-    }
-  }
-  return(ll);
+  return true;
 }
@@ -58,6 +58,15 @@
 //#define BLE_Debug 1
 //#define BLE_SHOW_DATA 1
 
+/* AMDTP_BULK_MODE asks the central for a short connection interval, the 2M PHY
+ * and long link layer packets while a transfer is going on, and for a long
+ * interval with latency 2 seconds after it (amdtp_link.h). It needs ArduinoBLE_P
+ * 3.3.4 or later (HCI_LINK_UPDATE), with another ArduinoBLE nothing is asked.
+ *
+ * Add // to disable
+ */
+#define AMDTP_BULK_MODE 1
+
 // set the name
 #define BLE_PERIPHERAL_NAME "Artemis AMDTP BLE"
 
@@ -90,7 +99,7 @@ extern "C"
 #define AMDTP_LENGTH_SIZE_IN_PKT        2
 #define AMDTP_HEADER_SIZE_IN_PKT        2
 #define AMDTP_CRC_SIZE_IN_PKT           4
-#define AMDTP_PREFIX_SIZE_IN_PKT        AMDTP_LENGTH_SIZE_IN_PKT + AMDTP_HEADER_SIZE_IN_PKT
+#define AMDTP_PREFIX_SIZE_IN_PKT        (AMDTP_LENGTH_SIZE_IN_PKT + AMDTP_HEADER_SIZE_IN_PKT)
 
 #define PACKET_TYPE_BIT_OFFSET          12
 #define PACKET_TYPE_BIT_MASK            (0xf << PACKET_TYPE_BIT_OFFSET)
@@ -100,6 +109,10 @@ extern "C"
 #define PACKET_ENCRYPTION_BIT_MASK      (0x1 << PACKET_ENCRYPTION_BIT_OFFSET)
 #define PACKET_ACK_BIT_OFFSET           6
 #define PACKET_ACK_BIT_MASK             (0x1 << PACKET_ACK_BIT_OFFSET)
+#define PACKET_STREAM_BIT_OFFSET        5           // part of a stream (amdtp_core.h)
+#define PACKET_STREAM_BIT_MASK          (0x1 << PACKET_STREAM_BIT_OFFSET)
+#define PACKET_COMPRESS_BIT_OFFSET      4           // data is compressed (amdtp_lz.h), added October 2026
+#define PACKET_COMPRESS_BIT_MASK        (0x1 << PACKET_COMPRESS_BIT_OFFSET)
 
 #define BYTES_TO_UINT16(n, p)     {n = ((uint16_t)(p)[0] + ((uint16_t)(p)[1] << 8));}
 #define BYTES_TO_UINT32(n, p)     {n = ((uint32_t)(p)[0] + ((uint32_t)(p)[1] << 8) + \
@@ -110,6 +123,8 @@ extern "C"
 #define ATT_DEFAULT_MTU               23        /*! Default value of ATT_MTU */
 #define ATT_MAX_MTU                   200       /*! Maximum value of ATT_MTU */
 #define ATT_DEFAULT_PAYLOAD_LEN       20        /*! Default maximum payload length for most PDUs */
+#define AMDTP_ACK_SIZE                20        /*! size of acknowledge buffers */
+
 //
 // amdtp states
 //
@@ -139,6 +154,10 @@ typedef enum eAmdtpPktType
 typedef enum eAmdtpControl
 {
     AMDTP_CONTROL_RESEND_REQ,
+    AMDTP_CONTROL_SEND_READY,       // next frame can be sent (stop-and-wait)
+    AMDTP_CONTROL_WINDOW_REQ,       // [version][window] (amdtp_core.h)
+    AMDTP_CONTROL_WINDOW_RSP,       // [version][window] agreed window, 0 is stop-and-wait
+    AMDTP_CONTROL_WINDOW_ACK,       // [sn][cumulative][bitmap 4 bytes]([sn high])
     AMDTP_CONTROL_MAX
 }eAmdtpControl_t;
 
@@ -186,60 +205,27 @@ typedef struct
 }
 amdtpPacket_t;
 
-typedef struct
-{
-    eAmdtpState_t       txState;
-    amdtpPacket_t       rxPkt;              // buffers (512 + 4+4)
-    amdtpPacket_t       txPkt;              // buffers (512 + 4+4)
-    amdtpPacket_t       ackPkt;             // buffer (20)
-    uint8_t             txPktSn;            // data packet serial number for Tx
-    uint8_t             lastRxPktSn;        // last received data packet serial number
-    uint16_t            attMtuSize;         // expected MTU size
-}
-amdtpCb_t;
-
 //*****************************************************************************
 //
 // function definitions
 //
 //*****************************************************************************
 
-void
-AmdtpBuildPkt(eAmdtpPktType_t type, bool encrypted, bool enableACK, uint8_t *buf, uint16_t len);
-
 eAmdtpStatus_t
 AmdtpReceivePkt(uint8_t handle, uint16_t len, uint8_t *pValue);
 
-void
-AmdtpSendReply( eAmdtpStatus_t status, uint8_t *data, uint16_t len);
-
-void
-AmdtpSendControl( eAmdtpControl_t control, uint8_t *data, uint16_t len);
-
-void
-AmdtpSendPacketHandler();
-
-void
-AmdtpPacketHandler(eAmdtpPktType_t type, uint16_t len, uint8_t *buf);
+void 
+amdtps_init();
 
 void
-resetPkt(amdtpPacket_t *pkt);
+amdtps_connected(uint32_t nowMs);
 
 void
-amdtpsSendAck(eAmdtpPktType_t type, bool encrypted, bool enableACK, uint8_t *buf, uint16_t len);
-
-void 
-amdtps_init();
-
-eAmdtpStatus_t
-AmdtpsSendPacket(eAmdtpPktType_t type, bool encrypted, bool enableACK, uint8_t *buf, uint16_t len);
+amdtps_poll(uint32_t nowMs);
 
 bool 
 AmdtpSendData(uint8_t *buf, uint16_t len);
 
-uint16_t 
-decode_sent(uint8_t *value, uint16_t vlen);
-
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,129 @@
+// ****************************************************************************
+//
+//  amdtp_link.c
+//! @file
+//!
+//! @brief AMDTP bulk mode, see amdtp_link.h
+//!
+//! added paulvha / October 2026
+//
+// ****************************************************************************
+
+#include <string.h>
+#include "amdtp_link.h"
+
+static const amdtpLinkParams_t bulkDefault = AMDTP_LINK_BULK_DEFAULT;
+static const amdtpLinkParams_t idleDefault = AMDTP_LINK_IDLE_DEFAULT;
+
+static void
+request(amdtpLink_t *link, eAmdtpLinkMode_t mode)
+{
+    link->mode = mode;
+
+    if (mode == AMDTP_LINK_BULK)
+    {
+        link->bulkRequests++;
+        link->request(link->user, &link->bulk, true);
+    }
+    else
+    {
+        link->idleRequests++;
+        link->request(link->user, &link->idle, false);
+    }
+}
+
+// a packet of more than one frame or a stream is sent or received
+static bool
+transfer(const amdtpCore_t *core)
+{
+    bool sending = core->txState == AMDTP_STATE_SENDING || core->txState == AMDTP_STATE_WAITING_ACK;
+
+    return core->txStreamOpen || core->rxStreamOpen || core->rxWinActive || core->rxCur == &core->rxPkt ||
+           (sending && core->txPkt.len > core->attMtuSize - 3);
+}
+
+// packets of a transfer follow each other, more apart is a new transfer
+static uint32_t
+gapMs(const amdtpLink_t *link)
+{
+    uint32_t ms = link->idle.intervalMax * 5 / 2;
+
+    return ms > 2 * AMDTP_LINK_POLL_MS ? ms : 2 * AMDTP_LINK_POLL_MS;
+}
+
+void
+AmdtpLinkInit(amdtpLink_t *link, void (*request)(void *user, const amdtpLinkParams_t *params, bool bulk),
+              void *user)
+{
+    memset(link, 0, sizeof(amdtpLink_t));
+    link->request = request;
+    link->user = user;
+    link->bulk = bulkDefault;
+    link->idle = idleDefault;
+    link->idleMs = AMDTP_LINK_IDLE_MS;
+    link->bulkPackets = AMDTP_LINK_BULK_PACKETS;
+    link->enabled = true;
+}
+
+void
+AmdtpLinkSetParams(amdtpLink_t *link, const amdtpLinkParams_t *bulk, const amdtpLinkParams_t *idle, uint32_t idleMs,
+                   uint8_t bulkPackets)
+{
+    if (bulk) link->bulk = *bulk;
+    if (idle) link->idle = *idle;
+    link->idleMs = idleMs;
+    link->bulkPackets = bulkPackets ? bulkPackets : 1;
+}
+
+void
+AmdtpLinkEnable(amdtpLink_t *link, bool enable, uint32_t nowMs)
+{
+    if (! enable && link->enabled && link->mode == AMDTP_LINK_BULK) request(link, AMDTP_LINK_IDLE);
+
+    link->enabled = enable;
+    link->lastActiveMs = nowMs;
+}
+
+void
+AmdtpLinkReset(amdtpLink_t *link, uint32_t nowMs)
+{
+    link->mode = AMDTP_LINK_UNKNOWN;
+    link->lastActiveMs = nowMs;
+    link->lastBusyMs = nowMs;
+    link->lastFrames = 0;
+    link->firstPacket = 0;
+}
+
+bool
+AmdtpLinkUpdate(amdtpLink_t *link, const amdtpCore_t *core, uint32_t nowMs)
+{
+    uint32_t frames = core->stats.framesSent + core->stats.framesReceived;
+    uint32_t packets = core->stats.packetsSent + core->stats.packetsReceived;
+    bool moved = frames != link->lastFrames;
+    bool busy = transfer(core);
+
+    link->lastFrames = frames;
+
+    if (! link->enabled) return false;
+
+    if (busy && nowMs - link->lastBusyMs > gapMs(link)) link->firstPacket = packets;
+    if (busy) link->lastBusyMs = nowMs;
+
+    // a transfer that does not move (a lost frame in stop-and-wait) is idle
+    if (moved && busy)
+    {
+        link->lastActiveMs = nowMs;
+
+        if (link->mode != AMDTP_LINK_BULK && (core->txStreamOpen || core->rxStreamOpen ||
+            packets - link->firstPacket + 1 >= link->bulkPackets))
+        {
+            request(link, AMDTP_LINK_BULK);
+        }
+    }
+    else if (link->mode != AMDTP_LINK_IDLE && nowMs - link->lastActiveMs >= link->idleMs)
+    {
+        request(link, AMDTP_LINK_IDLE);
+    }
+
+    return link->mode == AMDTP_LINK_BULK;
+}
@@ -0,0 +1,140 @@
+// ****************************************************************************
+//
+//  amdtp_lz.c
+//! @file
+//!
+//! @brief Small LZ compression for AMDTP packets, see amdtp_lz.h
+//!
+//! added paulvha / October 2026
+//
+// ****************************************************************************
+
+#include <string.h>
+#include "amdtp_lz.h"
+
+#define LZ_HASH_SIZE        (1 << AMDTP_LZ_HASH_BITS)
+
+static uint16_t
+lzHash(const uint8_t *p)
+{
+    uint32_t v = p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16;
+
+    return (uint16_t)((v * 2654435761U) >> (32 - AMDTP_LZ_HASH_BITS));
+}
+
+uint16_t
+AmdtpLzCompress(const uint8_t *in, uint16_t len, uint8_t *out, uint16_t max)
+{
+    uint16_t head[LZ_HASH_SIZE];        // last position + 1 with this hash, 0 is none
+    uint16_t pos = 0, o = 0, ctrl = 0;
+    uint16_t cand, best, n, h;
+    uint8_t bit = 8;
+
+    memset(head, 0, sizeof(head));
+
+    while (pos < len)
+    {
+        // a new group
+        if (bit == 8)
+        {
+            if (o >= max) return 0;
+            ctrl = o++;
+            out[ctrl] = 0;
+            bit = 0;
+        }
+
+        best = 0;
+        cand = 0;
+
+        if (pos + AMDTP_LZ_MIN_MATCH <= len)
+        {
+            h = lzHash(&in[pos]);
+            cand = head[h];
+            head[h] = pos + 1;
+
+            if (cand > 0 && pos - (cand - 1) <= AMDTP_LZ_MAX_OFFSET)
+            {
+                cand--;
+                n = 0;
+
+                while (pos + n < len && n < AMDTP_LZ_MAX_MATCH && in[cand + n] == in[pos + n])
+                {
+                    n++;
+                }
+
+                if (n >= AMDTP_LZ_MIN_MATCH) best = n;
+            }
+        }
+
+        if (best)
+        {
+            if (o + 2 > max) return 0;
+
+            n = pos - cand - 1;
+            out[ctrl] |= 1 << bit;
+            out[o++] = n & 0xff;
+            out[o++] = ((n >> 8) << 7) | (best - AMDTP_LZ_MIN_MATCH);
+
+            // remember the positions inside the match too
+            for (n = 1; n < best && pos + n + AMDTP_LZ_MIN_MATCH <= len; n++)
+            {
+                head[lzHash(&in[pos + n])] = pos + n + 1;
+            }
+
+            pos += best;
+        }
+        else
+        {
+            if (o >= max) return 0;
+            out[o++] = in[pos++];
+        }
+
+        bit++;
+    }
+
+    return o;
+}
+
+uint16_t
+AmdtpLzDecompress(const uint8_t *in, uint16_t len, uint8_t *out, uint16_t max)
+{
+    uint16_t i = 0, o = 0, off, n;
+    uint8_t ctrl = 0, bit = 8;
+
+    while (i < len)
+    {
+        if (bit == 8)
+        {
+            ctrl = in[i++];
+            bit = 0;
+            continue;
+        }
+
+        if (ctrl & (1 << bit))
+        {
+            if (i + 2 > len) return 0;
+
+            off = (in[i] | ((in[i + 1] >> 7) << 8)) + 1;
+            n = (in[i + 1] & 0x7f) + AMDTP_LZ_MIN_MATCH;
+            i += 2;
+
+            if (off > o || o + n > max) return 0;
+
+            // byte by byte, the match can overlap the output
+            while (n--)
+            {
+                out[o] = out[o - off];
+                o++;
+            }
+        }
+        else
+        {
+            if (o >= max) return 0;
+            out[o++] = in[i++];
+        }
+
+        bit++;
+    }
+
+    return o;
+}
@@ -29,6 +29,26 @@
   * update with different ACK and timing to improve stability
   * changed from getTempDegF to getTempDegC (new in 2.0.2)
   * CRC32 is now also define in Mbed. Included instruction in CRC32.c/ .h
+
+  paulvha / October 2026 / version 4.0
+  * the protocol is now amdtp_core.c, the same as MBED-BLE and amdtc. Larger packets
+    are sent a frame at a time, after SEND_READY from the client. Needs client 4.x
+
+  paulvha / October 2026 / version 4.1
+  * raw byte characteristics instead of String : a zero is sent as is, the 0x7E 0x20
+    escape is gone and a frame can use the full MTU. Needs client and amdtc 4.1
+
+  paulvha / October 2026 / version 4.2
+  * AMDTP_CMD_SUBSCRIBE : the server samples battery, internal temperature and BME280 at
+    the requested interval and pushes a batch of samples per packet (AMDTP_CMD_TELEMETRY,
+    amdtp_tlm.c) instead of a command round trip per value. Needs amdtc 4.3
+  * a reply that the AMDTP core can not take (busy with a batch) is sent from loop()
+
+  paulvha / October 2026 / version 4.3
+  * bulk mode (AMDTP_BULK_MODE in amdtp_common.h, amdtp_link.c) : the server asks the central
+    for a 7.5 - 15 ms interval, 2M PHY and 251 byte link layer packets from the second packet
+    of a transfer, and for 100 - 125 ms with latency 4 two seconds after it. Needs ArduinoBLE_P
+    3.3.4 or later, see MBED-BLE/extras/amdtp_sim/bulk_sim for the gain and the cost
   
   ************************************************************************************
   == BME280
@@ -74,11 +94,12 @@
 #include <ArduinoBLE.h>
 #include "amdtp_common.h"
 #include "amdtp_bridge.h"
+#include "amdtp_tlm.h"
 #include "apollo3.h"                  // needed for battery load resistor
 
 // Server version
-#define MAJOR_SERVERVERSION 3         // new features implemented that require update to client
-#define MINOR_SERVERVERSION 1         // bug fixes, better calculation / layout
+#define MAJOR_SERVERVERSION 4         // new features implemented that require update to client
+#define MINOR_SERVERVERSION 3         // bug fixes, better calculation / layout
 
 // maximum length of reply / data message
 #define MAXREPLY 100
@@ -118,15 +139,29 @@ uint8_t  *val_len  = &val[1];   // store length of optional data
 
 uint16_t TestCounter = 0;       // for testdata
 bool opt_chat = false;          // indicator for  chat
+bool ReplyPending = false;      // reply waits for the AMDTP core
+
+// telemetry subscription (AMDTP_CMD_SUBSCRIBE)
+uint8_t  TlmFields = 0;         // 0 : not subscribed
+uint16_t TlmInterval;           // ms between samples
+uint8_t  TlmSamples;            // samples per packet
+uint32_t TlmLast;               // millis() of the last sample
+uint32_t TlmMissed = 0;         // samples not taken, the batch was not sent yet
+bool     TlmFull = false;       // batch waits for the AMDTP core
+bool     TlmHeld = false;       // TlmSample waits for room in the batch
+amdtpTlmSample_t TlmSample;
+uint8_t  TlmBuf[AMDTP_TLM_MAX_SIZE + 2];
+amdtpTlmEnc_t TlmEnc;
 
 
 // BLE constructor
 BLEService AMDTP_Service(ATT_UUID_AMDTP_SERVICE);  // create service
 
 // create characteristics and allow remote device to read and write
-BLEStringCharacteristic RxChar(ATT_UUID_AMDTP_RX, BLERead | BLEWrite, 100);
-BLEStringCharacteristic TxChar(ATT_UUID_AMDTP_TX, BLERead | BLENotify, 100);
-BLEStringCharacteristic AckChar(ATT_UUID_AMDTP_ACK, BLEWrite | BLERead | BLENotify ,50);
+// raw bytes : an AMDTP frame can contain a zero (String characteristics stop there)
+BLECharacteristic RxChar(ATT_UUID_AMDTP_RX, BLERead | BLEWrite, ATT_MAX_MTU);
+BLECharacteristic TxChar(ATT_UUID_AMDTP_TX, BLERead | BLENotify, ATT_MAX_MTU);
+BLECharacteristic AckChar(ATT_UUID_AMDTP_ACK, BLEWrite | BLERead | BLENotify, AMDTP_ACK_SIZE);
 
 void setup() {
   
@@ -203,6 +238,13 @@ void loop() {
   //
   if (opt_chat) chat();
 
+  // a reply goes first, then the telemetry
+  if (ReplyPending) SendReplyClient();
+  else if (TlmFields) telemetry_loop();
+
+  // bulk mode : follow the transfers of the AMDTP core
+  amdtps_poll(millis());
+
   // poll for BLE events
   BLE.poll();
 }
@@ -450,6 +492,25 @@ void UserRequestReceived(uint8_t * buf, uint16_t len)
         *val_len = 2;
         break;
         
+     case AMDTP_CMD_SUBSCRIBE:
+
+        #ifdef BLE_SHOW_DATA
+            SERIAL_PORT.println(F("\rSubscribe telemetry"));
+        #endif
+
+        telemetry_subscribe(&buf[1], len - 1);
+        *val_len = AmdtpTlmPutSubscribe(val_data, TlmFields, TlmInterval, TlmSamples);
+        break;
+
+     case AMDTP_CMD_UNSUBSCRIBE:
+
+        #ifdef BLE_SHOW_DATA
+            SERIAL_PORT.printf("\rUnsubscribe telemetry, %u samples missed\n", TlmMissed);
+        #endif
+
+        telemetry_stop();
+        break;
+
      case AMDTP_CMD_CUSTOM1:      // repeat for other options
 
         #ifdef BLE_SHOW_DATA
@@ -620,6 +681,137 @@ void Read_BME280()
 }
 #endif //INCLUDE_BME280
 
+/**
+ * start (or change) the telemetry subscription
+ *
+ * data : [fields][interval ms MSB][LSB][samples per packet], see amdtp_tlm.h
+ * only the fields this server has are taken, the interval and samples
+ * are limited. The reply tells the client what was taken.
+ */
+void telemetry_subscribe(uint8_t *data, uint16_t len)
+{
+  uint8_t fields = 0, samples = 1;
+  uint16_t interval = 1000;
+
+  AmdtpTlmGetSubscribe(data, len, &fields, &interval, &samples);
+
+#ifdef INCLUDE_BME280
+  if (! BmeDetected) fields &= ~AMDTP_TLM_BME280;
+#else
+  fields &= ~AMDTP_TLM_BME280;
+#endif
+
+  if (interval < AMDTP_TLM_MIN_INTERVAL_MS) interval = AMDTP_TLM_MIN_INTERVAL_MS;
+  if (samples < 1) samples = 1;
+  if (samples > AMDTP_TLM_MAX_SAMPLES) samples = AMDTP_TLM_MAX_SAMPLES;
+
+  TlmFields = fields;
+  TlmInterval = interval;
+  TlmSamples = samples;
+  TlmMissed = 0;
+  TlmFull = false;
+  TlmHeld = false;
+  TlmLast = millis() - interval;        // first sample now
+
+  AmdtpTlmEncInit(&TlmEnc, &TlmBuf[2], AMDTP_TLM_MAX_SIZE, TlmFields);
+}
+
+/**
+ * stop the subscription
+ */
+void telemetry_stop()
+{
+  TlmFields = 0;
+  TlmFull = false;
+  TlmHeld = false;
+}
+
+/**
+ * called on disconnect (amdtp_bridge.cpp) : nothing is sent to the next client
+ */
+void server_disconnected()
+{
+  telemetry_stop();
+  ReplyPending = false;
+}
+
+/**
+ * take a sample of the subscribed fields
+ */
+void telemetry_sample(amdtpTlmSample_t *s)
+{
+  s->time = millis();
+
+  if (TlmFields & AMDTP_TLM_BIT(AMDTP_TLM_BATTERY))
+    s->value[AMDTP_TLM_BATTERY] = AmdtpTlmToInt(read_battery_perc());
+
+  if (TlmFields & AMDTP_TLM_BIT(AMDTP_TLM_INTERNAL))
+    s->value[AMDTP_TLM_INTERNAL] = AmdtpTlmToInt(read_Internal_temp(2));
+
+#ifdef INCLUDE_BME280
+  // always metric, the client can convert
+  if (TlmFields & AMDTP_TLM_BME280) {
+    s->value[AMDTP_TLM_TEMPERATURE] = AmdtpTlmToInt(mySensor.readTempC());
+    s->value[AMDTP_TLM_HUMIDITY] = AmdtpTlmToInt(mySensor.readFloatHumidity());
+    s->value[AMDTP_TLM_PRESSURE] = AmdtpTlmToInt(mySensor.readFloatPressure() / 100);
+    s->value[AMDTP_TLM_ALTITUDE] = AmdtpTlmToInt(mySensor.readFloatAltitudeMeters());
+  }
+#endif //INCLUDE_BME280
+}
+
+/**
+ * add the held sample, a batch without room for it is full
+ */
+void telemetry_add()
+{
+  if (! TlmHeld || TlmFull) return;
+
+  if (AmdtpTlmEncAdd(&TlmEnc, &TlmSample)) {
+    TlmHeld = false;
+    if (AmdtpTlmEncCount(&TlmEnc) >= TlmSamples) TlmFull = true;
+  }
+  else
+    TlmFull = true;                     // it goes in the next batch
+}
+
+/**
+ * called from loop() : sample when it is time and send a full batch
+ *
+ * Format sent to the client :
+ * buf [0] = AMDTP_CMD_TELEMETRY
+ * buf [1] = length of the batch
+ * buf [2] ..... the batch (amdtp_tlm.h)
+ */
+void telemetry_loop()
+{
+  if (millis() - TlmLast >= TlmInterval) {
+    TlmLast += TlmInterval;
+
+    // behind more than an interval (BLE busy) : skip, the timestamps show the gap
+    if (millis() - TlmLast >= TlmInterval) TlmLast = millis();
+
+    if (TlmHeld) TlmMissed++;           // the batch before was not sent yet
+    else {
+      memset(&TlmSample, 0, sizeof(TlmSample));
+      telemetry_sample(&TlmSample);
+      TlmHeld = true;
+      telemetry_add();
+    }
+  }
+
+  if (! TlmFull) return;
+
+  TlmBuf[0] = AMDTP_CMD_TELEMETRY;
+  TlmBuf[1] = AmdtpTlmEncLen(&TlmEnc);
+
+  // else the core is busy (the previous batch), try again on the next loop()
+  if (AmdtpSendData(TlmBuf, TlmBuf[1] + 2)) {
+    AmdtpTlmEncInit(&TlmEnc, &TlmBuf[2], AMDTP_TLM_MAX_SIZE, TlmFields);
+    TlmFull = false;
+    telemetry_add();
+  }
+}
+
 /**
  * read internal temperature value
  * @param v =
@@ -675,10 +867,10 @@ float read_battery_perc()
  */
 void SendReplyClient()
 {
-  if (! AmdtpSendData(val, *val_len + 2) ) {
+  // the core is busy with a telemetry batch : loop() tries again
+  ReplyPending = ! AmdtpSendData(val, *val_len + 2);
 
 #ifdef BLE_Debug
-    SERIAL_PORT.printf("\rFailed to sent data for client\n");
+  if (ReplyPending) SERIAL_PORT.printf("\rFailed to sent data for client, try again\n");
 #endif
-  }
 }
@@ -0,0 +1,179 @@
+// ****************************************************************************
+//
+//  amdtp_tlm.h
+//! @file
+//!
+//! @brief Batched sensor telemetry for AMDTP packets.
+//!
+//! Instead of a command round trip per value (battery, temperature, BME280 ..)
+//! the client subscribes once and the server pushes a batch of samples per
+//! AMDTP packet. A sample is a timestamp and the values of the fields of the
+//! subscription, all as integers (value x 100 : 0.01 %, 0.01 C, Pa, 0.01 m).
+//!
+//! A batch is :
+//!
+//!   [version][fields][count]
+//!   [time][value field 0][value field 1] ..     the first sample, absolute
+//!   [dt][delta field 0][delta field 1] ..       the next ones, to the previous
+//!
+//! fields is a bit per eAmdtpTlmField_t, the values are in bit order. time is
+//! the ms clock of the server, dt the ms since the previous sample (the clock
+//! may wrap). All are varints : 7 bits per byte, least significant first, bit
+//! 7 set when another byte follows. Values and deltas are zigzag coded first
+//! (0, -1, 1, -2 .. as 0, 1, 2, 3 ..), so a small change is one byte.
+//!
+//! A BME280 sample of 4 fields and 1 s apart is about 7 bytes, the first one
+//! 16. There is no state between batches : a lost packet loses its samples
+//! only.
+//!
+//! The subscribe command data is [fields][interval ms, MSB first (2)][samples
+//! per packet], the server answers with what it will do (fields it does not
+//! have left out, limits applied). The same encoder and decoder are used on
+//! the server (ble_amdtp_arduino/amdtp_server) and amdtc, copied there by
+//! extras/amdtp_sim/sync_amdtp_core.
+//!
+//! added paulvha / October 2026
+//
+// ****************************************************************************
+
+#ifndef AMDTP_TLM_H
+#define AMDTP_TLM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define AMDTP_TLM_VERSION           1
+#define AMDTP_TLM_HDR_SIZE          3
+#define AMDTP_TLM_MAX_SIZE          253     // the length of a reply is 1 byte, + command and length
+#define AMDTP_TLM_SCALE             100     // value x 100 as integer
+#define AMDTP_TLM_SUBSCRIBE_SIZE    4
+
+#define AMDTP_TLM_MIN_INTERVAL_MS   20
+#define AMDTP_TLM_MAX_SAMPLES       64
+
+typedef enum
+{
+    AMDTP_TLM_BATTERY,                  // %
+    AMDTP_TLM_INTERNAL,                 // internal temperature, C
+    AMDTP_TLM_TEMPERATURE,              // BME280, C
+    AMDTP_TLM_HUMIDITY,                 // BME280, %
+    AMDTP_TLM_PRESSURE,                 // BME280, hPa
+    AMDTP_TLM_ALTITUDE,                 // BME280, m
+    AMDTP_TLM_FIELDS
+}
+eAmdtpTlmField_t;
+
+#define AMDTP_TLM_BIT(f)            (1 << (f))
+#define AMDTP_TLM_ALL               (AMDTP_TLM_BIT(AMDTP_TLM_FIELDS) - 1)
+#define AMDTP_TLM_BME280            (AMDTP_TLM_BIT(AMDTP_TLM_TEMPERATURE) | AMDTP_TLM_BIT(AMDTP_TLM_HUMIDITY) | \
+                                     AMDTP_TLM_BIT(AMDTP_TLM_PRESSURE) | AMDTP_TLM_BIT(AMDTP_TLM_ALTITUDE))
+
+typedef struct
+{
+    uint32_t    time;                       // ms, clock of the server
+    int32_t     value[AMDTP_TLM_FIELDS];    // x AMDTP_TLM_SCALE, only the fields of the batch
+}
+amdtpTlmSample_t;
+
+typedef struct
+{
+    uint8_t             *buf;
+    uint16_t            size;
+    uint16_t            len;
+    amdtpTlmSample_t    last;
+}
+amdtpTlmEnc_t;
+
+typedef struct
+{
+    const uint8_t       *buf;
+    uint16_t            len;
+    uint16_t            pos;
+    uint8_t             fields;
+    uint8_t             count;
+    uint8_t             index;
+    amdtpTlmSample_t    last;
+}
+amdtpTlmDec_t;
+
+//*****************************************************************************
+//
+//! @brief Start a batch of the fields (bits) in buf of size bytes (at least
+//! AMDTP_TLM_HDR_SIZE, at most AMDTP_TLM_MAX_SIZE is sent in one reply).
+//
+//*****************************************************************************
+extern void AmdtpTlmEncInit(amdtpTlmEnc_t *enc, uint8_t *buf, uint16_t size, uint8_t fields);
+
+//*****************************************************************************
+//
+//! @brief Add a sample.
+//!
+//! @return false when it does not fit (or 255 samples), the batch is as before
+//
+//*****************************************************************************
+extern bool AmdtpTlmEncAdd(amdtpTlmEnc_t *enc, const amdtpTlmSample_t *s);
+
+//*****************************************************************************
+//
+//! @brief Samples in the batch and its length in bytes.
+//
+//*****************************************************************************
+extern uint8_t AmdtpTlmEncCount(const amdtpTlmEnc_t *enc);
+extern uint16_t AmdtpTlmEncLen(const amdtpTlmEnc_t *enc);
+
+//*****************************************************************************
+//
+//! @brief Start decoding a batch of len bytes.
+//!
+//! @return false if it is not a batch of this version
+//
+//*****************************************************************************
+extern bool AmdtpTlmDecInit(amdtpTlmDec_t *dec, const uint8_t *buf, uint16_t len);
+
+//*****************************************************************************
+//
+//! @brief The next sample, only the fields of dec->fields are set.
+//!
+//! @return false after the last sample, or if the batch is cut short
+//
+//*****************************************************************************
+extern bool AmdtpTlmDecNext(amdtpTlmDec_t *dec, amdtpTlmSample_t *s);
+
+//*****************************************************************************
+//
+//! @brief A value as integer (x AMDTP_TLM_SCALE, rounded) and back.
+//
+//*****************************************************************************
+extern int32_t AmdtpTlmToInt(float value);
+extern float AmdtpTlmToFloat(int32_t value);
+
+//*****************************************************************************
+//
+//! @brief Name ("battery", "temperature" ..) and unit ("%", "C" ..) of a field.
+//
+//*****************************************************************************
+extern const char *AmdtpTlmName(uint8_t field);
+extern const char *AmdtpTlmUnit(uint8_t field);
+
+//*****************************************************************************
+//
+//! @brief The data of the subscribe command (and its answer) in buf
+//! (AMDTP_TLM_SUBSCRIBE_SIZE bytes) and back.
+//!
+//! @return Put : the length. Get : false if len is too short
+//
+//*****************************************************************************
+extern uint16_t AmdtpTlmPutSubscribe(uint8_t *buf, uint8_t fields, uint16_t intervalMs, uint8_t samples);
+extern bool AmdtpTlmGetSubscribe(const uint8_t *buf, uint16_t len, uint8_t *fields, uint16_t *intervalMs,
+                                 uint8_t *samples);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AMDTP_TLM_H
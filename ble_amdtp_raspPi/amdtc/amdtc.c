@@ -35,6 +35,9 @@
 
 #include <errno.h>
 #include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
 #include <unistd.h>
 
 #include <glib.h>
@@ -52,6 +55,7 @@
 #include "amdtc.h"
 #include "src/shared/util.h"
 #include "amdtc_UI.h"
+#include "amdtc_gateway.h"
 
 /**
  * AMDTP defined information is svc_amdtp
@@ -87,6 +91,12 @@ gboolean opt_read_pin = FALSE;
 gboolean opt_pin_high = FALSE;
 gboolean opt_pin_low = FALSE;
 gboolean opt_quiet = FALSE;
+static gchar *opt_stream_file = NULL;           // save received streams
+static gboolean opt_compress = FALSE;           // compress the packets sent
+static gchar *opt_key = NULL;                   // encrypt with this key (32 hex digits)
+static gchar *opt_tlm = NULL;                   // subscribe to telemetry
+static int opt_samples = 100;                   // with opt_tlm : stop after, 0 is never
+static FILE *stream_fp = NULL;
 
 extern uint8_t GetValue;                 // which value to get next (defined in amdtc_UI.c)
 
@@ -100,48 +110,66 @@ static amdtpCb_t amdtpCb;                // the AMD transfer protocol control bl
 struct gatt_primary r_primary[MAX_PRIMARY];
 
 uint8_t g_debug = 0;                     // set verbose / debug
-uint8_t ReceivedBuf[200];                // decode
-uint16_t ReceivedLen;
-
-/*
- * As we receive bytes on a String characteristic, we can not have a zero in the middle of the
- * bytes to be received. At the sender side we translate a zero to 0x73 0x20. This routine
- * will just do the opposite and translate 0x7e 0x20 back to 0x0.
- *
- * Hope and pray that 0x7e 0x20 strings do not happen ... else we extend the decode one morestep.
+/**
+ * @brief part of a stream received from the server (added October 2026)
  */
-void encode_receipt(const uint8_t *pdu, uint16_t len)
+static void stream_received(uint8_t *buf, uint16_t len, uint32_t offset)
 {
-  char save = 0x0;
-  ReceivedLen = 0;
+    if (g_debug > 0) g_print("stream : %d bytes at offset %u\n", len, offset);
 
-  for (size_t i = 0; i < len; i++) {
+    if (stream_fp == NULL && opt_stream_file != NULL) {
 
-    char c = pdu[i];
+        // a new stream starts at offset 0
+        stream_fp = fopen(opt_stream_file, "wb");
 
-    // Header character for 0x0 ??
-    if (c == 0x7E && save == 0x0) {
-        save = 0x7E;
-        continue;
+        if (stream_fp == NULL) {
+            g_printerr("Can not open %s\n", opt_stream_file);
+            g_free(opt_stream_file);
+            opt_stream_file = NULL;
+        }
     }
 
-    // did we get a header character before
-    if (save == 0x7E){
+    if (stream_fp) fwrite(buf, 1, len, stream_fp);
+}
 
-      // if next is 0x20 then the real character was 0x0;
-      if (c == 0x20)  c = 0x0;
+/**
+ * @brief a stream was received or sent
+ */
+static void stream_done(eAmdtpStatus_t status, uint32_t len)
+{
+    if (stream_fp) {
+        fclose(stream_fp);
+        stream_fp = NULL;
+    }
 
-      // the previous 0x7E was not header, add
-      else {
-        ReceivedBuf[ReceivedLen++] = save;
-      }
+    if (status == AMDTP_STATUS_RECEIVE_DONE) {
+        if (! opt_quiet) g_print("stream of %u bytes received%s%s\n", len,
+                        opt_stream_file ? " in " : "", opt_stream_file ? opt_stream_file : "");
+    }
+    else if (status == AMDTP_STATUS_SUCCESS) {
+        if (! opt_quiet) g_print("stream of %u bytes sent\n", len);
+    }
+    else
+        g_printerr("stream failed after %u bytes, status %d\n", len, status);
+}
+
+/**
+ * @brief the key of --key : 32 hex digits to 16 bytes (added October 2026)
+ */
+static gboolean parse_key(const char *hex, uint8_t *key)
+{
+    unsigned int b;
+    int i;
+
+    if (strlen(hex) != AMDTP_CCM_KEY_SIZE * 2) return FALSE;
 
-    save = 0x0; // reset header
+    for (i = 0; i < AMDTP_CCM_KEY_SIZE; i++) {
+        if (! isxdigit(hex[i * 2]) || ! isxdigit(hex[i * 2 + 1])) return FALSE;
+        if (sscanf(&hex[i * 2], "%2x", &b) != 1) return FALSE;
+        key[i] = b;
     }
 
-    // Store real current character
-    ReceivedBuf[ReceivedLen++] = c;
-  }
+    return TRUE;
 }
 
 /**
@@ -149,29 +177,22 @@ void encode_receipt(const uint8_t *pdu, uint16_t len)
  */
 static void parseNotification(uint16_t handle, const uint8_t *pdu, uint16_t len, gpointer user_data)
 {
-    uint8_t packet[len];
     eAmdtpStatus_t res;
     uint16_t i;
 
 
     if (g_debug > 1) g_print("%s\n", __func__);
 
-    // see description
-    encode_receipt(pdu, len);
-
     if (g_debug > 0) {
         g_print("Data received : ");
-        for (i = 0; i < ReceivedLen; i++)  g_print("0x%X ", ReceivedBuf[i]);
+        for (i = 0; i < len; i++)  g_print("0x%X ", pdu[i]);
         g_print("\n");
     }
 
-    // copy as PDU is "constant" and AmdtpReceivePkt is not expecting that
-    for (i = 0 ; i < ReceivedLen; i++) packet[i] = ReceivedBuf[i];
-
-    if (handle == amdtpCb.ACK_handle)
-        res = AmdtpReceivePkt(&amdtpCb, &amdtpCb.ackPkt, ReceivedLen, packet);
-    else
-        res = AmdtpReceivePkt(&amdtpCb, &amdtpCb.rxPkt, ReceivedLen, packet);
+    // the characteristics of the server are raw bytes (version 4.1), the frame is
+    // given as is. The core only reads it, the const is for the prototype only.
+    // data or acknowledgement, the AMDTP core finds out from the packet
+    res = AmdtpReceivePkt(&amdtpCb, len, (uint8_t *) pdu);
 
     switch(res) {
         case AMDTP_STATUS_INVALID_PKT_LENGTH:
@@ -188,13 +209,10 @@ static void parseNotification(uint16_t handle, const uint8_t *pdu, uint16_t len,
             break;
 
         case AMDTP_STATUS_RECEIVE_DONE:
-            if (g_debug > 0) g_print("complete packet received\n");
-
-            // now interprete the complete package
-            // from here MainLoop call will be done for the
+            // the complete package has been handled by the AMDTP core
+            // MainLoop call will be done (in commACK_cb) for the
             // data received for user interface to handle
-
-            AmdtpPacketHandler(&amdtpCb);
+            if (g_debug > 0) g_print("complete packet received\n");
 
             return;
             break;
@@ -319,10 +337,9 @@ static void connect_cb(GIOChannel *io, GError *err, gpointer user_data)
     b_attrib = g_attrib_new(io, mtu, false);
 
     // set maximum MTU size for AMDTP
-    amdtpCb.attMtuSize = mtu;
+    AmdtpSetMtu(&amdtpCb, mtu);
 
     // indicate connected for AMDTP
-    amdtpCb.txState = AMDTP_STATE_TX_IDLE;
     amdtpCb.txReady = true;
 
     // start notification listeners
@@ -332,47 +349,6 @@ static void connect_cb(GIOChannel *io, GError *err, gpointer user_data)
     operation(b_attrib);
 }
 
-/**
- *  @brief call back from writing a command / request
- *
- * callback from characteristics_write_req()
- */
-static void char_write_req_cb(guint8 status, const guint8 *pdu, guint16 plen,
-                            gpointer user_data)
-{
-    if (g_debug > 1) g_print("%s\n", __func__);
-
-    if (status != 0) {
-        g_print("Bluetooth error\n");
-       // g_printerr("Command Write Request failed: %s\n", att_ecode2str(status));
-        goto done;
-    }
-
-    if (! dec_write_resp(pdu, plen) && !dec_exec_write_resp(pdu, plen)) {
-        g_printerr("Bluetooth Protocol error\n");
-        goto done;
-    }
-
-    // if complete packet was not sent yet, continue sending
-    if (amdtpCb.txState == AMDTP_STATE_SENDING) {
-
-        if (g_debug > 0)
-            g_print("request was written successfully. continue sending \n");
-
-            AmdtpSendPacketHandler(&amdtpCb,(GAttribResultFunc) char_write_req_cb);
-            return;
-    }
-
-    if (g_debug > 0)
-        g_print("Request was written successfully. Waiting for respond notification\n");
-
-    return;
-
-done:
-    got_error = TRUE;
-    g_main_loop_quit(event_loop);
-}
-
 /**
  * @brief write a command / request to the server
  */
@@ -394,22 +370,8 @@ gboolean characteristics_write_req(uint8_t cmd, uint8_t *buf, uint8_t len)
         return FALSE;
     }
 
-    /* Build packet
-     *
-     * amdtpCb   : control block
-     * type      : data, ack or control
-     * encrypted : encryption or not    (FALSE)
-     * enableAck : does not seem to be used (FALSE)
-     * buf       : request to sent
-     * len       : length of request to sent
-     */
-
-    AmdtpBuildPkt(&amdtpCb, AMDTP_PKT_TYPE_DATA, FALSE, FALSE, sbuf, len+1);
-
-    // sent packet and call back char_write_req_cb
-    AmdtpSendPacketHandler(&amdtpCb, (GAttribResultFunc) char_write_req_cb);
-
-    return TRUE;
+    // sent packet, the server sends SEND_READY for each next part
+    return AmdtpSendPkt(&amdtpCb, (uint8_t *) sbuf, len + 1);
 }
 
 /**
@@ -425,6 +387,14 @@ static void enable_comms_cb(guint8 status, const guint8 *pdu, guint16 plen,
         goto error;
     }
 
+    // learn the server version and window (once, this is called for each CCCD)
+    static gboolean negotiated = FALSE;
+
+    if (! negotiated) {
+        negotiated = TRUE;
+        AmdtpNegotiate(&amdtpCb);
+    }
+
     // now sent hallo to server
     if (characteristics_write_req(AMDTP_CMD_HELLO,NULL,0))  return;
 
@@ -673,6 +643,17 @@ static GOptionEntry cmd_options[] = {
         &opt_quiet, "ONLY display result", NULL },
     { "verbose", 'v', G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_INT, &g_debug,
         "Set verbose 0 = off, 1 = data only, 2 = all", NULL},
+    { "stream-file", 'S', G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_FILENAME, &opt_stream_file,
+        "Save a received stream in file", "FILE"},
+    { "compress", 'C', G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_NONE, &opt_compress,
+        "Compress the packets sent (server AMDTP version 3)", NULL},
+    { "key", 'K', G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_STRING, &opt_key,
+        "Encrypt the data with this key, as on the server (AMDTP version 4)", "32 HEX DIGITS"},
+    { "subscribe", 'T', 0, G_OPTION_ARG_STRING, &opt_tlm,
+        "The server pushes samples, FIELDS (battery,internal,bme280,temperature,humidity,pressure,altitude,all)"
+        " every MS, SAMPLES per packet (server 4.2)", "FIELDS:MS:SAMPLES"},
+    { "samples", 0, 0, G_OPTION_ARG_INT, &opt_samples,
+        "With --subscribe : stop after this many samples, 0 is never. Default: 100", "N"},
     { NULL },
 };
 
@@ -716,6 +697,9 @@ int main(int argc, char *argv[])
     g_option_context_add_group(context, cmd_group);
     g_option_group_add_entries(cmd_group, cmd_options);
 
+    /* add the gateway mode (added October 2026) */
+    g_option_context_add_group(context, gateway_option_group());
+
     // now parse the command line
     if (!g_option_context_parse(context, &argc, &argv, &gerr)) {
         g_printerr("%s\n", gerr->message);
@@ -731,6 +715,20 @@ int main(int argc, char *argv[])
         goto done;
     }
 
+    // many servers, no user interface (amdtc_gateway.c)
+    if (gateway_requested()) {
+        uint8_t key[AMDTP_CCM_KEY_SIZE];
+
+        if (opt_key && ! parse_key(opt_key, key)) {
+            g_printerr("The key must be 32 hex digits\n");
+            got_error = TRUE;
+            goto done;
+        }
+
+        got_error = ! gateway_run(opt_src, opt_sec_level, opt_mtu, opt_compress, opt_key ? key : NULL);
+        goto done;
+    }
+
     // check for ADC channel
     if (opt_adc_ch) {
         opt_adc = TRUE;
@@ -763,6 +761,13 @@ int main(int argc, char *argv[])
             opt_pin_low = 0;
     }
 
+    // telemetry subscription
+    if (opt_tlm && ! set_subscribe(opt_tlm, opt_samples)) {
+        g_printerr("Invalid --subscribe %s or --samples %d\n", opt_tlm, opt_samples);
+        got_error = TRUE;
+        goto done;
+    }
+
     // check whether any user interface commands were selected
     DetermineValue(FALSE);
 
@@ -780,6 +785,26 @@ int main(int argc, char *argv[])
         goto done;
     }
 
+    // streams from the server
+    amdtpCb.rxStreamSink = stream_received;
+    amdtpCb.streamDone = stream_done;
+
+    // only used when the server has AMDTP version 3 (learned with AmdtpNegotiate)
+    AmdtpCoreSetCompress(&amdtpCb.core, opt_compress);
+
+    // the session key is agreed with AmdtpNegotiate(), then only encrypted data
+    if (opt_key) {
+        uint8_t key[AMDTP_CCM_KEY_SIZE];
+
+        if (! parse_key(opt_key, key)) {
+            g_printerr("The key must be 32 hex digits\n");
+            got_error = TRUE;
+            goto done;
+        }
+
+        AmdtpCoreSetKey(&amdtpCb.core, key);
+    }
+
     if (g_debug > 1) g_print("Trying to Connect\n");
 
     if (opt_dst == NULL) {
@@ -789,7 +814,7 @@ int main(int argc, char *argv[])
     }
 
     chan = gatt_connect(opt_src, opt_dst, opt_dst_type, opt_sec_level,
-                    opt_psm, opt_mtu, connect_cb, &gerr);
+                    opt_psm, opt_mtu, connect_cb, NULL, &gerr);
 
     if (chan == NULL) {
         g_printerr("%s\n", gerr->message);
@@ -814,11 +839,8 @@ done:
     g_free(opt_src);
     g_free(opt_dst);
     g_free(opt_sec_level);
-
-    // allocated during init
-    g_free(amdtpCb.rxPkt.data);
-    g_free(amdtpCb.txPkt.data);
-    g_free(amdtpCb.ackPkt.data);
+    g_free(opt_stream_file);
+    if (stream_fp) fclose(stream_fp);
 
     if (got_error) exit(EXIT_FAILURE);
 
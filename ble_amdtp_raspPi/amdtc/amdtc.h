@@ -30,12 +30,40 @@
  */
 
 #include "amdtc/amdtpcommon/amdtp_common.h"
+#include "amdtc/amdtpcommon/amdtp_core.h"
 #include "amdtc_UI.h"
 
 #ifdef HAVE_CONFIG_H
 #include <config.h>
 #endif
 
+/* the AMD transfer protocol control block (amdtpcommon/amdtp_common.c) */
+typedef struct
+{
+    gboolean        txReady;               // TRUE if ready to send notifications
+    uint16_t        attMtuSize;            // MTU of the connection
+    uint16_t        TX_handle;
+    uint16_t        RX_handle;
+    uint16_t        ACK_handle;
+    uint16_t        ACK_CCChandle;
+    uint16_t        TX_CCChandle;
+    guint           ackTimer;              // no ACK from the server in time
+    guint           coreTimer;             // AmdtpCoreTimeout()
+
+    // stream receive
+    amdtp_stream_sink_func_t rxStreamSink;
+    amdtp_stream_done_func_t streamDone;
+
+    amdtpCore_t     core;
+}
+amdtpCb_t;
+
+gboolean amdtc_init(amdtpCb_t *amdtpCb);
+void AmdtpSetMtu(amdtpCb_t *amdtpCb, uint16_t mtu);
+void AmdtpNegotiate(amdtpCb_t *amdtpCb);
+eAmdtpStatus_t AmdtpReceivePkt(amdtpCb_t *amdtpCb, uint16_t len, uint8_t *pValue);
+gboolean AmdtpSendPkt(amdtpCb_t *amdtpCb, uint8_t *buf, uint16_t len);
+
 // foreward declarations
 
 GAttrib *b_attrib;
@@ -45,7 +73,7 @@ GMainLoop *event_loop;
 GIOChannel *gatt_connect(const char *src, const char *dst,
             const char *dst_type, const char *sec_level,
             int psm, int mtu, BtIOConnect connect_cb,
-            GError **gerr);
+            gpointer user_data, GError **gerr);
 
 size_t gatt_attr_data_from_string(const char *str, uint8_t **data);
 gboolean characteristics_write_req(uint8_t cmd, uint8_t *buf, uint8_t len);
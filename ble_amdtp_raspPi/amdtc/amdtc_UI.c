@@ -16,6 +16,12 @@
  * added major/minor server and client number
  *
  */
+//! paulvha / October 2026 / version 4.3
+/*
+ * subscribe to telemetry (--subscribe or selection 15) : the server pushes
+ * a batch of samples per packet (amdtp_tlm.h) instead of a command round trip
+ * per value. Needs server 4.2
+ */
 //! @{
 //
 // ****************************************************************************
@@ -65,6 +71,7 @@
 
 #include "amdtc_UI.h"
 #include "amdtc.h"
+#include "amdtc_gw.h"              // GwParseSubscribe()
 
 #include <stdlib.h>
 #include <unistd.h>
@@ -105,6 +112,18 @@ gboolean opt_chat = FALSE;
 gboolean FirstChat;
 gboolean opt_vers = FALSE;
 
+// telemetry subscription
+gboolean opt_subscribe = FALSE;     // send SUBSCRIBE
+gboolean opt_unsubscribe = FALSE;   // send UNSUBSCRIBE
+gboolean TlmActive = FALSE;         // the server pushes batches
+uint8_t  TlmFields;                 // asked for
+uint16_t TlmInterval;
+uint8_t  TlmSamples;
+int      TlmMax = 0;                // stop after this many samples, 0 is never
+int      TlmCount;                  // samples received
+int      TlmBatches;
+uint32_t TlmStart;                  // server time of the first sample
+
 
 /**
  * check for valid digital pin
@@ -391,6 +410,33 @@ void MainLoop(uint8_t *buf, uint16_t len)
             g_print("Client version: %d.%d\n",MAJOR_CLIENTVERSION, MINOR_CLIENTVERSION);
 
             break;
+        case AMDTP_CMD_SUBSCRIBE:
+            if (g_debug > 0) g_print("\nSubscribed to telemetry\n");
+
+            display_subscribe(buf, len);
+
+            // wait for the batches, the server takes the initiative
+            if (TlmActive) return;
+            break;
+
+        case AMDTP_CMD_TELEMETRY:
+            // a batch that was on its way while unsubscribing
+            if (! TlmActive) return;
+
+            display_telemetry(buf, len);
+
+            if (TlmActive) return;
+            break;                  // enough samples : unsubscribe
+
+        case AMDTP_CMD_UNSUBSCRIBE:
+            if (opt_quiet == FALSE)
+                g_print("\nTelemetry stopped : %d samples in %d packets\n", TlmCount, TlmBatches);
+            break;
+
+        case AMDTP_CMD_NONE:         // the server does not know the command
+            g_print("\nRequest not supported by the server (SUBSCRIBE needs server 4.2)\n");
+            break;
+
         case AMDTP_CMD_CUSTOM1:      // repeat for other options
              if (g_debug >0) g_print("\nAMDTP_CMD_CUSTOM1\n");
 
@@ -432,6 +478,11 @@ retry:
         if (Pin == 0) goto retry;
         ret = characteristics_write_req(GetValue, &Pin, 1);
     }
+    else if (GetValue == AMDTP_CMD_SUBSCRIBE) {
+        uint8_t data[AMDTP_TLM_SUBSCRIBE_SIZE];
+        ret = characteristics_write_req(GetValue, data,
+                        AmdtpTlmPutSubscribe(data, TlmFields, TlmInterval, TlmSamples));
+    }
     else if (GetValue == AMDTP_CMD_CHAT){
         char buf[MAX_BUF];
         if (FirstChat) g_print ("Enter: BYE to terminate chat\n");
@@ -518,6 +569,101 @@ void display_BME280(uint8_t *buf, uint16_t len)
     g_print("Altitude\t%2.2f %c\n", ret, ind);
 }
 
+/**
+ * @brief the subscription from the command line or interactive
+ * @param spec : as "bme280,battery:1000:10", see GwParseSubscribe()
+ * @param samples : stop after this many samples, 0 is never
+ *
+ * return : FALSE if spec is not valid
+ */
+gboolean set_subscribe(const char *spec, int samples)
+{
+    if (samples < 0 || ! GwParseSubscribe(spec, &TlmFields, &TlmInterval, &TlmSamples)) return FALSE;
+
+    TlmMax = samples;
+    opt_subscribe = TRUE;
+    return TRUE;
+}
+
+/**
+ * @brief display the reply on SUBSCRIBE
+ *
+ * 1 byte  original request
+ * 1 byte  len of data (4, 0 if the server does not know the command)
+ * 1 byte  fields the server will send (bits of eAmdtpTlmField_t)
+ * 2 bytes ms between samples, MSB first
+ * 1 byte  samples per packet
+ */
+void display_subscribe(uint8_t *buf, uint16_t len)
+{
+    uint8_t fields, samples, f;
+    uint16_t interval;
+
+    if (! AmdtpTlmGetSubscribe(&buf[2], buf[1], &fields, &interval, &samples) || fields == 0) {
+        g_print("\nThe server has none of the fields asked for\n");
+        return;
+    }
+
+    TlmActive = TRUE;
+    TlmCount = 0;
+    TlmBatches = 0;
+
+    if (opt_quiet) return;
+
+    g_print("\nTelemetry every %d ms, %d samples per packet :", interval, samples);
+    for (f = 0; f < AMDTP_TLM_FIELDS; f++)
+        if (fields & AMDTP_TLM_BIT(f)) g_print(" %s", AmdtpTlmName(f));
+    g_print("\n");
+
+    if (fields != TlmFields) g_print("(not all fields asked for are on the server)\n");
+}
+
+/**
+ * @brief display the samples of a batch (amdtp_tlm.h)
+ *
+ * 1 byte  AMDTP_CMD_TELEMETRY
+ * 1 byte  len of the batch
+ * the batch
+ *
+ * After TlmMax samples TlmActive is reset and UNSUBSCRIBE requested
+ */
+void display_telemetry(uint8_t *buf, uint16_t len)
+{
+    amdtpTlmDec_t dec;
+    amdtpTlmSample_t s;
+    uint8_t f;
+
+    if (len < buf[1] + 2 || ! AmdtpTlmDecInit(&dec, &buf[2], buf[1])) {
+        g_print("Invalid telemetry received\n");
+        return;
+    }
+
+    TlmBatches++;
+
+    while (AmdtpTlmDecNext(&dec, &s)) {
+        if (TlmCount++ == 0) TlmStart = s.time;
+
+        if (opt_quiet) g_print("%u", s.time - TlmStart);
+        else g_print("%9.3f s", (s.time - TlmStart) / 1000.0);
+
+        for (f = 0; f < AMDTP_TLM_FIELDS; f++) {
+            if ((dec.fields & AMDTP_TLM_BIT(f)) == 0) continue;
+
+            if (opt_quiet) g_print(",%.2f", AmdtpTlmToFloat(s.value[f]));
+            else g_print("  %s %.2f %s", AmdtpTlmName(f), AmdtpTlmToFloat(s.value[f]), AmdtpTlmUnit(f));
+        }
+        g_print("\n");
+
+        if (TlmMax && TlmCount >= TlmMax) {
+            TlmActive = FALSE;
+            opt_unsubscribe = TRUE;
+            return;
+        }
+    }
+
+    if (dec.index != dec.count) g_print("Telemetry packet cut short\n");
+}
+
 /**
  * @brief Check whether there is a request to sent to server
  * @param get : if true remove the option and return value,
@@ -533,7 +679,11 @@ void DetermineValue(gboolean get)
 {
     GetValue = AMDTP_CMD_NONE;
 
-    if (opt_TempC) {
+    if (opt_unsubscribe) {
+        if (get) opt_unsubscribe = FALSE;
+        GetValue = AMDTP_CMD_UNSUBSCRIBE;
+    }
+    else if (opt_TempC) {
         if (get) opt_TempC = FALSE;
         GetValue = AMDTP_CMD_REQ_INTERNAL_TEMP_CEL;
     }
@@ -606,6 +756,10 @@ void DetermineValue(gboolean get)
         if (get) opt_vers = FALSE;
         GetValue = AMDTP_CMD_VERSION;
     }
+    else if(opt_subscribe) {
+        if (get) opt_subscribe = FALSE;
+        GetValue = AMDTP_CMD_SUBSCRIBE;
+    }
 }
 
 /**
@@ -633,9 +787,40 @@ void display_menu()
     g_print("%d\tSet a pin HIGH\n",sel++);
     g_print("%d\tSet a pin LOW\n",sel++);
     g_print("%d\tPerform simple chat\n",sel++);
+    g_print("%d\tSubscribe to telemetry\n",sel++);
     g_print("30\tRequest server version number\n");
 }
 
+/**
+ * @brief obtain the telemetry subscription from user
+ *
+ * return : FALSE on cancel
+ */
+gboolean get_subscribe()
+{
+    char spec[MAX_BUF];
+    int samples = 0, ret;
+
+    do {
+        g_print("Fields (battery,internal,bme280,temperature,humidity,pressure,altitude or all)\n");
+        g_print("as FIELDS:MS:SAMPLES PER PACKET, e.g. bme280,battery:1000:10 (0 = cancel) : ");
+        ret = scanf("%48s", spec);
+
+        if (ret != 1 || strcmp(spec, "0") == 0) {
+            g_print("Cancel selection\n");
+            return FALSE;
+        }
+
+        g_print("Stop after how many samples : ");
+        ret = scanf("%d", &samples);
+
+        if (ret == 1 && samples > 0 && set_subscribe(spec, samples)) return TRUE;
+
+        g_print("Invalid selection\n");
+
+    } while(1);
+}
+
 /**
  * @brief read keyboard input interactive
  *
@@ -712,6 +897,9 @@ gboolean read_interactive()
                 opt_chat = TRUE;
                 FirstChat = TRUE;
                 break;
+            case 15: // telemetry
+                if (get_subscribe() == FALSE) ret = 0;
+                break;
             case 30: // Server version number
                 opt_vers = TRUE;
                 break;
@@ -60,41 +60,10 @@
 #define AMDTP_UI
 
 // version number
-#define MAJOR_CLIENTVERSION 3 // new features, changes on both server and client
-#define MINOR_CLIENTVERSION 1 // bug fixes, better calculation/ layout only impact client
+#define MAJOR_CLIENTVERSION 4 // new features, changes on both server and client
+#define MINOR_CLIENTVERSION 3 // bug fixes, better calculation/ layout only impact client
 
-/**
- * command to exchange between client and server
- *
- * This list must stay aligned with the server (BLE_amdpts)
- * it is located in BLE_amdtp.h */
-typedef enum eAmdtpcmd
-{
-    AMDTP_CMD_NONE,
-    AMDTP_CMD_START_TEST_DATA,
-    AMDTP_CMD_STOP_TEST_DATA,
-    AMDTP_CMD_HELLO,
-    AMDTP_CMD_REQ_BATTERY_LEVEL,
-    AMDTP_CMD_REQ_BATTERYLOAD_ON,
-    AMDTP_CMD_REQ_BATTERYLOAD_OFF,
-    AMDTP_CMD_REQ_INTERNAL_TEMP_CEL,
-    AMDTP_CMD_REQ_INTERNAL_TEMP_FRH,
-    AMDTP_CMD_TURN_LED_ON,
-    AMDTP_CMD_TURN_LED_OFF,
-    AMDTP_CMD_BME280,
-    AMDTP_CMD_ADC,
-    AMDTP_CMD_CHAT,
-    AMDTP_CMD_READ_PIN,
-    AMDTP_CMD_PIN_HIGH,
-    AMDTP_CMD_PIN_LOW,
-    AMDTP_CMD_VERSION,
-    AMDTP_CMD_CUSTOM1,
-    AMDTP_CMD_CUSTOM2,
-    AMDTP_CMD_CUSTOM3,
-    AMDTP_CMD_CUSTOM4,
-    AMDTP_CMD_CUSTOM5,
-    AMDTP_CMD_MAX
-}eAmdtpPktcmd_t;
+#include "amdtc_cmd.h"         // commands to exchange with the server
 
 #define MAX_BUF 50
 
@@ -116,6 +85,10 @@ gboolean read_interactive();
 //gboolean HandleRequest();
 float byte_to_float(uint8_t *buf, int x);
 void display_BME280(uint8_t *buf, uint16_t len);
+void display_subscribe(uint8_t *buf, uint16_t len);
+void display_telemetry(uint8_t *buf, uint16_t len);
+gboolean set_subscribe(const char *spec, int samples);
+gboolean get_subscribe();
 void set_terminal();
 void rst_terminal();
 int rd_keyboard();
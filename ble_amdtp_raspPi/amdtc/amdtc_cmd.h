@@ -0,0 +1,55 @@
+// ****************************************************************************
+//
+//
+//! @file  amdtc_cmd.h
+//!
+//! @brief The commands of the amdtc client to the amdtp server.
+//!
+//! Without glib, so the gateway (amdtc_gw.c) can also be compiled on a host
+//! (MBED-BLE/extras/amdtp_sim/gateway_sim).
+//!
+//! paulvha / October 2026 / version 4.2 : moved from amdtc_UI.h
+//! paulvha / October 2026 / version 4.3 : added SUBSCRIBE, UNSUBSCRIBE and TELEMETRY
+//
+// ****************************************************************************
+
+#ifndef AMDTC_CMD_H
+#define AMDTC_CMD_H
+
+/**
+ * command to exchange between client and server
+ *
+ * This list must stay aligned with the server (BLE_amdpts)
+ * it is located in BLE_amdtp.h */
+typedef enum eAmdtpcmd
+{
+    AMDTP_CMD_NONE,
+    AMDTP_CMD_START_TEST_DATA,
+    AMDTP_CMD_STOP_TEST_DATA,
+    AMDTP_CMD_HELLO,
+    AMDTP_CMD_REQ_BATTERY_LEVEL,
+    AMDTP_CMD_REQ_BATTERYLOAD_ON,
+    AMDTP_CMD_REQ_BATTERYLOAD_OFF,
+    AMDTP_CMD_REQ_INTERNAL_TEMP_CEL,
+    AMDTP_CMD_REQ_INTERNAL_TEMP_FRH,
+    AMDTP_CMD_TURN_LED_ON,
+    AMDTP_CMD_TURN_LED_OFF,
+    AMDTP_CMD_BME280,
+    AMDTP_CMD_ADC,
+    AMDTP_CMD_CHAT,
+    AMDTP_CMD_READ_PIN,
+    AMDTP_CMD_PIN_HIGH,
+    AMDTP_CMD_PIN_LOW,
+    AMDTP_CMD_VERSION,
+    AMDTP_CMD_CUSTOM1,
+    AMDTP_CMD_CUSTOM2,
+    AMDTP_CMD_CUSTOM3,
+    AMDTP_CMD_CUSTOM4,
+    AMDTP_CMD_CUSTOM5,
+    AMDTP_CMD_SUBSCRIBE,            // batched telemetry (amdtp_tlm.h), server 4.2
+    AMDTP_CMD_UNSUBSCRIBE,
+    AMDTP_CMD_TELEMETRY,            // a batch, pushed by the server
+    AMDTP_CMD_MAX
+}eAmdtpPktcmd_t;
+
+#endif // AMDTC_CMD_H
@@ -0,0 +1,767 @@
+/**
+ *  paulvha / October 2026 / version 4.2
+ *  paulvha / October 2026 / version 4.3 : --telemetry, the servers push batches of samples
+ *
+ * Gateway mode of amdtc : collect from many amdtp servers at the same time.
+ *
+ *  ./amdtc --gateway devices.txt --sink csv:/var/log/sensors.csv --poll battery,bme280
+ *
+ * One glib main loop for all servers in the device file. Each server is a
+ * gwDevice_t with its own AMDTP core (gwConn_t, amdtc_gw.c) instead of the
+ * globals and the keyboard of the interactive mode. The device file has one
+ * server per line :
+ *
+ *   C0:01:02:03:04:05 [public | random]     a server over Bluetooth
+ *   sim:/tmp/fake_periph.sock [count]       count servers of fake_periph
+ *   # a comment
+ *
+ * Bluetooth servers are connected one at a time (the controller creates one
+ * LE connection at a time), followed by the discovery of the AMDTP service and
+ * the CCCDs as in the interactive mode. A server that disconnects, does not
+ * reply in time or can not be connected is tried again after 1, 2, 4 .. 60
+ * seconds, the others continue.
+ *
+ * With --telemetry bme280,battery:1000:10 a server (4.2 or later) pushes a
+ * batch of 10 samples a packet instead of a reply per command, older servers
+ * are polled.
+ *
+ * The records go to the sink (--sink, default JSON lines on stdout), messages
+ * to stderr. SIGINT or SIGTERM stops the gateway and shows per server the
+ * connects, records, timeouts and the reply time.
+ *
+ * sim: connects over a Unix socket to MBED-BLE/extras/amdtp_sim/fake_periph,
+ * to try the gateway with dozens of servers on a Linux box without radios.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <glib.h>
+#include <glib-unix.h>
+
+#include "lib/bluetooth.h"
+#include "lib/hci.h"
+#include "lib/hci_lib.h"
+#include "lib/sdp.h"
+#include "lib/uuid.h"
+
+#include "att.h"
+#include "btio/btio.h"
+#include "gattrib.h"
+#include "gatt.h"
+#include "src/shared/util.h"
+#include "amdtc_gw.h"
+#include "amdtc_gateway.h"
+
+/* UUIDs, as in amdtc.c */
+static const char svcRxUuid[] = "00002760-08c2-11e1-9073-0e8ac72e0011";
+static const char svcTxUuid[] = "00002760-08c2-11e1-9073-0e8ac72e0012";
+static const char svcAckUuid[] = "00002760-08c2-11e1-9073-0e8ac72e0013";
+static const char amdtpSvcUuid[] = "00002760-08c2-11e1-9073-0e8ac72e1011";
+
+#define GW_CONNECT_MS       30000           // LE connect, then the next server
+#define GW_RETRY_MIN_MS     1000
+#define GW_RETRY_MAX_MS     60000
+
+typedef struct
+{
+    gwConn_t        conn;                   // AMDTP of this server
+    char            addr[GW_NAME_SIZE];     // MAC or path of the socket
+    char            addrType[8];            // public or random
+    gboolean        sim;
+    gboolean        closing;                // gw_close() is pending
+    GIOChannel      *io;
+    guint           ioWatch;
+    GAttrib         *attrib;
+    uint16_t        mtu;
+    uint16_t        TX_handle;
+    uint16_t        RX_handle;
+    uint16_t        ACK_handle;
+    uint8_t         cccdLeft;               // CCCD writes to be confirmed
+    guint           retryTimer;
+    uint32_t        retryMs;
+    uint8_t         rx[GW_SIM_MSG_SIZE * 2];    // sim : received, not complete
+    uint16_t        rxLen;
+}
+gwDevice_t;
+
+static gchar *opt_gateway = NULL;           // device file
+static gchar *opt_sink = NULL;
+static gchar *opt_poll = NULL;
+static int opt_interval = GW_INTERVAL_MS / 1000;
+static gchar *opt_telemetry = NULL;
+
+static gwDevice_t *devices;
+static int deviceCount;
+static gwConfig_t config;
+static gwSink_t sink;
+static GMainLoop *gw_loop;
+
+static GQueue connectQueue = G_QUEUE_INIT;  // Bluetooth servers waiting to connect
+static gwDevice_t *connecting;
+static guint connectTimer;
+static guint tickTimer;
+static uint64_t tickAt;
+
+static const char *gw_src;
+static const char *gw_sec_level;
+static int gw_mtu;
+
+extern uint8_t g_debug;
+extern gboolean opt_quiet;
+
+GIOChannel *gatt_connect(const char *src, const char *dst,
+            const char *dst_type, const char *sec_level,
+            int psm, int mtu, BtIOConnect connect_cb,
+            gpointer user_data, GError **gerr);
+
+static void gw_connect(gwDevice_t *dev);
+static void gw_next_connect();
+
+static uint64_t now_ms()
+{
+    return g_get_monotonic_time() / 1000;
+}
+
+//*****************************************************************************
+//
+// one timer for all servers, at the first GwConnTick() wants
+//
+//*****************************************************************************
+static gboolean gw_tick(gpointer data);
+
+static void gw_wakeup(uint32_t wait)
+{
+    uint64_t at = now_ms() + wait;
+
+    if (tickTimer && at >= tickAt) return;
+
+    if (tickTimer) g_source_remove(tickTimer);
+    tickAt = at;
+    tickTimer = g_timeout_add(wait, gw_tick, NULL);
+}
+
+static gboolean gw_tick(gpointer data)
+{
+    uint32_t wait = 1000, w;
+    int i;
+
+    tickTimer = 0;
+
+    for (i = 0; i < deviceCount; i++) {
+        w = GwConnTick(&devices[i].conn, now_ms());
+        if (w < wait) wait = w;
+    }
+
+    gw_wakeup(wait);
+    return FALSE;
+}
+
+//*****************************************************************************
+//
+// disconnect and try again later
+//
+//*****************************************************************************
+static gboolean gw_retry(gpointer data)
+{
+    gwDevice_t *dev = data;
+
+    dev->retryTimer = 0;
+    gw_connect(dev);
+
+    return FALSE;
+}
+
+static void gw_down(gwDevice_t *dev)
+{
+    GwConnDown(&dev->conn);
+
+    if (dev->ioWatch) {
+        g_source_remove(dev->ioWatch);
+        dev->ioWatch = 0;
+    }
+
+    // the GAttrib closes the socket, else (sim, connect failed) the channel
+    if (dev->attrib) {
+        g_attrib_unref(dev->attrib);
+        dev->attrib = NULL;
+    }
+    else if (dev->io)
+        g_io_channel_shutdown(dev->io, FALSE, NULL);
+
+    if (dev->io) {
+        g_io_channel_unref(dev->io);
+        dev->io = NULL;
+    }
+
+    dev->rxLen = 0;
+    dev->closing = FALSE;
+
+    if (! opt_quiet) g_printerr("%s : not connected, next try in %u s\n", dev->conn.name, dev->retryMs / 1000);
+
+    dev->retryTimer = g_timeout_add(dev->retryMs, gw_retry, dev);
+    dev->retryMs = dev->retryMs * 2 > GW_RETRY_MAX_MS ? GW_RETRY_MAX_MS : dev->retryMs * 2;
+}
+
+static gboolean gw_close_idle(gpointer data)
+{
+    gw_down(data);
+    return FALSE;
+}
+
+/**
+ * @brief close() of the link : not from within a GAttrib or core callback
+ */
+static void gw_close(void *ctx)
+{
+    gwDevice_t *dev = ctx;
+
+    if (dev->closing || dev->retryTimer) return;
+
+    dev->closing = TRUE;
+    g_idle_add(gw_close_idle, dev);
+}
+
+/**
+ * @brief the link is ready : start AMDTP
+ */
+static void gw_up(gwDevice_t *dev, uint16_t mtu)
+{
+    if (! opt_quiet) g_printerr("%s : connected, MTU %d\n", dev->conn.name, mtu);
+
+    dev->retryMs = GW_RETRY_MIN_MS;
+    GwConnUp(&dev->conn, mtu, now_ms());
+    gw_wakeup(GwConnTick(&dev->conn, now_ms()));
+}
+
+//*****************************************************************************
+//
+// Bluetooth link
+//
+//*****************************************************************************
+static void gw_write_cb(guint8 status, const guint8 *pdu, guint16 plen, gpointer user_data)
+{
+    gwDevice_t *dev = user_data;
+
+    if (status != 0) {
+        g_printerr("%s : write failed: %s\n", dev->conn.name, att_ecode2str(status));
+        gw_close(dev);
+    }
+}
+
+static bool gw_ble_write(void *ctx, const uint8_t *buf, uint16_t len)
+{
+    gwDevice_t *dev = ctx;
+
+    if (dev->attrib == NULL) return false;
+
+    // data, ACK and control all on TX, as amdtpcommon/amdtp_common.c
+    return gatt_write_char(dev->attrib, dev->TX_handle, buf, len, gw_write_cb, dev) != 0;
+}
+
+static const gwLink_t bleLink = { gw_ble_write, gw_close };
+
+static void gw_notify(const uint8_t *pdu, uint16_t len, gpointer user_data)
+{
+    gwDevice_t *dev = user_data;
+    uint16_t handle;
+
+    if (len < 3 || pdu[0] != ATT_OP_HANDLE_NOTIFY) return;
+
+    handle = get_le16(&pdu[1]);
+    if (handle != dev->RX_handle && handle != dev->ACK_handle) return;
+
+    if (g_debug > 1) g_printerr("%s : %d bytes on 0x%04x\n", dev->conn.name, len - 3, handle);
+
+    GwConnFrame(&dev->conn, (uint8_t *) &pdu[3], len - 3, now_ms());
+    gw_wakeup(GwConnTick(&dev->conn, now_ms()));
+}
+
+static void gw_cccd_cb(guint8 status, const guint8 *pdu, guint16 plen, gpointer user_data)
+{
+    gwDevice_t *dev = user_data;
+
+    if (status != 0) {
+        g_printerr("%s : enable notifications failed: %s\n", dev->conn.name, att_ecode2str(status));
+        gw_close(dev);
+        return;
+    }
+
+    if (--dev->cccdLeft == 0) gw_up(dev, dev->mtu);
+}
+
+static void gw_char_cb(uint8_t status, GSList *ranges, void *user_data)
+{
+    gwDevice_t *dev = user_data;
+    uint8_t value[2] = { 0x01, 0x00 };      // enable notification
+    uint8_t t = 0;
+    GSList *l;
+
+    if (dev->attrib == NULL) return;
+
+    if (status) {
+        g_printerr("%s : discover characteristics failed: %s\n", dev->conn.name, att_ecode2str(status));
+        gw_close(dev);
+        return;
+    }
+
+    for (l = ranges; l; l = l->next) {
+        struct gatt_char *range = l->data;
+
+        // RX of the server is TX for us and the other way around
+        if (strcmp(range->uuid, svcRxUuid) == 0) {
+            dev->TX_handle = range->value_handle;
+            t++;
+        }
+        else if (strcmp(range->uuid, svcTxUuid) == 0) {
+            dev->RX_handle = range->value_handle;
+            t++;
+        }
+        else if (strcmp(range->uuid, svcAckUuid) == 0) {
+            dev->ACK_handle = range->value_handle;
+            t++;
+        }
+    }
+
+    if (t != 3) {
+        g_printerr("%s : could not get all the handles\n", dev->conn.name);
+        gw_close(dev);
+        return;
+    }
+
+    // the CCCD follows the value handle
+    dev->cccdLeft = 2;
+    gatt_write_char(dev->attrib, dev->RX_handle + 1, value, 2, gw_cccd_cb, dev);
+    gatt_write_char(dev->attrib, dev->ACK_handle + 1, value, 2, gw_cccd_cb, dev);
+}
+
+static void gw_primary_cb(uint8_t status, GSList *services, void *user_data)
+{
+    gwDevice_t *dev = user_data;
+    GSList *l;
+
+    if (dev->attrib == NULL) return;
+
+    if (status) {
+        g_printerr("%s : discover primary services failed: %s\n", dev->conn.name, att_ecode2str(status));
+        gw_close(dev);
+        return;
+    }
+
+    for (l = services; l; l = l->next) {
+        struct gatt_primary *prim = l->data;
+
+        if (strcmp(prim->uuid, amdtpSvcUuid) == 0) {
+            gatt_discover_char(dev->attrib, prim->range.start, prim->range.end, NULL, gw_char_cb, dev);
+            return;
+        }
+    }
+
+    g_printerr("%s : AMDTP service not found\n", dev->conn.name);
+    gw_close(dev);
+}
+
+static gboolean gw_hup(GIOChannel *io, GIOCondition cond, gpointer user_data)
+{
+    gwDevice_t *dev = user_data;
+
+    dev->ioWatch = 0;
+    gw_down(dev);
+
+    return FALSE;
+}
+
+static void gw_connect_cb(GIOChannel *io, GError *err, gpointer user_data)
+{
+    gwDevice_t *dev = user_data;
+    GError *gerr = NULL;
+    uint16_t mtu, cid;
+
+    // given up by gw_connect_timeout()
+    if (dev != connecting || io != dev->io) return;
+
+    if (connectTimer) g_source_remove(connectTimer);
+    connectTimer = 0;
+    connecting = NULL;
+
+    if (err) {
+        g_printerr("%s : %s\n", dev->conn.name, err->message);
+        gw_down(dev);
+        gw_next_connect();
+        return;
+    }
+
+    bt_io_get(io, &gerr, BT_IO_OPT_IMTU, &mtu, BT_IO_OPT_CID, &cid, BT_IO_OPT_INVALID);
+
+    if (gerr) {
+        g_error_free(gerr);
+        mtu = ATT_DEFAULT_LE_MTU;
+    }
+
+    if (cid == ATT_CID) mtu = ATT_DEFAULT_LE_MTU;
+
+    dev->mtu = mtu;
+    dev->attrib = g_attrib_new(io, mtu, false);
+    g_attrib_register(dev->attrib, ATT_OP_HANDLE_NOTIFY, GATTRIB_ALL_HANDLES, gw_notify, dev, NULL);
+    dev->ioWatch = g_io_add_watch(io, G_IO_HUP | G_IO_ERR | G_IO_NVAL, gw_hup, dev);
+
+    gatt_discover_primary(dev->attrib, NULL, gw_primary_cb, dev);
+
+    gw_next_connect();
+}
+
+static gboolean gw_connect_timeout(gpointer data)
+{
+    gwDevice_t *dev = data;
+
+    connectTimer = 0;
+    connecting = NULL;
+
+    g_printerr("%s : no connection\n", dev->conn.name);
+    gw_down(dev);
+    gw_next_connect();
+
+    return FALSE;
+}
+
+/**
+ * @brief connect the next Bluetooth server that waits
+ */
+static void gw_next_connect()
+{
+    GError *gerr = NULL;
+    gwDevice_t *dev;
+
+    while (connecting == NULL && (dev = g_queue_pop_head(&connectQueue)) != NULL) {
+
+        if (g_debug > 0) g_printerr("%s : connecting\n", dev->conn.name);
+
+        dev->io = gatt_connect(gw_src, dev->addr, dev->addrType, gw_sec_level,
+                               0, gw_mtu, gw_connect_cb, dev, &gerr);
+
+        if (dev->io == NULL) {
+            g_printerr("%s : %s\n", dev->conn.name, gerr->message);
+            g_clear_error(&gerr);
+            gw_down(dev);
+            continue;
+        }
+
+        connecting = dev;
+        connectTimer = g_timeout_add(GW_CONNECT_MS, gw_connect_timeout, dev);
+    }
+}
+
+//*****************************************************************************
+//
+// sim link : Unix socket to fake_periph
+//
+//*****************************************************************************
+static bool gw_sim_write(void *ctx, const uint8_t *buf, uint16_t len)
+{
+    gwDevice_t *dev = ctx;
+    uint8_t msg[GW_SIM_MSG_SIZE];
+    uint16_t n;
+
+    if (dev->io == NULL || len > 255) return false;
+
+    n = GwSimMessage(msg, GW_SIM_FRAME, buf, len);
+
+    // full : the core tries again
+    return send(g_io_channel_unix_get_fd(dev->io), msg, n, MSG_DONTWAIT | MSG_NOSIGNAL) == n;
+}
+
+static const gwLink_t simLink = { gw_sim_write, gw_close };
+
+static void gw_sim_msg(void *ctx, uint8_t type, uint8_t *data, uint8_t len)
+{
+    gwDevice_t *dev = ctx;
+
+    if (dev->closing) return;
+
+    if (type == GW_SIM_MTU && len == 2) {
+        gw_up(dev, data[0] | data[1] << 8);
+        return;
+    }
+
+    if (type == GW_SIM_FRAME) {
+        GwConnFrame(&dev->conn, data, len, now_ms());
+        gw_wakeup(GwConnTick(&dev->conn, now_ms()));
+    }
+}
+
+static gboolean gw_sim_read(GIOChannel *io, GIOCondition cond, gpointer user_data)
+{
+    gwDevice_t *dev = user_data;
+    ssize_t n;
+
+    n = read(g_io_channel_unix_get_fd(io), &dev->rx[dev->rxLen], sizeof(dev->rx) - dev->rxLen);
+
+    if (n < 0 && (errno == EAGAIN || errno == EINTR)) return TRUE;
+
+    if (n <= 0) {
+        dev->ioWatch = 0;
+        gw_down(dev);
+        return FALSE;
+    }
+
+    dev->rxLen += n;
+    GwSimParse(dev->rx, &dev->rxLen, gw_sim_msg, dev);
+
+    return TRUE;
+}
+
+static void gw_sim_connect(gwDevice_t *dev)
+{
+    struct sockaddr_un addr;
+    uint16_t mtu = gw_mtu ? gw_mtu : ATT_DEFAULT_LE_MTU;
+    uint8_t m[2] = { mtu & 0xff, mtu >> 8 };
+    uint8_t msg[GW_SIM_MSG_SIZE];
+    int fd;
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, dev->addr, sizeof(addr.sun_path) - 1);
+
+    if (fd < 0 || connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        if (g_debug > 0) g_printerr("%s : %s\n", dev->conn.name, strerror(errno));
+        if (fd >= 0) close(fd);
+        gw_down(dev);
+        return;
+    }
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    dev->io = g_io_channel_unix_new(fd);
+    g_io_channel_set_close_on_unref(dev->io, TRUE);
+    dev->ioWatch = g_io_add_watch(dev->io, G_IO_IN | G_IO_HUP | G_IO_ERR, gw_sim_read, dev);
+
+    // the MTU exchange, fake_periph answers with the MTU of the connection
+    send(fd, msg, GwSimMessage(msg, GW_SIM_MTU, m, 2), MSG_NOSIGNAL);
+}
+
+//*****************************************************************************
+//
+// the gateway
+//
+//*****************************************************************************
+static void gw_connect(gwDevice_t *dev)
+{
+    if (dev->sim) {
+        gw_sim_connect(dev);
+        return;
+    }
+
+    g_queue_push_tail(&connectQueue, dev);
+    gw_next_connect();
+}
+
+/**
+ * @brief read the device file : MAC [public | random] or sim:PATH [count]
+ */
+static gboolean gw_read_devices(const char *file)
+{
+    gchar *contents, **lines;
+    char addr[GW_NAME_SIZE], arg[16], name[GW_NAME_SIZE];
+    GError *gerr = NULL;
+    gboolean ok = TRUE;
+    int pass, i, n, c, count;
+    bdaddr_t ba;
+
+    if (! g_file_get_contents(file, &contents, NULL, &gerr)) {
+        g_printerr("%s\n", gerr->message);
+        g_clear_error(&gerr);
+        return FALSE;
+    }
+
+    lines = g_strsplit(contents, "\n", -1);
+    g_free(contents);
+
+    // count first, the devices do not move once the cores point at them
+    for (pass = 0; pass < 2 && ok; pass++) {
+
+        if (pass == 1) devices = g_new0(gwDevice_t, deviceCount);
+        deviceCount = 0;
+
+        for (i = 0; lines[i] && ok; i++) {
+
+            g_strstrip(lines[i]);
+            if (lines[i][0] == 0 || lines[i][0] == '#') continue;
+
+            n = sscanf(lines[i], "%63s %15s", addr, arg);
+
+            if (strncmp(addr, "sim:", 4) == 0) {
+                count = n == 2 ? atoi(arg) : 1;
+                if (count < 1 || strlen(addr + 4) >= sizeof(((struct sockaddr_un *) 0)->sun_path)) ok = FALSE;
+            }
+            else {
+                count = 1;
+                if (str2ba(addr, &ba) < 0 || bachk(addr) < 0) ok = FALSE;
+                if (n == 2 && strcmp(arg, "public") != 0 && strcmp(arg, "random") != 0) ok = FALSE;
+            }
+
+            if (! ok) {
+                g_printerr("%s line %d : %s ?\n", file, i + 1, lines[i]);
+                break;
+            }
+
+            for (c = 0; c < count; c++, deviceCount++) {
+                gwDevice_t *dev;
+
+                if (pass == 0) continue;
+
+                dev = &devices[deviceCount];
+
+                if (strncmp(addr, "sim:", 4) == 0) {
+                    dev->sim = TRUE;
+                    strcpy(dev->addr, addr + 4);
+                    if (count > 1) snprintf(name, sizeof(name), "%s#%d", addr, c + 1);
+                    else strcpy(name, addr);
+                    GwConnInit(&dev->conn, name, &config, &sink, &simLink, dev);
+                }
+                else {
+                    strcpy(dev->addr, addr);
+                    strcpy(dev->addrType, n == 2 ? arg : "public");
+                    GwConnInit(&dev->conn, addr, &config, &sink, &bleLink, dev);
+                }
+
+                dev->retryMs = GW_RETRY_MIN_MS;
+            }
+        }
+    }
+
+    g_strfreev(lines);
+
+    if (ok && deviceCount == 0) {
+        g_printerr("%s : no servers\n", file);
+        ok = FALSE;
+    }
+
+    return ok;
+}
+
+static gboolean gw_quit(gpointer data)
+{
+    g_main_loop_quit(gw_loop);
+    return G_SOURCE_REMOVE;
+}
+
+static void gw_show_stats()
+{
+    gwStats_t *s;
+    int i;
+
+    g_printerr("%-32s %8s %8s %8s %8s %8s %8s\n", "server", "connects", "records", "timeouts",
+               "errors", "avg ms", "max ms");
+
+    for (i = 0; i < deviceCount; i++) {
+        s = &devices[i].conn.stats;
+        g_printerr("%-32s %8u %8u %8u %8u %8u %8u\n", devices[i].conn.name, s->connects, s->records,
+                   s->timeouts, s->errors, s->polled ? (unsigned) (s->latencySumMs / s->polled) : 0,
+                   s->latencyMaxMs);
+    }
+
+    g_printerr("%u records written, %u dropped by the sink\n", sink.written, sink.dropped);
+}
+
+static GOptionEntry gateway_options[] = {
+    { "gateway", 'G', G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_FILENAME, &opt_gateway,
+        "Collect from the servers in FILE, no user interface", "FILE" },
+    { "sink", 0, 0, G_OPTION_ARG_STRING, &opt_sink,
+        "Write the records as json[:FILE], csv[:FILE] or unix:PATH. Default: json", "SINK" },
+    { "poll", 0, 0, G_OPTION_ARG_STRING, &opt_poll,
+        "Commands of each round. Default: battery,tempC",
+        "battery,tempC,tempF,bme280,version,adc:CH,pin:PIN" },
+    { "interval", 0, 0, G_OPTION_ARG_INT, &opt_interval,
+        "Seconds between the rounds. Default: 10", "SEC" },
+    { "telemetry", 0, 0, G_OPTION_ARG_STRING, &opt_telemetry,
+        "Subscribe instead of polling : FIELDS (battery,internal,bme280,temperature,humidity,pressure,altitude,all),"
+        " ms between the samples and samples per packet. Default ms 1000, samples 10", "FIELDS[:MS[:SAMPLES]]" },
+    { NULL },
+};
+
+GOptionGroup *gateway_option_group()
+{
+    GOptionGroup *group;
+
+    group = g_option_group_new("gateway", "gateway mode",
+                    "Show the gateway options", NULL, NULL);
+    g_option_group_add_entries(group, gateway_options);
+
+    return group;
+}
+
+gboolean gateway_requested()
+{
+    return opt_gateway != NULL;
+}
+
+gboolean gateway_run(const char *src, const char *sec_level, int mtu,
+                     gboolean compress, const uint8_t *key)
+{
+    int i;
+
+    gw_src = src;
+    gw_sec_level = sec_level;
+    gw_mtu = mtu;
+
+    memset(&config, 0, sizeof(config));
+    config.intervalMs = opt_interval * 1000;
+    config.replyMs = GW_REPLY_MS;
+    config.compress = compress;
+
+    if (key) {
+        config.keySet = true;
+        memcpy(config.key, key, AMDTP_CCM_KEY_SIZE);
+    }
+
+    if (opt_interval < 1 || ! GwConfigPoll(&config, opt_poll ? opt_poll : "battery,tempC")) {
+        g_printerr("Invalid --poll or --interval\n");
+        return FALSE;
+    }
+
+    if (opt_telemetry && ! GwConfigSubscribe(&config, opt_telemetry)) {
+        g_printerr("Invalid --telemetry %s\n", opt_telemetry);
+        return FALSE;
+    }
+
+    if (! GwSinkOpen(&sink, opt_sink ? opt_sink : "json")) {
+        g_printerr("Can not open sink %s\n", opt_sink);
+        return FALSE;
+    }
+
+    if (! gw_read_devices(opt_gateway)) {
+        GwSinkClose(&sink);
+        return FALSE;
+    }
+
+    if (! opt_quiet) g_printerr("gateway : %d servers\n", deviceCount);
+
+    gw_loop = g_main_loop_new(NULL, FALSE);
+    g_unix_signal_add(SIGINT, gw_quit, NULL);
+    g_unix_signal_add(SIGTERM, gw_quit, NULL);
+
+    for (i = 0; i < deviceCount; i++) gw_connect(&devices[i]);
+
+    gw_wakeup(1000);
+    g_main_loop_run(gw_loop);
+
+    if (! opt_quiet) gw_show_stats();
+
+    GwSinkClose(&sink);
+    g_main_loop_unref(gw_loop);
+
+    return TRUE;
+}
@@ -0,0 +1,24 @@
+/**
+ * paulvha / October 2026 / version 4.2
+ *
+ * Gateway mode of amdtc : collect from many amdtp servers at the same time,
+ * without the user interface. See amdtc_gateway.c
+ */
+
+#ifndef AMDTC_GATEWAY_H
+#define AMDTC_GATEWAY_H
+
+#include <glib.h>
+#include <stdint.h>
+
+/* the options --gateway, --sink, --poll, --interval and --telemetry */
+GOptionGroup *gateway_option_group();
+
+/* TRUE if --gateway FILE was given */
+gboolean gateway_requested();
+
+/* runs until SIGINT / SIGTERM, FALSE on an error in the options or the device file */
+gboolean gateway_run(const char *src, const char *sec_level, int mtu,
+                     gboolean compress, const uint8_t *key);
+
+#endif // AMDTC_GATEWAY_H
@@ -0,0 +1,499 @@
+// ****************************************************************************
+//
+//
+//! @file  amdtc_gw.c
+//!
+//! @brief One server (sensor) of the gateway mode, see amdtc_gw.h
+//!
+//! paulvha / October 2026 / version 4.2
+//! paulvha / October 2026 / version 4.3 : subscribe to telemetry
+//
+// ****************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/random.h>
+
+#include "amdtc_cmd.h"
+#include "amdtc_gw.h"
+
+#define GW_RETRY_MS     10          // core busy, try the command again
+#define GW_NEGOTIATE_MS 1000        // no answer on the negotiate, again
+#define GW_NEGOTIATE_MAX 3          // then HELLO without, a server before version 4.0
+
+//*****************************************************************************
+//
+// negotiate the window, version and session key (again)
+//
+//*****************************************************************************
+static void negotiate(gwConn_t *conn)
+{
+    conn->negotiatedAt = conn->now;
+    conn->negotiations++;
+    AmdtpCoreNegotiate(&conn->core);
+}
+
+//*****************************************************************************
+//
+// send HELLO, SUBSCRIBE or the next poll command
+//
+//*****************************************************************************
+static void send_next(gwConn_t *conn)
+{
+    uint8_t buf[1 + AMDTP_TLM_SUBSCRIBE_SIZE];
+    uint16_t len = 1;
+    const gwPoll_t *p;
+
+    if (conn->state == GW_STATE_HELLO) {
+        // HELLO in the window mode, a lost frame in stop-and-wait is not sent again
+        if (conn->core.peerVersion == 0 && conn->negotiations < GW_NEGOTIATE_MAX) {
+            if (conn->now >= conn->negotiatedAt + GW_NEGOTIATE_MS) negotiate(conn);
+            return;
+        }
+        buf[0] = AMDTP_CMD_HELLO;
+    }
+    else if (conn->state == GW_STATE_SUBSCRIBE) {
+        buf[0] = AMDTP_CMD_SUBSCRIBE;
+        len += AmdtpTlmPutSubscribe(&buf[1], conn->cfg->tlmFields, conn->cfg->tlmIntervalMs,
+                                    conn->cfg->tlmSamples);
+    }
+    else {
+        p = &conn->cfg->poll[conn->pollNext];
+        buf[0] = p->cmd;
+        if (p->hasArg) buf[len++] = p->arg;
+    }
+
+    // busy (the previous packet) or no session key yet : on the next tick
+    switch (AmdtpCoreSend(&conn->core, buf, len)) {
+        case AMDTP_STATUS_SUCCESS:
+            break;
+
+        case AMDTP_STATUS_TX_NOT_READY:
+            // the negotiate is not acknowledged, the request or reply was lost
+            if (conn->now >= conn->negotiatedAt + GW_NEGOTIATE_MS) negotiate(conn);
+            return;
+
+        default:
+            return;
+    }
+
+    conn->pollPending = false;
+    conn->sentAt = conn->now;
+    conn->replyBy = conn->now + conn->cfg->replyMs;
+}
+
+//*****************************************************************************
+//
+// the samples of a telemetry batch to the sink
+//
+//*****************************************************************************
+static void telemetry(gwConn_t *conn, uint8_t *buf, uint16_t len)
+{
+    amdtpTlmDec_t dec;
+    amdtpTlmSample_t s[AMDTP_TLM_MAX_SIZE / 2];
+    gwRecord_t rec;
+    uint8_t n = 0, i;
+
+    if (len < 2 || len < buf[1] + 2 || ! AmdtpTlmDecInit(&dec, &buf[2], buf[1])) {
+        conn->stats.errors++;
+        return;
+    }
+
+    while (n < sizeof(s) / sizeof(s[0]) && AmdtpTlmDecNext(&dec, &s[n])) n++;
+
+    if (n != dec.count) conn->stats.errors++;
+
+    conn->stats.batches++;
+    conn->stats.batchBytes += buf[1];
+
+    // the last sample was taken just before the batch was sent
+    for (i = 0; i < n; i++) {
+        if (! GwRecordSample(&rec, conn->name, dec.fields, &s[i], s[n - 1].time - s[i].time)) continue;
+        conn->stats.records++;
+        if (conn->sink) GwSinkWrite(conn->sink, &rec);
+    }
+}
+
+// no batch in this time : the link is gone
+static uint32_t stream_wait(const gwConn_t *conn, uint16_t intervalMs, uint8_t samples)
+{
+    return (uint32_t) intervalMs * samples + conn->cfg->replyMs;
+}
+
+//*****************************************************************************
+//
+// core callbacks
+//
+//*****************************************************************************
+static bool gwCoreSend(void *user, eAmdtpPktType_t type, uint8_t *buf, uint16_t len)
+{
+    gwConn_t *conn = user;
+
+    if (conn->state == GW_STATE_DOWN || ! conn->link->write(conn->linkCtx, buf, len)) return false;
+
+    conn->stats.frames++;
+    return true;
+}
+
+static void gwCoreReceived(void *user, uint8_t *buf, uint16_t len)
+{
+    gwConn_t *conn = user;
+    gwRecord_t rec;
+    uint32_t latency;
+
+    uint8_t fields, samples;
+    uint16_t intervalMs;
+
+    conn->stats.replies++;
+
+    if (len > 0 && buf[0] == AMDTP_CMD_TELEMETRY) {
+        telemetry(conn, buf, len);
+        if (conn->state == GW_STATE_STREAM)
+            conn->replyBy = conn->now + stream_wait(conn, conn->streamIntervalMs, conn->streamSamples);
+        return;
+    }
+
+    if (GwRecordDecode(&rec, conn->name, buf, len)) {
+        conn->stats.records++;
+        if (conn->sink) GwSinkWrite(conn->sink, &rec);
+    }
+
+    if (conn->state == GW_STATE_HELLO) {
+        if (buf[0] != AMDTP_CMD_HELLO) return;
+
+        if (conn->cfg->tlmFields) {
+            conn->state = GW_STATE_SUBSCRIBE;
+            conn->pollPending = true;
+        }
+        else {
+            conn->state = GW_STATE_IDLE;
+            conn->nextRound = conn->now;
+        }
+    }
+    else if (conn->state == GW_STATE_SUBSCRIBE) {
+        // a server before 4.2 answers AMDTP_CMD_NONE : poll it
+        if (len > 1 && buf[0] == AMDTP_CMD_SUBSCRIBE &&
+            AmdtpTlmGetSubscribe(&buf[2], buf[1], &fields, &intervalMs, &samples) && fields)
+        {
+            conn->state = GW_STATE_STREAM;
+            conn->streamIntervalMs = intervalMs;
+            conn->streamSamples = samples;
+            conn->replyBy = conn->now + stream_wait(conn, intervalMs, samples);
+            return;
+        }
+
+        if (buf[0] != AMDTP_CMD_SUBSCRIBE && buf[0] != AMDTP_CMD_NONE) return;
+
+        fprintf(stderr, "%s : no telemetry, polled\n", conn->name);
+        conn->state = GW_STATE_IDLE;
+        conn->nextRound = conn->now;
+    }
+    else if (conn->state == GW_STATE_POLL) {
+        if (buf[0] != conn->cfg->poll[conn->pollNext].cmd) return;
+
+        latency = conn->now - conn->sentAt;
+        conn->stats.polled++;
+        conn->stats.latencySumMs += latency;
+        if (latency > conn->stats.latencyMaxMs) conn->stats.latencyMaxMs = latency;
+
+        if (++conn->pollNext < conn->cfg->pollCount) {
+            conn->pollPending = true;       // sent after AmdtpCoreReceive() returns
+        }
+        else {
+            conn->state = GW_STATE_IDLE;
+        }
+    }
+    else
+        return;
+
+    conn->replyBy = 0;
+}
+
+static void gwCoreSent(void *user, eAmdtpStatus_t status)
+{
+    gwConn_t *conn = user;
+
+    // the reply will not come, replyBy closes the link
+    if (status != AMDTP_STATUS_SUCCESS) conn->stats.errors++;
+}
+
+static void gwCoreTimer(void *user, uint32_t ms)
+{
+    gwConn_t *conn = user;
+
+    conn->coreTimerAt = ms ? conn->now + ms : 0;
+}
+
+static void gwCoreRandom(void *user, uint8_t *buf, uint16_t len)
+{
+    if (getrandom(buf, len, 0) != len)
+        fprintf(stderr, "no random for the session key\n");
+}
+
+//*****************************************************************************
+//
+// connection
+//
+//*****************************************************************************
+void GwConnInit(gwConn_t *conn, const char *name, const gwConfig_t *cfg, gwSink_t *sink,
+                const gwLink_t *link, void *linkCtx)
+{
+    amdtpCoreCallbacks_t cb = {0};
+
+    memset(conn, 0, sizeof(gwConn_t));
+    snprintf(conn->name, sizeof(conn->name), "%s", name);
+    conn->cfg = cfg;
+    conn->sink = sink;
+    conn->link = link;
+    conn->linkCtx = linkCtx;
+    conn->state = GW_STATE_DOWN;
+
+    cb.send = gwCoreSend;
+    cb.received = gwCoreReceived;
+    cb.sent = gwCoreSent;
+    cb.timer = gwCoreTimer;
+    cb.random = gwCoreRandom;
+    cb.user = conn;
+
+    AmdtpCoreSetCallbacks(&conn->core, &cb);
+    AmdtpCoreSetCompress(&conn->core, cfg->compress);
+    if (cfg->keySet) AmdtpCoreSetKey(&conn->core, cfg->key);
+}
+
+void GwConnUp(gwConn_t *conn, uint16_t mtu, uint64_t now)
+{
+    conn->now = now;
+
+    // a new connection starts a new session, the settings are kept
+    AmdtpCoreInit(&conn->core);
+    AmdtpCoreSetMtu(&conn->core, mtu);
+
+    conn->stats.connects++;
+    conn->state = GW_STATE_HELLO;
+    conn->pollNext = 0;
+    conn->pollPending = true;
+
+    // learn the version and window of the server, then HELLO as amdtc does
+    conn->negotiations = 0;
+    negotiate(conn);
+    send_next(conn);
+}
+
+void GwConnFrame(gwConn_t *conn, uint8_t *buf, uint16_t len, uint64_t now)
+{
+    eAmdtpStatus_t status;
+
+    if (conn->state == GW_STATE_DOWN) return;
+
+    conn->now = now;
+    conn->stats.frames++;
+    status = AmdtpCoreReceive(&conn->core, buf, len);
+
+    if (status == AMDTP_STATUS_CRC_ERROR || status == AMDTP_STATUS_INSUFFICIENT_BUFFER ||
+        status == AMDTP_STATUS_INVALID_PKT_LENGTH)
+        conn->stats.errors++;
+
+    // the next command of the round, not from within the core
+    if (conn->pollPending) send_next(conn);
+}
+
+static uint32_t until(uint64_t at, uint64_t now, uint32_t wait)
+{
+    if (at == 0) return wait;
+    if (at <= now) return 0;
+    return at - now < wait ? at - now : wait;
+}
+
+uint32_t GwConnTick(gwConn_t *conn, uint64_t now)
+{
+    uint32_t wait = 1000;
+
+    if (conn->state == GW_STATE_DOWN) return wait;
+
+    conn->now = now;
+
+    if (conn->coreTimerAt && now >= conn->coreTimerAt) {
+        conn->coreTimerAt = 0;
+        AmdtpCoreTimeout(&conn->core);
+    }
+
+    // an ACK the transport refused
+    AmdtpCorePump(&conn->core);
+
+    if (conn->replyBy && now >= conn->replyBy) {
+        conn->stats.timeouts++;
+        conn->replyBy = 0;
+        conn->link->close(conn->linkCtx);
+        return wait;
+    }
+
+    if (conn->state == GW_STATE_IDLE && conn->cfg->pollCount && now >= conn->nextRound) {
+        conn->state = GW_STATE_POLL;
+        conn->pollNext = 0;
+        conn->pollPending = true;
+        conn->nextRound = now + conn->cfg->intervalMs;
+    }
+
+    if (conn->pollPending) {
+        send_next(conn);
+        if (conn->pollPending) wait = GW_RETRY_MS;
+    }
+
+    wait = until(conn->coreTimerAt, now, wait);
+    wait = until(conn->replyBy, now, wait);
+    if (conn->state == GW_STATE_IDLE && conn->cfg->pollCount) wait = until(conn->nextRound, now, wait);
+
+    return wait;
+}
+
+void GwConnDown(gwConn_t *conn)
+{
+    conn->state = GW_STATE_DOWN;
+    conn->coreTimerAt = 0;
+    conn->replyBy = 0;
+    conn->pollPending = false;
+}
+
+//*****************************************************************************
+//
+// configuration
+//
+//*****************************************************************************
+bool GwConfigPoll(gwConfig_t *cfg, const char *list)
+{
+    static const struct { const char *name; uint8_t cmd; bool hasArg; } names[] = {
+        { "battery", AMDTP_CMD_REQ_BATTERY_LEVEL,     false },
+        { "tempC",   AMDTP_CMD_REQ_INTERNAL_TEMP_CEL, false },
+        { "tempF",   AMDTP_CMD_REQ_INTERNAL_TEMP_FRH, false },
+        { "bme280",  AMDTP_CMD_BME280,                false },
+        { "version", AMDTP_CMD_VERSION,               false },
+        { "adc",     AMDTP_CMD_ADC,                   true },
+        { "pin",     AMDTP_CMD_READ_PIN,              true },
+    };
+    char item[32], *arg;
+    const char *end;
+    size_t i, len;
+
+    while (*list) {
+        end = strchr(list, ',');
+        len = end ? (size_t) (end - list) : strlen(list);
+        if (len == 0 || len >= sizeof(item) || cfg->pollCount >= GW_MAX_POLL) return false;
+
+        memcpy(item, list, len);
+        item[len] = 0;
+        arg = strchr(item, ':');
+        if (arg) *arg++ = 0;
+
+        for (i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+            if (strcmp(item, names[i].name) == 0) break;
+
+        if (i == sizeof(names) / sizeof(names[0])) return false;
+        if (names[i].hasArg != (arg != NULL)) return false;
+
+        cfg->poll[cfg->pollCount].cmd = names[i].cmd;
+        cfg->poll[cfg->pollCount].hasArg = names[i].hasArg;
+        cfg->poll[cfg->pollCount].arg = arg ? atoi(arg) : 0;
+        cfg->pollCount++;
+
+        list += len;
+        if (*list == ',') list++;
+    }
+
+    return true;
+}
+
+bool GwParseSubscribe(const char *spec, uint8_t *fields, uint16_t *intervalMs, uint8_t *samples)
+{
+    static const struct { const char *name; uint8_t bits; } names[] = {
+        { "battery",     AMDTP_TLM_BIT(AMDTP_TLM_BATTERY) },
+        { "internal",    AMDTP_TLM_BIT(AMDTP_TLM_INTERNAL) },
+        { "tempC",       AMDTP_TLM_BIT(AMDTP_TLM_INTERNAL) },
+        { "bme280",      AMDTP_TLM_BME280 },
+        { "temperature", AMDTP_TLM_BIT(AMDTP_TLM_TEMPERATURE) },
+        { "humidity",    AMDTP_TLM_BIT(AMDTP_TLM_HUMIDITY) },
+        { "pressure",    AMDTP_TLM_BIT(AMDTP_TLM_PRESSURE) },
+        { "altitude",    AMDTP_TLM_BIT(AMDTP_TLM_ALTITUDE) },
+        { "all",         AMDTP_TLM_ALL },
+    };
+    char item[32];
+    const char *end, *colon;
+    long ms = GW_TLM_INTERVAL_MS, n = GW_TLM_SAMPLES;
+    size_t i, len;
+    char *rest;
+
+    *fields = 0;
+
+    // the fields up to the first ':'
+    colon = strchr(spec, ':');
+    end = colon ? colon : spec + strlen(spec);
+
+    while (spec < end) {
+        const char *comma = memchr(spec, ',', end - spec);
+
+        len = comma ? (size_t) (comma - spec) : (size_t) (end - spec);
+        if (len == 0 || len >= sizeof(item)) return false;
+
+        memcpy(item, spec, len);
+        item[len] = 0;
+
+        for (i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+            if (strcmp(item, names[i].name) == 0) break;
+
+        if (i == sizeof(names) / sizeof(names[0])) return false;
+        *fields |= names[i].bits;
+
+        spec += len;
+        if (spec < end) spec++;
+    }
+
+    if (colon) {
+        ms = strtol(colon + 1, &rest, 10);
+        if (rest == colon + 1) return false;
+        if (*rest == ':') {
+            n = strtol(rest + 1, &rest, 10);
+            if (*rest) return false;
+        }
+        else if (*rest) return false;
+    }
+
+    if (*fields == 0 || ms < AMDTP_TLM_MIN_INTERVAL_MS || ms > 65535 || n < 1 || n > AMDTP_TLM_MAX_SAMPLES)
+        return false;
+
+    *intervalMs = ms;
+    *samples = n;
+    return true;
+}
+
+bool GwConfigSubscribe(gwConfig_t *cfg, const char *spec)
+{
+    return GwParseSubscribe(spec, &cfg->tlmFields, &cfg->tlmIntervalMs, &cfg->tlmSamples);
+}
+
+//*****************************************************************************
+//
+// sim link
+//
+//*****************************************************************************
+uint16_t GwSimMessage(uint8_t *out, uint8_t type, const uint8_t *buf, uint8_t len)
+{
+    out[0] = type;
+    out[1] = len;
+    memcpy(&out[GW_SIM_HDR_SIZE], buf, len);
+
+    return len + GW_SIM_HDR_SIZE;
+}
+
+void GwSimParse(uint8_t *buf, uint16_t *len,
+                void (*msg)(void *ctx, uint8_t type, uint8_t *data, uint8_t len), void *ctx)
+{
+    uint16_t i = 0;
+
+    while (*len - i >= GW_SIM_HDR_SIZE && *len - i >= GW_SIM_HDR_SIZE + buf[i + 1]) {
+        msg(ctx, buf[i], &buf[i + GW_SIM_HDR_SIZE], buf[i + 1]);
+        i += GW_SIM_HDR_SIZE + buf[i + 1];
+    }
+
+    memmove(buf, &buf[i], *len - i);
+    *len -= i;
+}
@@ -0,0 +1,256 @@
+// ****************************************************************************
+//
+//
+//! @file  amdtc_gw.h
+//!
+//! @brief One server (sensor) of the gateway mode.
+//!
+//! amdtc with --gateway collects from many servers at the same time. Each
+//! server has a gwConn_t with its own AMDTP core, the commands to poll and
+//! the time of the next poll. There are no globals : the gateway
+//! (amdtc_gateway.c) keeps a table of them in one glib main loop.
+//!
+//! The gwConn_t does not know the event loop or the transport. It is given :
+//!
+//!   GwConnUp()      the link is connected (and the MTU known)
+//!   GwConnFrame()   a frame (notification) from the server
+//!   GwConnTick()    the time, from a timer of the loop
+//!   GwConnDown()    the link is gone
+//!
+//! and writes frames with the write() of its gwLink_t. After HELLO it sends
+//! the poll commands one after the other and each reply that has values goes
+//! as a record to the sink. When all are done the next round starts after
+//! the interval. A reply that does not come in time closes the link (close()
+//! of gwLink_t), the gateway connects again.
+//!
+//! With a subscription (GwConfigSubscribe()) it sends AMDTP_CMD_SUBSCRIBE after
+//! HELLO instead of polling. The server pushes a batch of samples per packet
+//! (amdtp_tlm.h) and each sample goes as a record to the sink. A server that
+//! does not know the command (before version 4.2) is polled. No batch in
+//! samples x interval + GW_REPLY_MS closes the link.
+//!
+//! No glib or bluez in here, so MBED-BLE/extras/amdtp_sim/gateway_sim runs it
+//! on a host against fake_periph, the servers as a local process.
+//!
+//! The sim link (a Unix stream socket to fake_periph) frames each message as
+//! [type][length][data] : GW_SIM_MTU has the MTU (2 bytes, little endian) and
+//! is sent by both sides after connect (the ATT MTU exchange), GW_SIM_FRAME
+//! has an AMDTP frame as it would be in a notification or write.
+//!
+//! paulvha / October 2026 / version 4.2
+//! paulvha / October 2026 / version 4.3 : subscribe to telemetry
+//
+// ****************************************************************************
+
+#ifndef AMDTC_GW_H
+#define AMDTC_GW_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "amdtp_core.h"
+#include "amdtp_tlm.h"
+#include "amdtc_sink.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define GW_MAX_POLL             8           // commands per round
+#define GW_NAME_SIZE            64
+#define GW_INTERVAL_MS          10000       // default time between rounds
+#define GW_REPLY_MS             5000        // reply of the server, else the link is closed
+#define GW_TLM_INTERVAL_MS      1000        // default time between the samples of a subscription
+#define GW_TLM_SAMPLES          10          // default samples per packet
+
+#define GW_SIM_MTU              'M'
+#define GW_SIM_FRAME            'F'
+#define GW_SIM_HDR_SIZE         2
+#define GW_SIM_MSG_SIZE         (GW_SIM_HDR_SIZE + 255)
+
+typedef enum
+{
+    GW_STATE_DOWN,                          // not connected
+    GW_STATE_HELLO,                         // connected, waiting for the reply on HELLO
+    GW_STATE_IDLE,                          // waiting for the next round
+    GW_STATE_POLL,                          // waiting for a reply
+    GW_STATE_SUBSCRIBE,                     // waiting for the reply on SUBSCRIBE
+    GW_STATE_STREAM,                        // subscribed, the server pushes the samples
+}
+eGwState_t;
+
+typedef struct
+{
+    uint8_t     cmd;
+    uint8_t     arg;                        // ADC channel or pin
+    bool        hasArg;
+}
+gwPoll_t;
+
+//! the same for all servers
+typedef struct
+{
+    gwPoll_t    poll[GW_MAX_POLL];
+    uint8_t     pollCount;
+    uint32_t    intervalMs;
+    uint32_t    replyMs;
+    uint8_t     tlmFields;                  // subscribe to these (amdtp_tlm.h), 0 : poll
+    uint16_t    tlmIntervalMs;
+    uint8_t     tlmSamples;
+    bool        compress;
+    bool        keySet;
+    uint8_t     key[AMDTP_CCM_KEY_SIZE];
+}
+gwConfig_t;
+
+typedef struct
+{
+    //! write a frame to the server, false if the transport is full
+    bool        (*write)(void *ctx, const uint8_t *buf, uint16_t len);
+
+    //! disconnect, the gateway calls GwConnDown() when it is gone
+    void        (*close)(void *ctx);
+}
+gwLink_t;
+
+typedef struct
+{
+    uint32_t    connects;
+    uint32_t    records;                    // replies with values
+    uint32_t    replies;                    // all replies
+    uint32_t    polled;                     // replies on a poll command
+    uint32_t    timeouts;                   // no reply in time
+    uint32_t    errors;                     // frames the core refused (CRC ..)
+    uint32_t    batches;                    // telemetry packets
+    uint32_t    batchBytes;
+    uint32_t    frames;                     // both ways, data and acknowledge
+    uint32_t    latencyMaxMs;               // poll until reply
+    uint64_t    latencySumMs;
+}
+gwStats_t;
+
+typedef struct
+{
+    char                name[GW_NAME_SIZE];
+    eGwState_t          state;
+    const gwConfig_t    *cfg;
+    gwSink_t            *sink;
+
+    const gwLink_t      *link;
+    void                *linkCtx;
+
+    amdtpCore_t         core;
+    uint64_t            now;                // ms, the last time given
+    uint64_t            coreTimerAt;        // AmdtpCoreTimeout(), 0 if not running
+    uint64_t            replyBy;            // 0 if not waiting
+    uint64_t            nextRound;
+    uint64_t            sentAt;             // the poll command
+    uint64_t            negotiatedAt;
+    uint8_t             negotiations;       // since the connect
+    uint8_t             pollNext;
+    bool                pollPending;        // the core was busy, send on the next tick
+    uint16_t            streamIntervalMs;   // the subscription as the server took it
+    uint8_t             streamSamples;
+
+    gwStats_t           stats;
+}
+gwConn_t;
+
+//*****************************************************************************
+//
+//! @brief Set up a connection, not connected yet.
+//
+//*****************************************************************************
+extern void GwConnInit(gwConn_t *conn, const char *name, const gwConfig_t *cfg, gwSink_t *sink,
+                       const gwLink_t *link, void *linkCtx);
+
+//*****************************************************************************
+//
+//! @brief The link is up : negotiate and send HELLO.
+//!
+//! @param mtu  ATT MTU of the connection
+//! @param now  ms, any monotonic clock
+//
+//*****************************************************************************
+extern void GwConnUp(gwConn_t *conn, uint16_t mtu, uint64_t now);
+
+//*****************************************************************************
+//
+//! @brief A frame from the server (data or acknowledge, the core finds out).
+//
+//*****************************************************************************
+extern void GwConnFrame(gwConn_t *conn, uint8_t *buf, uint16_t len, uint64_t now);
+
+//*****************************************************************************
+//
+//! @brief Run the timers and start a round when it is time.
+//!
+//! @return ms until the next call is needed (at most 1000)
+//
+//*****************************************************************************
+extern uint32_t GwConnTick(gwConn_t *conn, uint64_t now);
+
+//*****************************************************************************
+//
+//! @brief The link is gone, stops the timers.
+//
+//*****************************************************************************
+extern void GwConnDown(gwConn_t *conn);
+
+//*****************************************************************************
+//
+//! @brief Add the poll commands of a list as "battery,tempC,bme280,adc:3".
+//!
+//! names : battery, tempC, tempF, bme280, version, adc:CHANNEL, pin:PIN
+//!
+//! @return false on an unknown name or more than GW_MAX_POLL
+//
+//*****************************************************************************
+extern bool GwConfigPoll(gwConfig_t *cfg, const char *list);
+
+//*****************************************************************************
+//
+//! @brief Subscribe instead of polling, spec as "bme280,battery:500:10" :
+//! the fields, the ms between the samples and the samples per packet.
+//!
+//! fields : battery, internal (or tempC), bme280, temperature, humidity,
+//! pressure, altitude and all. The ms and samples can be left out (1000, 10).
+//!
+//! @return false on an unknown field or a value out of range
+//
+//*****************************************************************************
+extern bool GwConfigSubscribe(gwConfig_t *cfg, const char *spec);
+
+//*****************************************************************************
+//
+//! @brief The same for amdtc --subscribe, without a gwConfig_t.
+//
+//*****************************************************************************
+extern bool GwParseSubscribe(const char *spec, uint8_t *fields, uint16_t *intervalMs, uint8_t *samples);
+
+//*****************************************************************************
+//
+//! @brief A message of the sim link in out, [type][length][data].
+//!
+//! @return length of the message
+//
+//*****************************************************************************
+extern uint16_t GwSimMessage(uint8_t *out, uint8_t type, const uint8_t *buf, uint8_t len);
+
+//*****************************************************************************
+//
+//! @brief Take the complete messages of the sim link from a receive buffer.
+//!
+//! Calls msg() for each and moves what is left to the front.
+//!
+//! @param len  bytes in buf, updated with the bytes left
+//
+//*****************************************************************************
+extern void GwSimParse(uint8_t *buf, uint16_t *len,
+                       void (*msg)(void *ctx, uint8_t type, uint8_t *data, uint8_t len), void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AMDTC_GW_H
@@ -0,0 +1,372 @@
+// ****************************************************************************
+//
+//
+//! @file  amdtc_sink.c
+//!
+//! @brief Records of the gateway mode and where they are written, see amdtc_sink.h
+//!
+//! paulvha / October 2026 / version 4.2
+//! paulvha / October 2026 / version 4.3 : telemetry records
+//
+// ****************************************************************************
+
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "amdtc_cmd.h"
+#include "amdtc_sink.h"
+
+#define LINE_SIZE           512
+
+/**
+ * @brief 4 bytes IEEE754, most significant first (float_to_byte() of the server)
+ */
+static float get_float(const uint8_t *p)
+{
+    union { uint8_t array[4]; float value; } conv;
+    uint8_t i;
+
+    for (i = 0; i < 4; i++) conv.array[3-i] = p[i];
+    return conv.value;
+}
+
+static void add_field(gwRecord_t *rec, const char *name, double value, const char *unit)
+{
+    gwField_t *f = &rec->field[rec->count++];
+
+    f->name = name;
+    f->value = value;
+    snprintf(f->unit, sizeof(f->unit), "%s", unit);
+}
+
+bool GwRecordDecode(gwRecord_t *rec, const char *device, const uint8_t *buf, uint16_t len)
+{
+    struct timeval tv;
+    int16_t val;
+
+    memset(rec, 0, sizeof(gwRecord_t));
+
+    if (len < 2 || len < buf[1] + 2) return false;
+
+    gettimeofday(&tv, NULL);
+    rec->time = tv.tv_sec + tv.tv_usec / 1000000.0;
+    rec->device = device;
+
+    switch (buf[0]) {
+
+        case AMDTP_CMD_REQ_BATTERY_LEVEL:
+            if (buf[1] < 4) return false;
+            rec->type = "battery";
+            add_field(rec, "level", get_float(&buf[2]), "%");
+            break;
+
+        case AMDTP_CMD_REQ_INTERNAL_TEMP_CEL:
+        case AMDTP_CMD_REQ_INTERNAL_TEMP_FRH:
+            if (buf[1] < 4) return false;
+            rec->type = buf[0] == AMDTP_CMD_REQ_INTERNAL_TEMP_CEL ? "tempC" : "tempF";
+            add_field(rec, "temperature", get_float(&buf[2]),
+                      buf[0] == AMDTP_CMD_REQ_INTERNAL_TEMP_CEL ? "C" : "F");
+            break;
+
+        // [C or F][temperature][humidity][pressure][M or F][altitude], see display_BME280()
+        case AMDTP_CMD_BME280:
+            if (buf[1] != 18) return false;     // 0 : no BME280 on the server
+            rec->type = "bme280";
+            add_field(rec, "temperature", get_float(&buf[3]), buf[2] == 'C' ? "C" : "F");
+            add_field(rec, "humidity", get_float(&buf[7]), "%");
+            add_field(rec, "pressure", get_float(&buf[11]) / 100, "hPa");
+            add_field(rec, "altitude", get_float(&buf[16]), buf[15] == 'M' ? "m" : "ft");
+            break;
+
+        case AMDTP_CMD_ADC:
+            if (buf[1] < 3) return false;
+            val = buf[3] << 8 | buf[4];
+            if (val == -1) return false;        // not an analog pin
+            rec->type = "adc";
+            add_field(rec, "channel", buf[2], "");
+            add_field(rec, "value", val, "");
+            break;
+
+        case AMDTP_CMD_READ_PIN:
+            if (buf[1] < 2) return false;
+            rec->type = "pin";
+            add_field(rec, "pin", buf[2], "");
+            add_field(rec, "level", buf[3] ? 1 : 0, "");
+            break;
+
+        case AMDTP_CMD_VERSION:
+            if (buf[1] < 2) return false;
+            rec->type = "version";
+            add_field(rec, "major", buf[2], "");
+            add_field(rec, "minor", buf[3], "");
+            break;
+
+        default:
+            return false;
+    }
+
+    return true;
+}
+
+bool GwRecordSample(gwRecord_t *rec, const char *device, uint8_t fields, const amdtpTlmSample_t *s,
+                    uint32_t ageMs)
+{
+    struct timeval tv;
+    uint8_t f;
+
+    memset(rec, 0, sizeof(gwRecord_t));
+
+    gettimeofday(&tv, NULL);
+    rec->time = tv.tv_sec + tv.tv_usec / 1000000.0 - ageMs / 1000.0;
+    rec->device = device;
+    rec->type = "telemetry";
+
+    for (f = 0; f < AMDTP_TLM_FIELDS; f++)
+        if (fields & AMDTP_TLM_BIT(f))
+            add_field(rec, AmdtpTlmName(f), AmdtpTlmToFloat(s->value[f]), AmdtpTlmUnit(f));
+
+    return rec->count > 0;
+}
+
+//*****************************************************************************
+//
+// formats
+//
+//*****************************************************************************
+
+/**
+ * @brief a JSON string, the device name comes from the device file
+ */
+static int json_string(char *out, int size, const char *s)
+{
+    int n = 0;
+
+    if (n < size) out[n++] = '"';
+
+    for ( ; *s && n < size - 7; s++) {
+        if (*s == '"' || *s == '\\') {
+            out[n++] = '\\';
+            out[n++] = *s;
+        }
+        else if ((unsigned char) *s < 0x20)
+            n += snprintf(&out[n], size - n, "\\u%04x", *s);
+        else
+            out[n++] = *s;
+    }
+
+    if (n < size) out[n++] = '"';
+    return n;
+}
+
+/**
+ * @brief {"time":..,"device":..,"type":..,"level":91.5,"units":{"level":"%"}}
+ */
+static int json_line(char *out, int size, const gwRecord_t *rec)
+{
+    int n, i, units = 0;
+
+    n = snprintf(out, size, "{\"time\":%.3f,\"device\":", rec->time);
+    n += json_string(&out[n], size - n, rec->device);
+    n += snprintf(&out[n], size - n, ",\"type\":\"%s\"", rec->type);
+
+    for (i = 0; i < rec->count; i++)
+        n += snprintf(&out[n], size - n, ",\"%s\":%.7g", rec->field[i].name, rec->field[i].value);
+
+    for (i = 0; i < rec->count; i++) {
+        if (rec->field[i].unit[0] == 0) continue;
+        n += snprintf(&out[n], size - n, "%s\"%s\":", units++ ? "," : ",\"units\":{", rec->field[i].name);
+        n += json_string(&out[n], size - n, rec->field[i].unit);
+    }
+
+    n += snprintf(&out[n], size - n, "%s}\n", units ? "}" : "");
+
+    return n < size ? n : size - 1;
+}
+
+//*****************************************************************************
+//
+// json and csv to stdout or a file
+//
+//*****************************************************************************
+static bool file_open(gwSink_t *sink, const char *arg)
+{
+    if (arg == NULL || *arg == 0) {
+        sink->fp = stdout;
+        return true;
+    }
+
+    // a file is added to, a restarted gateway does not lose the earlier records
+    sink->fp = fopen(arg, "a");
+    return sink->fp != NULL;
+}
+
+static void file_close(gwSink_t *sink)
+{
+    if (sink->fp && sink->fp != stdout) fclose(sink->fp);
+    else if (sink->fp) fflush(sink->fp);
+    sink->fp = NULL;
+}
+
+static bool json_write(gwSink_t *sink, const gwRecord_t *rec)
+{
+    char line[LINE_SIZE];
+    int n = json_line(line, sizeof(line), rec);
+
+    if (fwrite(line, 1, n, sink->fp) != (size_t) n) return false;
+
+    // a reader (tail -f, a pipe) gets each record as it comes
+    fflush(sink->fp);
+    return true;
+}
+
+static bool csv_open(gwSink_t *sink, const char *arg)
+{
+    if (! file_open(sink, arg)) return false;
+
+    // header only at the start of the file
+    if (sink->fp == stdout || ftell(sink->fp) == 0)
+        fprintf(sink->fp, "time,device,type,field,value,unit\n");
+
+    return true;
+}
+
+static bool csv_write(gwSink_t *sink, const gwRecord_t *rec)
+{
+    int i;
+
+    for (i = 0; i < rec->count; i++) {
+        if (fprintf(sink->fp, "%.3f,%s,%s,%s,%.7g,%s\n", rec->time, rec->device, rec->type,
+                    rec->field[i].name, rec->field[i].value, rec->field[i].unit) < 0)
+            return false;
+    }
+
+    fflush(sink->fp);
+    return true;
+}
+
+//*****************************************************************************
+//
+// JSON lines to a Unix stream socket
+//
+//*****************************************************************************
+static double now_s()
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static void unix_close(gwSink_t *sink)
+{
+    if (sink->fd >= 0) close(sink->fd);
+    sink->fd = -1;
+}
+
+static bool unix_connect(gwSink_t *sink)
+{
+    struct sockaddr_un addr;
+
+    if (now_s() < sink->retryAt) return false;
+    sink->retryAt = now_s() + 1;
+
+    sink->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sink->fd < 0) return false;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, sink->path, sizeof(addr.sun_path) - 1);
+
+    if (connect(sink->fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        unix_close(sink);
+        return false;
+    }
+
+    return true;
+}
+
+static bool unix_open(gwSink_t *sink, const char *arg)
+{
+    if (arg == NULL || *arg == 0 || strlen(arg) >= GW_SINK_PATH) return false;
+
+    strcpy(sink->path, arg);
+    sink->fd = -1;
+
+    // the listener may start later, unix_write() connects
+    unix_connect(sink);
+    return true;
+}
+
+static bool unix_write(gwSink_t *sink, const gwRecord_t *rec)
+{
+    char line[LINE_SIZE];
+    int n = json_line(line, sizeof(line), rec);
+    ssize_t w;
+
+    if (sink->fd < 0 && ! unix_connect(sink)) return false;
+
+    w = send(sink->fd, line, n, MSG_DONTWAIT | MSG_NOSIGNAL);
+
+    if (w == n) return true;
+
+    // full : drop this record, the listener is slower than the sensors
+    if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return false;
+
+    // gone, or part of a line was written : start again with a new connection
+    unix_close(sink);
+    return false;
+}
+
+//*****************************************************************************
+//
+// the sinks
+//
+//*****************************************************************************
+static const gwSinkOps_t sinks[] = {
+    { "json", file_open, json_write, file_close },
+    { "csv",  csv_open,  csv_write,  file_close },
+    { "unix", unix_open, unix_write, unix_close },
+};
+
+bool GwSinkOpen(gwSink_t *sink, const char *spec)
+{
+    const char *arg = strchr(spec, ':');
+    size_t len = arg ? (size_t) (arg - spec) : strlen(spec);
+    size_t i;
+
+    memset(sink, 0, sizeof(gwSink_t));
+    sink->fd = -1;
+
+    for (i = 0; i < sizeof(sinks) / sizeof(sinks[0]); i++) {
+
+        if (strlen(sinks[i].name) != len || strncmp(spec, sinks[i].name, len) != 0)
+            continue;
+
+        sink->ops = &sinks[i];
+        return sinks[i].open(sink, arg ? arg + 1 : NULL);
+    }
+
+    return false;
+}
+
+bool GwSinkWrite(gwSink_t *sink, const gwRecord_t *rec)
+{
+    if (sink->ops && sink->ops->write(sink, rec)) {
+        sink->written++;
+        return true;
+    }
+
+    sink->dropped++;
+    return false;
+}
+
+void GwSinkClose(gwSink_t *sink)
+{
+    if (sink->ops) sink->ops->close(sink);
+    sink->ops = NULL;
+}
@@ -0,0 +1,129 @@
+// ****************************************************************************
+//
+//
+//! @file  amdtc_sink.h
+//!
+//! @brief Records of the gateway mode and where they are written.
+//!
+//! A reply of the server (buf[0] the command, buf[1] the length of the data)
+//! is decoded into a record : the device, the type (battery, tempC, bme280 ..)
+//! and named values. A sink writes the records :
+//!
+//!   json[:FILE]   one JSON object per line (stdout without FILE)
+//!   csv[:FILE]    time,device,type,field,value,unit : one line per value
+//!   unix:PATH     JSON lines to a program listening on a Unix stream socket
+//!
+//! A new sink is an entry in the table of amdtc_sink.c. The unix sink does not
+//! block the gateway : a record that does not fit in the socket is dropped and
+//! counted, after an error it connects again (at most once a second).
+//!
+//! No glib or bluez in here, MBED-BLE/extras/amdtp_sim/gateway_sim uses the
+//! same file on a host.
+//!
+//! A sample of a telemetry batch (amdtp_tlm.h) is a record of type telemetry
+//! with the fields of the subscription.
+//!
+//! paulvha / October 2026 / version 4.2
+//! paulvha / October 2026 / version 4.3 : telemetry records
+//
+// ****************************************************************************
+
+#ifndef AMDTC_SINK_H
+#define AMDTC_SINK_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "amdtp_tlm.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define GW_RECORD_FIELDS    AMDTP_TLM_FIELDS    // values in a record (telemetry)
+#define GW_SINK_PATH        108         // sun_path of a Unix socket
+
+typedef struct
+{
+    const char      *name;
+    double          value;
+    char            unit[4];
+}
+gwField_t;
+
+typedef struct
+{
+    double          time;               // seconds since 1970, with ms
+    const char      *device;            // MAC or sim:PATH#n
+    const char      *type;
+    uint8_t         count;
+    gwField_t       field[GW_RECORD_FIELDS];
+}
+gwRecord_t;
+
+struct gwSinkOps;
+
+typedef struct
+{
+    const struct gwSinkOps *ops;
+    FILE            *fp;
+    int             fd;                 // unix
+    char            path[GW_SINK_PATH];
+    double          retryAt;            // unix : next connect, seconds
+    uint32_t        written;            // records
+    uint32_t        dropped;            // records not written
+}
+gwSink_t;
+
+typedef struct gwSinkOps
+{
+    const char      *name;              // in front of the ':' of the spec
+    bool            (*open)(gwSink_t *sink, const char *arg);
+    bool            (*write)(gwSink_t *sink, const gwRecord_t *rec);
+    void            (*close)(gwSink_t *sink);
+}
+gwSinkOps_t;
+
+//*****************************************************************************
+//
+//! @brief Decode a reply of the server.
+//!
+//! @return false if the reply has no values (HELLO, LED on ..) or is too short
+//
+//*****************************************************************************
+extern bool GwRecordDecode(gwRecord_t *rec, const char *device, const uint8_t *buf, uint16_t len);
+
+//*****************************************************************************
+//
+//! @brief A sample of a telemetry batch, taken ageMs before now.
+//!
+//! @return false if it has no fields
+//
+//*****************************************************************************
+extern bool GwRecordSample(gwRecord_t *rec, const char *device, uint8_t fields, const amdtpTlmSample_t *s,
+                           uint32_t ageMs);
+
+//*****************************************************************************
+//
+//! @brief Open a sink, spec as "json", "csv:/tmp/data.csv" or "unix:/run/gw.sock".
+//!
+//! @return false on an unknown name or if the file can not be created
+//
+//*****************************************************************************
+extern bool GwSinkOpen(gwSink_t *sink, const char *spec);
+
+//*****************************************************************************
+//
+//! @brief Write a record, false if it was dropped.
+//
+//*****************************************************************************
+extern bool GwSinkWrite(gwSink_t *sink, const gwRecord_t *rec);
+
+extern void GwSinkClose(gwSink_t *sink);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AMDTC_SINK_H
@@ -0,0 +1,297 @@
+// ****************************************************************************
+//
+//  amdtp_ccm.c
+//! @file
+//!
+//! @brief AES-128-CCM for AMDTP packets, see amdtp_ccm.h
+//!
+//! The AES rounds use one T-table (S-box times the MixColumns column) and
+//! rotate it for the other 3 columns, 1 Kbyte instead of 4 Kbyte.
+//!
+//! added paulvha / October 2026
+//
+// ****************************************************************************
+
+#include <string.h>
+#include "amdtp_ccm.h"
+
+#define CCM_LEN_SIZE        2       // 15 - AMDTP_CCM_NONCE_SIZE
+
+#define ROR(x, n)           (((x) >> (n)) | ((x) << (32 - (n))))
+#define GET32(p)            ((uint32_t)(p)[0] << 24 | (uint32_t)(p)[1] << 16 | (uint32_t)(p)[2] << 8 | (p)[3])
+
+static const uint8_t aesSbox[256] =
+{
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+    0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+    0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+    0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+    0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+    0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+    0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+    0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+    0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+    0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+    0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16
+};
+
+// S-box times [02 01 01 03], the other columns are rotations
+static const uint32_t aesTe0[256] =
+{
+    0xc66363a5U, 0xf87c7c84U, 0xee777799U, 0xf67b7b8dU, 0xfff2f20dU, 0xd66b6bbdU,
+    0xde6f6fb1U, 0x91c5c554U, 0x60303050U, 0x02010103U, 0xce6767a9U, 0x562b2b7dU,
+    0xe7fefe19U, 0xb5d7d762U, 0x4dababe6U, 0xec76769aU, 0x8fcaca45U, 0x1f82829dU,
+    0x89c9c940U, 0xfa7d7d87U, 0xeffafa15U, 0xb25959ebU, 0x8e4747c9U, 0xfbf0f00bU,
+    0x41adadecU, 0xb3d4d467U, 0x5fa2a2fdU, 0x45afafeaU, 0x239c9cbfU, 0x53a4a4f7U,
+    0xe4727296U, 0x9bc0c05bU, 0x75b7b7c2U, 0xe1fdfd1cU, 0x3d9393aeU, 0x4c26266aU,
+    0x6c36365aU, 0x7e3f3f41U, 0xf5f7f702U, 0x83cccc4fU, 0x6834345cU, 0x51a5a5f4U,
+    0xd1e5e534U, 0xf9f1f108U, 0xe2717193U, 0xabd8d873U, 0x62313153U, 0x2a15153fU,
+    0x0804040cU, 0x95c7c752U, 0x46232365U, 0x9dc3c35eU, 0x30181828U, 0x379696a1U,
+    0x0a05050fU, 0x2f9a9ab5U, 0x0e070709U, 0x24121236U, 0x1b80809bU, 0xdfe2e23dU,
+    0xcdebeb26U, 0x4e272769U, 0x7fb2b2cdU, 0xea75759fU, 0x1209091bU, 0x1d83839eU,
+    0x582c2c74U, 0x341a1a2eU, 0x361b1b2dU, 0xdc6e6eb2U, 0xb45a5aeeU, 0x5ba0a0fbU,
+    0xa45252f6U, 0x763b3b4dU, 0xb7d6d661U, 0x7db3b3ceU, 0x5229297bU, 0xdde3e33eU,
+    0x5e2f2f71U, 0x13848497U, 0xa65353f5U, 0xb9d1d168U, 0x00000000U, 0xc1eded2cU,
+    0x40202060U, 0xe3fcfc1fU, 0x79b1b1c8U, 0xb65b5bedU, 0xd46a6abeU, 0x8dcbcb46U,
+    0x67bebed9U, 0x7239394bU, 0x944a4adeU, 0x984c4cd4U, 0xb05858e8U, 0x85cfcf4aU,
+    0xbbd0d06bU, 0xc5efef2aU, 0x4faaaae5U, 0xedfbfb16U, 0x864343c5U, 0x9a4d4dd7U,
+    0x66333355U, 0x11858594U, 0x8a4545cfU, 0xe9f9f910U, 0x04020206U, 0xfe7f7f81U,
+    0xa05050f0U, 0x783c3c44U, 0x259f9fbaU, 0x4ba8a8e3U, 0xa25151f3U, 0x5da3a3feU,
+    0x804040c0U, 0x058f8f8aU, 0x3f9292adU, 0x219d9dbcU, 0x70383848U, 0xf1f5f504U,
+    0x63bcbcdfU, 0x77b6b6c1U, 0xafdada75U, 0x42212163U, 0x20101030U, 0xe5ffff1aU,
+    0xfdf3f30eU, 0xbfd2d26dU, 0x81cdcd4cU, 0x180c0c14U, 0x26131335U, 0xc3ecec2fU,
+    0xbe5f5fe1U, 0x359797a2U, 0x884444ccU, 0x2e171739U, 0x93c4c457U, 0x55a7a7f2U,
+    0xfc7e7e82U, 0x7a3d3d47U, 0xc86464acU, 0xba5d5de7U, 0x3219192bU, 0xe6737395U,
+    0xc06060a0U, 0x19818198U, 0x9e4f4fd1U, 0xa3dcdc7fU, 0x44222266U, 0x542a2a7eU,
+    0x3b9090abU, 0x0b888883U, 0x8c4646caU, 0xc7eeee29U, 0x6bb8b8d3U, 0x2814143cU,
+    0xa7dede79U, 0xbc5e5ee2U, 0x160b0b1dU, 0xaddbdb76U, 0xdbe0e03bU, 0x64323256U,
+    0x743a3a4eU, 0x140a0a1eU, 0x924949dbU, 0x0c06060aU, 0x4824246cU, 0xb85c5ce4U,
+    0x9fc2c25dU, 0xbdd3d36eU, 0x43acacefU, 0xc46262a6U, 0x399191a8U, 0x319595a4U,
+    0xd3e4e437U, 0xf279798bU, 0xd5e7e732U, 0x8bc8c843U, 0x6e373759U, 0xda6d6db7U,
+    0x018d8d8cU, 0xb1d5d564U, 0x9c4e4ed2U, 0x49a9a9e0U, 0xd86c6cb4U, 0xac5656faU,
+    0xf3f4f407U, 0xcfeaea25U, 0xca6565afU, 0xf47a7a8eU, 0x47aeaee9U, 0x10080818U,
+    0x6fbabad5U, 0xf0787888U, 0x4a25256fU, 0x5c2e2e72U, 0x381c1c24U, 0x57a6a6f1U,
+    0x73b4b4c7U, 0x97c6c651U, 0xcbe8e823U, 0xa1dddd7cU, 0xe874749cU, 0x3e1f1f21U,
+    0x964b4bddU, 0x61bdbddcU, 0x0d8b8b86U, 0x0f8a8a85U, 0xe0707090U, 0x7c3e3e42U,
+    0x71b5b5c4U, 0xcc6666aaU, 0x904848d8U, 0x06030305U, 0xf7f6f601U, 0x1c0e0e12U,
+    0xc26161a3U, 0x6a35355fU, 0xae5757f9U, 0x69b9b9d0U, 0x17868691U, 0x99c1c158U,
+    0x3a1d1d27U, 0x279e9eb9U, 0xd9e1e138U, 0xebf8f813U, 0x2b9898b3U, 0x22111133U,
+    0xd26969bbU, 0xa9d9d970U, 0x078e8e89U, 0x339494a7U, 0x2d9b9bb6U, 0x3c1e1e22U,
+    0x15878792U, 0xc9e9e920U, 0x87cece49U, 0xaa5555ffU, 0x50282878U, 0xa5dfdf7aU,
+    0x038c8c8fU, 0x59a1a1f8U, 0x09898980U, 0x1a0d0d17U, 0x65bfbfdaU, 0xd7e6e631U,
+    0x844242c6U, 0xd06868b8U, 0x824141c3U, 0x299999b0U, 0x5a2d2d77U, 0x1e0f0f11U,
+    0x7bb0b0cbU, 0xa85454fcU, 0x6dbbbbd6U, 0x2c16163aU
+};
+
+static void
+put32(uint8_t *p, uint32_t n)
+{
+    p[0] = n >> 24;
+    p[1] = (n >> 16) & 0xff;
+    p[2] = (n >> 8) & 0xff;
+    p[3] = n & 0xff;
+}
+
+static uint32_t
+subWord(uint32_t w)
+{
+    return (uint32_t) aesSbox[w >> 24] << 24 | (uint32_t) aesSbox[(w >> 16) & 0xff] << 16 |
+           (uint32_t) aesSbox[(w >> 8) & 0xff] << 8 | aesSbox[w & 0xff];
+}
+
+void
+AmdtpCcmSetKey(amdtpCcmKey_t *ctx, const uint8_t *key)
+{
+    uint32_t *rk = ctx->rk;
+    uint32_t t;
+    uint8_t rcon = 0x01;
+    int i;
+
+    for (i = 0; i < 4; i++)
+    {
+        rk[i] = GET32(&key[i * 4]);
+    }
+
+    for (i = 4; i < 44; i++)
+    {
+        t = rk[i - 1];
+
+        if ((i & 3) == 0)
+        {
+            t = subWord((t << 8) | (t >> 24)) ^ ((uint32_t) rcon << 24);
+            rcon = (rcon << 1) ^ (rcon & 0x80 ? 0x1b : 0);
+        }
+
+        rk[i] = rk[i - 4] ^ t;
+    }
+}
+
+void
+AmdtpCcmBlock(const amdtpCcmKey_t *ctx, const uint8_t *in, uint8_t *out)
+{
+    const uint32_t *rk = ctx->rk;
+    uint32_t s0, s1, s2, s3, t0, t1, t2, t3;
+    int r;
+
+    s0 = GET32(in)      ^ rk[0];
+    s1 = GET32(in + 4)  ^ rk[1];
+    s2 = GET32(in + 8)  ^ rk[2];
+    s3 = GET32(in + 12) ^ rk[3];
+
+    for (r = 1; r < 10; r++)
+    {
+        rk += 4;
+        t0 = aesTe0[s0 >> 24] ^ ROR(aesTe0[(s1 >> 16) & 0xff], 8) ^
+             ROR(aesTe0[(s2 >> 8) & 0xff], 16) ^ ROR(aesTe0[s3 & 0xff], 24) ^ rk[0];
+        t1 = aesTe0[s1 >> 24] ^ ROR(aesTe0[(s2 >> 16) & 0xff], 8) ^
+             ROR(aesTe0[(s3 >> 8) & 0xff], 16) ^ ROR(aesTe0[s0 & 0xff], 24) ^ rk[1];
+        t2 = aesTe0[s2 >> 24] ^ ROR(aesTe0[(s3 >> 16) & 0xff], 8) ^
+             ROR(aesTe0[(s0 >> 8) & 0xff], 16) ^ ROR(aesTe0[s1 & 0xff], 24) ^ rk[2];
+        t3 = aesTe0[s3 >> 24] ^ ROR(aesTe0[(s0 >> 16) & 0xff], 8) ^
+             ROR(aesTe0[(s1 >> 8) & 0xff], 16) ^ ROR(aesTe0[s2 & 0xff], 24) ^ rk[3];
+        s0 = t0; s1 = t1; s2 = t2; s3 = t3;
+    }
+
+    // last round without MixColumns
+    rk += 4;
+    put32(out,      ((uint32_t) aesSbox[s0 >> 24] << 24 | (uint32_t) aesSbox[(s1 >> 16) & 0xff] << 16 |
+                     (uint32_t) aesSbox[(s2 >> 8) & 0xff] << 8 | aesSbox[s3 & 0xff]) ^ rk[0]);
+    put32(out + 4,  ((uint32_t) aesSbox[s1 >> 24] << 24 | (uint32_t) aesSbox[(s2 >> 16) & 0xff] << 16 |
+                     (uint32_t) aesSbox[(s3 >> 8) & 0xff] << 8 | aesSbox[s0 & 0xff]) ^ rk[1]);
+    put32(out + 8,  ((uint32_t) aesSbox[s2 >> 24] << 24 | (uint32_t) aesSbox[(s3 >> 16) & 0xff] << 16 |
+                     (uint32_t) aesSbox[(s0 >> 8) & 0xff] << 8 | aesSbox[s1 & 0xff]) ^ rk[2]);
+    put32(out + 12, ((uint32_t) aesSbox[s3 >> 24] << 24 | (uint32_t) aesSbox[(s0 >> 16) & 0xff] << 16 |
+                     (uint32_t) aesSbox[(s1 >> 8) & 0xff] << 8 | aesSbox[s2 & 0xff]) ^ rk[3]);
+}
+
+//*****************************************************************************
+//
+// CCM : the CBC-MAC starts with B0 and the aad, the counter blocks are
+// [L - 1][nonce][counter]. Counter 0 encrypts the MIC, 1.. the data.
+//
+//*****************************************************************************
+static void
+ccmStart(const amdtpCcmKey_t *ctx, const uint8_t *nonce, const uint8_t *aad, uint16_t aadLen,
+         uint16_t len, uint8_t micLen, uint8_t *x, uint8_t *a)
+{
+    uint16_t i, n;
+
+    x[0] = (aadLen > 0 ? 0x40 : 0) | ((micLen - 2) / 2) << 3 | (CCM_LEN_SIZE - 1);
+    memcpy(&x[1], nonce, AMDTP_CCM_NONCE_SIZE);
+    x[14] = len >> 8;
+    x[15] = len & 0xff;
+    AmdtpCcmBlock(ctx, x, x);
+
+    // aad with its length in front, aadLen < 0xFF00 needs 2 bytes
+    if (aadLen > 0)
+    {
+        x[0] ^= aadLen >> 8;
+        x[1] ^= aadLen & 0xff;
+        n = 2;
+
+        for (i = 0; i < aadLen; i++)
+        {
+            x[n++] ^= aad[i];
+
+            if (n == AMDTP_CCM_BLOCK_SIZE)
+            {
+                AmdtpCcmBlock(ctx, x, x);
+                n = 0;
+            }
+        }
+
+        if (n > 0) AmdtpCcmBlock(ctx, x, x);
+    }
+
+    a[0] = CCM_LEN_SIZE - 1;
+    memcpy(&a[1], nonce, AMDTP_CCM_NONCE_SIZE);
+    a[14] = 0;
+    a[15] = 0;
+}
+
+static void
+ccmNext(uint8_t *a)
+{
+    if (++a[15] == 0) a[14]++;
+}
+
+void
+AmdtpCcmEncrypt(const amdtpCcmKey_t *ctx, const uint8_t *nonce,
+                const uint8_t *aad, uint16_t aadLen,
+                uint8_t *buf, uint16_t len, uint8_t *mic, uint8_t micLen)
+{
+    uint8_t x[AMDTP_CCM_BLOCK_SIZE], a[AMDTP_CCM_BLOCK_SIZE], s[AMDTP_CCM_BLOCK_SIZE];
+    uint16_t i, n;
+
+    ccmStart(ctx, nonce, aad, aadLen, len, micLen, x, a);
+
+    for (i = 0; i < len; i += n)
+    {
+        n = len - i < AMDTP_CCM_BLOCK_SIZE ? len - i : AMDTP_CCM_BLOCK_SIZE;
+
+        ccmNext(a);
+        AmdtpCcmBlock(ctx, a, s);
+
+        for (uint16_t j = 0; j < n; j++)
+        {
+            x[j] ^= buf[i + j];
+            buf[i + j] ^= s[j];
+        }
+
+        AmdtpCcmBlock(ctx, x, x);
+    }
+
+    a[14] = 0;
+    a[15] = 0;
+    AmdtpCcmBlock(ctx, a, s);
+
+    for (i = 0; i < micLen; i++)
+    {
+        mic[i] = x[i] ^ s[i];
+    }
+}
+
+bool
+AmdtpCcmDecrypt(const amdtpCcmKey_t *ctx, const uint8_t *nonce,
+                const uint8_t *aad, uint16_t aadLen,
+                uint8_t *buf, uint16_t len, const uint8_t *mic, uint8_t micLen)
+{
+    uint8_t x[AMDTP_CCM_BLOCK_SIZE], a[AMDTP_CCM_BLOCK_SIZE], s[AMDTP_CCM_BLOCK_SIZE];
+    uint8_t diff = 0;
+    uint16_t i, n;
+
+    ccmStart(ctx, nonce, aad, aadLen, len, micLen, x, a);
+
+    for (i = 0; i < len; i += n)
+    {
+        n = len - i < AMDTP_CCM_BLOCK_SIZE ? len - i : AMDTP_CCM_BLOCK_SIZE;
+
+        ccmNext(a);
+        AmdtpCcmBlock(ctx, a, s);
+
+        for (uint16_t j = 0; j < n; j++)
+        {
+            buf[i + j] ^= s[j];
+            x[j] ^= buf[i + j];
+        }
+
+        AmdtpCcmBlock(ctx, x, x);
+    }
+
+    a[14] = 0;
+    a[15] = 0;
+    AmdtpCcmBlock(ctx, a, s);
+
+    // all bytes, so the time does not tell where the MIC differs
+    for (i = 0; i < micLen; i++)
+    {
+        diff |= mic[i] ^ x[i] ^ s[i];
+    }
+
+    return diff == 0;
+}
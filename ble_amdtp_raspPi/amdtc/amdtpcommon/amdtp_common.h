@@ -75,7 +75,7 @@ extern "C"
 #define AMDTP_LENGTH_SIZE_IN_PKT        2
 #define AMDTP_HEADER_SIZE_IN_PKT        2
 #define AMDTP_CRC_SIZE_IN_PKT           4
-#define AMDTP_PREFIX_SIZE_IN_PKT        AMDTP_LENGTH_SIZE_IN_PKT + AMDTP_HEADER_SIZE_IN_PKT
+#define AMDTP_PREFIX_SIZE_IN_PKT        (AMDTP_LENGTH_SIZE_IN_PKT + AMDTP_HEADER_SIZE_IN_PKT)
 
 #define PACKET_TYPE_BIT_OFFSET          12
 #define PACKET_TYPE_BIT_MASK            (0xf << PACKET_TYPE_BIT_OFFSET)
@@ -85,9 +85,17 @@ extern "C"
 #define PACKET_ENCRYPTION_BIT_MASK      (0x1 << PACKET_ENCRYPTION_BIT_OFFSET)
 #define PACKET_ACK_BIT_OFFSET           6
 #define PACKET_ACK_BIT_MASK             (0x1 << PACKET_ACK_BIT_OFFSET)
+#define PACKET_STREAM_BIT_OFFSET        5           // part of a stream, added October 2026
+#define PACKET_STREAM_BIT_MASK          (0x1 << PACKET_STREAM_BIT_OFFSET)
+#define PACKET_COMPRESS_BIT_OFFSET      4           // data is compressed (amdtp_lz.h), added October 2026
+#define PACKET_COMPRESS_BIT_MASK        (0x1 << PACKET_COMPRESS_BIT_OFFSET)
 
 #define TX_TIMEOUT_DEFAULT              1000
 #define ATT_DEFAULT_PAYLOAD_LEN         20        /*! Default maximum payload length for most PDUs */
+#define ATT_DEFAULT_MTU                 23        /*! Default value of ATT_MTU */
+#define ATT_MAX_MTU                     200       /*! largest frame amdtp_core.c builds */
+#define AMDTP_ACK_SIZE                  20        /*! size of acknowledge buffers */
+
 /*!
  * Macros for converting a little endian byte buffer to integers.
  */
@@ -128,6 +136,10 @@ typedef enum eAmdtpPktType
 typedef enum eAmdtpControl
 {
     AMDTP_CONTROL_RESEND_REQ,       // is actually reset command
+    AMDTP_CONTROL_SEND_READY,
+    AMDTP_CONTROL_WINDOW_REQ,       // [version][window] also used to learn the server version
+    AMDTP_CONTROL_WINDOW_RSP,       // [version][window]
+    AMDTP_CONTROL_WINDOW_ACK,
     AMDTP_CONTROL_MAX
 }eAmdtpControl_t;
 
@@ -175,80 +187,11 @@ typedef struct
 }
 amdtpPacket_t;
 
-/*! Application data reception callback */
-typedef void (*amdtpRecvCback_t)(uint8_t *buf, uint16_t len);
-
-/*! Application data transmission result callback */
-typedef void (*amdtpTransCback_t)(eAmdtpStatus_t status);
-
-typedef void (*amdtp_reply_func_t)(eAmdtpStatus_t status, uint8_t *data, uint16_t len);
-
-typedef void (*amdtp_packet_handler_func_t)(eAmdtpPktType_t type, uint16_t len, uint8_t *buf);
-
-typedef eAmdtpStatus_t (*amdtp_ack_sender_func_t)(eAmdtpPktType_t type, gboolean encrypted, gboolean enableACK, uint8_t *buf, uint16_t len);
-
-typedef void (*amdtp_data_sender_func_t)(uint8_t *buf, uint16_t len);
-
-// already defined in #include "../gattrib.h"
-typedef void (*GAttribResultFunc) (guint8 status, const guint8 *pdu, guint16 len, gpointer user_data);
-
-typedef struct
-{
-    eAmdtpState_t   txState;
-    eAmdtpState_t   rxState;
-    eAmdtpState_t   AckState;
-    gboolean        txReady;               // TRUE if ready to send notifications
-    amdtpPacket_t   rxPkt;
-    amdtpPacket_t   txPkt;
-    amdtpPacket_t   ackPkt;
-    uint8_t         LastRxPktType;         // hold last received packet type for easier parsing
-    uint8_t         TxPktType;             // current transmit package type
-    uint8_t         txPktSn;               // data packet serial number for Tx
-    eAmdtpPktType_t lastRxPktSn;           // last received data packet serial number
-    uint16_t        attMtuSize;            // max MTU size to break long message
-    uint16_t        TX_handle;
-    uint16_t        RX_handle;
-    uint16_t        ACK_handle;
-    uint16_t        ACK_CCChandle;
-    uint16_t        TX_CCChandle;
-    time_t          AckTime;
-
-}
-amdtpCb_t;
-
-
-//*****************************************************************************
-//
-// function definitions
-//
-//*****************************************************************************
-
-void
-AmdtpBuildPkt(amdtpCb_t *amdtpCb, eAmdtpPktType_t type, gboolean encrypted, gboolean enableACK, uint8_t *buf, uint16_t len);
-
-gboolean
-amdtc_init(amdtpCb_t *amdtpCb);
-
-eAmdtpStatus_t
-AmdtpReceivePkt(amdtpCb_t *amdtpCb, amdtpPacket_t *pkt, uint16_t len, uint8_t *pValue);
-
-void
-AmdtpSendReply(amdtpCb_t *amdtpCb, eAmdtpStatus_t status, uint8_t *data, uint16_t len, gboolean enableACK);
-
-static eAmdtpStatus_t
-amdtpcSendAck(amdtpCb_t *amdtpCb, eAmdtpPktType_t type, gboolean encrypted, gboolean enableACK, uint8_t *buf, uint16_t len);
-
-void
-AmdtpSendControl(amdtpCb_t *amdtpCb, eAmdtpControl_t control, uint8_t *data, uint16_t len);
-
-void
-AmdtpSendPacketHandler(amdtpCb_t *amdtpCb, GAttribResultFunc callback);
-
-void
-AmdtpPacketHandler(amdtpCb_t *amdtpCb);
+/*! stream : part of a received stream, offset is the position in the stream */
+typedef void (*amdtp_stream_sink_func_t)(uint8_t *buf, uint16_t len, uint32_t offset);
 
-void
-resetPkt(amdtpPacket_t *pkt);
+/*! stream : received (status AMDTP_STATUS_RECEIVE_DONE) or sent stream is done */
+typedef void (*amdtp_stream_done_func_t)(eAmdtpStatus_t status, uint32_t len);
 
 #ifdef __cplusplus
 }
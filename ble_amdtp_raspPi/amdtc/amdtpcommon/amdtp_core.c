@@ -0,0 +1,1895 @@
+// ****************************************************************************
+//
+//  amdtp_core.c
+//! @file
+//!
+//! @brief Transport independent AMDTP protocol core.
+//!
+//! See amdtp_core.h for the two transfer modes and the negotiation.
+//!
+//! The stop-and-wait part is the state machine that was in AMDTPS and AMDTPC,
+//! with the static variables moved into the context.
+//!
+//! added paulvha / October 2026
+//
+// ****************************************************************************
+
+#include <string.h>
+#include "amdtp_core.h"
+#include "crc32.h"
+#include "amdtp_lz.h"
+
+#if (AMDTP_CORE_PACKET_SIZE + ATT_DEFAULT_MTU - 4 - AMDTP_WIN_EXT_HDR_SIZE) / \
+    (ATT_DEFAULT_MTU - 3 - AMDTP_WIN_EXT_HDR_SIZE) > AMDTP_WIN_MAX_CHUNKS
+#error "a packet needs more window frames than fit in the bitmaps"
+#endif
+
+#define CHUNK_BIT(n)        ((uint64_t)1 << (n))
+#define ALL_CHUNKS(n)       ((n) >= 64 ? ~(uint64_t)0 : CHUNK_BIT(n) - 1)
+
+static void legacySendNext(amdtpCore_t *core);
+static void winStart(amdtpCore_t *core);
+static void winPump(amdtpCore_t *core);
+static void streamFlush(amdtpCore_t *core);
+
+//*****************************************************************************
+//
+// helpers
+//
+//*****************************************************************************
+static void
+resetPkt(amdtpPacket_t *pkt)
+{
+    pkt->offset = 0;
+    pkt->header.pktType = AMDTP_PKT_TYPE_UNKNOWN;
+    pkt->len = 0;
+}
+
+static uint8_t
+countChunks(uint64_t map)
+{
+    uint8_t n = 0;
+
+    while (map)
+    {
+        map &= map - 1;
+        n++;
+    }
+    return n;
+}
+
+static void
+setTimer(amdtpCore_t *core, uint32_t ms)
+{
+    if (core->cb.timer)
+    {
+        core->cb.timer(core->cb.user, ms);
+    }
+}
+
+static uint8_t
+ackEvery(amdtpCore_t *core)
+{
+    return core->window > 2 ? core->window / 2 : 1;
+}
+
+static void
+putUint32(uint8_t *p, uint32_t n)
+{
+    p[0] = n & 0xff;
+    p[1] = (n >> 8) & 0xff;
+    p[2] = (n >> 16) & 0xff;
+    p[3] = (n >> 24) & 0xff;
+}
+
+//*****************************************************************************
+//
+// build a packet : length, header, data, CRC
+// flags are extra header bits (PACKET_STREAM_BIT_MASK). buf can already be
+// at the data position in pkt, it is then not moved.
+// return the number of bytes in pkt
+//
+//*****************************************************************************
+static uint16_t
+buildPkt(uint8_t *pkt, eAmdtpPktType_t type, uint8_t sn, uint8_t flags, bool enableACK, uint8_t *buf, uint16_t len)
+{
+    uint16_t header;
+    uint32_t calDataCrc;
+
+    header = (type << PACKET_TYPE_BIT_OFFSET) | ((sn & 0xf) << PACKET_SN_BIT_OFFSET) | flags;
+
+    if (enableACK)
+    {
+        header |= PACKET_ACK_BIT_MASK;
+    }
+
+    pkt[0] = (len + AMDTP_CRC_SIZE_IN_PKT) & 0xff;
+    pkt[1] = ((len + AMDTP_CRC_SIZE_IN_PKT) >> 8) & 0xff;
+    pkt[2] = header & 0xff;
+    pkt[3] = header >> 8;
+
+    if (buf != &pkt[AMDTP_PREFIX_SIZE_IN_PKT])
+    {
+        memmove(&pkt[AMDTP_PREFIX_SIZE_IN_PKT], buf, len);
+    }
+    calDataCrc = AmdtpCrc32(0, &pkt[AMDTP_PREFIX_SIZE_IN_PKT], len);
+
+    pkt[AMDTP_PREFIX_SIZE_IN_PKT + len] = calDataCrc & 0xff;
+    pkt[AMDTP_PREFIX_SIZE_IN_PKT + len + 1] = (calDataCrc >> 8) & 0xff;
+    pkt[AMDTP_PREFIX_SIZE_IN_PKT + len + 2] = (calDataCrc >> 16) & 0xff;
+    pkt[AMDTP_PREFIX_SIZE_IN_PKT + len + 3] = (calDataCrc >> 24) & 0xff;
+
+    return len + AMDTP_PREFIX_SIZE_IN_PKT + AMDTP_CRC_SIZE_IN_PKT;
+}
+
+//*****************************************************************************
+//
+// send an ACK (status) or CONTROL (control code) packet with optional data
+//
+//*****************************************************************************
+static void
+sendAck(amdtpCore_t *core, eAmdtpPktType_t type, uint8_t code, uint8_t *data, uint16_t len)
+{
+    uint8_t buf[AMDTP_ACK_SIZE - AMDTP_PREFIX_SIZE_IN_PKT - AMDTP_CRC_SIZE_IN_PKT] = {0};
+    uint16_t pktLen;
+
+    if (len > sizeof(buf) - 1)
+    {
+        return;
+    }
+
+    buf[0] = code;
+    if (len > 0) memcpy(buf + 1, data, len);
+
+    pktLen = buildPkt(core->txAckBuf, type, 0, 0, false, buf, len + 1);
+
+    core->stats.controlSent++;
+
+    // the transport is full : keep it for AmdtpCorePump(), a newer one replaces it
+    core->txAckLen = 0;
+    if (! core->cb.send(core->cb.user, type, core->txAckBuf, pktLen))
+    {
+        core->txAckLen = (uint8_t) pktLen;
+        core->txAckType = (uint8_t) type;
+    }
+}
+
+// send the ACK / CONTROL the transport refused, false if it is still full
+static bool
+ackFlush(amdtpCore_t *core)
+{
+    if (core->txAckLen == 0)
+    {
+        return true;
+    }
+
+    if (! core->cb.send(core->cb.user, (eAmdtpPktType_t) core->txAckType, core->txAckBuf, core->txAckLen))
+    {
+        return false;
+    }
+
+    core->txAckLen = 0;
+    return true;
+}
+
+static void
+sendReply(amdtpCore_t *core, eAmdtpStatus_t status)
+{
+    sendAck(core, AMDTP_PKT_TYPE_ACK, status, NULL, 0);
+}
+
+//*****************************************************************************
+//
+// a frame that holds a complete ACK or CONTROL packet with a correct CRC
+//
+//*****************************************************************************
+static bool
+isAckFrame(uint8_t *buf, uint16_t len)
+{
+    uint16_t pktLen, header;
+    uint32_t peerCrc;
+    uint8_t type;
+
+    if (len < AMDTP_PREFIX_SIZE_IN_PKT + AMDTP_CRC_SIZE_IN_PKT + 1 || len > AMDTP_ACK_SIZE)
+    {
+        return false;
+    }
+
+    BYTES_TO_UINT16(pktLen, buf);
+    BYTES_TO_UINT16(header, &buf[2]);
+    type = (header & PACKET_TYPE_BIT_MASK) >> PACKET_TYPE_BIT_OFFSET;
+
+    if (pktLen + AMDTP_PREFIX_SIZE_IN_PKT != len ||
+        (type != AMDTP_PKT_TYPE_ACK && type != AMDTP_PKT_TYPE_CONTROL))
+    {
+        return false;
+    }
+
+    BYTES_TO_UINT32(peerCrc, &buf[len - AMDTP_CRC_SIZE_IN_PKT]);
+    return peerCrc == AmdtpCrc32(0, &buf[AMDTP_PREFIX_SIZE_IN_PKT], pktLen - AMDTP_CRC_SIZE_IN_PKT);
+}
+
+//*****************************************************************************
+//
+// encryption : the session key is AES(key, random client | random server)
+//
+//*****************************************************************************
+static void
+secStart(amdtpCore_t *core, const uint8_t *skdClient, const uint8_t *skdServer, bool initiator)
+{
+    amdtpCcmKey_t ltk;
+    uint8_t sk[AMDTP_CCM_KEY_SIZE];
+
+    memcpy(sk, skdClient, AMDTP_SEC_SKD_SIZE);
+    memcpy(&sk[AMDTP_SEC_SKD_SIZE], skdServer, AMDTP_SEC_SKD_SIZE);
+
+    AmdtpCcmSetKey(&ltk, core->key);
+    AmdtpCcmBlock(&ltk, sk, sk);
+    AmdtpCcmSetKey(&core->sessionKey, sk);
+
+    memset(&ltk, 0, sizeof(ltk));
+    memset(sk, 0, sizeof(sk));
+
+    core->secure = true;
+    core->initiator = initiator;
+    core->txCounter = 0;
+    core->rxCounterValid = false;
+}
+
+// the nonce is [counter][direction], 1 for the packets of the initiator
+static void
+secNonce(uint8_t *nonce, uint32_t counter, bool initiator)
+{
+    memset(nonce, 0, AMDTP_CCM_NONCE_SIZE);
+    putUint32(nonce, counter);
+    nonce[AMDTP_SEC_CTR_SIZE] = initiator;
+}
+
+// no data can be sent with a key until the session key is agreed
+static bool
+secBlocked(amdtpCore_t *core)
+{
+    return core->keySet && (! core->secure || core->txCounter == 0xFFFFFFFFU);
+}
+
+//*****************************************************************************
+//
+// encrypt len bytes at p + AMDTP_SEC_CTR_SIZE in place, counter in front and
+// MIC after the data. flags are the header bits.
+//
+//*****************************************************************************
+static void
+secSeal(amdtpCore_t *core, uint8_t *p, uint16_t len, uint8_t flags)
+{
+    uint8_t nonce[AMDTP_CCM_NONCE_SIZE];
+    uint8_t aad = flags & (PACKET_STREAM_BIT_MASK | PACKET_COMPRESS_BIT_MASK);
+
+    secNonce(nonce, core->txCounter, core->initiator);
+    putUint32(p, core->txCounter++);
+
+    AmdtpCcmEncrypt(&core->sessionKey, nonce, &aad, 1, p + AMDTP_SEC_CTR_SIZE, len,
+                    p + AMDTP_SEC_CTR_SIZE + len, AMDTP_SEC_MIC_SIZE);
+}
+
+//*****************************************************************************
+//
+// decrypt a received packet [counter][data][MIC] in place
+// return false when it has to be dropped
+//
+//*****************************************************************************
+static bool
+secOpen(amdtpCore_t *core, uint16_t header, uint8_t *buf, uint16_t len)
+{
+    uint8_t nonce[AMDTP_CCM_NONCE_SIZE];
+    uint8_t aad = header & (PACKET_STREAM_BIT_MASK | PACKET_COMPRESS_BIT_MASK);
+    uint32_t counter;
+
+    if (! (header & PACKET_ENCRYPTION_BIT_MASK) || ! core->secure || len < AMDTP_SEC_SIZE)
+    {
+        return false;
+    }
+
+    BYTES_TO_UINT32(counter, buf);
+
+    if (core->rxCounterValid && counter <= core->rxCounter)
+    {
+        return false;               // repeated (or replayed) packet
+    }
+
+    len -= AMDTP_SEC_SIZE;
+    secNonce(nonce, counter, ! core->initiator);
+
+    if (! AmdtpCcmDecrypt(&core->sessionKey, nonce, &aad, 1, buf + AMDTP_SEC_CTR_SIZE, len,
+                          buf + AMDTP_SEC_CTR_SIZE + len, AMDTP_SEC_MIC_SIZE))
+    {
+        return false;
+    }
+
+    core->rxCounter = counter;
+    core->rxCounterValid = true;
+    return true;
+}
+
+//*****************************************************************************
+//
+// transmit is done, report to the front-end
+//
+//*****************************************************************************
+static void
+txDone(amdtpCore_t *core, eAmdtpStatus_t status)
+{
+    bool stream = core->txStreamPkt;
+
+    // an extended receiver must see every new packet as new, also after a
+    // failed one
+    if (status == AMDTP_STATUS_SUCCESS || core->txExt)
+    {
+        core->txPktSn++;            // only 4 bits are part of the header
+    }
+
+    if (status == AMDTP_STATUS_SUCCESS)
+    {
+        core->stats.packetsSent++;
+    }
+
+    if (core->txWindowed)
+    {
+        setTimer(core, 0);
+    }
+
+    core->txState = AMDTP_STATE_TX_IDLE;
+    core->sendingNotComplete = false;
+    core->txStreamPkt = false;
+    resetPkt(&core->txPkt);
+
+    if (stream)
+    {
+        // more of the stream to send
+        if (status == AMDTP_STATUS_SUCCESS && ! core->txStreamLast)
+        {
+            if (core->txStreamFill == AMDTP_STREAM_DATA_SIZE || core->txStreamClosing)
+            {
+                streamFlush(core);
+
+                if (core->cb.writable)
+                {
+                    core->cb.writable(core->cb.user);
+                }
+            }
+            return;
+        }
+
+        // done or failed, the peer will see a new OPEN
+        core->txStreamOpen = false;
+        if (status == AMDTP_STATUS_SUCCESS) core->stats.streamsSent++;
+    }
+
+    if (core->cb.sent)
+    {
+        core->cb.sent(core->cb.user, status);
+    }
+}
+
+//*****************************************************************************
+//
+// start sending a packet that is in buf (which can be txPkt data already)
+//
+//*****************************************************************************
+static void
+startPkt(amdtpCore_t *core, uint8_t *buf, uint16_t len, uint8_t flags)
+{
+    uint8_t *p = &core->txPkt.data[AMDTP_PREFIX_SIZE_IN_PKT];
+    bool enableACK;
+    uint16_t n;
+
+    // compress when the peer can handle it and it makes the packet smaller
+    if (core->localCompress && core->peerVersion >= AMDTP_COMPRESS_MIN_VERSION && len > 1)
+    {
+        n = AmdtpLzCompress(buf, len, core->lzBuf, len - 1);
+
+        if (n > 0)
+        {
+            core->stats.packetsCompressed++;
+            core->stats.bytesSaved += len - n;
+            buf = core->lzBuf;
+            len = n;
+            flags |= PACKET_COMPRESS_BIT_MASK;
+        }
+    }
+
+    // encrypt in place in txPkt, after the compression
+    if (core->secure)
+    {
+        if (buf != p + AMDTP_SEC_CTR_SIZE)
+        {
+            memmove(p + AMDTP_SEC_CTR_SIZE, buf, len);
+        }
+
+        secSeal(core, p, len, flags);
+        buf = p;
+        len += AMDTP_SEC_SIZE;
+        flags |= PACKET_ENCRYPTION_BIT_MASK;
+    }
+
+    core->txWindowed = core->window > 0 && core->attMtuSize >= ATT_DEFAULT_MTU;
+
+    // stop-and-wait : ask for SEND_READY when more than one frame is needed
+    enableACK = ! core->txWindowed &&
+                len + AMDTP_PREFIX_SIZE_IN_PKT + AMDTP_CRC_SIZE_IN_PKT > core->attMtuSize - 3;
+
+    core->txPkt.len = buildPkt(core->txPkt.data, AMDTP_PKT_TYPE_DATA, core->txPktSn & 0xf, flags, enableACK, buf, len);
+    core->txPkt.offset = 0;
+
+    if (core->txWindowed)
+    {
+        winStart(core);
+    }
+    else
+    {
+        legacySendNext(core);
+    }
+}
+
+//*****************************************************************************
+//
+// stream : running CRC32, same result as one AmdtpCrc32() over all data
+//
+//*****************************************************************************
+static uint32_t
+streamCrc(uint32_t crc, const uint8_t *buf, uint16_t len)
+{
+    return AmdtpCrc32(crc, buf, len);
+}
+
+//*****************************************************************************
+//
+// stream : send the staging buffer as the next packet, when TX is idle
+//
+//*****************************************************************************
+static void
+streamFlush(amdtpCore_t *core)
+{
+    // leave room for the packet counter, so the encryption does not move it
+    uint8_t *p = &core->txPkt.data[AMDTP_PREFIX_SIZE_IN_PKT + (core->secure ? AMDTP_SEC_CTR_SIZE : 0)];
+    uint16_t len = 1;
+
+    if (core->txState != AMDTP_STATE_TX_IDLE)
+    {
+        return;
+    }
+
+    p[0] = 0;
+
+    if (core->txStreamFirst)
+    {
+        p[0] |= AMDTP_STREAM_OPEN;
+        putUint32(&p[len], core->txStreamLen);
+        len += 4;
+    }
+
+    if (core->txStreamClosing)
+    {
+        p[0] |= AMDTP_STREAM_CLOSE;
+        putUint32(&p[len], core->txStreamCrc);
+        len += 4;
+    }
+
+    memcpy(&p[len], core->txStreamBuf, core->txStreamFill);
+    len += core->txStreamFill;
+
+    core->txStreamFirst = false;
+    core->txStreamLast = core->txStreamClosing;
+    core->txStreamFill = 0;
+    core->txStreamPkt = true;
+
+    startPkt(core, p, len, PACKET_STREAM_BIT_MASK);
+}
+
+//*****************************************************************************
+//
+// stream : a received stream packet [flags][length][crc][data]
+//
+//*****************************************************************************
+static void
+streamEnd(amdtpCore_t *core, eAmdtpStatus_t status)
+{
+    core->rxStreamOpen = false;
+
+    if (status == AMDTP_STATUS_SUCCESS) core->stats.streamsReceived++;
+
+    if (core->cb.streamDone)
+    {
+        core->cb.streamDone(core->cb.user, status, core->rxStreamCount);
+    }
+}
+
+static void
+streamReceive(amdtpCore_t *core, uint8_t *buf, uint16_t len)
+{
+    uint8_t flags;
+    uint16_t idx = 1;
+    uint32_t peerCrc = 0;
+
+    if (core->cb.streamReceived == NULL || len < 1)
+    {
+        return;
+    }
+
+    flags = buf[0];
+
+    if (flags & AMDTP_STREAM_OPEN)
+    {
+        if (len < idx + 4) return;
+
+        if (core->rxStreamOpen)
+        {
+            streamEnd(core, AMDTP_STATUS_UNKNOWN_ERROR);     // the close never came
+        }
+
+        BYTES_TO_UINT32(core->rxStreamLen, &buf[idx]);
+        idx += 4;
+        core->rxStreamOpen = true;
+        core->rxStreamCount = 0;
+        core->rxStreamCrc = 0;
+    }
+
+    if (flags & AMDTP_STREAM_CLOSE)
+    {
+        if (len < idx + 4) return;
+
+        BYTES_TO_UINT32(peerCrc, &buf[idx]);
+        idx += 4;
+    }
+
+    if (! core->rxStreamOpen)
+    {
+        return;                     // missed the start
+    }
+
+    if (len > idx)
+    {
+        core->cb.streamReceived(core->cb.user, &buf[idx], len - idx, core->rxStreamCount);
+        core->rxStreamCrc = streamCrc(core->rxStreamCrc, &buf[idx], len - idx);
+        core->rxStreamCount += len - idx;
+    }
+
+    if (core->rxStreamLen != AMDTP_STREAM_LEN_UNKNOWN && core->rxStreamCount > core->rxStreamLen)
+    {
+        streamEnd(core, AMDTP_STATUS_INVALID_PKT_LENGTH);
+    }
+    else if (flags & AMDTP_STREAM_CLOSE)
+    {
+        if (core->rxStreamLen != AMDTP_STREAM_LEN_UNKNOWN && core->rxStreamCount != core->rxStreamLen)
+        {
+            streamEnd(core, AMDTP_STATUS_INVALID_PKT_LENGTH);
+        }
+        else
+        {
+            streamEnd(core, peerCrc == core->rxStreamCrc ? AMDTP_STATUS_SUCCESS : AMDTP_STATUS_CRC_ERROR);
+        }
+    }
+}
+
+//*****************************************************************************
+//
+// hand a received data packet to the front-end
+//
+//*****************************************************************************
+static void
+deliverPkt(amdtpCore_t *core, uint16_t header, uint8_t *buf, uint16_t len)
+{
+    // with a key only encrypted packets are accepted
+    if (core->keySet || (header & PACKET_ENCRYPTION_BIT_MASK))
+    {
+        if (! secOpen(core, header, buf, len))
+        {
+            core->stats.authErrors++;
+            return;
+        }
+
+        buf += AMDTP_SEC_CTR_SIZE;
+        len -= AMDTP_SEC_SIZE;
+    }
+
+    if (header & PACKET_COMPRESS_BIT_MASK)
+    {
+        len = AmdtpLzDecompress(buf, len, core->rxPlainBuf, sizeof(core->rxPlainBuf));
+
+        if (len == 0)
+        {
+            core->stats.crcErrors++;        // the peer made a mistake, nothing to deliver
+            return;
+        }
+
+        buf = core->rxPlainBuf;
+    }
+
+    if (header & PACKET_STREAM_BIT_MASK)
+    {
+        streamReceive(core, buf, len);
+    }
+    else
+    {
+        core->cb.received(core->cb.user, buf, len);
+    }
+}
+
+//*****************************************************************************
+//
+// receive : add a part of a packet to the running CRC. The bytes after
+// total - AMDTP_CRC_SIZE_IN_PKT are the CRC of the peer and are kept apart,
+// so the check at the end does not need the whole packet.
+//
+// returns the number of data bytes (without CRC) in the part
+//
+//*****************************************************************************
+static uint16_t
+rxFold(amdtpRxCrc_t *rc, uint16_t offset, uint16_t total, const uint8_t *buf, uint16_t len)
+{
+    uint16_t dataEnd = total > AMDTP_CRC_SIZE_IN_PKT ? total - AMDTP_CRC_SIZE_IN_PKT : 0;
+    uint16_t n = 0, i;
+
+    if (offset < dataEnd)
+    {
+        n = dataEnd - offset < len ? dataEnd - offset : len;
+        rc->crc = AmdtpCrc32(rc->crc, buf, n);
+    }
+
+    for (i = n; i < len && offset + i < total; i++)
+    {
+        rc->peer[offset + i - dataEnd] = buf[i];
+    }
+
+    return n;
+}
+
+// cut-through : the result of the legacy data packet in progress
+static void
+rxCutEnd(amdtpCore_t *core, amdtpPacket_t *pkt, eAmdtpStatus_t status)
+{
+    uint16_t dataEnd = pkt->len > AMDTP_CRC_SIZE_IN_PKT ? pkt->len - AMDTP_CRC_SIZE_IN_PKT : 0;
+
+    if (pkt != &core->rxPkt || ! core->rxCut)
+    {
+        return;
+    }
+
+    core->rxCut = false;
+
+    if (core->cb.partDone)
+    {
+        core->cb.partDone(core->cb.user, status, pkt->offset < dataEnd ? pkt->offset : dataEnd);
+    }
+}
+
+//*****************************************************************************
+//
+// window mode : transmit
+//
+//*****************************************************************************
+static void
+winStart(amdtpCore_t *core)
+{
+    uint16_t mtu = core->attMtuSize > ATT_MAX_MTU ? ATT_MAX_MTU : core->attMtuSize;
+
+    core->txExt = core->peerVersion >= AMDTP_EXTSN_MIN_VERSION;
+    core->txChunkSize = mtu - 3 - (core->txExt ? AMDTP_WIN_EXT_HDR_SIZE : AMDTP_WIN_HDR_SIZE);
+    core->txChunks = (core->txPkt.len + core->txChunkSize - 1) / core->txChunkSize;
+    core->txAcked = 0;
+    core->txSent = 0;
+    core->txPending = ALL_CHUNKS(core->txChunks);
+    core->txFastResent = 0;
+    core->txRetries = 0;
+    core->txBlocked = false;
+    core->txState = AMDTP_STATE_SENDING;
+
+    winPump(core);
+}
+
+static bool
+winSendChunk(amdtpCore_t *core, uint8_t idx)
+{
+    uint16_t offset = idx * core->txChunkSize;
+    uint16_t size = core->txPkt.len - offset;
+    uint8_t hdr = AMDTP_WIN_HDR_SIZE;
+
+    if (size > core->txChunkSize)
+    {
+        size = core->txChunkSize;
+    }
+
+    core->txFrame[0] = idx;
+    core->txFrame[1] = AMDTP_WIN_MARK | (core->txPktSn & 0xf);
+    core->txFrame[2] = core->txChunkSize;
+
+    if (core->txExt)
+    {
+        core->txFrame[1] = AMDTP_WIN_EXT_MARK | (core->txPktSn & 0xf);
+        core->txFrame[3] = core->txPktSn & 0xff;
+        core->txFrame[4] = core->txPktSn >> 8;
+        hdr = AMDTP_WIN_EXT_HDR_SIZE;
+    }
+
+    memcpy(&core->txFrame[hdr], &core->txPkt.data[offset], size);
+
+    return core->cb.send(core->cb.user, AMDTP_PKT_TYPE_DATA, core->txFrame, size + hdr);
+}
+
+//*****************************************************************************
+//
+// send pending frames, lowest first, as long as the window allows
+//
+//*****************************************************************************
+static void
+winPump(amdtpCore_t *core)
+{
+    uint64_t all = ALL_CHUNKS(core->txChunks);
+    bool sent = false;
+    uint8_t idx;
+
+    if (core->txState != AMDTP_STATE_SENDING || ! core->txWindowed || core->txBlocked)
+    {
+        return;
+    }
+
+    // a waiting ACK goes before the data, else the peer may never get it
+    if (! ackFlush(core))
+    {
+        core->stats.sendBusy++;
+        core->txBlocked = true;
+        setTimer(core, AMDTP_BUSY_RETRY_MS);
+        return;
+    }
+
+    for (idx = 0; idx < core->txChunks && core->txPending; idx++)
+    {
+        if (! (core->txPending & CHUNK_BIT(idx)))
+        {
+            continue;
+        }
+
+        // frames sent, not confirmed and not to be repeated
+        if (countChunks(all & ~core->txAcked & ~core->txPending) >= core->window)
+        {
+            break;
+        }
+
+        if (! winSendChunk(core, idx))
+        {
+            // transport is full, try again soon
+            core->stats.sendBusy++;
+            core->txBlocked = true;
+            setTimer(core, AMDTP_BUSY_RETRY_MS);
+            return;
+        }
+
+        if (core->txSent & CHUNK_BIT(idx))
+        {
+            core->stats.framesResent++;
+        }
+
+        core->stats.framesSent++;
+        core->txSent |= CHUNK_BIT(idx);
+        core->txPending &= ~CHUNK_BIT(idx);
+        sent = true;
+    }
+
+    if (sent)
+    {
+        setTimer(core, AMDTP_RETX_TIMEOUT_MS);
+    }
+}
+
+// an answer is for the packet in progress : all 16 bits of the sn when the
+// receiver sent them (extended), else the 4 bits of the header
+static bool
+winSnMatch(amdtpCore_t *core, uint16_t sn, bool ext)
+{
+    return ext ? sn == core->txPktSn : sn == (core->txPktSn & 0xf);
+}
+
+//*****************************************************************************
+//
+// WINDOW_ACK : [sn][cumulative][bitmap] (extended : + [sn high byte])
+// frames 0 .. cumulative - 1 are received, bit n of the bitmap is frame
+// cumulative + 1 + n. Frames missing below the highest received are repeated
+// once, until the next timeout.
+//
+//*****************************************************************************
+static void
+winAck(amdtpCore_t *core, uint16_t sn, bool ext, uint8_t cum, uint32_t map)
+{
+    uint64_t all = ALL_CHUNKS(core->txChunks);
+    uint64_t acked, gap;
+    uint8_t highest = 0;
+
+    if (core->txState != AMDTP_STATE_SENDING || ! core->txWindowed ||
+        ! winSnMatch(core, sn, ext) || cum > core->txChunks)
+    {
+        return;
+    }
+
+    acked = ALL_CHUNKS(cum);
+    if (cum + 1 < 64)
+    {
+        acked |= (uint64_t)map << (cum + 1);
+    }
+    acked &= all;
+
+    if (acked & ~core->txAcked)
+    {
+        core->txRetries = 0;
+        if (! core->txBlocked)
+        {
+            setTimer(core, AMDTP_RETX_TIMEOUT_MS);
+        }
+    }
+
+    core->txAcked |= acked;
+    core->txPending &= ~core->txAcked;
+
+    for (uint8_t i = 0; i < core->txChunks; i++)
+    {
+        if (core->txAcked & CHUNK_BIT(i)) highest = i;
+    }
+
+    gap = ALL_CHUNKS(highest) & core->txSent & ~core->txAcked & ~core->txPending & ~core->txFastResent;
+    core->txPending |= gap;
+    core->txFastResent |= gap;
+
+    winPump(core);
+}
+
+//*****************************************************************************
+//
+// final ACK of a window packet : [status][sn] (extended : [status][sn 16 bits])
+//
+//*****************************************************************************
+static void
+winFinalAck(amdtpCore_t *core, eAmdtpStatus_t status, uint16_t sn, bool ext)
+{
+    if (! winSnMatch(core, sn, ext))
+    {
+        return;                     // late answer on an earlier packet
+    }
+
+    if (status == AMDTP_STATUS_CRC_ERROR || status == AMDTP_STATUS_RESEND_REPLY)
+    {
+        // send the whole packet again
+        core->txAcked = 0;
+        core->txPending = ALL_CHUNKS(core->txChunks);
+        core->txFastResent = 0;
+        winPump(core);
+        return;
+    }
+
+    txDone(core, status);
+}
+
+//*****************************************************************************
+//
+// window mode : receive
+//
+//*****************************************************************************
+
+// add the frames that follow on the frames done to the CRC (and give them
+// cut-through), needs frame 0 for the length
+static void
+winFold(amdtpCore_t *core)
+{
+    uint16_t pktLen, dataEnd, start, end;
+
+    if (core->rxWinChunks == 0)
+    {
+        return;
+    }
+
+    BYTES_TO_UINT16(pktLen, core->rxPktBuf);
+    dataEnd = pktLen + AMDTP_PREFIX_SIZE_IN_PKT - AMDTP_CRC_SIZE_IN_PKT;
+
+    while (core->rxWinFolded < core->rxWinChunks && (core->rxWinMap & CHUNK_BIT(core->rxWinFolded)))
+    {
+        start = core->rxWinFolded * core->rxWinChunkSize;
+        end = start + core->rxWinChunkSize;
+
+        if (start < AMDTP_PREFIX_SIZE_IN_PKT) start = AMDTP_PREFIX_SIZE_IN_PKT;
+        if (end > dataEnd) end = dataEnd;
+
+        if (start < end)
+        {
+            core->rxWinCrc = AmdtpCrc32(core->rxWinCrc, &core->rxPktBuf[start], end - start);
+
+            if (core->rxWinCut)
+            {
+                core->cb.partReceived(core->cb.user, &core->rxPktBuf[start], end - start,
+                                      start - AMDTP_PREFIX_SIZE_IN_PKT);
+            }
+        }
+
+        core->rxWinFolded++;
+    }
+}
+
+// cut-through : the result of the window packet in progress
+static void
+winCutEnd(amdtpCore_t *core, eAmdtpStatus_t status)
+{
+    uint16_t pktLen, done;
+
+    if (! core->rxWinCut)
+    {
+        return;
+    }
+
+    core->rxWinCut = false;
+
+    BYTES_TO_UINT16(pktLen, core->rxPktBuf);
+    pktLen -= AMDTP_CRC_SIZE_IN_PKT;
+    done = core->rxWinFolded * core->rxWinChunkSize;
+    done = done > AMDTP_PREFIX_SIZE_IN_PKT ? done - AMDTP_PREFIX_SIZE_IN_PKT : 0;
+
+    if (core->cb.partDone)
+    {
+        core->cb.partDone(core->cb.user, status, done < pktLen ? done : pktLen);
+    }
+}
+
+static void
+winSendAck(amdtpCore_t *core)
+{
+    uint8_t data[7];
+    uint8_t cum = 0;
+    uint32_t map = 0;
+
+    while (cum < AMDTP_WIN_MAX_CHUNKS && (core->rxWinMap & CHUNK_BIT(cum)))
+    {
+        cum++;
+    }
+
+    if (cum + 1 < 64)
+    {
+        map = (uint32_t)(core->rxWinMap >> (cum + 1));
+    }
+
+    data[0] = core->rxWinSn & 0xff;
+    data[1] = cum;
+    data[2] = map & 0xff;
+    data[3] = (map >> 8) & 0xff;
+    data[4] = (map >> 16) & 0xff;
+    data[5] = (map >> 24) & 0xff;
+    data[6] = core->rxWinSn >> 8;
+
+    core->rxWinNew = 0;
+    sendAck(core, AMDTP_PKT_TYPE_CONTROL, AMDTP_CONTROL_WINDOW_ACK, data, core->rxWinExt ? 7 : 6);
+}
+
+static void
+winSendFinal(amdtpCore_t *core, eAmdtpStatus_t status, uint16_t sn, bool ext)
+{
+    uint8_t data[2];
+
+    data[0] = sn & 0xff;
+    data[1] = sn >> 8;
+    sendAck(core, AMDTP_PKT_TYPE_ACK, status, data, ext ? 2 : 1);
+}
+
+// extended frame : is it of a packet that is done or older than the one in
+// progress. The serial numbers are compared modulo 16 bits
+static bool
+winStale(amdtpCore_t *core, uint16_t sn)
+{
+    if (core->rxExtSnValid && (int16_t)(sn - core->lastRxExtSn) <= 0)
+    {
+        // the final ACK got lost and the sender repeats the last packet
+        if (sn == core->lastRxExtSn && ! core->rxWinActive)
+        {
+            core->stats.framesDuplicate++;
+            winSendFinal(core, AMDTP_STATUS_SUCCESS, sn, true);
+            return true;
+        }
+
+        core->stats.framesStale++;
+        return true;
+    }
+
+    if (core->rxWinActive && core->rxWinExt && (int16_t)(sn - core->rxWinSn) < 0)
+    {
+        core->stats.framesStale++;
+        return true;
+    }
+
+    return false;
+}
+
+static eAmdtpStatus_t
+winReceive(amdtpCore_t *core, uint8_t *buf, uint16_t len)
+{
+    bool ext = buf[1] < AMDTP_WIN_MARK;
+    uint8_t hdr = ext ? AMDTP_WIN_EXT_HDR_SIZE : AMDTP_WIN_HDR_SIZE;
+    uint8_t idx = buf[0];
+    uint16_t sn = buf[1] & 0xf;
+    uint8_t chunkSize = buf[2];
+    uint8_t *data = &buf[hdr];
+    uint16_t dlen = len - hdr;
+    uint16_t pktLen, header;
+    uint32_t peerCrc;
+    bool gap;
+
+    core->stats.framesReceived++;
+
+    if (len <= hdr || chunkSize == 0 || dlen > chunkSize || idx >= AMDTP_WIN_MAX_CHUNKS ||
+        idx * chunkSize + dlen > AMDTP_CORE_PACKET_SIZE)
+    {
+        return AMDTP_STATUS_INVALID_PKT_LENGTH;
+    }
+
+    if (ext)
+    {
+        sn = buf[3] | (uint16_t) buf[4] << 8;
+
+        if ((sn & 0xf) != (buf[1] & 0xf))
+        {
+            return AMDTP_STATUS_INVALID_PKT_LENGTH;
+        }
+
+        if (winStale(core, sn))
+        {
+            return AMDTP_STATUS_SUCCESS;
+        }
+    }
+
+    if (! core->rxWinActive || sn != core->rxWinSn || ext != core->rxWinExt)
+    {
+        // a frame of the last packet : the final ACK got lost and the sender
+        // repeats, or (with a new packet in progress) a late copy
+        if (! ext && core->rxSnValid && sn == core->lastRxPktSn)
+        {
+            core->stats.framesDuplicate++;
+            if (! core->rxWinActive)
+            {
+                winSendFinal(core, AMDTP_STATUS_SUCCESS, sn, false);
+            }
+            return AMDTP_STATUS_SUCCESS;
+        }
+
+        // new packet (an unfinished one is abandoned)
+        winCutEnd(core, AMDTP_STATUS_UNKNOWN_ERROR);
+        core->rxWinActive = true;
+        core->rxWinExt = ext;
+        core->rxWinSn = sn;
+        core->rxWinChunkSize = chunkSize;
+        core->rxWinChunks = 0;
+        core->rxWinHighest = 0;
+        core->rxWinNew = 0;
+        core->rxWinMap = 0;
+        core->rxWinFolded = 0;
+        core->rxWinCrc = 0;
+    }
+
+    if (chunkSize != core->rxWinChunkSize)
+    {
+        return AMDTP_STATUS_INVALID_PKT_LENGTH;
+    }
+
+    if (core->rxWinMap & CHUNK_BIT(idx))
+    {
+        // the sender missed our WINDOW_ACK
+        core->stats.framesDuplicate++;
+        winSendAck(core);
+        return AMDTP_STATUS_RECEIVE_CONTINUE;
+    }
+
+    gap = core->rxWinMap ? idx > core->rxWinHighest + 1 : idx > 0;
+
+    if (core->rxWinMap && idx < core->rxWinHighest)
+    {
+        core->stats.framesReordered++;
+    }
+
+    if (idx > core->rxWinHighest) core->rxWinHighest = idx;
+
+    memcpy(&core->rxPktBuf[idx * chunkSize], data, dlen);
+    core->rxWinMap |= CHUNK_BIT(idx);
+    core->rxWinNew++;
+
+    // the first frame holds the length
+    if (idx == 0)
+    {
+        if (dlen < AMDTP_PREFIX_SIZE_IN_PKT)
+        {
+            core->rxWinActive = false;
+            winSendFinal(core, AMDTP_STATUS_INVALID_PKT_LENGTH, sn, ext);
+            return AMDTP_STATUS_INVALID_PKT_LENGTH;
+        }
+
+        BYTES_TO_UINT16(pktLen, core->rxPktBuf);
+        pktLen += AMDTP_PREFIX_SIZE_IN_PKT;
+
+        if (pktLen > AMDTP_CORE_PACKET_SIZE || pktLen < AMDTP_PREFIX_SIZE_IN_PKT + AMDTP_CRC_SIZE_IN_PKT)
+        {
+            core->rxWinActive = false;
+            winSendFinal(core, AMDTP_STATUS_INSUFFICIENT_BUFFER, sn, ext);
+            return AMDTP_STATUS_INSUFFICIENT_BUFFER;
+        }
+
+        core->rxWinChunks = (pktLen + chunkSize - 1) / chunkSize;
+
+        BYTES_TO_UINT16(header, &core->rxPktBuf[2]);
+        core->rxWinCut = core->cb.partReceived != NULL && ! core->keySet &&
+                ! (header & (PACKET_STREAM_BIT_MASK | PACKET_COMPRESS_BIT_MASK | PACKET_ENCRYPTION_BIT_MASK)) &&
+                (header & PACKET_TYPE_BIT_MASK) >> PACKET_TYPE_BIT_OFFSET == AMDTP_PKT_TYPE_DATA;
+    }
+
+    winFold(core);
+
+    if (core->rxWinChunks == 0 ||
+        (core->rxWinMap & ALL_CHUNKS(core->rxWinChunks)) != ALL_CHUNKS(core->rxWinChunks))
+    {
+        if (gap || core->rxWinNew >= ackEvery(core))
+        {
+            winSendAck(core);
+        }
+        return AMDTP_STATUS_RECEIVE_CONTINUE;
+    }
+
+    // complete, the CRC was calculated as the frames came in
+    core->rxWinActive = false;
+
+    BYTES_TO_UINT16(pktLen, core->rxPktBuf);
+    BYTES_TO_UINT16(header, &core->rxPktBuf[2]);
+    pktLen -= AMDTP_CRC_SIZE_IN_PKT;
+
+    BYTES_TO_UINT32(peerCrc, &core->rxPktBuf[AMDTP_PREFIX_SIZE_IN_PKT + pktLen]);
+
+    if (peerCrc != core->rxWinCrc ||
+        (header & PACKET_TYPE_BIT_MASK) >> PACKET_TYPE_BIT_OFFSET != AMDTP_PKT_TYPE_DATA)
+    {
+        core->stats.crcErrors++;
+        winCutEnd(core, AMDTP_STATUS_CRC_ERROR);
+        winSendFinal(core, AMDTP_STATUS_CRC_ERROR, sn, ext);
+        return AMDTP_STATUS_CRC_ERROR;
+    }
+
+    if (ext)
+    {
+        core->lastRxExtSn = sn;
+        core->rxExtSnValid = true;
+    }
+
+    core->lastRxPktSn = sn & 0xf;
+    core->rxSnValid = true;
+    core->stats.packetsReceived++;
+    winSendFinal(core, AMDTP_STATUS_SUCCESS, sn, ext);
+
+    if (core->rxWinCut)
+    {
+        winCutEnd(core, AMDTP_STATUS_SUCCESS);
+    }
+    else
+    {
+        deliverPkt(core, header, &core->rxPktBuf[AMDTP_PREFIX_SIZE_IN_PKT], pktLen);
+    }
+
+    return AMDTP_STATUS_RECEIVE_DONE;
+}
+
+//*****************************************************************************
+//
+// stop-and-wait : send the next frame of the packet, wait for SEND_READY
+//
+//*****************************************************************************
+static void
+legacySendNext(amdtpCore_t *core)
+{
+    amdtpPacket_t *txPkt = &core->txPkt;
+    uint16_t transferSize;
+    uint16_t remainingBytes;
+
+    if (core->txState == AMDTP_STATE_TX_IDLE)
+    {
+        txPkt->offset = 0;
+        core->txState = AMDTP_STATE_SENDING;
+        core->txChunkCount = 0;
+    }
+
+    if (core->txState != AMDTP_STATE_SENDING || txPkt->offset >= txPkt->len)
+    {
+        return;
+    }
+
+    // send small pieces of the packet. It just restricts sending to mtusize -3
+    remainingBytes = txPkt->len - txPkt->offset;
+    transferSize = ((core->attMtuSize - 3) > remainingBytes) ? remainingBytes : (core->attMtuSize - 3);
+
+    core->cb.send(core->cb.user, AMDTP_PKT_TYPE_DATA, &txPkt->data[txPkt->offset], transferSize);
+    core->stats.framesSent++;
+
+    txPkt->offset += transferSize;
+
+    if (txPkt->offset >= txPkt->len)
+    {
+        core->txState = AMDTP_STATE_WAITING_ACK;
+        core->sendingNotComplete = false;
+    }
+    else
+    {
+        core->txChunkCount++;
+        core->sendingNotComplete = true;
+    }
+}
+
+//*****************************************************************************
+//
+// a complete ACK packet was received
+//
+//*****************************************************************************
+static void
+ackReceived(amdtpCore_t *core, uint8_t *buf, uint16_t len)
+{
+    eAmdtpStatus_t status = (eAmdtpStatus_t) buf[0];
+
+    // the answer to the RESEND_REQ of a reset comes before any ACK of a new packet
+    if (core->txResetReq)
+    {
+        core->txResetReq = false;
+        return;
+    }
+
+    if (core->txState == AMDTP_STATE_TX_IDLE)
+    {
+        return;                     // unexpected ACK
+    }
+
+    if (core->txWindowed)
+    {
+        if (len > 2)
+        {
+            winFinalAck(core, status, buf[1] | (uint16_t) buf[2] << 8, true);
+        }
+        else
+        {
+            winFinalAck(core, status, len > 1 ? buf[1] : core->txPktSn & 0xf, false);
+        }
+        return;
+    }
+
+    core->txState = AMDTP_STATE_TX_IDLE;
+
+    if (status == AMDTP_STATUS_CRC_ERROR || status == AMDTP_STATUS_RESEND_REPLY)
+    {
+        legacySendNext(core);       // resend packet
+    }
+    else
+    {
+        txDone(core, status);
+    }
+}
+
+// a new negotiation : the peer may count its serial numbers from 0 again
+static void
+winRxRestart(amdtpCore_t *core)
+{
+    winCutEnd(core, AMDTP_STATUS_UNKNOWN_ERROR);
+    core->rxWinActive = false;
+    core->rxExtSnValid = false;
+}
+
+//*****************************************************************************
+//
+// a complete CONTROL packet was received
+//
+//*****************************************************************************
+static void
+controlReceived(amdtpCore_t *core, uint8_t *buf, uint16_t len)
+{
+    uint8_t data[2 + AMDTP_SEC_SKD_SIZE];
+    uint16_t dlen;
+
+    switch ((eAmdtpControl_t) buf[0])
+    {
+        case AMDTP_CONTROL_SEND_READY:
+            // receiver is ready for the next frame. A late one, after the
+            // packet was done or stopped, must not start an empty packet
+            if (! core->txWindowed && core->txState == AMDTP_STATE_SENDING)
+            {
+                legacySendNext(core);
+            }
+            break;
+
+        case AMDTP_CONTROL_RESEND_REQ:
+            if (len < 2) break;
+
+            core->rxCur = NULL;
+            resetPkt(&core->rxPkt);
+
+            if (buf[1] > core->lastRxPktSn)
+            {
+                sendReply(core, AMDTP_STATUS_RESEND_REPLY);
+            }
+            else if (buf[1] == core->lastRxPktSn)
+            {
+                sendReply(core, AMDTP_STATUS_SUCCESS);
+            }
+            break;
+
+        case AMDTP_CONTROL_WINDOW_REQ:
+            if (len < 3) break;
+
+            core->peerVersion = buf[1];
+            core->window = buf[2] < core->localWindow ? buf[2] : core->localWindow;
+            winRxRestart(core);
+            core->secure = false;
+            data[0] = AMDTP_CORE_VERSION;
+            data[1] = core->window;
+            dlen = 2;
+
+            // the client offers a session key, add our part
+            if (len >= 3 + AMDTP_SEC_SKD_SIZE && core->keySet && core->cb.random &&
+                core->peerVersion >= AMDTP_ENCRYPT_MIN_VERSION)
+            {
+                core->cb.random(core->cb.user, &data[2], AMDTP_SEC_SKD_SIZE);
+                secStart(core, &buf[3], &data[2], false);
+                dlen += AMDTP_SEC_SKD_SIZE;
+            }
+
+            sendAck(core, AMDTP_PKT_TYPE_CONTROL, AMDTP_CONTROL_WINDOW_RSP, data, dlen);
+            break;
+
+        case AMDTP_CONTROL_WINDOW_RSP:
+            if (len < 3) break;
+
+            core->peerVersion = buf[1];
+            core->window = buf[2] < core->localWindow ? buf[2] : core->localWindow;
+            winRxRestart(core);
+
+            if (len >= 3 + AMDTP_SEC_SKD_SIZE && core->skdValid)
+            {
+                secStart(core, core->skd, &buf[3], true);
+            }
+            core->skdValid = false;
+            break;
+
+        case AMDTP_CONTROL_WINDOW_ACK:
+        {
+            uint32_t map;
+
+            if (len < 7) break;
+
+            BYTES_TO_UINT32(map, &buf[3]);
+
+            if (len > 7)
+            {
+                winAck(core, buf[1] | (uint16_t) buf[7] << 8, true, buf[2], map);
+            }
+            else
+            {
+                winAck(core, buf[1], false, buf[2], map);
+            }
+        }
+            break;
+
+        default:
+            break;                  // unknown control, ignore
+    }
+}
+
+//*****************************************************************************
+//
+// a complete packet was received (stop-and-wait format)
+//
+//*****************************************************************************
+static void
+packetHandler(amdtpCore_t *core, amdtpPacket_t *pkt, uint16_t len)
+{
+    switch (pkt->header.pktType)
+    {
+        case AMDTP_PKT_TYPE_DATA:
+            core->lastRxPktSn = pkt->header.pktSn;
+            core->rxSnValid = true;
+            core->stats.packetsReceived++;
+
+            sendReply(core, AMDTP_STATUS_SUCCESS);
+
+            if (core->rxCut)
+            {
+                rxCutEnd(core, pkt, AMDTP_STATUS_SUCCESS);
+            }
+            else
+            {
+                deliverPkt(core, pkt->header.reserved | pkt->header.encrypted << PACKET_ENCRYPTION_BIT_OFFSET,
+                           pkt->data, len);
+            }
+            break;
+
+        case AMDTP_PKT_TYPE_ACK:
+            ackReceived(core, pkt->data, len);
+            break;
+
+        case AMDTP_PKT_TYPE_CONTROL:
+            controlReceived(core, pkt->data, len);
+            break;
+
+        default:
+            break;
+    }
+
+    resetPkt(pkt);
+}
+
+//*****************************************************************************
+//
+// stop-and-wait : add a frame to the packet in progress
+//
+//*****************************************************************************
+static eAmdtpStatus_t
+legacyReceive(amdtpCore_t *core, uint8_t *pValue, uint16_t len)
+{
+    amdtpPacket_t *pkt;
+    amdtpRxCrc_t *rc;
+    uint16_t bufSize, n;
+    uint16_t header = 0;
+    uint8_t dataIdx = 0;
+    uint32_t peerCrc;
+
+    // select the buffer on the first frame of a packet
+    if (core->rxCur == NULL)
+    {
+        if (len < AMDTP_PREFIX_SIZE_IN_PKT)
+        {
+            sendReply(core, AMDTP_STATUS_INVALID_PKT_LENGTH);
+            return AMDTP_STATUS_INVALID_PKT_LENGTH;
+        }
+
+        BYTES_TO_UINT16(header, &pValue[2]);
+        if ((header & PACKET_TYPE_BIT_MASK) >> PACKET_TYPE_BIT_OFFSET == AMDTP_PKT_TYPE_DATA)
+        {
+            core->rxCur = &core->rxPkt;
+        }
+        else
+        {
+            core->rxCur = &core->ackPkt;
+        }
+    }
+
+    pkt = core->rxCur;
+    bufSize = (pkt == &core->rxPkt) ? AMDTP_CORE_PACKET_SIZE : AMDTP_ACK_SIZE;
+    rc = (pkt == &core->rxPkt) ? &core->rxPktCrc : &core->rxAckCrc;
+
+    if (pkt->offset == 0)
+    {
+        core->rxChunkCount = 0;
+        BYTES_TO_UINT16(pkt->len, pValue);
+        BYTES_TO_UINT16(header, &pValue[2]);
+        pkt->header.pktType = (header & PACKET_TYPE_BIT_MASK) >> PACKET_TYPE_BIT_OFFSET;
+        pkt->header.pktSn = (header & PACKET_SN_BIT_MASK) >> PACKET_SN_BIT_OFFSET;
+        pkt->header.encrypted = (header & PACKET_ENCRYPTION_BIT_MASK) >> PACKET_ENCRYPTION_BIT_OFFSET;
+        pkt->header.ackEnabled = (header & PACKET_ACK_BIT_MASK) >> PACKET_ACK_BIT_OFFSET;
+        pkt->header.reserved = header & (PACKET_STREAM_BIT_MASK | PACKET_COMPRESS_BIT_MASK);
+        dataIdx = AMDTP_PREFIX_SIZE_IN_PKT;
+        rc->crc = 0;
+
+        if (pkt == &core->rxPkt)
+        {
+            core->rxCut = core->cb.partReceived != NULL && ! core->keySet &&
+                          ! (header & (PACKET_STREAM_BIT_MASK | PACKET_COMPRESS_BIT_MASK | PACKET_ENCRYPTION_BIT_MASK));
+        }
+    }
+
+    // make sure we have enough space for new data
+    if (pkt->offset + len - dataIdx > bufSize)
+    {
+        rxCutEnd(core, pkt, AMDTP_STATUS_INSUFFICIENT_BUFFER);
+        resetPkt(pkt);
+        core->rxCur = NULL;
+        sendReply(core, AMDTP_STATUS_INSUFFICIENT_BUFFER);
+        return AMDTP_STATUS_INSUFFICIENT_BUFFER;
+    }
+
+    // CRC as the frames come in, cut-through does not collect the packet
+    n = rxFold(rc, pkt->offset, pkt->len, pValue + dataIdx, len - dataIdx);
+
+    if (pkt == &core->rxPkt && core->rxCut)
+    {
+        if (n > 0) core->cb.partReceived(core->cb.user, pValue + dataIdx, n, pkt->offset);
+    }
+    else
+    {
+        memcpy(pkt->data + pkt->offset, pValue + dataIdx, len - dataIdx);
+    }
+
+    pkt->offset += (len - dataIdx);
+
+    // whole packet received
+    if (pkt->offset >= pkt->len)
+    {
+        core->rxCur = NULL;
+
+        if (pkt->len < AMDTP_CRC_SIZE_IN_PKT + (pkt->header.pktType != AMDTP_PKT_TYPE_DATA))
+        {
+            rxCutEnd(core, pkt, AMDTP_STATUS_INVALID_PKT_LENGTH);
+            resetPkt(pkt);
+            sendReply(core, AMDTP_STATUS_INVALID_PKT_LENGTH);
+            return AMDTP_STATUS_INVALID_PKT_LENGTH;
+        }
+
+        BYTES_TO_UINT32(peerCrc, rc->peer);
+
+        if (peerCrc != rc->crc)
+        {
+            core->stats.crcErrors++;
+            rxCutEnd(core, pkt, AMDTP_STATUS_CRC_ERROR);
+            resetPkt(pkt);
+            sendReply(core, AMDTP_STATUS_CRC_ERROR);
+            return AMDTP_STATUS_CRC_ERROR;
+        }
+
+        packetHandler(core, pkt, pkt->len - AMDTP_CRC_SIZE_IN_PKT);
+        return AMDTP_STATUS_RECEIVE_DONE;
+    }
+
+    // if requested to confirm packet received (not on last packet)
+    if (pkt->header.pktType == AMDTP_PKT_TYPE_DATA && pkt->header.ackEnabled)
+    {
+        core->rxChunkCount++;       // the count starts with 1
+        sendAck(core, AMDTP_PKT_TYPE_CONTROL, AMDTP_CONTROL_SEND_READY, &core->rxChunkCount, 1);
+    }
+
+    return AMDTP_STATUS_RECEIVE_CONTINUE;
+}
+
+//*****************************************************************************
+//
+// public functions, see amdtp_core.h
+//
+//*****************************************************************************
+void
+AmdtpCoreSetCallbacks(amdtpCore_t *core, const amdtpCoreCallbacks_t *cb)
+{
+    core->cb = *cb;
+    AmdtpCoreSetWindow(core, AMDTP_WINDOW_DEFAULT);
+}
+
+void
+AmdtpCoreInit(amdtpCore_t *core)
+{
+    amdtpCoreCallbacks_t cb = core->cb;
+    uint8_t localWindow = core->localWindow;
+    bool localCompress = core->localCompress;
+    bool keySet = core->keySet;
+    uint8_t key[AMDTP_CCM_KEY_SIZE];
+
+    memcpy(key, core->key, sizeof(key));
+
+    setTimer(core, 0);
+
+    memset(core, 0, sizeof(amdtpCore_t));
+    core->cb = cb;
+    core->localWindow = localWindow;
+    core->localCompress = localCompress;
+    core->keySet = keySet;
+    memcpy(core->key, key, sizeof(key));
+
+    core->rxPkt.data = core->rxPktBuf;
+    core->ackPkt.data = core->rxAckBuf;
+    core->txPkt.data = core->txPktBuf;
+
+    core->attMtuSize = ATT_DEFAULT_MTU;
+    core->txState = AMDTP_STATE_TX_IDLE;
+}
+
+void
+AmdtpCoreResetTransfer(amdtpCore_t *core)
+{
+    setTimer(core, 0);
+
+    // the peer holds the first frames of a stop-and-wait packet and would add
+    // the next packet to them : RESEND_REQ makes it drop them. 0xf is never
+    // below its last serial number, so it always answers
+    if (! core->txWindowed && core->txState == AMDTP_STATE_SENDING && core->txPkt.offset > 0)
+    {
+        uint8_t sn = 0xf;
+
+        sendAck(core, AMDTP_PKT_TYPE_CONTROL, AMDTP_CONTROL_RESEND_REQ, &sn, 1);
+        core->txResetReq = true;
+    }
+
+    // the packet being sent fails as after too many retries, a stream with it
+    if (core->txState != AMDTP_STATE_TX_IDLE)
+    {
+        txDone(core, AMDTP_STATUS_UNKNOWN_ERROR);
+    }
+
+    core->txStreamOpen = false;
+    core->txStreamFirst = false;
+    core->txStreamClosing = false;
+    core->txStreamFill = 0;
+    core->txBlocked = false;
+
+    // drop what is received of a packet, the serial numbers stay to refuse copies of the last one
+    rxCutEnd(core, &core->rxPkt, AMDTP_STATUS_UNKNOWN_ERROR);
+    winCutEnd(core, AMDTP_STATUS_UNKNOWN_ERROR);
+
+    if (core->rxStreamOpen)
+    {
+        streamEnd(core, AMDTP_STATUS_UNKNOWN_ERROR);
+    }
+
+    core->rxCur = NULL;
+    core->rxChunkCount = 0;
+    core->rxWinActive = false;
+    resetPkt(&core->rxPkt);
+    resetPkt(&core->ackPkt);
+}
+
+void
+AmdtpCoreSetMtu(amdtpCore_t *core, uint16_t attMtuSize)
+{
+    if (attMtuSize < AMDTP_MIN_MTU)   attMtuSize = AMDTP_MIN_MTU;
+    if (attMtuSize > ATT_MAX_MTU)     attMtuSize = ATT_MAX_MTU;     // size of txFrame
+
+    core->attMtuSize = attMtuSize;
+}
+
+void
+AmdtpCoreSetWindow(amdtpCore_t *core, uint8_t window)
+{
+    if (core->cb.timer == NULL)
+    {
+        window = 0;                 // can not recover lost frames
+    }
+
+    core->localWindow = window > AMDTP_WINDOW_MAX ? AMDTP_WINDOW_MAX : window;
+}
+
+void
+AmdtpCoreSetCompress(amdtpCore_t *core, bool enable)
+{
+    core->localCompress = enable;
+}
+
+void
+AmdtpCoreSetKey(amdtpCore_t *core, const uint8_t *key)
+{
+    core->keySet = key != NULL;
+
+    if (key)
+    {
+        memcpy(core->key, key, AMDTP_CCM_KEY_SIZE);
+    }
+    else
+    {
+        memset(core->key, 0, AMDTP_CCM_KEY_SIZE);
+    }
+}
+
+void
+AmdtpCoreNegotiate(amdtpCore_t *core)
+{
+    uint8_t data[2 + AMDTP_SEC_SKD_SIZE];
+    uint16_t len = 2;
+
+    // also without a window, to learn the version of the peer
+    data[0] = AMDTP_CORE_VERSION;
+    data[1] = core->localWindow;
+
+    // offer our part of a session key
+    core->secure = false;
+    core->skdValid = core->keySet && core->cb.random;
+
+    if (core->skdValid)
+    {
+        core->cb.random(core->cb.user, core->skd, AMDTP_SEC_SKD_SIZE);
+        memcpy(&data[2], core->skd, AMDTP_SEC_SKD_SIZE);
+        len += AMDTP_SEC_SKD_SIZE;
+    }
+
+    sendAck(core, AMDTP_PKT_TYPE_CONTROL, AMDTP_CONTROL_WINDOW_REQ, data, len);
+}
+
+eAmdtpStatus_t
+AmdtpCoreReceive(amdtpCore_t *core, uint8_t *buf, uint16_t len)
+{
+    // acknowledgements can come in between the frames of a stop-and-wait packet
+    if (core->rxCur == &core->rxPkt && isAckFrame(buf, len))
+    {
+        amdtpPacket_t *save = core->rxCur;
+        eAmdtpStatus_t status;
+
+        core->rxCur = NULL;
+        status = legacyReceive(core, buf, len);
+        core->rxCur = save;
+        return status;
+    }
+
+    if (core->rxCur == NULL && len > AMDTP_WIN_HDR_SIZE && buf[1] >= AMDTP_WIN_EXT_MARK)
+    {
+        return winReceive(core, buf, len);
+    }
+
+    return legacyReceive(core, buf, len);
+}
+
+eAmdtpStatus_t
+AmdtpCoreSend(amdtpCore_t *core, uint8_t *buf, uint16_t len)
+{
+    if (core->txState != AMDTP_STATE_TX_IDLE || core->txStreamOpen)
+    {
+        return AMDTP_STATUS_BUSY;
+    }
+
+    if (len > AMDTP_MAX_PAYLOAD_SIZE)
+    {
+        return AMDTP_STATUS_INVALID_PKT_LENGTH;
+    }
+
+    if (secBlocked(core))
+    {
+        return AMDTP_STATUS_TX_NOT_READY;
+    }
+
+    startPkt(core, buf, len, 0);
+
+    return AMDTP_STATUS_SUCCESS;
+}
+
+bool
+AmdtpCoreSendComplete(amdtpCore_t *core)
+{
+    if (core->txStreamOpen)
+    {
+        return false;
+    }
+
+    if (core->txWindowed)
+    {
+        return core->txState == AMDTP_STATE_TX_IDLE;
+    }
+
+    return ! core->sendingNotComplete;
+}
+
+void
+AmdtpCorePump(amdtpCore_t *core)
+{
+    if (! ackFlush(core))
+    {
+        return;
+    }
+
+    if (core->txBlocked)
+    {
+        core->txBlocked = false;
+        winPump(core);
+
+        // replace the retry timer
+        if (! core->txBlocked)
+        {
+            setTimer(core, AMDTP_RETX_TIMEOUT_MS);
+        }
+    }
+}
+
+void
+AmdtpCoreTimeout(amdtpCore_t *core)
+{
+    if (core->txState != AMDTP_STATE_SENDING || ! core->txWindowed)
+    {
+        return;
+    }
+
+    if (core->txBlocked)
+    {
+        core->txBlocked = false;
+        winPump(core);
+        if (! core->txBlocked)
+        {
+            setTimer(core, AMDTP_RETX_TIMEOUT_MS);
+        }
+        return;
+    }
+
+    core->stats.timeouts++;
+
+    if (++core->txRetries > AMDTP_MAX_RETRIES)
+    {
+        txDone(core, AMDTP_STATUS_UNKNOWN_ERROR);
+        return;
+    }
+
+    // repeat everything that is not confirmed
+    core->txPending |= ALL_CHUNKS(core->txChunks) & ~core->txAcked;
+    core->txFastResent = 0;
+
+    // all confirmed but the final ACK did not come : the last frame again,
+    // the receiver answers it with the final ACK or its WINDOW_ACK
+    if (core->txPending == 0)
+    {
+        core->txPending = CHUNK_BIT(core->txChunks - 1);
+    }
+    winPump(core);
+}
+
+eAmdtpStatus_t
+AmdtpCoreStreamOpen(amdtpCore_t *core, uint32_t len)
+{
+    if (core->peerVersion < AMDTP_STREAM_MIN_VERSION || secBlocked(core))
+    {
+        return AMDTP_STATUS_TX_NOT_READY;
+    }
+
+    if (core->txState != AMDTP_STATE_TX_IDLE || core->txStreamOpen)
+    {
+        return AMDTP_STATUS_BUSY;
+    }
+
+    core->txStreamOpen = true;
+    core->txStreamFirst = true;
+    core->txStreamClosing = false;
+    core->txStreamLast = false;
+    core->txStreamLen = len;
+    core->txStreamCount = 0;
+    core->txStreamCrc = 0;
+    core->txStreamFill = 0;
+
+    return AMDTP_STATUS_SUCCESS;
+}
+
+uint16_t
+AmdtpCoreStreamWrite(amdtpCore_t *core, const uint8_t *buf, uint16_t len)
+{
+    uint16_t done = 0, n;
+
+    if (! core->txStreamOpen || core->txStreamClosing)
+    {
+        return 0;
+    }
+
+    // not more than announced
+    if (core->txStreamLen != AMDTP_STREAM_LEN_UNKNOWN && len > core->txStreamLen - core->txStreamCount)
+    {
+        len = core->txStreamLen - core->txStreamCount;
+    }
+
+    while (done < len)
+    {
+        // a full staging buffer goes out when the previous packet is done
+        if (core->txStreamFill == AMDTP_STREAM_DATA_SIZE)
+        {
+            if (core->txState != AMDTP_STATE_TX_IDLE) break;
+            streamFlush(core);
+        }
+
+        n = AMDTP_STREAM_DATA_SIZE - core->txStreamFill;
+        if (n > len - done) n = len - done;
+
+        memcpy(&core->txStreamBuf[core->txStreamFill], &buf[done], n);
+        core->txStreamCrc = streamCrc(core->txStreamCrc, &buf[done], n);
+        core->txStreamFill += n;
+        core->txStreamCount += n;
+        done += n;
+    }
+
+    // start sending as soon as possible
+    if (core->txStreamFill == AMDTP_STREAM_DATA_SIZE)
+    {
+        streamFlush(core);
+    }
+
+    return done;
+}
+
+eAmdtpStatus_t
+AmdtpCoreStreamClose(amdtpCore_t *core)
+{
+    if (! core->txStreamOpen || core->txStreamClosing)
+    {
+        return AMDTP_STATUS_TX_NOT_READY;
+    }
+
+    core->txStreamClosing = true;
+
+    // else sent after the packet in progress
+    streamFlush(core);
+
+    return AMDTP_STATUS_SUCCESS;
+}
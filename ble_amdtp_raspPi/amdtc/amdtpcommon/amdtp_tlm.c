@@ -0,0 +1,227 @@
+// ****************************************************************************
+//
+//  amdtp_tlm.c
+//! @file
+//!
+//! @brief Batched sensor telemetry for AMDTP packets, see amdtp_tlm.h
+//!
+//! added paulvha / October 2026
+//
+// ****************************************************************************
+
+#include <string.h>
+#include "amdtp_tlm.h"
+
+#define TLM_VARINT_MAX      5       // bytes of a 32 bit varint
+
+static const char * const tlmNames[AMDTP_TLM_FIELDS] =
+{
+    "battery", "internal", "temperature", "humidity", "pressure", "altitude"
+};
+
+static const char * const tlmUnits[AMDTP_TLM_FIELDS] =
+{
+    "%", "C", "C", "%", "hPa", "m"
+};
+
+static uint32_t
+zigzag(int32_t v)
+{
+    return ((uint32_t) v << 1) ^ (uint32_t)(v < 0 ? -1 : 0);
+}
+
+static int32_t
+unzigzag(uint32_t v)
+{
+    return (int32_t)((v >> 1) ^ (0U - (v & 1)));
+}
+
+// false when it does not fit, enc->len is then not changed
+static bool
+putVarint(amdtpTlmEnc_t *enc, uint32_t v)
+{
+    uint8_t tmp[TLM_VARINT_MAX];
+    uint8_t n = 0;
+
+    do
+    {
+        tmp[n] = v & 0x7f;
+        v >>= 7;
+        if (v) tmp[n] |= 0x80;
+        n++;
+    }
+    while (v);
+
+    if (enc->len + n > enc->size) return false;
+
+    memcpy(&enc->buf[enc->len], tmp, n);
+    enc->len += n;
+    return true;
+}
+
+static bool
+getVarint(amdtpTlmDec_t *dec, uint32_t *v)
+{
+    uint8_t shift = 0, b;
+
+    *v = 0;
+
+    do
+    {
+        if (dec->pos >= dec->len || shift >= 7 * TLM_VARINT_MAX) return false;
+
+        b = dec->buf[dec->pos++];
+        *v |= (uint32_t)(b & 0x7f) << shift;
+        shift += 7;
+    }
+    while (b & 0x80);
+
+    return true;
+}
+
+void
+AmdtpTlmEncInit(amdtpTlmEnc_t *enc, uint8_t *buf, uint16_t size, uint8_t fields)
+{
+    memset(enc, 0, sizeof(amdtpTlmEnc_t));
+    enc->buf = buf;
+    enc->size = size;
+
+    buf[0] = AMDTP_TLM_VERSION;
+    buf[1] = fields & AMDTP_TLM_ALL;
+    buf[2] = 0;
+    enc->len = AMDTP_TLM_HDR_SIZE;
+}
+
+bool
+AmdtpTlmEncAdd(amdtpTlmEnc_t *enc, const amdtpTlmSample_t *s)
+{
+    uint16_t save = enc->len;
+    bool first = enc->buf[2] == 0;
+    uint8_t f;
+
+    if (enc->buf[2] == 255) return false;
+
+    // the differences as uint32_t, int32_t could overflow
+    if (! putVarint(enc, first ? s->time : s->time - enc->last.time)) goto full;
+
+    for (f = 0; f < AMDTP_TLM_FIELDS; f++)
+    {
+        if ((enc->buf[1] & AMDTP_TLM_BIT(f)) == 0) continue;
+
+        if (! putVarint(enc, zigzag(first ? s->value[f] : (int32_t)((uint32_t) s->value[f] - (uint32_t) enc->last.value[f]))))
+            goto full;
+    }
+
+    enc->last = *s;
+    enc->buf[2]++;
+    return true;
+
+full:
+    enc->len = save;
+    return false;
+}
+
+uint8_t
+AmdtpTlmEncCount(const amdtpTlmEnc_t *enc)
+{
+    return enc->buf[2];
+}
+
+uint16_t
+AmdtpTlmEncLen(const amdtpTlmEnc_t *enc)
+{
+    return enc->len;
+}
+
+bool
+AmdtpTlmDecInit(amdtpTlmDec_t *dec, const uint8_t *buf, uint16_t len)
+{
+    memset(dec, 0, sizeof(amdtpTlmDec_t));
+
+    if (len < AMDTP_TLM_HDR_SIZE || buf[0] != AMDTP_TLM_VERSION) return false;
+
+    dec->buf = buf;
+    dec->len = len;
+    dec->fields = buf[1] & AMDTP_TLM_ALL;
+    dec->count = buf[2];
+    dec->pos = AMDTP_TLM_HDR_SIZE;
+    return true;
+}
+
+bool
+AmdtpTlmDecNext(amdtpTlmDec_t *dec, amdtpTlmSample_t *s)
+{
+    uint32_t v;
+    uint8_t f;
+
+    if (dec->index >= dec->count) return false;
+
+    memset(s, 0, sizeof(amdtpTlmSample_t));
+
+    if (! getVarint(dec, &v)) return false;
+    s->time = dec->index == 0 ? v : dec->last.time + v;
+
+    for (f = 0; f < AMDTP_TLM_FIELDS; f++)
+    {
+        if ((dec->fields & AMDTP_TLM_BIT(f)) == 0) continue;
+
+        if (! getVarint(dec, &v)) return false;
+        s->value[f] = dec->index == 0 ? unzigzag(v) : (int32_t)((uint32_t) dec->last.value[f] + (uint32_t) unzigzag(v));
+    }
+
+    dec->last = *s;
+    dec->index++;
+    return true;
+}
+
+int32_t
+AmdtpTlmToInt(float value)
+{
+    float v = value * AMDTP_TLM_SCALE;
+
+    if (v >= 2147483647.0f) return INT32_MAX;
+    if (v <= -2147483648.0f) return INT32_MIN;
+
+    return (int32_t)(v < 0 ? v - 0.5f : v + 0.5f);
+}
+
+float
+AmdtpTlmToFloat(int32_t value)
+{
+    return (float) value / AMDTP_TLM_SCALE;
+}
+
+const char *
+AmdtpTlmName(uint8_t field)
+{
+    return field < AMDTP_TLM_FIELDS ? tlmNames[field] : "";
+}
+
+const char *
+AmdtpTlmUnit(uint8_t field)
+{
+    return field < AMDTP_TLM_FIELDS ? tlmUnits[field] : "";
+}
+
+uint16_t
+AmdtpTlmPutSubscribe(uint8_t *buf, uint8_t fields, uint16_t intervalMs, uint8_t samples)
+{
+    buf[0] = fields;
+    buf[1] = intervalMs >> 8;
+    buf[2] = intervalMs & 0xff;
+    buf[3] = samples;
+
+    return AMDTP_TLM_SUBSCRIBE_SIZE;
+}
+
+bool
+AmdtpTlmGetSubscribe(const uint8_t *buf, uint16_t len, uint8_t *fields, uint16_t *intervalMs, uint8_t *samples)
+{
+    if (len < AMDTP_TLM_SUBSCRIBE_SIZE) return false;
+
+    *fields = buf[0] & AMDTP_TLM_ALL;
+    *intervalMs = buf[1] << 8 | buf[2];
+    *samples = buf[3];
+
+    return true;
+}
@@ -130,3 +130,86 @@ uint32_t CalcCrc32(uint32_t crcInit, uint32_t len, uint8_t *pBuf)
 
   return crc;
 }
+
+/*************************************************************************************************/
+/*
+ *  Incremental CRC-32 with slicing-by-8
+ *  paulvha / October 2026
+ *
+ *  AmdtpCrc32() gives the same result as zlib crc32() and Python zlib.crc32() :
+ *
+ *    AmdtpCrc32(0, pBuf, len) == CalcCrc32(0xFFFFFFFF, len, pBuf)
+ *
+ *  and the result can be passed back to continue over the next part of the data :
+ *
+ *    crc = AmdtpCrc32(0, part1, len1);
+ *    crc = AmdtpCrc32(crc, part2, len2);   // same as one call over part1 + part2
+ *
+ *  Slicing-by-8 handles 8 bytes per step with 8 tables of 256 entries. The first
+ *  table is crc32Table, the other 7 are calculated from it on the first call. That
+ *  takes 7 Kbyte RAM. Set CRC32_SLICE to 1 (in crc32.h) to use crc32Table only.
+ *
+ *  The bytes are combined as little endian, so it works on any CPU and
+ *  any alignment of pBuf. GCC turns that into a normal load on ARM and x86.
+ */
+/*************************************************************************************************/
+#if CRC32_SLICE == 8
+
+static uint32_t crc32Slice[7][256];
+static bool crc32SliceDone = false;
+
+static void crc32MakeSlice(void)
+{
+  uint32_t i, k, crc;
+
+  for (i = 0; i < 256; i++)
+  {
+    crc = crc32Table[i];
+
+    for (k = 0; k < 7; k++)
+    {
+      crc = crc32Table[crc & 0xff] ^ (crc >> 8);
+      crc32Slice[k][i] = crc;
+    }
+  }
+
+  crc32SliceDone = true;
+}
+
+#endif // CRC32_SLICE
+
+uint32_t AmdtpCrc32(uint32_t crc, const uint8_t *pBuf, uint32_t len)
+{
+  crc = crc ^ 0xFFFFFFFFU;
+
+#if CRC32_SLICE == 8
+  uint32_t one, two;
+
+  if (len >= 8 && !crc32SliceDone) crc32MakeSlice();
+
+  while (len >= 8)
+  {
+    one = crc ^ ((uint32_t) pBuf[0] | (uint32_t) pBuf[1] << 8 |
+                 (uint32_t) pBuf[2] << 16 | (uint32_t) pBuf[3] << 24);
+    two = (uint32_t) pBuf[4] | (uint32_t) pBuf[5] << 8 |
+          (uint32_t) pBuf[6] << 16 | (uint32_t) pBuf[7] << 24;
+
+    crc = crc32Slice[6][one & 0xff] ^ crc32Slice[5][(one >> 8) & 0xff] ^
+          crc32Slice[4][(one >> 16) & 0xff] ^ crc32Slice[3][one >> 24] ^
+          crc32Slice[2][two & 0xff] ^ crc32Slice[1][(two >> 8) & 0xff] ^
+          crc32Slice[0][(two >> 16) & 0xff] ^ crc32Table[two >> 24];
+
+    pBuf += 8;
+    len -= 8;
+  }
+#endif
+
+  while (len > 0)
+  {
+    crc = crc32Table[*pBuf ^ (uint8_t)crc] ^ (crc >> 8);
+    pBuf++;
+    len--;
+  }
+
+  return crc ^ 0xFFFFFFFFU;
+}